@@ -0,0 +1,2245 @@
+/*
+    Yojimbo Benchmarks.
+
+    Copyright © 2016 - 2026, Más Bandwidth LLC
+
+    Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+        1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+        2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer 
+           in the documentation and/or other materials provided with the distribution.
+
+        3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived 
+           from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+    INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+    SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+    USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "shared.h"
+#include "reliable.h"
+#include "netcode.h"
+#include <sodium.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <inttypes.h>
+
+/*
+    Results: each benchmark prints its numbers for people, and reports the headline ones here too, so `bench --json results.json`
+    can write them out and tools/bench/compare.py can diff one version's results against another's.
+*/
+
+enum BenchBetter
+{
+    BENCH_LOWER_IS_BETTER,
+    BENCH_HIGHER_IS_BETTER
+};
+
+struct BenchResult
+{
+    const char * benchmark;                 // the Benchmarks[] entry that reported it
+    char name[128];
+    double value;
+    const char * unit;
+    BenchBetter better;
+};
+
+const int BenchMaxResults = 1024;
+
+static BenchResult BenchResults[BenchMaxResults];
+static int BenchNumResults = 0;
+static const char * BenchCurrent = "";
+
+static void BenchReport( double value, const char * unit, BenchBetter better, const char * format, ... )
+{
+    yojimbo_assert( BenchNumResults < BenchMaxResults );
+    if ( BenchNumResults >= BenchMaxResults )
+        return;
+    BenchResult & result = BenchResults[BenchNumResults++];
+    result.benchmark = BenchCurrent;
+    va_list args;
+    va_start( args, format );
+    vsnprintf( result.name, sizeof( result.name ), format, args );
+    va_end( args );
+    result.value = value;
+    result.unit = unit;
+    result.better = better;
+}
+
+static bool BenchWriteResults( const char * path )
+{
+    FILE * file = fopen( path, "wb" );
+    if ( !file )
+        return false;
+
+#ifdef YOJIMBO_DEBUG
+    const char * build = "debug";
+#else // #ifdef YOJIMBO_DEBUG
+    const char * build = "release";
+#endif // #ifdef YOJIMBO_DEBUG
+
+    fprintf( file, "{\n  \"version\": \"%d.%d.%d\",\n  \"build\": \"%s\",\n  \"results\": [",
+        YOJIMBO_MAJOR_VERSION, YOJIMBO_MINOR_VERSION, YOJIMBO_PATCH_VERSION, build );
+
+    // names are written as is: they come from the format strings in this file, none of which contain quotes or backslashes
+
+    for ( int i = 0; i < BenchNumResults; ++i )
+    {
+        const BenchResult & result = BenchResults[i];
+        fprintf( file, "%s\n    { \"benchmark\": \"%s\", \"name\": \"%s\", \"value\": %.6g, \"unit\": \"%s\", \"better\": \"%s\" }",
+            i > 0 ? "," : "", result.benchmark, result.name, result.value, result.unit, result.better == BENCH_HIGHER_IS_BETTER ? "higher" : "lower" );
+    }
+
+    fprintf( file, "\n  ]\n}\n" );
+
+    const bool ok = !ferror( file );
+    return fclose( file ) == 0 && ok;
+}
+
+/*
+    A connection pair over the network simulator, with a reliable endpoint on each side for sequence numbers and acks.
+    This is the same path a client and server take, minus netcode, so benchmarks see real packet sizes and real ack timing under latency and loss.
+*/
+
+struct BenchLink
+{
+    struct Side
+    {
+        BenchLink * link;
+        int index;
+        Connection * connection;
+        reliable_endpoint_t * endpoint;
+        uint64_t bytesSent;
+        uint64_t packetsSent;
+    };
+
+    Side side[2];
+    ConnectionConfig connectionConfig;
+    NetworkSimulator * simulator;
+    double time;
+    int packetsPerUpdate;                   // packets each side generates per update
+    int replyInterval;                      // side 1 only sends packets every this many updates
+    int numUpdates;
+    bool batchAcks;                         // pass each update's acks to the connections in one call, rather than one call per ack
+    double ackSeconds;                      // time spent processing acks
+    double generateSeconds;                 // time spent generating packets
+};
+
+static void BenchTransmitPacket( void * context, uint64_t index, uint16_t packetSequence, uint8_t * packetData, int packetBytes )
+{
+    (void) packetSequence;
+    BenchLink * link = (BenchLink*) context;
+    BenchLink::Side & side = link->side[index];
+    side.bytesSent += packetBytes;
+    side.packetsSent++;
+    link->simulator->SendPacket( 1 - (int) index, packetData, packetBytes );
+}
+
+static int BenchProcessPacket( void * context, uint64_t index, uint16_t packetSequence, uint8_t * packetData, int packetBytes )
+{
+    BenchLink * link = (BenchLink*) context;
+    return link->side[index].connection->ProcessPacket( NULL, packetSequence, packetData, packetBytes ) ? 1 : 0;
+}
+
+static void BenchLinkCreate( BenchLink & link, MessageFactory & messageFactory, const ConnectionConfig & connectionConfig, float latency, float packetLoss, int ackBits = 32 )
+{
+    link.time = 100.0;
+    link.packetsPerUpdate = 1;
+    link.replyInterval = 1;
+    link.numUpdates = 0;
+    link.batchAcks = true;
+    link.ackSeconds = 0.0;
+    link.generateSeconds = 0.0;
+    link.connectionConfig = connectionConfig;
+    link.simulator = YOJIMBO_NEW( GetDefaultAllocator(), NetworkSimulator, GetDefaultAllocator(), 4096, link.time );
+    link.simulator->SetLatency( latency );
+    link.simulator->SetPacketLoss( packetLoss );
+
+    for ( int i = 0; i < 2; ++i )
+    {
+        BenchLink::Side & side = link.side[i];
+        side.link = &link;
+        side.index = i;
+        side.bytesSent = 0;
+        side.packetsSent = 0;
+        side.connection = YOJIMBO_NEW( GetDefaultAllocator(), Connection, GetDefaultAllocator(), messageFactory, connectionConfig, link.time );
+
+        reliable_config_t reliable_config;
+        reliable_default_config( &reliable_config );
+        yojimbo_copy_string( reliable_config.name, i == 0 ? "bench sender" : "bench receiver", sizeof( reliable_config.name ) );
+        reliable_config.context = (void*) &link;
+        reliable_config.id = i;
+        reliable_config.max_packet_size = connectionConfig.maxPacketSize;
+        reliable_config.fragment_above = connectionConfig.maxPacketSize;
+#ifndef YOJIMBO_SYSTEM_DEPS
+        reliable_config.ack_bits = ackBits;
+#else // #ifndef YOJIMBO_SYSTEM_DEPS
+        yojimbo_assert( ackBits == 32 );
+        (void) ackBits;
+#endif // #ifndef YOJIMBO_SYSTEM_DEPS
+        reliable_config.transmit_packet_function = BenchTransmitPacket;
+        reliable_config.process_packet_function = BenchProcessPacket;
+        side.endpoint = reliable_endpoint_create( &reliable_config, link.time );
+    }
+}
+
+static void BenchLinkDestroy( BenchLink & link )
+{
+    for ( int i = 0; i < 2; ++i )
+    {
+        reliable_endpoint_destroy( link.side[i].endpoint );
+        YOJIMBO_DELETE( GetDefaultAllocator(), Connection, link.side[i].connection );
+    }
+    YOJIMBO_DELETE( GetDefaultAllocator(), NetworkSimulator, link.simulator );
+}
+
+static void BenchLinkUpdate( BenchLink & link, double deltaTime )
+{
+    const ConnectionConfig & connectionConfig = link.connectionConfig;
+
+    uint8_t * packetData = (uint8_t*) alloca( connectionConfig.maxPacketSize );
+
+    for ( int i = 0; i < 2; ++i )
+    {
+        BenchLink::Side & side = link.side[i];
+        if ( i == 1 && ( link.numUpdates % link.replyInterval ) != 0 )
+            continue;
+        for ( int j = 0; j < link.packetsPerUpdate; ++j )
+        {
+            int packetBytes = 0;
+            const uint16_t packetSequence = reliable_endpoint_next_packet_sequence( side.endpoint );
+            const double generateStart = yojimbo_time();
+            const bool generated = side.connection->GeneratePacket( NULL, packetSequence, packetData, connectionConfig.maxPacketSize, packetBytes );
+            link.generateSeconds += yojimbo_time() - generateStart;
+            if ( generated )
+                reliable_endpoint_send_packet( side.endpoint, packetData, packetBytes );
+        }
+    }
+
+    link.time += deltaTime;
+    link.numUpdates++;
+
+    link.simulator->AdvanceTime( link.time );
+
+    const int MaxPackets = 64;
+    uint8_t * receivedPacketData[MaxPackets];
+    int receivedPacketBytes[MaxPackets];
+    int to[MaxPackets];
+
+    const int numPackets = link.simulator->ReceivePackets( MaxPackets, receivedPacketData, receivedPacketBytes, to );
+
+    for ( int i = 0; i < numPackets; ++i )
+    {
+        reliable_endpoint_receive_packet( link.side[to[i]].endpoint, receivedPacketData[i], receivedPacketBytes[i] );
+        YOJIMBO_FREE( link.simulator->GetAllocator(), receivedPacketData[i] );
+    }
+
+    for ( int i = 0; i < 2; ++i )
+    {
+        BenchLink::Side & side = link.side[i];
+        reliable_endpoint_update( side.endpoint, link.time );
+        int numAcks = 0;
+        const uint16_t * acks = reliable_endpoint_get_acks( side.endpoint, &numAcks );
+        const double ackStart = yojimbo_time();
+        if ( link.batchAcks )
+        {
+            side.connection->ProcessAcks( acks, numAcks );
+        }
+        else
+        {
+            for ( int j = 0; j < numAcks; ++j )
+                side.connection->ProcessAcks( &acks[j], 1 );
+        }
+        link.ackSeconds += yojimbo_time() - ackStart;
+        reliable_endpoint_clear_acks( side.endpoint );
+        side.connection->AdvanceTime( link.time );
+    }
+}
+
+/*
+    Snapshot bandwidth: a 60HZ stream of world snapshots where a handful of objects move each tick, sent over a snapshot channel (delta compressed
+    against acked baselines) and over an unreliable-unordered channel (full snapshot every time), across a range of packet loss.
+*/
+
+const int BenchSnapshotObjects = 64;
+const int BenchSnapshotObjectBytes = 16;
+const int BenchSnapshotBytes = BenchSnapshotObjects * BenchSnapshotObjectBytes;
+const int BenchSnapshotMovingObjects = 8;
+
+static void BenchFillSnapshot( uint8_t * data, int tick )
+{
+    // Every object has a fixed slot. Static objects never change, the moving ones change their position bytes every tick.
+    for ( int i = 0; i < BenchSnapshotObjects; ++i )
+    {
+        uint8_t * object = data + i * BenchSnapshotObjectBytes;
+        for ( int j = 0; j < BenchSnapshotObjectBytes; ++j )
+            object[j] = uint8_t( i * 31 + j );
+        if ( i < BenchSnapshotMovingObjects )
+        {
+            object[0] = uint8_t( tick + i );
+            object[1] = uint8_t( ( tick + i ) >> 8 );
+            object[4] = uint8_t( tick * 3 );
+        }
+    }
+}
+
+static void BenchSnapshotBandwidth( ChannelType channelType, float latency, float packetLoss )
+{
+    TestMessageFactory messageFactory( GetDefaultAllocator() );
+
+    ConnectionConfig connectionConfig;
+    connectionConfig.numChannels = 1;
+    connectionConfig.channel[0].type = channelType;
+    connectionConfig.channel[0].maxBlockSize = BenchSnapshotBytes;
+
+    BenchLink link;
+    BenchLinkCreate( link, messageFactory, connectionConfig, latency, packetLoss );
+
+    const int NumTicks = 600;
+    const double DeltaTime = 1.0 / 60.0;
+
+    int numReceived = 0;
+
+    for ( int tick = 0; tick < NumTicks; ++tick )
+    {
+        Connection & sender = *link.side[0].connection;
+        Connection & receiver = *link.side[1].connection;
+
+        TestBlockMessage * message = (TestBlockMessage*) messageFactory.CreateMessage( TEST_BLOCK_MESSAGE );
+        yojimbo_assert( message );
+        message->sequence = uint16_t( tick );
+        uint8_t * blockData = (uint8_t*) YOJIMBO_ALLOCATE( messageFactory.GetAllocator(), BenchSnapshotBytes );
+        BenchFillSnapshot( blockData, tick );
+        message->AttachBlock( messageFactory.GetAllocator(), blockData, BenchSnapshotBytes );
+        sender.SendMessage( 0, message );
+
+        BenchLinkUpdate( link, DeltaTime );
+
+        while ( Message * received = receiver.ReceiveMessage( 0 ) )
+        {
+            numReceived++;
+            receiver.ReleaseMessage( received );
+        }
+    }
+
+    const double seconds = NumTicks * DeltaTime;
+    const double sentKbps = link.side[0].bytesSent * 8.0 / seconds / 1000.0;
+    const double bytesPerPacket = link.side[0].packetsSent ? link.side[0].bytesSent / (double) link.side[0].packetsSent : 0.0;
+
+    printf( "    %-22s latency %4.0fms loss %4.1f%%: %8.1f kbps, %7.1f bytes/packet, %d/%d snapshots delivered\n",
+        channelType == CHANNEL_TYPE_SNAPSHOT ? "snapshot" : "unreliable-unordered",
+        latency, packetLoss, sentKbps, bytesPerPacket, numReceived, NumTicks );
+
+    BenchReport( sentKbps, "kbps", BENCH_LOWER_IS_BETTER, "%s, latency %.0fms, loss %.1f%%",
+        channelType == CHANNEL_TYPE_SNAPSHOT ? "snapshot" : "unreliable-unordered", latency, packetLoss );
+
+    BenchLinkDestroy( link );
+}
+
+static void BenchSnapshot()
+{
+    printf( "\nsnapshot bandwidth (%d byte snapshots, %d of %d objects moving, 60HZ)\n\n", BenchSnapshotBytes, BenchSnapshotMovingObjects, BenchSnapshotObjects );
+
+    const float PacketLoss[] = { 0.0f, 5.0f, 20.0f };
+
+    for ( int i = 0; i < (int) ( sizeof( PacketLoss ) / sizeof( PacketLoss[0] ) ); ++i )
+    {
+        BenchSnapshotBandwidth( CHANNEL_TYPE_UNRELIABLE_UNORDERED, 50.0f, PacketLoss[i] );
+        BenchSnapshotBandwidth( CHANNEL_TYPE_SNAPSHOT, 50.0f, PacketLoss[i] );
+    }
+}
+
+/*
+    Level load: a 256KB level sent as block messages on a reliable-ordered channel at 60HZ, timed until the receiver has every block.
+    Compares one fragment per packet with one block in flight against the default multi-fragment, windowed transfer, and with and without block compression.
+*/
+
+const int BenchLevelBytes = 256 * 1024;
+
+static void BenchFillLevel( uint8_t * data, int bytes, uint32_t seed )
+{
+    // Level-like data: 16 byte object records with a type, a position on a grid, a few small flags and a name from a short list.
+    // Compresses about as well as real level data does, much worse than a repeating pattern would.
+
+    static const char * Names[] = { "crate", "barrel", "door", "lamp", "spawn", "tree", "rock", "ammo" };
+
+    uint32_t state = seed * 2654435761U + 1;
+
+    for ( int i = 0; i < bytes; i += 16 )
+    {
+        uint8_t record[16];
+        memset( record, 0, sizeof( record ) );
+
+        state = state * 1664525U + 1013904223U;
+        const int type = ( state >> 24 ) % 8;
+        record[0] = uint8_t( type );
+        record[1] = uint8_t( ( i / 16 ) % 64 );
+        record[2] = uint8_t( ( i / 16 ) / 64 );
+        record[3] = uint8_t( ( state >> 8 ) & 0x3 );
+        record[4] = uint8_t( state >> 16 );
+        memcpy( record + 8, Names[type], strlen( Names[type] ) );
+
+        memcpy( data + i, record, yojimbo_min( 16, bytes - i ) );
+    }
+}
+
+static void BenchLevelLoad( int numBlocks, int maxFragmentsPerPacket, int maxBlocksInFlight, float latency, float packetLoss, bool compressBlocks = false )
+{
+    TestMessageFactory messageFactory( GetDefaultAllocator() );
+
+    const int blockSize = BenchLevelBytes / numBlocks;
+
+    ConnectionConfig connectionConfig;
+    connectionConfig.numChannels = 1;
+    connectionConfig.channel[0].type = CHANNEL_TYPE_RELIABLE_ORDERED;
+    connectionConfig.channel[0].maxBlockSize = blockSize;
+    connectionConfig.channel[0].maxFragmentsPerPacket = maxFragmentsPerPacket;
+    connectionConfig.channel[0].maxBlocksInFlight = maxBlocksInFlight;
+    connectionConfig.channel[0].compressBlocks = compressBlocks;
+
+    BenchLink link;
+    BenchLinkCreate( link, messageFactory, connectionConfig, latency, packetLoss );
+
+    Connection & sender = *link.side[0].connection;
+    Connection & receiver = *link.side[1].connection;
+
+    for ( int i = 0; i < numBlocks; ++i )
+    {
+        TestBlockMessage * message = (TestBlockMessage*) messageFactory.CreateMessage( TEST_BLOCK_MESSAGE );
+        yojimbo_assert( message );
+        message->sequence = uint16_t( i );
+        uint8_t * blockData = (uint8_t*) YOJIMBO_ALLOCATE( messageFactory.GetAllocator(), blockSize );
+        BenchFillLevel( blockData, blockSize, i );
+        message->AttachBlock( messageFactory.GetAllocator(), blockData, blockSize );
+        sender.SendMessage( 0, message );
+    }
+
+    const int MaxTicks = 60 * 60;
+    const double DeltaTime = 1.0 / 60.0;
+
+    int numReceived = 0;
+    int tick = 0;
+
+    for ( ; tick < MaxTicks && numReceived < numBlocks; ++tick )
+    {
+        BenchLinkUpdate( link, DeltaTime );
+
+        while ( Message * received = receiver.ReceiveMessage( 0 ) )
+        {
+            numReceived++;
+            receiver.ReleaseMessage( received );
+        }
+    }
+
+    printf( "    %d x %3dKB blocks, %d fragment(s)/packet, %d block(s) in flight%s, latency %4.0fms loss %4.1f%%: ",
+        numBlocks, blockSize / 1024, maxFragmentsPerPacket, maxBlocksInFlight, compressBlocks ? ", compressed" : "", latency, packetLoss );
+
+    if ( numReceived == numBlocks )
+        printf( "%6.2f seconds, %5d packets, %7.1fKB sent\n", tick * DeltaTime, (int) link.side[0].packetsSent, link.side[0].bytesSent / 1024.0 );
+    else
+        printf( "incomplete after %d seconds (%d/%d blocks)\n", MaxTicks / 60, numReceived, numBlocks );
+
+    // an incomplete load reports the time limit, so it still reads as a regression
+
+    BenchReport( tick * DeltaTime, "seconds", BENCH_LOWER_IS_BETTER, "%d x %dKB blocks, %d fragment(s)/packet, %d block(s) in flight%s, latency %.0fms, loss %.1f%%",
+        numBlocks, blockSize / 1024, maxFragmentsPerPacket, maxBlocksInFlight, compressBlocks ? ", compressed" : "", latency, packetLoss );
+
+    BenchLinkDestroy( link );
+}
+
+static void BenchBlocks()
+{
+    printf( "\nlevel load (%dKB over a reliable-ordered channel, 60HZ)\n\n", BenchLevelBytes / 1024 );
+
+    const float PacketLoss[] = { 0.0f, 5.0f, 20.0f };
+
+    for ( int i = 0; i < (int) ( sizeof( PacketLoss ) / sizeof( PacketLoss[0] ) ); ++i )
+    {
+        BenchLevelLoad( 1, 1, 1, 50.0f, PacketLoss[i] );
+        BenchLevelLoad( 1, 4, 1, 50.0f, PacketLoss[i] );
+        BenchLevelLoad( 4, 1, 1, 50.0f, PacketLoss[i] );
+        BenchLevelLoad( 4, 4, 4, 50.0f, PacketLoss[i] );
+    }
+}
+
+/*
+    Compression: the block codec on its own (ratio and throughput on one core), then its effect on a level load.
+*/
+
+static void BenchCodec( const char * name, const uint8_t * data, int bytes )
+{
+    const int bound = yojimbo_compress_bound( bytes );
+    uint8_t * compressed = (uint8_t*) malloc( bound );
+    uint8_t * decompressed = (uint8_t*) malloc( bytes );
+
+    const int NumIterations = 50;
+
+    int compressedBytes = 0;
+
+    const double compressStart = yojimbo_time();
+    for ( int i = 0; i < NumIterations; ++i )
+        compressedBytes = yojimbo_compress( data, bytes, compressed, bound, NULL, 0 );
+    const double compressTime = yojimbo_time() - compressStart;
+
+    int decompressedBytes = 0;
+
+    const double decompressStart = yojimbo_time();
+    for ( int i = 0; i < NumIterations; ++i )
+        decompressedBytes = yojimbo_decompress( compressed, compressedBytes, decompressed, bytes, NULL, 0 );
+    const double decompressTime = yojimbo_time() - decompressStart;
+
+    yojimbo_assert( decompressedBytes == bytes );
+    yojimbo_assert( memcmp( data, decompressed, bytes ) == 0 );
+    (void) decompressedBytes;
+
+    const double megabytes = double( bytes ) * NumIterations / ( 1024.0 * 1024.0 );
+
+    printf( "    %-8s %7d -> %7d bytes (%5.1f%%), compress %7.1f MB/s, decompress %7.1f MB/s\n",
+        name, bytes, compressedBytes, compressedBytes * 100.0 / bytes, megabytes / compressTime, megabytes / decompressTime );
+
+    BenchReport( compressedBytes * 100.0 / bytes, "%", BENCH_LOWER_IS_BETTER, "%s, compressed size", name );
+    BenchReport( megabytes / compressTime, "MB/s", BENCH_HIGHER_IS_BETTER, "%s, compress", name );
+    BenchReport( megabytes / decompressTime, "MB/s", BENCH_HIGHER_IS_BETTER, "%s, decompress", name );
+
+    free( compressed );
+    free( decompressed );
+}
+
+static void BenchCompression()
+{
+    printf( "\nblock codec (%dKB)\n\n", BenchLevelBytes / 1024 );
+
+    uint8_t * data = (uint8_t*) malloc( BenchLevelBytes );
+
+    BenchFillLevel( data, BenchLevelBytes, 0 );
+    BenchCodec( "level", data, BenchLevelBytes );
+
+    for ( int i = 0; i < BenchLevelBytes; i += BenchSnapshotBytes )
+        BenchFillSnapshot( data + i, i / BenchSnapshotBytes );
+    BenchCodec( "snapshot", data, BenchLevelBytes );
+
+    for ( int i = 0; i < BenchLevelBytes; ++i )
+        data[i] = uint8_t( rand() );
+    BenchCodec( "random", data, BenchLevelBytes );
+
+    free( data );
+
+    printf( "\nlevel load with block compression (%dKB over a reliable-ordered channel, 60HZ)\n\n", BenchLevelBytes / 1024 );
+
+    const float PacketLoss[] = { 0.0f, 5.0f, 20.0f };
+
+    for ( int i = 0; i < (int) ( sizeof( PacketLoss ) / sizeof( PacketLoss[0] ) ); ++i )
+    {
+        BenchLevelLoad( 4, 4, 4, 50.0f, PacketLoss[i], false );
+        BenchLevelLoad( 4, 4, 4, 50.0f, PacketLoss[i], true );
+    }
+}
+
+/*
+    Acks: small reliable messages keeping a 1024 message send queue full, with several packets sent per update so each update brings a batch of acks.
+    Compares handing the connection each update's acks one at a time against the whole set in one call.
+*/
+
+static void BenchAckProcessing( int numChannels, int packetsPerUpdate, bool batchAcks )
+{
+    TestMessageFactory messageFactory( GetDefaultAllocator() );
+
+    ConnectionConfig connectionConfig;
+    connectionConfig.numChannels = numChannels;
+    connectionConfig.maxPacketSize = 8 * 1024;
+    for ( int i = 0; i < numChannels; ++i )
+    {
+        connectionConfig.channel[i].type = CHANNEL_TYPE_RELIABLE_ORDERED;
+        connectionConfig.channel[i].messageSendQueueSize = 1024;
+        connectionConfig.channel[i].messageReceiveQueueSize = 1024;
+        connectionConfig.channel[i].maxMessagesPerPacket = 64;
+        connectionConfig.channel[i].disableBlocks = true;
+    }
+
+    BenchLink link;
+    BenchLinkCreate( link, messageFactory, connectionConfig, 50.0f, 5.0f );
+    link.packetsPerUpdate = packetsPerUpdate;
+    link.batchAcks = batchAcks;
+
+    Connection & sender = *link.side[0].connection;
+    Connection & receiver = *link.side[1].connection;
+
+    const int NumUpdates = 2000;
+    const double DeltaTime = 1.0 / 60.0;
+
+    uint64_t numReceived = 0;
+    uint16_t sequence = 0;
+
+    for ( int update = 0; update < NumUpdates; ++update )
+    {
+        for ( int i = 0; i < numChannels; ++i )
+        {
+            while ( sender.CanSendMessage( i ) )
+            {
+                TestMessage * message = (TestMessage*) messageFactory.CreateMessage( TEST_MESSAGE );
+                yojimbo_assert( message );
+                message->sequence = sequence++;
+                sender.SendMessage( i, message );
+            }
+        }
+
+        BenchLinkUpdate( link, DeltaTime );
+
+        for ( int i = 0; i < numChannels; ++i )
+        {
+            while ( Message * received = receiver.ReceiveMessage( i ) )
+            {
+                numReceived++;
+                receiver.ReleaseMessage( received );
+            }
+        }
+    }
+
+    printf( "    %d channel(s), %d packets/update, %-9s: %8.1f us/update acking, %9d messages delivered\n",
+        numChannels, packetsPerUpdate, batchAcks ? "batched" : "per-ack", link.ackSeconds * 1000000.0 / NumUpdates, (int) numReceived );
+
+    BenchReport( link.ackSeconds * 1000000.0 / NumUpdates, "us/update", BENCH_LOWER_IS_BETTER, "%d channel(s), %d packets/update, %s",
+        numChannels, packetsPerUpdate, batchAcks ? "batched" : "per-ack" );
+
+    BenchLinkDestroy( link );
+}
+
+static void BenchAcks()
+{
+    printf( "\nack processing (1024 message reliable-ordered queues, 50ms latency, 5%% loss, 60HZ)\n\n" );
+
+    const int PacketsPerUpdate[] = { 1, 8 };
+
+    for ( int i = 0; i < (int) ( sizeof( PacketsPerUpdate ) / sizeof( PacketsPerUpdate[0] ) ); ++i )
+    {
+        BenchAckProcessing( 1, PacketsPerUpdate[i], false );
+        BenchAckProcessing( 1, PacketsPerUpdate[i], true );
+        BenchAckProcessing( 4, PacketsPerUpdate[i], false );
+        BenchAckProcessing( 4, PacketsPerUpdate[i], true );
+    }
+}
+
+/*
+    Send queue: a deep backlog of small reliable messages in a 1024 message send queue, under latency so most of the queue is in flight and not yet due to resend.
+    Times packet generation, which has to find the messages that can go out.
+*/
+
+static void BenchSendQueueBacklog( int maxMessagesPerPacket, float packetLoss )
+{
+    TestMessageFactory messageFactory( GetDefaultAllocator() );
+
+    ConnectionConfig connectionConfig;
+    connectionConfig.numChannels = 1;
+    connectionConfig.maxPacketSize = 8 * 1024;
+    connectionConfig.channel[0].type = CHANNEL_TYPE_RELIABLE_ORDERED;
+    connectionConfig.channel[0].messageSendQueueSize = 1024;
+    connectionConfig.channel[0].messageReceiveQueueSize = 1024;
+    connectionConfig.channel[0].maxMessagesPerPacket = maxMessagesPerPacket;
+    connectionConfig.channel[0].disableBlocks = true;
+
+    BenchLink link;
+    BenchLinkCreate( link, messageFactory, connectionConfig, 250.0f, packetLoss );
+    link.packetsPerUpdate = 4;
+
+    Connection & sender = *link.side[0].connection;
+    Connection & receiver = *link.side[1].connection;
+
+    const int NumUpdates = 2000;
+    const double DeltaTime = 1.0 / 60.0;
+
+    uint64_t numReceived = 0;
+    uint16_t sequence = 0;
+
+    for ( int update = 0; update < NumUpdates; ++update )
+    {
+        while ( sender.CanSendMessage( 0 ) )
+        {
+            TestMessage * message = (TestMessage*) messageFactory.CreateMessage( TEST_MESSAGE );
+            yojimbo_assert( message );
+            message->sequence = sequence++;
+            sender.SendMessage( 0, message );
+        }
+
+        BenchLinkUpdate( link, DeltaTime );
+
+        while ( Message * received = receiver.ReceiveMessage( 0 ) )
+        {
+            numReceived++;
+            receiver.ReleaseMessage( received );
+        }
+    }
+
+    const uint64_t numPackets = link.side[0].packetsSent + link.side[1].packetsSent;
+
+    printf( "    %3d messages/packet, loss %4.1f%%: %6.2f us/packet generated, %9d messages delivered\n",
+        maxMessagesPerPacket, packetLoss, numPackets ? link.generateSeconds * 1000000.0 / numPackets : 0.0, (int) numReceived );
+
+    BenchReport( numPackets ? link.generateSeconds * 1000000.0 / numPackets : 0.0, "us/packet", BENCH_LOWER_IS_BETTER, "%d messages/packet, loss %.1f%%",
+        maxMessagesPerPacket, packetLoss );
+
+    BenchLinkDestroy( link );
+}
+
+static void BenchSendQueue()
+{
+    printf( "\nsend queue backlog (1024 message reliable-ordered queue, 250ms latency, 4 packets per update at 60HZ)\n\n" );
+
+    const float PacketLoss[] = { 0.0f, 5.0f, 20.0f };
+
+    for ( int i = 0; i < (int) ( sizeof( PacketLoss ) / sizeof( PacketLoss[0] ) ); ++i )
+    {
+        BenchSendQueueBacklog( 8, PacketLoss[i] );
+        BenchSendQueueBacklog( 64, PacketLoss[i] );
+    }
+}
+
+/*
+    Ack window: one side streams small reliable messages at a high packet rate while the other side replies only every few updates,
+    so each reply has to ack many packets. Packets that fall outside the ack window are never acked, count as lost, and their messages
+    are resent even though they arrived. Compares 32, 64 and 128 ack bits per packet header.
+*/
+
+static void BenchAckWindowStream( int ackBits, int replyInterval, float packetLoss )
+{
+    TestMessageFactory messageFactory( GetDefaultAllocator() );
+
+    ConnectionConfig connectionConfig;
+    connectionConfig.numChannels = 1;
+    connectionConfig.maxPacketSize = 1200;
+    connectionConfig.channel[0].type = CHANNEL_TYPE_RELIABLE_ORDERED;
+    connectionConfig.channel[0].messageSendQueueSize = 1024;
+    connectionConfig.channel[0].messageReceiveQueueSize = 1024;
+    connectionConfig.channel[0].maxMessagesPerPacket = 16;
+    connectionConfig.channel[0].disableBlocks = true;
+
+    BenchLink link;
+    BenchLinkCreate( link, messageFactory, connectionConfig, 50.0f, packetLoss, ackBits );
+    link.packetsPerUpdate = 8;
+    link.replyInterval = replyInterval;
+
+    Connection & sender = *link.side[0].connection;
+    Connection & receiver = *link.side[1].connection;
+
+    const int NumUpdates = 2000;
+    const double DeltaTime = 1.0 / 60.0;
+
+    uint64_t numReceived = 0;
+    uint16_t sequence = 0;
+
+    for ( int update = 0; update < NumUpdates; ++update )
+    {
+        while ( sender.CanSendMessage( 0 ) )
+        {
+            TestMessage * message = (TestMessage*) messageFactory.CreateMessage( TEST_MESSAGE );
+            yojimbo_assert( message );
+            message->sequence = sequence++;
+            sender.SendMessage( 0, message );
+        }
+
+        BenchLinkUpdate( link, DeltaTime );
+
+        while ( Message * received = receiver.ReceiveMessage( 0 ) )
+        {
+            numReceived++;
+            receiver.ReleaseMessage( received );
+        }
+    }
+
+    const uint64_t * counters = reliable_endpoint_counters( link.side[0].endpoint );
+    const uint64_t packetsSent = counters[RELIABLE_ENDPOINT_COUNTER_NUM_PACKETS_SENT];
+    const uint64_t packetsAcked = counters[RELIABLE_ENDPOINT_COUNTER_NUM_PACKETS_ACKED];
+
+    printf( "    %3d ack bits, reply every %2d updates, loss %4.1f%%: %5.1f%% of packets acked, %7.1f bytes sent per message delivered, %7d messages delivered\n",
+        ackBits, replyInterval, packetLoss, packetsSent ? packetsAcked * 100.0 / packetsSent : 0.0,
+        numReceived ? double( link.side[0].bytesSent ) / numReceived : 0.0, (int) numReceived );
+
+    BenchReport( packetsSent ? packetsAcked * 100.0 / packetsSent : 0.0, "%", BENCH_HIGHER_IS_BETTER, "%d ack bits, reply every %d updates, loss %.1f%%, packets acked",
+        ackBits, replyInterval, packetLoss );
+    BenchReport( numReceived ? double( link.side[0].bytesSent ) / numReceived : 0.0, "bytes/message", BENCH_LOWER_IS_BETTER, "%d ack bits, reply every %d updates, loss %.1f%%, bytes sent",
+        ackBits, replyInterval, packetLoss );
+
+    BenchLinkDestroy( link );
+}
+
+static void BenchAckWindow()
+{
+    printf( "\nack window (reliable-ordered stream, 8 packets per update at 60HZ, 50ms latency)\n\n" );
+
+#ifndef YOJIMBO_SYSTEM_DEPS
+    const int AckBits[] = { 32, 64, 128 };
+#else // #ifndef YOJIMBO_SYSTEM_DEPS
+    const int AckBits[] = { 32 };                               // a system reliable only has the 32 bit ack window
+#endif // #ifndef YOJIMBO_SYSTEM_DEPS
+    const int ReplyInterval[] = { 4, 12 };
+    const float PacketLoss[] = { 0.0f, 5.0f };
+
+    for ( int i = 0; i < (int) ( sizeof( PacketLoss ) / sizeof( PacketLoss[0] ) ); ++i )
+    {
+        for ( int j = 0; j < (int) ( sizeof( ReplyInterval ) / sizeof( ReplyInterval[0] ) ); ++j )
+        {
+            for ( int k = 0; k < (int) ( sizeof( AckBits ) / sizeof( AckBits[0] ) ); ++k )
+                BenchAckWindowStream( AckBits[k], ReplyInterval[j], PacketLoss[i] );
+        }
+    }
+}
+
+/*
+    Sequence buffers: the two per-packet sequence buffer kernels in isolation. Inserting with gaps clears
+    the skipped entries, and every packet sent writes ack bits generated from the received packets buffer.
+*/
+
+struct BenchSequenceEntry
+{
+    double time;
+    uint32_t data[3];
+};
+
+static volatile int BenchSequenceBufferSize = 1024;            // volatile so the buffer size is a runtime value, as it is in the channels
+
+static void BenchSequenceBufferInsert( int size, int gap )
+{
+    SequenceBuffer<BenchSequenceEntry> sequenceBuffer( GetDefaultAllocator(), size );
+
+    const int NumInserts = 4000000;
+
+    uint16_t sequence = 0;
+
+    const double start = yojimbo_time();
+    for ( int i = 0; i < NumInserts; ++i )
+    {
+        sequence += uint16_t( gap );
+        BenchSequenceEntry * entry = sequenceBuffer.Insert( sequence );
+        yojimbo_assert( entry );
+        entry->time = double( i );
+    }
+    const double seconds = yojimbo_time() - start;
+
+    printf( "    insert, %4d entries, gap %4d: %6.2f ns/insert\n", size, gap, seconds * 1000000000.0 / NumInserts );
+
+    BenchReport( seconds * 1000000000.0 / NumInserts, "ns/insert", BENCH_LOWER_IS_BETTER, "insert, %d entries, gap %d", size, gap );
+}
+
+struct BenchAckEndpoints
+{
+    reliable_endpoint_t * endpoint[2];
+    float packetLoss;
+};
+
+static void BenchAckTransmitPacket( void * context, uint64_t index, uint16_t packetSequence, uint8_t * packetData, int packetBytes )
+{
+    (void) packetSequence;
+    BenchAckEndpoints * endpoints = (BenchAckEndpoints*) context;
+    if ( index == 0 && yojimbo_random_float( 0.0f, 100.0f ) < endpoints->packetLoss )
+        return;
+    if ( index == 0 )
+        reliable_endpoint_receive_packet( endpoints->endpoint[1], packetData, packetBytes );
+}
+
+static int BenchAckProcessPacket( void * context, uint64_t index, uint16_t packetSequence, uint8_t * packetData, int packetBytes )
+{
+    (void) context;
+    (void) index;
+    (void) packetSequence;
+    (void) packetData;
+    (void) packetBytes;
+    return 1;
+}
+
+static void BenchAckBits( float packetLoss )
+{
+    BenchAckEndpoints endpoints;
+    endpoints.packetLoss = packetLoss;
+
+    for ( int i = 0; i < 2; ++i )
+    {
+        reliable_config_t reliable_config;
+        reliable_default_config( &reliable_config );
+        yojimbo_copy_string( reliable_config.name, i == 0 ? "bench sender" : "bench receiver", sizeof( reliable_config.name ) );
+        reliable_config.context = (void*) &endpoints;
+        reliable_config.id = i;
+        reliable_config.transmit_packet_function = BenchAckTransmitPacket;
+        reliable_config.process_packet_function = BenchAckProcessPacket;
+        endpoints.endpoint[i] = reliable_endpoint_create( &reliable_config, 100.0 );
+    }
+
+    const int NumPackets = 2000000;
+
+    uint8_t packetData[8];
+    memset( packetData, 0, sizeof( packetData ) );
+
+    double seconds = 0.0;
+
+    for ( int i = 0; i < NumPackets; ++i )
+    {
+        reliable_endpoint_send_packet( endpoints.endpoint[0], packetData, sizeof( packetData ) );
+
+        // Only the receiver's sends are timed. Each one generates ack bits from its received packets buffer.
+
+        const double start = yojimbo_time();
+        reliable_endpoint_send_packet( endpoints.endpoint[1], packetData, sizeof( packetData ) );
+        seconds += yojimbo_time() - start;
+    }
+
+    printf( "    ack bits, loss %4.1f%%: %6.2f ns/packet sent\n", packetLoss, seconds * 1000000000.0 / NumPackets );
+
+    BenchReport( seconds * 1000000000.0 / NumPackets, "ns/packet", BENCH_LOWER_IS_BETTER, "ack bits, loss %.1f%%", packetLoss );
+
+    reliable_endpoint_destroy( endpoints.endpoint[0] );
+    reliable_endpoint_destroy( endpoints.endpoint[1] );
+}
+
+static void BenchSequenceBuffers()
+{
+    printf( "\nsequence buffers\n\n" );
+
+    const int Gaps[] = { 1, 16, 256 };
+
+    for ( int i = 0; i < (int) ( sizeof( Gaps ) / sizeof( Gaps[0] ) ); ++i )
+        BenchSequenceBufferInsert( BenchSequenceBufferSize, Gaps[i] );
+
+    printf( "\n" );
+
+    const float PacketLoss[] = { 0.0f, 5.0f, 20.0f };
+
+    for ( int i = 0; i < (int) ( sizeof( PacketLoss ) / sizeof( PacketLoss[0] ) ); ++i )
+        BenchAckBits( PacketLoss[i] );
+}
+
+/*
+    Bitpacker: raw BitWriter / BitReader throughput on one core. Mixed width fields are the common case
+    for snapshots and message headers. Short byte runs follow an odd number of bits, so every one starts
+    part way through a word, which is how strings and small blocks land after a message header.
+*/
+
+static volatile int BenchBitpackerBytes = 64 * 1024;           // volatile so the buffer size is a runtime value, as it is for packets
+
+static void BenchBitpackerFields()
+{
+    const int bytes = BenchBitpackerBytes;
+    uint8_t * buffer = (uint8_t*) malloc( bytes );
+
+    const int NumIterations = 200;
+
+    // widths 1..32 in a fixed order, so each pass writes the same stream
+
+    int numFields = 0;
+    int64_t bitsPerPass = 0;
+    while ( bitsPerPass + 32 <= int64_t( bytes - 8 ) * 8 )
+    {
+        bitsPerPass += ( numFields % 32 ) + 1;
+        numFields++;
+    }
+
+    uint32_t checksum = 0;
+
+    const double writeStart = yojimbo_time();
+    for ( int iteration = 0; iteration < NumIterations; ++iteration )
+    {
+        BitWriter writer( buffer, bytes );
+        for ( int i = 0; i < numFields; ++i )
+        {
+            const int bits = ( i % 32 ) + 1;
+            writer.WriteBits( uint32_t( i + iteration ) & uint32_t( ( 1ULL << bits ) - 1 ), bits );
+        }
+        writer.FlushBits();
+    }
+    const double writeTime = yojimbo_time() - writeStart;
+
+    const double readStart = yojimbo_time();
+    for ( int iteration = 0; iteration < NumIterations; ++iteration )
+    {
+        BitReader reader( buffer, bytes );
+        for ( int i = 0; i < numFields; ++i )
+            checksum += reader.ReadBits( ( i % 32 ) + 1 );
+    }
+    const double readTime = yojimbo_time() - readStart;
+
+    const double megabytes = double( bitsPerPass ) / 8.0 * NumIterations / ( 1024.0 * 1024.0 );
+
+    printf( "    fields 1-32 bits:      write %7.1f MB/s, read %7.1f MB/s (checksum %08x)\n", megabytes / writeTime, megabytes / readTime, checksum );
+
+    BenchReport( megabytes / writeTime, "MB/s", BENCH_HIGHER_IS_BETTER, "fields 1-32 bits, write" );
+    BenchReport( megabytes / readTime, "MB/s", BENCH_HIGHER_IS_BETTER, "fields 1-32 bits, read" );
+
+    free( buffer );
+}
+
+static void BenchBitpackerByteRuns( int runBytes )
+{
+    const int bytes = BenchBitpackerBytes;
+    uint8_t * buffer = (uint8_t*) malloc( bytes );
+
+    uint8_t data[256];
+    for ( int i = 0; i < (int) sizeof( data ); ++i )
+        data[i] = uint8_t( i * 37 + 11 );
+
+    yojimbo_assert( runBytes <= (int) sizeof( data ) );
+
+    const int NumIterations = 200;
+
+    // each run is 3 header bits, an align, then the bytes. the header shifts the start offset within the word every run
+
+    const int bitsPerRun = 8 + runBytes * 8;
+    const int numRuns = ( bytes - 8 ) * 8 / bitsPerRun;
+
+    uint32_t checksum = 0;
+
+    const double writeStart = yojimbo_time();
+    for ( int iteration = 0; iteration < NumIterations; ++iteration )
+    {
+        BitWriter writer( buffer, bytes );
+        for ( int i = 0; i < numRuns; ++i )
+        {
+            writer.WriteBits( uint32_t( i & 7 ), 3 );
+            writer.WriteAlign();
+            writer.WriteBytes( data, runBytes );
+        }
+        writer.FlushBits();
+    }
+    const double writeTime = yojimbo_time() - writeStart;
+
+    uint8_t output[256];
+
+    const double readStart = yojimbo_time();
+    for ( int iteration = 0; iteration < NumIterations; ++iteration )
+    {
+        BitReader reader( buffer, bytes );
+        for ( int i = 0; i < numRuns; ++i )
+        {
+            checksum += reader.ReadBits( 3 );
+            reader.ReadAlign();
+            reader.ReadBytes( output, runBytes );
+            checksum += output[runBytes-1];
+        }
+    }
+    const double readTime = yojimbo_time() - readStart;
+
+    const double megabytes = double( numRuns ) * bitsPerRun / 8.0 * NumIterations / ( 1024.0 * 1024.0 );
+
+    printf( "    bytes, %3d byte runs:  write %7.1f MB/s, read %7.1f MB/s (checksum %08x)\n", runBytes, megabytes / writeTime, megabytes / readTime, checksum );
+
+    BenchReport( megabytes / writeTime, "MB/s", BENCH_HIGHER_IS_BETTER, "%d byte runs, write", runBytes );
+    BenchReport( megabytes / readTime, "MB/s", BENCH_HIGHER_IS_BETTER, "%d byte runs, read", runBytes );
+
+    free( buffer );
+}
+
+/*
+    Snapshot style payload: per entity positions and a ranged integer, serialized one value per macro or with the array macros.
+    Both write identical bits; the array macros size the field once and pack each run in one pass.
+*/
+
+const int BenchEntityCount = 256;
+
+struct BenchEntities
+{
+    int32_t ids[BenchEntityCount];
+    float position[BenchEntityCount*3];
+    int32_t health[BenchEntityCount];
+};
+
+template <typename Stream> bool BenchSerializeEntities( Stream & stream, BenchEntities & entities, bool arrays )
+{
+    if ( arrays )
+    {
+        serialize_sorted_int_array( stream, entities.ids, BenchEntityCount, 0, 65535 );
+        serialize_compressed_float_array( stream, entities.position, BenchEntityCount * 3, -1000.0f, 1000.0f, 0.01f );
+        serialize_int_array( stream, entities.health, BenchEntityCount, 0, 1000 );
+    }
+    else
+    {
+        for ( int i = 0; i < BenchEntityCount; ++i )
+        {
+            if ( i == 0 )
+                serialize_int( stream, entities.ids[i], 0, 65535 );
+            else
+                serialize_int_relative( stream, entities.ids[i-1], entities.ids[i] );
+        }
+        for ( int i = 0; i < BenchEntityCount * 3; ++i )
+            serialize_compressed_float( stream, entities.position[i], -1000.0f, 1000.0f, 0.01f );
+        for ( int i = 0; i < BenchEntityCount; ++i )
+            serialize_int( stream, entities.health[i], 0, 1000 );
+    }
+    return true;
+}
+
+static void BenchBitpackerArrays( bool arrays )
+{
+    BenchEntities entities;
+    int32_t id = 0;
+    for ( int i = 0; i < BenchEntityCount; ++i )
+    {
+        id += 1 + rand() % 8;
+        entities.ids[i] = id;
+        entities.health[i] = rand() % 1001;
+    }
+    for ( int i = 0; i < BenchEntityCount * 3; ++i )
+        entities.position[i] = yojimbo_random_float( -1000.0f, 1000.0f );
+
+    const int bytes = 8 * 1024;
+    uint8_t * buffer = (uint8_t*) malloc( bytes + 8 );          // + 8: read buffer allocations extend 8 bytes past the data
+    memset( buffer, 0, bytes + 8 );
+
+    const int NumIterations = 20000;
+
+    int64_t bytesWritten = 0;
+
+    const double writeStart = yojimbo_time();
+    for ( int iteration = 0; iteration < NumIterations; ++iteration )
+    {
+        WriteStream stream( buffer, bytes );
+        BenchSerializeEntities( stream, entities, arrays );
+        stream.Flush();
+        bytesWritten = stream.GetBytesProcessed();
+    }
+    const double writeTime = yojimbo_time() - writeStart;
+
+    BenchEntities readEntities;
+
+    const double readStart = yojimbo_time();
+    for ( int iteration = 0; iteration < NumIterations; ++iteration )
+    {
+        ReadStream stream( buffer, bytesWritten );
+        const bool result = BenchSerializeEntities( stream, readEntities, arrays );
+        yojimbo_assert( result );
+        (void) result;
+    }
+    const double readTime = yojimbo_time() - readStart;
+
+    yojimbo_assert( memcmp( readEntities.ids, entities.ids, sizeof( entities.ids ) ) == 0 );
+
+    const double measureStart = yojimbo_time();
+    int64_t bitsMeasured = 0;
+    for ( int iteration = 0; iteration < NumIterations; ++iteration )
+    {
+        MeasureStream stream;
+        BenchSerializeEntities( stream, entities, arrays );
+        bitsMeasured += stream.GetBitsProcessed();
+    }
+    const double measureTime = yojimbo_time() - measureStart;
+
+    printf( "    %d entities, %-6s %5d bytes: write %6.2f us, read %6.2f us, measure %6.3f us (%d bits)\n",
+        BenchEntityCount, arrays ? "arrays" : "loop", (int) bytesWritten,
+        writeTime * 1000000.0 / NumIterations, readTime * 1000000.0 / NumIterations, measureTime * 1000000.0 / NumIterations, (int) ( bitsMeasured / NumIterations ) );
+
+    BenchReport( writeTime * 1000000.0 / NumIterations, "us", BENCH_LOWER_IS_BETTER, "%d entities, %s, write", BenchEntityCount, arrays ? "arrays" : "loop" );
+    BenchReport( readTime * 1000000.0 / NumIterations, "us", BENCH_LOWER_IS_BETTER, "%d entities, %s, read", BenchEntityCount, arrays ? "arrays" : "loop" );
+    BenchReport( measureTime * 1000000.0 / NumIterations, "us", BENCH_LOWER_IS_BETTER, "%d entities, %s, measure", BenchEntityCount, arrays ? "arrays" : "loop" );
+
+    free( buffer );
+}
+
+static void BenchBitpacker()
+{
+    printf( "\nbitpacker (%dKB buffer)\n\n", BenchBitpackerBytes / 1024 );
+
+    BenchBitpackerFields();
+
+    const int RunBytes[] = { 3, 13, 29, 200 };
+
+    for ( int i = 0; i < (int) ( sizeof( RunBytes ) / sizeof( RunBytes[0] ) ); ++i )
+        BenchBitpackerByteRuns( RunBytes[i] );
+
+    printf( "\n" );
+
+    BenchBitpackerArrays( false );
+    BenchBitpackerArrays( true );
+}
+
+/*
+    Connection dispatch: a three channel connection (reliable-ordered, unreliable-unordered, reliable-ordered) exchanging a few small messages
+    per channel per packet over a lossless direct link. Times packet generation and processing on both ends, where Connection reaches its
+    channels through virtual calls and per-packet arrays sized for MaxChannels, and StaticConnection does neither.
+*/
+
+template <typename ConnectionType> static void BenchConnectionDispatch( const char * name )
+{
+    TestMessageFactory messageFactory( GetDefaultAllocator() );
+
+    ConnectionConfig connectionConfig;
+    connectionConfig.numChannels = 3;
+    connectionConfig.channel[0].type = CHANNEL_TYPE_RELIABLE_ORDERED;
+    connectionConfig.channel[1].type = CHANNEL_TYPE_UNRELIABLE_UNORDERED;
+    connectionConfig.channel[2].type = CHANNEL_TYPE_RELIABLE_ORDERED;
+    for ( int i = 0; i < connectionConfig.numChannels; ++i )
+        connectionConfig.channel[i].disableBlocks = true;
+
+    double time = 100.0;
+
+    ConnectionType * sender = YOJIMBO_NEW( GetDefaultAllocator(), ConnectionType, GetDefaultAllocator(), messageFactory, connectionConfig, time );
+    ConnectionType * receiver = YOJIMBO_NEW( GetDefaultAllocator(), ConnectionType, GetDefaultAllocator(), messageFactory, connectionConfig, time );
+
+    uint8_t * packetData = (uint8_t*) malloc( connectionConfig.maxPacketSize );
+
+    const int NumPackets = 50000;
+    const int MessagesPerChannel = 4;
+
+    uint64_t numReceived = 0;
+    uint64_t packetBytesTotal = 0;
+    double packetSeconds = 0.0;
+
+    for ( int packet = 0; packet < NumPackets; ++packet )
+    {
+        for ( int i = 0; i < connectionConfig.numChannels; ++i )
+        {
+            for ( int j = 0; j < MessagesPerChannel && sender->CanSendMessage( i ); ++j )
+            {
+                TestMessage * message = (TestMessage*) messageFactory.CreateMessage( TEST_MESSAGE );
+                yojimbo_assert( message );
+                message->sequence = uint16_t( packet );
+                sender->SendMessage( i, message );
+            }
+        }
+
+        const uint16_t sequence = uint16_t( packet );
+
+        const double start = yojimbo_time();
+
+        int packetBytes = 0;
+        if ( sender->GeneratePacket( NULL, sequence, packetData, connectionConfig.maxPacketSize, packetBytes ) && packetBytes > 0 )
+        {
+            receiver->ProcessPacket( NULL, sequence, packetData, packetBytes );
+            sender->ProcessAcks( &sequence, 1 );
+            packetBytesTotal += packetBytes;
+        }
+        if ( receiver->GeneratePacket( NULL, sequence, packetData, connectionConfig.maxPacketSize, packetBytes ) && packetBytes > 0 )
+        {
+            sender->ProcessPacket( NULL, sequence, packetData, packetBytes );
+            receiver->ProcessAcks( &sequence, 1 );
+        }
+
+        packetSeconds += yojimbo_time() - start;
+
+        time += 1.0 / 60.0;
+        sender->AdvanceTime( time );
+        receiver->AdvanceTime( time );
+
+        for ( int i = 0; i < connectionConfig.numChannels; ++i )
+        {
+            while ( Message * received = receiver->ReceiveMessage( i ) )
+            {
+                numReceived++;
+                receiver->ReleaseMessage( received );
+            }
+        }
+    }
+
+    printf( "    %-17s: %6.2f us/packet round trip, %5.1f bytes/packet, %9d messages delivered\n",
+        name, packetSeconds * 1000000.0 / NumPackets, double( packetBytesTotal ) / NumPackets, (int) numReceived );
+
+    BenchReport( packetSeconds * 1000000.0 / NumPackets, "us/packet", BENCH_LOWER_IS_BETTER, "%s, round trip", name );
+
+    free( packetData );
+    YOJIMBO_DELETE( GetDefaultAllocator(), ConnectionType, sender );
+    YOJIMBO_DELETE( GetDefaultAllocator(), ConnectionType, receiver );
+}
+
+static void BenchConnection()
+{
+    printf( "\nconnection dispatch (3 channels, 4 small messages per channel per packet, 60HZ)\n\n" );
+
+    typedef StaticConnection<ReliableOrderedChannel, UnreliableUnorderedChannel, ReliableOrderedChannel> BenchStaticConnection;
+
+    BenchConnectionDispatch<Connection>( "Connection" );
+    BenchConnectionDispatch<BenchStaticConnection>( "StaticConnection" );
+}
+
+/*
+    Reliable endpoint: one endpoint sending packets straight into another, which replies with a small packet to each, so both sides
+    are acking. Packets up to the fragment size go out whole, bigger ones are split into fragments and reassembled on receive.
+*/
+
+struct BenchReliableEndpoints
+{
+    reliable_endpoint_t * endpoint[2];
+};
+
+static void BenchReliableTransmitPacket( void * context, uint64_t index, uint16_t packetSequence, uint8_t * packetData, int packetBytes )
+{
+    (void) packetSequence;
+    BenchReliableEndpoints * endpoints = (BenchReliableEndpoints*) context;
+    reliable_endpoint_receive_packet( endpoints->endpoint[1 - index], packetData, packetBytes );
+}
+
+static void BenchReliableEndpoint( int packetBytes )
+{
+    BenchReliableEndpoints endpoints;
+
+    double time = 100.0;
+
+    for ( int i = 0; i < 2; ++i )
+    {
+        reliable_config_t reliable_config;
+        reliable_default_config( &reliable_config );
+        yojimbo_copy_string( reliable_config.name, i == 0 ? "bench sender" : "bench receiver", sizeof( reliable_config.name ) );
+        reliable_config.context = (void*) &endpoints;
+        reliable_config.id = i;
+        reliable_config.transmit_packet_function = BenchReliableTransmitPacket;
+        reliable_config.process_packet_function = BenchAckProcessPacket;
+        endpoints.endpoint[i] = reliable_endpoint_create( &reliable_config, time );
+    }
+
+    uint8_t * packetData = (uint8_t*) malloc( packetBytes );
+    for ( int i = 0; i < packetBytes; ++i )
+        packetData[i] = uint8_t( i );
+
+    uint8_t replyData[8];
+    memset( replyData, 0, sizeof( replyData ) );
+
+    const int NumPackets = 200000;
+
+    double sendSeconds = 0.0;
+    double updateSeconds = 0.0;
+
+    for ( int i = 0; i < NumPackets; ++i )
+    {
+        const double sendStart = yojimbo_time();
+        reliable_endpoint_send_packet( endpoints.endpoint[0], packetData, packetBytes );
+        reliable_endpoint_send_packet( endpoints.endpoint[1], replyData, sizeof( replyData ) );
+        sendSeconds += yojimbo_time() - sendStart;
+
+        time += 1.0 / 60.0;
+
+        // update recomputes rtt, jitter, loss and bandwidth over the whole history each call, so it is timed on its own
+
+        const double updateStart = yojimbo_time();
+        for ( int j = 0; j < 2; ++j )
+        {
+            reliable_endpoint_update( endpoints.endpoint[j], time );
+            reliable_endpoint_clear_acks( endpoints.endpoint[j] );
+        }
+        updateSeconds += yojimbo_time() - updateStart;
+    }
+
+    const uint64_t * counters = reliable_endpoint_counters( endpoints.endpoint[0] );
+    const uint64_t packetsAcked = counters[RELIABLE_ENDPOINT_COUNTER_NUM_PACKETS_ACKED];
+
+    printf( "    %5d byte packets: %7.1f ns to send, receive and reply, %7.1f ns to update both endpoints, %d/%d acked\n",
+        packetBytes, sendSeconds * 1000000000.0 / NumPackets, updateSeconds * 1000000000.0 / NumPackets, (int) packetsAcked, NumPackets );
+
+    BenchReport( sendSeconds * 1000000000.0 / NumPackets, "ns/packet", BENCH_LOWER_IS_BETTER, "%d byte packets, send, receive and reply", packetBytes );
+    BenchReport( updateSeconds * 1000000000.0 / NumPackets, "ns/packet", BENCH_LOWER_IS_BETTER, "%d byte packets, update", packetBytes );
+
+    free( packetData );
+
+    reliable_endpoint_destroy( endpoints.endpoint[0] );
+    reliable_endpoint_destroy( endpoints.endpoint[1] );
+}
+
+static void BenchReliable()
+{
+    printf( "\nreliable endpoint (direct link, 8 byte reply to every packet, 1024 byte fragments)\n\n" );
+
+    const int PacketBytes[] = { 64, 1024, 4096 };
+
+    for ( int i = 0; i < (int) ( sizeof( PacketBytes ) / sizeof( PacketBytes[0] ) ); ++i )
+        BenchReliableEndpoint( PacketBytes[i] );
+}
+
+/*
+    Netcode: the AEAD netcode seals every connected packet with, on a small and a full size payload, then the connect handshake
+    from connect token to connected between a netcode client and server over loopback sockets.
+*/
+
+static void BenchPacketCrypto( int bytes )
+{
+    uint8_t key[crypto_aead_chacha20poly1305_ietf_KEYBYTES];
+    uint8_t nonce[crypto_aead_chacha20poly1305_ietf_NPUBBYTES];
+    uint8_t additional[13+8+1];                                 // version info, protocol id and prefix byte, as netcode binds to each packet
+
+    netcode_random_bytes( key, sizeof( key ) );
+    memset( nonce, 0, sizeof( nonce ) );
+    memset( additional, 0, sizeof( additional ) );
+
+    const int encryptedBytes = bytes + crypto_aead_chacha20poly1305_ietf_ABYTES;
+    uint8_t * packet = (uint8_t*) malloc( encryptedBytes );
+    uint8_t * decrypted = (uint8_t*) malloc( bytes );
+    for ( int i = 0; i < bytes; ++i )
+        packet[i] = uint8_t( i );
+
+    const int NumPackets = 200000;
+
+    unsigned long long length = 0;
+
+    // netcode encrypts in place with the packet sequence in the nonce
+
+    const double encryptStart = yojimbo_time();
+    for ( int i = 0; i < NumPackets; ++i )
+    {
+        const uint64_t sequence = uint64_t( i );
+        memcpy( nonce + 4, &sequence, sizeof( sequence ) );
+        crypto_aead_chacha20poly1305_ietf_encrypt( packet, &length, packet, bytes, additional, sizeof( additional ), NULL, nonce, key );
+    }
+    const double encryptTime = yojimbo_time() - encryptStart;
+
+    int failures = 0;
+
+    const double decryptStart = yojimbo_time();
+    for ( int i = 0; i < NumPackets; ++i )
+        failures += crypto_aead_chacha20poly1305_ietf_decrypt( decrypted, &length, NULL, packet, encryptedBytes, additional, sizeof( additional ), nonce, key ) != 0;
+    const double decryptTime = yojimbo_time() - decryptStart;
+
+    yojimbo_assert( failures == 0 );
+
+    printf( "    %4d byte packets: encrypt %6.2f us, decrypt %6.2f us (%d failures)\n",
+        bytes, encryptTime * 1000000.0 / NumPackets, decryptTime * 1000000.0 / NumPackets, failures );
+
+    BenchReport( encryptTime * 1000000.0 / NumPackets, "us/packet", BENCH_LOWER_IS_BETTER, "%d byte packets, encrypt", bytes );
+    BenchReport( decryptTime * 1000000.0 / NumPackets, "us/packet", BENCH_LOWER_IS_BETTER, "%d byte packets, decrypt", bytes );
+
+    free( packet );
+    free( decrypted );
+}
+
+static void BenchHandshake()
+{
+    const uint64_t ProtocolId = 0x1122334455667788ULL;
+
+    char serverAddress[64];
+    snprintf( serverAddress, sizeof( serverAddress ), "127.0.0.1:%d", ServerPort );
+
+    double time = 100.0;
+
+    struct netcode_server_config_t serverConfig;
+    netcode_default_server_config( &serverConfig );
+    serverConfig.protocol_id = ProtocolId;
+    netcode_random_bytes( serverConfig.private_key, NETCODE_KEY_BYTES );
+
+    struct netcode_server_t * server = netcode_server_create( serverAddress, &serverConfig, time );
+    if ( !server )
+    {
+        printf( "    handshake: failed to create server\n" );
+        return;
+    }
+
+    netcode_server_start( server, 1 );
+
+    struct netcode_client_config_t clientConfig;
+    netcode_default_client_config( &clientConfig );
+
+    const int NumHandshakes = 200;
+
+    uint8_t connectToken[NETCODE_CONNECT_TOKEN_BYTES];
+    uint8_t userData[NETCODE_USER_DATA_BYTES];
+    memset( userData, 0, sizeof( userData ) );
+
+    NETCODE_CONST char * serverAddresses[] = { serverAddress };
+
+    double tokenSeconds = 0.0;
+    double handshakeSeconds = 0.0;
+    int numConnected = 0;
+    int numUpdates = 0;
+
+    for ( int i = 0; i < NumHandshakes; ++i )
+    {
+        struct netcode_client_t * client = netcode_client_create( "0.0.0.0", &clientConfig, time );
+        if ( !client )
+            break;
+
+        const double tokenStart = yojimbo_time();
+        const int result = netcode_generate_connect_token( 1, serverAddresses, serverAddresses, 30, 5, 1 + i, ProtocolId, serverConfig.private_key, userData, connectToken );
+        tokenSeconds += yojimbo_time() - tokenStart;
+        yojimbo_assert( result == NETCODE_OK );
+        (void) result;
+
+        // each update steps time past the 10HZ resend interval, so a lost or late packet costs one more update, not real time
+
+        const double handshakeStart = yojimbo_time();
+
+        netcode_client_connect( client, connectToken );
+
+        for ( int update = 0; update < 100 && netcode_client_state( client ) > NETCODE_CLIENT_STATE_DISCONNECTED && netcode_client_state( client ) != NETCODE_CLIENT_STATE_CONNECTED; ++update )
+        {
+            time += 0.1;
+            netcode_client_update( client, time );
+            netcode_server_update( server, time );
+            numUpdates++;
+        }
+
+        if ( netcode_client_state( client ) == NETCODE_CLIENT_STATE_CONNECTED )
+        {
+            handshakeSeconds += yojimbo_time() - handshakeStart;
+            numConnected++;
+        }
+
+        netcode_server_disconnect_all_clients( server );
+        netcode_client_destroy( client );
+    }
+
+    netcode_server_destroy( server );
+
+    if ( numConnected == 0 )
+    {
+        printf( "    handshake: no client connected\n" );
+        return;
+    }
+
+    printf( "    handshake: connect token %6.2f us, token to connected %6.1f us, %.1f updates each, %d/%d connected\n",
+        tokenSeconds * 1000000.0 / NumHandshakes, handshakeSeconds * 1000000.0 / numConnected, double( numUpdates ) / NumHandshakes, numConnected, NumHandshakes );
+
+    BenchReport( tokenSeconds * 1000000.0 / NumHandshakes, "us", BENCH_LOWER_IS_BETTER, "generate connect token" );
+    BenchReport( handshakeSeconds * 1000000.0 / numConnected, "us", BENCH_LOWER_IS_BETTER, "handshake, token to connected" );
+}
+
+static void BenchNetcode()
+{
+    printf( "\nnetcode (chacha20-poly1305 packet encryption, loopback handshake)\n\n" );
+
+    BenchPacketCrypto( 64 );
+    BenchPacketCrypto( 1200 );
+
+    printf( "\n" );
+
+    BenchHandshake();
+}
+
+/*
+    Message churn: create a batch of messages, interleaving two types, and release them in a scrambled order, as a channel does when
+    messages are acked out of order. Compares the factory allocating each message on a TLSF heap with per-type message pools.
+*/
+
+static void BenchMessageChurn( bool pools )
+{
+    const int HeapBytes = 4 * 1024 * 1024;
+    void * heap = malloc( HeapBytes );
+    TLSF_Allocator allocator( heap, HeapBytes );
+
+    {
+        TestMessageFactory messageFactory( allocator );
+        if ( pools )
+            messageFactory.EnableMessagePools( 0, 64 );
+
+        const int BatchSize = 256;
+        const int NumBatches = 4000;
+
+        Message * messages[BatchSize];
+
+        const double start = yojimbo_time();
+
+        for ( int batch = 0; batch < NumBatches; ++batch )
+        {
+            for ( int i = 0; i < BatchSize; ++i )
+            {
+                messages[i] = messageFactory.CreateMessage( ( i % 4 ) == 3 ? TEST_BLOCK_MESSAGE : TEST_MESSAGE );
+                yojimbo_assert( messages[i] );
+            }
+            // 97 is coprime with the batch size, so this visits every message once
+            for ( int i = 0; i < BatchSize; ++i )
+                messageFactory.ReleaseMessage( messages[( i * 97 + batch ) % BatchSize] );
+        }
+
+        const double seconds = yojimbo_time() - start;
+
+        printf( "    %-12s: %6.1f ns per create and release\n", pools ? "pools" : "TLSF heap", seconds * 1000000000.0 / ( double( NumBatches ) * BatchSize ) );
+
+        BenchReport( seconds * 1000000000.0 / ( double( NumBatches ) * BatchSize ), "ns", BENCH_LOWER_IS_BETTER, "%s, create and release", pools ? "pools" : "TLSF heap" );
+
+        MessagePoolStats stats;
+        if ( messageFactory.GetMessagePoolStats( TEST_MESSAGE, stats ) )
+        {
+            printf( "    %-12s  %d blocks of %d bytes, high water %d, %" PRIu64 " hits, %" PRIu64 " misses\n",
+                "", stats.capacity, stats.blockSize, stats.highWater, stats.hits, stats.misses );
+        }
+    }
+
+    free( heap );
+}
+
+static void BenchMessagePool()
+{
+    printf( "\nmessage churn (batches of 256 messages, released out of order)\n\n" );
+
+    BenchMessageChurn( false );
+    BenchMessageChurn( true );
+}
+
+/*
+    Small allocations, in the sizes and lifetimes a packet leaves behind: pointer arrays, channel packet data and serialize scratch,
+    freed a few packets later, with the odd packet sized buffer mixed in. Compares TLSF with the slab cache in front of it.
+*/
+
+static void BenchAllocatorChurn( const char * name, Allocator & allocator )
+{
+    static const int Sizes[] = { 24, 64, 120, 8, 40, 200, 16, 96, 1200, 32, 48, 256 };
+    const int NumSizes = (int) ( sizeof( Sizes ) / sizeof( Sizes[0] ) );
+
+    const int Window = 64;
+    const int NumAllocations = 2000000;
+
+    void * live[Window];
+    memset( live, 0, sizeof( live ) );
+
+    const double start = yojimbo_time();
+
+    for ( int i = 0; i < NumAllocations; ++i )
+    {
+        // each allocation lives for Window allocations, then is freed to make room for the next
+        const int slot = i % Window;
+        YOJIMBO_FREE( allocator, live[slot] );
+        live[slot] = YOJIMBO_ALLOCATE( allocator, Sizes[( i * 7 ) % NumSizes] );
+        yojimbo_assert( live[slot] );
+    }
+
+    const double seconds = yojimbo_time() - start;
+
+    for ( int i = 0; i < Window; ++i )
+        YOJIMBO_FREE( allocator, live[i] );
+
+    printf( "    %-12s: %6.1f ns per allocate and free\n", name, seconds * 1000000000.0 / NumAllocations );
+
+    BenchReport( seconds * 1000000000.0 / NumAllocations, "ns", BENCH_LOWER_IS_BETTER, "%s, allocate and free", name );
+}
+
+class BenchSlabAdapter : public TestAdapter
+{
+public:
+
+    Allocator * CreateAllocator( Allocator & allocator, void * memory, size_t bytes )
+    {
+        return YOJIMBO_NEW( allocator, TLSF_SlabAllocator, memory, bytes );
+    }
+};
+
+/*
+    Full stack: clients and a server exchanging messages both ways over loopback sockets, through netcode, the reliable endpoints
+    and the connection, with the client and per-client heaps created by the adapter. Message pools are off, so messages hit the heap too.
+*/
+
+static void BenchClientServerThroughput( const char * name, Adapter & benchAdapter, int numClients = 1 )
+{
+    yojimbo_assert( numClients >= 1 );
+    yojimbo_assert( numClients <= MaxClients );
+
+    const double DeltaTime = 1.0 / 60.0;
+    double time = 100.0;
+
+    ClientServerConfig config;
+    config.messagePoolGrowSize = 0;
+    config.timeout = -1;
+
+    uint8_t privateKey[KeyBytes];
+    memset( privateKey, 0, KeyBytes );
+
+    Address serverAddress( "127.0.0.1", ServerPort );
+
+    Server server( GetDefaultAllocator(), privateKey, serverAddress, config, benchAdapter, time );
+    server.Start( numClients );
+
+    Client ** clients = (Client**) alloca( sizeof( Client* ) * numClients );
+    for ( int i = 0; i < numClients; ++i )
+    {
+        clients[i] = YOJIMBO_NEW( GetDefaultAllocator(), Client, GetDefaultAllocator(), Address( "0.0.0.0", ClientPort + i ), config, benchAdapter, time );
+        clients[i]->InsecureConnect( privateKey, 1 + i, serverAddress );
+    }
+
+    int numConnected = 0;
+
+    for ( int iteration = 0; iteration < 1000 && numConnected < numClients; ++iteration )
+    {
+        for ( int i = 0; i < numClients; ++i )
+            clients[i]->SendPackets();
+        server.SendPackets();
+        for ( int i = 0; i < numClients; ++i )
+            clients[i]->ReceivePackets();
+        server.ReceivePackets();
+        time += DeltaTime;
+        numConnected = 0;
+        for ( int i = 0; i < numClients; ++i )
+        {
+            clients[i]->AdvanceTime( time );
+            numConnected += clients[i]->IsConnected() ? 1 : 0;
+        }
+        server.AdvanceTime( time );
+        yojimbo_sleep( 0.001 );
+    }
+
+    if ( numConnected == numClients )
+    {
+        // the same total work for every client count, so the time per message is comparable across them
+
+        const int NumUpdates = yojimbo_max( 1000, 20000 / numClients );
+        const int MessagesPerChannel = 4;
+
+        uint64_t numReceived = 0;
+
+        const double start = yojimbo_time();
+
+        for ( int update = 0; update < NumUpdates; ++update )
+        {
+            for ( int i = 0; i < numClients; ++i )
+            {
+                Client & client = *clients[i];
+                const int clientIndex = client.GetClientIndex();
+
+                for ( int channel = 0; channel < config.numChannels; ++channel )
+                {
+                    for ( int j = 0; j < MessagesPerChannel; ++j )
+                    {
+                        if ( client.CanSendMessage( channel ) )
+                        {
+                            TestMessage * message = (TestMessage*) client.CreateMessage( TEST_MESSAGE );
+                            if ( message )
+                            {
+                                message->sequence = uint16_t( update );
+                                client.SendMessage( channel, message );
+                            }
+                        }
+                        if ( server.CanSendMessage( clientIndex, channel ) )
+                        {
+                            TestMessage * message = (TestMessage*) server.CreateMessage( clientIndex, TEST_MESSAGE );
+                            if ( message )
+                            {
+                                message->sequence = uint16_t( update );
+                                server.SendMessage( clientIndex, channel, message );
+                            }
+                        }
+                    }
+                }
+            }
+
+            for ( int i = 0; i < numClients; ++i )
+                clients[i]->SendPackets();
+            server.SendPackets();
+            for ( int i = 0; i < numClients; ++i )
+                clients[i]->ReceivePackets();
+            server.ReceivePackets();
+
+            time += DeltaTime;
+            for ( int i = 0; i < numClients; ++i )
+                clients[i]->AdvanceTime( time );
+            server.AdvanceTime( time );
+
+            for ( int i = 0; i < numClients; ++i )
+            {
+                Client & client = *clients[i];
+                const int clientIndex = client.GetClientIndex();
+
+                for ( int channel = 0; channel < config.numChannels; ++channel )
+                {
+                    while ( Message * message = client.ReceiveMessage( channel ) )
+                    {
+                        numReceived++;
+                        client.ReleaseMessage( message );
+                    }
+                    while ( Message * message = server.ReceiveMessage( clientIndex, channel ) )
+                    {
+                        numReceived++;
+                        server.ReleaseMessage( clientIndex, message );
+                    }
+                }
+            }
+        }
+
+        const double seconds = yojimbo_time() - start;
+
+        printf( "    %-12s: %2d client(s), %8.2f us per update, %6.0f packets/sec each way, %9.0f messages/sec, %9d messages delivered\n",
+            name, numClients, seconds * 1000000.0 / NumUpdates, NumUpdates * numClients / seconds, numReceived / seconds, (int) numReceived );
+
+        BenchReport( seconds * 1000000.0 / NumUpdates, "us/update", BENCH_LOWER_IS_BETTER, "%s, %d client(s), update", name, numClients );
+        BenchReport( numReceived / seconds, "messages/sec", BENCH_HIGHER_IS_BETTER, "%s, %d client(s), messages delivered", name, numClients );
+    }
+    else
+    {
+        printf( "    %-12s: %2d client(s), only %d connected\n", name, numClients, numConnected );
+    }
+
+    for ( int i = 0; i < numClients; ++i )
+    {
+        clients[i]->Disconnect();
+        YOJIMBO_DELETE( GetDefaultAllocator(), Client, clients[i] );
+    }
+
+    server.Stop();
+}
+
+static void BenchAllocator()
+{
+    printf( "\nallocator churn (small allocations, each freed 64 allocations later)\n\n" );
+
+    const int HeapBytes = 4 * 1024 * 1024;
+    void * heap = malloc( HeapBytes );
+
+    {
+        TLSF_Allocator allocator( heap, HeapBytes );
+        BenchAllocatorChurn( "TLSF", allocator );
+    }
+
+    {
+        TLSF_SlabAllocator allocator( heap, HeapBytes );
+        BenchAllocatorChurn( "TLSF + slabs", allocator );
+    }
+
+    free( heap );
+
+    printf( "\nclient/server throughput (loopback sockets, 2 channels, 4 messages per channel each way per update, pools off)\n\n" );
+
+    BenchSlabAdapter slabAdapter;
+
+    BenchClientServerThroughput( "TLSF", adapter );
+    BenchClientServerThroughput( "TLSF + slabs", slabAdapter );
+}
+
+static void BenchClientServer()
+{
+    printf( "\nclient/server throughput (loopback sockets, 2 channels, 4 messages per channel each way per client per update, pools off)\n\n" );
+
+    const int NumClients[] = { 1, 8, 64 };
+
+    for ( int i = 0; i < (int) ( sizeof( NumClients ) / sizeof( NumClients[0] ) ); ++i )
+        BenchClientServerThroughput( "default", adapter, NumClients[i] );
+}
+
+/*
+    Loopback: a listen server and a client in the same process exchanging messages both ways. The regular loopback client sends them
+    through the connection, the reliable endpoints and netcode, with the adapter handing each packet across. The direct loopback client
+    hands the messages themselves across, with no packets at all.
+*/
+
+class BenchLoopbackAdapter : public TestAdapter
+{
+public:
+
+    Client * client;
+    Server * server;
+
+    BenchLoopbackAdapter()
+    {
+        client = NULL;
+        server = NULL;
+    }
+
+    void ClientSendLoopbackPacket( int clientIndex, const uint8_t * packetData, int packetBytes, uint64_t packetSequence )
+    {
+        server->ProcessLoopbackPacket( clientIndex, packetData, packetBytes, packetSequence );
+    }
+
+    void ServerSendLoopbackPacket( int clientIndex, const uint8_t * packetData, int packetBytes, uint64_t packetSequence )
+    {
+        (void) clientIndex;
+        client->ProcessLoopbackPacket( packetData, packetBytes, packetSequence );
+    }
+};
+
+static void BenchLoopbackThroughput( const char * name, bool direct, int blockBytes )
+{
+    const double DeltaTime = 1.0 / 60.0;
+    double time = 100.0;
+
+    ClientServerConfig config;
+    config.timeout = -1;
+
+    uint8_t privateKey[KeyBytes];
+    memset( privateKey, 0, KeyBytes );
+
+    BenchLoopbackAdapter loopbackAdapter;
+
+    Server server( GetDefaultAllocator(), privateKey, Address( "127.0.0.1", ServerPort ), config, loopbackAdapter, time );
+    server.Start( 1 );
+
+    Client client( GetDefaultAllocator(), Address( "0.0.0.0", ClientPort ), config, loopbackAdapter, time );
+
+    loopbackAdapter.client = &client;
+    loopbackAdapter.server = &server;
+
+    server.ConnectLoopbackClient( 0, 1, NULL );
+
+    if ( direct )
+        client.ConnectDirectLoopback( server, 0 );
+    else
+        client.ConnectLoopback( 0, 1, 1 );
+
+    const int NumUpdates = 20000;
+    const int MessagesPerChannel = 8;
+
+    uint64_t numReceived = 0;
+
+    const double start = yojimbo_time();
+
+    for ( int update = 0; update < NumUpdates; ++update )
+    {
+        for ( int channel = 0; channel < config.numChannels; ++channel )
+        {
+            for ( int j = 0; j < MessagesPerChannel; ++j )
+            {
+                if ( client.CanSendMessage( channel ) )
+                {
+                    if ( blockBytes > 0 )
+                    {
+                        TestBlockMessage * message = (TestBlockMessage*) client.CreateMessage( TEST_BLOCK_MESSAGE );
+                        uint8_t * block = client.AllocateBlock( blockBytes );
+                        memset( block, j, blockBytes );
+                        client.AttachBlockToMessage( message, block, blockBytes );
+                        client.SendMessage( channel, message );
+                    }
+                    else
+                    {
+                        TestMessage * message = (TestMessage*) client.CreateMessage( TEST_MESSAGE );
+                        message->sequence = uint16_t( update );
+                        client.SendMessage( channel, message );
+                    }
+                }
+                if ( server.CanSendMessage( 0, channel ) )
+                {
+                    if ( blockBytes > 0 )
+                    {
+                        TestBlockMessage * message = (TestBlockMessage*) server.CreateMessage( 0, TEST_BLOCK_MESSAGE );
+                        uint8_t * block = server.AllocateBlock( 0, blockBytes );
+                        memset( block, j, blockBytes );
+                        server.AttachBlockToMessage( 0, message, block, blockBytes );
+                        server.SendMessage( 0, channel, message );
+                    }
+                    else
+                    {
+                        TestMessage * message = (TestMessage*) server.CreateMessage( 0, TEST_MESSAGE );
+                        message->sequence = uint16_t( update );
+                        server.SendMessage( 0, channel, message );
+                    }
+                }
+            }
+        }
+
+        client.SendPackets();
+        server.SendPackets();
+        client.ReceivePackets();
+        server.ReceivePackets();
+
+        time += DeltaTime;
+        client.AdvanceTime( time );
+        server.AdvanceTime( time );
+
+        for ( int channel = 0; channel < config.numChannels; ++channel )
+        {
+            while ( Message * message = client.ReceiveMessage( channel ) )
+            {
+                numReceived++;
+                client.ReleaseMessage( message );
+            }
+            while ( Message * message = server.ReceiveMessage( 0, channel ) )
+            {
+                numReceived++;
+                server.ReleaseMessage( 0, message );
+            }
+        }
+    }
+
+    const double seconds = yojimbo_time() - start;
+
+    const double messagesPerSecond = numReceived / seconds;
+    const double nsPerMessage = seconds * 1000000000.0 / yojimbo_max( numReceived, (uint64_t) 1 );
+
+    printf( "    %-28s: %8.2f us per update, %10.0f messages/sec, %7.1f ns per message, %9d messages delivered\n",
+        name, seconds * 1000000.0 / NumUpdates, messagesPerSecond, nsPerMessage, (int) numReceived );
+
+    BenchReport( messagesPerSecond, "messages/sec", BENCH_HIGHER_IS_BETTER, "%s, messages delivered", name );
+    BenchReport( nsPerMessage, "ns", BENCH_LOWER_IS_BETTER, "%s, per message", name );
+
+    client.DisconnectLoopback();
+    server.DisconnectLoopbackClient( 0 );
+    server.Stop();
+}
+
+static void BenchLoopback()
+{
+    printf( "\nloopback client on a listen server (2 channels, 8 messages per channel each way per update)\n\n" );
+
+    BenchLoopbackThroughput( "packets, messages", false, 0 );
+    BenchLoopbackThroughput( "direct, messages", true, 0 );
+    BenchLoopbackThroughput( "packets, 256 byte blocks", false, 256 );
+    BenchLoopbackThroughput( "direct, 256 byte blocks", true, 256 );
+}
+
+/*
+    Server heaps: 64 heaps of 10MB, as a full server has, with allocations and frees landing on random heaps at random offsets,
+    the way TLSF spreads a busy server's packets and messages. Compares heaps from malloc with heaps mapped with huge pages.
+*/
+
+static void BenchServerHeaps( const char * name, bool mapped, bool hugePages )
+{
+    const int NumHeaps = 64;
+    const size_t HeapBytes = 10 * 1024 * 1024;
+    const int LivePerHeap = 512;
+    const int NumOperations = 4000000;
+
+    uint8_t * memory[NumHeaps];
+    TLSF_Allocator * heap[NumHeaps];
+    uint8_t ** live = (uint8_t**) calloc( NumHeaps * LivePerHeap, sizeof( uint8_t* ) );
+
+    const int numaNode = yojimbo_memory_numa_node();
+
+    for ( int i = 0; i < NumHeaps; ++i )
+    {
+        memory[i] = mapped ? (uint8_t*) yojimbo_memory_map( HeapBytes, hugePages, numaNode ) : (uint8_t*) malloc( HeapBytes );
+        yojimbo_assert( memory[i] );
+        heap[i] = YOJIMBO_NEW( GetDefaultAllocator(), TLSF_Allocator, memory[i], HeapBytes );
+    }
+
+    uint32_t seed = 12345;
+
+    // the first pass fills the heaps and takes the page faults. the second is timed
+
+    double seconds = 0.0;
+
+    for ( int pass = 0; pass < 2; ++pass )
+    {
+        const double start = yojimbo_time();
+
+        for ( int i = 0; i < NumOperations; ++i )
+        {
+            seed = seed * 1664525 + 1013904223;
+            const int h = ( seed >> 8 ) % NumHeaps;
+            const int slot = h * LivePerHeap + ( seed >> 16 ) % LivePerHeap;
+            YOJIMBO_FREE( *heap[h], live[slot] );
+            const int bytes = 64 + ( seed & 0x7FF );
+            live[slot] = (uint8_t*) YOJIMBO_ALLOCATE( *heap[h], bytes );
+            yojimbo_assert( live[slot] );
+            live[slot][0] = uint8_t( i );
+            live[slot][bytes - 1] = uint8_t( i );
+        }
+
+        seconds = yojimbo_time() - start;
+    }
+
+    size_t resident = 0;
+    for ( int i = 0; i < NumHeaps; ++i )
+        resident += yojimbo_memory_resident( memory[i], HeapBytes );
+
+    printf( "    %-12s: %6.1f ns per allocate, touch and free, %6.1fMB resident\n", name, seconds * 1000000000.0 / NumOperations, resident / ( 1024.0 * 1024.0 ) );
+
+    BenchReport( seconds * 1000000000.0 / NumOperations, "ns", BENCH_LOWER_IS_BETTER, "%s, allocate, touch and free", name );
+
+    for ( int i = 0; i < NumHeaps; ++i )
+    {
+        for ( int j = 0; j < LivePerHeap; ++j )
+            YOJIMBO_FREE( *heap[i], live[i * LivePerHeap + j] );
+        YOJIMBO_DELETE( GetDefaultAllocator(), TLSF_Allocator, heap[i] );
+        if ( mapped )
+            yojimbo_memory_release( memory[i], HeapBytes );
+        else
+            free( memory[i] );
+    }
+
+    free( live );
+}
+
+static void BenchHugePages()
+{
+    printf( "\nserver heaps (64 heaps of 10MB, random heap and offset per allocation, numa node %d)\n\n", yojimbo_memory_numa_node() );
+
+    BenchServerHeaps( "malloc", false, false );
+    BenchServerHeaps( "mapped", true, false );
+    BenchServerHeaps( "huge pages", true, true );
+}
+
+/*
+    Tracing: the cost of recording one event on the calling thread, then a traced client/server run dumped to trace.json
+    so it can be opened in Perfetto or chrome://tracing. Only does anything when built with -DYOJIMBO_TRACING=ON.
+*/
+
+static void BenchTrace()
+{
+#if YOJIMBO_ENABLE_TRACING
+    printf( "\ntrace (%d events per thread buffer)\n\n", YOJIMBO_TRACE_BUFFER_EVENTS );
+
+    const int NumPairs = 1000000;
+
+    yojimbo_trace_reset();
+
+    const double start = yojimbo_time();
+
+    for ( int i = 0; i < NumPairs; ++i )
+    {
+        yojimbo_trace_begin( "bench" );
+        yojimbo_trace_end( "bench" );
+    }
+
+    const double seconds = yojimbo_time() - start;
+
+    printf( "    %-12s: %6.1f ns per event\n", "record", seconds * 1000000000.0 / ( NumPairs * 2 ) );
+
+    BenchReport( seconds * 1000000000.0 / ( NumPairs * 2 ), "ns", BENCH_LOWER_IS_BETTER, "record event" );
+
+    yojimbo_trace_reset();
+
+    BenchClientServerThroughput( "traced", adapter );
+
+    if ( yojimbo_trace_write( "trace.json" ) )
+        printf( "\n    wrote trace.json\n" );
+#else // #if YOJIMBO_ENABLE_TRACING
+    printf( "\ntrace\n\n    tracing is compiled out. configure with -DYOJIMBO_TRACING=ON\n" );
+#endif // #if YOJIMBO_ENABLE_TRACING
+}
+
+struct Benchmark
+{
+    const char * name;
+    void (*function)();
+};
+
+static int BenchLogSink( const char * format, ... )
+{
+    (void) format;
+    return 0;
+}
+
+static void BenchLogging()
+{
+    printf( "\nlogging (an error message with a string and three ints)\n\n" );
+
+#if YOJIMBO_ENABLE_LOGGING
+    const int NumMessages = 1000000;
+
+    const char * address = "192.168.100.200:40000";
+
+    yojimbo_log_level( YOJIMBO_LOG_LEVEL_ERROR );
+
+    // formatted as it is logged: the default path, with output thrown away
+
+    yojimbo_set_printf_function( BenchLogSink );
+
+    double start = yojimbo_time();
+    for ( int i = 0; i < NumMessages; ++i )
+        yojimbo_printf( YOJIMBO_LOG_LEVEL_ERROR, "error: ignored packet from %s. sequence %d is stale (expected %d or later, type %d)\n", address, i, i + 256, i & 7 );
+    const double formatSeconds = yojimbo_time() - start;
+
+    // recorded in the binary log, with the rate limit off so every message is kept. Flushes between batches are timed separately
+
+    yojimbo_set_printf_function( yojimbo_binary_log_printf );
+    yojimbo_binary_log_rate_limit( 0, 0.0 );
+    yojimbo_binary_log_flush( BenchLogSink );
+
+    double recordSeconds = 0.0;
+    double flushSeconds = 0.0;
+    for ( int i = 0; i < NumMessages; i += YOJIMBO_BINARY_LOG_BUFFER_MESSAGES )
+    {
+        start = yojimbo_time();
+        for ( int j = 0; j < YOJIMBO_BINARY_LOG_BUFFER_MESSAGES; ++j )
+            yojimbo_printf( YOJIMBO_LOG_LEVEL_ERROR, "error: ignored packet from %s. sequence %d is stale (expected %d or later, type %d)\n", address, i + j, i + j + 256, j & 7 );
+        const double middle = yojimbo_time();
+        yojimbo_binary_log_flush( BenchLogSink );
+        recordSeconds += middle - start;
+        flushSeconds += yojimbo_time() - middle;
+    }
+    const int numRecorded = ( ( NumMessages + YOJIMBO_BINARY_LOG_BUFFER_MESSAGES - 1 ) / YOJIMBO_BINARY_LOG_BUFFER_MESSAGES ) * YOJIMBO_BINARY_LOG_BUFFER_MESSAGES;
+
+    // the same message repeated under attack: the rate limit keeps 16 a second and discards the rest
+
+    yojimbo_binary_log_rate_limit( 16, 1.0 );
+
+    start = yojimbo_time();
+    for ( int i = 0; i < NumMessages; ++i )
+        yojimbo_printf( YOJIMBO_LOG_LEVEL_ERROR, "error: ignored packet from %s. sequence %d is stale (expected %d or later, type %d)\n", address, i, i + 256, i & 7 );
+    const double limitedSeconds = yojimbo_time() - start;
+
+    yojimbo_binary_log_flush( BenchLogSink );
+    yojimbo_set_printf_function( printf );
+    yojimbo_log_level( YOJIMBO_LOG_LEVEL_NONE );
+
+    const double formatNs = formatSeconds * 1000000000.0 / NumMessages;
+    const double recordNs = recordSeconds * 1000000000.0 / numRecorded;
+    const double flushNs = flushSeconds * 1000000000.0 / numRecorded;
+    const double limitedNs = limitedSeconds * 1000000000.0 / NumMessages;
+
+    printf( "    %-28s: %6.1f ns per message\n", "formatted when logged", formatNs );
+    printf( "    %-28s: %6.1f ns per message\n", "binary log, record", recordNs );
+    printf( "    %-28s: %6.1f ns per message\n", "binary log, flush", flushNs );
+    printf( "    %-28s: %6.1f ns per message\n", "binary log, rate limited", limitedNs );
+
+    BenchReport( formatNs, "ns", BENCH_LOWER_IS_BETTER, "formatted when logged" );
+    BenchReport( recordNs, "ns", BENCH_LOWER_IS_BETTER, "binary log record" );
+    BenchReport( flushNs, "ns", BENCH_LOWER_IS_BETTER, "binary log flush" );
+    BenchReport( limitedNs, "ns", BENCH_LOWER_IS_BETTER, "binary log rate limited" );
+#else // #if YOJIMBO_ENABLE_LOGGING
+    printf( "    logging is compiled out\n" );
+#endif // #if YOJIMBO_ENABLE_LOGGING
+}
+
+static const Benchmark Benchmarks[] =
+{
+    { "snapshot", BenchSnapshot },
+    { "blocks", BenchBlocks },
+    { "compression", BenchCompression },
+    { "acks", BenchAcks },
+    { "sendqueue", BenchSendQueue },
+    { "sequencebuffer", BenchSequenceBuffers },
+    { "ackwindow", BenchAckWindow },
+    { "bitpacker", BenchBitpacker },
+    { "connection", BenchConnection },
+    { "reliable", BenchReliable },
+    { "netcode", BenchNetcode },
+    { "messagepool", BenchMessagePool },
+    { "allocator", BenchAllocator },
+    { "clientserver", BenchClientServer },
+    { "loopback", BenchLoopback },
+    { "hugepages", BenchHugePages },
+    { "trace", BenchTrace },
+    { "logging", BenchLogging },
+};
+
+int main( int argc, char ** argv )
+{
+    printf( "\nbench\n" );
+
+    // `bench [name] [--json path]`. No name runs them all. --json also writes every reported result to path.
+
+    const char * filter = NULL;
+    const char * jsonPath = NULL;
+
+    for ( int i = 1; i < argc; ++i )
+    {
+        if ( strcmp( argv[i], "--json" ) == 0 && i + 1 < argc )
+            jsonPath = argv[++i];
+        else
+            filter = argv[i];
+    }
+
+    if ( !InitializeYojimbo() )
+    {
+        printf( "error: failed to initialize Yojimbo!\n" );
+        return 1;
+    }
+
+    yojimbo_log_level( YOJIMBO_LOG_LEVEL_NONE );
+
+    int numRun = 0;
+
+    for ( int i = 0; i < (int) ( sizeof( Benchmarks ) / sizeof( Benchmarks[0] ) ); ++i )
+    {
+        if ( filter && strcmp( filter, Benchmarks[i].name ) != 0 )
+            continue;
+        // reseed per benchmark, so simulated loss and generated data are the same whether it runs alone or with the rest
+        srand( 100 );
+        BenchCurrent = Benchmarks[i].name;
+        Benchmarks[i].function();
+        numRun++;
+    }
+
+    ShutdownYojimbo();
+
+    printf( "\n" );
+
+    if ( numRun == 0 )
+    {
+        printf( "error: unknown benchmark '%s'\n", filter );
+        return 1;
+    }
+
+    if ( jsonPath )
+    {
+        if ( !BenchWriteResults( jsonPath ) )
+        {
+            printf( "error: failed to write results to %s\n", jsonPath );
+            return 1;
+        }
+        printf( "wrote %d results to %s\n\n", BenchNumResults, jsonPath );
+    }
+
+    return 0;
+}
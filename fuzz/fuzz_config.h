@@ -15,12 +15,12 @@
 
 using namespace yojimbo;
 
-const int FuzzNumConfigs = 8;
+const int FuzzNumConfigs = 13;
 
 inline void fuzz_make_config( uint8_t selector, ConnectionConfig & config )
 {
     // New configs are appended (never inserted) so an existing corpus input's leading selector
-    // byte keeps mapping to the same config: data[0] % 8 == data[0] % 6 for data[0] in [0,5].
+    // byte keeps mapping to the same config: data[0] % 12 == data[0] % 6 for data[0] in [0,5].
     switch ( selector % FuzzNumConfigs )
     {
         case 0: // reliable + unreliable, blocks enabled (the common case)
@@ -77,6 +77,46 @@ inline void fuzz_make_config( uint8_t selector, ConnectionConfig & config )
             config.channel[0].blockFragmentSize = 1024;
             config.channel[1].type = CHANNEL_TYPE_UNRELIABLE_UNORDERED;
             break;
+
+        case 8: // reliable-unordered + unreliable. Same framing as reliable-ordered, but the
+                // receiver delivers out of order through the receive window.
+            config.numChannels = 2;
+            config.channel[0].type = CHANNEL_TYPE_RELIABLE_UNORDERED;
+            config.channel[1].type = CHANNEL_TYPE_UNRELIABLE_UNORDERED;
+            break;
+
+        case 9: // snapshot + reliable. Snapshot blocks are small enough to always fit a packet,
+                // so the sender never trips the message too large error.
+            config.numChannels = 2;
+            config.channel[0].type = CHANNEL_TYPE_SNAPSHOT;
+            config.channel[0].maxBlockSize = 1024;
+            config.channel[1].type = CHANNEL_TYPE_RELIABLE_ORDERED;
+            break;
+
+        case 10: // several fragments per packet from a window of blocks: each block entry starts with
+                 // the fragment count, which the default of one fragment per packet leaves off the wire.
+            config.numChannels = 2;
+            config.channel[0].type = CHANNEL_TYPE_RELIABLE_ORDERED;
+            config.channel[0].maxFragmentsPerPacket = 4;
+            config.channel[0].maxBlocksInFlight = 4;
+            config.channel[1].type = CHANNEL_TYPE_UNRELIABLE_UNORDERED;
+            break;
+
+        case 11: // streamed blocks enabled: every fragment carries the stream flag, and stream
+                 // fragments carry 32 bit fragment ids and a 64 bit stream size with fragment 0.
+            config.numChannels = 2;
+            config.channel[0].type = CHANNEL_TYPE_RELIABLE_ORDERED;
+            config.channel[0].streamWindowSize = 16;
+            config.channel[1].type = CHANNEL_TYPE_UNRELIABLE_UNORDERED;
+            break;
+
+        case 12: // compressed blocks: fragment 0 carries the compressed flag and uncompressed size,
+                 // and completed blocks run through the decompressor.
+            config.numChannels = 2;
+            config.channel[0].type = CHANNEL_TYPE_RELIABLE_ORDERED;
+            config.channel[0].compressBlocks = true;
+            config.channel[1].type = CHANNEL_TYPE_UNRELIABLE_UNORDERED;
+            break;
     }
 }
 
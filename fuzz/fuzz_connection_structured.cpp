@@ -303,11 +303,11 @@ extern "C" int LLVMFuzzerTestOneInput( const uint8_t * data, size_t size )
             int type = r.u8() % FUZZ_NUM_MESSAGE_TYPES;
             int channel = ( config.numChannels > 1 ) ? ( r.u8() % config.numChannels ) : 0;
 
-            // Block messages are only valid on a reliable-ordered channel with blocks enabled:
+            // Block messages are only valid on a reliable channel with blocks enabled:
             // the unreliable channel serializes blocks inline and asserts if one won't fit a
             // single packet, and a disableBlocks channel asserts outright. Fall back otherwise.
             if ( type == FUZZ_MESSAGE_BLOCK &&
-                 ( config.channel[channel].type != CHANNEL_TYPE_RELIABLE_ORDERED ||
+                 ( config.channel[channel].type == CHANNEL_TYPE_UNRELIABLE_UNORDERED ||
                    config.channel[channel].disableBlocks ) )
             {
                 type = FUZZ_MESSAGE_PRIMITIVES;
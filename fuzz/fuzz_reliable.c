@@ -4,7 +4,9 @@
     Feeds arbitrary bytes into the reliable.io packet-receive path — packet-header
     parsing, ack decoding, and fragment reassembly — the code that runs on raw,
     attacker-controlled UDP payloads. The process-packet callback accepts everything
-    so reassembled payloads are exercised too.
+    so reassembled payloads are exercised too. Each input goes to two endpoints, one
+    with the default 32 ack bits and one with 128, so the extended ack header is
+    parsed as well.
 */
 
 #include "reliable.h"
@@ -13,6 +15,7 @@
 #include <string.h>
 
 static struct reliable_endpoint_t * g_endpoint = NULL;
+static struct reliable_endpoint_t * g_endpoint_extended_acks = NULL;
 static double g_time = 100.0;
 
 static int fuzz_process_packet( void * context, uint64_t id, uint16_t sequence, uint8_t * data, int bytes )
@@ -36,6 +39,8 @@ static void ensure_init( void )
     config.transmit_packet_function = fuzz_transmit_packet;
     config.process_packet_function = fuzz_process_packet;
     g_endpoint = reliable_endpoint_create( &config, g_time );
+    config.ack_bits = 128;
+    g_endpoint_extended_acks = reliable_endpoint_create( &config, g_time );
 }
 
 int LLVMFuzzerTestOneInput( const uint8_t * data, size_t size )
@@ -53,10 +58,17 @@ int LLVMFuzzerTestOneInput( const uint8_t * data, size_t size )
 
     reliable_endpoint_receive_packet( g_endpoint, buf, (int) size );
 
+    /* receiving may not modify the buffer, but don't rely on it */
+    memcpy( buf, data, size );
+
+    reliable_endpoint_receive_packet( g_endpoint_extended_acks, buf, (int) size );
+
     /* advance time so the reassembly / received-packet sequence buffers cycle */
     g_time += 0.01;
     reliable_endpoint_update( g_endpoint, g_time );
+    reliable_endpoint_update( g_endpoint_extended_acks, g_time );
     reliable_endpoint_clear_acks( g_endpoint );
+    reliable_endpoint_clear_acks( g_endpoint_extended_acks );
 
     return 0;
 }
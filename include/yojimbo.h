@@ -39,6 +39,7 @@
 #include "yojimbo_constants.h"
 #include "yojimbo_bit_array.h"
 #include "yojimbo_utils.h"
+#include "yojimbo_compression.h"
 #include "yojimbo_queue.h"
 #include "yojimbo_sequence_buffer.h"
 #include "yojimbo_address.h"
@@ -47,16 +48,24 @@
 #include "yojimbo_channel.h"
 #include "yojimbo_reliable_ordered_channel.h"
 #include "yojimbo_unreliable_unordered_channel.h"
+#include "yojimbo_snapshot_channel.h"
 #include "yojimbo_connection.h"
+#include "yojimbo_static_connection.h"
 #include "yojimbo_network_simulator.h"
 #include "yojimbo_adapter.h"
 #include "yojimbo_network_info.h"
+#include "yojimbo_metrics.h"
+#include "yojimbo_trace.h"
+#include "yojimbo_capture.h"
+#include "yojimbo_log.h"
+#include "yojimbo_direct_loopback.h"
 #include "yojimbo_server_interface.h"
 #include "yojimbo_base_server.h"
 #include "yojimbo_server.h"
 #include "yojimbo_client_interface.h"
 #include "yojimbo_base_client.h"
 #include "yojimbo_client.h"
+#include "yojimbo_network_thread.h"
 
 /** @file */
 
@@ -29,8 +29,10 @@
 #include "yojimbo_platform.h"
 
 #include <stdint.h>
+#include <string.h>
 #include <new>
 #include <utility>
+#include <mutex>
 #if YOJIMBO_DEBUG_MEMORY_LEAKS
 #include <map>
 #endif // YOJIMBO_DEBUG_MEMORY_LEAKS
@@ -96,6 +98,48 @@ namespace yojimbo
         }
     }
 
+    const int NumAllocatorSizeClasses = 12;                     ///< Allocation size classes in AllocatorStats: 16 bytes or less, then powers of two up to 16KB, then everything larger.
+
+    /**
+        Get the AllocatorStats size class of an allocation.
+        @param bytes The size of the allocation.
+        @returns The size class in [0,NumAllocatorSizeClasses-1]. Class i holds allocations of up to 16 << i bytes. The last class holds everything larger.
+     */
+
+    inline int GetAllocatorSizeClass( size_t bytes )
+    {
+        if ( bytes <= 16 )
+            return 0;
+#if defined( __GNUC__ )
+        // the number of bits in bytes - 1, less the 4 bits of the smallest class
+        const int sizeClass = int( sizeof( unsigned long long ) * 8 ) - __builtin_clzll( (unsigned long long) ( bytes - 1 ) ) - 4;
+        return sizeClass < NumAllocatorSizeClasses - 1 ? sizeClass : NumAllocatorSizeClasses - 1;
+#else // #if defined( __GNUC__ )
+        int sizeClass = 1;
+        while ( sizeClass < NumAllocatorSizeClasses - 1 && bytes > ( size_t( 16 ) << sizeClass ) )
+            sizeClass++;
+        return sizeClass;
+#endif // #if defined( __GNUC__ )
+    }
+
+    /**
+        Memory usage counters for an allocator. See Allocator::GetStats.
+        Kept in release builds too, so you can size ClientServerConfig::serverPerClientMemory from what clients really use.
+     */
+
+    struct AllocatorStats
+    {
+        size_t heapBytes;                                       ///< Bytes of memory the allocator works in.
+        size_t bytesInUse;                                      ///< Bytes currently allocated, as rounded up by the allocator.
+        size_t highWaterBytes;                                  ///< The most bytes ever allocated at once.
+        size_t freeBytes;                                       ///< Bytes in free blocks.
+        size_t largestFreeBlock;                                ///< The largest allocation that can succeed right now. Much smaller than freeBytes means the heap is fragmented.
+        int numFreeBlocks;                                      ///< The number of free blocks.
+        int numAllocations;                                     ///< The number of live allocations.
+        uint64_t totalAllocations;                              ///< The number of allocations ever made.
+        int numAllocationsBySizeClass[NumAllocatorSizeClasses]; ///< Live allocations by size class. See GetAllocatorSizeClass.
+    };
+
 #if YOJIMBO_DEBUG_MEMORY_LEAKS
 
     /**
@@ -176,6 +220,19 @@ namespace yojimbo
 
         void ClearError() { m_errorLevel = ALLOCATOR_ERROR_NONE; }
 
+        /**
+            Get memory usage counters for this allocator.
+            The default implementation keeps none. TLSF_Allocator and TLSF_SlabAllocator do.
+            @param stats The counters [out]. Zeroed if the allocator keeps no counters.
+            @returns True if the allocator keeps counters.
+         */
+
+        virtual bool GetStats( AllocatorStats & stats ) const
+        {
+            memset( &stats, 0, sizeof( stats ) );
+            return false;
+        }
+
     protected:
 
         /**
@@ -312,13 +369,269 @@ namespace yojimbo
 
         void Free( void * p, const char * file, int line );
 
-    private:
+        /**
+            Get memory usage counters.
+            Free block counts and the largest free block come from walking the TLSF pool, so this costs time in proportion to the number of blocks.
+            Don't call it for every client every frame.
+         */
+
+        bool GetStats( AllocatorStats & stats ) const;
+
+    protected:
+
+        void CountAllocation( size_t bytes )
+        {
+            m_stats.bytesInUse += bytes;
+            if ( m_stats.bytesInUse > m_stats.highWaterBytes )
+                m_stats.highWaterBytes = m_stats.bytesInUse;
+            m_stats.numAllocations++;
+            m_stats.totalAllocations++;
+            m_stats.numAllocationsBySizeClass[GetAllocatorSizeClass( bytes )]++;
+        }
+
+        void CountFree( size_t bytes )
+        {
+            yojimbo_assert( m_stats.bytesInUse >= bytes );
+            yojimbo_assert( m_stats.numAllocations > 0 );
+            m_stats.bytesInUse -= bytes;
+            m_stats.numAllocations--;
+            m_stats.numAllocationsBySizeClass[GetAllocatorSizeClass( bytes )]--;
+        }
 
         tlsf_t m_tlsf;              ///< The TLSF allocator instance backing this allocator.
+        uint8_t * m_poolStart;      ///< Start of the memory TLSF works in, after alignment.
+        size_t m_poolBytes;         ///< Size of the memory TLSF works in, after alignment (bytes).
+        AllocatorStats m_stats;     ///< Usage counters, updated on each allocate and free. The free block fields are filled in by GetStats.
+
+    private:
 
         TLSF_Allocator( const TLSF_Allocator & other );
         TLSF_Allocator & operator = ( const TLSF_Allocator & other );
     };
+
+    /**
+        A TLSF allocator with a slab cache in front of it for small allocations.
+        Allocations of up to MaxBytes are rounded up to a multiple of 16 and served from slabs: SlabBytes pages taken from TLSF and cut into blocks of one size class.
+        Allocating pops the free list of the first slab with room for the size class, and freeing pushes the block back on its slab, so neither searches TLSF.
+        Slabs go back to TLSF whole, once every block in them is free. One empty slab is kept per size class so a size class that goes empty and refills doesn't churn TLSF.
+        Larger allocations go straight to TLSF. If one fails, the empty slabs are given back and it is tried again.
+        In GetStats, slab blocks count at their size class size, and free blocks inside slabs are not in freeBytes. Use it by returning it from Adapter::CreateAllocator.
+     */
+
+    class TLSF_SlabAllocator : public TLSF_Allocator
+    {
+    public:
+
+        static const int SlabBytes = 4096;                      ///< Size of each slab. Slabs are aligned to this, so a block finds its slab by masking its address.
+        static const int MaxBytes = 256;                        ///< Allocations up to this size come from slabs.
+        static const int NumSizeClasses = MaxBytes / 16;        ///< One size class for each multiple of 16 bytes up to MaxBytes.
+
+        /**
+            TLSF slab allocator constructor.
+            Takes the same arguments as TLSF_Allocator. Sets aside one byte per slab sized page of memory to tell slab blocks from TLSF blocks.
+            @param memory Block of memory in which the allocator will work. This block must remain valid while this allocator exists.
+            @param bytes The size of the block of memory (bytes).
+         */
+
+        TLSF_SlabAllocator( void * memory, size_t bytes );
+
+        /**
+            TLSF slab allocator destructor.
+            Returns the empty slabs to TLSF. Free all memory allocated by this allocator before destroying.
+         */
+
+        ~TLSF_SlabAllocator();
+
+        /**
+            Allocate a block of memory, from a slab if it is small enough.
+            If a new slab is needed and TLSF has no aligned slab sized block left, the allocation goes to TLSF instead.
+            IMPORTANT: Don't call this directly. Use the YOJIMBO_NEW or YOJIMBO_ALLOCATE macros instead.
+         */
+
+        void * Allocate( size_t size, const char * file, int line );
+
+        /**
+            Free a block of memory allocated from a slab or from TLSF.
+            IMPORTANT: Don't call this directly. Use the YOJIMBO_DELETE or YOJIMBO_FREE macros instead.
+         */
+
+        void Free( void * p, const char * file, int line );
+
+        /**
+            Get the number of slabs currently taken from TLSF, including the empty slabs kept around.
+         */
+
+        int GetNumSlabs() const { return m_numSlabs; }
+
+    private:
+
+        struct Slab;
+
+        Slab * CreateSlab( int sizeClass );
+
+        void DestroySlab( Slab * slab );
+
+        bool ReleaseEmptySlabs();
+
+        void * AllocateLarge( size_t size, const char * file, int line );
+
+        uint8_t * m_slabPages;                                  ///< One byte per SlabBytes page of the pool. Non-zero if the page is a slab. NULL if the pool is too small for slabs.
+        uintptr_t m_firstPage;                                  ///< Address of the first page covered by m_slabPages.
+        size_t m_numPages;                                      ///< Number of entries in m_slabPages.
+        Slab * m_partialSlabs[NumSizeClasses];                  ///< Per size class, a list of slabs with at least one free block.
+        Slab * m_emptySlab[NumSizeClasses];                     ///< Per size class, an empty slab kept to refill from. NULL if none.
+        int m_numSlabs;                                         ///< Number of slabs taken from TLSF.
+
+        TLSF_SlabAllocator( const TLSF_SlabAllocator & other );
+        TLSF_SlabAllocator & operator = ( const TLSF_SlabAllocator & other );
+    };
+
+    /// Counters for one message pool. See MessageFactory::GetMessagePoolStats.
+
+    struct MessagePoolStats
+    {
+        int blockSize;                      ///< Bytes per message in the pool. 0 until the first message of the type is created.
+        int capacity;                       ///< Messages the pool has room for, in use or free.
+        int inUse;                          ///< Messages currently allocated from the pool.
+        int highWater;                      ///< The most messages ever in use at once.
+        uint64_t hits;                      ///< Allocations served straight from the free list.
+        uint64_t misses;                    ///< Allocations that had to grow the pool first.
+    };
+
+    /**
+        An allocator of equal size blocks, carved out of chunks taken from another allocator.
+        The message factory keeps one per message type, so creating and releasing messages pops and pushes a free list instead of going to the heap.
+        The block size is set by the first allocation. Chunks go back to the backing allocator only when the pool is destroyed, so a pool holds on to its high water mark.
+     */
+
+    class MessagePool : public Allocator
+    {
+    public:
+
+        /**
+            Message pool constructor. Nothing is allocated until the first allocation.
+            @param allocator The allocator chunks are taken from.
+            @param initialSize The number of blocks in the first chunk. 0 to use growSize.
+            @param growSize The number of blocks in each chunk after the first. Must be > 0.
+         */
+
+        MessagePool( Allocator & allocator, int initialSize, int growSize );
+
+        /**
+            Message pool destructor.
+            Returns all chunks to the backing allocator. Every block must have been freed.
+         */
+
+        ~MessagePool();
+
+        /**
+            Allocate a block, growing the pool by a chunk if the free list is empty.
+            @param size The size of the block (bytes). Must be no larger than the size of the first allocation.
+            @returns The block, or NULL if the pool needed to grow and the backing allocator is out of memory.
+         */
+
+        void * Allocate( size_t size, const char * file, int line );
+
+        /**
+            Return a block to the free list.
+         */
+
+        void Free( void * p, const char * file, int line );
+
+        /**
+            Has anything been allocated from this pool yet?
+            @returns True once the block size is set by the first allocation.
+         */
+
+        bool IsActive() const { return m_stats.blockSize != 0; }
+
+        /**
+            Get the pool counters.
+         */
+
+        const MessagePoolStats & GetStats() const { return m_stats; }
+
+    private:
+
+        bool Grow();
+
+        Allocator * m_allocator;            ///< The backing allocator chunks are taken from.
+        int m_initialSize;                  ///< Blocks in the first chunk.
+        int m_growSize;                     ///< Blocks in each later chunk.
+        void * m_freeList;                  ///< Singly linked list of free blocks, linked through their first word.
+        void * m_chunks;                    ///< Singly linked list of chunks, linked through a header at the start of each.
+        MessagePoolStats m_stats;           ///< Pool counters.
+
+        MessagePool( const MessagePool & other );
+        MessagePool & operator = ( const MessagePool & other );
+    };
+
+    /**
+        An allocator that makes another allocator safe to use from more than one thread, by taking a mutex around each call.
+        The network thread wraps the client and server allocators in one so the game thread can create and release messages while the network thread updates.
+        Allocations are tracked by the wrapped allocator, so leak reports name the original file and line.
+     */
+
+    class LockedAllocator : public Allocator
+    {
+    public:
+
+        /**
+            Wrap an allocator without taking ownership of it.
+            @param allocator The allocator to wrap. Must outlive this allocator.
+         */
+
+        LockedAllocator( Allocator & allocator );
+
+        /**
+            Wrap an allocator and take ownership of it.
+            @param parent The allocator the wrapped allocator was created with. It is deleted with this allocator when the locked allocator is destroyed.
+            @param allocator The allocator to wrap.
+         */
+
+        LockedAllocator( Allocator & parent, Allocator * allocator );
+
+        /**
+            Locked allocator destructor.
+            Deletes the wrapped allocator if it is owned.
+         */
+
+        ~LockedAllocator();
+
+        /**
+            Allocate from the wrapped allocator while holding the lock.
+            If the wrapped allocator fails, its error level is copied to this allocator.
+         */
+
+        void * Allocate( size_t size, const char * file, int line );
+
+        /**
+            Free to the wrapped allocator while holding the lock.
+         */
+
+        void Free( void * p, const char * file, int line );
+
+        /**
+            Get the counters of the wrapped allocator while holding the lock.
+         */
+
+        bool GetStats( AllocatorStats & stats ) const;
+
+        /**
+            Get the wrapped allocator.
+         */
+
+        Allocator & GetAllocator() { return *m_allocator; }
+
+    private:
+
+        Allocator * m_allocator;            ///< The wrapped allocator.
+        Allocator * m_parent;               ///< The allocator to delete the wrapped allocator with. NULL if it is not owned.
+        mutable std::mutex m_mutex;         ///< Taken around each call to the wrapped allocator.
+
+        LockedAllocator( const LockedAllocator & other );
+        LockedAllocator & operator = ( const LockedAllocator & other );
+    };
 }
 
 #endif // #ifndef YOJIMBO_ALLOCATOR_H
@@ -28,6 +28,8 @@
 #include "yojimbo_config.h"
 #include "yojimbo_platform.h"
 #include "yojimbo_client_interface.h"
+#include "yojimbo_metrics.h"
+#include "yojimbo_capture.h"
 #include <stdlib.h>
 
 struct reliable_endpoint_t;
@@ -100,6 +102,8 @@ namespace yojimbo
 
         void ReleaseMessage( Message * message );
 
+        void SetBlockStreamWriteFunction( int channelIndex, BlockStreamWriteFunction function, void * context );
+
         void GetNetworkInfo( NetworkInfo & info ) const;
 
         /**
@@ -111,8 +115,55 @@ namespace yojimbo
 
         int GetDisconnectReason() const { return m_disconnectReason; }
 
+        /**
+            Get the client metrics: the built-in packet, queue and update time metrics (see ConnectionMetrics), plus any you add.
+            Metrics count across connects. Take snapshots between client updates, on the thread that runs the client.
+            @see GetConnectionMetrics
+         */
+
+        MetricsRegistry & GetMetrics() { return m_metrics; }
+
+        const MetricsRegistry & GetMetrics() const { return m_metrics; }
+
+        /// Get the indices of the built-in metrics in GetMetrics.
+
+        const ConnectionMetrics & GetConnectionMetrics() const { return m_connectionMetrics; }
+
+        /**
+            Start capturing this client's traffic to a file, to replay later (see yojimbo_capture.h).
+            Every connection packet the client receives and sends is written out with its time, along with each AdvanceTime, connect and disconnect.
+            Each packet costs a copy into a buffered file write, so only capture when you want a capture.
+            @param path The capture file. Replaced if it exists.
+            @returns True if the capture file was created.
+         */
+
+        bool StartCapture( const char * path );
+
+        /// Stop capturing and close the capture file.
+
+        void StopCapture();
+
+        /// Is the client capturing its traffic? Goes false by itself if writing the capture file fails.
+
+        bool IsCapturing() const { return m_capture && m_capture->IsOpen(); }
+
+        /// Is this a direct loopback client? Its messages are handed to the server in the same process, with no packets. See Client::ConnectDirectLoopback.
+
+        bool IsDirectLoopback() const { return m_directLoopback != NULL; }
+
+        /**
+            Detach the client from its direct loopback link. Called by the server when it destroys the link, as it decommits the slot or stops.
+            The slot's memory goes with it, so ReleaseMessage ignores the messages from the slot the client still holds, until it connects again.
+         */
+
+        void DetachDirectLoopback();
+
     protected:
 
+        /// Get the packet capture, or NULL if StartCapture has not been called. Writes to a capture that hit an error are ignored.
+
+        PacketCapture * GetCapture() { return m_capture; }
+
         void SetDisconnectReason( int disconnectReason ) { m_disconnectReason = disconnectReason; }
 
         uint8_t * GetPacketBuffer() { return m_packetBuffer; }
@@ -137,6 +188,10 @@ namespace yojimbo
 
         class Connection & GetConnection() { yojimbo_assert( m_connection ); return *m_connection; }
 
+        /// Route messages through a direct loopback link to the server, instead of the connection. The client must be connected. DestroyInternal stops routing through the link, but the client keeps it to release the messages it holds until it connects again.
+
+        void SetDirectLoopback( class DirectLoopback * directLoopback );
+
         virtual void TransmitPacketFunction( uint16_t packetSequence, uint8_t * packetData, int packetBytes ) = 0;
 
         virtual int ProcessPacketFunction( uint16_t packetSequence, uint8_t * packetData, int packetBytes ) = 0;
@@ -170,6 +225,12 @@ namespace yojimbo
         int m_disconnectReason;                                             ///< The reason this client was last disconnected (ClientDisconnectReason). Cleared back to none when a new connect attempt starts.
         double m_time;                                                      ///< The current client time. See ClientInterface::AdvanceTime
         uint8_t * m_packetBuffer;                                           ///< Buffer used to read and write packets.
+        MetricsRegistry m_metrics;                                          ///< Client metrics. See GetMetrics.
+        ConnectionMetrics m_connectionMetrics;                              ///< Indices of the built-in metrics in m_metrics.
+        PacketCapture * m_capture;                                          ///< Packet capture. NULL unless StartCapture was called.
+        DirectLoopback * m_directLoopback;                                  ///< The link to the server slot while connected as a direct loopback client. Owned by the server. NULL otherwise.
+        DirectLoopback * m_directLoopbackSlot;                              ///< The link whose server slot owns the messages this client holds. Kept after disconnect, until the client connects again or the server destroys the link.
+        bool m_directLoopbackDetached;                                      ///< True if the server destroyed the link while the client was attached. Messages from the slot were freed with it.
 
     private:
 
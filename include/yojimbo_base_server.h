@@ -28,11 +28,30 @@
 #include "yojimbo_config.h"
 #include "yojimbo_allocator.h"
 #include "yojimbo_server_interface.h"
+#include "yojimbo_metrics.h"
+#include "yojimbo_capture.h"
 
 struct reliable_endpoint_t;
 
 namespace yojimbo
 {
+    /**
+        Memory use of a client slot on the server. See BaseServer::GetClientMemoryInfo.
+        The heap counters and message counts start over each time the slot is committed, so with ClientServerConfig::serverLazyClientMemory they cover the current client only.
+     */
+
+    struct ClientMemoryInfo
+    {
+        bool committed;                                             ///< True if the slot has its memory committed and its allocator, message factory, connection and endpoint created. Always true unless ClientServerConfig::serverLazyClientMemory is set.
+        size_t reservedBytes;                                       ///< Address space set aside for the slot (bytes).
+        size_t residentBytes;                                       ///< Bytes of the slot's memory currently backed by physical memory. Counts whole pages.
+        bool hasHeapStats;                                          ///< True if the slot's allocator keeps counters. False for a custom allocator from Adapter::CreateAllocator that doesn't override Allocator::GetStats.
+        AllocatorStats heap;                                        ///< Counters for the slot's allocator: bytes in use, high water mark, largest free block and live allocations by size class. Zeroed unless hasHeapStats.
+        int numMessages;                                            ///< Messages created by the slot's message factory that have not been destroyed yet.
+        int numMessageTypes;                                        ///< The number of valid entries in numMessagesByType. The factory's number of types, up to MaxMemoryInfoMessageTypes.
+        int numMessagesByType[MaxMemoryInfoMessageTypes];           ///< Live messages by message type.
+    };
+
     /**
         Common functionality across all server implementations.
      */
@@ -85,6 +104,8 @@ namespace yojimbo
 
         void ReleaseMessage( int clientIndex, Message * message );
 
+        void SetBlockStreamWriteFunction( int clientIndex, int channelIndex, BlockStreamWriteFunction function, void * context );
+
         void GetNetworkInfo( int clientIndex, NetworkInfo & info ) const;
 
         /**
@@ -97,8 +118,92 @@ namespace yojimbo
 
         int GetClientDisconnectReason( int clientIndex ) const;
 
+        /**
+            Get the memory use of a client slot.
+            Resident bytes are counted by asking the OS about each page, and the largest free block by walking the heap, so don't call this for every slot every frame.
+            Watch heap.highWaterBytes and heap.largestFreeBlock under real load to size ClientServerConfig::serverPerClientMemory.
+            @param clientIndex The index of the client slot in [0,maxClients-1].
+            @param info The memory info [out].
+         */
+
+        void GetClientMemoryInfo( int clientIndex, ClientMemoryInfo & info ) const;
+
+        /**
+            Get the number of client slots with committed memory.
+            Equal to the max clients unless ClientServerConfig::serverLazyClientMemory is set, in which case it is the connected clients plus idle slots not yet given back.
+         */
+
+        int GetNumCommittedClients() const;
+
+        /**
+            Get the server metrics: the built-in packet, queue and update time metrics (see ConnectionMetrics), plus any you add.
+            Metrics count across Start and Stop. Take snapshots between server updates, on the thread that runs the server.
+            @see GetConnectionMetrics
+         */
+
+        MetricsRegistry & GetMetrics() { return m_metrics; }
+
+        const MetricsRegistry & GetMetrics() const { return m_metrics; }
+
+        /// Get the indices of the built-in metrics in GetMetrics.
+
+        const ConnectionMetrics & GetConnectionMetrics() const { return m_connectionMetrics; }
+
+        /**
+            Start capturing the server's traffic to a file, to replay later (see yojimbo_capture.h).
+            Every connection packet received from and sent to each client is written out with the client index and time, along with each AdvanceTime, client connect and disconnect.
+            Each packet costs a copy into a buffered file write, so only capture when you want a capture.
+            @param path The capture file. Replaced if it exists.
+            @returns True if the capture file was created.
+         */
+
+        bool StartCapture( const char * path );
+
+        /// Stop capturing and close the capture file.
+
+        void StopCapture();
+
+        /// Is the server capturing its traffic? Goes false by itself if writing the capture file fails.
+
+        bool IsCapturing() const { return m_capture && m_capture->IsOpen(); }
+
+        /**
+            Link a loopback client slot to a client in the same process, so messages skip packets entirely.
+            Called by Client::ConnectDirectLoopback. You don't need to call this yourself.
+            @param clientIndex The index of a connected loopback client slot.
+            @param client The client to link. It is disconnected when the slot disconnects.
+            @returns The link, or NULL if it could not be created.
+         */
+
+        class DirectLoopback * CreateDirectLoopback( int clientIndex, class BaseClient & client );
+
+        /**
+            Is the client in this slot a direct loopback client?
+            @param clientIndex The index of the client slot in [0,maxClients-1].
+            @returns True if messages to and from this slot are handed to a client in the same process. See Client::ConnectDirectLoopback.
+         */
+
+        bool IsDirectLoopbackClient( int clientIndex ) const;
+
     protected:
 
+        /**
+            Disconnect a slot's direct loopback link, if it has one. Disconnects the linked client and releases the messages still queued.
+            The link itself is kept until the slot is decommitted, so the client can still release the messages it holds.
+         */
+
+        void DisconnectDirectLoopback( int clientIndex );
+
+        /**
+            Destroy a slot's direct loopback link, if it has one. Disconnects it first, and detaches the client from it.
+         */
+
+        void DestroyDirectLoopback( int clientIndex );
+
+        /// Get the packet capture, or NULL if StartCapture has not been called. Writes to a capture that hit an error are ignored.
+
+        PacketCapture * GetCapture() { return m_capture; }
+
         void SetClientDisconnectReason( int clientIndex, int disconnectReason );
 
         uint8_t * GetPacketBuffer() { return m_packetBuffer; }
@@ -133,8 +238,36 @@ namespace yojimbo
 
         virtual void ResetClient( int clientIndex );
 
+        /**
+            Commit memory for a client slot and create its allocator, message factory, connection and endpoint.
+            Does nothing if the slot is already committed.
+            @returns True if the slot is committed, false if memory or an object could not be created.
+         */
+
+        bool CommitClient( int clientIndex );
+
+        /**
+            Destroy a client slot's allocator, message factory, connection and endpoint, and give its memory back.
+         */
+
+        void DecommitClient( int clientIndex );
+
+        bool IsClientCommitted( int clientIndex ) const { return m_clientConnection[clientIndex] != NULL; }
+
     private:
 
+        void DecommitIdleClients();
+
+        size_t GetHeapPageSize() const;
+
+        size_t GetHeapBytes( size_t bytes ) const;
+
+        size_t GetClientMemoryReserveBytes() const;
+
+        uint8_t * AllocateHeap( size_t bytes );
+
+        void FreeHeap( uint8_t * memory, size_t bytes );
+
         ClientServerConfig m_config;                                ///< Base client/server config.
         Allocator * m_allocator;                                    ///< Allocator passed in to constructor.
         Adapter * m_adapter;                                        ///< The adapter specifies the allocator to use, and the message factory class.
@@ -142,16 +275,24 @@ namespace yojimbo
         int m_maxClients;                                           ///< Maximum number of clients supported.
         bool m_running;                                             ///< True if server is currently running, eg. after "Start" is called, before "Stop".
         double m_time;                                              ///< Current server time in seconds.
-        uint8_t * m_globalMemory;                                   ///< The block of memory backing the global allocator. Allocated with m_allocator.
-        uint8_t * m_clientMemory[MaxClients];                       ///< The block of memory backing the per-client allocators. Allocated with m_allocator.
+        uint8_t * m_globalMemory;                                   ///< The block of memory backing the global allocator. Allocated with m_allocator, or mapped from the OS if m_mappedHeaps.
+        uint8_t * m_clientMemory[MaxClients];                       ///< The block of memory backing the per-client allocators. Allocated like m_globalMemory, or part of m_clientMemoryReserve. NULL while a lazy slot is not committed.
+        uint8_t * m_clientMemoryReserve;                            ///< Address space reserved for all client slots with ClientServerConfig::serverLazyClientMemory. NULL otherwise.
+        uint8_t * m_clientMemoryBase;                               ///< Start of the first client slot in m_clientMemoryReserve, aligned to the huge page size with ClientServerConfig::serverHugePages.
+        size_t m_clientMemoryStride;                                ///< Bytes reserved for each client slot in m_clientMemoryReserve. serverPerClientMemory rounded up to the page size, or huge page size.
+        bool m_mappedHeaps;                                         ///< True if heaps are mapped from the OS for huge pages or a NUMA node, rather than allocated with m_allocator.
         Allocator * m_globalAllocator;                              ///< The global allocator. Used for allocations that don't belong to a specific client.
         Allocator * m_clientAllocator[MaxClients];                  ///< Array of per-client allocator. These are used for allocations related to connected clients.
         MessageFactory * m_clientMessageFactory[MaxClients];        ///< Array of per-client message factories. This silos message allocations per-client slot.
         Connection * m_clientConnection[MaxClients];                ///< Array of per-client connection classes. This is how messages are exchanged with clients.
         reliable_endpoint_t * m_clientEndpoint[MaxClients];         ///< Array of per-client reliable endpoints.
+        DirectLoopback * m_clientDirectLoopback[MaxClients];        ///< Array of per-client direct loopback links. Set while a direct loopback client is connected to the slot, and kept after it disconnects until the slot is decommitted or linked again.
         int m_clientDisconnectReason[MaxClients];                   ///< Per-client slot reason the last client in that slot was disconnected (ServerClientDisconnectReason). Reset to none at server start, and when a new client connects to the slot.
         NetworkSimulator * m_networkSimulator;                      ///< The network simulator used to simulate packet loss, latency, jitter etc. Optional.
         uint8_t * m_packetBuffer;                                   ///< Buffer used when writing packets.
+        MetricsRegistry m_metrics;                                  ///< Server metrics. See GetMetrics.
+        ConnectionMetrics m_connectionMetrics;                      ///< Indices of the built-in metrics in m_metrics.
+        PacketCapture * m_capture;                                  ///< Packet capture. NULL unless StartCapture was called.
     };
 }
 
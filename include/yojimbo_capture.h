@@ -0,0 +1,305 @@
+/*
+    Yojimbo Client/Server Network Library.
+
+    Copyright © 2016 - 2026, Más Bandwidth LLC.
+
+    Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+        1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+        2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+           in the documentation and/or other materials provided with the distribution.
+
+        3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived
+           from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+    INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+    SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+    USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef YOJIMBO_CAPTURE_H
+#define YOJIMBO_CAPTURE_H
+
+#include "yojimbo_config.h"
+#include "yojimbo_allocator.h"
+
+#include <stdio.h>
+#include <stdint.h>
+
+/** @file
+
+    Packet capture: a record of the connection packets a server or client received and sent, with the time and client index of each,
+    and every AdvanceTime, client connect and disconnect in between. Replay one to profile real traffic offline, or to compare two
+    versions on identical input.
+
+    Packets are captured where they enter and leave the connection: received packets after decryption and reassembly, as passed to
+    Connection::ProcessPacket, and sent packets as Connection::GeneratePacket wrote them, before fragmentation and encryption.
+    Loopback clients go through the same two points, so they are captured too.
+
+    File format. All integers are little endian.
+
+        header   "YOJICAP" and a zero byte, uint32 version, uint32 flags (bit 0 set if captured on a server),
+                 then the connection config: int32 maxPacketSize, int32 numChannels, and for each channel its ChannelConfig fields
+                 in declaration order, ints as int32, bools as uint8 and floats as float32. The compression dictionary is written
+                 as int32 bytes followed by the bytes.
+
+        record   uint8 type (CaptureRecordType), uint16 client index, uint16 packet sequence, float64 time, uint32 packet bytes,
+                 then the packet bytes. Records that are not packets have zero packet bytes.
+ */
+
+namespace yojimbo
+{
+    /// The version of the capture file format written by PacketCapture.
+
+    const uint32_t CaptureVersion = 1;
+
+    /// The types of record in a packet capture.
+
+    enum CaptureRecordType
+    {
+        CAPTURE_RECORD_PACKET_RECEIVED,                     ///< A connection packet received from the client, as passed to Connection::ProcessPacket.
+        CAPTURE_RECORD_PACKET_SENT,                         ///< A connection packet sent to the client, as written by Connection::GeneratePacket.
+        CAPTURE_RECORD_ADVANCE_TIME,                        ///< The server or client advanced time. Applies to every client.
+        CAPTURE_RECORD_CLIENT_CONNECTED,                    ///< A client connected to the slot. Its connection starts from scratch.
+        CAPTURE_RECORD_CLIENT_DISCONNECTED,                 ///< The client in the slot disconnected.
+        CAPTURE_NUM_RECORD_TYPES
+    };
+
+    /// A record read back from a packet capture. See PacketCaptureReader::ReadRecord.
+
+    struct CaptureRecord
+    {
+        CaptureRecordType type;                             ///< The record type.
+        int clientIndex;                                    ///< The client slot the record is for. Always 0 in a client capture.
+        uint16_t packetSequence;                            ///< The reliable packet sequence of the packet. 0 for records that are not packets.
+        double time;                                        ///< The server or client time when the record was written (seconds).
+        const uint8_t * packetData;                         ///< The packet data. Points into the reader's copy of the file, valid until it is closed, with at least 8 readable bytes past the end so it can be passed straight to Connection::ProcessPacket. NULL for records that are not packets.
+        int packetBytes;                                    ///< The size of the packet (bytes). 0 for records that are not packets.
+    };
+
+    /**
+        Writes a packet capture file.
+        Server::StartCapture and Client::StartCapture create one of these for you. Records are buffered, and written out as the buffer fills and on Close.
+     */
+
+    class PacketCapture
+    {
+    public:
+
+        /**
+            Packet capture constructor.
+            @param allocator The allocator for the write buffer.
+         */
+
+        PacketCapture( Allocator & allocator );
+
+        /**
+            Packet capture destructor. Closes the file if it is open.
+         */
+
+        ~PacketCapture();
+
+        /**
+            Create the capture file and write the header.
+            @param path The file to write. Replaced if it exists.
+            @param config The connection config of the connections being captured. Replay needs it to create matching connections.
+            @param server True if capturing a server, false if capturing a client.
+            @returns True if the file was created and the header written.
+         */
+
+        bool Open( const char * path, const ConnectionConfig & config, bool server );
+
+        /**
+            Flush and close the capture file.
+         */
+
+        void Close();
+
+        /**
+            Is the capture file open?
+            A write error closes it, so this also goes false if the disk fills up.
+         */
+
+        bool IsOpen() const { return m_file != NULL; }
+
+        /**
+            Write a packet record.
+            @param type CAPTURE_RECORD_PACKET_RECEIVED or CAPTURE_RECORD_PACKET_SENT.
+            @param clientIndex The client slot the packet was received from or sent to.
+            @param packetSequence The reliable packet sequence of the packet.
+            @param time The current server or client time (seconds).
+            @param packetData The connection packet data.
+            @param packetBytes The size of the packet (bytes).
+         */
+
+        void WritePacket( CaptureRecordType type, int clientIndex, uint16_t packetSequence, double time, const uint8_t * packetData, int packetBytes );
+
+        /**
+            Write a record that is not a packet: advance time, client connected or client disconnected.
+            @param type The record type.
+            @param clientIndex The client slot the record is for. Ignored for CAPTURE_RECORD_ADVANCE_TIME.
+            @param time The current server or client time (seconds).
+         */
+
+        void WriteEvent( CaptureRecordType type, int clientIndex, double time );
+
+        /**
+            Get the number of bytes written to the capture so far, including what is still buffered.
+         */
+
+        uint64_t GetBytesWritten() const { return m_bytesWritten; }
+
+    private:
+
+        void Write( const uint8_t * data, int bytes );
+
+        void WriteRecordHeader( CaptureRecordType type, int clientIndex, uint16_t packetSequence, double time, int packetBytes );
+
+        Allocator * m_allocator;                            ///< The allocator for the write buffer.
+        FILE * m_file;                                      ///< The capture file. NULL when closed.
+        char * m_buffer;                                    ///< stdio buffer for the file, so each record doesn't go to the OS.
+        uint64_t m_bytesWritten;                            ///< Bytes written so far.
+        char m_path[256];                                   ///< The file path, for error messages.
+
+        PacketCapture( const PacketCapture & other );
+        PacketCapture & operator = ( const PacketCapture & other );
+    };
+
+    /**
+        Reads a packet capture file back.
+        Open reads the whole file into memory, so replaying it afterwards does no IO.
+     */
+
+    class PacketCaptureReader
+    {
+    public:
+
+        /**
+            Packet capture reader constructor.
+            @param allocator The allocator for the copy of the file.
+         */
+
+        PacketCaptureReader( Allocator & allocator );
+
+        /**
+            Packet capture reader destructor. Frees the copy of the file.
+         */
+
+        ~PacketCaptureReader();
+
+        /**
+            Read a capture file into memory and parse its header.
+            @param path The capture file.
+            @returns True if the file was read and has a valid header of a version this reader understands.
+         */
+
+        bool Open( const char * path );
+
+        /**
+            Free the copy of the file.
+         */
+
+        void Close();
+
+        /**
+            Was this capture taken on a server?
+         */
+
+        bool IsServer() const { return m_server; }
+
+        /**
+            Get the connection config the capture was taken with.
+            Its compression dictionary, if any, points into the reader's copy of the file.
+         */
+
+        const ConnectionConfig & GetConnectionConfig() const { return m_config; }
+
+        /**
+            Read the next record.
+            @param record The record [out].
+            @returns True if a record was read. False at the end of the capture, or if the rest of the file is not a valid record (see IsTruncated).
+         */
+
+        bool ReadRecord( CaptureRecord & record );
+
+        /**
+            Did ReadRecord stop at a record that was cut short or invalid, rather than the end of the file?
+            A capture whose process was killed ends part way through a record. Everything before it is still good.
+         */
+
+        bool IsTruncated() const { return m_truncated; }
+
+        /**
+            Go back to the first record.
+         */
+
+        void Rewind();
+
+    private:
+
+        Allocator * m_allocator;                            ///< The allocator for the copy of the file.
+        uint8_t * m_data;                                   ///< The file contents, followed by 8 zero bytes for the bit reader. NULL when closed.
+        int64_t m_bytes;                                    ///< The size of the file (bytes).
+        int64_t m_firstRecord;                              ///< Offset of the first record, just past the header.
+        int64_t m_offset;                                   ///< Offset of the next record to read.
+        bool m_server;                                      ///< True if the capture was taken on a server.
+        bool m_truncated;                                   ///< True if ReadRecord stopped at a bad record.
+        ConnectionConfig m_config;                          ///< The connection config from the header.
+
+        PacketCaptureReader( const PacketCaptureReader & other );
+        PacketCaptureReader & operator = ( const PacketCaptureReader & other );
+    };
+
+    /// Counters from replaying a capture. See ReplayCapture.
+
+    struct CaptureReplayStats
+    {
+        uint64_t numRecords;                                ///< Records read.
+        uint64_t numPacketsReceived;                        ///< Received packets passed to the replay connections.
+        uint64_t numPacketsSent;                            ///< Sent packets passed to the peer connections. 0 unless replaying sent packets.
+        uint64_t packetBytes;                               ///< Bytes in the packets replayed.
+        uint64_t numPacketErrors;                           ///< Packets that Connection::ProcessPacket rejected. Non-zero means the capture does not match this version's packet format or message types.
+        uint64_t numMessagesReceived;                       ///< Messages received from the replayed packets.
+        uint64_t numAdvanceTimes;                           ///< AdvanceTime records replayed.
+        uint64_t numConnects;                               ///< Client connects replayed.
+
+        CaptureReplayStats() { Reset(); }
+
+        void Reset()
+        {
+            numRecords = 0;
+            numPacketsReceived = 0;
+            numPacketsSent = 0;
+            packetBytes = 0;
+            numPacketErrors = 0;
+            numMessagesReceived = 0;
+            numAdvanceTimes = 0;
+            numConnects = 0;
+        }
+    };
+
+    /**
+        Replay a capture through fresh connections, as fast as possible.
+        Each client slot gets a Connection created with the capture's connection config. Received packets go to its Connection::ProcessPacket
+        in capture order, messages are received and released as they arrive, and the connections advance time on each AdvanceTime record,
+        to the captured times. A client connect resets the slot's connection.
+        Sending is not replayed: there is no game code to send messages, and no acks come back. With replaySent, each sent packet goes to a
+        second connection per slot instead, standing in for the remote end, so its receive path is exercised too.
+        @param allocator The allocator for the connections.
+        @param messageFactory The message factory to create received messages with. Must know the same message types as the captured game.
+        @param context The serialization context passed to Connection::ProcessPacket, as set with Server::SetContext or Client::SetContext. NULL if none.
+        @param reader The capture to replay. Reads from its current position to the end.
+        @param replaySent If true, replay sent packets into a peer connection per client slot as well.
+        @param stats Counters for the replay [out].
+        @returns False if the capture ended in a truncated or invalid record, or a connection could not be created. The stats still count everything replayed.
+     */
+
+    bool ReplayCapture( Allocator & allocator, class MessageFactory & messageFactory, void * context, PacketCaptureReader & reader, bool replaySent, CaptureReplayStats & stats );
+}
+
+#endif // #ifndef YOJIMBO_CAPTURE_H
@@ -47,11 +47,23 @@ namespace yojimbo
         {
             BlockMessage * message;
             uint8_t * fragmentData;
-            uint64_t messageId : 16;
-            uint64_t fragmentId : 16;
-            uint64_t fragmentSize : 16;
-            uint64_t numFragments : 16;
+            uint64_t streamSize;                // streamed blocks only, sent with fragment 0
+            uint32_t fragmentId;
+            uint16_t messageId;
+            uint16_t fragmentSize;
+            uint16_t numFragments;              // blocks only, a stream's fragment count follows from its size
+            uint16_t isStream;
             int messageType;
+            int uncompressedSize;               // compressed blocks only, sent with fragment 0. 0 if the block is not compressed
+        };
+
+        struct SnapshotData
+        {
+            uint8_t * data;
+            int dataBytes;
+            int snapshotBytes;
+            uint16_t snapshotId;
+            uint16_t baselineOffset;
         };
 
         // `blockMessage` selects which of these is live for a given packet. They were once a
@@ -64,6 +76,17 @@ namespace yojimbo
         MessageData message;
         BlockData block;
 
+        // Reliable channels pack up to ChannelConfig::maxFragmentsPerPacket block fragments into
+        // a packet. `block` holds the first one and the rest are here, possibly from other blocks
+        // in flight. NULL with numExtraFragments 0 when the packet carries a single fragment.
+        int numExtraFragments;
+        BlockData * extraFragments;
+
+        // Snapshot channels send their snapshot message in `message` (always exactly one) and
+        // the encoded snapshot block here: in full when baselineOffset is 0, otherwise as a delta
+        // against snapshot (snapshotId - baselineOffset). See SnapshotChannel.
+        SnapshotData snapshot;
+
         void Initialize();
 
         void Free( MessageFactory & messageFactory );
@@ -107,6 +130,7 @@ namespace yojimbo
         CHANNEL_ERROR_FAILED_TO_SERIALIZE,                      ///< Serialize read failed for a message sent to this channel. Check your message serialize functions, one of them is returning false on serialize read. This can also be caused by a desync in message read and write.
         CHANNEL_ERROR_OUT_OF_MEMORY,                            ///< The channel tried to allocate some memory but couldn't.
         CHANNEL_ERROR_MESSAGE_TOO_LARGE,                        ///< The user tried to send a message that is too large to ever fit into a packet for this channel. Large data should be sent as a block message instead. This will assert out in development, but in production it sets this error on the channel.
+        CHANNEL_ERROR_STREAM_FAILED,                            ///< A streamed block could not be read on send or written on receive. Either the stream read or write function failed, or a stream arrived on a channel with no write function set. See BlockMessage::AttachBlockStream.
     };
 
     /// Helper function to convert a channel error to a user friendly string.
@@ -122,6 +146,7 @@ namespace yojimbo
             case CHANNEL_ERROR_BLOCKS_DISABLED:         return "blocks disabled";
             case CHANNEL_ERROR_FAILED_TO_SERIALIZE:     return "failed to serialize";
             case CHANNEL_ERROR_MESSAGE_TOO_LARGE:       return "message too large";
+            case CHANNEL_ERROR_STREAM_FAILED:           return "stream failed";
             default:
                 yojimbo_assert( false );
                 return "(unknown)";
@@ -165,6 +190,14 @@ namespace yojimbo
 
          virtual bool HasMessagesToSend() const = 0;
 
+        /**
+            Get the number of messages waiting in the send queue.
+            For reliable channels this includes messages that were sent but not acked yet.
+            @returns The number of messages in the send queue.
+         */
+
+        virtual int GetSendQueueDepth() const = 0;
+
         /**
             Queue a message to be sent across this channel.
             @param message The message to be sent.
@@ -218,6 +251,16 @@ namespace yojimbo
 
         virtual void ProcessAck( uint16_t sequence ) = 0;
 
+        /**
+            Process all connection packet acks received since the last update in one go.
+            Called once per update by Connection::ProcessAcks. The default implementation calls ProcessAck for each ack. Channels override it when
+            work that follows each ack, like advancing a send window, only needs to happen once for the whole set.
+            @param acks The sequence numbers of the acked connection packets, in the order reliable reported them.
+            @param numAcks The number of acks.
+         */
+
+        virtual void ProcessAcks( const uint16_t * acks, int numAcks );
+
     public:
 
         /**
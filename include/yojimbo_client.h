@@ -64,6 +64,7 @@ namespace yojimbo
         YOJIMBO_CLIENT_DISCONNECT_REASON_MESSAGE_TOO_LARGE,                 ///< Tried to send a message too large to ever fit into a packet. See CHANNEL_ERROR_MESSAGE_TOO_LARGE.
         YOJIMBO_CLIENT_DISCONNECT_REASON_OUT_OF_MEMORY,                     ///< The client memory budget was exhausted. Consider increasing ClientServerConfig::clientMemory.
         YOJIMBO_CLIENT_DISCONNECT_REASON_READ_PACKET_FAILED,                ///< A connection packet from the server failed to deserialize.
+        YOJIMBO_CLIENT_DISCONNECT_REASON_STREAM_FAILED,                     ///< A streamed block to or from the server failed. See CHANNEL_ERROR_STREAM_FAILED.
     };
 
     /// Helper function to convert a client disconnect reason to a user friendly string.
@@ -88,6 +89,7 @@ namespace yojimbo
             case YOJIMBO_CLIENT_DISCONNECT_REASON_MESSAGE_TOO_LARGE:                return "message too large";
             case YOJIMBO_CLIENT_DISCONNECT_REASON_OUT_OF_MEMORY:                    return "out of memory";
             case YOJIMBO_CLIENT_DISCONNECT_REASON_READ_PACKET_FAILED:               return "read packet failed";
+            case YOJIMBO_CLIENT_DISCONNECT_REASON_STREAM_FAILED:                    return "stream failed";
             default:
                 yojimbo_assert( false );
                 return "(unknown)";
@@ -136,6 +138,19 @@ namespace yojimbo
 
         void DisconnectLoopback();
 
+        /**
+            Connect to a listen server in the same process as a direct loopback client.
+            Like ConnectLoopback, but messages skip packets entirely: each message you send is handed to the server slot as is, with no serialization,
+            reliability, acks or netcode, and the other way around. Call SendPackets, ReceivePackets and AdvanceTime as usual. No Adapter loopback
+            functions are needed. See yojimbo_direct_loopback.h for what changes compared to a regular connection.
+            Both sides share the server slot's message factory and allocator, so release every message you received before disconnecting, and don't
+            move the client to another thread than the server. Disconnecting the slot on the server (or stopping it) disconnects this client.
+            @param server The server. Must be running in the same process, on the same thread.
+            @param clientIndex The slot of a loopback client, connected with Server::ConnectLoopbackClient.
+         */
+
+        void ConnectDirectLoopback( class Server & server, int clientIndex );
+
         bool IsLoopback() const;
 
         void ProcessLoopbackPacket( const uint8_t * packetData, int packetBytes, uint64_t packetSequence );
@@ -168,6 +183,7 @@ namespace yojimbo
 
         ClientServerConfig m_config;                    ///< Client/server configuration.
         netcode_client_t * m_client;                    ///< netcode client data.
+        uint64_t m_decryptFailures;                     ///< Decrypt failures counted by m_client so far, already added to the metrics.
         Address m_address;                              ///< Original address passed to ctor.
         Address m_boundAddress;                         ///< Address after socket bind, eg. with valid port
         uint64_t m_clientId;                            ///< The globally unique client id (set on each call to connect)
@@ -26,6 +26,7 @@
 #define YOJIMBO_CLIENT_INTERFACE_H
 
 #include "yojimbo_config.h"
+#include "yojimbo_message.h"
 #include "yojimbo_network_info.h"
 
 // fucking windows =p
@@ -217,6 +218,17 @@ namespace yojimbo
 
         virtual void ReleaseMessage( Message * message ) = 0;
 
+        /**
+            Set the function that receives streamed blocks sent by the server on a channel.
+            Call this after Client::Connect, and again after each reconnect. The channel must be a reliable channel with ChannelConfig::streamWindowSize > 0.
+            @param channelIndex The channel index in range [0,numChannels-1].
+            @param function The stream write function. NULL to clear it.
+            @param context Passed to the stream write function.
+            @see BlockMessage::AttachBlockStream
+         */
+
+        virtual void SetBlockStreamWriteFunction( int channelIndex, BlockStreamWriteFunction function, void * context ) = 0;
+
         /**
             Get client network info.
             Call this to receive information about the client network connection to the server, eg. round trip time, packet loss %, # of packets sent and so on.
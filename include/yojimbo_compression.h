@@ -0,0 +1,76 @@
+/*
+    Yojimbo Client/Server Network Library.
+
+    Copyright © 2016 - 2026, Más Bandwidth LLC.
+
+    Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+        1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+        2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+           in the documentation and/or other materials provided with the distribution.
+
+        3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived
+           from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+    INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+    SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+    USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef YOJIMBO_COMPRESSION_H
+#define YOJIMBO_COMPRESSION_H
+
+#include "yojimbo_config.h"
+
+/**
+    Small LZ77 codec used to compress block messages on the wire. See ChannelConfig::compressBlocks.
+
+    The format is a sequence of (literal run, match) pairs in the style of LZ4. Each pair starts with a token byte whose high nibble is the number of literals
+    and low nibble is the match length minus 4, with 15 in either nibble extended by following bytes of 255 until one is less than 255. The literals follow,
+    then a 16 bit little endian match offset, then the match length extension. The final pair has literals only. Matches may reach back into an optional
+    dictionary, which must be identical on both sides, so small payloads that share content with the dictionary compress well.
+
+    Both functions work on caller owned buffers and never allocate.
+ */
+
+/**
+    Get the worst case size of compressing some data.
+    @param bytes The size of the data to compress.
+    @returns The maximum number of bytes yojimbo_compress can write for that input.
+ */
+
+int yojimbo_compress_bound( int bytes );
+
+/**
+    Compress data.
+    @param input The data to compress.
+    @param inputBytes The size of the data to compress (bytes).
+    @param output The buffer to write the compressed data to.
+    @param outputBytes The size of the output buffer (bytes).
+    @param dictionary Optional data to match against before the input. Pass NULL for none. Only the last 65535 bytes are used.
+    @param dictionaryBytes The size of the dictionary (bytes).
+    @returns The size of the compressed data in bytes, or 0 if it doesn't fit in the output buffer. Pass an output buffer smaller than the input to only accept output that saves space.
+ */
+
+int yojimbo_compress( const uint8_t * input, int inputBytes, uint8_t * output, int outputBytes, const uint8_t * dictionary, int dictionaryBytes );
+
+/**
+    Decompress data written by yojimbo_compress.
+    The input is treated as untrusted: malformed data fails cleanly instead of reading or writing out of bounds.
+    @param input The compressed data.
+    @param inputBytes The size of the compressed data (bytes).
+    @param output The buffer to write the decompressed data to.
+    @param outputBytes The size of the output buffer (bytes).
+    @param dictionary The dictionary the data was compressed with, or NULL if none.
+    @param dictionaryBytes The size of the dictionary (bytes).
+    @returns The size of the decompressed data in bytes, or -1 if the data is malformed or doesn't fit in the output buffer.
+ */
+
+int yojimbo_decompress( const uint8_t * input, int inputBytes, uint8_t * output, int outputBytes, const uint8_t * dictionary, int dictionaryBytes );
+
+#endif // #ifndef YOJIMBO_COMPRESSION_H
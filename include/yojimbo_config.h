@@ -97,6 +97,28 @@
 #define YOJIMBO_ENABLE_LOGGING                      1
 #endif // #ifndef YOJIMBO_ENABLE_LOGGING
 
+// Tracing is OFF by default, and compiles to nothing. Turn it on from the build
+// system (CMake -DYOJIMBO_TRACING=ON, which also turns on NETCODE_ENABLE_TRACING
+// for the vendored netcode) to record hot path events. See yojimbo_trace.h.
+#ifndef YOJIMBO_ENABLE_TRACING
+#define YOJIMBO_ENABLE_TRACING                      0
+#endif // #ifndef YOJIMBO_ENABLE_TRACING
+
+// Events each thread keeps for tracing. Older events are overwritten. Must be a power of two.
+#ifndef YOJIMBO_TRACE_BUFFER_EVENTS
+#define YOJIMBO_TRACE_BUFFER_EVENTS                 65536
+#endif // #ifndef YOJIMBO_TRACE_BUFFER_EVENTS
+
+// Log messages each thread can hold for the binary logger before it drops new ones. Must be a power of two. See yojimbo_log.h.
+#ifndef YOJIMBO_BINARY_LOG_BUFFER_MESSAGES
+#define YOJIMBO_BINARY_LOG_BUFFER_MESSAGES          1024
+#endif // #ifndef YOJIMBO_BINARY_LOG_BUFFER_MESSAGES
+
+// Bytes of arguments the binary logger keeps per message. String arguments are copied, and cut short if they don't fit.
+#ifndef YOJIMBO_BINARY_LOG_MESSAGE_BYTES
+#define YOJIMBO_BINARY_LOG_MESSAGE_BYTES            240
+#endif // #ifndef YOJIMBO_BINARY_LOG_MESSAGE_BYTES
+
 namespace yojimbo
 {
     using namespace serialize;
@@ -106,7 +128,9 @@ namespace yojimbo
     enum ChannelType
     {
         CHANNEL_TYPE_RELIABLE_ORDERED,                              ///< Messages are received reliably and in the same order they were sent.
-        CHANNEL_TYPE_UNRELIABLE_UNORDERED                           ///< Messages are sent unreliably. Messages may arrive out of order, or not at all.
+        CHANNEL_TYPE_UNRELIABLE_UNORDERED,                          ///< Messages are sent unreliably. Messages may arrive out of order, or not at all.
+        CHANNEL_TYPE_RELIABLE_UNORDERED,                            ///< Messages are received reliably, but are delivered as soon as they arrive, so they may be received in a different order than they were sent.
+        CHANNEL_TYPE_SNAPSHOT                                       ///< Snapshots (block messages) are sent unreliably, newest only, and delta compressed against the newest snapshot acked by the other side.
     };
 
     /**
@@ -114,21 +138,36 @@ namespace yojimbo
 
         Channels let you specify different reliability and ordering guarantees for messages sent across a connection.
 
-        They may be configured as one of two types: reliable-ordered or unreliable-unordered.
+        They may be configured as one of four types: reliable-ordered, reliable-unordered, unreliable-unordered or snapshot.
 
         Reliable ordered channels guarantee that messages (see Message) are received reliably and in the same order they were sent.
         This channel type is designed for control messages and RPCs sent between the client and server.
 
+        Reliable unordered channels are sent exactly like reliable-ordered channels (same send queue, acks and resends), but each message is delivered as soon
+        as it arrives instead of waiting for every message before it. A lost packet only delays the messages that were in it, so this channel type suits
+        independent messages that must arrive but don't depend on each other, like chat, standalone RPCs and inventory events.
+
         Unreliable unordered channels are like UDP. There is no guarantee that messages will arrive, and messages may arrive out of order.
         This channel type is designed for data that is time critical and should not be resent if dropped, like snapshots of world state sent rapidly
         from server to client, or cosmetic events such as effects and sounds.
 
-        Both channel types support blocks of data attached to messages (see BlockMessage), but their treatment of blocks is quite different.
+        Snapshot channels are designed for world state sent rapidly from server to client. They send only the newest block message, and encode its
+        block as a delta against the newest snapshot the other side has acked, falling back to the full block when nothing has been acked yet.
+        See SnapshotChannel for details.
 
-        Reliable ordered channels are designed for blocks that must be received reliably and in-order with the rest of the messages sent over the channel.
+        All channel types support blocks of data attached to messages (see BlockMessage), but their treatment of blocks is quite different.
+
+        Reliable ordered (and reliable unordered) channels are designed for blocks that must be received reliably and in-order with the rest of the messages sent over the channel.
         Examples of these sort of blocks include the initial state of a level, or server configuration data sent down to a client on connect. These blocks
-        are sent by splitting them into fragments and resending each fragment until the other side has received the entire block. This allows for sending
-        blocks of data larger that maximum packet size quickly and reliably even under packet loss.
+        are sent by splitting them into fragments and resending each fragment until the other side has received the entire block. Several fragments are
+        packed into each packet, and several consecutive blocks can be in flight at once. This allows for sending blocks of data larger that maximum
+        packet size quickly and reliably even under packet loss.
+
+        Reliable channels can also send streamed blocks, which are read and written a fragment at a time through callbacks instead of held in memory,
+        so data of any size, like replays or map files, costs only a window of ChannelConfig::streamWindowSize fragments on each side.
+
+        Reliable channels can also compress blocks with a small built-in LZ codec, see ChannelConfig::compressBlocks. This suits level data, config blobs and
+        text, and costs nothing for blocks that don't compress, since those are sent as-is.
 
         Unreliable-unordered channels send blocks as-is without splitting them up into fragments. The idea is that transport level packet fragmentation
         should be used on top of the generated packet to split it up into into smaller packets that can be sent across typical Internet MTU (<1500 bytes).
@@ -139,7 +178,7 @@ namespace yojimbo
 
     struct ChannelConfig
     {
-        ChannelType type;                                           ///< Channel type: reliable-ordered or unreliable-unordered.
+        ChannelType type;                                           ///< Channel type: reliable-ordered, reliable-unordered, unreliable-unordered or snapshot.
         bool disableBlocks;                                         ///< Disables blocks being sent across this channel.
         int sentPacketBufferSize;                                   ///< Number of packet entries in the sent packet sequence buffer. Please consider your packet send rate and make sure you have at least a few seconds worth of entries in this buffer.
         int messageSendQueueSize;                                   ///< Number of messages in the send queue for this channel.
@@ -147,9 +186,16 @@ namespace yojimbo
         int maxMessagesPerPacket;                                   ///< Maximum number of messages to include in each packet. Will write up to this many messages, provided the messages fit into the channel packet budget and the number of bytes remaining in the packet.
         int packetBudget;                                           ///< Maximum amount of message data to write to the packet for this channel (bytes). Specifying -1 means the channel can use up to the rest of the bytes remaining in the packet.
         int maxBlockSize;                                           ///< The size of the largest block that can be sent across this channel (bytes).
-        int blockFragmentSize;                                      ///< Blocks are split up into fragments of this size (bytes). Reliable-ordered channel only.
-        float messageResendTime;                                    ///< Minimum delay between message resends (seconds). Avoids sending the same message too frequently. Reliable-ordered channel only.
-        float blockFragmentResendTime;                              ///< Minimum delay between block fragment resends (seconds). Avoids sending the same fragment too frequently. Reliable-ordered channel only.
+        int blockFragmentSize;                                      ///< Blocks are split up into fragments of this size (bytes). Reliable channels only.
+        float messageResendTime;                                    ///< Minimum delay between message resends (seconds). Avoids sending the same message too frequently. Reliable channels only.
+        float blockFragmentResendTime;                              ///< Delay before resending an unacked block fragment (seconds), used until the channel has a round trip time estimate. After that, fragments are resent once they have been unacked for 1.5x the smoothed round trip time. Reliable channels only.
+        int maxFragmentsPerPacket;                                  ///< Maximum number of block fragments to include in each packet. Will write up to this many fragments, provided they fit into the channel packet budget and the number of bytes remaining in the packet. Must be the same on client and server. Defaults to 1, the single fragment encoding: raise it (with maxBlocksInFlight) to send large blocks faster. Reliable channels only.
+        int maxBlocksInFlight;                                      ///< Maximum number of consecutive block messages whose fragments are sent at the same time. Each block in flight on the receiver holds a reassembly buffer the size of that block. Defaults to 1. Reliable channels only.
+        int streamWindowSize;                                       ///< Maximum number of fragments of a streamed block in flight at once (see BlockMessage::AttachBlockStream). Bounds the memory a stream of any size uses on either side to this many fragments. 0 disables streamed blocks. Must be the same on client and server. Reliable channels only.
+        bool compressBlocks;                                        ///< Compress block messages before splitting them into fragments, and decompress them once all fragments have arrived (see yojimbo_compress). A block is only sent compressed if that makes it smaller. Streamed blocks are never compressed. Must be the same on client and server. Reliable channels only.
+        const uint8_t * compressionDictionary;                      ///< Optional data that compressed blocks can refer back to, for example a few typical payloads concatenated, most common last. Lets small blocks compress well. Must be identical on client and server, and stay valid for the life of the channel. NULL for none.
+        int compressionDictionaryBytes;                             ///< Size of the compression dictionary (bytes). Only the last 65535 bytes are used.
+        int snapshotBufferSize;                                     ///< Number of recent snapshots each side keeps as delta baselines. Acks for snapshots older than this are too late to be used as a baseline. Must be a power of two and the same on client and server. Snapshot channel only.
 
         ChannelConfig() : type ( CHANNEL_TYPE_RELIABLE_ORDERED )
         {
@@ -163,13 +209,20 @@ namespace yojimbo
             blockFragmentSize = 1024;
             messageResendTime = 0.1f;
             blockFragmentResendTime = 0.25f;
+            maxFragmentsPerPacket = 1;
+            maxBlocksInFlight = 1;
+            streamWindowSize = 0;
+            compressBlocks = false;
+            compressionDictionary = NULL;
+            compressionDictionaryBytes = 0;
+            snapshotBufferSize = 32;
         }
 
         int GetMaxFragmentsPerBlock() const
         {
             // Round up: a block of maxBlockSize needs ceil(maxBlockSize/blockFragmentSize)
             // fragments. Using floor here under-sizes the send-side fragment buffers when
-            // maxBlockSize is not a multiple of blockFragmentSize (see GetFragmentToSend,
+            // maxBlockSize is not a multiple of blockFragmentSize (see StartSendingBlock,
             // which counts fragments with ceil).
             return ( maxBlockSize + blockFragmentSize - 1 ) / blockFragmentSize;
         }
@@ -184,6 +237,16 @@ namespace yojimbo
          */
 
         void Validate( int channelIndex, int maxPacketSize ) const;
+
+        /**
+            Check this channel configuration against the same rules as Validate, in every build.
+            Prints the first rule that fails and returns false instead of asserting. Use this for channel configs that come from outside your code, eg. read from a capture file.
+            @param channelIndex The index of this channel in the connection config. Used for error reporting.
+            @param maxPacketSize The maximum packet size from the connection config (bytes).
+            @returns True if the channel config is valid, false otherwise.
+         */
+
+        bool IsValid( int channelIndex, int maxPacketSize ) const;
     };
 
     /**
@@ -214,6 +277,14 @@ namespace yojimbo
          */
 
         void Validate() const;
+
+        /**
+            Check this connection configuration and each of its channels against the same rules as Validate, in every build.
+            Prints the first rule that fails and returns false instead of asserting.
+            @returns True if the connection config is valid, false otherwise.
+         */
+
+        bool IsValid() const;
     };
 
     /**
@@ -229,6 +300,10 @@ namespace yojimbo
         int clientMemory;                                       ///< Memory allocated inside Client for packets, messages and stream allocations (bytes)
         int serverGlobalMemory;                                 ///< Memory allocated inside Server for global connection request and challenge response packets (bytes)
         int serverPerClientMemory;                              ///< Memory allocated inside Server for packets, messages and stream allocations per-client (bytes)
+        bool serverLazyClientMemory;                            ///< If true, per-client memory is only reserved when the server starts. It is committed, and the client's allocator, message factory, connection and endpoint created, when a client connects to the slot, and given back to the OS after it disconnects. See BaseServer::GetClientMemoryInfo.
+        int serverWarmClientSlots;                              ///< With serverLazyClientMemory, the number of idle client slots that keep their memory committed after a disconnect, so the next client to connect to them doesn't wait on the OS.
+        bool serverHugePages;                                   ///< If true, the server global and per-client heaps are mapped straight from the OS with 2MB huge pages, instead of allocated from the server allocator. Cuts TLB misses when TLSF touches heaps at random. Falls back to normal pages if the OS has no huge pages to give.
+        int serverNumaNode;                                     ///< NUMA node to bind the server global and per-client heaps to, or -1 to leave placement to the OS. Set it to yojimbo_memory_numa_node() on the thread that runs the server. Any value other than -1 maps the heaps from the OS, as serverHugePages does.
         bool networkSimulator;                                  ///< If true then a network simulator is created for simulating latency, jitter, packet loss and duplicates.
         int maxSimulatorPackets;                                ///< Maximum number of packets that can be stored in the network simulator. Additional packets are dropped.
         int fragmentPacketsAbove;                               ///< Packets above this size (bytes) are split apart into fragments and reassembled on the other side.
@@ -237,7 +312,10 @@ namespace yojimbo
         int packetReassemblyBufferSize;                         ///< Number of packet entries in the fragmentation reassembly buffer.
         int ackedPacketsBufferSize;                             ///< Number of packet entries in the acked packet buffer. Consider your packet send rate and aim to have at least a few seconds worth of entries.
         int receivedPacketsBufferSize;                          ///< Number of packet entries in the received packet sequence buffer. Consider your packet send rate and aim to have at least a few seconds worth of entries.
+        int ackBits;                                            ///< Number of packets acked by each packet header: 32, 64 or 128. Must be the same on client and server. Raise it if either side sends more than 32 packets per round trip, otherwise acks fall off the window and packets that arrived are resent as lost. Needs the vendored reliable: built with YOJIMBO_SYSTEM_DEPS, only 32 is supported.
         float rttSmoothingFactor;                               ///< Round-Trip Time (RTT) smoothing factor over time.
+        int messagePoolInitialSize;                             ///< Messages of a type each message factory allocates for its pool on the first create of that type. 0 to use messagePoolGrowSize. See MessageFactory::EnableMessagePools.
+        int messagePoolGrowSize;                                ///< Messages added to a type's pool each time it runs dry. 0 disables message pools, so every message goes to the client or per-client allocator.
 
         ClientServerConfig()
         {
@@ -246,6 +324,10 @@ namespace yojimbo
             clientMemory = 10 * 1024 * 1024;
             serverGlobalMemory = 10 * 1024 * 1024;
             serverPerClientMemory = 10 * 1024 * 1024;
+            serverLazyClientMemory = false;
+            serverWarmClientSlots = 0;
+            serverHugePages = false;
+            serverNumaNode = -1;
             networkSimulator = true;
             maxSimulatorPackets = 4 * 1024;
             fragmentPacketsAbove = 1024;
@@ -254,7 +336,10 @@ namespace yojimbo
             packetReassemblyBufferSize = 64;
             ackedPacketsBufferSize = 256;
             receivedPacketsBufferSize = 256;
+            ackBits = 32;
             rttSmoothingFactor = 0.0025f;
+            messagePoolInitialSize = 0;
+            messagePoolGrowSize = 16;
         }
 
         /**
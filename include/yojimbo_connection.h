@@ -29,6 +29,7 @@
 #include "yojimbo_allocator.h"
 #include "yojimbo_message.h"
 #include "yojimbo_channel.h"
+#include "yojimbo_metrics.h"
 
 namespace yojimbo
 {
@@ -43,6 +44,166 @@ namespace yojimbo
         CONNECTION_ERROR_READ_PACKET_FAILED,                    ///< Failed to read packet. Received an invalid packet?
     };
 
+    /**
+        The payload of a connection packet: one channel packet data entry for each channel with something to send.
+        Connection and StaticConnection build and read packets through the same functions, so they interoperate on the wire.
+        @see GenerateConnectionPacket
+        @see ReadConnectionPacket
+     */
+
+    struct ConnectionPacket
+    {
+        int numChannelEntries;
+        ChannelPacketData * channelEntry;
+        MessageFactory * messageFactory;
+
+        ConnectionPacket()
+        {
+            messageFactory = NULL;
+            numChannelEntries = 0;
+            channelEntry = NULL;
+        }
+
+        ~ConnectionPacket()
+        {
+            if ( messageFactory )
+            {
+                for ( int i = 0; i < numChannelEntries; ++i )
+                {
+                    channelEntry[i].Free( *messageFactory );
+                }
+                YOJIMBO_FREE( messageFactory->GetAllocator(), channelEntry );
+                messageFactory = NULL;
+            }        
+        }
+
+        bool AllocateChannelData( MessageFactory & _messageFactory, int numEntries )
+        {
+            yojimbo_assert( numEntries > 0 );
+            yojimbo_assert( numEntries <= MaxChannels );
+            messageFactory = &_messageFactory;
+            Allocator & allocator = messageFactory->GetAllocator();
+            channelEntry = (ChannelPacketData*) YOJIMBO_ALLOCATE( allocator, sizeof( ChannelPacketData ) * numEntries );
+            if ( channelEntry == NULL )
+            {
+                // On the read path numChannelEntries was already set from the wire before this
+                // call; reset it so the destructor doesn't iterate a NULL channelEntry array.
+                numChannelEntries = 0;
+                return false;
+            }
+            for ( int i = 0; i < numEntries; ++i )
+            {
+                channelEntry[i].Initialize();
+            }
+            numChannelEntries = numEntries;
+            return true;
+        }
+
+        template <typename Stream> bool Serialize( Stream & stream, MessageFactory & messageFactory, const ConnectionConfig & connectionConfig )
+        {
+            const int numChannels = connectionConfig.numChannels;
+            serialize_int( stream, numChannelEntries, 0, connectionConfig.numChannels );
+#if YOJIMBO_DEBUG_MESSAGE_BUDGET
+            // Write/measure only — validates our own header-size estimate. (On read this is
+            // fixed-width and can't exceed the bound anyway, but keep it off the untrusted path.)
+            if ( !Stream::IsReading )
+                yojimbo_assert( stream.GetBitsProcessed() <= ConservativePacketHeaderBits );
+#endif // #if YOJIMBO_DEBUG_MESSAGE_BUDGET
+            if ( numChannelEntries > 0 )
+            {
+                if ( Stream::IsReading )
+                {
+                    if ( !AllocateChannelData( messageFactory, numChannelEntries ) )
+                    {
+                        yojimbo_printf( YOJIMBO_LOG_LEVEL_ERROR, "error: failed to allocate channel data (ConnectionPacket)\n" );
+                        return false;
+                    }
+                    for ( int i = 0; i < numChannelEntries; ++i )
+                    {
+                        yojimbo_assert( channelEntry[i].messageFailedToSerialize == 0 );
+                    }
+                }
+                for ( int i = 0; i < numChannelEntries; ++i )
+                {
+                    yojimbo_assert( channelEntry[i].messageFailedToSerialize == 0 );
+                    if ( !channelEntry[i].SerializeInternal( stream, messageFactory, connectionConfig.channel, numChannels ) )
+                    {
+                        yojimbo_printf( YOJIMBO_LOG_LEVEL_ERROR, "error: failed to serialize channel %d\n", i );
+                        return false;
+                    }
+                }
+            }
+            return true;
+        }
+
+        bool SerializeInternal( ReadStream & stream, MessageFactory & _messageFactory, const ConnectionConfig & connectionConfig )
+        {
+            return Serialize( stream, _messageFactory, connectionConfig );
+        }
+
+        bool SerializeInternal( WriteStream & stream, MessageFactory & _messageFactory, const ConnectionConfig & connectionConfig )
+        {
+            return Serialize( stream, _messageFactory, connectionConfig );            
+        }
+
+        bool SerializeInternal( MeasureStream & stream, MessageFactory & _messageFactory, const ConnectionConfig & connectionConfig )
+        {
+            return Serialize( stream, _messageFactory, connectionConfig );            
+        }
+
+    private:
+
+        ConnectionPacket( const ConnectionPacket & other );
+
+        const ConnectionPacket & operator = ( const ConnectionPacket & other );
+    };
+
+
+    /**
+        Build a connection packet from the channel packet data gathered for a packet and write it.
+        Takes ownership of each channelData entry flagged in channelHasData, and frees them if the packet can't be allocated.
+        @param context The context set on the write stream.
+        @param messageFactory The message factory messages and packet data are allocated with.
+        @param connectionConfig The connection config. Its channel configs decide how each entry is written.
+        @param channelData Channel packet data, indexed by channel.
+        @param channelHasData True for each channel that filled in its entry.
+        @param numChannels The number of entries in channelData and channelHasData.
+        @param numChannelsWithData The number of true entries in channelHasData.
+        @param packetData The buffer to write to.
+        @param maxPacketBytes The size of the buffer. A multiple of 8.
+        @param packetBytes The number of bytes written [out].
+        @returns True if the packet was written.
+     */
+
+    bool GenerateConnectionPacket( void * context,
+                                   MessageFactory & messageFactory,
+                                   const ConnectionConfig & connectionConfig,
+                                   ChannelPacketData * channelData,
+                                   const bool * channelHasData,
+                                   int numChannels,
+                                   int numChannelsWithData,
+                                   uint8_t * packetData,
+                                   int maxPacketBytes,
+                                   int & packetBytes );
+
+    /**
+        Read a connection packet.
+        @param context The context set on the read stream.
+        @param messageFactory The message factory to create received messages with.
+        @param connectionConfig The connection config. Its channel configs decide how each entry is read.
+        @param packet The packet to read into [out].
+        @param packetData The packet data.
+        @param packetBytes The size of the packet data in bytes. Greater than zero.
+        @returns True if the packet was read. False if it's malformed, or allocation failed.
+     */
+
+    bool ReadConnectionPacket( void * context,
+                               MessageFactory & messageFactory,
+                               const ConnectionConfig & connectionConfig,
+                               ConnectionPacket & packet,
+                               const uint8_t * packetData,
+                               int packetBytes );
+
     /**
         Sends and receives messages across a set of user defined channels.
      */
@@ -86,6 +247,34 @@ namespace yojimbo
 
         ChannelErrorLevel GetChannelErrorLevel( int channelIndex ) const;
 
+        /**
+            Set the function that receives streamed blocks sent to a channel.
+            The channel must be a reliable channel with ChannelConfig::streamWindowSize > 0. The function stays set across Reset.
+            @param channelIndex The channel index in [0,numChannels-1].
+            @param function The stream write function. NULL to clear it.
+            @param context Passed to the stream write function.
+            @see BlockMessage::AttachBlockStream
+         */
+
+        void SetBlockStreamWriteFunction( int channelIndex, BlockStreamWriteFunction function, void * context );
+
+        /**
+            Get the number of messages waiting in the send queues of all channels.
+            @see Channel::GetSendQueueDepth
+         */
+
+        int GetSendQueueDepth() const;
+
+        /**
+            Set the registry GeneratePacket counts packet contents into. The metrics stay set across Reset.
+            @param metrics The metrics registry. NULL to stop counting.
+            @param channelBitsMetric Histogram of the bits each channel with data writes into a packet.
+            @param messagesMetric Histogram of the messages in each packet.
+            @see ConnectionMetrics
+         */
+
+        void SetMetrics( MetricsRegistry * metrics, int channelBitsMetric, int messagesMetric );
+
     private:
 
         Allocator * m_allocator;                                ///< Allocator passed in to the connection constructor.
@@ -93,6 +282,9 @@ namespace yojimbo
         ConnectionConfig m_connectionConfig;                    ///< Connection configuration.
         Channel * m_channel[MaxChannels];                       ///< Array of connection channels. Array size corresponds to m_connectionConfig.numChannels
         ConnectionErrorLevel m_errorLevel;                      ///< The connection error level.
+        MetricsRegistry * m_metrics;                            ///< Packet contents are counted into this registry. NULL if not set.
+        int m_channelBitsMetric;                                ///< Channel bits per packet histogram in m_metrics.
+        int m_messagesMetric;                                   ///< Messages per packet histogram in m_metrics.
     };
 }
 
@@ -48,6 +48,12 @@ namespace yojimbo
     const int ConservativePacketHeaderBits = 16;                    ///< Conservative number of bits per-packet header.
     
     const int MaxAddressLength = 256;                               ///< The maximum length of an address when converted to a string (includes terminating NULL). @see Address::ToString
+
+    const int MaxMemoryInfoMessageTypes = 64;                       ///< The number of message types ClientMemoryInfo reports live message counts for. Messages of higher types are still counted in ClientMemoryInfo::numMessages.
+
+    const int MaxMetrics = 64;                                      ///< The maximum number of metrics in a MetricsRegistry, including the built-in client and server metrics.
+
+    const int MaxMetricBuckets = 16;                                ///< The maximum number of bucket bounds for a histogram metric. Each histogram also has an implicit +Inf bucket.
 }
 
 #endif // #ifndef YOJIMBO_CONSTANTS_H
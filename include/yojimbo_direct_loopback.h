@@ -0,0 +1,188 @@
+/*
+    Yojimbo Client/Server Network Library.
+
+    Copyright © 2016 - 2026, Más Bandwidth LLC.
+
+    Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+        1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+        2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+           in the documentation and/or other materials provided with the distribution.
+
+        3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived
+           from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+    INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+    SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+    USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef YOJIMBO_DIRECT_LOOPBACK_H
+#define YOJIMBO_DIRECT_LOOPBACK_H
+
+#include "yojimbo_config.h"
+#include "yojimbo_allocator.h"
+#include "yojimbo_message.h"
+#include "yojimbo_queue.h"
+
+/** @file
+    Direct loopback: messages between a server and a loopback client in the same process, with no packets.
+
+    A regular loopback client runs the full stack: each message is serialized into a packet, goes through the reliable endpoint
+    and netcode, is copied to the other side by the adapter, and is read back into a new message. A direct loopback client
+    (see Client::ConnectDirectLoopback) skips all of that. The client and its server slot share the slot's message factory and
+    allocator, so a message sent on one side is pushed onto a queue as is, and the other side receives that same object: the
+    reference the sender handed to SendMessage becomes the receiver's reference.
+
+    What changes compared to a regular loopback client:
+
+        - Messages are never serialized, so their Serialize functions aren't called, and the message budget isn't checked.
+        - Messages on the client side are created from the server slot's message factory, and blocks from its allocator.
+        - Every channel delivers every message, in order, with ids counting up from 0. Snapshot channels only keep the newest
+          snapshot that hasn't been received yet.
+        - A channel can hold ChannelConfig::messageSendQueueSize messages that the other side hasn't received yet. CanSendMessage
+          returns false while it is full.
+        - Streamed blocks are handed over with the stream attached: read them with BlockMessage::ReadBlockStream. The block
+          stream write function isn't called.
+        - Disconnecting the slot on the server disconnects the client too.
+        - Messages the client holds when it disconnects still belong to the slot. Client::ReleaseMessage hands them back to the
+          slot's message factory, even after the disconnect. Release them before the client connects again, and before the server
+          stops: stopping frees the slot's memory and the messages with it (reported as leaks when YOJIMBO_DEBUG_MESSAGE_LEAKS is on),
+          and releasing them afterwards does nothing.
+ */
+
+namespace yojimbo
+{
+    /// The direction messages travel through a DirectLoopback.
+
+    enum DirectLoopbackDirection
+    {
+        DIRECT_LOOPBACK_CLIENT_TO_SERVER,                       ///< Sent by the client, received by the server slot.
+        DIRECT_LOOPBACK_SERVER_TO_CLIENT,                       ///< Sent by the server slot, received by the client.
+        DIRECT_LOOPBACK_NUM_DIRECTIONS
+    };
+
+    /**
+        The message queues between a server slot and a direct loopback client.
+        Owned by the server slot. You don't use this directly: Server and Client route their message functions through it.
+        @see Client::ConnectDirectLoopback
+     */
+
+    class DirectLoopback
+    {
+    public:
+
+        /**
+            Direct loopback constructor.
+            @param allocator The server slot's allocator. The queues are allocated from it, and client blocks come from it.
+            @param messageFactory The server slot's message factory. Both sides create and release messages with it.
+            @param connectionConfig The connection config, for the channel types and queue sizes.
+         */
+
+        DirectLoopback( Allocator & allocator, MessageFactory & messageFactory, const ConnectionConfig & connectionConfig );
+
+        /**
+            Direct loopback destructor.
+            Releases the messages still in the queues.
+         */
+
+        ~DirectLoopback();
+
+        /**
+            Disconnect the link.
+            Releases the messages still in the queues. The server stops routing messages for the slot through the link, but keeps
+            it until the slot is decommitted, so the client can still release the messages it holds with GetMessageFactory.
+         */
+
+        void Disconnect();
+
+        /// Is the link connected? True from creation until Disconnect.
+
+        bool IsConnected() const { return m_connected; }
+
+        /**
+            Did the queues allocate?
+            @returns True if the constructor allocated every queue. False if the allocator ran out of memory.
+         */
+
+        bool IsValid() const { return m_valid; }
+
+        Allocator & GetAllocator() { return *m_allocator; }
+
+        MessageFactory & GetMessageFactory() { return *m_messageFactory; }
+
+        /**
+            Set the client at the other end.
+            The server disconnects the client through this pointer when the slot disconnects, and detaches it when the link is
+            destroyed. NULL when no client is linked.
+         */
+
+        void SetClient( class BaseClient * client ) { m_client = client; }
+
+        class BaseClient * GetClient() { return m_client; }
+
+        /**
+            Is there room to send a message?
+            @param direction The direction of the message.
+            @param channelIndex The channel index.
+            @returns True if the queue for the channel has room.
+         */
+
+        bool CanSendMessage( DirectLoopbackDirection direction, int channelIndex ) const;
+
+        /**
+            Are there messages the other side hasn't received yet?
+            @param direction The direction of the messages.
+            @param channelIndex The channel index.
+            @returns True if the queue for the channel isn't empty.
+         */
+
+        bool HasMessagesToSend( DirectLoopbackDirection direction, int channelIndex ) const;
+
+        /**
+            Hand a message to the other side.
+            The sender's reference on the message passes to the receiver. If the queue is full, the message is released and dropped:
+            check CanSendMessage first.
+            @param direction The direction of the message.
+            @param channelIndex The channel index.
+            @param message The message. Must be created by the server slot's message factory.
+         */
+
+        void SendMessage( DirectLoopbackDirection direction, int channelIndex, Message * message );
+
+        /**
+            Take the next message sent to this side.
+            The caller owns the reference: release it with the server slot's message factory, as the client and server ReleaseMessage do.
+            @param direction The direction of the message.
+            @param channelIndex The channel index.
+            @returns The oldest message not yet received, or NULL if there are none.
+         */
+
+        Message * ReceiveMessage( DirectLoopbackDirection direction, int channelIndex );
+
+    private:
+
+        Allocator * m_allocator;                                                    ///< The server slot's allocator.
+        MessageFactory * m_messageFactory;                                          ///< The server slot's message factory.
+        class BaseClient * m_client;                                                ///< The linked client. NULL if none.
+        bool m_connected;                                                           ///< True until Disconnect is called.
+        int m_numChannels;                                                          ///< The number of channels.
+        ChannelType m_channelType[MaxChannels];                                     ///< The type of each channel.
+        bool m_valid;                                                               ///< True if every queue allocated.
+        uint16_t m_messageId[DIRECT_LOOPBACK_NUM_DIRECTIONS][MaxChannels];          ///< Id for the next message sent on each channel, in each direction.
+        Queue<Message*> * m_queue[DIRECT_LOOPBACK_NUM_DIRECTIONS][MaxChannels];     ///< Messages sent and not yet received, for each channel in each direction.
+
+        void ReleaseQueuedMessages();
+
+        DirectLoopback( const DirectLoopback & other );
+
+        DirectLoopback & operator = ( const DirectLoopback & other );
+    };
+}
+
+#endif // #ifndef YOJIMBO_DIRECT_LOOPBACK_H
@@ -0,0 +1,124 @@
+/*
+    Yojimbo Client/Server Network Library.
+
+    Copyright © 2016 - 2026, Más Bandwidth LLC.
+
+    Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+        1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+        2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+           in the documentation and/or other materials provided with the distribution.
+
+        3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived
+           from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+    INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+    SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+    USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef YOJIMBO_LOG_H
+#define YOJIMBO_LOG_H
+
+#include "yojimbo_config.h"
+#include <stdarg.h>
+#include <stdint.h>
+
+/** @file
+    Deferred binary logging.
+
+    The default log path formats every message with vsnprintf as it is logged. Log messages on error paths that a client can
+    trigger (bad packets, stale packets, desync) then cost real CPU under attack. The binary logger only copies the format string
+    pointer and the raw arguments into a ring buffer per thread, with no locks, and formats them later: when you call
+    yojimbo_binary_log_flush, or on a background thread started with yojimbo_binary_log_start_thread. It also rate limits each
+    log call site, so a message repeated thousands of times a second is kept a few times and counted the rest.
+
+    Turn it on through the usual printf hook:
+
+        yojimbo_binary_log_start_thread( printf, 0.1 );
+        yojimbo_set_printf_function( yojimbo_binary_log_printf );
+
+    yojimbo_set_printf_function recognizes the binary logger, and has yojimbo, netcode and reliable hand it their messages
+    unformatted. (With YOJIMBO_SYSTEM_DEPS, the system netcode and reliable have no hook for that: their messages are formatted
+    first, and share one rate limit.)
+
+    Format strings must outlive the flush: string literals, as every log call in the library uses. %s arguments are copied,
+    up to YOJIMBO_BINARY_LOG_MESSAGE_BYTES for all the arguments of a message together. %n is ignored. When a thread's buffer
+    of YOJIMBO_BINARY_LOG_BUFFER_MESSAGES is full, new messages from it are dropped until the next flush.
+ */
+
+#define YOJIMBO_BINARY_LOG_COUNTER_MESSAGES_RECORDED        0           ///< Messages written to the ring buffers.
+#define YOJIMBO_BINARY_LOG_COUNTER_MESSAGES_SUPPRESSED      1           ///< Messages the rate limit discarded.
+#define YOJIMBO_BINARY_LOG_COUNTER_MESSAGES_DROPPED         2           ///< Messages discarded because their thread's buffer was full.
+#define YOJIMBO_BINARY_LOG_COUNTER_MESSAGES_WRITTEN         3           ///< Messages formatted and passed to the output function by a flush.
+#define YOJIMBO_BINARY_LOG_NUM_COUNTERS                     4
+
+/**
+    Record a log message in the calling thread's buffer, without formatting it.
+    Pass this to yojimbo_set_printf_function to send all library logging through the binary logger.
+    @param format The printf format string. Not copied: it must still be valid when the message is flushed.
+    @returns Always zero. The length of the formatted message isn't known until it is flushed.
+ */
+
+int yojimbo_binary_log_printf( const char * format, ... );
+
+/**
+    Record a log message in the calling thread's buffer, without formatting it.
+    This is the va_list form of yojimbo_binary_log_printf, used by the log functions of yojimbo, netcode and reliable.
+    @param format The printf format string. Not copied: it must still be valid when the message is flushed.
+    @param args The arguments for the format string.
+ */
+
+void yojimbo_binary_log_vprintf( const char * format, va_list args );
+
+/**
+    Format the messages recorded by every thread so far, and pass each to the output function, oldest first per thread.
+    Threads may keep logging while this runs. Flushes are serialized, so this is safe to call while the flush thread is running.
+    @param function The output function, called with "%s" and one message at a time. NULL for printf. Must not be yojimbo_binary_log_printf.
+    @returns The number of messages written.
+ */
+
+int yojimbo_binary_log_flush( int (*function)( const char * /*format*/, ... ) );
+
+/**
+    Start a background thread that flushes the binary log at an interval.
+    Call yojimbo_binary_log_stop_thread before the program exits.
+    @param function The output function, as for yojimbo_binary_log_flush.
+    @param interval The time between flushes (seconds).
+    @returns True if the thread started. False if it is already running, or couldn't be created.
+ */
+
+bool yojimbo_binary_log_start_thread( int (*function)( const char * /*format*/, ... ), double interval );
+
+/**
+    Stop the flush thread, and flush whatever it hadn't written yet.
+    Does nothing if the thread isn't running.
+ */
+
+void yojimbo_binary_log_stop_thread();
+
+/**
+    Set the rate limit for each log call site.
+    A call site (a format string) may record up to maxMessages in a window of the given length on each thread. Further messages from it are
+    counted and discarded until the window ends, and the next message from it that is kept is preceded by how many were discarded.
+    Initially 16 messages per second.
+    @param maxMessages The messages kept per window. 0 turns the rate limit off.
+    @param seconds The length of the window (seconds).
+ */
+
+void yojimbo_binary_log_rate_limit( int maxMessages, double seconds );
+
+/**
+    Get a binary log counter, summed over all threads since the process started.
+    @param index The counter, one of the YOJIMBO_BINARY_LOG_COUNTER_* values.
+    @returns The counter value.
+ */
+
+uint64_t yojimbo_binary_log_counter( int index );
+
+#endif // #ifndef YOJIMBO_LOG_H
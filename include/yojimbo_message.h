@@ -29,6 +29,7 @@
 #include <stdlib.h>
 #include "yojimbo_serialize.h"
 #include "yojimbo_allocator.h"
+#include <mutex>
 
 namespace yojimbo
 {
@@ -193,8 +194,37 @@ namespace yojimbo
         uint32_t m_blockMessage : 1;                ///< 1 if this is a block message. 0 otherwise. If 1 then you can cast the Message* to BlockMessage*. Lightweight RTTI.
     };
 
+    class BlockMessage;
+
+    /**
+        Reads part of a streamed block when it is sent. See BlockMessage::AttachBlockStream.
+        May be called more than once for the same range as fragments are resent, and must return the same bytes each time.
+        @param context The context passed to BlockMessage::AttachBlockStream.
+        @param offset The offset of the data in the stream (bytes).
+        @param data The buffer to fill [out].
+        @param bytes The number of bytes to read.
+        @returns True if the data was read, false if the stream failed. The channel goes into an error state if the stream fails.
+     */
+
+    typedef bool (*BlockStreamReadFunction)( void * context, uint64_t offset, uint8_t * data, int bytes );
+
+    /**
+        Writes part of a streamed block as it is received. See Connection::SetBlockStreamWriteFunction.
+        Called for each fragment of the stream in order, starting at offset 0, as soon as every fragment before it has arrived.
+        The message is the one sent with the stream, so its serialized fields are available from the first call. It is delivered by ReceiveMessage once the stream completes.
+        @param context The context passed to Connection::SetBlockStreamWriteFunction.
+        @param message The block message the stream is attached to.
+        @param offset The offset of the data in the stream (bytes).
+        @param data The data received.
+        @param bytes The number of bytes received.
+        @returns True if the data was written, false if the stream failed. The channel goes into an error state if the stream fails.
+     */
+
+    typedef bool (*BlockStreamWriteFunction)( void * context, BlockMessage * message, uint64_t offset, const uint8_t * data, int bytes );
+
     /**
         A message which can have a block of data attached to it.
+        Instead of a block held in memory, a block message sent over a reliable channel can carry a stream of any size, read a fragment at a time on send and written a fragment at a time on receive. See AttachBlockStream.
         @see ChannelConfig
      */
 
@@ -208,7 +238,7 @@ namespace yojimbo
             @see MessageFactory::CreateMessage
          */
 
-        explicit BlockMessage() : Message( 1 ), m_allocator(NULL), m_blockData(NULL), m_blockSize(0) {}
+        explicit BlockMessage() : Message( 1 ), m_allocator(NULL), m_blockData(NULL), m_blockSize(0), m_streamSize(0), m_streamReadFunction(NULL), m_streamContext(NULL) {}
 
         /**
             Attach a block to this message.
@@ -227,6 +257,71 @@ namespace yojimbo
             m_blockSize = blockSize;
         }
 
+        /**
+            Attach a stream to this message instead of a block.
+            The stream is sent over a reliable channel with ChannelConfig::streamWindowSize > 0, and only that many fragments of it are held in memory on either side at once.
+            On send, data is read through the read function as fragments go out. On receive, data is handed to the write function set on the channel, and this message has no block attached.
+            You can attach either a block or a stream, not both.
+            @param streamSize The size of the stream (bytes).
+            @param readFunction Reads data from the stream when it is sent.
+            @param context Passed to the read function.
+            @see Connection::SetBlockStreamWriteFunction
+         */
+
+        void AttachBlockStream( uint64_t streamSize, BlockStreamReadFunction readFunction, void * context )
+        {
+            yojimbo_assert( streamSize > 0 );
+            yojimbo_assert( readFunction );
+            yojimbo_assert( !m_blockData );
+            yojimbo_assert( !m_streamSize );
+            m_streamSize = streamSize;
+            m_streamReadFunction = readFunction;
+            m_streamContext = context;
+        }
+
+        /**
+            Is a stream attached to this message?
+            True on the sender after AttachBlockStream, and on the receiver for a message that was sent with a stream.
+            @returns True if this message carries a stream rather than a block.
+         */
+
+        bool IsBlockStream() const
+        {
+            return m_streamSize != 0;
+        }
+
+        /**
+            Get the size of the stream attached to this message.
+            @returns The size of the stream (bytes). 0 if no stream is attached.
+         */
+
+        uint64_t GetBlockStreamSize() const
+        {
+            return m_streamSize;
+        }
+
+        /**
+            Read data from the stream attached to this message.
+            Called by the channel as stream fragments are sent.
+            @returns True if the data was read, false if there is no read function or it failed.
+         */
+
+        bool ReadBlockStream( uint64_t offset, uint8_t * data, int bytes )
+        {
+            yojimbo_assert( offset + bytes <= m_streamSize );
+            return m_streamReadFunction && m_streamReadFunction( m_streamContext, offset, data, bytes );
+        }
+
+        /**
+            Set the size of the stream received with this message.
+            Called by the channel when the first fragment of a stream arrives. There is no read function on the receiver.
+         */
+
+        void SetBlockStreamSize( uint64_t streamSize )
+        {
+            m_streamSize = streamSize;
+        }
+
         /**
             Detach the block from this message.
             By doing this you are responsible for copying the block pointer and allocator and making sure the block is freed.
@@ -316,6 +411,9 @@ namespace yojimbo
         Allocator * m_allocator;                    ///< Allocator for the block attached to the message. NULL if no block is attached.
         uint8_t * m_blockData;                      ///< The block data. NULL if no block is attached.
         int m_blockSize;                            ///< The block size (bytes). 0 if no block is attached.
+        uint64_t m_streamSize;                      ///< The stream size (bytes). 0 if no stream is attached.
+        BlockStreamReadFunction m_streamReadFunction; ///< Reads stream data on send. NULL on the receiver.
+        void * m_streamContext;                     ///< Context passed to the stream read function.
     };
 
     /**
@@ -328,6 +426,35 @@ namespace yojimbo
         MESSAGE_FACTORY_ERROR_FAILED_TO_ALLOCATE_MESSAGE,                       ///< Failed to allocate a message. Typically this means we ran out of memory on the allocator backing the message factory.
     };
 
+    /**
+        Serialize functions and size bounds for one message type.
+        Message factories generated from a schema (see tools/schema) register a table of these, indexed by message type. Channels then serialize messages through direct calls to each type's templated serialize function instead of the virtual SerializeInternal methods, and skip the measure pass entirely for types whose size never changes.
+        Hand written factories can register a table too. Build each entry with YOJIMBO_MESSAGE_TYPE_INFO.
+        @see MessageFactory::SetMessageTypeInfo
+     */
+
+    struct MessageTypeInfo
+    {
+        bool (*read)( Message * message, ReadStream & stream );                 ///< Reads a message of this type.
+        bool (*write)( Message * message, WriteStream & stream );               ///< Writes a message of this type.
+        bool (*measure)( Message * message, MeasureStream & stream );           ///< Measures a message of this type.
+        int fixedBits;                                                          ///< The number of bits every message of this type serializes to, excluding any attached block. -1 if the size depends on the message contents.
+        int maxBits;                                                            ///< Upper bound on the bits a message of this type can measure, excluding any attached block.
+    };
+
+    /**
+        Serialize a message through its concrete type, with no virtual call.
+        Used as the read, write and measure functions in a MessageTypeInfo.
+        @param message The message. Must be of type T.
+        @param stream The stream to serialize with.
+        @returns The result of T::Serialize.
+     */
+
+    template <typename T, typename Stream> bool SerializeMessageAs( Message * message, Stream & stream )
+    {
+        return static_cast<T*>( message )->Serialize( stream );
+    }
+
     /**
         Defines the set of message types that can be created.
 
@@ -356,6 +483,13 @@ namespace yojimbo
             m_allocator = &allocator;
             m_numTypes = numTypes;
             m_errorLevel = MESSAGE_FACTORY_ERROR_NONE;
+            m_typeInfo = NULL;
+            m_messagePools = NULL;
+            m_locking = false;
+            m_numAllocatedMessages = 0;
+            m_numAllocatedMessagesByType = (int*) YOJIMBO_ALLOCATE( allocator, sizeof( int ) * numTypes );
+            if ( m_numAllocatedMessagesByType )
+                memset( m_numAllocatedMessagesByType, 0, sizeof( int ) * numTypes );
         }
 
         /**
@@ -367,8 +501,6 @@ namespace yojimbo
         {
             yojimbo_assert( m_allocator );
 
-            m_allocator = NULL;
-
             #if YOJIMBO_DEBUG_MESSAGE_LEAKS
             if ( allocated_messages.size() )
             {
@@ -386,6 +518,75 @@ namespace yojimbo
                 yojimbo_assert( false && "Message leaks detected, see log" );
             }
             #endif // #if YOJIMBO_DEBUG_MESSAGE_LEAKS
+
+            if ( m_messagePools )
+            {
+                for ( int i = 0; i < m_numTypes; ++i )
+                    m_messagePools[i].~MessagePool();
+                YOJIMBO_FREE( *m_allocator, m_messagePools );
+            }
+
+            YOJIMBO_FREE( *m_allocator, m_numAllocatedMessagesByType );
+
+            m_allocator = NULL;
+        }
+
+        /**
+            Give each message type its own pool of message objects.
+            Released messages go on a per-type free list and are reused by the next create of that type, so message churn doesn't go
+            through the allocator and doesn't fragment it. Memory is taken from the factory allocator a chunk at a time, on the first create
+            of each type and whenever its pool runs dry, and is only given back when the factory is destroyed.
+            Pooling covers factories that create messages with the allocator from GetMessageAllocator, which the factory macros and
+            generated factories do. Call this before creating any messages. Client and server call it with ClientServerConfig::messagePoolInitialSize
+            and ClientServerConfig::messagePoolGrowSize.
+            @param initialSize The number of messages of a type to allocate on its first create. 0 to use growSize.
+            @param growSize The number of messages to add to a type's pool each time it runs dry. 0 leaves pools disabled.
+            @see MessageFactory::GetMessagePoolStats
+         */
+
+        void EnableMessagePools( int initialSize, int growSize )
+        {
+            yojimbo_assert( m_messagePools == NULL );
+            #if YOJIMBO_DEBUG_MESSAGE_LEAKS
+            yojimbo_assert( allocated_messages.empty() );
+            #endif // #if YOJIMBO_DEBUG_MESSAGE_LEAKS
+            if ( growSize <= 0 || m_messagePools )
+                return;
+            m_messagePools = (MessagePool*) YOJIMBO_ALLOCATE( *m_allocator, sizeof( MessagePool ) * m_numTypes );
+            if ( !m_messagePools )
+                return;
+            for ( int i = 0; i < m_numTypes; ++i )
+                new ( &m_messagePools[i] ) MessagePool( *m_allocator, initialSize, growSize );
+        }
+
+        /**
+            Get the pool counters for a message type.
+            @param type The message type.
+            @param stats The pool counters [out].
+            @returns True if message pools are enabled, false otherwise.
+            @see MessageFactory::EnableMessagePools
+         */
+
+        bool GetMessagePoolStats( int type, MessagePoolStats & stats ) const
+        {
+            yojimbo_assert( type >= 0 );
+            yojimbo_assert( type < m_numTypes );
+            if ( !m_messagePools )
+                return false;
+            stats = m_messagePools[type].GetStats();
+            return true;
+        }
+
+        /**
+            Make the factory safe to create, acquire and release messages from more than one thread.
+            These calls then take a mutex, which covers the message pools, the leak tracking and message reference counts.
+            The factory allocator must be thread safe as well, see LockedAllocator. Call this before creating any messages.
+            @see NetworkThread
+         */
+
+        void EnableLocking()
+        {
+            m_locking = true;
         }
 
         /**
@@ -402,16 +603,22 @@ namespace yojimbo
         {
             yojimbo_assert( type >= 0 );
             yojimbo_assert( type < m_numTypes );
+            Lock();
             Message * message = CreateMessageInternal( type );
             if ( !message )
             {
                 m_errorLevel = MESSAGE_FACTORY_ERROR_FAILED_TO_ALLOCATE_MESSAGE;
+                Unlock();
                 return NULL;
             }
             #if YOJIMBO_DEBUG_MESSAGE_LEAKS
             allocated_messages[message] = 1;
             yojimbo_assert( allocated_messages.find( message ) != allocated_messages.end() );
             #endif // #if YOJIMBO_DEBUG_MESSAGE_LEAKS
+            m_numAllocatedMessages++;
+            if ( m_numAllocatedMessagesByType )
+                m_numAllocatedMessagesByType[type]++;
+            Unlock();
             return message;
         }
 
@@ -426,7 +633,11 @@ namespace yojimbo
         {
             yojimbo_assert( message );
             if ( message )
+            {
+                Lock();
                 message->Acquire();
+                Unlock();
+            }
         }
 
         /**
@@ -443,6 +654,7 @@ namespace yojimbo
             {
                 return;
             }
+            Lock();
             message->Release();
             if ( message->GetRefCount() == 0 )
             {
@@ -451,8 +663,48 @@ namespace yojimbo
                 allocated_messages.erase( message );
                 #endif // #if YOJIMBO_DEBUG_MESSAGE_LEAKS
                 yojimbo_assert( m_allocator );
-                YOJIMBO_DELETE( *m_allocator, Message, message );
+                const int type = message->GetType();
+                // a pool only becomes active if the factory created the type through it, see GetMessageAllocator
+                MessagePool * pool = m_messagePools ? &m_messagePools[type] : NULL;
+                if ( pool && pool->IsActive() )
+                    YOJIMBO_DELETE( *pool, Message, message );
+                else
+                    YOJIMBO_DELETE( *m_allocator, Message, message );
+                yojimbo_assert( m_numAllocatedMessages > 0 );
+                m_numAllocatedMessages--;
+                if ( m_numAllocatedMessagesByType )
+                    m_numAllocatedMessagesByType[type]--;
             }
+            Unlock();
+        }
+
+        /**
+            Get the number of messages created by this factory that have not been destroyed yet.
+            @returns The number of live messages.
+         */
+
+        int GetNumAllocatedMessages()
+        {
+            Lock();
+            const int numAllocatedMessages = m_numAllocatedMessages;
+            Unlock();
+            return numAllocatedMessages;
+        }
+
+        /**
+            Get the number of messages of a type created by this factory that have not been destroyed yet.
+            @param type The message type.
+            @returns The number of live messages of the type. Always 0 if the factory could not allocate its per-type counters.
+         */
+
+        int GetNumAllocatedMessages( int type )
+        {
+            yojimbo_assert( type >= 0 );
+            yojimbo_assert( type < m_numTypes );
+            Lock();
+            const int numAllocatedMessages = m_numAllocatedMessagesByType ? m_numAllocatedMessagesByType[type] : 0;
+            Unlock();
+            return numAllocatedMessages;
         }
 
         /**
@@ -465,6 +717,95 @@ namespace yojimbo
             return m_numTypes;
         }
 
+        /**
+            Get the serialize functions and size bounds for a message type.
+            @param type The message type.
+            @returns The type info, or NULL if this factory did not register a type info table.
+            @see MessageFactory::SetMessageTypeInfo
+         */
+
+        const MessageTypeInfo * GetMessageTypeInfo( int type ) const
+        {
+            yojimbo_assert( type >= 0 );
+            yojimbo_assert( type < m_numTypes );
+            return m_typeInfo ? &m_typeInfo[type] : NULL;
+        }
+
+        /**
+            Serialize a message (read).
+            Calls the read function from the type info table if there is one, otherwise the message's virtual SerializeInternal.
+            @param message The message to read into.
+            @param stream The stream to read from.
+            @returns True if the message was read successfully, false otherwise.
+         */
+
+        bool SerializeMessage( Message * message, ReadStream & stream )
+        {
+            yojimbo_assert( message );
+            return m_typeInfo ? m_typeInfo[message->GetType()].read( message, stream ) : message->SerializeInternal( stream );
+        }
+
+        /**
+            Serialize a message (write).
+            Calls the write function from the type info table if there is one, otherwise the message's virtual SerializeInternal.
+            @param message The message to write.
+            @param stream The stream to write to.
+            @returns True if the message was written successfully, false otherwise.
+         */
+
+        bool SerializeMessage( Message * message, WriteStream & stream )
+        {
+            yojimbo_assert( message );
+            return m_typeInfo ? m_typeInfo[message->GetType()].write( message, stream ) : message->SerializeInternal( stream );
+        }
+
+        /**
+            Serialize a message (measure).
+            Calls the measure function from the type info table if there is one, otherwise the message's virtual SerializeInternal.
+            @param message The message to measure.
+            @param stream The measure stream.
+            @returns True if the message was measured successfully, false otherwise.
+         */
+
+        bool SerializeMessage( Message * message, MeasureStream & stream )
+        {
+            yojimbo_assert( message );
+            return m_typeInfo ? m_typeInfo[message->GetType()].measure( message, stream ) : message->SerializeInternal( stream );
+        }
+
+        /**
+            Measure how many bits a message takes to write, not including any attached block.
+            Message types with a fixed size in the type info table return it directly, without running a measure stream.
+            @param message The message to measure.
+            @param context The context set on the measure stream, as on the write stream.
+            @returns The number of bits the message takes to write. Conservative, like the measure stream: alignment is counted as the worst case.
+         */
+
+        int MeasureMessage( Message * message, void * context )
+        {
+            yojimbo_assert( message );
+
+            if ( m_typeInfo && m_typeInfo[message->GetType()].fixedBits >= 0 )
+            {
+                const int fixedBits = m_typeInfo[message->GetType()].fixedBits;
+                #ifdef YOJIMBO_DEBUG
+                // the table is generated, but a hand edited message could drift from it. catch that here, not as corrupt packets
+                MeasureStream stream;
+                stream.SetContext( context );
+                stream.SetAllocator( m_allocator );
+                m_typeInfo[message->GetType()].measure( message, stream );
+                yojimbo_assert( stream.GetBitsProcessed() == fixedBits );
+                #endif // #ifdef YOJIMBO_DEBUG
+                return fixedBits;
+            }
+
+            MeasureStream stream;
+            stream.SetContext( context );
+            stream.SetAllocator( m_allocator );
+            SerializeMessage( message, stream );
+            return (int) stream.GetBitsProcessed();
+        }
+
         /**
             Get the allocator used to create messages.
             @returns The allocator.
@@ -513,8 +854,36 @@ namespace yojimbo
 
         void SetMessageType( Message * message, int type ) { message->SetType( type ); }
 
+        /**
+            Get the allocator to create a message of the given type with.
+            This is the type's message pool when pools are enabled, otherwise the factory allocator.
+            @param type The message type.
+            @returns The allocator to pass to YOJIMBO_NEW in CreateMessageInternal.
+            @see MessageFactory::EnableMessagePools
+         */
+
+        Allocator & GetMessageAllocator( int type )
+        {
+            yojimbo_assert( type >= 0 );
+            yojimbo_assert( type < m_numTypes );
+            return m_messagePools ? (Allocator&) m_messagePools[type] : *m_allocator;
+        }
+
+        /**
+            Register serialize functions and size bounds for every message type.
+            Call this from the derived factory's constructor. The table is not copied, so it must outlive the factory: a static array is typical.
+            @param typeInfo Array of type info, one entry per message type, indexed by type.
+            @see YOJIMBO_MESSAGE_TYPE_INFO
+         */
+
+        void SetMessageTypeInfo( const MessageTypeInfo * typeInfo ) { m_typeInfo = typeInfo; }
+
     private:
 
+        void Lock() { if ( m_locking ) m_mutex.lock(); }
+
+        void Unlock() { if ( m_locking ) m_mutex.unlock(); }
+
         #if YOJIMBO_DEBUG_MESSAGE_LEAKS
         std::map<void*,int> allocated_messages;                                 ///< The set of allocated messages for this factory. Used to track down message leaks.
         #endif // #if YOJIMBO_DEBUG_MESSAGE_LEAKS
@@ -524,6 +893,17 @@ namespace yojimbo
         int m_numTypes;                                                         ///< The number of message types.
 
         MessageFactoryErrorLevel m_errorLevel;                                  ///< The message factory error level.
+
+        const MessageTypeInfo * m_typeInfo;                                     ///< Serialize functions and size bounds per message type. NULL unless the derived factory registers a table.
+
+        MessagePool * m_messagePools;                                           ///< One message pool per message type. NULL unless EnableMessagePools was called.
+
+        int m_numAllocatedMessages;                                             ///< The number of messages created and not yet destroyed.
+        int * m_numAllocatedMessagesByType;                                     ///< The number of messages of each type created and not yet destroyed. NULL if it could not be allocated.
+
+        bool m_locking;                                                         ///< True if create, acquire and release take m_mutex. See EnableLocking.
+
+        std::mutex m_mutex;                                                     ///< Guards message creation and release when locking is enabled.
     };
 }
 
@@ -544,7 +924,7 @@ namespace yojimbo
         yojimbo::Message * CreateMessageInternal( int type )                                                                            \
         {                                                                                                                               \
             yojimbo::Message * message;                                                                                                 \
-            yojimbo::Allocator & allocator = GetAllocator();                                                                            \
+            yojimbo::Allocator & allocator = GetMessageAllocator( type );                                                               \
             (void) allocator;                                                                                                           \
             switch ( type )                                                                                                             \
             {                                                                                                                           \
@@ -579,6 +959,23 @@ namespace yojimbo
         }                                                                                                                               \
     };
 
+/**
+    Build a MessageTypeInfo entry for a message class with a templated Serialize method.
+    The message class must declare Serialize as public.
+    @param message_class The message class.
+    @param fixed_bits The number of bits every message of this class serializes to, or -1 if the size varies.
+    @param max_bits Upper bound on the bits a message of this class can measure.
+ */
+
+#define YOJIMBO_MESSAGE_TYPE_INFO( message_class, fixed_bits, max_bits )                                                                \
+    {                                                                                                                                   \
+        &yojimbo::SerializeMessageAs<message_class, yojimbo::ReadStream>,                                                               \
+        &yojimbo::SerializeMessageAs<message_class, yojimbo::WriteStream>,                                                              \
+        &yojimbo::SerializeMessageAs<message_class, yojimbo::MeasureStream>,                                                            \
+        fixed_bits,                                                                                                                     \
+        max_bits                                                                                                                        \
+    }
+
 /**
     Helper function to serialize a block attached to a message. Used by channel implementations.
  */
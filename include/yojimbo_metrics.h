@@ -0,0 +1,269 @@
+/*
+    Yojimbo Client/Server Network Library.
+
+    Copyright © 2016 - 2026, Más Bandwidth LLC.
+
+    Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+        1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+        2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+           in the documentation and/or other materials provided with the distribution.
+
+        3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived
+           from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+    INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+    SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+    USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef YOJIMBO_METRICS_H
+#define YOJIMBO_METRICS_H
+
+#include "yojimbo_config.h"
+#include "yojimbo_platform.h"
+
+#include <stdint.h>
+
+namespace yojimbo
+{
+    /// The type of a metric.
+
+    enum MetricType
+    {
+        METRIC_TYPE_COUNTER,                            ///< A count that only goes up, eg. packets sent.
+        METRIC_TYPE_GAUGE,                              ///< A value that goes up and down, eg. the number of connected clients.
+        METRIC_TYPE_HISTOGRAM,                          ///< A distribution of observed values, counted into fixed buckets, eg. packet sizes.
+    };
+
+    /// The text format metrics are exported in.
+
+    enum MetricsFormat
+    {
+        METRICS_FORMAT_PROMETHEUS,                      ///< The Prometheus text exposition format.
+        METRICS_FORMAT_JSON,                            ///< A JSON object with a "metrics" array.
+    };
+
+    /**
+        A single metric: its definition and current value.
+        Histogram buckets are not cumulative here. Each bucket counts the values in (bound[i-1],bound[i]], and the last bucket counts values above the highest bound.
+     */
+
+    struct Metric
+    {
+        const char * name;                              ///< The metric name. Points at the string passed in when the metric was added.
+        const char * help;                              ///< One line describing the metric. Points at the string passed in when the metric was added.
+        MetricType type;                                ///< The metric type.
+        uint64_t count;                                 ///< Counter value, or the number of values observed by a histogram.
+        double value;                                   ///< Gauge value, or the sum of the values observed by a histogram.
+        int numBounds;                                  ///< The number of histogram bucket bounds.
+        double bound[MaxMetricBuckets];                 ///< Histogram bucket upper bounds, in increasing order.
+        uint64_t bucket[MaxMetricBuckets+1];            ///< Histogram bucket counts. bucket[numBounds] counts values above the highest bound.
+    };
+
+    /**
+        A copy of every metric in a registry at one point in time.
+        @see MetricsRegistry::GetSnapshot
+     */
+
+    struct MetricsSnapshot
+    {
+        double time;                                    ///< The time the snapshot was taken (seconds). See yojimbo_time.
+        int numMetrics;                                 ///< The number of metrics.
+        Metric metric[MaxMetrics];                      ///< The metrics, in the order they were added.
+    };
+
+    /**
+        A fixed size set of counters, gauges and histograms.
+
+        Updates are a few instructions and never allocate, so metrics stay on in release builds. The registry is not thread safe:
+        update it and take snapshots from the thread that owns it, eg. between server updates, then export the snapshot from anywhere.
+
+        Names and help strings are not copied. Pass string literals, or strings that outlive the registry.
+
+        @see BaseServer::GetMetrics
+        @see BaseClient::GetMetrics
+        @see WriteMetrics
+     */
+
+    class MetricsRegistry
+    {
+    public:
+
+        MetricsRegistry();
+
+        /**
+            Add a counter.
+            @param name The metric name. Prometheus convention is lowercase with underscores, ending in "_total".
+            @param help One line describing the metric.
+            @returns The metric index, or -1 if the registry is full or a metric with this name already exists.
+         */
+
+        int AddCounter( const char * name, const char * help );
+
+        /**
+            Add a gauge.
+            @param name The metric name.
+            @param help One line describing the metric.
+            @returns The metric index, or -1 if the registry is full or a metric with this name already exists.
+         */
+
+        int AddGauge( const char * name, const char * help );
+
+        /**
+            Add a histogram with fixed buckets.
+            @param name The metric name.
+            @param help One line describing the metric.
+            @param bounds The bucket upper bounds, in increasing order. Copied.
+            @param numBounds The number of bounds in [1,MaxMetricBuckets].
+            @returns The metric index, or -1 if the registry is full or a metric with this name already exists.
+         */
+
+        int AddHistogram( const char * name, const char * help, const double * bounds, int numBounds );
+
+        /**
+            Find a metric by name.
+            @returns The metric index, or -1 if there is no metric with this name.
+         */
+
+        int FindMetric( const char * name ) const;
+
+        int GetNumMetrics() const { return m_numMetrics; }
+
+        const Metric & GetMetric( int index ) const
+        {
+            yojimbo_assert( index >= 0 );
+            yojimbo_assert( index < m_numMetrics );
+            return m_metric[index];
+        }
+
+        /// Add to a counter.
+
+        void Increment( int index, uint64_t value = 1 )
+        {
+            yojimbo_assert( index >= 0 );
+            yojimbo_assert( index < m_numMetrics );
+            yojimbo_assert( m_metric[index].type == METRIC_TYPE_COUNTER );
+            m_metric[index].count += value;
+        }
+
+        /// Set a gauge.
+
+        void SetGauge( int index, double value )
+        {
+            yojimbo_assert( index >= 0 );
+            yojimbo_assert( index < m_numMetrics );
+            yojimbo_assert( m_metric[index].type == METRIC_TYPE_GAUGE );
+            m_metric[index].value = value;
+        }
+
+        /// Count a value into a histogram.
+
+        void Observe( int index, double value )
+        {
+            yojimbo_assert( index >= 0 );
+            yojimbo_assert( index < m_numMetrics );
+            Metric & metric = m_metric[index];
+            yojimbo_assert( metric.type == METRIC_TYPE_HISTOGRAM );
+            int i = 0;
+            while ( i < metric.numBounds && value > metric.bound[i] )
+                i++;
+            metric.bucket[i]++;
+            metric.count++;
+            metric.value += value;
+        }
+
+        /**
+            Copy every metric into a snapshot.
+            @param snapshot The snapshot to fill [out].
+         */
+
+        void GetSnapshot( MetricsSnapshot & snapshot ) const;
+
+        /**
+            Zero every counter, gauge and histogram. The metrics stay defined.
+         */
+
+        void Reset();
+
+    private:
+
+        int AddMetric( const char * name, const char * help, MetricType type );
+
+        int m_numMetrics;                               ///< The number of metrics added.
+        Metric m_metric[MaxMetrics];                    ///< The metrics, in the order they were added.
+    };
+
+    /**
+        Indices of the metrics every client and server keeps.
+        @see RegisterConnectionMetrics
+     */
+
+    struct ConnectionMetrics
+    {
+        int packetsSent;                                ///< Counter: packets handed to netcode to send.
+        int packetsReceived;                            ///< Counter: packets received from netcode.
+        int decryptFailures;                            ///< Counter: packets netcode dropped because they failed to decrypt. Needs the vendored netcode: stays 0 when built with YOJIMBO_SYSTEM_DEPS.
+        int packetBytesSent;                            ///< Histogram: size of each packet sent, including the reliable header (bytes).
+        int packetBytesReceived;                        ///< Histogram: size of each packet received (bytes).
+        int channelBitsPerPacket;                       ///< Histogram: bits each channel with data wrote into a connection packet.
+        int messagesPerPacket;                          ///< Histogram: messages in each connection packet. Block fragments are not counted.
+        int sendQueueDepth;                             ///< Histogram: messages waiting in a connection's send queues after each send.
+        int sendQueueMessages;                          ///< Gauge: messages waiting in all send queues after the last send.
+        int connections;                                ///< Gauge: connected clients on a server, 1 or 0 on a client.
+        int receivePacketsTime;                         ///< Histogram: time spent in ReceivePackets (seconds).
+        int sendPacketsTime;                            ///< Histogram: time spent in SendPackets (seconds).
+        int advanceTimeTime;                            ///< Histogram: time spent in AdvanceTime (seconds).
+    };
+
+    /**
+        Add the built-in client and server metrics to a registry.
+        @param registry The registry to add to. Must have room for them.
+        @param metrics The indices of the added metrics [out].
+     */
+
+    void RegisterConnectionMetrics( MetricsRegistry & registry, ConnectionMetrics & metrics );
+
+    /**
+        Write a metrics snapshot as text.
+        Behaves like snprintf: the output is always NULL terminated, and the return value is the length of the full output, so you can size a buffer by calling with NULL and 0 first.
+        @param snapshot The snapshot to write.
+        @param format The text format.
+        @param buffer The buffer to write to. May be NULL if bufferSize is 0.
+        @param bufferSize The size of the buffer in bytes.
+        @returns The length of the full output, excluding the NULL terminator. If it is >= bufferSize, the output was truncated.
+     */
+
+    int WriteMetrics( const MetricsSnapshot & snapshot, MetricsFormat format, char * buffer, int bufferSize );
+
+    /**
+        Export a metrics snapshot to a file.
+        The text is written to a temporary file next to the file, then renamed over it, so a scraper reading the file never sees half an export.
+        @param snapshot The snapshot to export.
+        @param format The text format.
+        @param path The path of the file.
+        @returns True if the file was written.
+     */
+
+    bool ExportMetricsToFile( const MetricsSnapshot & snapshot, MetricsFormat format, const char * path );
+
+    /**
+        Export a metrics snapshot to a local collector listening on a unix domain stream socket.
+        Connects, sends the text and closes the connection. Not supported on windows.
+        @param snapshot The snapshot to export.
+        @param format The text format.
+        @param path The path of the socket.
+        @returns True if the text was sent. False if nothing is listening on the path.
+        @see yojimbo_local_socket_send
+     */
+
+    bool ExportMetricsToSocket( const MetricsSnapshot & snapshot, MetricsFormat format, const char * path );
+}
+
+#endif // #ifndef YOJIMBO_METRICS_H
@@ -0,0 +1,430 @@
+/*
+    Yojimbo Client/Server Network Library.
+
+    Copyright © 2016 - 2026, Más Bandwidth LLC.
+
+    Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+        1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+        2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+           in the documentation and/or other materials provided with the distribution.
+
+        3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived
+           from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+    INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+    SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+    USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef YOJIMBO_NETWORK_THREAD_H
+#define YOJIMBO_NETWORK_THREAD_H
+
+#include "yojimbo_config.h"
+#include "yojimbo_allocator.h"
+#include "yojimbo_queue.h"
+#include "yojimbo_message.h"
+#include "yojimbo_adapter.h"
+#include "yojimbo_address.h"
+#include "yojimbo_client_interface.h"
+#include <atomic>
+#include <thread>
+
+namespace yojimbo
+{
+    class Server;
+    class Client;
+
+    /// Network thread configuration.
+
+    struct NetworkThreadConfig
+    {
+        double updateInterval;                                  ///< Seconds between network thread updates. Each update receives packets, hands messages over in both directions and sends packets.
+        int sendQueueSize;                                      ///< Messages each channel can have waiting for the network thread to send them. Rounded up to a power of two.
+        int receiveQueueSize;                                   ///< Received messages each channel can have waiting for the game thread. Rounded up to a power of two.
+        int eventQueueSize;                                     ///< Connect and disconnect events that can be waiting for the game thread. Rounded up to a power of two.
+
+        NetworkThreadConfig()
+        {
+            updateInterval = 1.0 / 120.0;
+            sendQueueSize = 256;
+            receiveQueueSize = 256;
+            eventQueueSize = 64;
+        }
+    };
+
+    /// Network thread event types.
+
+    enum NetworkThreadEventType
+    {
+        NETWORK_THREAD_EVENT_CONNECTED,                         ///< A client connected. On the server, a client connected to the slot. On the client, the client connected to the server.
+        NETWORK_THREAD_EVENT_DISCONNECTED,                      ///< A client that was connected disconnected.
+    };
+
+    /**
+        A connect or disconnect seen by the network thread, passed to the game thread.
+        These replace Adapter::OnServerClientConnected and Adapter::OnServerClientDisconnected in threaded mode, which would otherwise be called on the network thread.
+     */
+
+    struct NetworkThreadEvent
+    {
+        NetworkThreadEventType type;                            ///< The event type.
+        int clientIndex;                                        ///< The client slot on the server. Always 0 on the client.
+        uint64_t clientId;                                      ///< The client id.
+        uint32_t generation;                                    ///< Counts connections to the slot. Messages queued for one connection are never delivered to the next.
+    };
+
+    /// A message in a network thread queue, tagged with the connection it belongs to.
+
+    struct NetworkThreadMessage
+    {
+        Message * message;                                      ///< The message. The queue holds the reference.
+        uint32_t generation;                                    ///< The connection generation the message was sent or received on.
+    };
+
+    /**
+        Wraps the game's adapter so allocators and message factories created for the client and server are safe to use from both threads.
+        Connect and disconnect callbacks are not forwarded. The network thread reports them as NetworkThreadEvent instead.
+     */
+
+    class NetworkThreadAdapter : public Adapter
+    {
+    public:
+
+        explicit NetworkThreadAdapter( Adapter & adapter ) : m_adapter( &adapter ) {}
+
+        Allocator * CreateAllocator( Allocator & allocator, void * memory, size_t bytes );
+
+        MessageFactory * CreateMessageFactory( Allocator & allocator );
+
+    private:
+
+        Adapter * m_adapter;                                    ///< The game's adapter.
+    };
+
+    /**
+        Runs client or server updates on a background thread.
+        The game thread hands messages to the network thread, and gets received messages back, through lock-free single producer single consumer queues: one pair per client slot and channel.
+        Messages and blocks are created and released through a message factory and allocator that take a lock, so either thread can release a message it was handed.
+        Don't use this class directly. Use ServerNetworkThread or ClientNetworkThread.
+     */
+
+    class NetworkThread
+    {
+    public:
+
+        NetworkThread( Allocator & allocator, int numChannels, const NetworkThreadConfig & config, double time );
+
+        virtual ~NetworkThread();
+
+        /**
+            Is the network thread running?
+            @returns True between starting and stopping the thread.
+         */
+
+        bool IsThreadRunning() const { return m_threadRunning; }
+
+        /**
+            Pop the next connect or disconnect event. Call this from the game thread every frame before receiving messages.
+            Messages received on a connection only come out of ReceiveMessage after its connect event has been popped here.
+            Messages still queued for a connection when its disconnect event is popped are released.
+            @param event The event [out].
+            @returns True if an event was popped, false if there are none.
+         */
+
+        bool ReceiveEvent( NetworkThreadEvent & event );
+
+        /**
+            Get the number of updates the network thread has run.
+            Safe to call from any thread.
+         */
+
+        uint64_t GetNumUpdates() const { return m_numUpdates.load( std::memory_order_relaxed ); }
+
+        /**
+            Get the allocator passed in to the constructor, wrapped so the game thread can share it with the network thread.
+         */
+
+        Allocator & GetAllocator() { return m_allocator; }
+
+    protected:
+
+        void CreateQueues( int numSlots );
+
+        void DestroyQueues();
+
+        void StartThread();
+
+        void StopThread();
+
+        bool IsSlotConnected( int slot ) const;
+
+        bool CanSendSlotMessage( int slot, int channelIndex );
+
+        bool SendSlotMessage( int slot, int channelIndex, Message * message );
+
+        Message * ReceiveSlotMessage( int slot, int channelIndex );
+
+        virtual void ReleaseSlotMessage( int slot, Message * message ) = 0;
+
+        virtual void ThreadReceivePackets( double time ) = 0;
+
+        virtual void ThreadSendPackets() = 0;
+
+        virtual bool ThreadIsSlotConnected( int slot ) = 0;
+
+        virtual uint64_t ThreadGetSlotClientId( int slot ) = 0;
+
+        virtual bool ThreadCanSendMessage( int slot, int channelIndex ) = 0;
+
+        virtual void ThreadSendMessage( int slot, int channelIndex, Message * message ) = 0;
+
+        virtual Message * ThreadReceiveMessage( int slot, int channelIndex ) = 0;
+
+        virtual void ThreadUpdateState() {}
+
+        LockedAllocator m_allocator;                            ///< The allocator passed in to the constructor, behind a lock.
+
+        NetworkThreadConfig m_config;                           ///< The network thread configuration.
+
+        double m_time;                                          ///< The time passed in to the constructor. Network thread time carries on from here.
+
+    private:
+
+        void ThreadMain();
+
+        void ThreadUpdateSlot( int slot );
+
+        void DrainSlot( int slot, uint32_t generation );
+
+        int m_numSlots;                                         ///< The number of client slots. 1 on the client.
+        int m_numChannels;                                      ///< The number of channels per slot, from the client/server config.
+        SpscQueue<NetworkThreadMessage> ** m_sendQueue;         ///< Game thread to network thread, indexed by slot * numChannels + channel.
+        SpscQueue<NetworkThreadMessage> ** m_receiveQueue;      ///< Network thread to game thread, indexed by slot * numChannels + channel.
+        SpscQueue<NetworkThreadEvent> * m_eventQueue;           ///< Network thread to game thread connect and disconnect events.
+
+        bool * m_gameConnected;                                 ///< Per-slot. Connected as far as the game thread has seen from events. Game thread only.
+        uint32_t * m_gameGeneration;                            ///< Per-slot. The generation of the game thread's view of the slot. Game thread only.
+        bool * m_threadConnected;                               ///< Per-slot. Connected as far as the network thread has reported. Network thread only.
+        uint64_t * m_threadClientId;                            ///< Per-slot. The client id the network thread reported connected. Network thread only.
+        uint32_t * m_threadGeneration;                          ///< Per-slot. Counts connections reported by the network thread. Network thread only.
+
+        std::thread m_thread;                                   ///< The network thread.
+        std::atomic<bool> m_quit;                               ///< Set by the game thread to stop the network thread.
+        std::atomic<uint64_t> m_numUpdates;                     ///< The number of updates run by the network thread.
+        bool m_threadRunning;                                   ///< True while the network thread is running.
+        double m_startWallTime;                                 ///< yojimbo_time when the thread was started.
+
+        NetworkThread( const NetworkThread & other );
+        NetworkThread & operator = ( const NetworkThread & other );
+    };
+
+    /**
+        A server that runs its updates on a network thread.
+        Start it, then from the game thread each frame pop events, receive messages from connected clients and send messages to them.
+        Don't call SendPackets, ReceivePackets or AdvanceTime: the network thread does that.
+        Loopback clients are not supported in threaded mode, and ClientServerConfig::serverLazyClientMemory is ignored: client slots stay committed.
+     */
+
+    class ServerNetworkThread : public NetworkThread
+    {
+    public:
+
+        ServerNetworkThread( Allocator & allocator, const uint8_t privateKey[], const Address & address, const ClientServerConfig & config, Adapter & adapter, double time, const NetworkThreadConfig & threadConfig = NetworkThreadConfig() );
+
+        ~ServerNetworkThread();
+
+        /**
+            Start the server and the network thread.
+            @param maxClients The maximum number of clients.
+         */
+
+        void Start( int maxClients );
+
+        /**
+            Stop the network thread, release any queued messages and stop the server.
+            Release any messages the game thread still holds first.
+         */
+
+        void Stop();
+
+        bool IsRunning() const { return IsThreadRunning(); }
+
+        int GetMaxClients() const { return m_maxClients; }
+
+        /**
+            Get the address the server is bound to. Valid after Start.
+         */
+
+        const Address & GetAddress() const;
+
+        /**
+            Is a client connected to the slot, as far as the game thread has seen from events?
+         */
+
+        bool IsClientConnected( int clientIndex ) const { return IsSlotConnected( clientIndex ); }
+
+        Message * CreateMessage( int clientIndex, int type );
+
+        uint8_t * AllocateBlock( int clientIndex, int bytes );
+
+        void AttachBlockToMessage( int clientIndex, Message * message, uint8_t * block, int bytes );
+
+        void FreeBlock( int clientIndex, uint8_t * block );
+
+        /**
+            Is there room to queue a message for the client on this channel?
+            @returns True if the client is connected and the send queue isn't full.
+         */
+
+        bool CanSendMessage( int clientIndex, int channelIndex ) { return CanSendSlotMessage( clientIndex, channelIndex ); }
+
+        /**
+            Queue a message for the network thread to send to the client.
+            The network thread holds messages back while the channel can't take them.
+            @returns True if the message was queued. False if the client isn't connected or the queue is full, in which case the message is released.
+         */
+
+        bool SendMessage( int clientIndex, int channelIndex, Message * message ) { return SendSlotMessage( clientIndex, channelIndex, message ); }
+
+        Message * ReceiveMessage( int clientIndex, int channelIndex ) { return ReceiveSlotMessage( clientIndex, channelIndex ); }
+
+        void ReleaseMessage( int clientIndex, Message * message ) { ReleaseSlotMessage( clientIndex, message ); }
+
+    protected:
+
+        void ReleaseSlotMessage( int slot, Message * message );
+
+        void ThreadReceivePackets( double time );
+
+        void ThreadSendPackets();
+
+        bool ThreadIsSlotConnected( int slot );
+
+        uint64_t ThreadGetSlotClientId( int slot );
+
+        bool ThreadCanSendMessage( int slot, int channelIndex );
+
+        void ThreadSendMessage( int slot, int channelIndex, Message * message );
+
+        Message * ThreadReceiveMessage( int slot, int channelIndex );
+
+    private:
+
+        NetworkThreadAdapter m_adapter;                         ///< Wraps the game's adapter.
+        Server * m_server;                                      ///< The server. Owned by the network thread while it runs.
+        int m_maxClients;                                       ///< The maximum number of clients passed in to Start.
+    };
+
+    /**
+        A client that runs its updates on a network thread.
+        Connect it, then from the game thread each frame pop events, and send and receive messages once connected.
+        Don't call SendPackets, ReceivePackets or AdvanceTime: the network thread does that.
+        Loopback is not supported in threaded mode.
+     */
+
+    class ClientNetworkThread : public NetworkThread
+    {
+    public:
+
+        ClientNetworkThread( Allocator & allocator, const Address & address, const ClientServerConfig & config, Adapter & adapter, double time, const NetworkThreadConfig & threadConfig = NetworkThreadConfig() );
+
+        ~ClientNetworkThread();
+
+        /**
+            Connect to a server without a connect token and start the network thread.
+            @see Client::InsecureConnect
+         */
+
+        void InsecureConnect( const uint8_t privateKey[], uint64_t clientId, const Address & address );
+
+        /**
+            Connect to a server with a connect token and start the network thread.
+            @see Client::Connect
+         */
+
+        void Connect( uint64_t clientId, uint8_t * connectToken );
+
+        /**
+            Stop the network thread, release any queued messages and disconnect.
+            Release any messages the game thread still holds first.
+         */
+
+        void Disconnect();
+
+        /**
+            Get the client state as of the last network thread update.
+            Safe to call from any thread.
+         */
+
+        ClientState GetClientState() const { return (ClientState) m_clientState.load( std::memory_order_acquire ); }
+
+        /**
+            Is the client connected, as far as the game thread has seen from events?
+         */
+
+        bool IsConnected() const { return IsSlotConnected( 0 ); }
+
+        Message * CreateMessage( int type );
+
+        uint8_t * AllocateBlock( int bytes );
+
+        void AttachBlockToMessage( Message * message, uint8_t * block, int bytes );
+
+        void FreeBlock( uint8_t * block );
+
+        /**
+            Is there room to queue a message on this channel?
+            @returns True if the client is connected and the send queue isn't full.
+         */
+
+        bool CanSendMessage( int channelIndex ) { return CanSendSlotMessage( 0, channelIndex ); }
+
+        /**
+            Queue a message for the network thread to send to the server.
+            The network thread holds messages back while the channel can't take them.
+            @returns True if the message was queued. False if the client isn't connected or the queue is full, in which case the message is released.
+         */
+
+        bool SendMessage( int channelIndex, Message * message ) { return SendSlotMessage( 0, channelIndex, message ); }
+
+        Message * ReceiveMessage( int channelIndex ) { return ReceiveSlotMessage( 0, channelIndex ); }
+
+        void ReleaseMessage( Message * message ) { ReleaseSlotMessage( 0, message ); }
+
+    protected:
+
+        void ReleaseSlotMessage( int slot, Message * message );
+
+        void ThreadReceivePackets( double time );
+
+        void ThreadSendPackets();
+
+        bool ThreadIsSlotConnected( int slot );
+
+        uint64_t ThreadGetSlotClientId( int slot );
+
+        bool ThreadCanSendMessage( int slot, int channelIndex );
+
+        void ThreadSendMessage( int slot, int channelIndex, Message * message );
+
+        Message * ThreadReceiveMessage( int slot, int channelIndex );
+
+        void ThreadUpdateState();
+
+    private:
+
+        void StartConnected();
+
+        NetworkThreadAdapter m_adapter;                         ///< Wraps the game's adapter.
+        Client * m_client;                                      ///< The client. Owned by the network thread while it runs.
+        std::atomic<int> m_clientState;                         ///< The client state as of the last network thread update.
+    };
+}
+
+#endif // #ifndef YOJIMBO_NETWORK_THREAD_H
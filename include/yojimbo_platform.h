@@ -44,6 +44,109 @@ void yojimbo_sleep( double time );
 
 double yojimbo_time();
 
+/**
+    Get the virtual memory page size.
+    @returns The page size in bytes.
+ */
+
+size_t yojimbo_memory_page_size();
+
+/**
+    Reserve a range of address space without committing memory to it.
+    The range can't be accessed until it is committed with yojimbo_memory_commit.
+    @param bytes The size of the range. A multiple of the page size.
+    @returns The start of the range, aligned to the page size, or NULL if the address space could not be reserved.
+ */
+
+void * yojimbo_memory_reserve( size_t bytes );
+
+/**
+    Commit part of a reserved range so it can be read and written.
+    Physical memory is only taken as pages are first touched.
+    @param memory The start of the part to commit. Aligned to the page size.
+    @param bytes The size of the part. A multiple of the page size.
+    @returns True if the memory was committed.
+ */
+
+bool yojimbo_memory_commit( void * memory, size_t bytes );
+
+/**
+    Give the physical memory behind part of a reserved range back to the OS.
+    The part stays reserved and can be committed again, but its contents are lost and it can't be accessed until then.
+    @param memory The start of the part to decommit. Aligned to the page size.
+    @param bytes The size of the part. A multiple of the page size.
+ */
+
+void yojimbo_memory_decommit( void * memory, size_t bytes );
+
+/**
+    Release a range reserved with yojimbo_memory_reserve.
+    @param memory The start of the range.
+    @param bytes The size passed to yojimbo_memory_reserve.
+ */
+
+void yojimbo_memory_release( void * memory, size_t bytes );
+
+/**
+    Count the bytes of a range of memory that are backed by physical memory.
+    Works on any mapped memory, not just reserved ranges. Where the OS can't report resident pages, committed pages are counted instead.
+    @param memory The start of the range. Need not be aligned.
+    @param bytes The size of the range.
+    @returns The number of bytes in the pages touching the range that are resident.
+ */
+
+size_t yojimbo_memory_resident( const void * memory, size_t bytes );
+
+/**
+    Get the huge page size.
+    @returns The size of the huge pages yojimbo_memory_map asks for (bytes), or 0 if the platform has none.
+ */
+
+size_t yojimbo_memory_huge_page_size();
+
+/**
+    Map a range of committed, zeroed memory, optionally backed by huge pages and bound to a NUMA node.
+    On linux, huge pages come from the hugetlbfs pool (MAP_HUGETLB) if it has enough free, otherwise the range is aligned to the huge page size and transparent huge pages are requested for it.
+    On windows, large pages need the "lock pages in memory" privilege. Without it, normal pages are used.
+    @param bytes The size of the range. A multiple of the page size, and of the huge page size if hugePages is true.
+    @param hugePages True to ask for huge pages. If none are available the range is still mapped, with normal pages.
+    @param numaNode The NUMA node to take physical memory from, or -1 to leave it to the OS.
+    @returns The start of the range, or NULL if it could not be mapped. Release it with yojimbo_memory_release.
+ */
+
+void * yojimbo_memory_map( size_t bytes, bool hugePages, int numaNode );
+
+/**
+    Set the huge page and NUMA policy for pages of a reserved range that are not yet touched.
+    Call this after yojimbo_memory_commit. Decommitting drops the policy, so set it again after each commit.
+    Huge pages here are always transparent huge pages. Does nothing on platforms without them.
+    @param memory The start of the range. Aligned to the page size.
+    @param bytes The size of the range. A multiple of the page size.
+    @param hugePages True to ask for huge pages.
+    @param numaNode The NUMA node to take physical memory from, or -1 to leave it to the OS.
+ */
+
+void yojimbo_memory_set_policy( void * memory, size_t bytes, bool hugePages, int numaNode );
+
+/**
+    Get the NUMA node of the CPU the calling thread is running on.
+    Call it from the thread that will run a server and set ClientServerConfig::serverNumaNode to the result, so the server's heaps sit next to the thread.
+    @returns The NUMA node, or -1 if it can't be found.
+ */
+
+int yojimbo_memory_numa_node();
+
+/**
+    Connect to a local (unix domain) stream socket, send a block of data and close the connection.
+    Used to push metrics to a local collector. Not supported on windows.
+    @param path The path of the socket.
+    @param data The data to send.
+    @param bytes The number of bytes to send.
+    @returns True if all the data was sent. False if nothing is listening on the path, or the send failed.
+ */
+
+bool yojimbo_local_socket_send( const char * path, const void * data, size_t bytes );
+
 #define YOJIMBO_LOG_LEVEL_NONE      0
 #define YOJIMBO_LOG_LEVEL_ERROR     1
 #define YOJIMBO_LOG_LEVEL_INFO      2
@@ -26,6 +26,7 @@
 #define YOJIMBO_QUEUE_H
 
 #include "yojimbo_config.h"
+#include <atomic>
 
 namespace yojimbo
 {
@@ -189,6 +190,145 @@ namespace yojimbo
         int m_startIndex;                               ///< The start index for the queue. This is the next value that gets popped off.
         int m_numEntries;                               ///< The number of entries currently stored in the queue.
     };
+
+    /**
+        A lock-free single producer, single consumer queue.
+        One thread pushes and one other thread pops. Neither side ever blocks: a push to a full queue or a pop from an empty queue fails and returns false.
+        The producer and consumer indices sit on separate cache lines, and each side caches the other's index so it only touches the shared line when it thinks the queue is full or empty.
+        Values are copied in and out, so T should be small and trivially copyable, such as a pointer and a tag.
+     */
+
+    template <typename T> class SpscQueue
+    {
+    public:
+
+        /**
+            SPSC queue constructor.
+            @param allocator The allocator to use.
+            @param size The minimum number of entries in the queue. Rounded up to a power of two.
+         */
+
+        SpscQueue( Allocator & allocator, int size )
+        {
+            yojimbo_assert( size > 0 );
+            uint32_t arraySize = 1;
+            while ( arraySize < uint32_t( size ) )
+                arraySize <<= 1;
+            m_allocator = &allocator;
+            m_entries = (T*) YOJIMBO_ALLOCATE( allocator, sizeof(T) * arraySize );
+            memset( m_entries, 0, sizeof(T) * arraySize );
+            m_mask = arraySize - 1;
+            m_head.store( 0, std::memory_order_relaxed );
+            m_tail.store( 0, std::memory_order_relaxed );
+            m_cachedHead = 0;
+            m_cachedTail = 0;
+        }
+
+        /**
+            SPSC queue destructor.
+            Neither thread may be using the queue.
+         */
+
+        ~SpscQueue()
+        {
+            yojimbo_assert( m_allocator );
+            YOJIMBO_FREE( *m_allocator, m_entries );
+            m_allocator = NULL;
+        }
+
+        /**
+            Push a value on to the queue. Call from the producer thread only.
+            @param value The value to push.
+            @returns True if the value was pushed, false if the queue is full.
+         */
+
+        bool Push( const T & value )
+        {
+            const uint32_t tail = m_tail.load( std::memory_order_relaxed );
+            if ( tail - m_cachedHead > m_mask )
+            {
+                m_cachedHead = m_head.load( std::memory_order_acquire );
+                if ( tail - m_cachedHead > m_mask )
+                    return false;
+            }
+            m_entries[tail & m_mask] = value;
+            m_tail.store( tail + 1, std::memory_order_release );
+            return true;
+        }
+
+        /**
+            Pop a value off the queue. Call from the consumer thread only.
+            @param value The oldest value in the queue [out].
+            @returns True if a value was popped, false if the queue is empty.
+         */
+
+        bool Pop( T & value )
+        {
+            if ( !Peek( value ) )
+                return false;
+            m_head.store( m_head.load( std::memory_order_relaxed ) + 1, std::memory_order_release );
+            return true;
+        }
+
+        /**
+            Look at the oldest value in the queue without popping it. Call from the consumer thread only.
+            @param value The oldest value in the queue [out].
+            @returns True if there is a value, false if the queue is empty.
+         */
+
+        bool Peek( T & value )
+        {
+            const uint32_t head = m_head.load( std::memory_order_relaxed );
+            if ( head == m_cachedTail )
+            {
+                m_cachedTail = m_tail.load( std::memory_order_acquire );
+                if ( head == m_cachedTail )
+                    return false;
+            }
+            value = m_entries[head & m_mask];
+            return true;
+        }
+
+        /**
+            Is the queue full? Call from the producer thread only.
+            The consumer may pop at any time, so a full queue can stop being full straight after this returns.
+            @returns True if a push would fail.
+         */
+
+        bool IsFull()
+        {
+            const uint32_t tail = m_tail.load( std::memory_order_relaxed );
+            if ( tail - m_cachedHead > m_mask )
+                m_cachedHead = m_head.load( std::memory_order_acquire );
+            return tail - m_cachedHead > m_mask;
+        }
+
+        /**
+            Get the size of the queue.
+            @returns The maximum number of values the queue can hold.
+         */
+
+        int GetSize() const
+        {
+            return int( m_mask + 1 );
+        }
+
+    private:
+
+        Allocator * m_allocator;                        ///< The allocator passed in to the constructor.
+        T * m_entries;                                  ///< Array of entries backing the queue (circular buffer).
+        uint32_t m_mask;                                ///< The size of the array minus one. The size is a power of two.
+        uint8_t m_pad0[64];                             ///< Keeps the producer index off the cache line of the consumer index.
+        std::atomic<uint32_t> m_tail;                   ///< Index of the next entry to push. Written by the producer.
+        uint32_t m_cachedHead;                          ///< The producer's last read of m_head.
+        uint8_t m_pad1[64];                             ///< Keeps the consumer index off the cache line of the producer index.
+        std::atomic<uint32_t> m_head;                   ///< Index of the next entry to pop. Written by the consumer.
+        uint32_t m_cachedTail;                          ///< The consumer's last read of m_tail.
+        uint8_t m_pad2[64];                             ///< Keeps the consumer index off whatever follows the queue.
+
+        SpscQueue( const SpscQueue<T> & other );
+        SpscQueue<T> & operator = ( const SpscQueue<T> & other );
+    };
 }
 
 #endif // #ifndef YOJIMBO_QUEUE_H
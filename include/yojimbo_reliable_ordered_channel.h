@@ -29,6 +29,7 @@
 #include "yojimbo_channel.h"
 #include "yojimbo_bit_array.h"
 #include "yojimbo_sequence_buffer.h"
+#include "yojimbo_queue.h"
 
 namespace yojimbo
 {
@@ -37,7 +38,9 @@ namespace yojimbo
         This channel type is best used for control messages and RPCs.
         Messages sent over this channel are included in connection packets until one of those packets is acked. Messages are acked individually and remain in the send queue until acked.
         Blocks attached to messages sent over this channel are split up into fragments. Each fragment of the block is included in a connection packet until one of those packets are acked. Eventually, all fragments are received on the other side, and block is reassembled and attached to the message.
-        Only one message block may be in flight over the network at any time, so blocks stall out message delivery slightly. Therefore, only use blocks for large data that won't fit inside a single connection packet where you actually need the channel to split it up into fragments. If your block fits inside a packet, just serialize it inside your message serialize via serialize_bytes instead.
+        Up to ChannelConfig::maxFragmentsPerPacket fragments go out in each packet, and up to ChannelConfig::maxBlocksInFlight consecutive block messages are sent at the same time. Unacked fragments are resent based on the round trip time measured from the channel's own acks.
+        Regular messages queued behind a block wait until the block has been received, so blocks stall out message delivery slightly. Therefore, only use blocks for large data that won't fit inside a single connection packet where you actually need the channel to split it up into fragments. If your block fits inside a packet, just serialize it inside your message serialize via serialize_bytes instead.
+        This class also implements CHANNEL_TYPE_RELIABLE_UNORDERED. The send side is identical, but received messages are delivered as soon as they arrive rather than in message id order, so one lost packet doesn't hold up every message behind it. Duplicates are suppressed with a window of received message ids that slides forward as the oldest missing message arrives.
      */
 
     class ReliableOrderedChannel : public Channel
@@ -78,6 +81,8 @@ namespace yojimbo
 
         void ProcessAck( uint16_t ack );
 
+        void ProcessAcks( const uint16_t * acks, int numAcks );
+
         /**
             Are there any unacked messages in the send queue?
             Messages are acked individually and remain in the send queue until acked.
@@ -86,12 +91,15 @@ namespace yojimbo
 
         bool HasMessagesToSend() const;
 
+        int GetSendQueueDepth() const;
+
         /**
             Get messages to include in a packet.
             Messages are measured to see how many bits they take, and only messages that fit within the channel packet budget will be included. See ChannelConfig::packetBudget.
             Takes care not to send messages too rapidly by respecting ChannelConfig::messageResendTime for each message, and to only include messages that that the receiver is able to buffer in their receive queue. In other words, won't run ahead of the receiver.
             @param messageIds Array of message ids to be filled [out]. Fills up to ChannelConfig::maxMessagesPerPacket messages, make sure your array is at least this size.
             @param numMessageIds The number of message ids written to the array.
+            Only visits messages that can go out: resends that are due, oldest first, then messages not sent yet, in message id order. See m_sentList and m_unsentList.
             @param remainingPacketBits Number of bits remaining in the packet. Considers this as a hard limit when determining how many messages can fit into the packet.
             @returns Estimate of the number of bits required to serialize the messages (upper bound).
             @see GetMessagePacketData
@@ -130,6 +138,17 @@ namespace yojimbo
 
         void ProcessPacketMessages( int numMessages, Message ** messages );
 
+        /**
+            Add a received message to the receive queue.
+            For a reliable-ordered channel the message waits in the receive queue until every message before it has been received.
+            For a reliable-unordered channel the message is marked as received in the receive window (for duplicate suppression) and is made available to ReceiveMessage immediately.
+            Takes over one reference to the message. The caller is responsible for adding that reference if it needs to keep its own.
+            @param message The message to add. Its message id must be inside the receive window and not already received.
+            @returns True if the message was added, false if the channel went into an error state.
+         */
+
+        bool AddReceivedMessage( Message * message );
+
         /**
             Track the oldest unacked message id in the send queue.
             Because messages are acked individually, the send queue is not a true queue and may have holes.
@@ -140,98 +159,136 @@ namespace yojimbo
 
         void UpdateOldestUnackedMessageId();
 
+        /**
+            Ack the messages and block fragments included in a sent connection packet.
+            Removes acked messages from the send queue, but leaves the oldest unacked message id for the caller to update, so a batch of acks only walks the send queue once.
+            @param ack The sequence number of the acked connection packet.
+            @returns True if any message left the send queue.
+         */
+
+        bool AckPacket( uint16_t ack );
+
         /**
             True if we are currently sending a block message.
             Block messages are treated differently to regular messages.
             Regular messages are small so we try to fit as many into the packet we can. See ReliableChannelData::GetMessagesToSend.
             Blocks attached to block messages are usually larger than the maximum packet size or channel budget, so they are split up fragments.
-            While in the mode of sending a block message, each channel packet data generated has exactly one fragment from the current block in it. Fragments keep getting included in packets until all fragments of that block are acked.
+            While the oldest unacked message is a block message, each channel packet data generated holds fragments from the blocks in flight. Fragments keep getting included in packets until all fragments of that block are acked.
             @returns True if currently sending a block message over the network, false otherwise.
             @see BlockMessage
-            @see GetFragmentToSend
+            @see GetBlockPacketData
          */
 
         bool SendingBlockMessage();
 
         /**
-            Get the next block fragment to send.
-            The next block fragment is selected by scanning left to right over the set of fragments in the block, skipping over any fragments that have already been acked or have been sent within ChannelConfig::fragmentResendTime.
-            @param messageId The id of the message that the block is attached to [out].
-            @param fragmentId The id of the fragment to send [out].
-            @param fragmentBytes The size of the fragment in bytes.
-            @param numFragments The total number of fragments in this block.
-            @param messageType The type of message the block is attached to. See MessageFactory.
-            @returns Pointer to the fragment data.
+            Fill the packet data with block fragments.
+            Walks the blocks in flight (consecutive block messages starting at the oldest unacked message, up to ChannelConfig::maxBlocksInFlight) and picks fragments that are not acked and are due to be resent, until the packet is full or ChannelConfig::maxFragmentsPerPacket fragments are picked.
+            @param packetData The packet data to fill [out].
+            @param packetSequence The sequence number of the connection packet being generated.
+            @param availableBits Number of bits remaining in the packet.
+            @returns An estimate of the number of bits required to serialize the fragments (upper bound), or 0 if there is no fragment to send.
          */
 
-        uint8_t * GetFragmentToSend( uint16_t & messageId, uint16_t & fragmentId, int & fragmentBytes, int & numFragments, int & messageType );
+        int GetBlockPacketData( ChannelPacketData & packetData, uint16_t packetSequence, int availableBits );
 
         /**
-            Fill the packet data with block and fragment data.
-            This is the payload function that fills the channel packet data while we are sending a block message.
-            @param packetData The packet data to fill [out]
-            @param messageId The id of the message that the block is attached to.
-            @param fragmentId The id of the block fragment being sent.
-            @param fragmentData The fragment data.
-            @param fragmentSize The size of the fragment data (bytes).
-            @param numFragments The number of fragments in the block.
-            @param messageType The type of message the block is attached to.
-            @returns An estimate of the number of bits required to serialize the block message and fragment data (upper bound).
+            Get how long an unacked fragment waits before it is resent.
+            This is ChannelConfig::blockFragmentResendTime until there is a round trip time estimate, then 1.5x the smoothed round trip time.
+            @returns The fragment resend time (seconds).
          */
 
-        int GetFragmentPacketData( ChannelPacketData & packetData,
-                                   uint16_t messageId,
-                                   uint16_t fragmentId,
-                                   uint8_t * fragmentData,
-                                   int fragmentSize,
-                                   int numFragments,
-                                   int messageType );
+        double GetFragmentResendTime() const;
 
         /**
-            Adds a packet entry for the fragment.
-            This lets us look up the fragment that was in the packet later on when it is acked, so we can ack that block fragment.
-            @param messageId The message id that the block was attached to.
-            @param fragmentId The fragment id.
-            @param sequence The sequence number of the packet the fragment was included in.
+            Adds a packet entry for the fragments included in a packet.
+            This lets us look up the fragments that were in the packet later on when it is acked, so we can ack those block fragments.
+            @param numFragments The number of fragments in the packet.
+            @param sequence The sequence number of the packet the fragments were included in.
+            @see m_packetFragments
          */
 
-        void AddFragmentPacketEntry( uint16_t messageId, uint16_t fragmentId, uint16_t sequence );
+        void AddFragmentPacketEntry( int numFragments, uint16_t sequence );
 
         /**
             Process a packet fragment.
-            The fragment is added to the set of received fragments for the block. When all packet fragments are received, that block is reconstructed, attached to the block message and added to the message receive queue.
-            @param messageType The type of the message this block fragment is attached to. This is used to make sure this message type actually allows blocks to be attached to it.
-            @param messageId The id of the message the block fragment belongs to.
-            @param numFragments The number of fragments in the block.
-            @param fragmentId The id of the fragment in [0,numFragments-1].
-            @param fragmentData The fragment data.
-            @param fragmentBytes The size of the fragment data in bytes.
-            @param blockMessage Pointer to the block message. Passed this in only with the first fragment (0), pass NULL for all other fragments.
-         */
-
-        void ProcessPacketFragment( int messageType,
-                                    uint16_t messageId,
-                                    int numFragments,
-                                    uint16_t fragmentId,
-                                    const uint8_t * fragmentData,
-                                    int fragmentBytes,
-                                    BlockMessage * blockMessage );
+            The fragment is added to the set of received fragments for its block. When all packet fragments are received, that block is attached to the block message and added to the message receive queue.
+            @param block The fragment, as read from the packet.
+         */
+
+        void ProcessPacketFragment( const ChannelPacketData::BlockData & block );
+
+        /**
+            Set the function that receives the data of streamed blocks sent to this channel.
+            Streamed blocks that arrive while no function is set put the channel into an error state.
+            @param function The stream write function. NULL to clear it.
+            @param context Passed to the stream write function.
+            @see BlockMessage::AttachBlockStream
+         */
+
+        void SetBlockStreamWriteFunction( BlockStreamWriteFunction function, void * context );
 
     protected:
 
         /**
             An entry in the send queue of the reliable-ordered channel.
             Messages stay into the send queue until acked. Each message is acked individually, so there can be "holes" in the message send queue.
+            Every entry is also linked into one of two lists, so packets can be built without scanning the send queue: the unsent list while the message has never been sent (block messages stay on it), and the sent list after.
          */
 
         struct MessageSendQueueEntry
         {
             Message * message;                                                          ///< Pointer to the message. When inserted in the send queue the message has one reference. It is released when the message is acked and removed from the send queue.
-            double timeLastSent;                                                        ///< The time the message was last sent. Used to implement ChannelConfig::messageResendTime.
+            double timeLastSent;                                                        ///< The time the message was last sent. Used to implement ChannelConfig::messageResendTime. Negative if the message has not been sent yet.
             uint32_t measuredBits : 31;                                                 ///< The number of bits the message takes up in a bit stream.
             uint32_t block : 1;                                                         ///< 1 if this is a block message. Block messages are treated differently to regular messages when sent over a reliable-ordered channel.
+            int prevIndex;                                                              ///< Send queue index of the previous entry in the same list. -1 if this is the first.
+            int nextIndex;                                                              ///< Send queue index of the next entry in the same list. -1 if this is the last.
+        };
+
+        /**
+            A list of send queue entries, linked through their send queue indices.
+         */
+
+        struct SendList
+        {
+            int head;                                                                   ///< Send queue index of the first entry. -1 if the list is empty.
+            int tail;                                                                   ///< Send queue index of the last entry. -1 if the list is empty.
         };
 
+        /**
+            Add a send queue entry to the end of a list.
+            @param list The list.
+            @param index The send queue index of the entry. It must not be on a list already.
+         */
+
+        void LinkSendQueueEntry( SendList & list, int index );
+
+        /**
+            Remove a send queue entry from a list.
+            @param list The list the entry is on.
+            @param index The send queue index of the entry.
+         */
+
+        void UnlinkSendQueueEntry( SendList & list, int index );
+
+        /**
+            Measure a message id written relative to the message id before it in the packet.
+            @param previousMessageId The message id written before it.
+            @param messageId The message id.
+            @param context The serialization context.
+            @returns The number of bits the relative message id takes.
+         */
+
+        int GetRelativeMessageIdBits( uint16_t previousMessageId, uint16_t messageId, void * context ) const;
+
+        /**
+            Remove an acked message from the send queue, and from whichever list it is on, and release it.
+            @param messageId The message id. It must be in the send queue.
+         */
+
+        void RemoveSentMessage( uint16_t messageId );
+
         /**
             An entry in the receive queue of the reliable-ordered channel.
          */
@@ -241,6 +298,16 @@ namespace yojimbo
             Message * message;                                                          ///< The message pointer. Has at a reference count of at least 1 while in the receive queue. Ownership of the message is passed back to the caller when the message is dequeued.
         };
 
+        /**
+            A block fragment included in a sent packet.
+         */
+
+        struct SentFragmentEntry
+        {
+            uint16_t messageId;                                                         ///< The id of the message the block is attached to.
+            uint32_t fragmentId;                                                        ///< The fragment id.
+        };
+
         /**
             Maps packet level acks to messages and fragments for the reliable-ordered channel.
          */
@@ -249,28 +316,30 @@ namespace yojimbo
         {
             double timeSent;                                                            ///< The time the packet was sent. Used to estimate round trip time.
             uint16_t * messageIds;                                                      ///< Pointer to an array of message ids. Dynamically allocated because the user can configure the maximum number of messages in a packet per-channel with ChannelConfig::maxMessagesPerPacket.
+            SentFragmentEntry * fragments;                                              ///< Pointer to an array of block fragments. Dynamically allocated because the user can configure the maximum number of fragments in a packet per-channel with ChannelConfig::maxFragmentsPerPacket.
             uint32_t numMessageIds : 16;                                                ///< The number of message ids in in the array.
             uint32_t acked : 1;                                                         ///< 1 if this packet has been acked.
-            uint64_t block : 1;                                                         ///< 1 if this packet contains a fragment of a block message.
-            uint64_t blockMessageId : 16;                                               ///< The block message id. Valid only if "block" is 1.
-            uint64_t blockFragmentId : 16;                                              ///< The block fragment id. Valid only if "block" is 1.
+            uint32_t block : 1;                                                         ///< 1 if this packet contains block fragments.
+            uint16_t numFragments;                                                      ///< The number of block fragments in the array. Valid only if "block" is 1.
         };
 
         /**
             Internal state for a block being sent across the reliable ordered channel.
-            Stores the block data and tracks which fragments have been acked. The block send completes when all fragments have been acked.
-            IMPORTANT: Although there can be multiple block messages in the message send and receive queues, only one data block can be in flights over the wire at a time.
+            Tracks which fragments have been acked. The block send completes when all fragments have been acked.
+            There is one per block in flight, see ChannelConfig::maxBlocksInFlight.
+            For a streamed block only the window of ChannelConfig::streamWindowSize fragments starting at baseFragment is tracked, indexed by fragment id modulo the window size.
          */
 
         struct SendBlockData
         {
-            SendBlockData( Allocator & allocator, int maxFragmentsPerBlock )
+            SendBlockData( Allocator & allocator, int maxFragments )
             {
                 m_allocator = &allocator;
-                ackedFragment = YOJIMBO_NEW( allocator, BitArray, allocator, maxFragmentsPerBlock );
-                fragmentSendTime = (double*) YOJIMBO_ALLOCATE( allocator, sizeof( double) * maxFragmentsPerBlock );
+                ackedFragment = YOJIMBO_NEW( allocator, BitArray, allocator, maxFragments );
+                fragmentSendTime = (double*) YOJIMBO_ALLOCATE( allocator, sizeof( double) * maxFragments );
                 yojimbo_assert( ackedFragment );
                 yojimbo_assert( fragmentSendTime );
+                compressedData = NULL;
                 Reset();
             }
 
@@ -278,19 +347,35 @@ namespace yojimbo
             {
                 YOJIMBO_DELETE( *m_allocator, BitArray, ackedFragment );
                 YOJIMBO_FREE( *m_allocator, fragmentSendTime );
+                YOJIMBO_FREE( *m_allocator, compressedData );
             }
 
             void Reset()
             {
+                YOJIMBO_FREE( *m_allocator, compressedData );
+                uncompressedSize = 0;
                 active = false;
+                stream = false;
                 numFragments = 0;
                 numAckedFragments = 0;
+                baseFragment = 0;
                 blockMessageId = 0;
                 blockSize = 0;
+                streamSize = 0;
+            }
+
+            int GetFragmentIndex( int fragmentId, int streamWindowSize ) const
+            {
+                return stream ? fragmentId % streamWindowSize : fragmentId;
             }
 
             bool active;                                                                ///< True if we are currently sending a block.
-            int blockSize;                                                              ///< The size of the block (bytes).
+            bool stream;                                                                ///< True if this is a streamed block.
+            int blockSize;                                                              ///< The size of the block as sent (bytes), after compression if the block is compressed. 0 for a streamed block.
+            int uncompressedSize;                                                       ///< The size of the block before compression (bytes). 0 if the block is sent as-is.
+            uint8_t * compressedData;                                                   ///< The compressed block. NULL if the block is sent as-is. See ChannelConfig::compressBlocks.
+            uint64_t streamSize;                                                        ///< The size of the stream (bytes). 0 for a block.
+            int baseFragment;                                                           ///< The oldest unacked fragment of a streamed block. Fragments from here to the end of the stream window are sent.
             int numFragments;                                                           ///< Number of fragments in the block being sent.
             int numAckedFragments;                                                      ///< Number of acked fragments in the block being sent.
             uint16_t blockMessageId;                                                    ///< The message id the block is attached to.
@@ -309,45 +394,61 @@ namespace yojimbo
         /**
             Internal state for a block being received across the reliable ordered channel.
             Stores the fragments received over the network for the block, and completes once all fragments have been received.
-            IMPORTANT: Although there can be multiple block messages in the message send and receive queues, only one data block can be in flight over the wire at a time.
+            There is one per block in flight, see ChannelConfig::maxBlocksInFlight. The block data is allocated from the message factory allocator when the first fragment arrives,
+            sized for the number of fragments in the block, and is handed over to the block message when the block completes. The channel frees it on reset.
+            A streamed block instead holds a window of ChannelConfig::streamWindowSize fragments starting at baseFragment, indexed by fragment id modulo the window size. Fragments are written out
+            to the stream write function in order as the window fills, and the message is delivered once the whole stream has been written.
          */
 
         struct ReceiveBlockData
         {
-            ReceiveBlockData( Allocator & allocator, int maxBlockSize, int maxFragmentsPerBlock )
+            ReceiveBlockData( Allocator & allocator, int maxFragments, int streamWindowSize )
             {
                 m_allocator = &allocator;
-                receivedFragment = YOJIMBO_NEW( allocator, BitArray, allocator, maxFragmentsPerBlock );
-                blockData = (uint8_t*) YOJIMBO_ALLOCATE( allocator, maxBlockSize );
-                yojimbo_assert( receivedFragment && blockData );
+                receivedFragment = YOJIMBO_NEW( allocator, BitArray, allocator, maxFragments );
+                yojimbo_assert( receivedFragment );
+                fragmentBytes = streamWindowSize > 0 ? (uint16_t*) YOJIMBO_ALLOCATE( allocator, sizeof( uint16_t ) * streamWindowSize ) : NULL;
+                blockData = NULL;
                 blockMessage = NULL;
                 Reset();
             }
 
             ~ReceiveBlockData()
             {
+                yojimbo_assert( !blockData );
                 YOJIMBO_DELETE( *m_allocator, BitArray, receivedFragment );
-                YOJIMBO_FREE( *m_allocator, blockData );
+                YOJIMBO_FREE( *m_allocator, fragmentBytes );
             }
 
             void Reset()
             {
                 active = false;
+                stream = false;
+                streamSize = 0;
+                baseFragment = 0;
                 numFragments = 0;
                 numReceivedFragments = 0;
                 messageId = 0;
                 messageType = 0;
+                uncompressedSize = 0;
                 blockSize = 0;
+                blockDataSize = 0;
             }
 
             bool active;                                                                ///< True if we are currently receiving a block.
-            int numFragments;                                                           ///< The number of fragments in this block
+            bool stream;                                                                ///< True if this is a streamed block.
+            uint64_t streamSize;                                                        ///< The size of the stream (bytes). 0 until fragment 0 of a streamed block arrives.
+            int baseFragment;                                                           ///< The next fragment of a streamed block to be written out.
+            uint16_t * fragmentBytes;                                                   ///< The size of each fragment held in the stream window. NULL if streams are disabled.
+            int numFragments;                                                           ///< The number of fragments in this block. For a streamed block, 0 until fragment 0 arrives.
             int numReceivedFragments;                                                   ///< The number of fragments received.
             uint16_t messageId;                                                         ///< The message id corresponding to the block.
             int messageType;                                                            ///< Message type of the block being received.
+            int uncompressedSize;                                                       ///< The size of the block once decompressed (bytes), from fragment 0. 0 if the block was sent as-is.
             uint32_t blockSize;                                                         ///< Block size in bytes.
             BitArray * receivedFragment;                                                ///< Has fragment n been received?
-            uint8_t * blockData;                                                        ///< Block data for receive.
+            uint8_t * blockData;                                                        ///< Block data for receive. NULL until the first fragment arrives.
+            int blockDataSize;                                                          ///< Size of the allocated block data (bytes).
             BlockMessage * blockMessage;                                                ///< Block message (sent with fragment 0).
 
         private:
@@ -359,18 +460,81 @@ namespace yojimbo
             ReceiveBlockData & operator = ( const ReceiveBlockData & other );
         };
 
+        /**
+            Get the send state for a block message, starting to send it if it isn't in flight yet.
+            @param messageId The id of the block message. It must be in the send queue.
+            @returns The send state for the block.
+         */
+
+        SendBlockData * StartSendingBlock( uint16_t messageId );
+
+        /**
+            Compress a block that is starting to send, if the channel compresses blocks and it gets smaller.
+            Leaves the block to be sent as-is otherwise, including when the compressed copy can't be allocated.
+            @param sendBlock The send state of the block.
+            @param blockMessage The block message.
+         */
+
+        void CompressBlock( SendBlockData & sendBlock, BlockMessage & blockMessage );
+
+        /**
+            Decompress a block once all of its fragments have arrived.
+            @param receiveBlock The receive state of the block. On success its block data is replaced with the decompressed block.
+            @returns True if successful. False if the block could not be decompressed, in which case the channel error level is set.
+         */
+
+        bool DecompressBlock( ReceiveBlockData & receiveBlock );
+
+        /**
+            Fill block data for a single fragment.
+            The fragment data is copied from the block, or read from the stream, and the block message has a reference added if this is fragment 0 (it carries the message).
+            @param block The block data to fill [out].
+            @param sendBlock The send state of the block the fragment belongs to.
+            @param fragmentId The id of the fragment.
+            @returns True if successful. False if the fragment data could not be allocated or read from the stream, in which case the channel error level is set.
+         */
+
+        bool GetFragmentData( ChannelPacketData::BlockData & block, const SendBlockData & sendBlock, int fragmentId );
+
+        /**
+            Get the size of a fragment.
+            @param sendBlock The send state of the block.
+            @param fragmentId The id of the fragment.
+            @returns The size of the fragment in bytes. Only the last fragment may be smaller than ChannelConfig::blockFragmentSize.
+         */
+
+        int GetFragmentBytes( const SendBlockData & sendBlock, int fragmentId ) const;
+
+        /**
+            Process a fragment of a streamed block.
+            Fragments inside the stream window are held until every fragment before them has arrived, then written out to the stream write function in order.
+            @param block The fragment, as read from the packet.
+            @param receiveBlock The receive state for the stream.
+         */
+
+        void ProcessStreamFragment( const ChannelPacketData::BlockData & block, ReceiveBlockData & receiveBlock );
+
     private:
 
+        bool m_ordered;                                                                 ///< True if this is a reliable-ordered channel, false if reliable-unordered.
         uint16_t m_sendMessageId;                                                       ///< Id of the next message to be added to the send queue.
-        uint16_t m_receiveMessageId;                                                    ///< Id of the next message to be added to the receive queue.
+        uint16_t m_receiveMessageId;                                                    ///< Id of the next message to be added to the receive queue. For reliable-unordered channels, this is the oldest message id not yet received (the start of the receive window).
         uint16_t m_oldestUnackedMessageId;                                              ///< Id of the oldest unacked message in the send queue.
         SequenceBuffer<SentPacketEntry> * m_sentPackets;                                ///< Stores information per sent connection packet about messages and block data included in each packet. Used to walk from connection packet level acks to message and data block fragment level acks.
         SequenceBuffer<MessageSendQueueEntry> * m_messageSendQueue;                     ///< Message send queue.
-        SequenceBuffer<MessageReceiveQueueEntry> * m_messageReceiveQueue;               ///< Message receive queue.
+        SendList m_unsentList;                                                          ///< Messages in the send queue that have never been sent, in message id order. Includes block messages, which stop the walk in GetMessagesToSend just like they stop the send window.
+        SendList m_sentList;                                                            ///< Messages that have been sent, in the order they were last sent. Every message resends after the same delay, so this is also the order they become due to resend.
+        SequenceBuffer<MessageReceiveQueueEntry> * m_messageReceiveQueue;               ///< Message receive queue. For reliable-unordered channels this only tracks which message ids in the receive window have been received, and the entries have no message.
+        Queue<Message*> * m_messageDeliveryQueue;                                       ///< Messages received but not yet dequeued by ReceiveMessage. Reliable-unordered channels only, NULL otherwise.
         uint16_t * m_sentPacketMessageIds;                                              ///< Array of n message ids per sent connection packet. Allows the maximum number of messages per-packet to be allocated dynamically.
         uint16_t * m_packetMessageIds;                                                  ///< Scratch space for the message ids gathered for the packet currently being generated (maxMessagesPerPacket entries). Owned by the channel so stack usage doesn't scale with the config.
-        SendBlockData * m_sendBlock;                                                    ///< Data about the block being currently sent.
-        ReceiveBlockData * m_receiveBlock;                                              ///< Data about the block being currently received.
+        SentFragmentEntry * m_sentPacketFragments;                                      ///< Array of n block fragments per sent connection packet. Allows the maximum number of fragments per-packet to be allocated dynamically.
+        SentFragmentEntry * m_packetFragments;                                          ///< Scratch space for the fragments gathered for the packet currently being generated (maxFragmentsPerPacket entries).
+        SendBlockData ** m_sendBlocks;                                                  ///< Blocks being sent, indexed by message id modulo ChannelConfig::maxBlocksInFlight. NULL if blocks are disabled.
+        ReceiveBlockData ** m_receiveBlocks;                                            ///< Blocks being received, indexed by message id modulo ChannelConfig::maxBlocksInFlight. NULL if blocks are disabled.
+        double m_rtt;                                                                   ///< Smoothed round trip time, measured from the time packets were sent to the time they were acked (seconds). Negative until the first ack.
+        BlockStreamWriteFunction m_streamWriteFunction;                                 ///< Receives the data of streamed blocks. NULL if not set.
+        void * m_streamWriteContext;                                                    ///< Context passed to the stream write function.
 
     private:
 
@@ -246,17 +246,46 @@ namespace yojimbo
         void RemoveEntries( int start_sequence, int finish_sequence )
         {
             if ( finish_sequence < start_sequence )
-                finish_sequence += 65535;
+                finish_sequence += 65536;
             yojimbo_assert( finish_sequence >= start_sequence );
             if ( finish_sequence - start_sequence < m_size )
             {
-                for ( int sequence = start_sequence; sequence <= finish_sequence; ++sequence )
-                    m_entry_sequence[sequence % m_size] = 0xFFFFFFFF;
+                ClearEntries( start_sequence, finish_sequence - start_sequence + 1 );
             }
             else
             {
-                for ( int i = 0; i < m_size; ++i )
-                    m_entry_sequence[i] = 0xFFFFFFFF;
+                memset( m_entry_sequence, 0xFF, sizeof( uint32_t ) * m_size );
+            }
+        }
+
+        /**
+            Helper function to mark a run of consecutive sequence numbers as empty.
+            The buffer size divides 65536 (see ChannelConfig), so the entries for the run are contiguous apart from at most one wrap at the end of the buffer, even when the run wraps around sequence 65535.
+            Long runs are cleared with memset instead of a modulo and a store per sequence number. Short runs (the common case, one packet or message at a time) stay a simple loop, where the call overhead of memset would dominate.
+            @param first_sequence The first sequence number in the run.
+            @param count The number of sequence numbers in the run. Must be less than the buffer size.
+         */
+
+        void ClearEntries( int first_sequence, int count )
+        {
+            yojimbo_assert( count <= m_size );
+            int index = first_sequence % m_size;
+            if ( count < 32 )
+            {
+                for ( int i = 0; i < count; ++i )
+                {
+                    m_entry_sequence[index] = 0xFFFFFFFF;
+                    if ( ++index == m_size )
+                        index = 0;
+                }
+                return;
+            }
+            while ( count > 0 )
+            {
+                const int n = yojimbo_min( count, m_size - index );
+                memset( m_entry_sequence + index, 0xFF, sizeof( uint32_t ) * n );
+                count -= n;
+                index = 0;
             }
         }
 
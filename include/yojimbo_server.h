@@ -60,6 +60,7 @@ namespace yojimbo
         YOJIMBO_SERVER_CLIENT_DISCONNECT_REASON_MESSAGE_TOO_LARGE,          ///< A message sent to this client is too large to ever fit into a packet. See CHANNEL_ERROR_MESSAGE_TOO_LARGE.
         YOJIMBO_SERVER_CLIENT_DISCONNECT_REASON_OUT_OF_MEMORY,              ///< The per-client memory budget for this client was exhausted. Consider increasing ClientServerConfig::serverPerClientMemory.
         YOJIMBO_SERVER_CLIENT_DISCONNECT_REASON_READ_PACKET_FAILED,         ///< A connection packet from this client failed to deserialize.
+        YOJIMBO_SERVER_CLIENT_DISCONNECT_REASON_STREAM_FAILED,              ///< A streamed block to or from this client failed. See CHANNEL_ERROR_STREAM_FAILED.
     };
 
     /// Helper function to convert a server client disconnect reason to a user friendly string.
@@ -79,6 +80,7 @@ namespace yojimbo
             case YOJIMBO_SERVER_CLIENT_DISCONNECT_REASON_MESSAGE_TOO_LARGE:     return "message too large";
             case YOJIMBO_SERVER_CLIENT_DISCONNECT_REASON_OUT_OF_MEMORY:         return "out of memory";
             case YOJIMBO_SERVER_CLIENT_DISCONNECT_REASON_READ_PACKET_FAILED:    return "read packet failed";
+            case YOJIMBO_SERVER_CLIENT_DISCONNECT_REASON_STREAM_FAILED:         return "stream failed";
             default:
                 yojimbo_assert( false );
                 return "(unknown)";
@@ -150,6 +152,7 @@ namespace yojimbo
         Address m_address;                                  // original address passed to ctor
         Address m_boundAddress;                             // address after socket bind, eg. valid port
         uint8_t m_privateKey[KeyBytes];
+        uint64_t m_decryptFailures;                         // decrypt failures counted by netcode so far, already added to the metrics
     };
 }
 
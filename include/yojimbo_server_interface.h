@@ -26,6 +26,7 @@
 #define YOJIMBO_SERVER_INTERFACE_H
 
 #include "yojimbo_config.h"
+#include "yojimbo_message.h"
 
 struct netcode_address_t;
 
@@ -176,6 +177,7 @@ namespace yojimbo
             Create a message of the specified type for a specific client.
             @param clientIndex The index of the client this message belongs to. Determines which client heap is used to allocate the message.
             @param type The type of the message to create. The message types corresponds to the message factory created by the adapter set on the server.
+            @returns The message, or NULL if it could not be allocated. Also NULL when ClientServerConfig::serverLazyClientMemory is set and no client has connected to the slot.
          */
 
         virtual class Message * CreateMessage( int clientIndex, int type ) = 0;
@@ -244,6 +246,19 @@ namespace yojimbo
 
         virtual void ReleaseMessage( int clientIndex, class Message * message ) = 0;
 
+        /**
+            Set the function that receives streamed blocks sent by a client on a channel.
+            Call this after Server::Start. It stays set for the client slot until changed, so set it again when a new client connects if the context is per client.
+            The channel must be a reliable channel with ChannelConfig::streamWindowSize > 0.
+            @param clientIndex The index of the client.
+            @param channelIndex The channel index in range [0,numChannels-1].
+            @param function The stream write function. NULL to clear it.
+            @param context Passed to the stream write function.
+            @see BlockMessage::AttachBlockStream
+         */
+
+        virtual void SetBlockStreamWriteFunction( int clientIndex, int channelIndex, BlockStreamWriteFunction function, void * context ) = 0;
+
         /**
             Get client network info.
             Call this to receive information about the client network connection, eg. round trip time, packet loss %, # of packets sent and so on.
@@ -0,0 +1,158 @@
+/*
+    Yojimbo Client/Server Network Library.
+
+    Copyright © 2016 - 2026, Más Bandwidth LLC.
+
+    Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+        1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+        2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+           in the documentation and/or other materials provided with the distribution.
+
+        3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived
+           from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+    INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+    SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+    USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef YOJIMBO_SNAPSHOT_CHANNEL_H
+#define YOJIMBO_SNAPSHOT_CHANNEL_H
+
+#include "yojimbo_config.h"
+#include "yojimbo_channel.h"
+#include "yojimbo_queue.h"
+#include "yojimbo_sequence_buffer.h"
+
+namespace yojimbo
+{
+    /**
+        Sends snapshots of world state, delta compressed against the most recent snapshot the other side is known to have received.
+        Send a block message with the serialized snapshot attached as its block. Each snapshot gets a snapshot id (the message id), and the channel
+        records which snapshot went out in each connection packet. When a packet is acked, the snapshot in it becomes a baseline that both sides are
+        known to have. Each new snapshot is sent as a delta against the newest acked baseline, or in full if there is no acked baseline yet.
+        Like the unreliable-unordered channel, snapshots are not resent when lost. Only the newest snapshot is sent: if you send several snapshots
+        before the next packet is generated, the older ones are superseded and never go out. On the receiver, snapshots older than the newest one
+        received are kept as baselines but are not delivered.
+        The delta encodes the changed byte ranges of the block against the baseline block, so it works best when your snapshot serializes each object
+        at a fixed offset (eg. quantized state in a fixed order), so unchanged state produces unchanged bytes.
+        IMPORTANT: Both sides keep their recent snapshot messages as baselines, so never modify the block of a snapshot message after you send it or after you receive it.
+     */
+
+    class SnapshotChannel : public Channel
+    {
+    public:
+
+        /**
+            Snapshot channel constructor.
+            @param allocator The allocator to use.
+            @param messageFactory Message factory for creating and destroying messages.
+            @param config The configuration for this channel.
+            @param maxPacketSize The maximum packet size in bytes (see ConnectionConfig::maxPacketSize).
+            @param channelIndex The channel index in [0,numChannels-1].
+         */
+
+        SnapshotChannel( Allocator & allocator, MessageFactory & messageFactory, const ChannelConfig & config, int maxPacketSize, int channelIndex, double time );
+
+        /**
+            Snapshot channel destructor.
+            Any snapshots still held as baselines or waiting in the receive queue will be released.
+         */
+
+        ~SnapshotChannel();
+
+        void Reset();
+
+        bool CanSendMessage() const;
+
+        bool HasMessagesToSend() const;
+
+        int GetSendQueueDepth() const;
+
+        void SendMessage( Message * message, void *context );
+
+        Message * ReceiveMessage();
+
+        void AdvanceTime( double time );
+
+        int GetPacketData( void *context, ChannelPacketData & packetData, uint16_t packetSequence, int availableBits );
+
+        void ProcessPacketData( const ChannelPacketData & packetData, uint16_t packetSequence );
+
+        void ProcessAck( uint16_t ack );
+
+        /**
+            Get the newest acked baseline.
+            @param snapshotId The snapshot id of the newest snapshot known to have been received by the other side [out].
+            @returns True if there is an acked baseline that new snapshots will be delta encoded against, false if the next snapshot will be sent in full.
+         */
+
+        bool GetBaselineSnapshotId( uint16_t & snapshotId ) const;
+
+    protected:
+
+        /**
+            A snapshot held by the channel. Sent snapshots are held so they can be used as baselines once acked, received snapshots so later deltas can be decoded against them.
+         */
+
+        struct SnapshotEntry
+        {
+            Message * message;                                                          ///< The snapshot message. The channel holds one reference on it while it is in the entry. NULL if the entry is empty.
+            uint16_t snapshotId;                                                        ///< The snapshot id.
+        };
+
+        /**
+            Maps packet level acks to snapshots.
+         */
+
+        struct SentPacketEntry
+        {
+            uint16_t snapshotId;                                                        ///< The id of the snapshot included in the packet.
+        };
+
+        /**
+            Look up a held snapshot by id.
+            @param entries The sent or received snapshot entries.
+            @param snapshotId The snapshot id.
+            @returns The snapshot entry, or NULL if that snapshot is no longer held.
+         */
+
+        SnapshotEntry * FindSnapshot( SnapshotEntry * entries, uint16_t snapshotId );
+
+        /**
+            Store a snapshot, releasing the older snapshot it replaces.
+            @param entries The sent or received snapshot entries.
+            @param snapshotId The snapshot id.
+            @param message The snapshot message. A reference is added for the entry.
+         */
+
+        void StoreSnapshot( SnapshotEntry * entries, uint16_t snapshotId, Message * message );
+
+    private:
+
+        uint16_t m_sendSnapshotId;                                                      ///< Id of the next snapshot to be sent.
+        uint16_t m_receiveSnapshotId;                                                   ///< Id of the newest snapshot received. Valid only if m_hasReceivedSnapshot is true.
+        uint16_t m_baselineSnapshotId;                                                  ///< Id of the newest sent snapshot that has been acked. Valid only if m_hasBaseline is true.
+        bool m_hasReceivedSnapshot;                                                     ///< True once a snapshot has been received.
+        bool m_hasBaseline;                                                             ///< True once a sent snapshot has been acked.
+        bool m_sendPending;                                                             ///< True if the newest snapshot has not been included in a packet yet.
+        SnapshotEntry * m_sendSnapshots;                                                ///< Recently sent snapshots, indexed by snapshot id modulo ChannelConfig::snapshotBufferSize.
+        SnapshotEntry * m_receiveSnapshots;                                             ///< Recently received snapshots, indexed by snapshot id modulo ChannelConfig::snapshotBufferSize.
+        SequenceBuffer<SentPacketEntry> * m_sentPackets;                                ///< Which snapshot was included in each sent connection packet. Used to walk from connection packet level acks to acked snapshots.
+        Queue<Message*> * m_messageReceiveQueue;                                        ///< Received snapshots waiting to be dequeued by ReceiveMessage.
+
+    private:
+
+        SnapshotChannel( const SnapshotChannel & other );
+
+        SnapshotChannel & operator = ( const SnapshotChannel & other );
+    };
+}
+
+#endif // #ifndef YOJIMBO_SNAPSHOT_CHANNEL_H
@@ -0,0 +1,358 @@
+/*
+    Yojimbo Client/Server Network Library.
+
+    Copyright © 2016 - 2026, Más Bandwidth LLC.
+
+    Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+        1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+        2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+           in the documentation and/or other materials provided with the distribution.
+
+        3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived
+           from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+    INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+    SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+    USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef YOJIMBO_STATIC_CONNECTION_H
+#define YOJIMBO_STATIC_CONNECTION_H
+
+#include "yojimbo_config.h"
+#include "yojimbo_connection.h"
+#include "yojimbo_reliable_ordered_channel.h"
+#include "yojimbo_unreliable_unordered_channel.h"
+#include "yojimbo_snapshot_channel.h"
+
+namespace yojimbo
+{
+    /// Channel types each channel class implements. StaticConnection checks the connection config against these.
+
+    inline bool ChannelClassSupportsType( const ReliableOrderedChannel *, ChannelType type ) { return type == CHANNEL_TYPE_RELIABLE_ORDERED || type == CHANNEL_TYPE_RELIABLE_UNORDERED; }
+    inline bool ChannelClassSupportsType( const UnreliableUnorderedChannel *, ChannelType type ) { return type == CHANNEL_TYPE_UNRELIABLE_UNORDERED; }
+    inline bool ChannelClassSupportsType( const SnapshotChannel *, ChannelType type ) { return type == CHANNEL_TYPE_SNAPSHOT; }
+
+    inline void SetChannelBlockStreamWriteFunction( ReliableOrderedChannel & channel, BlockStreamWriteFunction function, void * context ) { channel.SetBlockStreamWriteFunction( function, context ); }
+    template <typename T> void SetChannelBlockStreamWriteFunction( T &, BlockStreamWriteFunction, void * ) { yojimbo_assert( !"block streams need a reliable channel" ); }
+
+    /**
+        The channels of a StaticConnection, built at compile time from the list of channel classes.
+        Every call names the concrete channel class, so it's a direct call the compiler can inline, not a virtual one.
+        Calls that take a channel index walk the list with one compare per channel, which folds away when the index is a constant.
+     */
+
+    template <typename... Channels> struct StaticChannelList;
+
+    template <> struct StaticChannelList<>
+    {
+        StaticChannelList( Allocator &, MessageFactory &, const ConnectionConfig &, int, double ) {}
+        void Reset() {}
+        bool CanSendMessage( int ) const { yojimbo_assert( false ); return false; }
+        bool HasMessagesToSend( int ) const { yojimbo_assert( false ); return false; }
+        void SendMessage( int, Message *, void * ) { yojimbo_assert( false ); }
+        Message * ReceiveMessage( int ) { yojimbo_assert( false ); return NULL; }
+        void AdvanceTime( double ) {}
+        bool HasError() const { return false; }
+        int GetPacketData( void *, ChannelPacketData *, bool *, uint16_t, int & ) { return 0; }
+        void ProcessPacketData( int, const ChannelPacketData &, uint16_t ) { yojimbo_assert( false ); }
+        void ProcessAcks( const uint16_t *, int ) {}
+        ChannelErrorLevel GetErrorLevel( int ) const { yojimbo_assert( false ); return CHANNEL_ERROR_DESYNC; }
+        void SetBlockStreamWriteFunction( int, BlockStreamWriteFunction, void * ) { yojimbo_assert( false ); }
+    };
+
+    template <typename Head, typename... Tail> struct StaticChannelList<Head, Tail...>
+    {
+        Head head;
+        StaticChannelList<Tail...> tail;
+
+        StaticChannelList( Allocator & allocator, MessageFactory & messageFactory, const ConnectionConfig & connectionConfig, int channelIndex, double time )
+            : head( allocator, messageFactory, connectionConfig.channel[channelIndex], connectionConfig.maxPacketSize, channelIndex, time ),
+              tail( allocator, messageFactory, connectionConfig, channelIndex + 1, time )
+        {
+            yojimbo_assert( ChannelClassSupportsType( &head, connectionConfig.channel[channelIndex].type ) );
+        }
+
+        void Reset() { head.Head::Reset(); tail.Reset(); }
+
+        bool CanSendMessage( int channelIndex ) const { return channelIndex == 0 ? head.Head::CanSendMessage() : tail.CanSendMessage( channelIndex - 1 ); }
+
+        bool HasMessagesToSend( int channelIndex ) const { return channelIndex == 0 ? head.Head::HasMessagesToSend() : tail.HasMessagesToSend( channelIndex - 1 ); }
+
+        void SendMessage( int channelIndex, Message * message, void * context )
+        {
+            if ( channelIndex == 0 )
+                head.Head::SendMessage( message, context );
+            else
+                tail.SendMessage( channelIndex - 1, message, context );
+        }
+
+        Message * ReceiveMessage( int channelIndex ) { return channelIndex == 0 ? head.Head::ReceiveMessage() : tail.ReceiveMessage( channelIndex - 1 ); }
+
+        // stops at the first channel in error, like Connection::AdvanceTime
+        void AdvanceTime( double time )
+        {
+            head.Head::AdvanceTime( time );
+            if ( head.GetErrorLevel() != CHANNEL_ERROR_NONE )
+                return;
+            tail.AdvanceTime( time );
+        }
+
+        bool HasError() const { return head.GetErrorLevel() != CHANNEL_ERROR_NONE || tail.HasError(); }
+
+        int GetPacketData( void * context, ChannelPacketData * channelData, bool * channelHasData, uint16_t packetSequence, int & availableBits )
+        {
+            const int packetDataBits = head.Head::GetPacketData( context, *channelData, packetSequence, availableBits );
+            *channelHasData = packetDataBits > 0;
+            if ( packetDataBits > 0 )
+            {
+                availableBits -= ConservativeChannelHeaderBits;
+                availableBits -= packetDataBits;
+            }
+            return ( packetDataBits > 0 ? 1 : 0 ) + tail.GetPacketData( context, channelData + 1, channelHasData + 1, packetSequence, availableBits );
+        }
+
+        void ProcessPacketData( int channelIndex, const ChannelPacketData & packetData, uint16_t packetSequence )
+        {
+            if ( channelIndex == 0 )
+                head.Head::ProcessPacketData( packetData, packetSequence );
+            else
+                tail.ProcessPacketData( channelIndex - 1, packetData, packetSequence );
+        }
+
+        void ProcessAcks( const uint16_t * acks, int numAcks ) { head.Head::ProcessAcks( acks, numAcks ); tail.ProcessAcks( acks, numAcks ); }
+
+        ChannelErrorLevel GetErrorLevel( int channelIndex ) const { return channelIndex == 0 ? head.GetErrorLevel() : tail.GetErrorLevel( channelIndex - 1 ); }
+
+        void SetBlockStreamWriteFunction( int channelIndex, BlockStreamWriteFunction function, void * context )
+        {
+            if ( channelIndex == 0 )
+                SetChannelBlockStreamWriteFunction( head, function, context );
+            else
+                tail.SetBlockStreamWriteFunction( channelIndex - 1, function, context );
+        }
+    };
+
+    /// The channel class at index ChannelIndex in a channel class list.
+
+    template <int ChannelIndex, typename... Channels> struct StaticChannelAt;
+
+    template <typename Head, typename... Tail> struct StaticChannelAt<0, Head, Tail...>
+    {
+        typedef Head Type;
+        static Head & Get( StaticChannelList<Head, Tail...> & list ) { return list.head; }
+    };
+
+    template <int ChannelIndex, typename Head, typename... Tail> struct StaticChannelAt<ChannelIndex, Head, Tail...>
+    {
+        typedef typename StaticChannelAt<ChannelIndex - 1, Tail...>::Type Type;
+        static Type & Get( StaticChannelList<Head, Tail...> & list ) { return StaticChannelAt<ChannelIndex - 1, Tail...>::Get( list.tail ); }
+    };
+
+    /**
+        A connection whose channel layout is fixed at compile time.
+        Same interface and the same packets on the wire as Connection, so one end can use either. Channels are members rather than heap
+        objects reached through virtual calls, and the per-packet channel data is sized for the channels you have instead of MaxChannels.
+        Channels are listed by class, in channel index order, and must match the connection config:
+
+            StaticConnection<ReliableOrderedChannel, UnreliableUnorderedChannel> connection( allocator, messageFactory, config, time );
+
+        ReliableOrderedChannel serves both CHANNEL_TYPE_RELIABLE_ORDERED and CHANNEL_TYPE_RELIABLE_UNORDERED.
+        Client and server keep using Connection; this is for code that drives connections itself.
+        @see Connection
+     */
+
+    template <typename... Channels> class StaticConnection
+    {
+    public:
+
+        enum { NumChannels = sizeof...( Channels ) };
+
+        static_assert( NumChannels >= 1 && NumChannels <= MaxChannels, "a static connection needs between 1 and MaxChannels channels" );
+
+        StaticConnection( Allocator & allocator, MessageFactory & messageFactory, const ConnectionConfig & connectionConfig, double time )
+            : m_allocator( &allocator ),
+              m_messageFactory( &messageFactory ),
+              m_connectionConfig( connectionConfig ),
+              m_channels( allocator, messageFactory, m_connectionConfig, 0, time ),
+              m_errorLevel( CONNECTION_ERROR_NONE )
+        {
+            yojimbo_assert( m_connectionConfig.numChannels == NumChannels );
+        }
+
+        ~StaticConnection()
+        {
+            Reset();
+        }
+
+        void Reset()
+        {
+            m_errorLevel = CONNECTION_ERROR_NONE;
+            m_channels.Reset();
+        }
+
+        bool CanSendMessage( int channelIndex ) const
+        {
+            yojimbo_assert( channelIndex >= 0 );
+            yojimbo_assert( channelIndex < NumChannels );
+            return m_channels.CanSendMessage( channelIndex );
+        }
+
+        bool HasMessagesToSend( int channelIndex ) const
+        {
+            yojimbo_assert( channelIndex >= 0 );
+            yojimbo_assert( channelIndex < NumChannels );
+            return m_channels.HasMessagesToSend( channelIndex );
+        }
+
+        void SendMessage( int channelIndex, Message * message, void * context = 0 )
+        {
+            yojimbo_assert( channelIndex >= 0 );
+            yojimbo_assert( channelIndex < NumChannels );
+            m_channels.SendMessage( channelIndex, message, context );
+        }
+
+        Message * ReceiveMessage( int channelIndex )
+        {
+            yojimbo_assert( channelIndex >= 0 );
+            yojimbo_assert( channelIndex < NumChannels );
+            return m_channels.ReceiveMessage( channelIndex );
+        }
+
+        void ReleaseMessage( Message * message )
+        {
+            yojimbo_assert( message );
+            m_messageFactory->ReleaseMessage( message );
+        }
+
+        bool GeneratePacket( void * context, uint16_t packetSequence, uint8_t * packetData, int maxPacketBytes, int & packetBytes )
+        {
+            // rounded down to a multiple of 8 for the bit writer, see Connection::GeneratePacket
+            maxPacketBytes &= ~7;
+
+            ChannelPacketData channelData[NumChannels];
+            bool channelHasData[NumChannels];
+
+            int availableBits = maxPacketBytes * 8 - ConservativePacketHeaderBits;
+
+            const int numChannelsWithData = m_channels.GetPacketData( context, channelData, channelHasData, packetSequence, availableBits );
+
+            return GenerateConnectionPacket( context, *m_messageFactory, m_connectionConfig, channelData, channelHasData, NumChannels, numChannelsWithData, packetData, maxPacketBytes, packetBytes );
+        }
+
+        bool ProcessPacket( void * context, uint16_t packetSequence, const uint8_t * packetData, int packetBytes )
+        {
+            if ( m_errorLevel != CONNECTION_ERROR_NONE )
+            {
+                yojimbo_printf( YOJIMBO_LOG_LEVEL_DEBUG, "failed to read packet because connection is in error state\n" );
+                return false;
+            }
+
+            if ( !packetData || packetBytes <= 0 )
+            {
+                yojimbo_printf( YOJIMBO_LOG_LEVEL_ERROR, "error: failed to read packet (empty payload)\n" );
+                m_errorLevel = CONNECTION_ERROR_READ_PACKET_FAILED;
+                return false;
+            }
+
+            ConnectionPacket packet;
+
+            if ( !ReadConnectionPacket( context, *m_messageFactory, m_connectionConfig, packet, packetData, packetBytes ) )
+            {
+                yojimbo_printf( YOJIMBO_LOG_LEVEL_ERROR, "error: failed to read packet\n" );
+                m_errorLevel = CONNECTION_ERROR_READ_PACKET_FAILED;
+                return false;
+            }
+
+            for ( int i = 0; i < packet.numChannelEntries; ++i )
+            {
+                const int channelIndex = packet.channelEntry[i].channelIndex;
+                yojimbo_assert( channelIndex >= 0 );
+                yojimbo_assert( channelIndex < NumChannels );
+                m_channels.ProcessPacketData( channelIndex, packet.channelEntry[i], packetSequence );
+                if ( m_channels.GetErrorLevel( channelIndex ) != CHANNEL_ERROR_NONE )
+                {
+                    yojimbo_printf( YOJIMBO_LOG_LEVEL_DEBUG, "failed to read packet because channel %d is in error state\n", channelIndex );
+                    return false;
+                }
+            }
+
+            return true;
+        }
+
+        void ProcessAcks( const uint16_t * acks, int numAcks )
+        {
+            if ( numAcks == 0 )
+                return;
+            m_channels.ProcessAcks( acks, numAcks );
+        }
+
+        void AdvanceTime( double time )
+        {
+            m_channels.AdvanceTime( time );
+            if ( m_channels.HasError() )
+            {
+                m_errorLevel = CONNECTION_ERROR_CHANNEL;
+                return;
+            }
+            if ( m_allocator->GetErrorLevel() != ALLOCATOR_ERROR_NONE )
+            {
+                m_errorLevel = CONNECTION_ERROR_ALLOCATOR;
+                return;
+            }
+            if ( m_messageFactory->GetErrorLevel() != MESSAGE_FACTORY_ERROR_NONE )
+            {
+                m_errorLevel = CONNECTION_ERROR_MESSAGE_FACTORY;
+                return;
+            }
+        }
+
+        ConnectionErrorLevel GetErrorLevel() { return m_errorLevel; }
+
+        ChannelErrorLevel GetChannelErrorLevel( int channelIndex ) const
+        {
+            yojimbo_assert( channelIndex >= 0 );
+            yojimbo_assert( channelIndex < NumChannels );
+            return m_channels.GetErrorLevel( channelIndex );
+        }
+
+        void SetBlockStreamWriteFunction( int channelIndex, BlockStreamWriteFunction function, void * context )
+        {
+            yojimbo_assert( channelIndex >= 0 );
+            yojimbo_assert( channelIndex < NumChannels );
+            yojimbo_assert( m_connectionConfig.channel[channelIndex].streamWindowSize > 0 );
+            m_channels.SetBlockStreamWriteFunction( channelIndex, function, context );
+        }
+
+        /**
+            Get a channel by its compile time index, as its concrete class.
+            @returns The channel. Calls on it are direct calls.
+         */
+
+        template <int ChannelIndex> typename StaticChannelAt<ChannelIndex, Channels...>::Type & GetChannel()
+        {
+            static_assert( ChannelIndex >= 0 && ChannelIndex < NumChannels, "channel index out of range" );
+            return StaticChannelAt<ChannelIndex, Channels...>::Get( m_channels );
+        }
+
+    private:
+
+        StaticConnection( const StaticConnection & other );
+
+        const StaticConnection & operator = ( const StaticConnection & other );
+
+        Allocator * m_allocator;                                ///< Allocator passed in to the connection constructor.
+        MessageFactory * m_messageFactory;                      ///< Message factory for creating and destroying messages.
+        ConnectionConfig m_connectionConfig;                    ///< Connection configuration. Declared before the channels, which are built from it.
+        StaticChannelList<Channels...> m_channels;              ///< The channels, in channel index order.
+        ConnectionErrorLevel m_errorLevel;                      ///< The connection error level.
+    };
+}
+
+#endif // #ifndef YOJIMBO_STATIC_CONNECTION_H
@@ -0,0 +1,111 @@
+/*
+    Yojimbo Client/Server Network Library.
+
+    Copyright © 2016 - 2026, Más Bandwidth LLC.
+
+    Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+        1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+        2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+           in the documentation and/or other materials provided with the distribution.
+
+        3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived
+           from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+    INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+    SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+    USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef YOJIMBO_TRACE_H
+#define YOJIMBO_TRACE_H
+
+#include "yojimbo_config.h"
+
+/** @file
+    Hot path tracing.
+
+    With YOJIMBO_ENABLE_TRACING set, the library records begin and end events around packet receive, time advance,
+    connection packet read and write, reliable send and receive, and netcode packet encrypt and decrypt. Each thread
+    writes its events into its own ring buffer of YOJIMBO_TRACE_BUFFER_EVENTS, with no locks, and yojimbo_trace_write
+    dumps every thread's buffer as Chrome trace JSON. Open the file in chrome://tracing or https://ui.perfetto.dev.
+
+    Without it, the YOJIMBO_TRACE macros compile to nothing, and yojimbo_trace_write returns false.
+ */
+
+/**
+    Record the start of a traced section on the calling thread.
+    @param name The section name. Not copied: pass a string literal.
+ */
+
+void yojimbo_trace_begin( const char * name );
+
+/**
+    Record the end of the traced section most recently begun on the calling thread.
+    @param name The section name. Not copied: pass a string literal.
+ */
+
+void yojimbo_trace_end( const char * name );
+
+/**
+    Write the events recorded by every thread as Chrome trace JSON.
+    Threads may keep tracing while this runs, but events they write during the dump may come out torn or missing. Call it when the traced threads are quiet for a clean file.
+    @param path The path of the file to write.
+    @returns True if the file was written. False if it couldn't be, or tracing is compiled out.
+ */
+
+bool yojimbo_trace_write( const char * path );
+
+/**
+    Discard the events recorded by every thread so far.
+    Call it when the traced threads are quiet.
+ */
+
+void yojimbo_trace_reset();
+
+#if YOJIMBO_ENABLE_TRACING
+
+namespace yojimbo
+{
+    /// Records a begin event when constructed and the matching end event when it goes out of scope. See YOJIMBO_TRACE_SCOPE.
+
+    class TraceScope
+    {
+    public:
+
+        explicit TraceScope( const char * name ) : m_name( name ) { yojimbo_trace_begin( name ); }
+
+        ~TraceScope() { yojimbo_trace_end( m_name ); }
+
+    private:
+
+        TraceScope( const TraceScope & other );
+
+        const TraceScope & operator = ( const TraceScope & other );
+
+        const char * m_name;
+    };
+}
+
+#define YOJIMBO_TRACE_CONCAT_INTERNAL( a, b ) a##b
+#define YOJIMBO_TRACE_CONCAT( a, b ) YOJIMBO_TRACE_CONCAT_INTERNAL( a, b )
+
+#define YOJIMBO_TRACE_SCOPE( name ) yojimbo::TraceScope YOJIMBO_TRACE_CONCAT( yojimbo_trace_scope_, __LINE__ )( name )
+#define YOJIMBO_TRACE_BEGIN( name ) yojimbo_trace_begin( name )
+#define YOJIMBO_TRACE_END( name ) yojimbo_trace_end( name )
+
+#else // #if YOJIMBO_ENABLE_TRACING
+
+#define YOJIMBO_TRACE_SCOPE( name ) do {} while ( 0 )
+#define YOJIMBO_TRACE_BEGIN( name ) do {} while ( 0 )
+#define YOJIMBO_TRACE_END( name ) do {} while ( 0 )
+
+#endif // #if YOJIMBO_ENABLE_TRACING
+
+#endif // #ifndef YOJIMBO_TRACE_H
@@ -64,6 +64,8 @@ namespace yojimbo
 
         bool HasMessagesToSend() const;
 
+        int GetSendQueueDepth() const;
+
         void SendMessage( Message * message, void *context );
 
         Message * ReceiveMessage();
@@ -76,6 +78,8 @@ namespace yojimbo
 
         void ProcessAck( uint16_t ack );
 
+        void ProcessAcks( const uint16_t * acks, int numAcks );
+
     protected:
 
         Queue<Message*> * m_messageSendQueue;                   ///< Message send queue.
@@ -69,6 +69,10 @@
 #define NETCODE_ENABLE_LOGGING 1
 #endif // #ifndef NETCODE_ENABLE_LOGGING
 
+#ifndef NETCODE_ENABLE_TRACING
+#define NETCODE_ENABLE_TRACING 0
+#endif // #ifndef NETCODE_ENABLE_TRACING
+
 // ------------------------------------------------------------------
 
 #if NETCODE_PACKET_TAGGING
@@ -101,6 +105,7 @@ static void netcode_default_assert_handler( NETCODE_CONST char * condition, NETC
 
 static int log_level;
 static int (*printf_function)( NETCODE_CONST char *, ... ) = ( int (*)( NETCODE_CONST char *, ... ) ) printf;
+static void (*vprintf_function)( NETCODE_CONST char *, va_list ) = NULL;
 void (*netcode_assert_function)( NETCODE_CONST char *, NETCODE_CONST char *, NETCODE_CONST char * file, int line ) = netcode_default_assert_handler;
 
 void netcode_log_level( int level )
@@ -114,11 +119,37 @@ void netcode_set_printf_function( int (*function)( NETCODE_CONST char *, ... ) )
     printf_function = function;
 }
 
+void netcode_set_vprintf_function( void (*function)( NETCODE_CONST char *, va_list ) )
+{
+    vprintf_function = function;
+}
+
 void netcode_set_assert_function( void (*function)( NETCODE_CONST char *, NETCODE_CONST char *, NETCODE_CONST char * file, int line ) )
 {
     netcode_assert_function = function;
 }
 
+static void (*trace_begin_function)( NETCODE_CONST char * ) = NULL;
+static void (*trace_end_function)( NETCODE_CONST char * ) = NULL;
+
+void netcode_set_trace_functions( void (*begin_function)( NETCODE_CONST char * ), void (*end_function)( NETCODE_CONST char * ) )
+{
+    trace_begin_function = begin_function;
+    trace_end_function = end_function;
+}
+
+#if NETCODE_ENABLE_TRACING
+
+#define netcode_trace_begin( name ) do { if ( trace_begin_function ) trace_begin_function( name ); } while ( 0 )
+#define netcode_trace_end( name ) do { if ( trace_end_function ) trace_end_function( name ); } while ( 0 )
+
+#else // #if NETCODE_ENABLE_TRACING
+
+#define netcode_trace_begin( name ) do {} while ( 0 )
+#define netcode_trace_end( name ) do {} while ( 0 )
+
+#endif // #if NETCODE_ENABLE_TRACING
+
 #if NETCODE_ENABLE_LOGGING
 
 void netcode_printf( int level, NETCODE_CONST char * format, ... ) 
@@ -127,9 +158,16 @@ void netcode_printf( int level, NETCODE_CONST char * format, ... )
         return;
     va_list args;
     va_start( args, format );
-    char buffer[4*1024];
-    vsnprintf( buffer, sizeof(buffer), format, args );
-    printf_function( "%s", buffer );
+    if ( vprintf_function )
+    {
+        vprintf_function( format, args );
+    }
+    else
+    {
+        char buffer[4*1024];
+        vsnprintf( buffer, sizeof(buffer), format, args );
+        printf_function( "%s", buffer );
+    }
     va_end( args );
 }
 
@@ -1662,10 +1700,16 @@ int netcode_write_packet( void * packet, uint8_t * buffer, int buffer_length, ui
             netcode_write_uint64( &p, sequence );
         }
 
-        if ( netcode_encrypt_aead( encrypted_start, 
-                                   encrypted_finish - encrypted_start, 
-                                   additional_data, sizeof( additional_data ), 
-                                   nonce, write_packet_key ) != NETCODE_OK )
+        netcode_trace_begin( "netcode_write_packet (encrypt)" );
+
+        const int encrypt_result = netcode_encrypt_aead( encrypted_start, 
+                                                         encrypted_finish - encrypted_start, 
+                                                         additional_data, sizeof( additional_data ), 
+                                                         nonce, write_packet_key );
+
+        netcode_trace_end( "netcode_write_packet (encrypt)" );
+
+        if ( encrypt_result != NETCODE_OK )
         {
             return NETCODE_ERROR;
         }
@@ -1725,22 +1769,25 @@ void netcode_replay_protection_advance_sequence( struct netcode_replay_protectio
     replay_protection->received_packet[index] = sequence;
 }
 
-void * netcode_read_packet( uint8_t * buffer, 
-                            int buffer_length, 
-                            uint64_t * sequence, 
-                            uint8_t * read_packet_key, 
-                            uint64_t protocol_id, 
-                            uint64_t current_timestamp, 
-                            uint8_t * private_key, 
-                            uint8_t * allowed_packets, 
-                            struct netcode_replay_protection_t * replay_protection, 
-                            void * allocator_context, 
-                            void* (*allocate_function)(void*,size_t) )
+static void * netcode_read_packet_internal( uint8_t * buffer, 
+                                            int buffer_length, 
+                                            uint64_t * sequence, 
+                                            uint8_t * read_packet_key, 
+                                            uint64_t protocol_id, 
+                                            uint64_t current_timestamp, 
+                                            uint8_t * private_key, 
+                                            uint8_t * allowed_packets, 
+                                            struct netcode_replay_protection_t * replay_protection, 
+                                            void * allocator_context, 
+                                            void* (*allocate_function)(void*,size_t),
+                                            int * decrypt_failed )
 {
     netcode_assert( sequence );
     netcode_assert( allowed_packets );
+    netcode_assert( decrypt_failed );
 
     *sequence = 0;
+    *decrypt_failed = 0;
 
     if ( allocate_function == NULL )
     {
@@ -1828,6 +1875,7 @@ void * netcode_read_packet( uint8_t * buffer,
                                                     private_key ) != NETCODE_OK )
         {
             netcode_printf( NETCODE_LOG_LEVEL_DEBUG, "ignored connection request packet. connect token failed to decrypt\n" );
+            *decrypt_failed = 1;
             return NULL;
         }
 
@@ -1942,9 +1990,16 @@ void * netcode_read_packet( uint8_t * buffer,
             return NULL;
         }
 
-        if ( netcode_decrypt_aead( buffer, encrypted_bytes, additional_data, sizeof( additional_data ), nonce, read_packet_key ) != NETCODE_OK )
+        netcode_trace_begin( "netcode_read_packet (decrypt)" );
+
+        const int decrypt_result = netcode_decrypt_aead( buffer, encrypted_bytes, additional_data, sizeof( additional_data ), nonce, read_packet_key );
+
+        netcode_trace_end( "netcode_read_packet (decrypt)" );
+
+        if ( decrypt_result != NETCODE_OK )
         {
             netcode_printf( NETCODE_LOG_LEVEL_DEBUG, "ignored encrypted packet. failed to decrypt\n" );
+            *decrypt_failed = 1;
             return NULL;
         }
 
@@ -2116,6 +2171,22 @@ void * netcode_read_packet( uint8_t * buffer,
     }
 }
 
+void * netcode_read_packet( uint8_t * buffer, 
+                            int buffer_length, 
+                            uint64_t * sequence, 
+                            uint8_t * read_packet_key, 
+                            uint64_t protocol_id, 
+                            uint64_t current_timestamp, 
+                            uint8_t * private_key, 
+                            uint8_t * allowed_packets, 
+                            struct netcode_replay_protection_t * replay_protection, 
+                            void * allocator_context, 
+                            void* (*allocate_function)(void*,size_t) )
+{
+    int decrypt_failed;
+    return netcode_read_packet_internal( buffer, buffer_length, sequence, read_packet_key, protocol_id, current_timestamp, private_key, allowed_packets, replay_protection, allocator_context, allocate_function, &decrypt_failed );
+}
+
 // ----------------------------------------------------------------
 
 struct netcode_connect_token_t
@@ -2712,6 +2783,7 @@ struct netcode_client_t
     int receive_packet_bytes[NETCODE_CLIENT_MAX_RECEIVE_PACKETS];
     struct netcode_address_t receive_from[NETCODE_CLIENT_MAX_RECEIVE_PACKETS];
     int loopback;
+    uint64_t num_decrypt_failures;
 };
 
 static int client_create_error;
@@ -2858,6 +2930,7 @@ struct netcode_client_t * netcode_client_create_dual( NETCODE_CONST char * addre
     client->server_address_index = 0;
     client->challenge_token_sequence = 0;
     client->loopback = 0;
+    client->num_decrypt_failures = 0;
     memset( &client->server_address, 0, sizeof( struct netcode_address_t ) );
     memset( &client->connect_token, 0, sizeof( struct netcode_connect_token_t ) );
     memset( &client->context, 0, sizeof( struct netcode_context_t ) );
@@ -3101,20 +3174,26 @@ void netcode_client_process_packet( struct netcode_client_t * client, struct net
 
     uint64_t sequence;
 
-    void * packet = netcode_read_packet( packet_data, 
-                                         packet_bytes, 
-                                         &sequence, 
-                                         client->context.read_packet_key, 
-                                         client->connect_token.protocol_id, 
-                                         current_timestamp, 
-                                         NULL, 
-                                         allowed_packets, 
-                                         &client->replay_protection, 
-                                         client->config.allocator_context, 
-                                         client->config.allocate_function );
+    int decrypt_failed;
+
+    void * packet = netcode_read_packet_internal( packet_data, 
+                                                  packet_bytes, 
+                                                  &sequence, 
+                                                  client->context.read_packet_key, 
+                                                  client->connect_token.protocol_id, 
+                                                  current_timestamp, 
+                                                  NULL, 
+                                                  allowed_packets, 
+                                                  &client->replay_protection, 
+                                                  client->config.allocator_context, 
+                                                  client->config.allocate_function,
+                                                  &decrypt_failed );
 
     if ( !packet )
+    {
+        client->num_decrypt_failures += decrypt_failed;
         return;
+    }
     
     netcode_client_process_packet_internal( client, from, (uint8_t*)packet, sequence );
 }
@@ -3488,6 +3567,12 @@ int netcode_client_state( struct netcode_client_t * client )
     return client->state;
 }
 
+uint64_t netcode_client_num_decrypt_failures( struct netcode_client_t * client )
+{
+    netcode_assert( client );
+    return client->num_decrypt_failures;
+}
+
 int netcode_client_index( struct netcode_client_t * client )
 {
     netcode_assert( client );
@@ -3906,6 +3991,7 @@ struct netcode_server_t
     uint8_t * receive_packet_data[NETCODE_SERVER_MAX_RECEIVE_PACKETS];
     int receive_packet_bytes[NETCODE_SERVER_MAX_RECEIVE_PACKETS];
     struct netcode_address_t receive_from[NETCODE_SERVER_MAX_RECEIVE_PACKETS];
+    uint64_t num_decrypt_failures;
 };
 
 static int server_create_error;
@@ -4775,20 +4861,26 @@ void netcode_server_read_and_process_packet( struct netcode_server_t * server,
         return;
     }
 
-    void * packet = netcode_read_packet( packet_data, 
-                                         packet_bytes, 
-                                         &sequence, 
-                                         read_packet_key, 
-                                         server->config.protocol_id, 
-                                         current_timestamp, 
-                                         server->config.private_key, 
-                                         allowed_packets, 
-                                         ( client_index != -1 ) ? &server->client_replay_protection[client_index] : NULL, 
-                                         server->config.allocator_context, 
-                                         server->config.allocate_function );
+    int decrypt_failed;
+
+    void * packet = netcode_read_packet_internal( packet_data, 
+                                                  packet_bytes, 
+                                                  &sequence, 
+                                                  read_packet_key, 
+                                                  server->config.protocol_id, 
+                                                  current_timestamp, 
+                                                  server->config.private_key, 
+                                                  allowed_packets, 
+                                                  ( client_index != -1 ) ? &server->client_replay_protection[client_index] : NULL, 
+                                                  server->config.allocator_context, 
+                                                  server->config.allocate_function,
+                                                  &decrypt_failed );
 
     if ( !packet )
+    {
+        server->num_decrypt_failures += decrypt_failed;
         return;
+    }
 
     netcode_server_process_packet_internal( server, from, packet, sequence, encryption_index, client_index );
 }
@@ -5098,6 +5190,12 @@ int netcode_server_num_connected_clients( struct netcode_server_t * server )
     return server->num_connected_clients;
 }
 
+uint64_t netcode_server_num_decrypt_failures( struct netcode_server_t * server )
+{
+    netcode_assert( server );
+    return server->num_decrypt_failures;
+}
+
 void * netcode_server_client_user_data( struct netcode_server_t * server, int client_index )
 {
     netcode_assert( server );
@@ -48,6 +48,7 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include <stdarg.h>
 
 #if !defined(NETCODE_DEBUG) && !defined(NETCODE_RELEASE)
 #if defined(NDEBUG)
@@ -231,6 +232,8 @@ void netcode_client_disconnect( struct netcode_client_t * client );
 
 int netcode_client_state( struct netcode_client_t * client );
 
+uint64_t netcode_client_num_decrypt_failures( struct netcode_client_t * client );
+
 int netcode_client_index( struct netcode_client_t * client );
 
 int netcode_client_max_clients( struct netcode_client_t * client );
@@ -326,6 +329,8 @@ void netcode_server_free_packet( struct netcode_server_t * server, void * packet
 
 int netcode_server_num_connected_clients( struct netcode_server_t * server );
 
+uint64_t netcode_server_num_decrypt_failures( struct netcode_server_t * server );
+
 void * netcode_server_client_user_data( struct netcode_server_t * server, int client_index );
 
 void netcode_server_process_packet( struct netcode_server_t * server, struct netcode_address_t * from, uint8_t * packet_data, int packet_bytes );
@@ -344,6 +349,12 @@ void netcode_log_level( int level );
 
 void netcode_set_printf_function( int (*function)( NETCODE_CONST char *, ... ) );
 
+// when set, log messages go here unformatted, instead of being formatted and passed to the printf function. NULL to turn off
+
+void netcode_set_vprintf_function( void (*function)( NETCODE_CONST char *, va_list ) );
+
+void netcode_set_trace_functions( void (*begin_function)( NETCODE_CONST char * ), void (*end_function)( NETCODE_CONST char * ) );
+
 extern void (*netcode_assert_function)( NETCODE_CONST char *, NETCODE_CONST char *, NETCODE_CONST char * file, int line );
 
 #ifndef NDEBUG
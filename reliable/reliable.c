@@ -36,6 +36,18 @@
 #define RELIABLE_ENABLE_TESTS 0
 #endif // #ifndef RELIABLE_ENABLE_TESTS
 
+#ifndef RELIABLE_SSE2
+#if defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+#define RELIABLE_SSE2 1
+#else
+#define RELIABLE_SSE2 0
+#endif
+#endif // #ifndef RELIABLE_SSE2
+
+#if RELIABLE_SSE2
+#include <emmintrin.h>
+#endif // #if RELIABLE_SSE2
+
 #ifndef RELIABLE_ENABLE_LOGGING
 #define RELIABLE_ENABLE_LOGGING 1
 #endif // #ifndef RELIABLE_ENABLE_LOGGING
@@ -55,6 +67,7 @@ static void default_assert_handler( RELIABLE_CONST char * condition, RELIABLE_CO
 
 static int log_level = 0;
 static int (*printf_function)( RELIABLE_CONST char *, ... ) = ( int (*)( RELIABLE_CONST char *, ... ) ) printf;
+static void (*vprintf_function)( RELIABLE_CONST char *, va_list ) = NULL;
 void (*reliable_assert_function)( RELIABLE_CONST char *, RELIABLE_CONST char *, RELIABLE_CONST char * file, int line ) = default_assert_handler;
 
 void reliable_log_level( int level )
@@ -68,6 +81,11 @@ void reliable_set_printf_function( int (*function)( RELIABLE_CONST char *, ... )
     printf_function = function;
 }
 
+void reliable_set_vprintf_function( void (*function)( RELIABLE_CONST char *, va_list ) )
+{
+    vprintf_function = function;
+}
+
 void reliable_set_assert_function( void (*function)( RELIABLE_CONST char *, RELIABLE_CONST char *, RELIABLE_CONST char * file, int line ) )
 {
     reliable_assert_function = function;
@@ -81,9 +99,16 @@ void reliable_printf( int level, RELIABLE_CONST char * format, ... )
         return;
     va_list args;
     va_start( args, format );
-    char buffer[4*1024];
-    vsnprintf( buffer, sizeof(buffer), format, args );
-    printf_function( "%s", buffer );
+    if ( vprintf_function )
+    {
+        vprintf_function( format, args );
+    }
+    else
+    {
+        char buffer[4*1024];
+        vsnprintf( buffer, sizeof(buffer), format, args );
+        printf_function( "%s", buffer );
+    }
     va_end( args );
 }
 
@@ -202,6 +227,34 @@ void reliable_sequence_buffer_reset( struct reliable_sequence_buffer_t * sequenc
     memset( sequence_buffer->entry_sequence, 0xFF, sizeof( uint32_t) * sequence_buffer->num_entries );
 }
 
+static void reliable_sequence_buffer_clear_entries( struct reliable_sequence_buffer_t * sequence_buffer, int first_sequence, int count )
+{
+    // Marks count consecutive sequence numbers starting at first_sequence as empty. The entries are
+    // contiguous in the buffer apart from at most one wrap at num_entries, so long runs are at most
+    // two memsets. Short runs (one packet at a time is the common case) stay a simple loop.
+    int index = first_sequence % sequence_buffer->num_entries;
+    if ( count < 32 )
+    {
+        int i;
+        for ( i = 0; i < count; ++i )
+        {
+            sequence_buffer->entry_sequence[index] = 0xFFFFFFFF;
+            if ( ++index == sequence_buffer->num_entries )
+                index = 0;
+        }
+        return;
+    }
+    while ( count > 0 )
+    {
+        int n = sequence_buffer->num_entries - index;
+        if ( n > count )
+            n = count;
+        memset( sequence_buffer->entry_sequence + index, 0xFF, n * sizeof( uint32_t ) );
+        count -= n;
+        index = 0;
+    }
+}
+
 void reliable_sequence_buffer_remove_entries( struct reliable_sequence_buffer_t * sequence_buffer, 
                                               int start_sequence, 
                                               int finish_sequence, 
@@ -214,31 +267,42 @@ void reliable_sequence_buffer_remove_entries( struct reliable_sequence_buffer_t
     }
     if ( finish_sequence - start_sequence < sequence_buffer->num_entries )
     {
-        int sequence;
-        for ( sequence = start_sequence; sequence <= finish_sequence; ++sequence )
+        if ( !cleanup_function )
         {
-            if ( cleanup_function )
+            if ( finish_sequence < 65536 )
             {
-                cleanup_function( sequence_buffer->entry_data + sequence_buffer->entry_stride * ( sequence % sequence_buffer->num_entries ), 
-                                  sequence_buffer->allocator_context, 
-                                  sequence_buffer->free_function );
+                reliable_sequence_buffer_clear_entries( sequence_buffer, start_sequence, finish_sequence - start_sequence + 1 );
             }
-            sequence_buffer->entry_sequence[ sequence % sequence_buffer->num_entries ] = 0xFFFFFFFF;
+            else
+            {
+                reliable_sequence_buffer_clear_entries( sequence_buffer, start_sequence, 65536 - start_sequence );
+                reliable_sequence_buffer_clear_entries( sequence_buffer, 0, finish_sequence - 65536 + 1 );
+            }
+            return;
+        }
+        int sequence;
+        for ( sequence = start_sequence; sequence <= finish_sequence; ++sequence )
+        {
+            int index = ( sequence & 0xFFFF ) % sequence_buffer->num_entries;
+            cleanup_function( sequence_buffer->entry_data + sequence_buffer->entry_stride * index, 
+                              sequence_buffer->allocator_context, 
+                              sequence_buffer->free_function );
+            sequence_buffer->entry_sequence[index] = 0xFFFFFFFF;
         }
     }
     else
     {
-        int i;
-        for ( i = 0; i < sequence_buffer->num_entries; ++i )
+        if ( cleanup_function )
         {
-            if ( cleanup_function )
+            int i;
+            for ( i = 0; i < sequence_buffer->num_entries; ++i )
             {
                 cleanup_function( sequence_buffer->entry_data + sequence_buffer->entry_stride * i, 
                                   sequence_buffer->allocator_context, 
                                   sequence_buffer->free_function );
             }
-            sequence_buffer->entry_sequence[i] = 0xFFFFFFFF;
         }
+        memset( sequence_buffer->entry_sequence, 0xFF, sizeof( uint32_t ) * sequence_buffer->num_entries );
     }
 }
 
@@ -358,22 +422,77 @@ void * reliable_sequence_buffer_at_index( struct reliable_sequence_buffer_t * se
     return sequence_buffer->entry_sequence[index] != 0xFFFFFFFF ? ( sequence_buffer->entry_data + index * sequence_buffer->entry_stride ) : NULL;
 }
 
-void reliable_sequence_buffer_generate_ack_bits( struct reliable_sequence_buffer_t * sequence_buffer, uint16_t * ack, uint32_t * ack_bits )
+static uint32_t reliable_sequence_buffer_generate_ack_word( struct reliable_sequence_buffer_t * sequence_buffer, uint16_t newest )
 {
-    reliable_assert( sequence_buffer );
-    reliable_assert( ack );
-    reliable_assert( ack_bits );
-    *ack = sequence_buffer->sequence - 1;
-    *ack_bits = 0;
+    // bit i is set if sequence newest - i is in the buffer
+
+    int last = newest % sequence_buffer->num_entries;
+    if ( newest >= 31 && last >= 31 )
+    {
+        // The 32 sequence numbers newest-31 .. newest neither wrap around 65536 nor around the end of the
+        // buffer, so they sit in 32 consecutive entries. Compare those against the run of expected
+        // sequence numbers directly, instead of doing a modulo and a lookup per sequence number.
+        const uint32_t * entry = sequence_buffer->entry_sequence + last - 31;
+        const uint32_t first = newest - 31;
+#if RELIABLE_SSE2
+        uint32_t forward_bits = 0;
+        __m128i expected = _mm_setr_epi32( (int) first, (int) first + 1, (int) first + 2, (int) first + 3 );
+        const __m128i step = _mm_set1_epi32( 4 );
+        int i;
+        for ( i = 0; i < 32; i += 4 )
+        {
+            __m128i equal = _mm_cmpeq_epi32( _mm_loadu_si128( (const __m128i*) ( entry + i ) ), expected );
+            forward_bits |= ( (uint32_t) _mm_movemask_ps( _mm_castsi128_ps( equal ) ) ) << i;
+            expected = _mm_add_epi32( expected, step );
+        }
+        // forward_bits has bit i set for sequence first + i, but we want bit i for sequence newest - i.
+        forward_bits = ( ( forward_bits >> 1 ) & 0x55555555 ) | ( ( forward_bits & 0x55555555 ) << 1 );
+        forward_bits = ( ( forward_bits >> 2 ) & 0x33333333 ) | ( ( forward_bits & 0x33333333 ) << 2 );
+        forward_bits = ( ( forward_bits >> 4 ) & 0x0F0F0F0F ) | ( ( forward_bits & 0x0F0F0F0F ) << 4 );
+        forward_bits = ( ( forward_bits >> 8 ) & 0x00FF00FF ) | ( ( forward_bits & 0x00FF00FF ) << 8 );
+        return ( forward_bits >> 16 ) | ( forward_bits << 16 );
+#else // #if RELIABLE_SSE2
+        uint32_t bits = 0;
+        int i;
+        for ( i = 0; i < 32; ++i )
+        {
+            bits |= ( (uint32_t) ( entry[i] == first + (uint32_t) i ) ) << ( 31 - i );
+        }
+        return bits;
+#endif // #if RELIABLE_SSE2
+    }
+    uint32_t bits = 0;
     uint32_t mask = 1;
     int i;
     for ( i = 0; i < 32; ++i )
     {
-        uint16_t sequence = *ack - ((uint16_t)i);
+        uint16_t sequence = newest - ((uint16_t)i);
         if ( reliable_sequence_buffer_exists( sequence_buffer, sequence ) )
-            *ack_bits |= mask;
+            bits |= mask;
         mask <<= 1;
     }
+    return bits;
+}
+
+// Generates num_ack_bits / 32 words of ack bits, each word covering the 32 sequence numbers before the last.
+
+void reliable_sequence_buffer_generate_ack_window( struct reliable_sequence_buffer_t * sequence_buffer, uint16_t * ack, uint32_t * ack_bits, int num_ack_bits )
+{
+    reliable_assert( sequence_buffer );
+    reliable_assert( ack );
+    reliable_assert( ack_bits );
+    reliable_assert( num_ack_bits == 32 || num_ack_bits == 64 || num_ack_bits == 128 );
+    *ack = sequence_buffer->sequence - 1;
+    int i;
+    for ( i = 0; i < num_ack_bits / 32; ++i )
+    {
+        ack_bits[i] = reliable_sequence_buffer_generate_ack_word( sequence_buffer, (uint16_t) ( *ack - 32 * i ) );
+    }
+}
+
+void reliable_sequence_buffer_generate_ack_bits( struct reliable_sequence_buffer_t * sequence_buffer, uint16_t * ack, uint32_t * ack_bits )
+{
+    reliable_sequence_buffer_generate_ack_window( sequence_buffer, ack, ack_bits, 32 );
 }
 
 // ---------------------------------------------------------------
@@ -463,7 +582,7 @@ struct reliable_fragment_reassembly_data_t
 {
     uint16_t sequence;
     uint16_t ack;
-    uint32_t ack_bits;
+    uint32_t ack_bits[RELIABLE_MAX_ACK_BITS/32];
     int num_fragments_received;
     int num_fragments_total;
     uint8_t * packet_data;
@@ -546,6 +665,7 @@ void reliable_default_config( struct reliable_config_t * config )
     config->max_fragments = 16;
     config->fragment_size = 1024;
     config->ack_buffer_size = 256;
+    config->ack_bits = 32;
     config->sent_packets_buffer_size = 256;
     config->received_packets_buffer_size = 256;
     config->fragment_reassembly_buffer_size = 64;
@@ -565,6 +685,8 @@ struct reliable_endpoint_t * reliable_endpoint_create( struct reliable_config_t
     reliable_assert( config->max_fragments <= 256 );
     reliable_assert( config->fragment_size > 0 );
     reliable_assert( config->ack_buffer_size > 0 );
+    reliable_assert( config->ack_bits == 32 || config->ack_bits == 64 || config->ack_bits == 128 );
+    reliable_assert( config->received_packets_buffer_size >= config->ack_bits );
     reliable_assert( config->sent_packets_buffer_size > 0 );
     reliable_assert( config->received_packets_buffer_size > 0 );
     reliable_assert( config->transmit_packet_function != NULL );
@@ -689,28 +811,30 @@ uint16_t reliable_endpoint_next_packet_sequence( struct reliable_endpoint_t * en
     return endpoint->sequence;
 }
 
-int reliable_write_packet_header( uint8_t * packet_data, uint16_t sequence, uint16_t ack, uint32_t ack_bits )
+int reliable_write_packet_header( uint8_t * packet_data, uint16_t sequence, uint16_t ack, const uint32_t * ack_bits, int num_ack_bits )
 {
+    reliable_assert( num_ack_bits == 32 || num_ack_bits == 64 || num_ack_bits == 128 );
+
     uint8_t * p = packet_data;
 
     uint8_t prefix_byte = 0;
 
-    if ( ( ack_bits & 0x000000FF ) != 0x000000FF )
+    if ( ( ack_bits[0] & 0x000000FF ) != 0x000000FF )
     {
         prefix_byte |= (1<<1);
     }
 
-    if ( ( ack_bits & 0x0000FF00 ) != 0x0000FF00 )
+    if ( ( ack_bits[0] & 0x0000FF00 ) != 0x0000FF00 )
     {
         prefix_byte |= (1<<2);
     }
 
-    if ( ( ack_bits & 0x00FF0000 ) != 0x00FF0000 )
+    if ( ( ack_bits[0] & 0x00FF0000 ) != 0x00FF0000 )
     {
         prefix_byte |= (1<<3);
     }
 
-    if ( ( ack_bits & 0xFF000000 ) != 0xFF000000 )
+    if ( ( ack_bits[0] & 0xFF000000 ) != 0xFF000000 )
     {
         prefix_byte |= (1<<4);
     }
@@ -721,6 +845,26 @@ int reliable_write_packet_header( uint8_t * packet_data, uint16_t sequence, uint
     if ( sequence_difference <= 255 )
         prefix_byte |= (1<<5);
 
+    // extended ack bits (ack - 32 and older) follow the first 32 when the endpoint is configured for
+    // more than 32. bit 7 says they are all set and nothing follows. bit 6 says a mask follows, one bit
+    // per byte of extended ack bits, then each byte that is not 0xFF. neither bit set means there are no
+    // extended ack bits, which is exactly the 32 bit header.
+
+    int num_extended_bytes = ( num_ack_bits - 32 ) / 8;
+    uint32_t extended_mask = 0;
+    int i;
+    for ( i = 0; i < num_extended_bytes; ++i )
+    {
+        const uint8_t byte = (uint8_t) ( ack_bits[1 + i / 4] >> ( ( i % 4 ) * 8 ) );
+        if ( byte != 0xFF )
+            extended_mask |= ( 1U << i );
+    }
+
+    if ( num_extended_bytes > 0 )
+    {
+        prefix_byte |= extended_mask ? (1<<6) : (1<<7);
+    }
+
     reliable_write_uint8( &p, prefix_byte );
 
     reliable_write_uint16( &p, sequence );
@@ -734,24 +878,41 @@ int reliable_write_packet_header( uint8_t * packet_data, uint16_t sequence, uint
         reliable_write_uint16( &p, ack );
     }
 
-    if ( ( ack_bits & 0x000000FF ) != 0x000000FF )
+    if ( ( ack_bits[0] & 0x000000FF ) != 0x000000FF )
+    {
+        reliable_write_uint8( &p, (uint8_t) ( ack_bits[0] & 0x000000FF ) );
+    }
+
+    if ( ( ack_bits[0] & 0x0000FF00 ) != 0x0000FF00 )
     {
-        reliable_write_uint8( &p, (uint8_t) ( ack_bits & 0x000000FF ) );
+        reliable_write_uint8( &p, (uint8_t) ( ( ack_bits[0] & 0x0000FF00 ) >> 8 ) );
     }
 
-    if ( ( ack_bits & 0x0000FF00 ) != 0x0000FF00 )
+    if ( ( ack_bits[0] & 0x00FF0000 ) != 0x00FF0000 )
     {
-        reliable_write_uint8( &p, (uint8_t) ( ( ack_bits & 0x0000FF00 ) >> 8 ) );
+        reliable_write_uint8( &p, (uint8_t) ( ( ack_bits[0] & 0x00FF0000 ) >> 16 ) );
     }
 
-    if ( ( ack_bits & 0x00FF0000 ) != 0x00FF0000 )
+    if ( ( ack_bits[0] & 0xFF000000 ) != 0xFF000000 )
     {
-        reliable_write_uint8( &p, (uint8_t) ( ( ack_bits & 0x00FF0000 ) >> 16 ) );
+        reliable_write_uint8( &p, (uint8_t) ( ( ack_bits[0] & 0xFF000000 ) >> 24 ) );
     }
 
-    if ( ( ack_bits & 0xFF000000 ) != 0xFF000000 )
+    if ( extended_mask )
     {
-        reliable_write_uint8( &p, (uint8_t) ( ( ack_bits & 0xFF000000 ) >> 24 ) );
+        int num_mask_bytes = ( num_extended_bytes + 7 ) / 8;
+        for ( i = 0; i < num_mask_bytes; ++i )
+        {
+            reliable_write_uint8( &p, (uint8_t) ( extended_mask >> ( i * 8 ) ) );
+        }
+
+        for ( i = 0; i < num_extended_bytes; ++i )
+        {
+            if ( extended_mask & ( 1U << i ) )
+            {
+                reliable_write_uint8( &p, (uint8_t) ( ack_bits[1 + i / 4] >> ( ( i % 4 ) * 8 ) ) );
+            }
+        }
     }
 
     reliable_assert( p - packet_data <= RELIABLE_MAX_PACKET_HEADER_BYTES );
@@ -775,9 +936,9 @@ void reliable_endpoint_send_packet( struct reliable_endpoint_t * endpoint, uint8
 
     uint16_t sequence = endpoint->sequence++;
     uint16_t ack;
-    uint32_t ack_bits;
+    uint32_t ack_bits[RELIABLE_MAX_ACK_BITS/32];
 
-    reliable_sequence_buffer_generate_ack_bits( endpoint->received_packets, &ack, &ack_bits );
+    reliable_sequence_buffer_generate_ack_window( endpoint->received_packets, &ack, ack_bits, endpoint->config.ack_bits );
 
     reliable_printf( RELIABLE_LOG_LEVEL_DEBUG, "[%s] sending packet %d\n", endpoint->config.name, sequence );
 
@@ -797,7 +958,7 @@ void reliable_endpoint_send_packet( struct reliable_endpoint_t * endpoint, uint8
 
         uint8_t * transmit_packet_data = endpoint->transmit_buffer;
 
-        int packet_header_bytes = reliable_write_packet_header( transmit_packet_data, sequence, ack, ack_bits );
+        int packet_header_bytes = reliable_write_packet_header( transmit_packet_data, sequence, ack, ack_bits, endpoint->config.ack_bits );
 
         memcpy( transmit_packet_data + packet_header_bytes, packet_data, packet_bytes );
 
@@ -811,7 +972,7 @@ void reliable_endpoint_send_packet( struct reliable_endpoint_t * endpoint, uint8
 
         memset( packet_header, 0, RELIABLE_MAX_PACKET_HEADER_BYTES );
 
-        int packet_header_bytes = reliable_write_packet_header( packet_header, sequence, ack, ack_bits );        
+        int packet_header_bytes = reliable_write_packet_header( packet_header, sequence, ack, ack_bits, endpoint->config.ack_bits );
 
         int num_fragments = ( packet_bytes / endpoint->config.fragment_size ) + ( ( packet_bytes % endpoint->config.fragment_size ) != 0 ? 1 : 0 );
 
@@ -864,7 +1025,7 @@ void reliable_endpoint_send_packet( struct reliable_endpoint_t * endpoint, uint8
     endpoint->counters[RELIABLE_ENDPOINT_COUNTER_NUM_PACKETS_SENT]++;
 }
 
-int reliable_read_packet_header( RELIABLE_CONST char * name, uint8_t * packet_data, int packet_bytes, uint16_t * sequence, uint16_t * ack, uint32_t * ack_bits )
+int reliable_read_packet_header( RELIABLE_CONST char * name, uint8_t * packet_data, int packet_bytes, uint16_t * sequence, uint16_t * ack, uint32_t * ack_bits, int num_ack_bits )
 {
     if ( packet_bytes < 3 )
     {
@@ -919,30 +1080,95 @@ int reliable_read_packet_header( RELIABLE_CONST char * name, uint8_t * packet_da
         return -1;
     }
 
-    *ack_bits = 0xFFFFFFFF;
+    ack_bits[0] = 0xFFFFFFFF;
 
     if ( prefix_byte & (1<<1) )
     {
-        *ack_bits &= 0xFFFFFF00;
-        *ack_bits |= (uint32_t) ( reliable_read_uint8( &p ) );
+        ack_bits[0] &= 0xFFFFFF00;
+        ack_bits[0] |= (uint32_t) ( reliable_read_uint8( &p ) );
     }
 
     if ( prefix_byte & (1<<2) )
     {
-        *ack_bits &= 0xFFFF00FF;
-        *ack_bits |= (uint32_t) ( reliable_read_uint8( &p ) ) << 8;
+        ack_bits[0] &= 0xFFFF00FF;
+        ack_bits[0] |= (uint32_t) ( reliable_read_uint8( &p ) ) << 8;
     }
 
     if ( prefix_byte & (1<<3) )
     {
-        *ack_bits &= 0xFF00FFFF;
-        *ack_bits |= (uint32_t) ( reliable_read_uint8( &p ) ) << 16;
+        ack_bits[0] &= 0xFF00FFFF;
+        ack_bits[0] |= (uint32_t) ( reliable_read_uint8( &p ) ) << 16;
     }
 
     if ( prefix_byte & (1<<4) )
     {
-        *ack_bits &= 0x00FFFFFF;
-        *ack_bits |= (uint32_t) ( reliable_read_uint8( &p ) ) << 24;
+        ack_bits[0] &= 0x00FFFFFF;
+        ack_bits[0] |= (uint32_t) ( reliable_read_uint8( &p ) ) << 24;
+    }
+
+    // extended ack bits. see reliable_write_packet_header
+
+    int num_extended_bytes = ( num_ack_bits - 32 ) / 8;
+
+    if ( ( prefix_byte & (1<<6) ) && ( prefix_byte & (1<<7) ) )
+    {
+        reliable_printf( RELIABLE_LOG_LEVEL_DEBUG, "[%s] packet header has both extended ack bit flags set\n", name );
+        return -1;
+    }
+
+    if ( ( prefix_byte & ( (1<<6) | (1<<7) ) ) && num_extended_bytes == 0 )
+    {
+        reliable_printf( RELIABLE_LOG_LEVEL_DEBUG, "[%s] packet header has extended ack bits, but this endpoint is configured for 32\n", name );
+        return -1;
+    }
+
+    for ( i = 1; i < num_ack_bits / 32; ++i )
+    {
+        ack_bits[i] = ( prefix_byte & ( (1<<6) | (1<<7) ) ) ? 0xFFFFFFFF : 0;
+    }
+
+    if ( prefix_byte & (1<<6) )
+    {
+        int num_mask_bytes = ( num_extended_bytes + 7 ) / 8;
+        if ( packet_bytes < ( p - packet_data ) + num_mask_bytes )
+        {
+            reliable_printf( RELIABLE_LOG_LEVEL_DEBUG, "[%s] packet too small for packet header (5)\n", name );
+            return -1;
+        }
+
+        uint32_t extended_mask = 0;
+        for ( i = 0; i < num_mask_bytes; ++i )
+        {
+            extended_mask |= ( (uint32_t) reliable_read_uint8( &p ) ) << ( i * 8 );
+        }
+
+        if ( extended_mask == 0 || ( extended_mask >> num_extended_bytes ) != 0 )
+        {
+            reliable_printf( RELIABLE_LOG_LEVEL_DEBUG, "[%s] invalid extended ack bits mask\n", name );
+            return -1;
+        }
+
+        expected_bytes = 0;
+        for ( i = 0; i < num_extended_bytes; ++i )
+        {
+            if ( extended_mask & ( 1U << i ) )
+                expected_bytes++;
+        }
+        if ( packet_bytes < ( p - packet_data ) + expected_bytes )
+        {
+            reliable_printf( RELIABLE_LOG_LEVEL_DEBUG, "[%s] packet too small for packet header (6)\n", name );
+            return -1;
+        }
+
+        for ( i = 0; i < num_extended_bytes; ++i )
+        {
+            if ( extended_mask & ( 1U << i ) )
+            {
+                const int shift = ( i % 4 ) * 8;
+                ack_bits[1 + i / 4] &= ~( 0xFFU << shift );
+                ack_bits[1 + i / 4] |= ( (uint32_t) reliable_read_uint8( &p ) ) << shift;
+            }
+        }
     }
 
     return (int) ( p - packet_data );
@@ -958,7 +1184,8 @@ int reliable_read_fragment_header( char * name,
                                    int * fragment_bytes, 
                                    uint16_t * sequence, 
                                    uint16_t * ack, 
-                                   uint32_t * ack_bits )
+                                   uint32_t * ack_bits,
+                                   int num_ack_bits )
 {
     if ( packet_bytes < RELIABLE_FRAGMENT_HEADER_BYTES )
     {
@@ -995,7 +1222,8 @@ int reliable_read_fragment_header( char * name,
 
     uint16_t packet_sequence = 0;
     uint16_t packet_ack = 0;
-    uint32_t packet_ack_bits = 0;
+    uint32_t packet_ack_bits[RELIABLE_MAX_ACK_BITS/32];
+    memset( packet_ack_bits, 0, sizeof( packet_ack_bits ) );
 
     if ( *fragment_id == 0 )
     {
@@ -1004,7 +1232,8 @@ int reliable_read_fragment_header( char * name,
                                                                packet_bytes - RELIABLE_FRAGMENT_HEADER_BYTES,
                                                                &packet_sequence,
                                                                &packet_ack, 
-                                                               &packet_ack_bits );
+                                                               packet_ack_bits,
+                                                               num_ack_bits );
 
         if ( packet_header_bytes < 0 )
         {
@@ -1022,7 +1251,7 @@ int reliable_read_fragment_header( char * name,
         // header would shift where the fragment payload lands. reject it here instead.
 
         uint8_t canonical_header[RELIABLE_MAX_PACKET_HEADER_BYTES];
-        int canonical_header_bytes = reliable_write_packet_header( canonical_header, packet_sequence, packet_ack, packet_ack_bits );
+        int canonical_header_bytes = reliable_write_packet_header( canonical_header, packet_sequence, packet_ack, packet_ack_bits, num_ack_bits );
         if ( canonical_header_bytes != packet_header_bytes || memcmp( canonical_header, packet_data + RELIABLE_FRAGMENT_HEADER_BYTES, canonical_header_bytes ) != 0 )
         {
             reliable_printf( RELIABLE_LOG_LEVEL_DEBUG, "[%s] non-canonical packet header in fragment\n", name );
@@ -1033,7 +1262,7 @@ int reliable_read_fragment_header( char * name,
     }
 
     *ack = packet_ack;
-    *ack_bits = packet_ack_bits;
+    memcpy( ack_bits, packet_ack_bits, sizeof( uint32_t ) * ( num_ack_bits / 32 ) );
 
     if ( *fragment_bytes > fragment_size )
     {
@@ -1054,7 +1283,8 @@ int reliable_read_fragment_header( char * name,
 void reliable_store_fragment_data( struct reliable_fragment_reassembly_data_t * reassembly_data, 
                                    uint16_t sequence, 
                                    uint16_t ack, 
-                                   uint32_t ack_bits, 
+                                   const uint32_t * ack_bits, 
+                                   int num_ack_bits, 
                                    int fragment_id, 
                                    int fragment_size, 
                                    uint8_t * fragment_data, 
@@ -1066,7 +1296,7 @@ void reliable_store_fragment_data( struct reliable_fragment_reassembly_data_t *
 
         memset( packet_header, 0, RELIABLE_MAX_PACKET_HEADER_BYTES );
 
-        reassembly_data->packet_header_bytes = reliable_write_packet_header( packet_header, sequence, ack, ack_bits );
+        reassembly_data->packet_header_bytes = reliable_write_packet_header( packet_header, sequence, ack, ack_bits, num_ack_bits );
 
         memcpy( reassembly_data->packet_data + RELIABLE_MAX_PACKET_HEADER_BYTES - reassembly_data->packet_header_bytes, 
                 packet_header, 
@@ -1121,9 +1351,9 @@ void reliable_endpoint_receive_packet( struct reliable_endpoint_t * endpoint, ui
 
         uint16_t sequence;
         uint16_t ack;
-        uint32_t ack_bits;
+        uint32_t ack_bits[RELIABLE_MAX_ACK_BITS/32];
 
-        int packet_header_bytes = reliable_read_packet_header( endpoint->config.name, packet_data, packet_bytes, &sequence, &ack, &ack_bits );
+        int packet_header_bytes = reliable_read_packet_header( endpoint->config.name, packet_data, packet_bytes, &sequence, &ack, ack_bits, endpoint->config.ack_bits );
         if ( packet_header_bytes < 0 )
         {
             reliable_printf( RELIABLE_LOG_LEVEL_DEBUG, "[%s] ignoring invalid packet. could not read packet header\n", endpoint->config.name );
@@ -1178,9 +1408,9 @@ void reliable_endpoint_receive_packet( struct reliable_endpoint_t * endpoint, ui
             received_packet_data->packet_bytes = endpoint->config.packet_header_size + packet_bytes;
 
             int i;
-            for ( i = 0; i < 32; ++i )
+            for ( i = 0; i < endpoint->config.ack_bits; ++i )
             {
-                if ( ack_bits & 1 )
+                if ( ack_bits[i/32] & ( 1U << ( i % 32 ) ) )
                 {                    
                     uint16_t ack_sequence = ack - ((uint16_t)i);
                     
@@ -1220,7 +1450,6 @@ void reliable_endpoint_receive_packet( struct reliable_endpoint_t * endpoint, ui
                         }
                     }
                 }
-                ack_bits >>= 1;
             }
         }
         else
@@ -1238,7 +1467,7 @@ void reliable_endpoint_receive_packet( struct reliable_endpoint_t * endpoint, ui
 
         uint16_t sequence;
         uint16_t ack;
-        uint32_t ack_bits;
+        uint32_t ack_bits[RELIABLE_MAX_ACK_BITS/32];
 
         int fragment_header_bytes = reliable_read_fragment_header( endpoint->config.name, 
                                                                    packet_data, 
@@ -1250,7 +1479,8 @@ void reliable_endpoint_receive_packet( struct reliable_endpoint_t * endpoint, ui
                                                                    &fragment_bytes, 
                                                                    &sequence, 
                                                                    &ack, 
-                                                                   &ack_bits );
+                                                                   ack_bits,
+                                                                   endpoint->config.ack_bits );
 
         if ( fragment_header_bytes < 0 )
         {
@@ -1287,7 +1517,7 @@ void reliable_endpoint_receive_packet( struct reliable_endpoint_t * endpoint, ui
 
             reassembly_data->sequence = sequence;
             reassembly_data->ack = 0;
-            reassembly_data->ack_bits = 0;
+            memset( reassembly_data->ack_bits, 0, sizeof( reassembly_data->ack_bits ) );
             reassembly_data->num_fragments_received = 0;
             reassembly_data->num_fragments_total = num_fragments;
             reassembly_data->packet_data = (uint8_t*) endpoint->allocate_function( endpoint->allocator_context, packet_buffer_size );
@@ -1322,6 +1552,7 @@ void reliable_endpoint_receive_packet( struct reliable_endpoint_t * endpoint, ui
                                       sequence, 
                                       ack, 
                                       ack_bits, 
+                                      endpoint->config.ack_bits, 
                                       fragment_id, 
                                       endpoint->config.fragment_size, 
                                       packet_data + fragment_header_bytes, 
@@ -1902,6 +2133,64 @@ static void test_generate_ack_bits()
     reliable_sequence_buffer_destroy( sequence_buffer );
 }
 
+static void test_generate_ack_bits_random()
+{
+    // Insert sequence numbers with random gaps, through several wraps around 65536, and check all
+    // 128 ack bits against a record of which sequence numbers were inserted. Covers both the contiguous
+    // path and the path where 32 entries wrap around the end of the buffer.
+
+    const int buffer_sizes[] = { TEST_SEQUENCE_BUFFER_SIZE, 128 };
+
+    int j;
+    for ( j = 0; j < (int) ( sizeof( buffer_sizes ) / sizeof( buffer_sizes[0] ) ); ++j )
+    {
+        struct reliable_sequence_buffer_t * sequence_buffer = reliable_sequence_buffer_create( buffer_sizes[j], 
+                                                                                               sizeof( struct test_sequence_data_t ), 
+                                                                                               NULL, 
+                                                                                               NULL, 
+                                                                                               NULL );
+
+        static uint8_t inserted[65536];
+        memset( inserted, 0, sizeof( inserted ) );
+
+        uint16_t sequence = 0;
+
+        int i;
+        for ( i = 0; i < 20000; ++i )
+        {
+            int gap = ( rand() % 8 == 0 ) ? 1 + rand() % ( buffer_sizes[j] * 2 ) : 1 + rand() % 3;
+            while ( gap-- > 0 )
+            {
+                sequence++;
+                inserted[sequence] = 0;
+            }
+
+            reliable_sequence_buffer_insert( sequence_buffer, sequence );
+            inserted[sequence] = 1;
+
+            uint16_t ack = 0;
+            uint32_t ack_bits[4];
+            reliable_sequence_buffer_generate_ack_window( sequence_buffer, &ack, ack_bits, 128 );
+
+            check( ack == sequence );
+
+            uint32_t expected_ack_bits[4];
+            memset( expected_ack_bits, 0, sizeof( expected_ack_bits ) );
+            int k;
+            for ( k = 0; k < 128; ++k )
+            {
+                if ( inserted[(uint16_t) ( ack - k )] )
+                    expected_ack_bits[k/32] |= 1U << ( k % 32 );
+            }
+
+            check( memcmp( ack_bits, expected_ack_bits, sizeof( ack_bits ) ) == 0 );
+            check( ack_bits[0] & 1 );
+        }
+
+        reliable_sequence_buffer_destroy( sequence_buffer );
+    }
+}
+
 static void test_packet_header()
 {
     uint16_t write_sequence;
@@ -1920,11 +2209,11 @@ static void test_packet_header()
     write_ack = 100;
     write_ack_bits = 0;
 
-    int bytes_written = reliable_write_packet_header( packet_data, write_sequence, write_ack, write_ack_bits );
+    int bytes_written = reliable_write_packet_header( packet_data, write_sequence, write_ack, &write_ack_bits, 32 );
 
-    check( bytes_written == RELIABLE_MAX_PACKET_HEADER_BYTES );
+    check( bytes_written == 1 + 2 + 2 + 4 );
 
-    int bytes_read = reliable_read_packet_header( "test_packet_header", packet_data, bytes_written, &read_sequence, &read_ack, &read_ack_bits );
+    int bytes_read = reliable_read_packet_header( "test_packet_header", packet_data, bytes_written, &read_sequence, &read_ack, &read_ack_bits, 32 );
 
     check( bytes_read == bytes_written );
 
@@ -1938,11 +2227,11 @@ static void test_packet_header()
     write_ack = 100;
     write_ack_bits = 0xFEFEFFFE;
 
-    bytes_written = reliable_write_packet_header( packet_data, write_sequence, write_ack, write_ack_bits );
+    bytes_written = reliable_write_packet_header( packet_data, write_sequence, write_ack, &write_ack_bits, 32 );
 
     check( bytes_written == 1 + 2 + 2 + 3 );
 
-    bytes_read = reliable_read_packet_header( "test_packet_header", packet_data, bytes_written, &read_sequence, &read_ack, &read_ack_bits );
+    bytes_read = reliable_read_packet_header( "test_packet_header", packet_data, bytes_written, &read_sequence, &read_ack, &read_ack_bits, 32 );
 
     check( bytes_read == bytes_written );
 
@@ -1956,11 +2245,11 @@ static void test_packet_header()
     write_ack = 100;
     write_ack_bits = 0xFFFEFFFF;
 
-    bytes_written = reliable_write_packet_header( packet_data, write_sequence, write_ack, write_ack_bits );
+    bytes_written = reliable_write_packet_header( packet_data, write_sequence, write_ack, &write_ack_bits, 32 );
 
     check( bytes_written == 1 + 2 + 1 + 1 );
 
-    bytes_read = reliable_read_packet_header( "test_packet_header", packet_data, bytes_written, &read_sequence, &read_ack, &read_ack_bits );
+    bytes_read = reliable_read_packet_header( "test_packet_header", packet_data, bytes_written, &read_sequence, &read_ack, &read_ack_bits, 32 );
 
     check( bytes_read == bytes_written );
 
@@ -1974,11 +2263,11 @@ static void test_packet_header()
     write_ack = 100;
     write_ack_bits = 0xFFFFFFFF;
 
-    bytes_written = reliable_write_packet_header( packet_data, write_sequence, write_ack, write_ack_bits );
+    bytes_written = reliable_write_packet_header( packet_data, write_sequence, write_ack, &write_ack_bits, 32 );
 
     check( bytes_written == 1 + 2 + 1 );
 
-    bytes_read = reliable_read_packet_header( "test_packet_header", packet_data, bytes_written, &read_sequence, &read_ack, &read_ack_bits );
+    bytes_read = reliable_read_packet_header( "test_packet_header", packet_data, bytes_written, &read_sequence, &read_ack, &read_ack_bits, 32 );
 
     check( bytes_read == bytes_written );
 
@@ -1987,6 +2276,92 @@ static void test_packet_header()
     check( read_ack_bits == write_ack_bits );
 }
 
+static void test_packet_header_extended_acks()
+{
+    uint8_t packet_data[RELIABLE_MAX_PACKET_HEADER_BYTES];
+
+    uint32_t write_ack_bits[4];
+    uint32_t read_ack_bits[4];
+
+    uint16_t read_sequence;
+    uint16_t read_ack;
+
+    // no packet loss. extended ack bits cost nothing over the 32 bit header.
+
+    memset( write_ack_bits, 0xFF, sizeof( write_ack_bits ) );
+
+    int bytes_written = reliable_write_packet_header( packet_data, 200, 100, write_ack_bits, 128 );
+    check( bytes_written == 1 + 2 + 1 );
+
+    int bytes_read = reliable_read_packet_header( "test_packet_header_extended_acks", packet_data, bytes_written, &read_sequence, &read_ack, read_ack_bits, 128 );
+    check( bytes_read == bytes_written );
+    check( read_sequence == 200 );
+    check( read_ack == 100 );
+    check( memcmp( read_ack_bits, write_ack_bits, sizeof( write_ack_bits ) ) == 0 );
+
+    // worst case with 128 ack bits, sequence and ack far apart, nothing acked
+
+    memset( write_ack_bits, 0, sizeof( write_ack_bits ) );
+
+    bytes_written = reliable_write_packet_header( packet_data, 10000, 100, write_ack_bits, 128 );
+    check( bytes_written == RELIABLE_MAX_PACKET_HEADER_BYTES );
+
+    bytes_read = reliable_read_packet_header( "test_packet_header_extended_acks", packet_data, bytes_written, &read_sequence, &read_ack, read_ack_bits, 128 );
+    check( bytes_read == bytes_written );
+    check( memcmp( read_ack_bits, write_ack_bits, sizeof( write_ack_bits ) ) == 0 );
+
+    // one missing packet in the extended window with 64 ack bits: a one byte mask and one byte of ack bits
+
+    write_ack_bits[0] = 0xFFFFFFFF;
+    write_ack_bits[1] = 0xFFFEFFFF;
+
+    bytes_written = reliable_write_packet_header( packet_data, 200, 100, write_ack_bits, 64 );
+    check( bytes_written == 1 + 2 + 1 + 1 + 1 );
+
+    bytes_read = reliable_read_packet_header( "test_packet_header_extended_acks", packet_data, bytes_written, &read_sequence, &read_ack, read_ack_bits, 64 );
+    check( bytes_read == bytes_written );
+    check( memcmp( read_ack_bits, write_ack_bits, sizeof( uint32_t ) * 2 ) == 0 );
+
+    // random ack bits round trip at every width
+
+    const int widths[] = { 32, 64, 128 };
+    int i;
+    for ( i = 0; i < 1000; ++i )
+    {
+        const int num_ack_bits = widths[i%3];
+        int j;
+        for ( j = 0; j < 4; ++j )
+        {
+            // mostly set, like real ack bits, with the occasional run of loss
+            write_ack_bits[j] = ( rand() % 2 ) ? 0xFFFFFFFF : ( (uint32_t) rand() | ( (uint32_t) rand() << 16 ) );
+        }
+        const uint16_t sequence = (uint16_t) rand();
+        const uint16_t ack = (uint16_t) ( sequence - rand() % 512 );
+        bytes_written = reliable_write_packet_header( packet_data, sequence, ack, write_ack_bits, num_ack_bits );
+        check( bytes_written <= RELIABLE_MAX_PACKET_HEADER_BYTES );
+        bytes_read = reliable_read_packet_header( "test_packet_header_extended_acks", packet_data, bytes_written, &read_sequence, &read_ack, read_ack_bits, num_ack_bits );
+        check( bytes_read == bytes_written );
+        check( read_sequence == sequence );
+        check( read_ack == ack );
+        check( memcmp( read_ack_bits, write_ack_bits, sizeof( uint32_t ) * ( num_ack_bits / 32 ) ) == 0 );
+        check( reliable_read_packet_header( "test_packet_header_extended_acks", packet_data, bytes_written - 1, &read_sequence, &read_ack, read_ack_bits, num_ack_bits ) < 0 );
+    }
+
+    // a header with extended ack bits can't be read by an endpoint configured for 32 ack bits
+
+    memset( write_ack_bits, 0xFF, sizeof( write_ack_bits ) );
+    bytes_written = reliable_write_packet_header( packet_data, 200, 100, write_ack_bits, 64 );
+    check( reliable_read_packet_header( "test_packet_header_extended_acks", packet_data, bytes_written, &read_sequence, &read_ack, read_ack_bits, 32 ) < 0 );
+
+    // a 32 bit header read with extended ack bits acks nothing beyond the first 32
+
+    bytes_written = reliable_write_packet_header( packet_data, 200, 100, write_ack_bits, 32 );
+    bytes_read = reliable_read_packet_header( "test_packet_header_extended_acks", packet_data, bytes_written, &read_sequence, &read_ack, read_ack_bits, 128 );
+    check( bytes_read == bytes_written );
+    check( read_ack_bits[0] == 0xFFFFFFFF );
+    check( read_ack_bits[1] == 0 && read_ack_bits[2] == 0 && read_ack_bits[3] == 0 );
+}
+
 struct test_context_t
 {
     int drop;
@@ -2124,6 +2499,87 @@ static void test_acks()
     reliable_endpoint_destroy( context.receiver );
 }
 
+#define TEST_ACKS_BURST_NUM_BURSTS 8
+
+static int test_acks_burst( int ack_bits, int burst_size )
+{
+    // the sender sends bursts of packets and the receiver replies once per burst, so each reply has to
+    // ack the whole burst. returns how many of the sender's packets were acked.
+
+    double time = 100.0;
+
+    struct test_context_t context;
+    test_default_context( &context );
+    
+    struct reliable_config_t sender_config;
+    struct reliable_config_t receiver_config;
+
+    reliable_default_config( &sender_config );
+    reliable_default_config( &receiver_config );
+
+    sender_config.context = &context;
+    sender_config.id = 0;
+    sender_config.ack_bits = ack_bits;
+    sender_config.transmit_packet_function = &test_transmit_packet_function;
+    sender_config.process_packet_function = &test_process_packet_function;
+
+    receiver_config.context = &context;
+    receiver_config.id = 1;
+    receiver_config.ack_bits = ack_bits;
+    receiver_config.transmit_packet_function = &test_transmit_packet_function;
+    receiver_config.process_packet_function = &test_process_packet_function;
+
+    context.sender = reliable_endpoint_create( &sender_config, time );
+    context.receiver = reliable_endpoint_create( &receiver_config, time );
+
+    int num_acked = 0;
+
+    int i;
+    for ( i = 0; i < TEST_ACKS_BURST_NUM_BURSTS; ++i )
+    {
+        uint8_t dummy_packet[8];
+        memset( dummy_packet, 0, sizeof( dummy_packet ) );
+
+        int j;
+        for ( j = 0; j < burst_size; ++j )
+        {
+            reliable_endpoint_send_packet( context.sender, dummy_packet, sizeof( dummy_packet ) );
+        }
+
+        reliable_endpoint_send_packet( context.receiver, dummy_packet, sizeof( dummy_packet ) );
+
+        int num_acks;
+        reliable_endpoint_get_acks( context.sender, &num_acks );
+        num_acked += num_acks;
+        reliable_endpoint_clear_acks( context.sender );
+
+        reliable_endpoint_update( context.sender, time );
+        reliable_endpoint_update( context.receiver, time );
+
+        time += 0.01;
+    }
+
+    reliable_endpoint_destroy( context.sender );
+    reliable_endpoint_destroy( context.receiver );
+
+    return num_acked;
+}
+
+static void test_acks_extended()
+{
+    const int burst_size = 100;
+    const int num_bursts = TEST_ACKS_BURST_NUM_BURSTS;
+
+    // 32 ack bits only reach the last 32 packets of each burst
+
+    check( test_acks_burst( 32, burst_size ) == 32 * num_bursts );
+
+    // 64 ack bits reach 64 of them, and 128 reach the whole burst
+
+    check( test_acks_burst( 64, burst_size ) == 64 * num_bursts );
+    check( test_acks_burst( 128, burst_size ) == burst_size * num_bursts );
+}
+
 static void test_acks_packet_loss()
 {
     double time = 100.0;
@@ -3046,9 +3502,12 @@ void reliable_test()
         RUN_TEST( test_endian );
         RUN_TEST( test_sequence_buffer );
         RUN_TEST( test_generate_ack_bits );
+        RUN_TEST( test_generate_ack_bits_random );
         RUN_TEST( test_packet_header );
+        RUN_TEST( test_packet_header_extended_acks );
         RUN_TEST( test_acks );
         RUN_TEST( test_acks_packet_loss );
+        RUN_TEST( test_acks_extended );
         RUN_TEST( test_duplicate_packets );
         RUN_TEST( test_stale_packets );
         RUN_TEST( test_ack_buffer_overflow );
@@ -39,6 +39,7 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include <stdarg.h>
 #include <string.h>
 #include <inttypes.h>
 
@@ -84,7 +85,8 @@
 #define RELIABLE_ENDPOINT_COUNTER_NUM_PACKETS_DUPLICATE                     10
 #define RELIABLE_ENDPOINT_NUM_COUNTERS                                      11
 
-#define RELIABLE_MAX_PACKET_HEADER_BYTES 9
+#define RELIABLE_MAX_ACK_BITS            128
+#define RELIABLE_MAX_PACKET_HEADER_BYTES 23                                     // 9 with 32 ack bits, plus up to 2 mask bytes and 12 bytes of extended ack bits
 #define RELIABLE_FRAGMENT_HEADER_BYTES   5
 
 #define RELIABLE_LOG_LEVEL_NONE     0
@@ -124,6 +126,7 @@ struct reliable_config_t
     int max_fragments;                                                          // maximum number of fragments per-packet. 256 max. must cover max_packet_size / fragment_size
     int fragment_size;                                                          // size of each fragment (bytes)
     int ack_buffer_size;                                                        // maximum number of acks buffered between calls to reliable_endpoint_clear_acks
+    int ack_bits;                                                               // number of packets acked by each packet header: 32, 64 or 128. must be the same on both endpoints. use more than 32 when sending more than 32 packets per round trip, otherwise acks fall off the window and received packets count as lost
     int sent_packets_buffer_size;                                               // number of sent packets tracked for acks, packet loss and bandwidth stats
     int received_packets_buffer_size;                                           // number of received packets tracked. also the window for stale and duplicate packet rejection
     int fragment_reassembly_buffer_size;                                        // number of packets that can be under reassembly from fragments at the same time
@@ -217,6 +220,10 @@ void reliable_log_level( int level );
 
 void reliable_set_printf_function( int (*function)( RELIABLE_CONST char *, ... ) );
 
+// when set, log messages go here unformatted, instead of being formatted and passed to the printf function. NULL to turn off
+
+void reliable_set_vprintf_function( void (*function)( RELIABLE_CONST char *, va_list ) );
+
 extern void (*reliable_assert_function)( RELIABLE_CONST char *, RELIABLE_CONST char *, RELIABLE_CONST char * file, int line );
 
 #ifdef RELIABLE_DEBUG
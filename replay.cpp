@@ -0,0 +1,148 @@
+/*
+    Yojimbo Capture Replay.
+
+    Copyright © 2016 - 2026, Más Bandwidth LLC
+
+    Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+        1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+        2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer 
+           in the documentation and/or other materials provided with the distribution.
+
+        3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived 
+           from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+    INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+    SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+    USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "shared.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+    Replays a packet capture (see yojimbo_capture.h) through fresh connections as fast as possible, and reports how long it took.
+    Capture a server with Server::StartCapture, or run `bin/server capture.bin`, then replay it here on the same or another version
+    to profile that exact traffic.
+
+    usage: replay <capture file> [--repeat N] [--sent]
+
+        --repeat N  replay the capture N times, and report each pass and the fastest
+        --sent      also replay the packets the server sent, into a peer connection per client
+
+    Messages are created with the sample message factory from shared.h, so this replays captures of the sample programs and tests.
+    For your own game, call ReplayCapture the same way with your message factory.
+*/
+
+const int ReplayHeapBytes = 64 * 1024 * 1024;
+
+int ReplayMain( const char * path, int numPasses, bool replaySent )
+{
+    PacketCaptureReader reader( GetDefaultAllocator() );
+
+    if ( !reader.Open( path ) )
+        return 1;
+
+    const ConnectionConfig & config = reader.GetConnectionConfig();
+
+    printf( "%s: %s capture, %d channel(s), %d byte max packet size\n\n", path, reader.IsServer() ? "server" : "client", config.numChannels, config.maxPacketSize );
+
+    // messages and connections come from a heap created by the adapter, as they do for a server's client slots
+
+    uint8_t * memory = (uint8_t*) malloc( ReplayHeapBytes );
+    if ( !memory )
+    {
+        printf( "error: failed to allocate replay heap\n" );
+        return 1;
+    }
+
+    Allocator * allocator = adapter.CreateAllocator( GetDefaultAllocator(), memory, ReplayHeapBytes );
+    MessageFactory * messageFactory = adapter.CreateMessageFactory( *allocator );
+
+    double bestSeconds = 0.0;
+    CaptureReplayStats stats;
+    bool result = true;
+
+    for ( int pass = 0; pass < numPasses && result; ++pass )
+    {
+        reader.Rewind();
+
+        const double start = yojimbo_time();
+        result = ReplayCapture( *allocator, *messageFactory, NULL, reader, replaySent, stats );
+        const double seconds = yojimbo_time() - start;
+
+        if ( pass == 0 || seconds < bestSeconds )
+            bestSeconds = seconds;
+
+        const uint64_t numPackets = stats.numPacketsReceived + stats.numPacketsSent;
+
+        printf( "pass %d: %.6f seconds, %.0f packets/sec, %.1f MB/s, %.0f ns/packet\n",
+            pass + 1, seconds, numPackets / seconds, stats.packetBytes / ( 1024.0 * 1024.0 ) / seconds, numPackets ? seconds * 1000000000.0 / numPackets : 0.0 );
+    }
+
+    printf( "\n%" PRIu64 " records, %" PRIu64 " packets received, %" PRIu64 " packets sent, %" PRIu64 " bytes, %" PRIu64 " messages, %" PRIu64 " updates, %" PRIu64 " connects\n",
+        stats.numRecords, stats.numPacketsReceived, stats.numPacketsSent, stats.packetBytes, stats.numMessagesReceived, stats.numAdvanceTimes, stats.numConnects );
+
+    if ( numPasses > 1 )
+        printf( "fastest pass: %.6f seconds\n", bestSeconds );
+
+    if ( stats.numPacketErrors > 0 )
+        printf( "warning: %" PRIu64 " packets failed to process. was the capture taken with a different packet format or message types?\n", stats.numPacketErrors );
+
+    if ( reader.IsTruncated() )
+        printf( "warning: the capture ends in a truncated record. everything before it was replayed\n" );
+
+    YOJIMBO_DELETE( *allocator, MessageFactory, messageFactory );
+    YOJIMBO_DELETE( GetDefaultAllocator(), Allocator, allocator );
+    free( memory );
+
+    return ( result && stats.numPacketErrors == 0 ) ? 0 : 1;
+}
+
+int main( int argc, char ** argv )
+{
+    printf( "\n" );
+
+    const char * path = NULL;
+    int numPasses = 1;
+    bool replaySent = false;
+
+    for ( int i = 1; i < argc; ++i )
+    {
+        if ( strcmp( argv[i], "--repeat" ) == 0 && i + 1 < argc )
+            numPasses = atoi( argv[++i] );
+        else if ( strcmp( argv[i], "--sent" ) == 0 )
+            replaySent = true;
+        else
+            path = argv[i];
+    }
+
+    if ( !path || numPasses < 1 )
+    {
+        printf( "usage: replay <capture file> [--repeat N] [--sent]\n\n" );
+        return 1;
+    }
+
+    if ( !InitializeYojimbo() )
+    {
+        printf( "error: failed to initialize Yojimbo!\n" );
+        return 1;
+    }
+
+    yojimbo_log_level( YOJIMBO_LOG_LEVEL_ERROR );
+
+    int result = ReplayMain( path, numPasses, replaySent );
+
+    ShutdownYojimbo();
+
+    printf( "\n" );
+
+    return result;
+}
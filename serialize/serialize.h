@@ -1049,6 +1049,73 @@ namespace serialize
         return int32_t( ( n >> 1 ) ^ ( 0 - ( n & 1 ) ) );
     }
 
+    /**
+        The largest quantized integer for a compressed float range, as used by serialize_compressed_float and serialize_compressed_float_array.
+        The number of quantization steps is clamped to [1,2^32) so the conversion to uint32_t is defined even for pathological delta / res.
+        @param min The minimum float value.
+        @param max The maximum float value.
+        @param res The resolution.
+        @returns The largest integer value. Values are encoded in bits_required( 0, maxIntegerValue ) bits.
+     */
+
+    inline uint32_t compressed_float_max_integer_value( float min, float max, float res )
+    {
+        serialize_assert( min < max && res > 0 );
+
+        float values = ( max - min ) / res;
+
+        // clamp so the uint32_t cast below is defined even for pathological delta / res (the !>= form also catches NaN)
+        if ( !( values >= 1.0f ) )
+        {
+            values = 1.0f;
+        }
+        else if ( values > 4294967040.0f )      // largest float below 2^32
+        {
+            values = 4294967040.0f;
+        }
+
+        return (uint32_t) ceil(values);
+    }
+
+    /**
+        Quantize a float to a compressed float integer value.
+        @param value The float value. Clamped to [min,max], and NaN is forced to min.
+        @param min The minimum float value.
+        @param delta The float range, max - min.
+        @param maxIntegerValue The largest integer value (see compressed_float_max_integer_value).
+        @returns The integer value in [0,maxIntegerValue].
+     */
+
+    inline uint32_t compressed_float_quantize( float value, float min, float delta, uint32_t maxIntegerValue )
+    {
+        // clamp with the !>= / !<= form so a NaN value is forced into range instead of reaching the uint32 cast below
+        float normalizedValue = (value - min) / delta;
+        if ( !( normalizedValue >= 0.0f ) )
+        {
+            normalizedValue = 0.0f;
+        }
+        else if ( !( normalizedValue <= 1.0f ) )
+        {
+            normalizedValue = 1.0f;
+        }
+        return (uint32_t) floor( normalizedValue * maxIntegerValue + 0.5f );
+    }
+
+    /**
+        Convert a compressed float integer value back to a float.
+        @param integerValue The integer value in [0,maxIntegerValue].
+        @param min The minimum float value.
+        @param delta The float range, max - min.
+        @param maxIntegerValue The largest integer value (see compressed_float_max_integer_value).
+        @returns The float value in [min,max].
+     */
+
+    inline float compressed_float_dequantize( uint32_t integerValue, float min, float delta, uint32_t maxIntegerValue )
+    {
+        const float normalizedValue = integerValue / float(maxIntegerValue);
+        return normalizedValue * delta + min;
+    }
+
     /**
         Bitpacks unsigned integer values to a buffer.
         Integer bit values are written to a 64 bit scratch value from right to left.
@@ -1147,6 +1214,55 @@ namespace serialize
             m_bitsWritten += bits;
         }
 
+        /**
+            Write an array of values to the buffer, each with the same number of bits.
+            Produces exactly the same bits as calling WriteBits( values[i] - bias, bits ) for each value, but keeps the scratch state in locals across the whole run, so the compiler holds it in registers instead of reloading the members for every value.
+            @param values The values to write. Each values[i] - bias must be in [0,(1<<bits)-1].
+            @param count The number of values to write.
+            @param bits The number of bits to encode each value with, in [1,32].
+            @param bias Subtracted from each value before it is written (unsigned, so it wraps). Pass the range minimum for ranged integers, or zero.
+            @see BitReader::ReadBitsArray
+         */
+
+        void WriteBitsArray( const uint32_t * serialize_restrict values, int count, int bits, uint32_t bias ) serialize_restrict     // restrict qualified this: see WriteBits
+        {
+            serialize_assert( m_data );                 // if this fires, the writer was used before Initialize
+            serialize_assert( count >= 0 );
+            serialize_assert( bits > 0 );
+            serialize_assert( bits <= 32 );
+            serialize_assert( m_bitsWritten + int64_t( count ) * bits <= m_numBits );
+
+            uint8_t * data = m_data;
+            uint64_t scratch = m_scratch;
+            int scratchBits = m_scratchBits;
+            int64_t wordIndex = m_wordIndex;
+
+            for ( int i = 0; i < count; ++i )
+            {
+                const uint32_t value = values[i] - bias;
+
+                serialize_assert( uint64_t( value ) <= ( ( 1ULL << bits ) - 1 ) );
+
+                scratch |= uint64_t( value ) << scratchBits;
+                scratchBits += bits;
+
+                if ( scratchBits >= 64 )
+                {
+                    const uint64_t word = host_to_network( scratch );
+                    memcpy( data + (size_t) wordIndex * 8, &word, sizeof( word ) );
+                    wordIndex++;
+                    scratchBits -= 64;
+                    // the top scratchBits bits of value spilled past 64. the shift is in [1,32], so it is defined even when nothing spilled
+                    scratch = uint64_t( value ) >> ( bits - scratchBits );
+                }
+            }
+
+            m_scratch = scratch;
+            m_scratchBits = scratchBits;
+            m_wordIndex = wordIndex;
+            m_bitsWritten += int64_t( count ) * bits;
+        }
+
         /**
             Write an alignment to the bit stream, padding zeros so the bit index becomes is a multiple of 8.
             This is useful if you want to write some data to a packet that should be byte aligned. For example, an array of bytes, or a string.
@@ -1181,11 +1297,27 @@ namespace serialize
             serialize_assert( uint64_t(m_bitsWritten) + uint64_t(bytes) * 8 <= uint64_t(m_numBits) );
             serialize_assert( ( m_bitsWritten % 8 ) == 0 );                         // byte aligned (GetAlignBits() == 0, spelled directly: a restrict qualified function cannot call unqualified members on some compilers)
 
+            // head and tail bytes go into the scratch word in one merge each, instead of one WriteBits per byte.
+            // the network byte order is little endian, so byte i of a partial word sits at bit 8*i of the scratch
+
             int64_t headBytes = ( 8 - ( m_bitsWritten % 64 ) / 8 ) % 8;
             if ( headBytes > bytes )
                 headBytes = bytes;
-            for ( int64_t i = 0; i < headBytes; ++i )
-                WriteBits( data[i], 8 );
+            if ( headBytes > 0 )
+            {
+                serialize_assert( m_scratchBits + headBytes * 8 <= 64 );
+                m_scratch |= LoadPartialWord( data, (int) headBytes ) << m_scratchBits;
+                m_scratchBits += (int) headBytes * 8;
+                m_bitsWritten += headBytes * 8;
+                if ( m_scratchBits == 64 )
+                {
+                    const uint64_t word = host_to_network( m_scratch );
+                    memcpy( m_data + (size_t) m_wordIndex * 8, &word, sizeof( word ) );
+                    m_wordIndex++;
+                    m_scratch = 0;
+                    m_scratchBits = 0;
+                }
+            }
             if ( headBytes == bytes )
                 return;
 
@@ -1206,14 +1338,35 @@ namespace serialize
             int64_t tailStart = headBytes + numWords * 8;
             int64_t tailBytes = bytes - tailStart;
             serialize_assert( tailBytes >= 0 && tailBytes < 8 );
-            for ( int64_t i = 0; i < tailBytes; ++i )
-                WriteBits( data[tailStart+i], 8 );
+            if ( tailBytes > 0 )
+            {
+                m_scratch = LoadPartialWord( data + tailStart, (int) tailBytes );
+                m_scratchBits = (int) tailBytes * 8;
+                m_bitsWritten += tailBytes * 8;
+            }
 
             serialize_assert( ( m_bitsWritten % 8 ) == 0 );     // still byte aligned
 
             serialize_assert( headBytes + numWords * 8 + tailBytes == bytes );
         }
 
+        /**
+            Load 1 to 7 bytes as the low bytes of a word, first byte lowest. Used to merge a partial word of bytes into scratch.
+            @param data The bytes to load.
+            @param bytes The number of bytes to load in [1,7].
+            @returns The bytes as a little endian word, with the unused high bytes zero.
+         */
+
+        static uint64_t LoadPartialWord( const uint8_t * data, int bytes )
+        {
+            serialize_assert( bytes > 0 );
+            serialize_assert( bytes < 8 );
+            uint64_t value = 0;
+            for ( int i = 0; i < bytes; ++i )
+                value |= uint64_t( data[i] ) << ( i * 8 );
+            return value;
+        }
+
         /**
             Flush any remaining bits to memory.
             Call this once after you've finished writing bits to flush the last word of scratch to memory!
@@ -1383,6 +1536,55 @@ namespace serialize
             return output;
         }
 
+        /**
+            Read an array of values from the bit buffer, each with the same number of bits.
+            Reads exactly the bits that calling ReadBits( bits ) once per value would, keeping the read position in a local across the whole run.
+            The caller checks the whole run is in bounds first (see BitReader::GetBitsRemaining), just as with ReadBits.
+            @param values The values read are stored here, as the raw value plus bias. Written even when the function fails.
+            @param count The number of values to read.
+            @param bits The number of bits to read for each value, in [1,32].
+            @param bias Added to each raw value (unsigned, so it wraps). Pass the range minimum for ranged integers, or zero.
+            @param maxValue The largest valid raw value. Encodings above this are malicious or corrupt.
+            @returns True if every raw value is in [0,maxValue], false otherwise.
+            @see BitWriter::WriteBitsArray
+         */
+
+        bool ReadBitsArray( uint32_t * serialize_restrict values, int count, int bits, uint32_t bias, uint32_t maxValue )
+        {
+            serialize_assert( m_data );                 // if this fires, the reader was used before Initialize
+            serialize_assert( count >= 0 );
+            serialize_assert( bits > 0 );
+            serialize_assert( bits <= 32 );
+            serialize_assert( m_bitsRead + int64_t( count ) * bits <= m_numBits );
+
+            const uint8_t * data = m_data;
+            const uint32_t mask = uint32_t( ( uint64_t(1) << bits ) - 1 );
+            int64_t bitsRead = m_bitsRead;
+
+            // validate without a branch per value: a single out of range encoding fails the whole array
+            uint32_t invalid = 0;
+
+            for ( int i = 0; i < count; ++i )
+            {
+                // loads up to 7 bytes past the last data byte: the allocation contract covers this
+                uint64_t window;
+                memcpy( &window, data + ( bitsRead >> 3 ), sizeof( window ) );
+                window = network_to_host( window );
+
+                const uint32_t value = uint32_t( window >> ( bitsRead & 7 ) ) & mask;
+
+                invalid |= uint32_t( value > maxValue );
+
+                values[i] = value + bias;
+
+                bitsRead += bits;
+            }
+
+            m_bitsRead = bitsRead;
+
+            return invalid == 0;
+        }
+
         /**
             Read an align.
             Call this on read to correspond to a WriteAlign call when the bitpacked buffer was written.
@@ -1665,6 +1867,105 @@ namespace serialize
             return true;
         }
 
+        /**
+            Serialize an array of integers (write).
+            The bits are identical to calling SerializeInteger on each value in turn, but the bit width is computed once and the whole run is packed by BitWriter::WriteBitsArray.
+            @param values The integer values, each in [min,max].
+            @param count The number of values.
+            @param min The minimum value.
+            @param max The maximum value.
+            @returns Always returns true. All checking is performed by debug asserts only on write.
+         */
+
+        bool SerializeIntegerArray( const int32_t * values, int count, int32_t min, int32_t max )
+        {
+            serialize_assert( values || count == 0 );
+            serialize_assert( count >= 0 );
+            serialize_assert( min < max );
+            for ( int i = 0; i < count; ++i )
+            {
+                serialize_assert( values[i] >= min );
+                serialize_assert( values[i] <= max );
+            }
+            const int bits = bits_required( min, max );
+            // int32_t and uint32_t may alias, and the subtraction of min in the kernel happens in the unsigned domain
+            m_writer.WriteBitsArray( (const uint32_t*) values, count, bits, uint32_t(min) );
+            return true;
+        }
+
+        /**
+            Serialize an array of compressed floats (write).
+            The bits are identical to calling serialize_compressed_float on each value in turn. Values are quantized a chunk at a time, then packed by BitWriter::WriteBitsArray.
+            @param values The float values. Values outside [min,max] are clamped.
+            @param count The number of values.
+            @param min The minimum value.
+            @param max The maximum value.
+            @param res The resolution.
+            @returns Always returns true. All checking is performed by debug asserts only on write.
+         */
+
+        bool SerializeCompressedFloatArray( const float * values, int count, float min, float max, float res )
+        {
+            serialize_assert( values || count == 0 );
+            serialize_assert( count >= 0 );
+            const float delta = max - min;
+            const uint32_t maxIntegerValue = compressed_float_max_integer_value( min, max, res );
+            const int bits = bits_required( 0, maxIntegerValue );
+            uint32_t chunk[64];
+            for ( int start = 0; start < count; start += 64 )
+            {
+                const int chunkCount = ( count - start < 64 ) ? ( count - start ) : 64;
+                for ( int i = 0; i < chunkCount; ++i )
+                    chunk[i] = compressed_float_quantize( values[start+i], min, delta, maxIntegerValue );
+                m_writer.WriteBitsArray( chunk, chunkCount, bits, 0 );
+            }
+            return true;
+        }
+
+        /**
+            Serialize a sorted array of integers (write).
+            Values must be strictly increasing, like a list of entity ids. The first value is written like SerializeInteger, then each gap minus one is written with the bit width of the widest gap, sent once in 6 bits. A run of consecutive ids costs nothing past the first value and the width.
+            @param values The integer values, each in [min,max] and strictly increasing.
+            @param count The number of values.
+            @param min The minimum value.
+            @param max The maximum value.
+            @returns Always returns true. All checking is performed by debug asserts only on write.
+         */
+
+        bool SerializeSortedIntegerArray( const int32_t * values, int count, int32_t min, int32_t max )
+        {
+            serialize_assert( values || count == 0 );
+            serialize_assert( count >= 0 );
+            serialize_assert( min < max );
+            if ( count == 0 )
+                return true;
+            serialize_assert( values[0] >= min );
+            serialize_assert( values[count-1] <= max );
+            m_writer.WriteBits( uint32_t(values[0]) - uint32_t(min), bits_required( min, max ) );
+            if ( count == 1 )
+                return true;
+            // or-ing the gaps gives the same bit width as their maximum, without a compare per value
+            uint32_t gapBitsUnion = 0;
+            for ( int i = 1; i < count; ++i )
+            {
+                serialize_assert( values[i] > values[i-1] );
+                gapBitsUnion |= uint32_t(values[i]) - uint32_t(values[i-1]) - 1;
+            }
+            const int gapBits = bits_required( 0, gapBitsUnion );
+            m_writer.WriteBits( uint32_t( gapBits ), 6 );
+            if ( gapBits == 0 )
+                return true;
+            uint32_t chunk[64];
+            for ( int start = 1; start < count; start += 64 )
+            {
+                const int chunkCount = ( count - start < 64 ) ? ( count - start ) : 64;
+                for ( int i = 0; i < chunkCount; ++i )
+                    chunk[i] = uint32_t(values[start+i]) - uint32_t(values[start+i-1]) - 1;
+                m_writer.WriteBitsArray( chunk, chunkCount, gapBits, 0 );
+            }
+            return true;
+        }
+
         /**
             Serialize an array of bytes (write).
             @param data Array of bytes to be written.
@@ -1905,6 +2206,117 @@ namespace serialize
             return true;
         }
 
+        /**
+            Serialize an array of integers (read).
+            @param values The integer values read are stored here. They are guaranteed to be in [min,max] if this function succeeds.
+            @param count The number of values.
+            @param min The minimum allowed value.
+            @param max The maximum allowed value.
+            @returns Returns true if the serialize succeeded and every value is in the correct range. False otherwise.
+         */
+
+        bool SerializeIntegerArray( int32_t * values, int count, int32_t min, int32_t max )
+        {
+            serialize_assert( min < max );
+            if ( count < 0 )
+                return false;
+            const int bits = bits_required( min, max );
+            if ( int64_t( count ) * bits > m_reader.GetBitsRemaining() )
+                return false;
+            // int32_t and uint32_t may alias, and the addition of min in the kernel happens in the unsigned domain
+            return m_reader.ReadBitsArray( (uint32_t*) values, count, bits, uint32_t(min), uint32_t(max) - uint32_t(min) );
+        }
+
+        /**
+            Serialize an array of compressed floats (read).
+            @param values The float values read are stored here. They are guaranteed to be in [min,max] if this function succeeds.
+            @param count The number of values.
+            @param min The minimum value.
+            @param max The maximum value.
+            @param res The resolution.
+            @returns Returns true if the serialize succeeded and every encoded value is in range. False otherwise.
+         */
+
+        bool SerializeCompressedFloatArray( float * values, int count, float min, float max, float res )
+        {
+            if ( count < 0 )
+                return false;
+            const float delta = max - min;
+            const uint32_t maxIntegerValue = compressed_float_max_integer_value( min, max, res );
+            const int bits = bits_required( 0, maxIntegerValue );
+            if ( int64_t( count ) * bits > m_reader.GetBitsRemaining() )
+                return false;
+            uint32_t chunk[64];
+            for ( int start = 0; start < count; start += 64 )
+            {
+                const int chunkCount = ( count - start < 64 ) ? ( count - start ) : 64;
+                if ( !m_reader.ReadBitsArray( chunk, chunkCount, bits, 0, maxIntegerValue ) )
+                    return false;
+                for ( int i = 0; i < chunkCount; ++i )
+                    values[start+i] = compressed_float_dequantize( chunk[i], min, delta, maxIntegerValue );
+            }
+            return true;
+        }
+
+        /**
+            Serialize a sorted array of integers (read).
+            @param values The integer values read are stored here. They are guaranteed to be in [min,max] and strictly increasing if this function succeeds.
+            @param count The number of values.
+            @param min The minimum allowed value.
+            @param max The maximum allowed value.
+            @returns Returns true if the serialize succeeded and every value is in the correct range. False otherwise.
+         */
+
+        bool SerializeSortedIntegerArray( int32_t * values, int count, int32_t min, int32_t max )
+        {
+            serialize_assert( min < max );
+            if ( count < 0 )
+                return false;
+            if ( count == 0 )
+                return true;
+            const uint32_t range = uint32_t(max) - uint32_t(min);
+            const int bits = bits_required( min, max );
+            if ( m_reader.WouldReadPastEnd( bits ) )
+                return false;
+            uint32_t offset = m_reader.ReadBits( bits );
+            if ( offset > range )
+                return false;
+            values[0] = int32_t( offset + uint32_t(min) );
+            if ( count == 1 )
+                return true;
+            if ( m_reader.WouldReadPastEnd( 6 ) )
+                return false;
+            const int gapBits = (int) m_reader.ReadBits( 6 );
+            if ( gapBits > 32 )
+                return false;
+            // offsets from min grow by gap + 1 per value. work in 64 bits so a malicious gap cannot wrap past range
+            if ( gapBits == 0 )
+            {
+                if ( uint64_t( offset ) + uint64_t( count - 1 ) > range )
+                    return false;
+                for ( int i = 1; i < count; ++i )
+                    values[i] = int32_t( offset + uint32_t(i) + uint32_t(min) );
+                return true;
+            }
+            if ( int64_t( count - 1 ) * gapBits > m_reader.GetBitsRemaining() )
+                return false;
+            uint32_t chunk[64];
+            for ( int start = 1; start < count; start += 64 )
+            {
+                const int chunkCount = ( count - start < 64 ) ? ( count - start ) : 64;
+                m_reader.ReadBitsArray( chunk, chunkCount, gapBits, 0, 0xFFFFFFFF );
+                for ( int i = 0; i < chunkCount; ++i )
+                {
+                    const uint64_t next = uint64_t( offset ) + chunk[i] + 1;
+                    if ( next > range )
+                        return false;
+                    offset = uint32_t( next );
+                    values[start+i] = int32_t( offset + uint32_t(min) );
+                }
+            }
+            return true;
+        }
+
         /**
             Serialize an array of bytes (read).
             @param data Array of bytes to read.
@@ -2069,6 +2481,70 @@ namespace serialize
             return true;
         }
 
+        /**
+            Serialize an array of integers (measure).
+            Constant time: every value costs the same number of bits.
+            @param values The integer values. Not actually used or checked.
+            @param count The number of values.
+            @param min The minimum value.
+            @param max The maximum value.
+            @returns Always returns true. All checking is performed by debug asserts only on measure.
+         */
+
+        bool SerializeIntegerArray( const int32_t * values, int count, int32_t min, int32_t max )
+        {
+            (void) values;
+            serialize_assert( count >= 0 );
+            serialize_assert( min < max );
+            m_bitsWritten += int64_t( count ) * bits_required( min, max );
+            return true;
+        }
+
+        /**
+            Serialize an array of compressed floats (measure).
+            Constant time: every value costs the same number of bits.
+            @param values The float values. Not actually used.
+            @param count The number of values.
+            @param min The minimum value.
+            @param max The maximum value.
+            @param res The resolution.
+            @returns Always returns true. All checking is performed by debug asserts only on measure.
+         */
+
+        bool SerializeCompressedFloatArray( const float * values, int count, float min, float max, float res )
+        {
+            (void) values;
+            serialize_assert( count >= 0 );
+            m_bitsWritten += int64_t( count ) * bits_required( 0, compressed_float_max_integer_value( min, max, res ) );
+            return true;
+        }
+
+        /**
+            Serialize a sorted array of integers (measure).
+            IMPORTANT: The gap width depends on the values, so to stay constant time this measures the worst case, where every gap is as wide as the range allows. Like align, the measurement is conservative.
+            @param values The integer values. Not actually used.
+            @param count The number of values.
+            @param min The minimum value.
+            @param max The maximum value.
+            @returns Always returns true. All checking is performed by debug asserts only on measure.
+         */
+
+        bool SerializeSortedIntegerArray( const int32_t * values, int count, int32_t min, int32_t max )
+        {
+            (void) values;
+            serialize_assert( count >= 0 );
+            serialize_assert( min < max );
+            if ( count == 0 )
+                return true;
+            m_bitsWritten += bits_required( min, max );
+            if ( count == 1 )
+                return true;
+            // each gap minus one is at most range - 1, so that bounds the gap width
+            const uint32_t range = uint32_t(max) - uint32_t(min);
+            m_bitsWritten += 6 + int64_t( count - 1 ) * bits_required( 0, range - 1 );
+            return true;
+        }
+
         /**
             Serialize an array of bytes (measure).
             @param data Array of bytes to 'write'. Not actually used.
@@ -2366,19 +2842,7 @@ namespace serialize
 
         const float delta = max - min;
 
-        float values = delta / res;
-
-        // clamp so the uint32_t cast below is defined even for pathological delta / res (the !>= form also catches NaN)
-        if ( !( values >= 1.0f ) )
-        {
-            values = 1.0f;
-        }
-        else if ( values > 4294967040.0f )      // largest float below 2^32
-        {
-            values = 4294967040.0f;
-        }
-
-        const uint32_t maxIntegerValue = (uint32_t) ceil(values);
+        const uint32_t maxIntegerValue = compressed_float_max_integer_value( min, max, res );
 
         const int bits = bits_required( 0, maxIntegerValue );
         
@@ -2386,17 +2850,7 @@ namespace serialize
         
         if ( Stream::IsWriting )
         {
-            // clamp with the !>= / !<= form so a NaN value is forced into range instead of reaching the uint32 cast below
-            float normalizedValue = (value - min) / delta;
-            if ( !( normalizedValue >= 0.0f ) )
-            {
-                normalizedValue = 0.0f;
-            }
-            else if ( !( normalizedValue <= 1.0f ) )
-            {
-                normalizedValue = 1.0f;
-            }
-            integerValue = (uint32_t) floor( normalizedValue * maxIntegerValue + 0.5f );
+            integerValue = compressed_float_quantize( value, min, delta, maxIntegerValue );
         }
 
         if ( !stream.SerializeBits( integerValue, bits ) )
@@ -2410,8 +2864,7 @@ namespace serialize
             {
                 return false;
             }
-            const float normalizedValue = integerValue / float(maxIntegerValue);
-            value = normalizedValue * delta + min;
+            value = compressed_float_dequantize( integerValue, min, delta, maxIntegerValue );
         }
 
         return true;
@@ -2860,6 +3313,71 @@ namespace serialize
             }                                                                               \
         } while (0)
 
+    /**
+        Serialize an array of integers in the same range (read/write/measure).
+        The bits are identical to serialize_int on each value in turn, so this is a drop in replacement for that loop. The bit width is computed once, and the whole run is packed in one pass. Measure is constant time.
+        Serialize macros returns false on error so we don't need to use exceptions for error handling on read. This is an important safety measure because packet data comes from the network and may be malicious.
+        IMPORTANT: This macro must be called inside a templated serialize function with template \<typename Stream\>. The serialize method must have a bool return value.
+        @param stream The stream object. May be a read, write or measure stream.
+        @param values Pointer to the int32_t values, each in [min,max].
+        @param count The number of values. Must be the same on read and write: send it first if it varies.
+        @param min The minimum value.
+        @param max The maximum value.
+     */
+
+    #define serialize_int_array( stream, values, count, min, max )                          \
+        do                                                                                  \
+        {                                                                                   \
+            if ( !stream.SerializeIntegerArray( values, count, min, max ) )                 \
+            {                                                                               \
+                return false;                                                               \
+            }                                                                               \
+        } while (0)
+
+    /**
+        Serialize an array of compressed floats in the same range (read/write/measure).
+        The bits are identical to serialize_compressed_float on each value in turn, so this is a drop in replacement for that loop. The quantization is set up once, and the whole run is packed in one pass. Measure is constant time.
+        Serialize macros returns false on error so we don't need to use exceptions for error handling on read. This is an important safety measure because packet data comes from the network and may be malicious.
+        IMPORTANT: This macro must be called inside a templated serialize function with template \<typename Stream\>. The serialize method must have a bool return value.
+        @param stream The stream object. May be a read, write or measure stream.
+        @param values Pointer to the float values.
+        @param count The number of values. Must be the same on read and write: send it first if it varies.
+        @param min The minimum value.
+        @param max The maximum value.
+        @param res The resolution.
+     */
+
+    #define serialize_compressed_float_array( stream, values, count, min, max, res )        \
+        do                                                                                  \
+        {                                                                                   \
+            if ( !stream.SerializeCompressedFloatArray( values, count, min, max, res ) )    \
+            {                                                                               \
+                return false;                                                               \
+            }                                                                               \
+        } while (0)
+
+    /**
+        Serialize a strictly increasing array of integers, such as a sorted list of entity ids (read/write/measure).
+        The first value is sent in full, then the gaps between values are packed with one shared bit width, sized to the widest gap. Clustered ids cost a few bits each, and a run of consecutive ids costs only the first value plus 6 bits.
+        This is a different encoding from serialize_int_relative, which picks a size class per value. Measure is constant time and conservative: it assumes the widest possible gaps.
+        Serialize macros returns false on error so we don't need to use exceptions for error handling on read. This is an important safety measure because packet data comes from the network and may be malicious.
+        IMPORTANT: This macro must be called inside a templated serialize function with template \<typename Stream\>. The serialize method must have a bool return value.
+        @param stream The stream object. May be a read, write or measure stream.
+        @param values Pointer to the int32_t values, strictly increasing and each in [min,max].
+        @param count The number of values. Must be the same on read and write: send it first if it varies.
+        @param min The minimum value.
+        @param max The maximum value.
+     */
+
+    #define serialize_sorted_int_array( stream, values, count, min, max )                   \
+        do                                                                                  \
+        {                                                                                   \
+            if ( !stream.SerializeSortedIntegerArray( values, count, min, max ) )           \
+            {                                                                               \
+                return false;                                                               \
+            }                                                                               \
+        } while (0)
+
     /**
         Compile time trait marking the integer types usable as fixed point storage.
         Written locally because std::is_integral is not guaranteed to cover __int128 on every compiler, and this header does not include \<type_traits\>.
@@ -4782,6 +5300,311 @@ inline void test_compressed_float_validation()
     }
 }
 
+// Array test helpers. Each array macro is checked against the per value loop it replaces, so the
+// serialize functions below come in pairs over the same ranges.
+
+template <typename Stream> bool serialize_test_int_array( Stream & stream, int32_t * values, int count, int32_t min, int32_t max )
+{
+    serialize_int_array( stream, values, count, min, max );
+    return true;
+}
+
+template <typename Stream> bool serialize_test_int_loop( Stream & stream, int32_t * values, int count, int32_t min, int32_t max )
+{
+    for ( int i = 0; i < count; i++ )
+        serialize_int( stream, values[i], min, max );
+    return true;
+}
+
+template <typename Stream> bool serialize_test_compressed_float_array( Stream & stream, float * values, int count )
+{
+    serialize_compressed_float_array( stream, values, count, -50.0f, 50.0f, 0.01f );
+    return true;
+}
+
+template <typename Stream> bool serialize_test_compressed_float_loop( Stream & stream, float * values, int count )
+{
+    for ( int i = 0; i < count; i++ )
+        serialize_compressed_float( stream, values[i], -50.0f, 50.0f, 0.01f );
+    return true;
+}
+
+template <typename Stream> bool serialize_test_sorted_int_array( Stream & stream, int32_t * values, int count, int32_t min, int32_t max )
+{
+    serialize_sorted_int_array( stream, values, count, min, max );
+    return true;
+}
+
+inline void test_serialize_int_array()
+{
+    // write 3 bits first so the array starts part way through a word, then check the array bits match the serialize_int loop exactly
+
+    const int MaxValues = 300;
+
+    struct Range { int32_t min, max; };
+    const Range ranges[] = { { -100, 1000 }, { 0, 1 }, { INT32_MIN, INT32_MAX }, { 5, 70000 } };
+
+    uint64_t lcg = 12345;
+
+    for ( int r = 0; r < (int) ( sizeof( ranges ) / sizeof( ranges[0] ) ); r++ )
+    {
+        const int32_t min = ranges[r].min;
+        const int32_t max = ranges[r].max;
+        const uint32_t range = uint32_t(max) - uint32_t(min);
+
+        const int counts[] = { 0, 1, 7, 64, 65, MaxValues };
+
+        for ( int c = 0; c < (int) ( sizeof( counts ) / sizeof( counts[0] ) ); c++ )
+        {
+            const int count = counts[c];
+
+            int32_t values[MaxValues];
+            for ( int i = 0; i < count; i++ )
+            {
+                lcg = lcg * 6364136223846793005ULL + 1442695040888963407ULL;
+                const uint32_t offset = ( range == 0xFFFFFFFF ) ? uint32_t( lcg >> 32 ) : uint32_t( ( lcg >> 32 ) % ( uint64_t( range ) + 1 ) );
+                values[i] = int32_t( uint32_t(min) + offset );
+            }
+
+            uint8_t expected[1280 + 8];
+            uint8_t actual[1280 + 8];
+            memset( expected, 0, sizeof( expected ) );
+            memset( actual, 0, sizeof( actual ) );
+
+            serialize::WriteStream referenceStream( expected, 1280 );
+            referenceStream.SerializeBits( 5, 3 );
+            serialize_check( serialize_test_int_loop( referenceStream, values, count, min, max ) == true );
+            referenceStream.Flush();
+
+            serialize::WriteStream writeStream( actual, 1280 );
+            writeStream.SerializeBits( 5, 3 );
+            serialize_check( serialize_test_int_array( writeStream, values, count, min, max ) == true );
+            writeStream.Flush();
+
+            serialize_check( writeStream.GetBitsProcessed() == referenceStream.GetBitsProcessed() );
+            serialize_check( memcmp( actual, expected, sizeof( expected ) ) == 0 );
+
+            serialize::MeasureStream measureStream;
+            measureStream.SerializeBits( 5, 3 );
+            serialize_check( serialize_test_int_array( measureStream, values, count, min, max ) == true );
+            serialize_check( measureStream.GetBitsProcessed() == writeStream.GetBitsProcessed() );
+
+            serialize::ReadStream readStream( actual, writeStream.GetBytesProcessed() );
+            uint32_t header = 0;
+            serialize_check( readStream.SerializeBits( header, 3 ) == true );
+            int32_t read_values[MaxValues];
+            serialize_check( serialize_test_int_array( readStream, read_values, count, min, max ) == true );
+            serialize_check( count == 0 || memcmp( read_values, values, count * sizeof( int32_t ) ) == 0 );
+        }
+    }
+
+    // a malicious packet can encode values above max in the bit headroom. one bad value fails the whole array
+    {
+        uint8_t buffer[8 + 8] = { 0 };          // + 8: read buffer allocations extend 8 bytes past the data
+
+        serialize::WriteStream writeStream( buffer, 8 );
+        for ( int i = 0; i < 4; i++ )
+            writeStream.SerializeBits( i == 2 ? 1023 : 10, 10 );   // [0,1000] -> 10 bits
+        writeStream.Flush();
+
+        serialize::ReadStream readStream( buffer, 8 );
+        int32_t values[4];
+        serialize_check( serialize_test_int_array( readStream, values, 4, 0, 1000 ) == false );
+    }
+
+    // an array that runs past the end of the packet is rejected before anything is read
+    {
+        uint8_t buffer[8 + 8] = { 0 };          // + 8: read buffer allocations extend 8 bytes past the data
+
+        serialize::ReadStream readStream( buffer, 8 );
+        int32_t values[8];
+        serialize_check( serialize_test_int_array( readStream, values, 8, 0, 1000 ) == false );      // 80 bits from a 64 bit packet
+        serialize_check( serialize_test_int_array( readStream, values, -1, 0, 1000 ) == false );
+    }
+}
+
+inline void test_serialize_compressed_float_array()
+{
+    // the array must write the same bits as the serialize_compressed_float loop, including clamped and NaN inputs, and read back the same floats
+
+    const int NumValues = 150;
+
+    float values[NumValues];
+    for ( int i = 0; i < NumValues; i++ )
+        values[i] = -60.0f + i * 0.8123f;                       // runs past both ends of [-50,50]
+
+    uint32_t nan_bits = 0x7fc00000;                             // quiet NaN bit pattern, built without the NAN macro (finite-math builds reject it)
+    memcpy( &values[17], &nan_bits, 4 );
+
+    uint8_t expected[512 + 8];
+    uint8_t actual[512 + 8];
+    memset( expected, 0, sizeof( expected ) );
+    memset( actual, 0, sizeof( actual ) );
+
+    serialize::WriteStream referenceStream( expected, 512 );
+    referenceStream.SerializeBits( 1, 1 );
+    serialize_check( serialize_test_compressed_float_loop( referenceStream, values, NumValues ) == true );
+    referenceStream.Flush();
+
+    serialize::WriteStream writeStream( actual, 512 );
+    writeStream.SerializeBits( 1, 1 );
+    serialize_check( serialize_test_compressed_float_array( writeStream, values, NumValues ) == true );
+    writeStream.Flush();
+
+    serialize_check( writeStream.GetBitsProcessed() == referenceStream.GetBitsProcessed() );
+    serialize_check( memcmp( actual, expected, sizeof( expected ) ) == 0 );
+
+    serialize::MeasureStream measureStream;
+    measureStream.SerializeBits( 1, 1 );
+    serialize_check( serialize_test_compressed_float_array( measureStream, values, NumValues ) == true );
+    serialize_check( measureStream.GetBitsProcessed() == writeStream.GetBitsProcessed() );
+
+    uint32_t header = 0;
+
+    serialize::ReadStream referenceRead( actual, writeStream.GetBytesProcessed() );
+    serialize_check( referenceRead.SerializeBits( header, 1 ) == true );
+    float expected_values[NumValues];
+    serialize_check( serialize_test_compressed_float_loop( referenceRead, expected_values, NumValues ) == true );
+
+    serialize::ReadStream readStream( actual, writeStream.GetBytesProcessed() );
+    serialize_check( readStream.SerializeBits( header, 1 ) == true );
+    float read_values[NumValues];
+    serialize_check( serialize_test_compressed_float_array( readStream, read_values, NumValues ) == true );
+
+    serialize_check( memcmp( read_values, expected_values, sizeof( read_values ) ) == 0 );
+
+    // encodings above maxIntegerValue in the bit headroom must be rejected, as for a single compressed float
+    {
+        uint8_t buffer[16 + 8] = { 0 };         // + 8: read buffer allocations extend 8 bytes past the data
+
+        serialize::WriteStream badStream( buffer, 16 );
+        badStream.SerializeBits( 100, 14 );                     // [-50,50] at 0.01 -> maxIntegerValue 10000, 14 bits
+        badStream.SerializeBits( 16383, 14 );
+        badStream.Flush();
+
+        serialize::ReadStream badRead( buffer, 16 );
+        float bad_values[2];
+        serialize_check( serialize_test_compressed_float_array( badRead, bad_values, 2 ) == false );
+    }
+}
+
+inline void test_serialize_sorted_int_array()
+{
+    const int MaxValues = 200;
+
+    struct Case { int32_t min, max; int count; int32_t first; int32_t step; };
+    const Case cases[] =
+    {
+        { 0, 1000, 0, 0, 0 },
+        { 0, 1000, 1, 1000, 0 },
+        { 0, 1000, 64, 10, 1 },                     // consecutive ids: only the first value and the width
+        { 0, 65535, MaxValues, 3, 0 },              // clustered ids with irregular gaps
+        { -5000, 5000, 101, -5000, 100 },           // last value lands exactly on max
+    };
+
+    uint64_t lcg = 777;
+
+    for ( int c = 0; c < (int) ( sizeof( cases ) / sizeof( cases[0] ) ); c++ )
+    {
+        const Case & test = cases[c];
+
+        int32_t values[MaxValues];
+        int32_t value = test.first;
+        for ( int i = 0; i < test.count; i++ )
+        {
+            values[i] = value;
+            if ( test.step > 0 )
+            {
+                value += test.step;
+            }
+            else
+            {
+                lcg = lcg * 6364136223846793005ULL + 1442695040888963407ULL;
+                value += 1 + int32_t( ( lcg >> 32 ) % 40 );
+            }
+        }
+
+        uint8_t buffer[1024 + 8];
+        memset( buffer, 0, sizeof( buffer ) );
+
+        serialize::WriteStream writeStream( buffer, 1024 );
+        writeStream.SerializeBits( 3, 2 );
+        serialize_check( serialize_test_sorted_int_array( writeStream, values, test.count, test.min, test.max ) == true );
+        writeStream.Flush();
+
+        serialize::MeasureStream measureStream;
+        measureStream.SerializeBits( 3, 2 );
+        serialize_check( serialize_test_sorted_int_array( measureStream, values, test.count, test.min, test.max ) == true );
+        serialize_check( measureStream.GetBitsProcessed() >= writeStream.GetBitsProcessed() );
+
+        if ( test.step == 1 )
+            serialize_check( writeStream.GetBitsProcessed() == 2 + serialize::bits_required( test.min, test.max ) + 6 );
+
+        serialize::ReadStream readStream( buffer, writeStream.GetBytesProcessed() );
+        uint32_t header = 0;
+        serialize_check( readStream.SerializeBits( header, 2 ) == true );
+        int32_t read_values[MaxValues];
+        serialize_check( serialize_test_sorted_int_array( readStream, read_values, test.count, test.min, test.max ) == true );
+        serialize_check( test.count == 0 || memcmp( read_values, values, test.count * sizeof( int32_t ) ) == 0 );
+    }
+
+    // full 32 bit range: gaps near 2^32 must not wrap in the offset arithmetic
+    {
+        int32_t values[3] = { INT32_MIN, 0, INT32_MAX };
+
+        uint8_t buffer[32 + 8] = { 0 };         // + 8: read buffer allocations extend 8 bytes past the data
+
+        serialize::WriteStream writeStream( buffer, 32 );
+        serialize_check( serialize_test_sorted_int_array( writeStream, values, 3, INT32_MIN, INT32_MAX ) == true );
+        writeStream.Flush();
+
+        serialize::ReadStream readStream( buffer, writeStream.GetBytesProcessed() );
+        int32_t read_values[3];
+        serialize_check( serialize_test_sorted_int_array( readStream, read_values, 3, INT32_MIN, INT32_MAX ) == true );
+        serialize_check( memcmp( read_values, values, sizeof( values ) ) == 0 );
+    }
+
+    // malicious encodings: a gap width over 32, gaps that walk past max, and a consecutive run that walks past max
+    {
+        uint8_t buffer[16 + 8] = { 0 };         // + 8: read buffer allocations extend 8 bytes past the data
+
+        serialize::WriteStream writeStream( buffer, 16 );
+        writeStream.SerializeBits( 0, 10 );                     // first value 0 in [0,1000]
+        writeStream.SerializeBits( 33, 6 );                     // gap width 33
+        writeStream.Flush();
+
+        serialize::ReadStream readStream( buffer, 16 );
+        int32_t values[2];
+        serialize_check( serialize_test_sorted_int_array( readStream, values, 2, 0, 1000 ) == false );
+    }
+    {
+        uint8_t buffer[16 + 8] = { 0 };         // + 8: read buffer allocations extend 8 bytes past the data
+
+        serialize::WriteStream writeStream( buffer, 16 );
+        writeStream.SerializeBits( 900, 10 );
+        writeStream.SerializeBits( 8, 6 );                      // gaps in 8 bits
+        writeStream.SerializeBits( 50, 8 );                     // 951
+        writeStream.SerializeBits( 200, 8 );                    // 1152: past max
+        writeStream.Flush();
+
+        serialize::ReadStream readStream( buffer, 16 );
+        int32_t values[3];
+        serialize_check( serialize_test_sorted_int_array( readStream, values, 3, 0, 1000 ) == false );
+    }
+    {
+        uint8_t buffer[16 + 8] = { 0 };         // + 8: read buffer allocations extend 8 bytes past the data
+
+        serialize::WriteStream writeStream( buffer, 16 );
+        writeStream.SerializeBits( 998, 10 );
+        writeStream.SerializeBits( 0, 6 );                      // consecutive run 998, 999, 1000, 1001: past max
+        writeStream.Flush();
+
+        serialize::ReadStream readStream( buffer, 16 );
+        int32_t values[4];
+        serialize_check( serialize_test_sorted_int_array( readStream, values, 4, 0, 1000 ) == false );
+    }
+}
+
 // Fixed point test helpers. Every configuration in the matrix runs the same case list, and every
 // round trip also runs the measure stream and requires exact agreement with the write stream:
 // fixed point serialization involves no alignment, so measure is exact, not just conservative.
@@ -6974,6 +7797,50 @@ inline void test_unaligned_writer()
     }
 }
 
+inline void test_write_bytes_partial_words()
+{
+    // WriteBytes merges its head and tail bytes into the scratch word in one step each. check the
+    // output is identical to writing every byte with WriteBits, for every start offset in a word and
+    // every run length that leaves a head, whole words and a tail in any combination.
+
+    uint8_t data[24];
+    for ( int i = 0; i < (int) sizeof( data ); i++ )
+        data[i] = (uint8_t) ( i * 29 + 7 );
+
+    for ( int offset = 0; offset < 64; offset += 8 )
+    {
+        for ( int bytes = 0; bytes <= (int) sizeof( data ); bytes++ )
+        {
+            uint8_t expected[64];
+            uint8_t actual[64];
+            memset( expected, 0xCD, sizeof( expected ) );
+            memset( actual, 0xCD, sizeof( actual ) );
+
+            serialize::BitWriter reference( expected, sizeof( expected ) );
+            serialize::BitWriter writer( actual, sizeof( actual ) );
+
+            for ( int i = 0; i < offset; i += 8 )
+            {
+                reference.WriteBits( 0xA5, 8 );
+                writer.WriteBits( 0xA5, 8 );
+            }
+
+            for ( int i = 0; i < bytes; i++ )
+                reference.WriteBits( data[i], 8 );
+            writer.WriteBytes( data, bytes );
+
+            reference.WriteBits( 0x5A5A5, 19 );
+            writer.WriteBits( 0x5A5A5, 19 );
+
+            reference.FlushBits();
+            writer.FlushBits();
+
+            serialize_check( writer.GetBitsWritten() == reference.GetBitsWritten() );
+            serialize_check( memcmp( actual, expected, sizeof( expected ) ) == 0 );
+        }
+    }
+}
+
 inline void test_large_buffer()
 {
     // bit counts are 64 bit, so buffers larger than the old 256 MB limit work. write a bulk
@@ -7054,6 +7921,9 @@ inline void serialize_test()
         SERIALIZE_RUN_TEST( test_wstring_validation );
         SERIALIZE_RUN_TEST( test_int_relative_validation );
         SERIALIZE_RUN_TEST( test_compressed_float_validation );
+        SERIALIZE_RUN_TEST( test_serialize_int_array );
+        SERIALIZE_RUN_TEST( test_serialize_compressed_float_array );
+        SERIALIZE_RUN_TEST( test_serialize_sorted_int_array );
         SERIALIZE_RUN_TEST( test_serialize_fixed );
         SERIALIZE_RUN_TEST( test_serialize_fixed_validation );
         SERIALIZE_RUN_TEST( test_serialize_fixed_matches_int64 );
@@ -7079,6 +7949,7 @@ inline void serialize_test()
 #endif // #if defined( SERIALIZE_HAS_COMPILE_TIME_SURFACE )
         SERIALIZE_RUN_TEST( test_golden_wire_format );
         SERIALIZE_RUN_TEST( test_unaligned_writer );
+        SERIALIZE_RUN_TEST( test_write_bytes_partial_words );
         SERIALIZE_RUN_TEST( test_large_buffer );
     }
 }
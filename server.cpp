@@ -64,7 +64,7 @@ public:
     Server * server;
 };
 
-int ServerMain()
+int ServerMain( const char * capturePath )
 {
     printf( "started server on port %d (insecure)\n", ServerPort );
 
@@ -83,6 +83,14 @@ int ServerMain()
 
     server.Start( MaxClients );
 
+    if ( capturePath )
+    {
+        if ( server.StartCapture( capturePath ) )
+            printf( "capturing traffic to %s\n", capturePath );
+        else
+            printf( "error: could not capture traffic to %s\n", capturePath );
+    }
+
     char addressString[256];
     server.GetAddress().ToString( addressString, sizeof( addressString ) );
     printf( "server address is %s\n", addressString );
@@ -109,10 +117,14 @@ int ServerMain()
 
     server.Stop();
 
+    server.StopCapture();
+
     return 0;
 }
 
-int main()
+// `server [capture file]`: with a file, the server's traffic is captured to it for bin/replay.
+
+int main( int argc, char ** argv )
 {
     printf( "\n" );
 
@@ -126,7 +138,7 @@ int main()
 
     srand( (unsigned int) time( NULL ) );
 
-    int result = ServerMain();
+    int result = ServerMain( argc > 1 ? argv[1] : NULL );
 
     ShutdownYojimbo();
 
@@ -65,6 +65,10 @@ bool InitializeYojimbo()
     yojimbo_assert( g_defaultAllocator == NULL );
     g_defaultAllocator = new yojimbo::DefaultAllocator();
 
+#if YOJIMBO_ENABLE_TRACING
+    netcode_set_trace_functions( yojimbo_trace_begin, yojimbo_trace_end );
+#endif // #if YOJIMBO_ENABLE_TRACING
+
     return true;
 }
 
@@ -75,6 +79,10 @@ void EnablePacketTagging()
 
 void ShutdownYojimbo()
 {
+#if YOJIMBO_ENABLE_TRACING
+    netcode_set_trace_functions( NULL, NULL );
+#endif // #if YOJIMBO_ENABLE_TRACING
+
     reliable_term();
 
     netcode_term();
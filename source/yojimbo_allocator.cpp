@@ -28,6 +28,7 @@
 #if YOJIMBO_DEBUG_MEMORY_LEAKS
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #endif // #if YOJIMBO_DEBUG_MEMORY_LEAKS
 
 #include "tlsf/tlsf.h"
@@ -159,6 +160,11 @@ namespace yojimbo
         size_t aligned_memory_size = aligned_memory_finish - aligned_memory_start;
 
         m_tlsf = tlsf_create_with_pool( aligned_memory_start, aligned_memory_size );
+        m_poolStart = aligned_memory_start;
+        m_poolBytes = aligned_memory_size;
+
+        memset( &m_stats, 0, sizeof( m_stats ) );
+        m_stats.heapBytes = aligned_memory_size;
     }
 
     TLSF_Allocator::~TLSF_Allocator()
@@ -177,6 +183,8 @@ namespace yojimbo
         }
 
         TrackAlloc( p, size, file, line );
+
+        CountAllocation( tlsf_block_size( p ) );
         
         return p;
     }
@@ -188,6 +196,407 @@ namespace yojimbo
 
         TrackFree( p, file, line );
 
+        CountFree( tlsf_block_size( p ) );
+
         tlsf_free( m_tlsf, p );
     }
+
+    struct TLSF_WalkStats
+    {
+        size_t freeBytes;
+        size_t largestFreeBlock;
+        int numFreeBlocks;
+    };
+
+    static void TLSF_StatsWalker( void * ptr, size_t size, int used, void * user )
+    {
+        (void) ptr;
+        if ( used )
+            return;
+        TLSF_WalkStats * walk = (TLSF_WalkStats*) user;
+        walk->freeBytes += size;
+        walk->numFreeBlocks++;
+        if ( size > walk->largestFreeBlock )
+            walk->largestFreeBlock = size;
+    }
+
+    bool TLSF_Allocator::GetStats( AllocatorStats & stats ) const
+    {
+        TLSF_WalkStats walk;
+        memset( &walk, 0, sizeof( walk ) );
+        tlsf_walk_pool( tlsf_get_pool( m_tlsf ), TLSF_StatsWalker, &walk );
+
+        stats = m_stats;
+        stats.freeBytes = walk.freeBytes;
+        stats.largestFreeBlock = walk.largestFreeBlock;
+        stats.numFreeBlocks = walk.numFreeBlocks;
+
+        return true;
+    }
+
+    // =============================================
+
+    // slab header, at the start of each slab. padded so the blocks after it keep 16 byte alignment
+    struct TLSF_SlabAllocator::Slab
+    {
+        Slab * next;
+        Slab * prev;
+        void * freeList;
+        uint16_t numBlocks;
+        uint16_t numFree;
+        uint16_t sizeClass;
+    };
+
+    static const int SlabHeaderBytes = 32;
+
+    TLSF_SlabAllocator::TLSF_SlabAllocator( void * memory, size_t bytes ) : TLSF_Allocator( memory, bytes )
+    {
+        yojimbo_assert( sizeof( Slab ) <= size_t( SlabHeaderBytes ) );
+
+        for ( int i = 0; i < NumSizeClasses; ++i )
+        {
+            m_partialSlabs[i] = NULL;
+            m_emptySlab[i] = NULL;
+        }
+        m_numSlabs = 0;
+
+        m_firstPage = uintptr_t( m_poolStart ) & ~uintptr_t( SlabBytes - 1 );
+        m_numPages = ( uintptr_t( m_poolStart + m_poolBytes ) - m_firstPage + SlabBytes - 1 ) / SlabBytes;
+        m_slabPages = (uint8_t*) tlsf_malloc( m_tlsf, m_numPages );
+        if ( m_slabPages )
+        {
+            memset( m_slabPages, 0, m_numPages );
+        }
+    }
+
+    TLSF_SlabAllocator::~TLSF_SlabAllocator()
+    {
+        ReleaseEmptySlabs();
+        if ( m_slabPages )
+        {
+            tlsf_free( m_tlsf, m_slabPages );
+            m_slabPages = NULL;
+        }
+    }
+
+    TLSF_SlabAllocator::Slab * TLSF_SlabAllocator::CreateSlab( int sizeClass )
+    {
+        uint8_t * memory = (uint8_t*) tlsf_memalign( m_tlsf, SlabBytes, SlabBytes );
+        if ( !memory )
+            return NULL;
+
+        const int blockSize = ( sizeClass + 1 ) * 16;
+
+        Slab * slab = (Slab*) memory;
+        slab->next = NULL;
+        slab->prev = NULL;
+        slab->freeList = NULL;
+        slab->numBlocks = uint16_t( ( SlabBytes - SlabHeaderBytes ) / blockSize );
+        slab->numFree = slab->numBlocks;
+        slab->sizeClass = uint16_t( sizeClass );
+
+        // push in reverse so blocks come off the free list in address order
+        uint8_t * blocks = memory + SlabHeaderBytes;
+        for ( int i = slab->numBlocks - 1; i >= 0; --i )
+        {
+            void * block = blocks + i * blockSize;
+            *( (void**) block ) = slab->freeList;
+            slab->freeList = block;
+        }
+
+        m_slabPages[( uintptr_t( memory ) - m_firstPage ) / SlabBytes] = 1;
+        m_numSlabs++;
+
+        return slab;
+    }
+
+    void TLSF_SlabAllocator::DestroySlab( Slab * slab )
+    {
+        yojimbo_assert( slab->numFree == slab->numBlocks );
+        m_slabPages[( uintptr_t( slab ) - m_firstPage ) / SlabBytes] = 0;
+        m_numSlabs--;
+        tlsf_free( m_tlsf, slab );
+    }
+
+    bool TLSF_SlabAllocator::ReleaseEmptySlabs()
+    {
+        bool released = false;
+        for ( int i = 0; i < NumSizeClasses; ++i )
+        {
+            if ( m_emptySlab[i] )
+            {
+                DestroySlab( m_emptySlab[i] );
+                m_emptySlab[i] = NULL;
+                released = true;
+            }
+        }
+        return released;
+    }
+
+    void * TLSF_SlabAllocator::AllocateLarge( size_t size, const char * file, int line )
+    {
+        void * p = tlsf_memalign( m_tlsf, 16, size );
+
+        // the empty slabs kept around may be what stands between TLSF and a free block big enough
+        if ( !p && ReleaseEmptySlabs() )
+            p = tlsf_memalign( m_tlsf, 16, size );
+
+        if ( !p )
+        {
+            SetErrorLevel( ALLOCATOR_ERROR_OUT_OF_MEMORY );
+            return NULL;
+        }
+
+        TrackAlloc( p, size, file, line );
+
+        CountAllocation( tlsf_block_size( p ) );
+
+        return p;
+    }
+
+    void * TLSF_SlabAllocator::Allocate( size_t size, const char * file, int line )
+    {
+        if ( size > size_t( MaxBytes ) || !m_slabPages )
+            return AllocateLarge( size, file, line );
+
+        const int sizeClass = size > 0 ? int( ( size - 1 ) >> 4 ) : 0;
+
+        Slab * slab = m_partialSlabs[sizeClass];
+        if ( !slab )
+        {
+            slab = m_emptySlab[sizeClass];
+            m_emptySlab[sizeClass] = NULL;
+            if ( !slab )
+            {
+                slab = CreateSlab( sizeClass );
+                if ( !slab )
+                    return AllocateLarge( size, file, line );
+            }
+            m_partialSlabs[sizeClass] = slab;
+        }
+
+        void * p = slab->freeList;
+        slab->freeList = *( (void**) p );
+        slab->numFree--;
+
+        // a full slab leaves the partial list until a block comes back to it
+        if ( slab->numFree == 0 )
+        {
+            m_partialSlabs[sizeClass] = slab->next;
+            if ( slab->next )
+                slab->next->prev = NULL;
+            slab->next = NULL;
+        }
+
+        TrackAlloc( p, size, file, line );
+
+        CountAllocation( size_t( sizeClass + 1 ) * 16 );
+
+        return p;
+    }
+
+    void TLSF_SlabAllocator::Free( void * p, const char * file, int line )
+    {
+        if ( !p )
+            return;
+
+        const uintptr_t page = uintptr_t( p ) & ~uintptr_t( SlabBytes - 1 );
+        if ( !m_slabPages || page < m_firstPage || m_slabPages[( page - m_firstPage ) / SlabBytes] == 0 )
+        {
+            TLSF_Allocator::Free( p, file, line );
+            return;
+        }
+
+        TrackFree( p, file, line );
+
+        Slab * slab = (Slab*) page;
+        const int sizeClass = slab->sizeClass;
+
+        CountFree( size_t( sizeClass + 1 ) * 16 );
+
+        *( (void**) p ) = slab->freeList;
+        slab->freeList = p;
+        slab->numFree++;
+
+        if ( slab->numFree == 1 )
+        {
+            // was full: back on the front of the partial list
+            slab->prev = NULL;
+            slab->next = m_partialSlabs[sizeClass];
+            if ( slab->next )
+                slab->next->prev = slab;
+            m_partialSlabs[sizeClass] = slab;
+        }
+
+        if ( slab->numFree == slab->numBlocks )
+        {
+            if ( slab->prev )
+                slab->prev->next = slab->next;
+            else
+                m_partialSlabs[sizeClass] = slab->next;
+            if ( slab->next )
+                slab->next->prev = slab->prev;
+            slab->next = NULL;
+            slab->prev = NULL;
+
+            if ( !m_emptySlab[sizeClass] )
+                m_emptySlab[sizeClass] = slab;
+            else
+                DestroySlab( slab );
+        }
+    }
+
+    // =============================================
+
+    // chunk header, padded so the blocks after it keep 16 byte alignment
+    static const int MessagePoolChunkHeaderBytes = 16;
+
+    MessagePool::MessagePool( Allocator & allocator, int initialSize, int growSize )
+    {
+        yojimbo_assert( initialSize >= 0 );
+        yojimbo_assert( growSize > 0 );
+        m_allocator = &allocator;
+        m_initialSize = initialSize > 0 ? initialSize : growSize;
+        m_growSize = growSize;
+        m_freeList = NULL;
+        m_chunks = NULL;
+        memset( &m_stats, 0, sizeof( m_stats ) );
+    }
+
+    MessagePool::~MessagePool()
+    {
+        yojimbo_assert( m_stats.inUse == 0 );
+        while ( m_chunks )
+        {
+            void * chunk = m_chunks;
+            m_chunks = *( (void**) chunk );
+            YOJIMBO_FREE( *m_allocator, chunk );
+        }
+        m_freeList = NULL;
+        m_allocator = NULL;
+    }
+
+    bool MessagePool::Grow()
+    {
+        const int numBlocks = m_stats.capacity == 0 ? m_initialSize : m_growSize;
+
+        uint8_t * chunk = (uint8_t*) YOJIMBO_ALLOCATE( *m_allocator, MessagePoolChunkHeaderBytes + size_t( numBlocks ) * m_stats.blockSize );
+        if ( !chunk )
+        {
+            SetErrorLevel( ALLOCATOR_ERROR_OUT_OF_MEMORY );
+            return false;
+        }
+
+        *( (void**) chunk ) = m_chunks;
+        m_chunks = chunk;
+
+        // push in reverse so blocks come off the free list in address order
+        uint8_t * blocks = chunk + MessagePoolChunkHeaderBytes;
+        for ( int i = numBlocks - 1; i >= 0; --i )
+        {
+            void * block = blocks + size_t( i ) * m_stats.blockSize;
+            *( (void**) block ) = m_freeList;
+            m_freeList = block;
+        }
+
+        m_stats.capacity += numBlocks;
+
+        return true;
+    }
+
+    void * MessagePool::Allocate( size_t size, const char * file, int line )
+    {
+        yojimbo_assert( size > 0 );
+
+        if ( m_stats.blockSize == 0 )
+            m_stats.blockSize = int( ( size + 15 ) & ~size_t( 15 ) );
+
+        // a message type always creates the same class, so every block is the size of the first
+        yojimbo_assert( size <= size_t( m_stats.blockSize ) );
+        if ( size > size_t( m_stats.blockSize ) )
+        {
+            SetErrorLevel( ALLOCATOR_ERROR_OUT_OF_MEMORY );
+            return NULL;
+        }
+
+        if ( m_freeList )
+        {
+            m_stats.hits++;
+        }
+        else
+        {
+            m_stats.misses++;
+            if ( !Grow() )
+                return NULL;
+        }
+
+        void * p = m_freeList;
+        m_freeList = *( (void**) p );
+
+        m_stats.inUse++;
+        if ( m_stats.inUse > m_stats.highWater )
+            m_stats.highWater = m_stats.inUse;
+
+        TrackAlloc( p, m_stats.blockSize, file, line );
+
+        return p;
+    }
+
+    void MessagePool::Free( void * p, const char * file, int line )
+    {
+        if ( !p )
+            return;
+
+        TrackFree( p, file, line );
+
+        yojimbo_assert( m_stats.inUse > 0 );
+        m_stats.inUse--;
+
+        *( (void**) p ) = m_freeList;
+        m_freeList = p;
+    }
+
+    LockedAllocator::LockedAllocator( Allocator & allocator )
+    {
+        m_allocator = &allocator;
+        m_parent = NULL;
+    }
+
+    LockedAllocator::LockedAllocator( Allocator & parent, Allocator * allocator )
+    {
+        yojimbo_assert( allocator );
+        m_allocator = allocator;
+        m_parent = &parent;
+    }
+
+    LockedAllocator::~LockedAllocator()
+    {
+        if ( m_parent )
+        {
+            YOJIMBO_DELETE( *m_parent, Allocator, m_allocator );
+        }
+        m_allocator = NULL;
+        m_parent = NULL;
+    }
+
+    void * LockedAllocator::Allocate( size_t size, const char * file, int line )
+    {
+        std::lock_guard<std::mutex> lock( m_mutex );
+        void * p = m_allocator->Allocate( size, file, line );
+        if ( !p )
+            SetErrorLevel( m_allocator->GetErrorLevel() );
+        return p;
+    }
+
+    void LockedAllocator::Free( void * p, const char * file, int line )
+    {
+        std::lock_guard<std::mutex> lock( m_mutex );
+        m_allocator->Free( p, file, line );
+    }
+
+    bool LockedAllocator::GetStats( AllocatorStats & stats ) const
+    {
+        std::lock_guard<std::mutex> lock( m_mutex );
+        return m_allocator->GetStats( stats );
+    }
 }
@@ -25,10 +25,12 @@
 #include "yojimbo_base_client.h"
 #include "yojimbo_allocator.h"
 #include "yojimbo_connection.h"
+#include "yojimbo_direct_loopback.h"
 #include "yojimbo_network_simulator.h"
 #include "yojimbo_adapter.h"
 #include "yojimbo_utils.h"
 #include "yojimbo_client.h"             // for the ClientDisconnectReason enum
+#include "yojimbo_trace.h"
 #include "reliable.h"
 
 namespace yojimbo
@@ -49,12 +51,20 @@ namespace yojimbo
         m_clientIndex = -1;
         m_disconnectReason = YOJIMBO_CLIENT_DISCONNECT_REASON_NONE;
         m_packetBuffer = (uint8_t*) YOJIMBO_ALLOCATE( allocator, config.maxPacketSize );
+        m_capture = NULL;
+        m_directLoopback = NULL;
+        m_directLoopbackSlot = NULL;
+        m_directLoopbackDetached = false;
+        RegisterConnectionMetrics( m_metrics, m_connectionMetrics );
     }
 
     BaseClient::~BaseClient()
     {
         // IMPORTANT: Please disconnect the client before destroying it
         yojimbo_assert( m_clientState <= CLIENT_STATE_DISCONNECTED );
+        if ( m_directLoopbackSlot )
+            m_directLoopbackSlot->SetClient( NULL );
+        StopCapture();
         YOJIMBO_FREE( *m_allocator, m_packetBuffer );
         m_allocator = NULL;
     }
@@ -89,6 +99,7 @@ namespace yojimbo
                         case CHANNEL_ERROR_FAILED_TO_SERIALIZE:     return YOJIMBO_CLIENT_DISCONNECT_REASON_FAILED_TO_SERIALIZE;
                         case CHANNEL_ERROR_OUT_OF_MEMORY:           return YOJIMBO_CLIENT_DISCONNECT_REASON_OUT_OF_MEMORY;
                         case CHANNEL_ERROR_MESSAGE_TOO_LARGE:       return YOJIMBO_CLIENT_DISCONNECT_REASON_MESSAGE_TOO_LARGE;
+                        case CHANNEL_ERROR_STREAM_FAILED:           return YOJIMBO_CLIENT_DISCONNECT_REASON_STREAM_FAILED;
                         case CHANNEL_ERROR_NONE:                    break;
                     }
                 }
@@ -106,7 +117,10 @@ namespace yojimbo
 
     void BaseClient::AdvanceTime( double time )
     {
+        YOJIMBO_TRACE_SCOPE( "BaseClient::AdvanceTime" );
         m_time = time;
+        if ( m_capture )
+            m_capture->WriteEvent( CAPTURE_RECORD_ADVANCE_TIME, 0, time );
         if ( m_endpoint )
         {
             m_connection->AdvanceTime( time );
@@ -182,13 +196,24 @@ namespace yojimbo
 
         m_config.Validate();
 
+        // messages from a previous direct loopback connection should be released by now
+        if ( m_directLoopbackSlot )
+        {
+            m_directLoopbackSlot->SetClient( NULL );
+            m_directLoopbackSlot = NULL;
+        }
+        m_directLoopbackDetached = false;
+
         m_clientMemory = (uint8_t*) YOJIMBO_ALLOCATE( *m_allocator, m_config.clientMemory );
         m_clientAllocator = m_adapter->CreateAllocator( *m_allocator, m_clientMemory, m_config.clientMemory );
         m_messageFactory = m_adapter->CreateMessageFactory( *m_clientAllocator );
+        m_messageFactory->EnableMessagePools( m_config.messagePoolInitialSize, m_config.messagePoolGrowSize );
         m_connection = YOJIMBO_NEW( *m_clientAllocator, Connection, *m_clientAllocator, *m_messageFactory, m_config, m_time );
 
         yojimbo_assert( m_connection );
 
+        m_connection->SetMetrics( &m_metrics, m_connectionMetrics.channelBitsPerPacket, m_connectionMetrics.messagesPerPacket );
+
         if ( m_config.networkSimulator )
         {
             m_networkSimulator = YOJIMBO_NEW( *m_clientAllocator, NetworkSimulator, *m_clientAllocator, m_config.maxSimulatorPackets, m_time );
@@ -204,6 +229,9 @@ namespace yojimbo
         reliable_config.fragment_size = m_config.packetFragmentSize; 
         reliable_config.ack_buffer_size = m_config.ackedPacketsBufferSize;
         reliable_config.received_packets_buffer_size = m_config.receivedPacketsBufferSize;
+#ifndef YOJIMBO_SYSTEM_DEPS
+        reliable_config.ack_bits = m_config.ackBits;
+#endif // #ifndef YOJIMBO_SYSTEM_DEPS
         reliable_config.fragment_reassembly_buffer_size = m_config.packetReassemblyBufferSize;
         reliable_config.rtt_smoothing_factor = m_config.rttSmoothingFactor;
         reliable_config.transmit_packet_function = BaseClient::StaticTransmitPacketFunction;
@@ -215,11 +243,17 @@ namespace yojimbo
         m_endpoint = reliable_endpoint_create( &reliable_config, m_time );
 
         reliable_endpoint_reset( m_endpoint );
+
+        if ( m_capture )
+            m_capture->WriteEvent( CAPTURE_RECORD_CLIENT_CONNECTED, 0, m_time );
     }
 
     void BaseClient::DestroyInternal()
     {
         yojimbo_assert( m_allocator );
+        if ( m_capture && m_connection )
+            m_capture->WriteEvent( CAPTURE_RECORD_CLIENT_DISCONNECTED, 0, m_time );
+        m_directLoopback = NULL;
         if ( m_endpoint )
         {
             reliable_endpoint_destroy( m_endpoint ); 
@@ -232,6 +266,21 @@ namespace yojimbo
         YOJIMBO_FREE( *m_allocator, m_clientMemory );
     }
 
+    void BaseClient::SetDirectLoopback( DirectLoopback * directLoopback )
+    {
+        yojimbo_assert( m_connection );
+        yojimbo_assert( directLoopback );
+        m_directLoopback = directLoopback;
+        m_directLoopbackSlot = directLoopback;
+    }
+
+    void BaseClient::DetachDirectLoopback()
+    {
+        yojimbo_assert( !m_directLoopback );
+        m_directLoopbackSlot = NULL;
+        m_directLoopbackDetached = true;
+    }
+
     void BaseClient::StaticTransmitPacketFunction( void * context, uint64_t index, uint16_t packetSequence, uint8_t * packetData, int packetBytes )
     {
         (void) index;
@@ -264,11 +313,15 @@ namespace yojimbo
     Message * BaseClient::CreateMessage( int type )
     {
         yojimbo_assert( m_messageFactory );
+        if ( m_directLoopback )
+            return m_directLoopback->GetMessageFactory().CreateMessage( type );
         return m_messageFactory->CreateMessage( type );
     }
 
     uint8_t * BaseClient::AllocateBlock( int bytes )
     {
+        if ( m_directLoopback )
+            return (uint8_t*) YOJIMBO_ALLOCATE( m_directLoopback->GetAllocator(), bytes );
         return (uint8_t*) YOJIMBO_ALLOCATE( *m_clientAllocator, bytes );
     }
 
@@ -279,11 +332,16 @@ namespace yojimbo
         yojimbo_assert( bytes > 0 );
         yojimbo_assert( message->IsBlockMessage() );
         BlockMessage * blockMessage = (BlockMessage*) message;
-        blockMessage->AttachBlock( *m_clientAllocator, block, bytes );
+        blockMessage->AttachBlock( m_directLoopback ? m_directLoopback->GetAllocator() : *m_clientAllocator, block, bytes );
     }
 
     void BaseClient::FreeBlock( uint8_t * block )
     {
+        if ( m_directLoopback )
+        {
+            YOJIMBO_FREE( m_directLoopback->GetAllocator(), block );
+            return;
+        }
         YOJIMBO_FREE( *m_clientAllocator, block );
     }
 
@@ -292,6 +350,8 @@ namespace yojimbo
         yojimbo_assert( m_connection );
         yojimbo_assert( channelIndex >= 0 );
         yojimbo_assert( channelIndex < m_config.numChannels );
+        if ( m_directLoopback )
+            return m_directLoopback->CanSendMessage( DIRECT_LOOPBACK_CLIENT_TO_SERVER, channelIndex );
         return m_connection->CanSendMessage( channelIndex );
     }
 
@@ -300,6 +360,8 @@ namespace yojimbo
         yojimbo_assert( m_connection );
         yojimbo_assert( channelIndex >= 0 );
         yojimbo_assert( channelIndex < m_config.numChannels );
+        if ( m_directLoopback )
+            return m_directLoopback->HasMessagesToSend( DIRECT_LOOPBACK_CLIENT_TO_SERVER, channelIndex );
         return m_connection->HasMessagesToSend( channelIndex );
     }
 
@@ -308,6 +370,11 @@ namespace yojimbo
         yojimbo_assert( m_connection );
         yojimbo_assert( channelIndex >= 0 );
         yojimbo_assert( channelIndex < m_config.numChannels );
+        if ( m_directLoopback )
+        {
+            m_directLoopback->SendMessage( DIRECT_LOOPBACK_CLIENT_TO_SERVER, channelIndex, message );
+            return;
+        }
         m_connection->SendMessage( channelIndex, message, GetContext() );
     }
 
@@ -316,15 +383,35 @@ namespace yojimbo
         yojimbo_assert( m_connection );
         yojimbo_assert( channelIndex >= 0 );
         yojimbo_assert( channelIndex < m_config.numChannels );
+        if ( m_directLoopback )
+            return m_directLoopback->ReceiveMessage( DIRECT_LOOPBACK_SERVER_TO_CLIENT, channelIndex );
         return m_connection->ReceiveMessage( channelIndex );
     }
 
     void BaseClient::ReleaseMessage( Message * message )
     {
+        if ( m_directLoopbackSlot )
+        {
+            m_directLoopbackSlot->GetMessageFactory().ReleaseMessage( message );
+            return;
+        }
+        if ( m_directLoopbackDetached )
+        {
+            // freed with the server slot
+            return;
+        }
         yojimbo_assert( m_connection );
         m_connection->ReleaseMessage( message );
     }
 
+    void BaseClient::SetBlockStreamWriteFunction( int channelIndex, BlockStreamWriteFunction function, void * context )
+    {
+        yojimbo_assert( m_connection );
+        yojimbo_assert( channelIndex >= 0 );
+        yojimbo_assert( channelIndex < m_config.numChannels );
+        m_connection->SetBlockStreamWriteFunction( channelIndex, function, context );
+    }
+
     void BaseClient::GetNetworkInfo( NetworkInfo & info ) const
     {
         memset( &info, 0, sizeof( info ) );
@@ -347,6 +434,25 @@ namespace yojimbo
         }
     }
 
+    bool BaseClient::StartCapture( const char * path )
+    {
+        StopCapture();
+        m_capture = YOJIMBO_NEW( *m_allocator, PacketCapture, *m_allocator );
+        if ( !m_capture )
+            return false;
+        if ( !m_capture->Open( path, m_config, false ) )
+        {
+            StopCapture();
+            return false;
+        }
+        return true;
+    }
+
+    void BaseClient::StopCapture()
+    {
+        YOJIMBO_DELETE( *m_allocator, PacketCapture, m_capture );
+    }
+
     void BaseClient::Reset()
     {
         if ( m_connection )
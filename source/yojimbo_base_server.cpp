@@ -2,8 +2,11 @@
 #include "yojimbo_adapter.h"
 #include "yojimbo_network_simulator.h"
 #include "yojimbo_connection.h"
+#include "yojimbo_direct_loopback.h"
+#include "yojimbo_base_client.h"
 #include "yojimbo_network_info.h"
 #include "yojimbo_utils.h"
+#include "yojimbo_trace.h"
 #include "yojimbo_server.h"             // for the ServerClientDisconnectReason enum
 #include "reliable.h"
 
@@ -26,16 +29,24 @@ namespace yojimbo
             m_clientMessageFactory[i] = NULL;
             m_clientConnection[i] = NULL;
             m_clientEndpoint[i] = NULL;
+            m_clientDirectLoopback[i] = NULL;
             m_clientDisconnectReason[i] = YOJIMBO_SERVER_CLIENT_DISCONNECT_REASON_NONE;
         }
+        m_clientMemoryReserve = NULL;
+        m_clientMemoryBase = NULL;
+        m_clientMemoryStride = 0;
+        m_mappedHeaps = false;
         m_networkSimulator = NULL;
         m_packetBuffer = NULL;
+        m_capture = NULL;
+        RegisterConnectionMetrics( m_metrics, m_connectionMetrics );
     }
 
     BaseServer::~BaseServer()
     {
         // IMPORTANT: Please stop the server before destroying it!
         yojimbo_assert( !IsRunning () );
+        StopCapture();
         m_allocator = NULL;
     }
 
@@ -63,7 +74,14 @@ namespace yojimbo
 
         yojimbo_assert( !m_globalMemory );
         yojimbo_assert( !m_globalAllocator );
-        m_globalMemory = (uint8_t*) YOJIMBO_ALLOCATE( *m_allocator, m_config.serverGlobalMemory );
+        m_mappedHeaps = m_config.serverHugePages || m_config.serverNumaNode >= 0;
+        m_globalMemory = AllocateHeap( m_config.serverGlobalMemory );
+        if ( !m_globalMemory && m_mappedHeaps )
+        {
+            yojimbo_printf( YOJIMBO_LOG_LEVEL_ERROR, "error: failed to map server heaps from the OS. allocating them instead\n" );
+            m_mappedHeaps = false;
+            m_globalMemory = AllocateHeap( m_config.serverGlobalMemory );
+        }
 
         m_globalAllocator = m_adapter->CreateAllocator( *m_allocator, m_globalMemory, m_config.serverGlobalMemory );
         yojimbo_assert( m_globalAllocator );
@@ -73,44 +91,35 @@ namespace yojimbo
             m_networkSimulator = YOJIMBO_NEW( *m_globalAllocator, NetworkSimulator, *m_globalAllocator, m_config.maxSimulatorPackets, m_time );
         }
 
-        for ( int i = 0; i < m_maxClients; ++i )
+        if ( m_config.serverLazyClientMemory )
+        {
+            // reserve address space for every slot now. memory is committed as clients connect
+
+            // with huge pages each slot is a whole number of huge pages, and the slots start on a huge page boundary
+
+            const size_t pageSize = GetHeapPageSize();
+            m_clientMemoryStride = ( size_t( m_config.serverPerClientMemory ) + pageSize - 1 ) & ~( pageSize - 1 );
+            m_clientMemoryReserve = (uint8_t*) yojimbo_memory_reserve( GetClientMemoryReserveBytes() );
+            if ( m_clientMemoryReserve )
+            {
+                m_clientMemoryBase = (uint8_t*) ( ( uintptr_t( m_clientMemoryReserve ) + pageSize - 1 ) & ~uintptr_t( pageSize - 1 ) );
+            }
+            else
+            {
+                yojimbo_printf( YOJIMBO_LOG_LEVEL_ERROR, "error: failed to reserve client memory. allocating it up front instead\n" );
+            }
+        }
+
+        if ( !m_clientMemoryReserve )
         {
-            yojimbo_assert( !m_clientMemory[i] );
-            yojimbo_assert( !m_clientAllocator[i] );
-            
-            m_clientMemory[i] = (uint8_t*) YOJIMBO_ALLOCATE( *m_allocator, m_config.serverPerClientMemory );
-            yojimbo_assert( m_clientMemory[i] );            
-
-            m_clientAllocator[i] = m_adapter->CreateAllocator( *m_allocator, m_clientMemory[i], m_config.serverPerClientMemory );
-            yojimbo_assert( m_clientAllocator[i] );
-            
-            m_clientMessageFactory[i] = m_adapter->CreateMessageFactory( *m_clientAllocator[i] );
-            yojimbo_assert( m_clientMessageFactory[i] );
-            
-            m_clientConnection[i] = YOJIMBO_NEW( *m_clientAllocator[i], Connection, *m_clientAllocator[i], *m_clientMessageFactory[i], m_config, m_time );
-            yojimbo_assert( m_clientConnection[i] );
-
-            reliable_config_t reliable_config;
-            reliable_default_config( &reliable_config );
-            yojimbo_copy_string( reliable_config.name, "server endpoint", sizeof( reliable_config.name ) );
-            reliable_config.context = (void*) this;
-            reliable_config.id = i;
-            reliable_config.max_packet_size = m_config.maxPacketSize;
-            reliable_config.fragment_above = m_config.fragmentPacketsAbove;
-            reliable_config.max_fragments = m_config.maxPacketFragments;
-            reliable_config.fragment_size = m_config.packetFragmentSize; 
-            reliable_config.ack_buffer_size = m_config.ackedPacketsBufferSize;
-            reliable_config.received_packets_buffer_size = m_config.receivedPacketsBufferSize;
-            reliable_config.fragment_reassembly_buffer_size = m_config.packetReassemblyBufferSize;
-            reliable_config.rtt_smoothing_factor = m_config.rttSmoothingFactor;
-            reliable_config.transmit_packet_function = BaseServer::StaticTransmitPacketFunction;
-            reliable_config.process_packet_function = BaseServer::StaticProcessPacketFunction;
-            reliable_config.allocator_context = &GetGlobalAllocator();
-            reliable_config.allocate_function = BaseServer::StaticAllocateFunction;
-            reliable_config.free_function = BaseServer::StaticFreeFunction;
-            m_clientEndpoint[i] = reliable_endpoint_create( &reliable_config, m_time );
-            reliable_endpoint_reset( m_clientEndpoint[i] );
+            for ( int i = 0; i < m_maxClients; ++i )
+            {
+                const bool committed = CommitClient( i );
+                yojimbo_assert( committed );
+                (void) committed;
+            }
         }
+
         m_packetBuffer = (uint8_t*) YOJIMBO_ALLOCATE( *m_globalAllocator, m_config.maxPacketSize );
     }
 
@@ -126,18 +135,18 @@ namespace yojimbo
             yojimbo_assert( m_maxClients <= MaxClients );
             for ( int i = 0; i < m_maxClients; ++i )
             {
-                yojimbo_assert( m_clientMemory[i] );
-                yojimbo_assert( m_clientAllocator[i] );
-                yojimbo_assert( m_clientMessageFactory[i] );
-                yojimbo_assert( m_clientEndpoint[i] );
-                reliable_endpoint_destroy( m_clientEndpoint[i] ); m_clientEndpoint[i] = NULL;
-                YOJIMBO_DELETE( *m_clientAllocator[i], Connection, m_clientConnection[i] );
-                YOJIMBO_DELETE( *m_clientAllocator[i], MessageFactory, m_clientMessageFactory[i] );
-                YOJIMBO_DELETE( *m_allocator, Allocator, m_clientAllocator[i] );
-                YOJIMBO_FREE( *m_allocator, m_clientMemory[i] );
+                DecommitClient( i );
+            }
+            if ( m_clientMemoryReserve )
+            {
+                yojimbo_memory_release( m_clientMemoryReserve, GetClientMemoryReserveBytes() );
+                m_clientMemoryReserve = NULL;
+                m_clientMemoryBase = NULL;
+                m_clientMemoryStride = 0;
             }
             YOJIMBO_DELETE( *m_allocator, Allocator, m_globalAllocator );
-            YOJIMBO_FREE( *m_allocator, m_globalMemory );
+            FreeHeap( m_globalMemory, m_config.serverGlobalMemory );
+            m_globalMemory = NULL;
         }
         for ( int i = 0; i < MaxClients; ++i )
         {
@@ -146,12 +155,314 @@ namespace yojimbo
             m_clientMessageFactory[i] = NULL;
             m_clientConnection[i] = NULL;
             m_clientEndpoint[i] = NULL;
+            m_clientDirectLoopback[i] = NULL;
         }
         m_running = false;
         m_maxClients = 0;
         m_packetBuffer = NULL;
     }
 
+    bool BaseServer::CommitClient( int clientIndex )
+    {
+        yojimbo_assert( clientIndex >= 0 );
+        yojimbo_assert( clientIndex < m_maxClients );
+
+        if ( IsClientCommitted( clientIndex ) )
+            return true;
+
+        if ( m_clientMemoryReserve )
+        {
+            uint8_t * memory = m_clientMemoryBase + m_clientMemoryStride * clientIndex;
+            if ( !yojimbo_memory_commit( memory, m_clientMemoryStride ) )
+            {
+                yojimbo_printf( YOJIMBO_LOG_LEVEL_ERROR, "error: failed to commit memory for client %d\n", clientIndex );
+                return false;
+            }
+            if ( m_mappedHeaps )
+            {
+                yojimbo_memory_set_policy( memory, m_clientMemoryStride, m_config.serverHugePages, m_config.serverNumaNode );
+            }
+            m_clientMemory[clientIndex] = memory;
+        }
+        else
+        {
+            m_clientMemory[clientIndex] = AllocateHeap( m_config.serverPerClientMemory );
+            if ( !m_clientMemory[clientIndex] )
+                return false;
+        }
+
+        m_clientAllocator[clientIndex] = m_adapter->CreateAllocator( *m_allocator, m_clientMemory[clientIndex], m_config.serverPerClientMemory );
+        if ( m_clientAllocator[clientIndex] )
+        {
+            m_clientMessageFactory[clientIndex] = m_adapter->CreateMessageFactory( *m_clientAllocator[clientIndex] );
+        }
+        if ( m_clientMessageFactory[clientIndex] )
+        {
+            m_clientMessageFactory[clientIndex]->EnableMessagePools( m_config.messagePoolInitialSize, m_config.messagePoolGrowSize );
+            m_clientConnection[clientIndex] = YOJIMBO_NEW( *m_clientAllocator[clientIndex], Connection, *m_clientAllocator[clientIndex], *m_clientMessageFactory[clientIndex], m_config, m_time );
+        }
+        if ( m_clientConnection[clientIndex] )
+        {
+            m_clientConnection[clientIndex]->SetMetrics( &m_metrics, m_connectionMetrics.channelBitsPerPacket, m_connectionMetrics.messagesPerPacket );
+        }
+        if ( !m_clientConnection[clientIndex] )
+        {
+            yojimbo_printf( YOJIMBO_LOG_LEVEL_ERROR, "error: failed to create client %d\n", clientIndex );
+            DecommitClient( clientIndex );
+            return false;
+        }
+
+        reliable_config_t reliable_config;
+        reliable_default_config( &reliable_config );
+        yojimbo_copy_string( reliable_config.name, "server endpoint", sizeof( reliable_config.name ) );
+        reliable_config.context = (void*) this;
+        reliable_config.id = clientIndex;
+        reliable_config.max_packet_size = m_config.maxPacketSize;
+        reliable_config.fragment_above = m_config.fragmentPacketsAbove;
+        reliable_config.max_fragments = m_config.maxPacketFragments;
+        reliable_config.fragment_size = m_config.packetFragmentSize; 
+        reliable_config.ack_buffer_size = m_config.ackedPacketsBufferSize;
+        reliable_config.received_packets_buffer_size = m_config.receivedPacketsBufferSize;
+#ifndef YOJIMBO_SYSTEM_DEPS
+        reliable_config.ack_bits = m_config.ackBits;
+#endif // #ifndef YOJIMBO_SYSTEM_DEPS
+        reliable_config.fragment_reassembly_buffer_size = m_config.packetReassemblyBufferSize;
+        reliable_config.rtt_smoothing_factor = m_config.rttSmoothingFactor;
+        reliable_config.transmit_packet_function = BaseServer::StaticTransmitPacketFunction;
+        reliable_config.process_packet_function = BaseServer::StaticProcessPacketFunction;
+        reliable_config.allocator_context = &GetGlobalAllocator();
+        reliable_config.allocate_function = BaseServer::StaticAllocateFunction;
+        reliable_config.free_function = BaseServer::StaticFreeFunction;
+        m_clientEndpoint[clientIndex] = reliable_endpoint_create( &reliable_config, m_time );
+        if ( !m_clientEndpoint[clientIndex] )
+        {
+            yojimbo_printf( YOJIMBO_LOG_LEVEL_ERROR, "error: failed to create endpoint for client %d\n", clientIndex );
+            DecommitClient( clientIndex );
+            return false;
+        }
+        reliable_endpoint_reset( m_clientEndpoint[clientIndex] );
+
+        return true;
+    }
+
+    void BaseServer::DecommitClient( int clientIndex )
+    {
+        yojimbo_assert( clientIndex >= 0 );
+        yojimbo_assert( clientIndex < m_maxClients );
+
+        DestroyDirectLoopback( clientIndex );
+
+        if ( m_clientEndpoint[clientIndex] )
+        {
+            reliable_endpoint_destroy( m_clientEndpoint[clientIndex] );
+            m_clientEndpoint[clientIndex] = NULL;
+        }
+
+        if ( m_clientAllocator[clientIndex] )
+        {
+            YOJIMBO_DELETE( *m_clientAllocator[clientIndex], Connection, m_clientConnection[clientIndex] );
+            YOJIMBO_DELETE( *m_clientAllocator[clientIndex], MessageFactory, m_clientMessageFactory[clientIndex] );
+            YOJIMBO_DELETE( *m_allocator, Allocator, m_clientAllocator[clientIndex] );
+        }
+
+        if ( m_clientMemoryReserve )
+        {
+            if ( m_clientMemory[clientIndex] )
+            {
+                yojimbo_memory_decommit( m_clientMemory[clientIndex], m_clientMemoryStride );
+                m_clientMemory[clientIndex] = NULL;
+            }
+        }
+        else
+        {
+            FreeHeap( m_clientMemory[clientIndex], m_config.serverPerClientMemory );
+            m_clientMemory[clientIndex] = NULL;
+        }
+    }
+
+    DirectLoopback * BaseServer::CreateDirectLoopback( int clientIndex, BaseClient & client )
+    {
+        yojimbo_assert( IsRunning() );
+        yojimbo_assert( clientIndex >= 0 );
+        yojimbo_assert( clientIndex < m_maxClients );
+        yojimbo_assert( IsClientConnected( clientIndex ) );
+        if ( !IsClientCommitted( clientIndex ) )
+            return NULL;
+        DestroyDirectLoopback( clientIndex );
+        DirectLoopback * directLoopback = YOJIMBO_NEW( *m_clientAllocator[clientIndex], DirectLoopback, *m_clientAllocator[clientIndex], *m_clientMessageFactory[clientIndex], m_config );
+        if ( !directLoopback )
+            return NULL;
+        if ( !directLoopback->IsValid() )
+        {
+            yojimbo_printf( YOJIMBO_LOG_LEVEL_ERROR, "error: failed to create direct loopback for client %d\n", clientIndex );
+            YOJIMBO_DELETE( *m_clientAllocator[clientIndex], DirectLoopback, directLoopback );
+            return NULL;
+        }
+        // anything left from the packet path belongs to nobody now
+        m_clientConnection[clientIndex]->Reset();
+        directLoopback->SetClient( &client );
+        m_clientDirectLoopback[clientIndex] = directLoopback;
+        return directLoopback;
+    }
+
+    bool BaseServer::IsDirectLoopbackClient( int clientIndex ) const
+    {
+        yojimbo_assert( clientIndex >= 0 );
+        yojimbo_assert( clientIndex < m_maxClients );
+        return m_clientDirectLoopback[clientIndex] != NULL && m_clientDirectLoopback[clientIndex]->IsConnected();
+    }
+
+    void BaseServer::DisconnectDirectLoopback( int clientIndex )
+    {
+        if ( !IsDirectLoopbackClient( clientIndex ) )
+            return;
+        DirectLoopback * directLoopback = m_clientDirectLoopback[clientIndex];
+        directLoopback->Disconnect();
+        // the client stays attached to the link, so messages it still holds are released back to this slot
+        BaseClient * client = directLoopback->GetClient();
+        if ( client && client->IsDirectLoopback() )
+        {
+            client->DisconnectLoopback();
+        }
+    }
+
+    void BaseServer::DestroyDirectLoopback( int clientIndex )
+    {
+        DirectLoopback * directLoopback = m_clientDirectLoopback[clientIndex];
+        if ( !directLoopback )
+            return;
+        DisconnectDirectLoopback( clientIndex );
+        m_clientDirectLoopback[clientIndex] = NULL;
+        BaseClient * client = directLoopback->GetClient();
+        if ( client )
+        {
+            directLoopback->SetClient( NULL );
+            client->DetachDirectLoopback();
+        }
+        YOJIMBO_DELETE( *m_clientAllocator[clientIndex], DirectLoopback, directLoopback );
+    }
+
+    size_t BaseServer::GetHeapPageSize() const
+    {
+        const size_t hugePageSize = m_config.serverHugePages ? yojimbo_memory_huge_page_size() : 0;
+        return hugePageSize != 0 ? hugePageSize : yojimbo_memory_page_size();
+    }
+
+    size_t BaseServer::GetHeapBytes( size_t bytes ) const
+    {
+        if ( !m_mappedHeaps )
+            return bytes;
+        const size_t pageSize = GetHeapPageSize();
+        return ( bytes + pageSize - 1 ) & ~( pageSize - 1 );
+    }
+
+    size_t BaseServer::GetClientMemoryReserveBytes() const
+    {
+        // one page extra, to line the slots up on a page boundary
+        const size_t pageSize = GetHeapPageSize();
+        return m_clientMemoryStride * m_maxClients + ( pageSize > yojimbo_memory_page_size() ? pageSize : 0 );
+    }
+
+    uint8_t * BaseServer::AllocateHeap( size_t bytes )
+    {
+        if ( m_mappedHeaps )
+            return (uint8_t*) yojimbo_memory_map( GetHeapBytes( bytes ), m_config.serverHugePages, m_config.serverNumaNode );
+        return (uint8_t*) YOJIMBO_ALLOCATE( *m_allocator, bytes );
+    }
+
+    void BaseServer::FreeHeap( uint8_t * memory, size_t bytes )
+    {
+        if ( !memory )
+            return;
+        if ( m_mappedHeaps )
+        {
+            yojimbo_memory_release( memory, GetHeapBytes( bytes ) );
+        }
+        else
+        {
+            YOJIMBO_FREE( *m_allocator, memory );
+        }
+    }
+
+    void BaseServer::DecommitIdleClients()
+    {
+        // idle slots past the warm budget give their memory back once the game has released every message from the last client
+
+        int numWarmClients = 0;
+        for ( int i = 0; i < m_maxClients; ++i )
+        {
+            if ( !IsClientCommitted( i ) || IsClientConnected( i ) )
+                continue;
+            if ( numWarmClients < m_config.serverWarmClientSlots )
+            {
+                numWarmClients++;
+                continue;
+            }
+            if ( m_clientMessageFactory[i]->GetNumAllocatedMessages() == 0 )
+            {
+                DecommitClient( i );
+            }
+        }
+    }
+
+    void BaseServer::GetClientMemoryInfo( int clientIndex, ClientMemoryInfo & info ) const
+    {
+        yojimbo_assert( IsRunning() );
+        yojimbo_assert( clientIndex >= 0 );
+        yojimbo_assert( clientIndex < m_maxClients );
+        memset( &info, 0, sizeof( info ) );
+        info.committed = IsClientCommitted( clientIndex );
+        info.reservedBytes = m_clientMemoryReserve ? m_clientMemoryStride : GetHeapBytes( m_config.serverPerClientMemory );
+        if ( m_clientMemory[clientIndex] )
+        {
+            info.residentBytes = yojimbo_memory_resident( m_clientMemory[clientIndex], m_config.serverPerClientMemory );
+        }
+        if ( m_clientAllocator[clientIndex] )
+        {
+            info.hasHeapStats = m_clientAllocator[clientIndex]->GetStats( info.heap );
+        }
+        MessageFactory * messageFactory = m_clientMessageFactory[clientIndex];
+        if ( messageFactory )
+        {
+            info.numMessages = messageFactory->GetNumAllocatedMessages();
+            info.numMessageTypes = yojimbo_min( messageFactory->GetNumTypes(), MaxMemoryInfoMessageTypes );
+            for ( int i = 0; i < info.numMessageTypes; ++i )
+            {
+                info.numMessagesByType[i] = messageFactory->GetNumAllocatedMessages( i );
+            }
+        }
+    }
+
+    int BaseServer::GetNumCommittedClients() const
+    {
+        int numCommittedClients = 0;
+        for ( int i = 0; i < m_maxClients; ++i )
+        {
+            if ( IsClientCommitted( i ) )
+                numCommittedClients++;
+        }
+        return numCommittedClients;
+    }
+
+    bool BaseServer::StartCapture( const char * path )
+    {
+        StopCapture();
+        m_capture = YOJIMBO_NEW( *m_allocator, PacketCapture, *m_allocator );
+        if ( !m_capture )
+            return false;
+        if ( !m_capture->Open( path, m_config, true ) )
+        {
+            StopCapture();
+            return false;
+        }
+        return true;
+    }
+
+    void BaseServer::StopCapture()
+    {
+        YOJIMBO_DELETE( *m_allocator, PacketCapture, m_capture );
+    }
+
     // Map the error that drove a connection into an error state to the disconnect reason we
     // record for the client slot. For channel errors, drill into the channels to find the one
     // in error, because that is where the actionable detail lives (eg. serialize failure vs
@@ -176,6 +487,7 @@ namespace yojimbo
                         case CHANNEL_ERROR_FAILED_TO_SERIALIZE:     return YOJIMBO_SERVER_CLIENT_DISCONNECT_REASON_FAILED_TO_SERIALIZE;
                         case CHANNEL_ERROR_OUT_OF_MEMORY:           return YOJIMBO_SERVER_CLIENT_DISCONNECT_REASON_OUT_OF_MEMORY;
                         case CHANNEL_ERROR_MESSAGE_TOO_LARGE:       return YOJIMBO_SERVER_CLIENT_DISCONNECT_REASON_MESSAGE_TOO_LARGE;
+                        case CHANNEL_ERROR_STREAM_FAILED:           return YOJIMBO_SERVER_CLIENT_DISCONNECT_REASON_STREAM_FAILED;
                         case CHANNEL_ERROR_NONE:                    break;
                     }
                 }
@@ -193,11 +505,16 @@ namespace yojimbo
 
     void BaseServer::AdvanceTime( double time )
     {
+        YOJIMBO_TRACE_SCOPE( "BaseServer::AdvanceTime" );
         m_time = time;
+        if ( m_capture )
+            m_capture->WriteEvent( CAPTURE_RECORD_ADVANCE_TIME, 0, time );
         if ( IsRunning() )
         {
             for ( int i = 0; i < m_maxClients; ++i )
             {
+                if ( !m_clientConnection[i] )
+                    continue;
                 m_clientConnection[i]->AdvanceTime( time );
                 const ConnectionErrorLevel connectionErrorLevel = m_clientConnection[i]->GetErrorLevel();
                 if ( connectionErrorLevel != CONNECTION_ERROR_NONE )
@@ -213,6 +530,10 @@ namespace yojimbo
                 m_clientConnection[i]->ProcessAcks( acks, numAcks );
                 reliable_endpoint_clear_acks( m_clientEndpoint[i] );
             }
+            if ( m_clientMemoryReserve )
+            {
+                DecommitIdleClients();
+            }
             NetworkSimulator * networkSimulator = GetNetworkSimulator();
             if ( networkSimulator )
             {
@@ -261,7 +582,8 @@ namespace yojimbo
     {
         yojimbo_assert( clientIndex >= 0 );
         yojimbo_assert( clientIndex < m_maxClients );
-        yojimbo_assert( m_clientMessageFactory[clientIndex] );
+        if ( !m_clientMessageFactory[clientIndex] )
+            return NULL;
         return m_clientMessageFactory[clientIndex]->CreateMessage( type );
     }
 
@@ -269,7 +591,8 @@ namespace yojimbo
     {
         yojimbo_assert( clientIndex >= 0 );
         yojimbo_assert( clientIndex < m_maxClients );
-        yojimbo_assert( m_clientAllocator[clientIndex] );
+        if ( !m_clientAllocator[clientIndex] )
+            return NULL;
         return (uint8_t*) YOJIMBO_ALLOCATE( *m_clientAllocator[clientIndex], bytes );
     }
 
@@ -298,7 +621,10 @@ namespace yojimbo
         yojimbo_assert( clientIndex < m_maxClients );
         yojimbo_assert( channelIndex >= 0 );
         yojimbo_assert( channelIndex < m_config.numChannels );
-        yojimbo_assert( m_clientConnection[clientIndex] );
+        if ( IsDirectLoopbackClient( clientIndex ) )
+            return m_clientDirectLoopback[clientIndex]->CanSendMessage( DIRECT_LOOPBACK_SERVER_TO_CLIENT, channelIndex );
+        if ( !m_clientConnection[clientIndex] )
+            return false;
         return m_clientConnection[clientIndex]->CanSendMessage( channelIndex );
     }
 
@@ -306,9 +632,12 @@ namespace yojimbo
     {
         yojimbo_assert( clientIndex >= 0 );
         yojimbo_assert( clientIndex < m_maxClients );
-        yojimbo_assert( m_clientConnection[clientIndex] );
         yojimbo_assert( channelIndex >= 0 );
         yojimbo_assert( channelIndex < m_config.numChannels );
+        if ( IsDirectLoopbackClient( clientIndex ) )
+            return m_clientDirectLoopback[clientIndex]->HasMessagesToSend( DIRECT_LOOPBACK_SERVER_TO_CLIENT, channelIndex );
+        if ( !m_clientConnection[clientIndex] )
+            return false;
         return m_clientConnection[clientIndex]->HasMessagesToSend( channelIndex );
     }
 
@@ -319,6 +648,11 @@ namespace yojimbo
         yojimbo_assert( m_clientConnection[clientIndex] );
         yojimbo_assert( channelIndex >= 0 );
         yojimbo_assert( channelIndex < m_config.numChannels );
+        if ( IsDirectLoopbackClient( clientIndex ) )
+        {
+            m_clientDirectLoopback[clientIndex]->SendMessage( DIRECT_LOOPBACK_SERVER_TO_CLIENT, channelIndex, message );
+            return;
+        }
         return m_clientConnection[clientIndex]->SendMessage( channelIndex, message, GetContext() );
     }
 
@@ -326,9 +660,12 @@ namespace yojimbo
     {
         yojimbo_assert( clientIndex >= 0 );
         yojimbo_assert( clientIndex < m_maxClients );
-        yojimbo_assert( m_clientConnection[clientIndex] );
         yojimbo_assert( channelIndex >= 0 );
         yojimbo_assert( channelIndex < m_config.numChannels );
+        if ( IsDirectLoopbackClient( clientIndex ) )
+            return m_clientDirectLoopback[clientIndex]->ReceiveMessage( DIRECT_LOOPBACK_CLIENT_TO_SERVER, channelIndex );
+        if ( !m_clientConnection[clientIndex] )
+            return NULL;
         return m_clientConnection[clientIndex]->ReceiveMessage( channelIndex );
     }
 
@@ -340,6 +677,16 @@ namespace yojimbo
         m_clientConnection[clientIndex]->ReleaseMessage( message );
     }
 
+    void BaseServer::SetBlockStreamWriteFunction( int clientIndex, int channelIndex, BlockStreamWriteFunction function, void * context )
+    {
+        yojimbo_assert( clientIndex >= 0 );
+        yojimbo_assert( clientIndex < m_maxClients );
+        yojimbo_assert( m_clientConnection[clientIndex] );
+        yojimbo_assert( channelIndex >= 0 );
+        yojimbo_assert( channelIndex < m_config.numChannels );
+        m_clientConnection[clientIndex]->SetBlockStreamWriteFunction( channelIndex, function, context );
+    }
+
     void BaseServer::GetNetworkInfo( int clientIndex, NetworkInfo & info ) const
     {
         yojimbo_assert( IsRunning() );
@@ -370,6 +717,7 @@ namespace yojimbo
         yojimbo_assert( IsRunning() ); 
         yojimbo_assert( clientIndex >= 0 ); 
         yojimbo_assert( clientIndex < m_maxClients );
+        yojimbo_assert( m_clientMessageFactory[clientIndex] );
         return *m_clientMessageFactory[clientIndex];
     }
 
@@ -433,6 +781,9 @@ namespace yojimbo
 
     void BaseServer::ResetClient( int clientIndex )
     {
-        m_clientConnection[clientIndex]->Reset();
+        if ( m_clientConnection[clientIndex] )
+        {
+            m_clientConnection[clientIndex]->Reset();
+        }
     }
 }
@@ -0,0 +1,556 @@
+#include "yojimbo_capture.h"
+#include "yojimbo_connection.h"
+#include "yojimbo_message.h"
+#include "yojimbo_utils.h"
+#include <string.h>
+
+namespace yojimbo
+{
+    static const uint8_t CaptureMagic[8] = { 'Y', 'O', 'J', 'I', 'C', 'A', 'P', 0 };
+
+    static const int CaptureRecordHeaderBytes = 1 + 2 + 2 + 8 + 4;
+
+    static const int CaptureWriteBufferBytes = 256 * 1024;
+
+    static void CaptureWriteUint8( uint8_t *& p, uint8_t value )
+    {
+        *p++ = value;
+    }
+
+    static void CaptureWriteUint16( uint8_t *& p, uint16_t value )
+    {
+        p[0] = uint8_t( value );
+        p[1] = uint8_t( value >> 8 );
+        p += 2;
+    }
+
+    static void CaptureWriteUint32( uint8_t *& p, uint32_t value )
+    {
+        p[0] = uint8_t( value );
+        p[1] = uint8_t( value >> 8 );
+        p[2] = uint8_t( value >> 16 );
+        p[3] = uint8_t( value >> 24 );
+        p += 4;
+    }
+
+    static void CaptureWriteUint64( uint8_t *& p, uint64_t value )
+    {
+        CaptureWriteUint32( p, uint32_t( value ) );
+        CaptureWriteUint32( p, uint32_t( value >> 32 ) );
+    }
+
+    static void CaptureWriteFloat( uint8_t *& p, float value )
+    {
+        uint32_t bits;
+        memcpy( &bits, &value, sizeof( bits ) );
+        CaptureWriteUint32( p, bits );
+    }
+
+    static void CaptureWriteDouble( uint8_t *& p, double value )
+    {
+        uint64_t bits;
+        memcpy( &bits, &value, sizeof( bits ) );
+        CaptureWriteUint64( p, bits );
+    }
+
+    /// Bounds checked little endian reads over the reader's copy of the file. Any read past the end fails, and so does every read after it.
+
+    struct CaptureCursor
+    {
+        const uint8_t * data;
+        int64_t bytes;
+        int64_t offset;
+        bool ok;
+
+        bool Has( int64_t n )
+        {
+            ok = ok && n >= 0 && offset + n <= bytes;
+            return ok;
+        }
+
+        uint8_t ReadUint8()
+        {
+            if ( !Has( 1 ) )
+                return 0;
+            return data[offset++];
+        }
+
+        uint16_t ReadUint16()
+        {
+            if ( !Has( 2 ) )
+                return 0;
+            const uint8_t * p = data + offset;
+            offset += 2;
+            return uint16_t( p[0] | ( p[1] << 8 ) );
+        }
+
+        uint32_t ReadUint32()
+        {
+            if ( !Has( 4 ) )
+                return 0;
+            const uint8_t * p = data + offset;
+            offset += 4;
+            return uint32_t( p[0] ) | ( uint32_t( p[1] ) << 8 ) | ( uint32_t( p[2] ) << 16 ) | ( uint32_t( p[3] ) << 24 );
+        }
+
+        int ReadInt32()
+        {
+            return int( int32_t( ReadUint32() ) );
+        }
+
+        uint64_t ReadUint64()
+        {
+            const uint64_t low = ReadUint32();
+            const uint64_t high = ReadUint32();
+            return low | ( high << 32 );
+        }
+
+        float ReadFloat()
+        {
+            const uint32_t bits = ReadUint32();
+            float value;
+            memcpy( &value, &bits, sizeof( value ) );
+            return value;
+        }
+
+        double ReadDouble()
+        {
+            const uint64_t bits = ReadUint64();
+            double value;
+            memcpy( &value, &bits, sizeof( value ) );
+            return value;
+        }
+    };
+
+    // ---------------------------------------------------------------------------------
+
+    PacketCapture::PacketCapture( Allocator & allocator )
+    {
+        m_allocator = &allocator;
+        m_file = NULL;
+        m_buffer = NULL;
+        m_bytesWritten = 0;
+        m_path[0] = '\0';
+    }
+
+    PacketCapture::~PacketCapture()
+    {
+        Close();
+    }
+
+    bool PacketCapture::Open( const char * path, const ConnectionConfig & config, bool server )
+    {
+        yojimbo_assert( path );
+
+        Close();
+
+        m_file = fopen( path, "wb" );
+        if ( !m_file )
+        {
+            yojimbo_printf( YOJIMBO_LOG_LEVEL_ERROR, "error: failed to create capture file %s\n", path );
+            return false;
+        }
+
+        yojimbo_copy_string( m_path, path, sizeof( m_path ) );
+
+        m_buffer = (char*) YOJIMBO_ALLOCATE( *m_allocator, CaptureWriteBufferBytes );
+        if ( m_buffer )
+            setvbuf( m_file, m_buffer, _IOFBF, CaptureWriteBufferBytes );
+
+        m_bytesWritten = 0;
+
+        uint8_t header[8+4+4+4+4];
+        uint8_t * p = header;
+        memcpy( p, CaptureMagic, sizeof( CaptureMagic ) );
+        p += sizeof( CaptureMagic );
+        CaptureWriteUint32( p, CaptureVersion );
+        CaptureWriteUint32( p, server ? 1 : 0 );
+        CaptureWriteUint32( p, uint32_t( config.maxPacketSize ) );
+        CaptureWriteUint32( p, uint32_t( config.numChannels ) );
+        Write( header, int( p - header ) );
+
+        for ( int i = 0; i < config.numChannels && m_file; ++i )
+        {
+            const ChannelConfig & channel = config.channel[i];
+            uint8_t fields[64];
+            p = fields;
+            CaptureWriteUint32( p, uint32_t( channel.type ) );
+            CaptureWriteUint8( p, channel.disableBlocks ? 1 : 0 );
+            CaptureWriteUint32( p, uint32_t( channel.sentPacketBufferSize ) );
+            CaptureWriteUint32( p, uint32_t( channel.messageSendQueueSize ) );
+            CaptureWriteUint32( p, uint32_t( channel.messageReceiveQueueSize ) );
+            CaptureWriteUint32( p, uint32_t( channel.maxMessagesPerPacket ) );
+            CaptureWriteUint32( p, uint32_t( channel.packetBudget ) );
+            CaptureWriteUint32( p, uint32_t( channel.maxBlockSize ) );
+            CaptureWriteUint32( p, uint32_t( channel.blockFragmentSize ) );
+            CaptureWriteFloat( p, channel.messageResendTime );
+            CaptureWriteFloat( p, channel.blockFragmentResendTime );
+            CaptureWriteUint32( p, uint32_t( channel.maxFragmentsPerPacket ) );
+            CaptureWriteUint32( p, uint32_t( channel.maxBlocksInFlight ) );
+            CaptureWriteUint32( p, uint32_t( channel.streamWindowSize ) );
+            CaptureWriteUint8( p, channel.compressBlocks ? 1 : 0 );
+            const int dictionaryBytes = channel.compressionDictionary ? channel.compressionDictionaryBytes : 0;
+            CaptureWriteUint32( p, uint32_t( dictionaryBytes ) );
+            Write( fields, int( p - fields ) );
+            if ( dictionaryBytes > 0 )
+                Write( channel.compressionDictionary, dictionaryBytes );
+            p = fields;
+            CaptureWriteUint32( p, uint32_t( channel.snapshotBufferSize ) );
+            Write( fields, int( p - fields ) );
+        }
+
+        return IsOpen();
+    }
+
+    void PacketCapture::Close()
+    {
+        if ( m_file )
+        {
+            if ( fclose( m_file ) != 0 )
+                yojimbo_printf( YOJIMBO_LOG_LEVEL_ERROR, "error: failed to write capture file %s\n", m_path );
+            m_file = NULL;
+        }
+        // stdio owns the buffer until the file is closed
+        YOJIMBO_FREE( *m_allocator, m_buffer );
+    }
+
+    void PacketCapture::Write( const uint8_t * data, int bytes )
+    {
+        if ( !m_file )
+            return;
+        if ( fwrite( data, 1, bytes, m_file ) != size_t( bytes ) )
+        {
+            yojimbo_printf( YOJIMBO_LOG_LEVEL_ERROR, "error: failed to write capture file %s. capture stopped\n", m_path );
+            Close();
+            return;
+        }
+        m_bytesWritten += bytes;
+    }
+
+    void PacketCapture::WriteRecordHeader( CaptureRecordType type, int clientIndex, uint16_t packetSequence, double time, int packetBytes )
+    {
+        yojimbo_assert( type >= 0 && type < CAPTURE_NUM_RECORD_TYPES );
+        yojimbo_assert( clientIndex >= 0 && clientIndex <= 0xFFFF );
+        uint8_t header[CaptureRecordHeaderBytes];
+        uint8_t * p = header;
+        CaptureWriteUint8( p, uint8_t( type ) );
+        CaptureWriteUint16( p, uint16_t( clientIndex ) );
+        CaptureWriteUint16( p, packetSequence );
+        CaptureWriteDouble( p, time );
+        CaptureWriteUint32( p, uint32_t( packetBytes ) );
+        Write( header, CaptureRecordHeaderBytes );
+    }
+
+    void PacketCapture::WritePacket( CaptureRecordType type, int clientIndex, uint16_t packetSequence, double time, const uint8_t * packetData, int packetBytes )
+    {
+        yojimbo_assert( type == CAPTURE_RECORD_PACKET_RECEIVED || type == CAPTURE_RECORD_PACKET_SENT );
+        yojimbo_assert( packetData );
+        yojimbo_assert( packetBytes >= 0 );
+        WriteRecordHeader( type, clientIndex, packetSequence, time, packetBytes );
+        Write( packetData, packetBytes );
+    }
+
+    void PacketCapture::WriteEvent( CaptureRecordType type, int clientIndex, double time )
+    {
+        yojimbo_assert( type == CAPTURE_RECORD_ADVANCE_TIME || type == CAPTURE_RECORD_CLIENT_CONNECTED || type == CAPTURE_RECORD_CLIENT_DISCONNECTED );
+        WriteRecordHeader( type, type == CAPTURE_RECORD_ADVANCE_TIME ? 0 : clientIndex, 0, time, 0 );
+    }
+
+    // ---------------------------------------------------------------------------------
+
+    PacketCaptureReader::PacketCaptureReader( Allocator & allocator )
+    {
+        m_allocator = &allocator;
+        m_data = NULL;
+        m_bytes = 0;
+        m_firstRecord = 0;
+        m_offset = 0;
+        m_server = false;
+        m_truncated = false;
+    }
+
+    PacketCaptureReader::~PacketCaptureReader()
+    {
+        Close();
+    }
+
+    bool PacketCaptureReader::Open( const char * path )
+    {
+        yojimbo_assert( path );
+
+        Close();
+
+        FILE * file = fopen( path, "rb" );
+        if ( !file )
+        {
+            yojimbo_printf( YOJIMBO_LOG_LEVEL_ERROR, "error: failed to open capture file %s\n", path );
+            return false;
+        }
+
+        fseek( file, 0, SEEK_END );
+        const long fileBytes = ftell( file );
+        fseek( file, 0, SEEK_SET );
+
+        // Packet records are passed to Connection::ProcessPacket in place, and the bit reader loads 8 byte
+        // windows, so the copy extends 8 zero bytes past the end of the file for a packet in the last record.
+
+        if ( fileBytes > 0 )
+        {
+            m_data = (uint8_t*) YOJIMBO_ALLOCATE( *m_allocator, size_t( fileBytes ) + 8 );
+            if ( m_data )
+                memset( m_data + fileBytes, 0, 8 );
+        }
+
+        const bool read = m_data && fread( m_data, 1, size_t( fileBytes ), file ) == size_t( fileBytes );
+
+        fclose( file );
+
+        if ( !read )
+        {
+            yojimbo_printf( YOJIMBO_LOG_LEVEL_ERROR, "error: failed to read capture file %s\n", path );
+            Close();
+            return false;
+        }
+
+        m_bytes = fileBytes;
+
+        CaptureCursor cursor = { m_data, m_bytes, 0, true };
+
+        if ( !cursor.Has( sizeof( CaptureMagic ) ) || memcmp( m_data, CaptureMagic, sizeof( CaptureMagic ) ) != 0 )
+        {
+            yojimbo_printf( YOJIMBO_LOG_LEVEL_ERROR, "error: %s is not a capture file\n", path );
+            Close();
+            return false;
+        }
+        cursor.offset += sizeof( CaptureMagic );
+
+        const uint32_t version = cursor.ReadUint32();
+        if ( cursor.ok && version != CaptureVersion )
+        {
+            yojimbo_printf( YOJIMBO_LOG_LEVEL_ERROR, "error: capture file %s is version %u. this reader understands version %u\n", path, version, CaptureVersion );
+            Close();
+            return false;
+        }
+
+        const uint32_t flags = cursor.ReadUint32();
+        m_server = ( flags & 1 ) != 0;
+
+        m_config = ConnectionConfig();
+        m_config.maxPacketSize = cursor.ReadInt32();
+        m_config.numChannels = cursor.ReadInt32();
+
+        bool valid = cursor.ok && m_config.maxPacketSize > 0 && m_config.numChannels >= 1 && m_config.numChannels <= MaxChannels;
+
+        for ( int i = 0; valid && i < m_config.numChannels; ++i )
+        {
+            ChannelConfig & channel = m_config.channel[i];
+            const int type = cursor.ReadInt32();
+            channel.type = (ChannelType) type;
+            channel.disableBlocks = cursor.ReadUint8() != 0;
+            channel.sentPacketBufferSize = cursor.ReadInt32();
+            channel.messageSendQueueSize = cursor.ReadInt32();
+            channel.messageReceiveQueueSize = cursor.ReadInt32();
+            channel.maxMessagesPerPacket = cursor.ReadInt32();
+            channel.packetBudget = cursor.ReadInt32();
+            channel.maxBlockSize = cursor.ReadInt32();
+            channel.blockFragmentSize = cursor.ReadInt32();
+            channel.messageResendTime = cursor.ReadFloat();
+            channel.blockFragmentResendTime = cursor.ReadFloat();
+            channel.maxFragmentsPerPacket = cursor.ReadInt32();
+            channel.maxBlocksInFlight = cursor.ReadInt32();
+            channel.streamWindowSize = cursor.ReadInt32();
+            channel.compressBlocks = cursor.ReadUint8() != 0;
+            const int dictionaryBytes = cursor.ReadInt32();
+            if ( dictionaryBytes > 0 && cursor.Has( dictionaryBytes ) )
+            {
+                channel.compressionDictionary = m_data + cursor.offset;
+                channel.compressionDictionaryBytes = dictionaryBytes;
+                cursor.offset += dictionaryBytes;
+            }
+            channel.snapshotBufferSize = cursor.ReadInt32();
+            valid = cursor.ok && type >= CHANNEL_TYPE_RELIABLE_ORDERED && type <= CHANNEL_TYPE_SNAPSHOT && dictionaryBytes >= 0;
+        }
+
+        // The channel sizes come from the file, and replay builds a connection with them, so hold them to the
+        // same rules as ConnectionConfig::Validate. That only asserts in debug, so check them for real here.
+
+        valid = valid && m_config.IsValid();
+
+        if ( !valid )
+        {
+            yojimbo_printf( YOJIMBO_LOG_LEVEL_ERROR, "error: capture file %s has an invalid header\n", path );
+            Close();
+            return false;
+        }
+
+        m_firstRecord = cursor.offset;
+        m_offset = m_firstRecord;
+        m_truncated = false;
+
+        return true;
+    }
+
+    void PacketCaptureReader::Close()
+    {
+        YOJIMBO_FREE( *m_allocator, m_data );
+        m_bytes = 0;
+        m_firstRecord = 0;
+        m_offset = 0;
+        m_server = false;
+        m_truncated = false;
+        m_config = ConnectionConfig();
+    }
+
+    bool PacketCaptureReader::ReadRecord( CaptureRecord & record )
+    {
+        if ( !m_data || m_offset == m_bytes )
+            return false;
+
+        CaptureCursor cursor = { m_data, m_bytes, m_offset, true };
+
+        const int type = cursor.ReadUint8();
+        record.type = (CaptureRecordType) type;
+        record.clientIndex = cursor.ReadUint16();
+        record.packetSequence = cursor.ReadUint16();
+        record.time = cursor.ReadDouble();
+        const uint32_t packetBytes = cursor.ReadUint32();
+
+        const bool isPacket = type == CAPTURE_RECORD_PACKET_RECEIVED || type == CAPTURE_RECORD_PACKET_SENT;
+
+        if ( !cursor.ok || type >= CAPTURE_NUM_RECORD_TYPES || record.clientIndex >= MaxClients || packetBytes > uint32_t( m_config.maxPacketSize ) || ( !isPacket && packetBytes != 0 ) || !cursor.Has( packetBytes ) )
+        {
+            m_truncated = true;
+            return false;
+        }
+
+        record.packetData = isPacket ? m_data + cursor.offset : NULL;
+        record.packetBytes = int( packetBytes );
+
+        m_offset = cursor.offset + packetBytes;
+
+        return true;
+    }
+
+    void PacketCaptureReader::Rewind()
+    {
+        m_offset = m_firstRecord;
+        m_truncated = false;
+    }
+
+    // ---------------------------------------------------------------------------------
+
+    static void ReplayReceiveMessages( Connection & connection, int numChannels, CaptureReplayStats & stats )
+    {
+        for ( int i = 0; i < numChannels; ++i )
+        {
+            while ( Message * message = connection.ReceiveMessage( i ) )
+            {
+                stats.numMessagesReceived++;
+                connection.ReleaseMessage( message );
+            }
+        }
+    }
+
+    bool ReplayCapture( Allocator & allocator, MessageFactory & messageFactory, void * context, PacketCaptureReader & reader, bool replaySent, CaptureReplayStats & stats )
+    {
+        stats.Reset();
+
+        const ConnectionConfig & config = reader.GetConnectionConfig();
+
+        // connections are created for a slot the first time it shows up, so a capture of a few clients on a big server stays cheap
+
+        Connection * connection[MaxClients];
+        Connection * peer[MaxClients];
+        memset( connection, 0, sizeof( connection ) );
+        memset( peer, 0, sizeof( peer ) );
+
+        bool result = true;
+        double time = 0.0;
+
+        CaptureRecord record;
+
+        while ( reader.ReadRecord( record ) )
+        {
+            stats.numRecords++;
+
+            if ( stats.numRecords == 1 )
+                time = record.time;
+
+            if ( record.type == CAPTURE_RECORD_ADVANCE_TIME )
+            {
+                time = record.time;
+                for ( int i = 0; i < MaxClients; ++i )
+                {
+                    if ( connection[i] )
+                        connection[i]->AdvanceTime( time );
+                    if ( peer[i] )
+                        peer[i]->AdvanceTime( time );
+                }
+                stats.numAdvanceTimes++;
+                continue;
+            }
+
+            if ( record.type == CAPTURE_RECORD_PACKET_SENT && !replaySent )
+                continue;
+
+            const int clientIndex = record.clientIndex;
+
+            Connection ** slot = ( record.type == CAPTURE_RECORD_PACKET_SENT ) ? &peer[clientIndex] : &connection[clientIndex];
+
+            if ( !*slot )
+            {
+                *slot = YOJIMBO_NEW( allocator, Connection, allocator, messageFactory, config, time );
+                if ( !*slot )
+                {
+                    yojimbo_printf( YOJIMBO_LOG_LEVEL_ERROR, "error: failed to create replay connection for client %d\n", clientIndex );
+                    result = false;
+                    break;
+                }
+            }
+
+            Connection & target = **slot;
+
+            switch ( record.type )
+            {
+                case CAPTURE_RECORD_PACKET_RECEIVED:
+                case CAPTURE_RECORD_PACKET_SENT:
+                {
+                    if ( record.type == CAPTURE_RECORD_PACKET_RECEIVED )
+                        stats.numPacketsReceived++;
+                    else
+                        stats.numPacketsSent++;
+                    stats.packetBytes += record.packetBytes;
+                    if ( !target.ProcessPacket( context, record.packetSequence, record.packetData, record.packetBytes ) )
+                        stats.numPacketErrors++;
+                    ReplayReceiveMessages( target, config.numChannels, stats );
+                }
+                break;
+
+                case CAPTURE_RECORD_CLIENT_CONNECTED:
+                case CAPTURE_RECORD_CLIENT_DISCONNECTED:
+                {
+                    target.Reset();
+                    if ( peer[clientIndex] )
+                        peer[clientIndex]->Reset();
+                    if ( record.type == CAPTURE_RECORD_CLIENT_CONNECTED )
+                        stats.numConnects++;
+                }
+                break;
+
+                default:
+                    break;
+            }
+        }
+
+        if ( reader.IsTruncated() )
+            result = false;
+
+        for ( int i = 0; i < MaxClients; ++i )
+        {
+            YOJIMBO_DELETE( allocator, Connection, connection[i] );
+            YOJIMBO_DELETE( allocator, Connection, peer[i] );
+        }
+
+        return result;
+    }
+}
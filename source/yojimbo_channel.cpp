@@ -43,6 +43,13 @@ namespace yojimbo
         block.fragmentSize = 0;
         block.numFragments = 0;
         block.messageType = 0;
+        numExtraFragments = 0;
+        extraFragments = NULL;
+        snapshot.data = NULL;
+        snapshot.dataBytes = 0;
+        snapshot.snapshotBytes = 0;
+        snapshot.snapshotId = 0;
+        snapshot.baselineOffset = 0;
         initialized = 1;
     }
 
@@ -72,7 +79,19 @@ namespace yojimbo
                 block.message = NULL;
             }
             YOJIMBO_FREE( allocator, block.fragmentData );
+            for ( int i = 0; i < numExtraFragments; ++i )
+            {
+                if ( extraFragments[i].message )
+                {
+                    messageFactory.ReleaseMessage( extraFragments[i].message );
+                    extraFragments[i].message = NULL;
+                }
+                YOJIMBO_FREE( allocator, extraFragments[i].fragmentData );
+            }
+            YOJIMBO_FREE( allocator, extraFragments );
+            numExtraFragments = 0;
         }
+        YOJIMBO_FREE( allocator, snapshot.data );
         initialized = 0;
     }
 
@@ -151,7 +170,7 @@ namespace yojimbo
 
             yojimbo_assert( messages[i] );
 
-            if ( !messages[i]->SerializeInternal( stream ) )
+            if ( !messageFactory.SerializeMessage( messages[i], stream ) )
             {
                 yojimbo_printf( YOJIMBO_LOG_LEVEL_ERROR, "error: failed to serialize message of type %d (SerializeOrderedMessages)\n", messageTypes[i] );
                 return false;
@@ -270,7 +289,7 @@ namespace yojimbo
 
             yojimbo_assert( messages[i] );
 
-            if ( !messages[i]->SerializeInternal( stream ) )
+            if ( !messageFactory.SerializeMessage( messages[i], stream ) )
             {
                 yojimbo_printf( YOJIMBO_LOG_LEVEL_ERROR, "error: failed to serialize message type %d (SerializeUnorderedMessages)\n", messageTypes[i] );
                 return false;
@@ -333,6 +352,118 @@ namespace yojimbo
         return result;
     }
 
+    template <typename Stream> bool SerializeSnapshot( Stream & stream,
+                                                       MessageFactory & messageFactory,
+                                                       int & numMessages,
+                                                       Message ** & messages,
+                                                       ChannelPacketData::SnapshotData & snapshot,
+                                                       const ChannelConfig & channelConfig )
+    {
+        const int maxMessageType = messageFactory.GetNumTypes() - 1;
+
+        Allocator & allocator = messageFactory.GetAllocator();
+
+        if ( Stream::IsReading )
+        {
+            messages = (Message**) YOJIMBO_ALLOCATE( allocator, sizeof( Message* ) );
+
+            if ( !messages )
+            {
+                yojimbo_printf( YOJIMBO_LOG_LEVEL_ERROR, "error: failed to allocate messages (SerializeSnapshot)\n" );
+                return false;
+            }
+
+            // A NULL entry is skipped by ChannelPacketData::Free, so a failed read below leaves the arm safe to free.
+            messages[0] = NULL;
+            numMessages = 1;
+        }
+        else
+        {
+            yojimbo_assert( numMessages == 1 );
+            yojimbo_assert( messages && messages[0] );
+        }
+
+        serialize_bits( stream, snapshot.snapshotId, 16 );
+
+        serialize_int( stream, snapshot.baselineOffset, 0, channelConfig.snapshotBufferSize - 1 );
+
+        serialize_int( stream, snapshot.snapshotBytes, 0, channelConfig.maxBlockSize );
+
+        if ( snapshot.snapshotBytes == 0 )
+        {
+            // An empty snapshot has nothing to delta against.
+            if ( snapshot.baselineOffset != 0 )
+                return false;
+            snapshot.dataBytes = 0;
+        }
+        else if ( snapshot.baselineOffset != 0 )
+        {
+            // The sender falls back to a full snapshot whenever the delta isn't smaller, so a
+            // delta is always shorter than the snapshot it encodes.
+            if ( snapshot.snapshotBytes < 2 )
+                return false;
+            serialize_int( stream, snapshot.dataBytes, 1, snapshot.snapshotBytes - 1 );
+        }
+        else
+        {
+            snapshot.dataBytes = snapshot.snapshotBytes;
+        }
+
+        if ( snapshot.dataBytes > 0 )
+        {
+            if ( Stream::IsReading )
+            {
+                // The delta decoder reads this with a bit reader, which needs 8 bytes of slack
+                // past the end of the data.
+                snapshot.data = (uint8_t*) YOJIMBO_ALLOCATE( allocator, snapshot.dataBytes + 8 );
+
+                if ( !snapshot.data )
+                {
+                    yojimbo_printf( YOJIMBO_LOG_LEVEL_ERROR, "error: failed to allocate snapshot data (SerializeSnapshot)\n" );
+                    return false;
+                }
+
+                memset( snapshot.data + snapshot.dataBytes, 0, 8 );
+            }
+
+            serialize_bytes( stream, snapshot.data, snapshot.dataBytes );
+        }
+
+        int messageType = Stream::IsWriting ? messages[0]->GetType() : 0;
+
+        if ( maxMessageType > 0 )
+        {
+            serialize_int( stream, messageType, 0, maxMessageType );
+        }
+
+        if ( Stream::IsReading )
+        {
+            messages[0] = messageFactory.CreateMessage( messageType );
+
+            if ( !messages[0] )
+            {
+                yojimbo_printf( YOJIMBO_LOG_LEVEL_ERROR, "error: failed to create message of type %d (SerializeSnapshot)\n", messageType );
+                return false;
+            }
+
+            if ( snapshot.snapshotBytes > 0 && !messages[0]->IsBlockMessage() )
+            {
+                yojimbo_printf( YOJIMBO_LOG_LEVEL_ERROR, "error: received snapshot data attached to non-block message (SerializeSnapshot)\n" );
+                return false;
+            }
+
+            messages[0]->SetId( snapshot.snapshotId );
+        }
+
+        if ( !messageFactory.SerializeMessage( messages[0], stream ) )
+        {
+            yojimbo_printf( YOJIMBO_LOG_LEVEL_ERROR, "error: failed to serialize message of type %d (SerializeSnapshot)\n", messageType );
+            return false;
+        }
+
+        return true;
+    }
+
     template <typename Stream> bool SerializeBlockFragment( Stream & stream, 
                                                             MessageFactory & messageFactory, 
                                                             ChannelPacketData::BlockData & block, 
@@ -344,6 +475,8 @@ namespace yojimbo
         {
             block.message = NULL;
             block.fragmentData = NULL;
+            block.streamSize = 0;
+            block.uncompressedSize = 0;
             // messageType is only serialized with fragment 0 (below); default it so a
             // non-zero fragment leaves it defined rather than read uninitialized by callers.
             block.messageType = 0;
@@ -351,24 +484,46 @@ namespace yojimbo
 
         serialize_bits( stream, block.messageId, 16 );
 
-        if ( channelConfig.GetMaxFragmentsPerBlock() > 1 )
+        bool isStream = Stream::IsWriting && block.isStream;
+
+        if ( channelConfig.streamWindowSize > 0 )
         {
-            serialize_int( stream, block.numFragments, 1, channelConfig.GetMaxFragmentsPerBlock() );
-        }
-        else
-        {
-            if ( Stream::IsReading )
-                block.numFragments = 1;
+            serialize_bool( stream, isStream );
         }
 
-        if ( block.numFragments > 1 )
+        if ( Stream::IsReading )
+            block.isStream = isStream;
+
+        if ( isStream )
         {
-            serialize_int( stream, block.fragmentId, 0, block.numFragments - 1 );
+            // Streams have no fragment count limit, so the fragment id is sent in full and the count follows from the stream size.
+
+            serialize_bits( stream, block.fragmentId, 32 );
+
+            if ( Stream::IsReading )
+                block.numFragments = 0;
         }
         else
         {
-            if ( Stream::IsReading )
-                block.fragmentId = 0;
+            if ( channelConfig.GetMaxFragmentsPerBlock() > 1 )
+            {
+                serialize_int( stream, block.numFragments, 1, channelConfig.GetMaxFragmentsPerBlock() );
+            }
+            else
+            {
+                if ( Stream::IsReading )
+                    block.numFragments = 1;
+            }
+
+            if ( block.numFragments > 1 )
+            {
+                serialize_int( stream, block.fragmentId, 0, block.numFragments - 1 );
+            }
+            else
+            {
+                if ( Stream::IsReading )
+                    block.fragmentId = 0;
+            }
         }
 
         serialize_int( stream, block.fragmentSize, 1, channelConfig.blockFragmentSize );
@@ -388,6 +543,34 @@ namespace yojimbo
 
         if ( block.fragmentId == 0 )
         {
+            if ( isStream )
+            {
+                serialize_uint64( stream, block.streamSize );
+
+                if ( Stream::IsReading && block.streamSize == 0 )
+                {
+                    yojimbo_printf( YOJIMBO_LOG_LEVEL_ERROR, "error: received empty block stream (SerializeBlockFragment)\n" );
+                    return false;
+                }
+            }
+            else if ( channelConfig.compressBlocks )
+            {
+                bool compressed = Stream::IsWriting && block.uncompressedSize > 0;
+
+                serialize_bool( stream, compressed );
+
+                if ( compressed )
+                {
+                    serialize_int( stream, block.uncompressedSize, 0, channelConfig.maxBlockSize );
+
+                    if ( Stream::IsReading && block.uncompressedSize == 0 )
+                    {
+                        yojimbo_printf( YOJIMBO_LOG_LEVEL_ERROR, "error: received empty compressed block (SerializeBlockFragment)\n" );
+                        return false;
+                    }
+                }
+            }
+
             // block message
 
             if ( maxMessageType > 0 )
@@ -421,7 +604,7 @@ namespace yojimbo
 
             yojimbo_assert( block.message );
 
-            if ( !block.message->SerializeInternal( stream ) )
+            if ( !messageFactory.SerializeMessage( block.message, stream ) )
             {
                 yojimbo_printf( YOJIMBO_LOG_LEVEL_ERROR, "error: failed to serialize block message of type %d (SerializeBlockFragment)\n", block.messageType );
                 return false;
@@ -456,6 +639,7 @@ namespace yojimbo
             switch ( channelConfig.type )
             {
                 case CHANNEL_TYPE_RELIABLE_ORDERED:
+                case CHANNEL_TYPE_RELIABLE_UNORDERED:
                 {
                     if ( !SerializeOrderedMessages( stream, messageFactory, message.numMessages, message.messages, channelConfig.maxMessagesPerPacket ) )
                     {
@@ -479,6 +663,16 @@ namespace yojimbo
                     }
                 }
                 break;
+
+                case CHANNEL_TYPE_SNAPSHOT:
+                {
+                    if ( !SerializeSnapshot( stream, messageFactory, message.numMessages, message.messages, snapshot, channelConfig ) )
+                    {
+                        messageFailedToSerialize = 1;
+                        return true;
+                    }
+                }
+                break;
             }
 
 #if YOJIMBO_DEBUG_MESSAGE_BUDGET
@@ -498,8 +692,37 @@ namespace yojimbo
             if ( channelConfig.disableBlocks )
                 return false;
 
+            int numFragments = 1 + numExtraFragments;
+
+            if ( channelConfig.maxFragmentsPerPacket > 1 )
+            {
+                serialize_int( stream, numFragments, 1, channelConfig.maxFragmentsPerPacket );
+            }
+
+            if ( Stream::IsReading && numFragments > 1 )
+            {
+                // Zeroed, so a read that fails part way through leaves the unread entries safe to free.
+                extraFragments = (BlockData*) YOJIMBO_ALLOCATE( messageFactory.GetAllocator(), sizeof( BlockData ) * ( numFragments - 1 ) );
+
+                if ( !extraFragments )
+                {
+                    yojimbo_printf( YOJIMBO_LOG_LEVEL_ERROR, "error: failed to allocate block fragments\n" );
+                    return false;
+                }
+
+                memset( extraFragments, 0, sizeof( BlockData ) * ( numFragments - 1 ) );
+
+                numExtraFragments = numFragments - 1;
+            }
+
             if ( !SerializeBlockFragment( stream, messageFactory, block, channelConfig ) )
                 return false;
+
+            for ( int i = 0; i < numExtraFragments; ++i )
+            {
+                if ( !SerializeBlockFragment( stream, messageFactory, extraFragments[i], channelConfig ) )
+                    return false;
+            }
         }
 
         return true;
@@ -551,6 +774,14 @@ namespace yojimbo
         return m_channelIndex;
     }
 
+    void Channel::ProcessAcks( const uint16_t * acks, int numAcks )
+    {
+        for ( int i = 0; i < numAcks; ++i )
+        {
+            ProcessAck( acks[i] );
+        }
+    }
+
     void Channel::SetErrorLevel( ChannelErrorLevel errorLevel )
     {
         if ( errorLevel != m_errorLevel && errorLevel != CHANNEL_ERROR_NONE )
@@ -1,8 +1,10 @@
 #include "yojimbo_client.h"
 #include "yojimbo_connection.h"
+#include "yojimbo_server.h"
 #include "yojimbo_network_simulator.h"
 #include "yojimbo_adapter.h"
 #include "yojimbo_utils.h"
+#include "yojimbo_trace.h"
 #include "netcode.h"
 #include "reliable.h"
 
@@ -29,6 +31,7 @@ namespace yojimbo
     {
         m_clientId = 0;
         m_client = NULL;
+        m_decryptFailures = 0;
         m_boundAddress = m_address;
     }
 
@@ -150,16 +153,26 @@ namespace yojimbo
 
     void Client::SendPackets()
     {
-        if ( !IsConnected() )
+        if ( !IsConnected() || IsDirectLoopback() )
             return;
         yojimbo_assert( m_client );
+        YOJIMBO_TRACE_SCOPE( "Client::SendPackets" );
+        const double startTime = yojimbo_time();
         uint8_t * packetData = GetPacketBuffer();
         int packetBytes;
         uint16_t packetSequence = reliable_endpoint_next_packet_sequence( GetEndpoint() );
         if ( GetConnection().GeneratePacket( GetContext(), packetSequence, packetData, m_config.maxPacketSize, packetBytes ) )
         {
+            if ( PacketCapture * capture = GetCapture() )
+                capture->WritePacket( CAPTURE_RECORD_PACKET_SENT, 0, packetSequence, GetTime(), packetData, packetBytes );
+            YOJIMBO_TRACE_BEGIN( "reliable_endpoint_send_packet" );
             reliable_endpoint_send_packet( GetEndpoint(), packetData, packetBytes );
+            YOJIMBO_TRACE_END( "reliable_endpoint_send_packet" );
         }
+        const int sendQueueDepth = GetConnection().GetSendQueueDepth();
+        GetMetrics().Observe( GetConnectionMetrics().sendQueueDepth, sendQueueDepth );
+        GetMetrics().SetGauge( GetConnectionMetrics().sendQueueMessages, sendQueueDepth );
+        GetMetrics().Observe( GetConnectionMetrics().sendPacketsTime, yojimbo_time() - startTime );
     }
 
     void Client::ReceivePackets()
@@ -167,6 +180,10 @@ namespace yojimbo
         if ( !IsConnected() )
             return;
         yojimbo_assert( m_client );
+        YOJIMBO_TRACE_SCOPE( "Client::ReceivePackets" );
+        const double startTime = yojimbo_time();
+        MetricsRegistry & metrics = GetMetrics();
+        const ConnectionMetrics & ids = GetConnectionMetrics();
         while ( true )
         {
             int packetBytes;
@@ -174,17 +191,31 @@ namespace yojimbo
             uint8_t * packetData = netcode_client_receive_packet( m_client, &packetBytes, &packetSequence );
             if ( !packetData )
                 break;
+            metrics.Increment( ids.packetsReceived );
+            metrics.Observe( ids.packetBytesReceived, packetBytes );
+            YOJIMBO_TRACE_BEGIN( "reliable_endpoint_receive_packet" );
             reliable_endpoint_receive_packet( GetEndpoint(), packetData, packetBytes );
+            YOJIMBO_TRACE_END( "reliable_endpoint_receive_packet" );
             netcode_client_free_packet( m_client, packetData );
         }
+        metrics.Observe( ids.receivePacketsTime, yojimbo_time() - startTime );
     }
 
     void Client::AdvanceTime( double time )
     {
+        const double startTime = yojimbo_time();
         BaseClient::AdvanceTime( time );
         if ( m_client )
         {
+            YOJIMBO_TRACE_BEGIN( "netcode_client_update" );
             netcode_client_update( m_client, time );
+            YOJIMBO_TRACE_END( "netcode_client_update" );
+#ifndef YOJIMBO_SYSTEM_DEPS
+            // netcode reads the socket here, so this is where it drops packets that fail to decrypt
+            const uint64_t decryptFailures = netcode_client_num_decrypt_failures( m_client );
+            GetMetrics().Increment( GetConnectionMetrics().decryptFailures, decryptFailures - m_decryptFailures );
+            m_decryptFailures = decryptFailures;
+#endif // #ifndef YOJIMBO_SYSTEM_DEPS
             const int state = netcode_client_state( m_client );
             if ( state < NETCODE_CLIENT_STATE_DISCONNECTED )
             {
@@ -238,6 +269,8 @@ namespace yojimbo
                 }
             }
         }
+        GetMetrics().SetGauge( GetConnectionMetrics().connections, IsConnected() ? 1 : 0 );
+        GetMetrics().Observe( GetConnectionMetrics().advanceTimeTime, yojimbo_time() - startTime );
     }
 
     int Client::GetClientIndex() const
@@ -277,6 +310,23 @@ namespace yojimbo
         m_clientId = 0;
     }
 
+    void Client::ConnectDirectLoopback( Server & server, int clientIndex )
+    {
+        yojimbo_assert( server.IsRunning() );
+        yojimbo_assert( server.IsLoopbackClient( clientIndex ) );
+        ConnectLoopback( clientIndex, server.GetClientId( clientIndex ), server.GetMaxClients() );
+        if ( !IsConnected() )
+            return;
+        DirectLoopback * directLoopback = server.CreateDirectLoopback( clientIndex, *this );
+        if ( !directLoopback )
+        {
+            yojimbo_printf( YOJIMBO_LOG_LEVEL_ERROR, "error: failed to link direct loopback client %d\n", clientIndex );
+            DisconnectLoopback();
+            return;
+        }
+        SetDirectLoopback( directLoopback );
+    }
+
     bool Client::IsLoopback() const
     {
         // Safe to query in any state: when not connected there is no netcode client, so this is
@@ -304,6 +354,7 @@ namespace yojimbo
         netcodeConfig.state_change_callback         = StaticStateChangeCallbackFunction;
         netcodeConfig.send_loopback_packet_callback = StaticSendLoopbackPacketCallbackFunction;
         m_client = netcode_client_create(addressString, &netcodeConfig, GetTime());
+        m_decryptFailures = 0;
         
         if ( m_client )
         {
@@ -336,6 +387,8 @@ namespace yojimbo
     void Client::TransmitPacketFunction( uint16_t packetSequence, uint8_t * packetData, int packetBytes )
     {
         (void) packetSequence;
+        GetMetrics().Increment( GetConnectionMetrics().packetsSent );
+        GetMetrics().Observe( GetConnectionMetrics().packetBytesSent, packetBytes );
         NetworkSimulator * networkSimulator = GetNetworkSimulator();
         if ( networkSimulator && networkSimulator->IsActive() )
         {
@@ -349,6 +402,8 @@ namespace yojimbo
 
     int Client::ProcessPacketFunction( uint16_t packetSequence, uint8_t * packetData, int packetBytes )
     {
+        if ( PacketCapture * capture = GetCapture() )
+            capture->WritePacket( CAPTURE_RECORD_PACKET_RECEIVED, 0, packetSequence, GetTime(), packetData, packetBytes );
         return (int) GetConnection().ProcessPacket( GetContext(), packetSequence, packetData, packetBytes );
     }
 
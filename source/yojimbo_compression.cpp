@@ -0,0 +1,309 @@
+/*
+    Yojimbo Client/Server Network Library.
+
+    Copyright © 2016 - 2026, Más Bandwidth LLC.
+
+    Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+        1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+        2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+           in the documentation and/or other materials provided with the distribution.
+
+        3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived
+           from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+    INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+    SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+    USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "yojimbo_compression.h"
+#include "yojimbo_platform.h"
+
+#include <string.h>
+
+namespace
+{
+    const int MinMatch = 4;
+    const int MaxOffset = 65535;
+    const int HashBits = 12;
+    const int HashSize = 1 << HashBits;
+
+    inline uint32_t Read32( const uint8_t * p )
+    {
+        uint32_t value;
+        memcpy( &value, p, 4 );
+        return value;
+    }
+
+    inline int Hash( uint32_t value )
+    {
+        return int( ( value * 2654435761U ) >> ( 32 - HashBits ) );
+    }
+
+    // Positions below zero are in the dictionary, which sits directly before the input.
+
+    struct Window
+    {
+        const uint8_t * dictionary;
+        int dictionaryBytes;
+        const uint8_t * input;
+
+        uint8_t At( int position ) const
+        {
+            return position < 0 ? dictionary[dictionaryBytes+position] : input[position];
+        }
+    };
+
+    inline uint8_t * WriteLengthExtension( uint8_t * p, int length )
+    {
+        length -= 15;
+        while ( length >= 255 )
+        {
+            *p++ = 255;
+            length -= 255;
+        }
+        *p++ = uint8_t( length );
+        return p;
+    }
+
+    bool WriteSequence( uint8_t * & p, const uint8_t * end, const uint8_t * literals, int numLiterals, int offset, int matchLength )
+    {
+        // Conservative size check, so nothing below needs to check again.
+
+        const int maxBytes = 1 + ( numLiterals / 255 + 1 ) + numLiterals + ( matchLength > 0 ? 2 + ( matchLength / 255 + 1 ) : 0 );
+
+        if ( end - p < maxBytes )
+            return false;
+
+        const int matchCode = matchLength > 0 ? matchLength - MinMatch : 0;
+
+        uint8_t * token = p++;
+        *token = uint8_t( ( ( numLiterals < 15 ? numLiterals : 15 ) << 4 ) | ( matchCode < 15 ? matchCode : 15 ) );
+
+        if ( numLiterals >= 15 )
+            p = WriteLengthExtension( p, numLiterals );
+
+        memcpy( p, literals, numLiterals );
+        p += numLiterals;
+
+        if ( matchLength == 0 )
+            return true;
+
+        *p++ = uint8_t( offset & 0xFF );
+        *p++ = uint8_t( offset >> 8 );
+
+        if ( matchCode >= 15 )
+            p = WriteLengthExtension( p, matchCode );
+
+        return true;
+    }
+
+    bool ReadLengthExtension( const uint8_t * & p, const uint8_t * end, int & length, int limit )
+    {
+        while ( true )
+        {
+            if ( p >= end )
+                return false;
+            const int value = *p++;
+            length += value;
+            if ( length > limit )
+                return false;
+            if ( value < 255 )
+                return true;
+        }
+    }
+}
+
+int yojimbo_compress_bound( int bytes )
+{
+    return bytes + bytes / 255 + 16;
+}
+
+int yojimbo_compress( const uint8_t * input, int inputBytes, uint8_t * output, int outputBytes, const uint8_t * dictionary, int dictionaryBytes )
+{
+    yojimbo_assert( input );
+    yojimbo_assert( inputBytes >= 0 );
+    yojimbo_assert( output );
+    yojimbo_assert( dictionaryBytes >= 0 );
+    yojimbo_assert( dictionary || dictionaryBytes == 0 );
+
+    if ( dictionaryBytes > MaxOffset )
+    {
+        dictionary += dictionaryBytes - MaxOffset;
+        dictionaryBytes = MaxOffset;
+    }
+
+    Window window;
+    window.dictionary = dictionary;
+    window.dictionaryBytes = dictionaryBytes;
+    window.input = input;
+
+    // The hash table holds position + dictionaryBytes + 1, so 0 means empty.
+
+    int table[HashSize];
+    memset( table, 0, sizeof( table ) );
+
+    for ( int position = -dictionaryBytes; position + MinMatch <= 0; ++position )
+    {
+        table[ Hash( Read32( dictionary + dictionaryBytes + position ) ) ] = position + dictionaryBytes + 1;
+    }
+
+    uint8_t * p = output;
+    const uint8_t * end = output + outputBytes;
+
+    int anchor = 0;
+    int position = 0;
+    int misses = 0;
+
+    while ( position + MinMatch <= inputBytes )
+    {
+        const uint32_t sequence = Read32( input + position );
+        const int hash = Hash( sequence );
+        const int candidate = table[hash] - dictionaryBytes - 1;
+        const bool valid = table[hash] != 0 && position - candidate <= MaxOffset;
+
+        table[hash] = position + dictionaryBytes + 1;
+
+        bool match = false;
+
+        if ( valid )
+        {
+            if ( candidate >= 0 )
+            {
+                match = Read32( input + candidate ) == sequence;
+            }
+            else
+            {
+                match = window.At( candidate ) == input[position] && window.At( candidate + 1 ) == input[position+1] &&
+                        window.At( candidate + 2 ) == input[position+2] && window.At( candidate + 3 ) == input[position+3];
+            }
+        }
+
+        if ( !match )
+        {
+            // Step faster through data that doesn't compress.
+            position += 1 + ( misses++ >> 6 );
+            continue;
+        }
+
+        misses = 0;
+
+        int length = MinMatch;
+        const int limit = inputBytes - position;
+
+        if ( candidate >= 0 )
+        {
+            const uint8_t * a = input + candidate;
+            const uint8_t * b = input + position;
+            while ( length < limit && a[length] == b[length] )
+                length++;
+        }
+        else
+        {
+            while ( length < limit && window.At( candidate + length ) == input[position+length] )
+                length++;
+        }
+
+        if ( !WriteSequence( p, end, input + anchor, position - anchor, position - candidate, length ) )
+            return 0;
+
+        position += length;
+        anchor = position;
+
+        if ( position - 2 >= 0 && position - 2 + MinMatch <= inputBytes )
+            table[ Hash( Read32( input + position - 2 ) ) ] = position - 2 + dictionaryBytes + 1;
+    }
+
+    if ( !WriteSequence( p, end, input + anchor, inputBytes - anchor, 0, 0 ) )
+        return 0;
+
+    return int( p - output );
+}
+
+int yojimbo_decompress( const uint8_t * input, int inputBytes, uint8_t * output, int outputBytes, const uint8_t * dictionary, int dictionaryBytes )
+{
+    yojimbo_assert( input );
+    yojimbo_assert( output );
+    yojimbo_assert( dictionaryBytes >= 0 );
+    yojimbo_assert( dictionary || dictionaryBytes == 0 );
+
+    if ( dictionaryBytes > MaxOffset )
+    {
+        dictionary += dictionaryBytes - MaxOffset;
+        dictionaryBytes = MaxOffset;
+    }
+
+    const uint8_t * p = input;
+    const uint8_t * end = input + inputBytes;
+
+    int outputPosition = 0;
+
+    while ( p < end )
+    {
+        const int token = *p++;
+
+        // literals
+
+        int numLiterals = token >> 4;
+
+        if ( numLiterals == 15 && !ReadLengthExtension( p, end, numLiterals, inputBytes ) )
+            return -1;
+
+        if ( numLiterals > end - p || numLiterals > outputBytes - outputPosition )
+            return -1;
+
+        memcpy( output + outputPosition, p, numLiterals );
+        p += numLiterals;
+        outputPosition += numLiterals;
+
+        if ( p == end )
+            break;
+
+        // match
+
+        if ( end - p < 2 )
+            return -1;
+
+        const int offset = p[0] | ( p[1] << 8 );
+        p += 2;
+
+        if ( offset == 0 || offset > outputPosition + dictionaryBytes )
+            return -1;
+
+        int length = token & 0xF;
+
+        if ( length == 15 && !ReadLengthExtension( p, end, length, outputBytes ) )
+            return -1;
+
+        length += MinMatch;
+
+        if ( length > outputBytes - outputPosition )
+            return -1;
+
+        const int source = outputPosition - offset;
+
+        if ( source >= 0 && offset >= length )
+        {
+            memcpy( output + outputPosition, output + source, length );
+            outputPosition += length;
+        }
+        else
+        {
+            // Overlapping, or starts in the dictionary.
+            for ( int i = 0; i < length; ++i )
+            {
+                const int from = source + i;
+                output[outputPosition] = from < 0 ? dictionary[dictionaryBytes+from] : output[from];
+                outputPosition++;
+            }
+        }
+    }
+
+    return outputPosition;
+}
@@ -29,85 +29,144 @@
 
 namespace yojimbo
 {
-#ifdef YOJIMBO_DEBUG
-
-    // Print what is wrong with the config (with the offending values), then assert. Debug builds
-    // only: config validation follows the library-wide contract that asserts enforce correct usage
-    // in debug and the programmer has already validated their integration before shipping release.
-    #define YOJIMBO_CONFIG_CHECK( condition, ... )                                                  \
+    // Print what is wrong with the config (with the offending values) and return false. The rules are checked in
+    // order and stop at the first failure, so later rules can divide by sizes that earlier rules checked are > 0.
+    #define YOJIMBO_CONFIG_RULE( condition, ... )                                                   \
         do                                                                                          \
         {                                                                                           \
             if ( !( condition ) )                                                                   \
             {                                                                                       \
                 yojimbo_printf( YOJIMBO_LOG_LEVEL_ERROR, __VA_ARGS__ );                             \
-                yojimbo_assert( condition );                                                        \
+                return false;                                                                       \
             }                                                                                       \
         } while ( 0 )
 
-    void ChannelConfig::Validate( int channelIndex, int maxPacketSize ) const
+    bool ChannelConfig::IsValid( int channelIndex, int maxPacketSize ) const
     {
-        YOJIMBO_CONFIG_CHECK( messageSendQueueSize > 0,
+        YOJIMBO_CONFIG_RULE( messageSendQueueSize > 0,
             "error: invalid config: channel %d messageSendQueueSize (%d) must be > 0\n", channelIndex, messageSendQueueSize );
 
-        YOJIMBO_CONFIG_CHECK( messageReceiveQueueSize > 0,
+        YOJIMBO_CONFIG_RULE( messageReceiveQueueSize > 0,
             "error: invalid config: channel %d messageReceiveQueueSize (%d) must be > 0\n", channelIndex, messageReceiveQueueSize );
 
-        YOJIMBO_CONFIG_CHECK( maxMessagesPerPacket > 0,
+        YOJIMBO_CONFIG_RULE( maxMessagesPerPacket > 0,
             "error: invalid config: channel %d maxMessagesPerPacket (%d) must be > 0\n", channelIndex, maxMessagesPerPacket );
 
         if ( !disableBlocks )
         {
-            YOJIMBO_CONFIG_CHECK( maxBlockSize > 0,
+            YOJIMBO_CONFIG_RULE( maxBlockSize > 0,
                 "error: invalid config: channel %d maxBlockSize (%d) must be > 0\n", channelIndex, maxBlockSize );
         }
 
-        if ( type == CHANNEL_TYPE_RELIABLE_ORDERED )
+        if ( type == CHANNEL_TYPE_RELIABLE_ORDERED || type == CHANNEL_TYPE_RELIABLE_UNORDERED )
         {
-            // The reliable-ordered channel stores its state in sequence buffers indexed by
+            // The reliable channels store their state in sequence buffers indexed by
             // sequence % size, which only works when the size divides 65536 (ie. a power of two).
             // Any other size aliases sequence numbers and corrupts channel state.
 
-            YOJIMBO_CONFIG_CHECK( sentPacketBufferSize > 0,
+            YOJIMBO_CONFIG_RULE( sentPacketBufferSize > 0,
                 "error: invalid config: channel %d sentPacketBufferSize (%d) must be > 0\n", channelIndex, sentPacketBufferSize );
 
-            YOJIMBO_CONFIG_CHECK( ( 65536 % sentPacketBufferSize ) == 0,
+            YOJIMBO_CONFIG_RULE( ( 65536 % sentPacketBufferSize ) == 0,
                 "error: invalid config: channel %d sentPacketBufferSize (%d) must be a power of two\n", channelIndex, sentPacketBufferSize );
 
-            YOJIMBO_CONFIG_CHECK( ( 65536 % messageSendQueueSize ) == 0,
+            YOJIMBO_CONFIG_RULE( ( 65536 % messageSendQueueSize ) == 0,
                 "error: invalid config: channel %d messageSendQueueSize (%d) must be a power of two\n", channelIndex, messageSendQueueSize );
 
-            YOJIMBO_CONFIG_CHECK( ( 65536 % messageReceiveQueueSize ) == 0,
+            YOJIMBO_CONFIG_RULE( ( 65536 % messageReceiveQueueSize ) == 0,
                 "error: invalid config: channel %d messageReceiveQueueSize (%d) must be a power of two\n", channelIndex, messageReceiveQueueSize );
 
             if ( !disableBlocks )
             {
-                YOJIMBO_CONFIG_CHECK( blockFragmentSize > 0,
+                YOJIMBO_CONFIG_RULE( blockFragmentSize > 0,
                     "error: invalid config: channel %d blockFragmentSize (%d) must be > 0\n", channelIndex, blockFragmentSize );
 
                 // A block fragment must fit inside a packet, or the channel stalls forever trying
                 // to send the block (see ReliableOrderedChannel::GetPacketData).
-                YOJIMBO_CONFIG_CHECK( blockFragmentSize <= maxPacketSize,
+                YOJIMBO_CONFIG_RULE( blockFragmentSize <= maxPacketSize,
                     "error: invalid config: channel %d blockFragmentSize (%d) must be <= maxPacketSize (%d)\n", channelIndex, blockFragmentSize, maxPacketSize );
 
-                // Fragment id 0xFFFF is reserved as a sentinel (see GetFragmentToSend).
-                YOJIMBO_CONFIG_CHECK( GetMaxFragmentsPerBlock() <= 65535,
+                // Fragment ids are stored in 16 bits when tracking which fragments went out in each packet.
+                YOJIMBO_CONFIG_RULE( ( int64_t( maxBlockSize ) + blockFragmentSize - 1 ) / blockFragmentSize <= 65535,
                     "error: invalid config: channel %d maxBlockSize (%d) / blockFragmentSize (%d) gives too many fragments per block (max 65535)\n", channelIndex, maxBlockSize, blockFragmentSize );
+
+                YOJIMBO_CONFIG_RULE( maxFragmentsPerPacket > 0,
+                    "error: invalid config: channel %d maxFragmentsPerPacket (%d) must be > 0\n", channelIndex, maxFragmentsPerPacket );
+
+                // Blocks in flight are consecutive message ids, and must all fit in the receiver's queue at once.
+                YOJIMBO_CONFIG_RULE( maxBlocksInFlight > 0 && maxBlocksInFlight <= messageReceiveQueueSize,
+                    "error: invalid config: channel %d maxBlocksInFlight (%d) must be in [1,messageReceiveQueueSize (%d)]\n", channelIndex, maxBlocksInFlight, messageReceiveQueueSize );
+
+                YOJIMBO_CONFIG_RULE( streamWindowSize >= 0,
+                    "error: invalid config: channel %d streamWindowSize (%d) must be >= 0\n", channelIndex, streamWindowSize );
+
+                YOJIMBO_CONFIG_RULE( compressionDictionaryBytes >= 0 && ( compressionDictionary || compressionDictionaryBytes == 0 ),
+                    "error: invalid config: channel %d compressionDictionaryBytes (%d) must be >= 0, and 0 when compressionDictionary is NULL\n", channelIndex, compressionDictionaryBytes );
             }
         }
+
+        if ( type == CHANNEL_TYPE_SNAPSHOT )
+        {
+            // Snapshots are indexed by snapshot id % snapshotBufferSize, and a delta names its
+            // baseline as an offset in [1,snapshotBufferSize-1] from the snapshot id.
+
+            YOJIMBO_CONFIG_RULE( snapshotBufferSize >= 2 && ( 65536 % snapshotBufferSize ) == 0,
+                "error: invalid config: channel %d snapshotBufferSize (%d) must be a power of two >= 2\n", channelIndex, snapshotBufferSize );
+
+            YOJIMBO_CONFIG_RULE( sentPacketBufferSize > 0 && ( 65536 % sentPacketBufferSize ) == 0,
+                "error: invalid config: channel %d sentPacketBufferSize (%d) must be a power of two\n", channelIndex, sentPacketBufferSize );
+
+            YOJIMBO_CONFIG_RULE( !disableBlocks,
+                "error: invalid config: channel %d is a snapshot channel, which sends snapshots as blocks, so blocks can't be disabled\n", channelIndex );
+        }
+
+        return true;
     }
 
-    void ConnectionConfig::Validate() const
+    bool ConnectionConfig::IsValid() const
     {
-        YOJIMBO_CONFIG_CHECK( numChannels >= 1 && numChannels <= MaxChannels,
+        YOJIMBO_CONFIG_RULE( numChannels >= 1 && numChannels <= MaxChannels,
             "error: invalid config: numChannels (%d) must be in [1,%d]\n", numChannels, MaxChannels );
 
-        YOJIMBO_CONFIG_CHECK( maxPacketSize > 0,
+        YOJIMBO_CONFIG_RULE( maxPacketSize > 0,
             "error: invalid config: maxPacketSize (%d) must be > 0\n", maxPacketSize );
 
         for ( int i = 0; i < numChannels; ++i )
         {
-            channel[i].Validate( i, maxPacketSize );
+            if ( !channel[i].IsValid( i, maxPacketSize ) )
+                return false;
         }
+
+        return true;
+    }
+
+#ifdef YOJIMBO_DEBUG
+
+    // Print what is wrong with the config (with the offending values), then assert. Debug builds
+    // only: config validation follows the library-wide contract that asserts enforce correct usage
+    // in debug and the programmer has already validated their integration before shipping release.
+    #define YOJIMBO_CONFIG_CHECK( condition, ... )                                                  \
+        do                                                                                          \
+        {                                                                                           \
+            if ( !( condition ) )                                                                   \
+            {                                                                                       \
+                yojimbo_printf( YOJIMBO_LOG_LEVEL_ERROR, __VA_ARGS__ );                             \
+                yojimbo_assert( condition );                                                        \
+            }                                                                                       \
+        } while ( 0 )
+
+    void ChannelConfig::Validate( int channelIndex, int maxPacketSize ) const
+    {
+        const bool valid = IsValid( channelIndex, maxPacketSize );
+        yojimbo_assert( valid );
+        (void) valid;
+    }
+
+    void ConnectionConfig::Validate() const
+    {
+        const bool valid = IsValid();
+        yojimbo_assert( valid );
+        (void) valid;
     }
 
     void ClientServerConfig::Validate() const
@@ -123,6 +182,14 @@ namespace yojimbo
         YOJIMBO_CONFIG_CHECK( serverPerClientMemory > 0,
             "error: invalid config: serverPerClientMemory (%d) must be > 0\n", serverPerClientMemory );
 
+        YOJIMBO_CONFIG_CHECK( serverWarmClientSlots >= 0,
+            "error: invalid config: serverWarmClientSlots (%d) must be >= 0\n", serverWarmClientSlots );
+        YOJIMBO_CONFIG_CHECK( serverNumaNode >= -1,
+            "error: invalid config: serverNumaNode (%d) must be -1 or a NUMA node\n", serverNumaNode );
+
+        YOJIMBO_CONFIG_CHECK( messagePoolInitialSize >= 0 && messagePoolGrowSize >= 0,
+            "error: invalid config: messagePoolInitialSize (%d) and messagePoolGrowSize (%d) must be >= 0\n", messagePoolInitialSize, messagePoolGrowSize );
+
         if ( networkSimulator )
         {
             YOJIMBO_CONFIG_CHECK( maxSimulatorPackets > 0,
@@ -158,6 +225,19 @@ namespace yojimbo
 
         YOJIMBO_CONFIG_CHECK( receivedPacketsBufferSize > 0,
             "error: invalid config: receivedPacketsBufferSize (%d) must be > 0\n", receivedPacketsBufferSize );
+
+#ifndef YOJIMBO_SYSTEM_DEPS
+        YOJIMBO_CONFIG_CHECK( ackBits == 32 || ackBits == 64 || ackBits == 128,
+            "error: invalid config: ackBits (%d) must be 32, 64 or 128\n", ackBits );
+#else // #ifndef YOJIMBO_SYSTEM_DEPS
+        // A system-installed reliable has no ack_bits setting. Its packet headers always ack 32 packets.
+        YOJIMBO_CONFIG_CHECK( ackBits == 32,
+            "error: invalid config: ackBits (%d) must be 32 when built against a system reliable (YOJIMBO_SYSTEM_DEPS)\n", ackBits );
+#endif // #ifndef YOJIMBO_SYSTEM_DEPS
+
+        // Ack bits are generated by looking back through the received packets buffer.
+        YOJIMBO_CONFIG_CHECK( receivedPacketsBufferSize >= ackBits,
+            "error: invalid config: receivedPacketsBufferSize (%d) must be >= ackBits (%d)\n", receivedPacketsBufferSize, ackBits );
     }
 
 #else // #ifdef YOJIMBO_DEBUG
@@ -1,124 +1,20 @@
 #include "yojimbo_connection.h"
 #include "yojimbo_reliable_ordered_channel.h"
 #include "yojimbo_unreliable_unordered_channel.h"
+#include "yojimbo_snapshot_channel.h"
+#include "yojimbo_trace.h"
 
 namespace yojimbo
 {
-    struct ConnectionPacket
-    {
-        int numChannelEntries;
-        ChannelPacketData * channelEntry;
-        MessageFactory * messageFactory;
-
-        ConnectionPacket()
-        {
-            messageFactory = NULL;
-            numChannelEntries = 0;
-            channelEntry = NULL;
-        }
-
-        ~ConnectionPacket()
-        {
-            if ( messageFactory )
-            {
-                for ( int i = 0; i < numChannelEntries; ++i )
-                {
-                    channelEntry[i].Free( *messageFactory );
-                }
-                YOJIMBO_FREE( messageFactory->GetAllocator(), channelEntry );
-                messageFactory = NULL;
-            }        
-        }
-
-        bool AllocateChannelData( MessageFactory & _messageFactory, int numEntries )
-        {
-            yojimbo_assert( numEntries > 0 );
-            yojimbo_assert( numEntries <= MaxChannels );
-            messageFactory = &_messageFactory;
-            Allocator & allocator = messageFactory->GetAllocator();
-            channelEntry = (ChannelPacketData*) YOJIMBO_ALLOCATE( allocator, sizeof( ChannelPacketData ) * numEntries );
-            if ( channelEntry == NULL )
-            {
-                // On the read path numChannelEntries was already set from the wire before this
-                // call; reset it so the destructor doesn't iterate a NULL channelEntry array.
-                numChannelEntries = 0;
-                return false;
-            }
-            for ( int i = 0; i < numEntries; ++i )
-            {
-                channelEntry[i].Initialize();
-            }
-            numChannelEntries = numEntries;
-            return true;
-        }
-
-        template <typename Stream> bool Serialize( Stream & stream, MessageFactory & messageFactory, const ConnectionConfig & connectionConfig )
-        {
-            const int numChannels = connectionConfig.numChannels;
-            serialize_int( stream, numChannelEntries, 0, connectionConfig.numChannels );
-#if YOJIMBO_DEBUG_MESSAGE_BUDGET
-            // Write/measure only — validates our own header-size estimate. (On read this is
-            // fixed-width and can't exceed the bound anyway, but keep it off the untrusted path.)
-            if ( !Stream::IsReading )
-                yojimbo_assert( stream.GetBitsProcessed() <= ConservativePacketHeaderBits );
-#endif // #if YOJIMBO_DEBUG_MESSAGE_BUDGET
-            if ( numChannelEntries > 0 )
-            {
-                if ( Stream::IsReading )
-                {
-                    if ( !AllocateChannelData( messageFactory, numChannelEntries ) )
-                    {
-                        yojimbo_printf( YOJIMBO_LOG_LEVEL_ERROR, "error: failed to allocate channel data (ConnectionPacket)\n" );
-                        return false;
-                    }
-                    for ( int i = 0; i < numChannelEntries; ++i )
-                    {
-                        yojimbo_assert( channelEntry[i].messageFailedToSerialize == 0 );
-                    }
-                }
-                for ( int i = 0; i < numChannelEntries; ++i )
-                {
-                    yojimbo_assert( channelEntry[i].messageFailedToSerialize == 0 );
-                    if ( !channelEntry[i].SerializeInternal( stream, messageFactory, connectionConfig.channel, numChannels ) )
-                    {
-                        yojimbo_printf( YOJIMBO_LOG_LEVEL_ERROR, "error: failed to serialize channel %d\n", i );
-                        return false;
-                    }
-                }
-            }
-            return true;
-        }
-
-        bool SerializeInternal( ReadStream & stream, MessageFactory & _messageFactory, const ConnectionConfig & connectionConfig )
-        {
-            return Serialize( stream, _messageFactory, connectionConfig );
-        }
-
-        bool SerializeInternal( WriteStream & stream, MessageFactory & _messageFactory, const ConnectionConfig & connectionConfig )
-        {
-            return Serialize( stream, _messageFactory, connectionConfig );            
-        }
-
-        bool SerializeInternal( MeasureStream & stream, MessageFactory & _messageFactory, const ConnectionConfig & connectionConfig )
-        {
-            return Serialize( stream, _messageFactory, connectionConfig );            
-        }
-
-    private:
-
-        ConnectionPacket( const ConnectionPacket & other );
-
-        const ConnectionPacket & operator = ( const ConnectionPacket & other );
-    };
-
-    // ------------------------------------------------------------------------------
-
     Connection::Connection( Allocator & allocator, MessageFactory & messageFactory, const ConnectionConfig & connectionConfig, double time ) 
         : m_connectionConfig( connectionConfig )
     {
         m_allocator = &allocator;
         m_messageFactory = &messageFactory;
         m_errorLevel = CONNECTION_ERROR_NONE;
+        m_metrics = NULL;
+        m_channelBitsMetric = -1;
+        m_messagesMetric = -1;
         memset( m_channel, 0, sizeof( m_channel ) );
         yojimbo_assert( m_connectionConfig.numChannels >= 1 );
         yojimbo_assert( m_connectionConfig.numChannels <= MaxChannels );
@@ -127,6 +23,7 @@ namespace yojimbo
             switch ( m_connectionConfig.channel[channelIndex].type )
             {
                 case CHANNEL_TYPE_RELIABLE_ORDERED: 
+                case CHANNEL_TYPE_RELIABLE_UNORDERED: 
                 {
                     m_channel[channelIndex] = YOJIMBO_NEW( *m_allocator, 
                                                            ReliableOrderedChannel, 
@@ -152,6 +49,19 @@ namespace yojimbo
                 }
                 break;
 
+                case CHANNEL_TYPE_SNAPSHOT: 
+                {
+                    m_channel[channelIndex] = YOJIMBO_NEW( *m_allocator, 
+                                                           SnapshotChannel, 
+                                                           *m_allocator, 
+                                                           messageFactory, 
+                                                           m_connectionConfig.channel[channelIndex],
+                                                           m_connectionConfig.maxPacketSize,
+                                                           channelIndex, 
+                                                           time ); 
+                }
+                break;
+
                 default: 
                     yojimbo_assert( !"unknown channel type" );
             }
@@ -191,6 +101,23 @@ namespace yojimbo
         return m_channel[channelIndex]->HasMessagesToSend();
     }
 
+    int Connection::GetSendQueueDepth() const
+    {
+        int depth = 0;
+        for ( int i = 0; i < m_connectionConfig.numChannels; ++i )
+        {
+            depth += m_channel[i]->GetSendQueueDepth();
+        }
+        return depth;
+    }
+
+    void Connection::SetMetrics( MetricsRegistry * metrics, int channelBitsMetric, int messagesMetric )
+    {
+        m_metrics = metrics;
+        m_channelBitsMetric = channelBitsMetric;
+        m_messagesMetric = messagesMetric;
+    }
+
     void Connection::SendMessage( int channelIndex, Message * message, void *context)
     {
         yojimbo_assert( channelIndex >= 0 );
@@ -211,33 +138,90 @@ namespace yojimbo
         m_messageFactory->ReleaseMessage( message );
     }
 
-    static int WritePacket( void * context, 
-                            MessageFactory & messageFactory, 
-                            const ConnectionConfig & connectionConfig, 
-                            ConnectionPacket & packet, 
-                            uint8_t * buffer, 
-                            int bufferSize )
+    void Connection::SetBlockStreamWriteFunction( int channelIndex, BlockStreamWriteFunction function, void * context )
     {
-        WriteStream stream( buffer, bufferSize );
+        yojimbo_assert( channelIndex >= 0 );
+        yojimbo_assert( channelIndex < m_connectionConfig.numChannels );
+
+        const ChannelType type = m_connectionConfig.channel[channelIndex].type;
+
+        yojimbo_assert( type == CHANNEL_TYPE_RELIABLE_ORDERED || type == CHANNEL_TYPE_RELIABLE_UNORDERED );
+        yojimbo_assert( m_connectionConfig.channel[channelIndex].streamWindowSize > 0 );
+
+        if ( type == CHANNEL_TYPE_RELIABLE_ORDERED || type == CHANNEL_TYPE_RELIABLE_UNORDERED )
+        {
+            ( (ReliableOrderedChannel*) m_channel[channelIndex] )->SetBlockStreamWriteFunction( function, context );
+        }
+    }
+
+    bool GenerateConnectionPacket( void * context,
+                                   MessageFactory & messageFactory,
+                                   const ConnectionConfig & connectionConfig,
+                                   ChannelPacketData * channelData,
+                                   const bool * channelHasData,
+                                   int numChannels,
+                                   int numChannelsWithData,
+                                   uint8_t * packetData,
+                                   int maxPacketBytes,
+                                   int & packetBytes )
+    {
+        yojimbo_assert( ( maxPacketBytes % 8 ) == 0 );
+
+        ConnectionPacket packet;
+
+        if ( numChannelsWithData > 0 )
+        {
+            if ( !packet.AllocateChannelData( messageFactory, numChannelsWithData ) )
+            {
+                yojimbo_printf( YOJIMBO_LOG_LEVEL_ERROR, "error: failed to allocate channel data\n" );
+                // GetPacketData already populated channelData for each channel with data
+                // (acquired message references, allocated message-pointer arrays, copied
+                // fragment data). Ownership hasn't transferred to the packet yet, so free
+                // those entries here or they leak on this error path.
+                for ( int channelIndex = 0; channelIndex < numChannels; ++channelIndex )
+                {
+                    if ( channelHasData[channelIndex] )
+                        channelData[channelIndex].Free( messageFactory );
+                }
+                return false;
+            }
+
+            int index = 0;
+
+            for ( int channelIndex = 0; channelIndex < numChannels; ++channelIndex )
+            {
+                if ( channelHasData[channelIndex] )
+                {
+                    memcpy( &packet.channelEntry[index], &channelData[channelIndex], sizeof( ChannelPacketData ) );
+                    index++;
+                }
+            }
+        }
+
+        WriteStream stream( packetData, maxPacketBytes );
         
         stream.SetContext( context );
 
         stream.SetAllocator( &messageFactory.GetAllocator() );
         
+        packetBytes = 0;
+
         if ( !packet.SerializeInternal( stream, messageFactory, connectionConfig ) )
         {
             yojimbo_printf( YOJIMBO_LOG_LEVEL_ERROR, "error: serialize connection packet failed (write packet)\n" );
-            return 0;
+            return true;
         }
 
         stream.Flush();
 
-        return stream.GetBytesProcessed();
+        packetBytes = stream.GetBytesProcessed();
+
+        return true;
     }
 
     bool Connection::GeneratePacket( void * context, uint16_t packetSequence, uint8_t * packetData, int maxPacketBytes, int & packetBytes )
     {
-        ConnectionPacket packet;
+        YOJIMBO_TRACE_SCOPE( "Connection::GeneratePacket" );
 
         // The serialize BitWriter stores qwords, so its buffer size must be a multiple of 8
         // bytes (it may flush a full final qword past the written data). Round the write size
@@ -247,73 +231,47 @@ namespace yojimbo
         // same rounded size so what we pack always fits what we write.
         maxPacketBytes &= ~7;
 
-        if ( m_connectionConfig.numChannels > 0 )
-        {
-            int numChannelsWithData = 0;
-            bool channelHasData[MaxChannels];
-            memset( channelHasData, 0, sizeof( channelHasData ) );
-            ChannelPacketData channelData[MaxChannels];
-
-            int availableBits = maxPacketBytes * 8 - ConservativePacketHeaderBits;
-            
-            for ( int channelIndex = 0; channelIndex < m_connectionConfig.numChannels; ++channelIndex )
-            {
-                int packetDataBits = m_channel[channelIndex]->GetPacketData( context, channelData[channelIndex], packetSequence, availableBits );
-                if ( packetDataBits > 0 )
-                {
-                    availableBits -= ConservativeChannelHeaderBits;
-                    availableBits -= packetDataBits;
-                    channelHasData[channelIndex] = true;
-                    numChannelsWithData++;
-                }
-            }
-
-            if ( numChannelsWithData > 0 )
-            {
-                if ( !packet.AllocateChannelData( *m_messageFactory, numChannelsWithData ) )
-                {
-                    yojimbo_printf( YOJIMBO_LOG_LEVEL_ERROR, "error: failed to allocate channel data\n" );
-                    // GetPacketData already populated channelData for each channel with data
-                    // (acquired message references, allocated message-pointer arrays, copied
-                    // fragment data). Ownership hasn't transferred to the packet yet, so free
-                    // those entries here or they leak on this error path.
-                    for ( int channelIndex = 0; channelIndex < m_connectionConfig.numChannels; ++channelIndex )
-                    {
-                        if ( channelHasData[channelIndex] )
-                            channelData[channelIndex].Free( *m_messageFactory );
-                    }
-                    return false;
-                }
+        int numChannelsWithData = 0;
+        bool channelHasData[MaxChannels];
+        memset( channelHasData, 0, sizeof( channelHasData ) );
+        ChannelPacketData channelData[MaxChannels];
 
-                int index = 0;
+        int availableBits = maxPacketBytes * 8 - ConservativePacketHeaderBits;
 
-                for ( int channelIndex = 0; channelIndex < m_connectionConfig.numChannels; ++channelIndex )
-                {
-                    if ( channelHasData[channelIndex] )
-                    {
-                        memcpy( &packet.channelEntry[index], &channelData[channelIndex], sizeof( ChannelPacketData ) );
-                        index++;
-                    }
-                }
+        int numMessages = 0;
+        
+        for ( int channelIndex = 0; channelIndex < m_connectionConfig.numChannels; ++channelIndex )
+        {
+            int packetDataBits = m_channel[channelIndex]->GetPacketData( context, channelData[channelIndex], packetSequence, availableBits );
+            if ( packetDataBits > 0 )
+            {
+                availableBits -= ConservativeChannelHeaderBits;
+                availableBits -= packetDataBits;
+                channelHasData[channelIndex] = true;
+                numChannelsWithData++;
+                numMessages += channelData[channelIndex].message.numMessages;
+                if ( m_metrics )
+                    m_metrics->Observe( m_channelBitsMetric, packetDataBits );
             }
         }
 
-        packetBytes = WritePacket( context, *m_messageFactory, m_connectionConfig, packet, packetData, maxPacketBytes );
+        if ( m_metrics )
+            m_metrics->Observe( m_messagesMetric, numMessages );
 
-        return true;
+        return GenerateConnectionPacket( context, *m_messageFactory, m_connectionConfig, channelData, channelHasData, m_connectionConfig.numChannels, numChannelsWithData, packetData, maxPacketBytes, packetBytes );
     }
 
-    static bool ReadPacket( void * context, 
-                            MessageFactory & messageFactory, 
-                            const ConnectionConfig & connectionConfig, 
-                            ConnectionPacket & packet, 
-                            const uint8_t * buffer, 
-                            int bufferSize )
+    bool ReadConnectionPacket( void * context, 
+                               MessageFactory & messageFactory, 
+                               const ConnectionConfig & connectionConfig, 
+                               ConnectionPacket & packet, 
+                               const uint8_t * packetData, 
+                               int packetBytes )
     {
-        yojimbo_assert( buffer );
-        yojimbo_assert( bufferSize > 0 );
+        yojimbo_assert( packetData );
+        yojimbo_assert( packetBytes > 0 );
 
-        ReadStream stream( buffer, bufferSize );
+        ReadStream stream( packetData, packetBytes );
         
         stream.SetContext( context );
 
@@ -330,6 +288,8 @@ namespace yojimbo
 
     bool Connection::ProcessPacket( void * context, uint16_t packetSequence, const uint8_t * packetData, int packetBytes )
     {
+        YOJIMBO_TRACE_SCOPE( "Connection::ProcessPacket" );
+
         if ( m_errorLevel != CONNECTION_ERROR_NONE )
         {
             yojimbo_printf( YOJIMBO_LOG_LEVEL_DEBUG, "failed to read packet because connection is in error state\n" );
@@ -347,7 +307,7 @@ namespace yojimbo
 
         ConnectionPacket packet;
 
-        if ( !ReadPacket( context, *m_messageFactory, m_connectionConfig, packet, packetData, packetBytes ) )
+        if ( !ReadConnectionPacket( context, *m_messageFactory, m_connectionConfig, packet, packetData, packetBytes ) )
         {
             yojimbo_printf( YOJIMBO_LOG_LEVEL_ERROR, "error: failed to read packet\n" );
             m_errorLevel = CONNECTION_ERROR_READ_PACKET_FAILED;
@@ -379,12 +339,12 @@ namespace yojimbo
 
     void Connection::ProcessAcks( const uint16_t * acks, int numAcks )
     {
-        for ( int i = 0; i < numAcks; ++i )
+        if ( numAcks == 0 )
+            return;
+
+        for ( int channelIndex = 0; channelIndex < m_connectionConfig.numChannels; ++channelIndex )
         {
-            for ( int channelIndex = 0; channelIndex < m_connectionConfig.numChannels; ++channelIndex )
-            {
-                m_channel[channelIndex]->ProcessAck( acks[i] );
-            }
+            m_channel[channelIndex]->ProcessAcks( acks, numAcks );
         }
     }
 
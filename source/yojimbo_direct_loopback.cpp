@@ -0,0 +1,121 @@
+#include "yojimbo_direct_loopback.h"
+#include <string.h>
+
+namespace yojimbo
+{
+    DirectLoopback::DirectLoopback( Allocator & allocator, MessageFactory & messageFactory, const ConnectionConfig & connectionConfig )
+    {
+        yojimbo_assert( connectionConfig.numChannels >= 1 );
+        yojimbo_assert( connectionConfig.numChannels <= MaxChannels );
+        m_allocator = &allocator;
+        m_messageFactory = &messageFactory;
+        m_client = NULL;
+        m_connected = true;
+        m_numChannels = connectionConfig.numChannels;
+        m_valid = true;
+        memset( m_messageId, 0, sizeof( m_messageId ) );
+        memset( m_queue, 0, sizeof( m_queue ) );
+        for ( int i = 0; i < m_numChannels; ++i )
+        {
+            m_channelType[i] = connectionConfig.channel[i].type;
+            for ( int j = 0; j < DIRECT_LOOPBACK_NUM_DIRECTIONS; ++j )
+            {
+                m_queue[j][i] = YOJIMBO_NEW( allocator, Queue<Message*>, allocator, connectionConfig.channel[i].messageSendQueueSize );
+                if ( !m_queue[j][i] )
+                    m_valid = false;
+            }
+        }
+    }
+
+    DirectLoopback::~DirectLoopback()
+    {
+        yojimbo_assert( m_client == NULL );
+        ReleaseQueuedMessages();
+        for ( int i = 0; i < m_numChannels; ++i )
+        {
+            for ( int j = 0; j < DIRECT_LOOPBACK_NUM_DIRECTIONS; ++j )
+            {
+                YOJIMBO_DELETE( *m_allocator, Queue<Message*>, m_queue[j][i] );
+            }
+        }
+    }
+
+    void DirectLoopback::Disconnect()
+    {
+        m_connected = false;
+        ReleaseQueuedMessages();
+    }
+
+    void DirectLoopback::ReleaseQueuedMessages()
+    {
+        for ( int i = 0; i < m_numChannels; ++i )
+        {
+            for ( int j = 0; j < DIRECT_LOOPBACK_NUM_DIRECTIONS; ++j )
+            {
+                Queue<Message*> * queue = m_queue[j][i];
+                if ( !queue )
+                    continue;
+                while ( !queue->IsEmpty() )
+                    m_messageFactory->ReleaseMessage( queue->Pop() );
+            }
+        }
+    }
+
+    bool DirectLoopback::CanSendMessage( DirectLoopbackDirection direction, int channelIndex ) const
+    {
+        yojimbo_assert( channelIndex >= 0 );
+        yojimbo_assert( channelIndex < m_numChannels );
+        yojimbo_assert( m_queue[direction][channelIndex] );
+        // A snapshot replaces the one still queued, so there is always room
+        return m_channelType[channelIndex] == CHANNEL_TYPE_SNAPSHOT || !m_queue[direction][channelIndex]->IsFull();
+    }
+
+    bool DirectLoopback::HasMessagesToSend( DirectLoopbackDirection direction, int channelIndex ) const
+    {
+        yojimbo_assert( channelIndex >= 0 );
+        yojimbo_assert( channelIndex < m_numChannels );
+        yojimbo_assert( m_queue[direction][channelIndex] );
+        return !m_queue[direction][channelIndex]->IsEmpty();
+    }
+
+    void DirectLoopback::SendMessage( DirectLoopbackDirection direction, int channelIndex, Message * message )
+    {
+        yojimbo_assert( channelIndex >= 0 );
+        yojimbo_assert( channelIndex < m_numChannels );
+        yojimbo_assert( message );
+
+        Queue<Message*> & queue = *m_queue[direction][channelIndex];
+
+        if ( m_channelType[channelIndex] == CHANNEL_TYPE_SNAPSHOT )
+        {
+            // Newest only, like the snapshot channel: the receiver never sees a snapshot older than one it could have had
+            while ( !queue.IsEmpty() )
+                m_messageFactory->ReleaseMessage( queue.Pop() );
+        }
+
+        yojimbo_assert( !queue.IsFull() );
+
+        if ( queue.IsFull() )
+        {
+            m_messageFactory->ReleaseMessage( message );
+            return;
+        }
+
+        message->SetId( m_messageId[direction][channelIndex]++ );
+
+        queue.Push( message );
+    }
+
+    Message * DirectLoopback::ReceiveMessage( DirectLoopbackDirection direction, int channelIndex )
+    {
+        yojimbo_assert( channelIndex >= 0 );
+        yojimbo_assert( channelIndex < m_numChannels );
+
+        Queue<Message*> & queue = *m_queue[direction][channelIndex];
+
+        if ( queue.IsEmpty() )
+            return NULL;
+
+        return queue.Pop();
+    }
+}
@@ -0,0 +1,669 @@
+#include "yojimbo_log.h"
+#include "yojimbo_platform.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+
+namespace yojimbo
+{
+    // How the argument of a conversion is read with va_arg when it is recorded, and passed to snprintf when it is flushed.
+
+    enum LogArgType
+    {
+        LOG_ARG_NONE,                                           // no argument: %% and conversions we don't know
+        LOG_ARG_INT,                                            // d i o u x X c, with no length or h/hh (promoted to int)
+        LOG_ARG_LONG,                                           // l
+        LOG_ARG_LONG_LONG,                                      // ll
+        LOG_ARG_SIZE,                                           // z
+        LOG_ARG_INTMAX,                                         // j
+        LOG_ARG_PTRDIFF,                                        // t
+        LOG_ARG_DOUBLE,                                         // e E f F g G a A
+        LOG_ARG_LONG_DOUBLE,                                    // L with a floating point conversion
+        LOG_ARG_STRING,                                         // s. The string is copied
+        LOG_ARG_POINTER,                                        // p
+        LOG_ARG_COUNT,                                          // n. Consumed when recorded, and written as nothing
+    };
+
+    struct LogConversion
+    {
+        LogArgType type;
+        bool starWidth;                                         // the width is an int argument before the value
+        bool starPrecision;                                     // the precision is an int argument before the value
+    };
+
+    // Parses the conversion that starts at the '%' at format, and returns the character after it.
+
+    static const char * ParseLogConversion( const char * format, LogConversion & conversion )
+    {
+        yojimbo_assert( *format == '%' );
+
+        const char * p = format + 1;
+
+        conversion.type = LOG_ARG_NONE;
+        conversion.starWidth = false;
+        conversion.starPrecision = false;
+
+        while ( *p && strchr( "-+ #0'", *p ) )
+            ++p;
+
+        if ( *p == '*' )
+        {
+            conversion.starWidth = true;
+            ++p;
+        }
+        else
+        {
+            while ( *p >= '0' && *p <= '9' )
+                ++p;
+        }
+
+        if ( *p == '.' )
+        {
+            ++p;
+            if ( *p == '*' )
+            {
+                conversion.starPrecision = true;
+                ++p;
+            }
+            else
+            {
+                while ( *p >= '0' && *p <= '9' )
+                    ++p;
+            }
+        }
+
+        char length = 0;
+        int lengthCount = 0;
+        while ( *p && strchr( "hlLjzt", *p ) )
+        {
+            length = *p;
+            ++lengthCount;
+            ++p;
+        }
+
+        switch ( *p )
+        {
+            case 'd': case 'i': case 'o': case 'u': case 'x': case 'X': case 'c':
+                if ( length == 'l' )
+                    conversion.type = lengthCount > 1 ? LOG_ARG_LONG_LONG : LOG_ARG_LONG;
+                else if ( length == 'z' )
+                    conversion.type = LOG_ARG_SIZE;
+                else if ( length == 'j' )
+                    conversion.type = LOG_ARG_INTMAX;
+                else if ( length == 't' )
+                    conversion.type = LOG_ARG_PTRDIFF;
+                else
+                    conversion.type = LOG_ARG_INT;
+                break;
+
+            case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A':
+                conversion.type = length == 'L' ? LOG_ARG_LONG_DOUBLE : LOG_ARG_DOUBLE;
+                break;
+
+            case 's':
+                conversion.type = LOG_ARG_STRING;
+                break;
+
+            case 'p':
+                conversion.type = LOG_ARG_POINTER;
+                break;
+
+            case 'n':
+                conversion.type = LOG_ARG_COUNT;
+                break;
+
+            case '\0':
+                // an unfinished conversion at the end of the format string
+                conversion.starWidth = false;
+                conversion.starPrecision = false;
+                return p;
+
+            default:
+                break;
+        }
+
+        return p + 1;
+    }
+
+    // Argument bytes are written with memcpy and no alignment: integers as the type va_arg read them as, strings with their terminator.
+
+    class LogArgWriter
+    {
+    public:
+
+        LogArgWriter( uint8_t * data, int bytes ) : m_data( data ), m_bytes( bytes ), m_offset( 0 ), m_truncated( false ) {}
+
+        template <typename T> void Write( T value )
+        {
+            if ( m_truncated || m_offset + (int) sizeof( T ) > m_bytes )
+            {
+                m_truncated = true;
+                return;
+            }
+            memcpy( m_data + m_offset, &value, sizeof( T ) );
+            m_offset += sizeof( T );
+        }
+
+        void WriteString( const char * string )
+        {
+            if ( !string )
+                string = "(null)";
+            if ( m_truncated || m_offset >= m_bytes )
+            {
+                m_truncated = true;
+                return;
+            }
+            int length = (int) strlen( string );
+            if ( length > m_bytes - m_offset - 1 )
+                length = m_bytes - m_offset - 1;
+            memcpy( m_data + m_offset, string, length );
+            m_data[m_offset+length] = '\0';
+            m_offset += length + 1;
+        }
+
+        int GetBytes() const { return m_offset; }
+
+    private:
+
+        uint8_t * m_data;
+        int m_bytes;
+        int m_offset;
+        bool m_truncated;
+    };
+
+    class LogArgReader
+    {
+    public:
+
+        LogArgReader( const uint8_t * data, int bytes ) : m_data( data ), m_bytes( bytes ), m_offset( 0 ) {}
+
+        template <typename T> bool Read( T & value )
+        {
+            if ( m_offset + (int) sizeof( T ) > m_bytes )
+                return false;
+            memcpy( &value, m_data + m_offset, sizeof( T ) );
+            m_offset += sizeof( T );
+            return true;
+        }
+
+        bool ReadString( const char * & string )
+        {
+            if ( m_offset >= m_bytes )
+                return false;
+            string = (const char*) m_data + m_offset;
+            m_offset += (int) strlen( string ) + 1;
+            return true;
+        }
+
+    private:
+
+        const uint8_t * m_data;
+        int m_bytes;
+        int m_offset;
+    };
+
+    // Most va_arg reads kept per message, counting * widths and precisions. Conversions past them are written as "?".
+
+    const int LogMaxArgs = 32;
+
+    // Lists the va_arg reads the format string needs, in order. Returns how many, up to LogMaxArgs.
+
+    static int ParseLogArgs( const char * format, uint8_t * argTypes )
+    {
+        int numArgs = 0;
+
+        const char * p = format;
+        while ( *p && numArgs < LogMaxArgs )
+        {
+            if ( *p != '%' )
+            {
+                ++p;
+                continue;
+            }
+
+            LogConversion conversion;
+            p = ParseLogConversion( p, conversion );
+
+            if ( conversion.starWidth && numArgs < LogMaxArgs )
+                argTypes[numArgs++] = LOG_ARG_INT;
+            if ( conversion.starPrecision && numArgs < LogMaxArgs )
+                argTypes[numArgs++] = LOG_ARG_INT;
+            if ( conversion.type != LOG_ARG_NONE && numArgs < LogMaxArgs )
+                argTypes[numArgs++] = (uint8_t) conversion.type;
+        }
+
+        return numArgs;
+    }
+
+    static int CaptureLogArgs( const uint8_t * argTypes, int numArgs, va_list args, uint8_t * data, int bytes )
+    {
+        LogArgWriter writer( data, bytes );
+
+        for ( int i = 0; i < numArgs; ++i )
+        {
+            switch ( argTypes[i] )
+            {
+                case LOG_ARG_INT:           writer.Write( va_arg( args, int ) );                    break;
+                case LOG_ARG_LONG:          writer.Write( va_arg( args, long ) );                   break;
+                case LOG_ARG_LONG_LONG:     writer.Write( va_arg( args, long long ) );              break;
+                case LOG_ARG_SIZE:          writer.Write( va_arg( args, size_t ) );                 break;
+                case LOG_ARG_INTMAX:        writer.Write( va_arg( args, intmax_t ) );               break;
+                case LOG_ARG_PTRDIFF:       writer.Write( va_arg( args, ptrdiff_t ) );              break;
+                case LOG_ARG_DOUBLE:        writer.Write( va_arg( args, double ) );                 break;
+                case LOG_ARG_LONG_DOUBLE:   writer.Write( va_arg( args, long double ) );            break;
+                case LOG_ARG_STRING:        writer.WriteString( va_arg( args, const char* ) );      break;
+                case LOG_ARG_POINTER:       writer.Write( va_arg( args, void* ) );                  break;
+                case LOG_ARG_COUNT:         (void) va_arg( args, void* );                           break;
+                default:                    break;
+            }
+        }
+
+        return writer.GetBytes();
+    }
+
+    // Appends to a fixed size text buffer, cutting off whatever doesn't fit.
+
+    class LogText
+    {
+    public:
+
+        LogText( char * text, int bytes ) : m_text( text ), m_bytes( bytes ), m_length( 0 ) { m_text[0] = '\0'; }
+
+        void Append( const char * string, int length )
+        {
+            if ( length > m_bytes - 1 - m_length )
+                length = m_bytes - 1 - m_length;
+            memcpy( m_text + m_length, string, length );
+            m_length += length;
+            m_text[m_length] = '\0';
+        }
+
+        template <typename T> void AppendFormatted( const char * spec, const int * star, int numStar, T value )
+        {
+            const int available = m_bytes - m_length;
+            int result;
+            if ( numStar == 2 )
+                result = snprintf( m_text + m_length, available, spec, star[0], star[1], value );
+            else if ( numStar == 1 )
+                result = snprintf( m_text + m_length, available, spec, star[0], value );
+            else
+                result = snprintf( m_text + m_length, available, spec, value );
+            if ( result > 0 )
+                m_length += result < available ? result : available - 1;
+        }
+
+    private:
+
+        char * m_text;
+        int m_bytes;
+        int m_length;
+    };
+
+    // Formats a recorded message. A conversion whose argument was cut off by YOJIMBO_BINARY_LOG_MESSAGE_BYTES is written as "?".
+
+    static void FormatLogMessage( const char * format, const uint8_t * data, int bytes, char * text, int textBytes )
+    {
+        LogText output( text, textBytes );
+        LogArgReader reader( data, bytes );
+
+        const char * p = format;
+        while ( *p )
+        {
+            const char * literal = p;
+            while ( *p && *p != '%' )
+                ++p;
+            output.Append( literal, (int) ( p - literal ) );
+
+            if ( !*p )
+                break;
+
+            const char * start = p;
+            LogConversion conversion;
+            p = ParseLogConversion( p, conversion );
+
+            if ( conversion.type == LOG_ARG_NONE )
+            {
+                if ( p - start == 2 && start[1] == '%' )
+                    output.Append( "%", 1 );
+                else
+                    output.Append( start, (int) ( p - start ) );
+                continue;
+            }
+
+            char spec[64];
+            const int specLength = (int) ( p - start );
+            if ( specLength >= (int) sizeof( spec ) )
+            {
+                output.Append( start, specLength );
+                continue;
+            }
+            memcpy( spec, start, specLength );
+            spec[specLength] = '\0';
+
+            int star[2];
+            int numStar = 0;
+            bool ok = true;
+            if ( conversion.starWidth )
+                ok = ok && reader.Read( star[numStar++] );
+            if ( conversion.starPrecision )
+                ok = ok && reader.Read( star[numStar++] );
+
+            switch ( conversion.type )
+            {
+                case LOG_ARG_INT:           { int value;            if ( ( ok = ok && reader.Read( value ) ) )          output.AppendFormatted( spec, star, numStar, value ); }     break;
+                case LOG_ARG_LONG:          { long value;           if ( ( ok = ok && reader.Read( value ) ) )          output.AppendFormatted( spec, star, numStar, value ); }     break;
+                case LOG_ARG_LONG_LONG:     { long long value;      if ( ( ok = ok && reader.Read( value ) ) )          output.AppendFormatted( spec, star, numStar, value ); }     break;
+                case LOG_ARG_SIZE:          { size_t value;         if ( ( ok = ok && reader.Read( value ) ) )          output.AppendFormatted( spec, star, numStar, value ); }     break;
+                case LOG_ARG_INTMAX:        { intmax_t value;       if ( ( ok = ok && reader.Read( value ) ) )          output.AppendFormatted( spec, star, numStar, value ); }     break;
+                case LOG_ARG_PTRDIFF:       { ptrdiff_t value;      if ( ( ok = ok && reader.Read( value ) ) )          output.AppendFormatted( spec, star, numStar, value ); }     break;
+                case LOG_ARG_DOUBLE:        { double value;         if ( ( ok = ok && reader.Read( value ) ) )          output.AppendFormatted( spec, star, numStar, value ); }     break;
+                case LOG_ARG_LONG_DOUBLE:   { long double value;    if ( ( ok = ok && reader.Read( value ) ) )          output.AppendFormatted( spec, star, numStar, value ); }     break;
+                case LOG_ARG_STRING:        { const char * value;   if ( ( ok = ok && reader.ReadString( value ) ) )    output.AppendFormatted( spec, star, numStar, value ); }     break;
+                case LOG_ARG_POINTER:       { void * value;         if ( ( ok = ok && reader.Read( value ) ) )          output.AppendFormatted( spec, star, numStar, value ); }     break;
+                case LOG_ARG_COUNT:         break;
+                case LOG_ARG_NONE:          break;
+            }
+
+            if ( !ok )
+                output.Append( "?", 1 );
+        }
+    }
+
+    // Each thread keeps a small table of call sites, indexed by the format string pointer, with the parsed argument list
+    // and the rate limit state. Two call sites that land in the same entry take turns owning it: each parses its format
+    // again and restarts its window when it takes it back.
+
+    const int LogCallSiteEntries = 64;
+
+    struct LogCallSite
+    {
+        const char * format;                                    // the call site that owns this entry
+        uint64_t windowStart;                                   // steady clock nanoseconds when the current window started
+        uint32_t count;                                         // messages kept in the current window
+        uint32_t suppressed;                                    // messages discarded since the last one kept
+        int numArgs;                                            // va_arg reads the format needs
+        uint8_t argTypes[LogMaxArgs];                           // LogArgType of each read, in order
+    };
+
+    struct LogMessage
+    {
+        const char * format;                                    // the format string, formatted when the message is flushed
+        uint32_t suppressed;                                    // messages from the same call site the rate limit discarded just before this one
+        uint32_t argBytes;                                      // bytes used in args
+        uint8_t args[YOJIMBO_BINARY_LOG_MESSAGE_BYTES];         // the arguments, see LogArgWriter
+    };
+
+    // A single producer, single consumer ring: the owning thread writes at head, and flushes (serialized by a mutex) read from tail.
+
+    struct LogBuffer
+    {
+        LogBuffer * next;                                       // next buffer in the global list. Buffers are never unlinked
+        std::atomic<bool> inUse;                                // true while a thread owns this buffer
+        std::atomic<uint64_t> head;                             // messages recorded. Only the owning thread writes it
+        std::atomic<uint64_t> tail;                             // messages flushed. Only a flush writes it
+        std::atomic<uint64_t> counters[YOJIMBO_BINARY_LOG_COUNTER_MESSAGES_WRITTEN];  // recorded, suppressed and dropped. Only the owning thread writes them
+        LogCallSite callSites[LogCallSiteEntries];
+        LogMessage messages[YOJIMBO_BINARY_LOG_BUFFER_MESSAGES];
+    };
+
+    static std::atomic<LogBuffer*> s_logBuffers( NULL );
+    static std::atomic<uint64_t> s_logMessagesWritten( 0 );
+    static std::atomic<uint32_t> s_logRateLimitMessages( 16 );
+    static std::atomic<uint64_t> s_logRateLimitWindow( 1000000000ULL );
+    static std::mutex s_logFlushMutex;
+
+    // Hands a thread's buffer back when the thread exits, so the next new thread reuses it instead of growing the list.
+    // Messages it recorded and nobody flushed yet stay in it, and come out with the next flush.
+
+    struct LogThread
+    {
+        LogBuffer * buffer;
+
+        ~LogThread()
+        {
+            if ( buffer )
+                buffer->inUse.store( false, std::memory_order_release );
+        }
+    };
+
+    static thread_local LogThread t_logThread = { NULL };
+
+    static LogBuffer * AcquireLogBuffer()
+    {
+        for ( LogBuffer * buffer = s_logBuffers.load( std::memory_order_acquire ); buffer; buffer = buffer->next )
+        {
+            bool expected = false;
+            if ( buffer->inUse.compare_exchange_strong( expected, true, std::memory_order_acquire ) )
+                return buffer;
+        }
+
+        // The buffer lives until the process exits: a flush may be reading it at any time.
+
+        LogBuffer * buffer = (LogBuffer*) calloc( 1, sizeof( LogBuffer ) );
+        if ( !buffer )
+            return NULL;
+        buffer->inUse.store( true, std::memory_order_relaxed );
+        LogBuffer * head = s_logBuffers.load( std::memory_order_relaxed );
+        do
+        {
+            buffer->next = head;
+        }
+        while ( !s_logBuffers.compare_exchange_weak( head, buffer, std::memory_order_release, std::memory_order_relaxed ) );
+        return buffer;
+    }
+
+    static inline void IncrementLogCounter( LogBuffer * buffer, int index )
+    {
+        buffer->counters[index].store( buffer->counters[index].load( std::memory_order_relaxed ) + 1, std::memory_order_relaxed );
+    }
+
+    static inline uint64_t LogTime()
+    {
+        return (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+    }
+
+    static void RecordLogMessage( const char * format, va_list args )
+    {
+        LogBuffer * buffer = t_logThread.buffer;
+        if ( !buffer )
+        {
+            buffer = AcquireLogBuffer();
+            if ( !buffer )
+                return;
+            t_logThread.buffer = buffer;
+        }
+
+        LogCallSite & site = buffer->callSites[( ( (uintptr_t) format ) >> 3 ) & ( LogCallSiteEntries - 1 )];
+        if ( site.format != format )
+        {
+            site.format = format;
+            site.count = 0;
+            site.suppressed = 0;
+            site.numArgs = ParseLogArgs( format, site.argTypes );
+        }
+
+        // The clock is only read at the start of a window, and once the call site has used it up,
+        // so messages under the limit cost no more than the table lookup.
+
+        uint32_t suppressed = 0;
+        const uint32_t maxMessages = s_logRateLimitMessages.load( std::memory_order_relaxed );
+        if ( maxMessages > 0 )
+        {
+            if ( site.count == 0 )
+            {
+                site.windowStart = LogTime();
+            }
+            else if ( site.count >= maxMessages )
+            {
+                const uint64_t time = LogTime();
+                if ( time - site.windowStart < s_logRateLimitWindow.load( std::memory_order_relaxed ) )
+                {
+                    site.suppressed++;
+                    IncrementLogCounter( buffer, YOJIMBO_BINARY_LOG_COUNTER_MESSAGES_SUPPRESSED );
+                    return;
+                }
+                site.windowStart = time;
+                site.count = 0;
+            }
+            site.count++;
+            suppressed = site.suppressed;
+            site.suppressed = 0;
+        }
+
+        const uint64_t head = buffer->head.load( std::memory_order_relaxed );
+        if ( head - buffer->tail.load( std::memory_order_acquire ) >= YOJIMBO_BINARY_LOG_BUFFER_MESSAGES )
+        {
+            IncrementLogCounter( buffer, YOJIMBO_BINARY_LOG_COUNTER_MESSAGES_DROPPED );
+            return;
+        }
+
+        LogMessage & message = buffer->messages[head & ( YOJIMBO_BINARY_LOG_BUFFER_MESSAGES - 1 )];
+        message.format = format;
+        message.suppressed = suppressed;
+        message.argBytes = (uint32_t) CaptureLogArgs( site.argTypes, site.numArgs, args, message.args, sizeof( message.args ) );
+        buffer->head.store( head + 1, std::memory_order_release );
+
+        IncrementLogCounter( buffer, YOJIMBO_BINARY_LOG_COUNTER_MESSAGES_RECORDED );
+    }
+
+    // The flush thread. Heap allocated, so a program that exits without stopping it isn't terminated by a joinable std::thread destructor.
+
+    static std::mutex s_logThreadMutex;
+    static std::condition_variable s_logThreadCondition;
+    static std::thread * s_logThread = NULL;
+    static bool s_logThreadStop = false;
+
+    static void LogThreadFunction( int (*function)( const char *, ... ), double interval )
+    {
+        std::unique_lock<std::mutex> lock( s_logThreadMutex );
+        while ( !s_logThreadStop )
+        {
+            lock.unlock();
+            yojimbo_binary_log_flush( function );
+            lock.lock();
+            s_logThreadCondition.wait_for( lock, std::chrono::duration<double>( interval ), [] { return s_logThreadStop; } );
+        }
+    }
+}
+
+int yojimbo_binary_log_printf( const char * format, ... )
+{
+    yojimbo_assert( format );
+    va_list args;
+    va_start( args, format );
+    yojimbo::RecordLogMessage( format, args );
+    va_end( args );
+    return 0;
+}
+
+void yojimbo_binary_log_vprintf( const char * format, va_list args )
+{
+    yojimbo_assert( format );
+    yojimbo::RecordLogMessage( format, args );
+}
+
+int yojimbo_binary_log_flush( int (*function)( const char *, ... ) )
+{
+    using namespace yojimbo;
+
+    if ( !function )
+        function = printf;
+
+    yojimbo_assert( function != yojimbo_binary_log_printf );
+
+    std::lock_guard<std::mutex> lock( s_logFlushMutex );
+
+    int numMessages = 0;
+
+    char text[4*1024];
+
+    for ( LogBuffer * buffer = s_logBuffers.load( std::memory_order_acquire ); buffer; buffer = buffer->next )
+    {
+        const uint64_t head = buffer->head.load( std::memory_order_acquire );
+        uint64_t tail = buffer->tail.load( std::memory_order_relaxed );
+        for ( ; tail != head; ++tail )
+        {
+            const LogMessage & message = buffer->messages[tail & ( YOJIMBO_BINARY_LOG_BUFFER_MESSAGES - 1 )];
+            if ( message.suppressed )
+                function( "(%u similar messages suppressed)\n", message.suppressed );
+            FormatLogMessage( message.format, message.args, message.argBytes, text, sizeof( text ) );
+            function( "%s", text );
+            ++numMessages;
+        }
+        buffer->tail.store( tail, std::memory_order_release );
+    }
+
+    s_logMessagesWritten.fetch_add( numMessages, std::memory_order_relaxed );
+
+    return numMessages;
+}
+
+bool yojimbo_binary_log_start_thread( int (*function)( const char *, ... ), double interval )
+{
+    using namespace yojimbo;
+
+    yojimbo_assert( function != yojimbo_binary_log_printf );
+    yojimbo_assert( interval >= 0.0 );
+
+    std::lock_guard<std::mutex> lock( s_logThreadMutex );
+
+    if ( s_logThread )
+        return false;
+
+    s_logThreadStop = false;
+    s_logThread = new ( std::nothrow ) std::thread( LogThreadFunction, function, interval );
+
+    return s_logThread != NULL;
+}
+
+void yojimbo_binary_log_stop_thread()
+{
+    using namespace yojimbo;
+
+    std::thread * thread;
+    {
+        std::lock_guard<std::mutex> lock( s_logThreadMutex );
+        thread = s_logThread;
+        s_logThread = NULL;
+        s_logThreadStop = true;
+    }
+
+    if ( !thread )
+        return;
+
+    s_logThreadCondition.notify_all();
+    thread->join();
+    delete thread;
+}
+
+void yojimbo_binary_log_rate_limit( int maxMessages, double seconds )
+{
+    using namespace yojimbo;
+    yojimbo_assert( maxMessages >= 0 );
+    yojimbo_assert( seconds >= 0.0 );
+    s_logRateLimitWindow.store( (uint64_t) ( seconds * 1000000000.0 ), std::memory_order_relaxed );
+    s_logRateLimitMessages.store( (uint32_t) maxMessages, std::memory_order_relaxed );
+}
+
+uint64_t yojimbo_binary_log_counter( int index )
+{
+    using namespace yojimbo;
+
+    yojimbo_assert( index >= 0 );
+    yojimbo_assert( index < YOJIMBO_BINARY_LOG_NUM_COUNTERS );
+
+    if ( index == YOJIMBO_BINARY_LOG_COUNTER_MESSAGES_WRITTEN )
+        return s_logMessagesWritten.load( std::memory_order_relaxed );
+
+    uint64_t value = 0;
+    for ( LogBuffer * buffer = s_logBuffers.load( std::memory_order_acquire ); buffer; buffer = buffer->next )
+        value += buffer->counters[index].load( std::memory_order_relaxed );
+    return value;
+}
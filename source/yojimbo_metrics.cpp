@@ -0,0 +1,341 @@
+#include "yojimbo_metrics.h"
+#include "yojimbo_allocator.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+namespace yojimbo
+{
+    MetricsRegistry::MetricsRegistry()
+    {
+        m_numMetrics = 0;
+        memset( m_metric, 0, sizeof( m_metric ) );
+    }
+
+    int MetricsRegistry::AddMetric( const char * name, const char * help, MetricType type )
+    {
+        yojimbo_assert( name );
+        yojimbo_assert( help );
+        if ( m_numMetrics == MaxMetrics )
+        {
+            yojimbo_printf( YOJIMBO_LOG_LEVEL_ERROR, "error: metrics registry is full. can't add metric %s\n", name );
+            return -1;
+        }
+        if ( FindMetric( name ) != -1 )
+        {
+            yojimbo_printf( YOJIMBO_LOG_LEVEL_ERROR, "error: metric %s already exists\n", name );
+            return -1;
+        }
+        Metric & metric = m_metric[m_numMetrics];
+        memset( &metric, 0, sizeof( Metric ) );
+        metric.name = name;
+        metric.help = help;
+        metric.type = type;
+        return m_numMetrics++;
+    }
+
+    int MetricsRegistry::AddCounter( const char * name, const char * help )
+    {
+        return AddMetric( name, help, METRIC_TYPE_COUNTER );
+    }
+
+    int MetricsRegistry::AddGauge( const char * name, const char * help )
+    {
+        return AddMetric( name, help, METRIC_TYPE_GAUGE );
+    }
+
+    int MetricsRegistry::AddHistogram( const char * name, const char * help, const double * bounds, int numBounds )
+    {
+        yojimbo_assert( bounds );
+        yojimbo_assert( numBounds >= 1 );
+        yojimbo_assert( numBounds <= MaxMetricBuckets );
+        for ( int i = 1; i < numBounds; ++i )
+        {
+            yojimbo_assert( bounds[i] > bounds[i-1] );
+        }
+        const int index = AddMetric( name, help, METRIC_TYPE_HISTOGRAM );
+        if ( index == -1 )
+            return -1;
+        m_metric[index].numBounds = numBounds;
+        memcpy( m_metric[index].bound, bounds, sizeof( double ) * numBounds );
+        return index;
+    }
+
+    int MetricsRegistry::FindMetric( const char * name ) const
+    {
+        yojimbo_assert( name );
+        for ( int i = 0; i < m_numMetrics; ++i )
+        {
+            if ( strcmp( m_metric[i].name, name ) == 0 )
+                return i;
+        }
+        return -1;
+    }
+
+    void MetricsRegistry::GetSnapshot( MetricsSnapshot & snapshot ) const
+    {
+        snapshot.time = yojimbo_time();
+        snapshot.numMetrics = m_numMetrics;
+        memcpy( snapshot.metric, m_metric, sizeof( Metric ) * m_numMetrics );
+    }
+
+    void MetricsRegistry::Reset()
+    {
+        for ( int i = 0; i < m_numMetrics; ++i )
+        {
+            m_metric[i].count = 0;
+            m_metric[i].value = 0.0;
+            memset( m_metric[i].bucket, 0, sizeof( m_metric[i].bucket ) );
+        }
+    }
+
+    void RegisterConnectionMetrics( MetricsRegistry & registry, ConnectionMetrics & metrics )
+    {
+        static const double PacketBytesBounds[] = { 32, 64, 128, 256, 512, 768, 1024, 1200, 1500, 2048, 4096, 8192 };
+        static const double ChannelBitsBounds[] = { 64, 128, 256, 512, 1024, 2048, 4096, 8192, 16384, 32768, 65536 };
+        static const double MessagesBounds[] = { 0, 1, 2, 4, 8, 16, 32, 64, 128, 256 };
+        static const double QueueDepthBounds[] = { 0, 1, 4, 16, 64, 256, 1024, 4096 };
+        static const double SecondsBounds[] = { 0.00001, 0.000025, 0.00005, 0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1 };
+
+        const int numPacketBytesBounds = sizeof( PacketBytesBounds ) / sizeof( double );
+        const int numChannelBitsBounds = sizeof( ChannelBitsBounds ) / sizeof( double );
+        const int numMessagesBounds = sizeof( MessagesBounds ) / sizeof( double );
+        const int numQueueDepthBounds = sizeof( QueueDepthBounds ) / sizeof( double );
+        const int numSecondsBounds = sizeof( SecondsBounds ) / sizeof( double );
+
+        metrics.packetsSent = registry.AddCounter( "yojimbo_packets_sent_total", "Packets sent." );
+        metrics.packetsReceived = registry.AddCounter( "yojimbo_packets_received_total", "Packets received." );
+        metrics.decryptFailures = registry.AddCounter( "yojimbo_decrypt_failures_total", "Packets dropped because they failed to decrypt." );
+        metrics.packetBytesSent = registry.AddHistogram( "yojimbo_packet_bytes_sent", "Size of each packet sent in bytes.", PacketBytesBounds, numPacketBytesBounds );
+        metrics.packetBytesReceived = registry.AddHistogram( "yojimbo_packet_bytes_received", "Size of each packet received in bytes.", PacketBytesBounds, numPacketBytesBounds );
+        metrics.channelBitsPerPacket = registry.AddHistogram( "yojimbo_channel_bits_per_packet", "Bits each channel with data wrote into a connection packet.", ChannelBitsBounds, numChannelBitsBounds );
+        metrics.messagesPerPacket = registry.AddHistogram( "yojimbo_messages_per_packet", "Messages in each connection packet sent.", MessagesBounds, numMessagesBounds );
+        metrics.sendQueueDepth = registry.AddHistogram( "yojimbo_send_queue_depth", "Messages waiting in a connection's send queues after each send.", QueueDepthBounds, numQueueDepthBounds );
+        metrics.sendQueueMessages = registry.AddGauge( "yojimbo_send_queue_messages", "Messages waiting in all send queues after the last send." );
+        metrics.connections = registry.AddGauge( "yojimbo_connections", "Connected connections." );
+        metrics.receivePacketsTime = registry.AddHistogram( "yojimbo_receive_packets_seconds", "Time spent receiving packets each update.", SecondsBounds, numSecondsBounds );
+        metrics.sendPacketsTime = registry.AddHistogram( "yojimbo_send_packets_seconds", "Time spent sending packets each update.", SecondsBounds, numSecondsBounds );
+        metrics.advanceTimeTime = registry.AddHistogram( "yojimbo_advance_time_seconds", "Time spent advancing time each update.", SecondsBounds, numSecondsBounds );
+    }
+
+    /// Appends formatted text to a buffer, snprintf style: counts the full length even once the buffer is full.
+
+    struct MetricsWriter
+    {
+        char * buffer;
+        int bufferSize;
+        int length;
+
+        void Write( const char * format, ... )
+        {
+            char * p = NULL;
+            int available = 0;
+            if ( length < bufferSize )
+            {
+                p = buffer + length;
+                available = bufferSize - length;
+            }
+            va_list args;
+            va_start( args, format );
+            const int result = vsnprintf( p, available, format, args );
+            va_end( args );
+            if ( result > 0 )
+                length += result;
+        }
+
+        void WriteEscaped( const char * string, bool json )
+        {
+            // prometheus help text escapes backslash and newline. json also escapes quotes and control characters
+            for ( const char * c = string; *c; ++c )
+            {
+                if ( *c == '\\' )
+                    Write( "\\\\" );
+                else if ( *c == '\n' )
+                    Write( "\\n" );
+                else if ( json && *c == '"' )
+                    Write( "\\\"" );
+                else if ( json && (unsigned char) *c < 0x20 )
+                    Write( "\\u%04x", (unsigned char) *c );
+                else
+                    Write( "%c", *c );
+            }
+        }
+    };
+
+    static const char * GetMetricTypeString( MetricType type )
+    {
+        switch ( type )
+        {
+            case METRIC_TYPE_COUNTER:       return "counter";
+            case METRIC_TYPE_GAUGE:         return "gauge";
+            case METRIC_TYPE_HISTOGRAM:     return "histogram";
+            default:
+                yojimbo_assert( false );
+                return "untyped";
+        }
+    }
+
+    static void WriteMetricsPrometheus( MetricsWriter & writer, const MetricsSnapshot & snapshot )
+    {
+        for ( int i = 0; i < snapshot.numMetrics; ++i )
+        {
+            const Metric & metric = snapshot.metric[i];
+            writer.Write( "# HELP %s ", metric.name );
+            writer.WriteEscaped( metric.help, false );
+            writer.Write( "\n# TYPE %s %s\n", metric.name, GetMetricTypeString( metric.type ) );
+            switch ( metric.type )
+            {
+                case METRIC_TYPE_COUNTER:
+                    writer.Write( "%s %llu\n", metric.name, (unsigned long long) metric.count );
+                    break;
+
+                case METRIC_TYPE_GAUGE:
+                    writer.Write( "%s %.17g\n", metric.name, metric.value );
+                    break;
+
+                case METRIC_TYPE_HISTOGRAM:
+                {
+                    // prometheus buckets are cumulative
+                    uint64_t cumulative = 0;
+                    for ( int j = 0; j < metric.numBounds; ++j )
+                    {
+                        cumulative += metric.bucket[j];
+                        writer.Write( "%s_bucket{le=\"%.17g\"} %llu\n", metric.name, metric.bound[j], (unsigned long long) cumulative );
+                    }
+                    writer.Write( "%s_bucket{le=\"+Inf\"} %llu\n", metric.name, (unsigned long long) metric.count );
+                    writer.Write( "%s_sum %.17g\n", metric.name, metric.value );
+                    writer.Write( "%s_count %llu\n", metric.name, (unsigned long long) metric.count );
+                }
+                break;
+            }
+        }
+    }
+
+    static void WriteMetricsJSON( MetricsWriter & writer, const MetricsSnapshot & snapshot )
+    {
+        writer.Write( "{\"time\":%.17g,\"metrics\":[", snapshot.time );
+        for ( int i = 0; i < snapshot.numMetrics; ++i )
+        {
+            const Metric & metric = snapshot.metric[i];
+            writer.Write( "%s{\"name\":\"", i > 0 ? "," : "" );
+            writer.WriteEscaped( metric.name, true );
+            writer.Write( "\",\"help\":\"" );
+            writer.WriteEscaped( metric.help, true );
+            writer.Write( "\",\"type\":\"%s\"", GetMetricTypeString( metric.type ) );
+            switch ( metric.type )
+            {
+                case METRIC_TYPE_COUNTER:
+                    writer.Write( ",\"value\":%llu}", (unsigned long long) metric.count );
+                    break;
+
+                case METRIC_TYPE_GAUGE:
+                    writer.Write( ",\"value\":%.17g}", metric.value );
+                    break;
+
+                case METRIC_TYPE_HISTOGRAM:
+                {
+                    // buckets match the prometheus export, so both read the same way
+                    writer.Write( ",\"count\":%llu,\"sum\":%.17g,\"buckets\":[", (unsigned long long) metric.count, metric.value );
+                    uint64_t cumulative = 0;
+                    for ( int j = 0; j < metric.numBounds; ++j )
+                    {
+                        cumulative += metric.bucket[j];
+                        writer.Write( "%s{\"le\":%.17g,\"count\":%llu}", j > 0 ? "," : "", metric.bound[j], (unsigned long long) cumulative );
+                    }
+                    writer.Write( ",{\"le\":\"+Inf\",\"count\":%llu}]}", (unsigned long long) metric.count );
+                }
+                break;
+            }
+        }
+        writer.Write( "]}\n" );
+    }
+
+    int WriteMetrics( const MetricsSnapshot & snapshot, MetricsFormat format, char * buffer, int bufferSize )
+    {
+        yojimbo_assert( buffer || bufferSize == 0 );
+        yojimbo_assert( bufferSize >= 0 );
+        MetricsWriter writer;
+        writer.buffer = buffer;
+        writer.bufferSize = bufferSize;
+        writer.length = 0;
+        if ( bufferSize > 0 )
+            buffer[0] = '\0';
+        if ( format == METRICS_FORMAT_JSON )
+            WriteMetricsJSON( writer, snapshot );
+        else
+            WriteMetricsPrometheus( writer, snapshot );
+        return writer.length;
+    }
+
+    static char * AllocateMetricsText( const MetricsSnapshot & snapshot, MetricsFormat format, int & length )
+    {
+        length = WriteMetrics( snapshot, format, NULL, 0 );
+        char * text = (char*) YOJIMBO_ALLOCATE( GetDefaultAllocator(), length + 1 );
+        if ( !text )
+            return NULL;
+        WriteMetrics( snapshot, format, text, length + 1 );
+        return text;
+    }
+
+    bool ExportMetricsToFile( const MetricsSnapshot & snapshot, MetricsFormat format, const char * path )
+    {
+        yojimbo_assert( path );
+
+        int length;
+        char * text = AllocateMetricsText( snapshot, format, length );
+        if ( !text )
+            return false;
+
+        char temporaryPath[1024];
+        if ( snprintf( temporaryPath, sizeof( temporaryPath ), "%s.tmp", path ) >= (int) sizeof( temporaryPath ) )
+        {
+            YOJIMBO_FREE( GetDefaultAllocator(), text );
+            return false;
+        }
+
+        bool result = false;
+        FILE * file = fopen( temporaryPath, "wb" );
+        if ( file )
+        {
+            const bool written = fwrite( text, 1, length, file ) == (size_t) length;
+            const bool closed = fclose( file ) == 0;
+            if ( written && closed )
+            {
+#if YOJIMBO_PLATFORM == YOJIMBO_PLATFORM_WINDOWS
+                // rename won't replace an existing file on windows
+                remove( path );
+#endif // #if YOJIMBO_PLATFORM == YOJIMBO_PLATFORM_WINDOWS
+                result = rename( temporaryPath, path ) == 0;
+            }
+            if ( !result )
+            {
+                remove( temporaryPath );
+            }
+        }
+
+        if ( !result )
+        {
+            yojimbo_printf( YOJIMBO_LOG_LEVEL_ERROR, "error: failed to export metrics to %s\n", path );
+        }
+
+        YOJIMBO_FREE( GetDefaultAllocator(), text );
+
+        return result;
+    }
+
+    bool ExportMetricsToSocket( const MetricsSnapshot & snapshot, MetricsFormat format, const char * path )
+    {
+        yojimbo_assert( path );
+
+        int length;
+        char * text = AllocateMetricsText( snapshot, format, length );
+        if ( !text )
+            return false;
+
+        const bool result = yojimbo_local_socket_send( path, text, (size_t) length );
+
+        YOJIMBO_FREE( GetDefaultAllocator(), text );
+
+        return result;
+    }
+}
@@ -0,0 +1,584 @@
+/*
+    Yojimbo Client/Server Network Library.
+
+    Copyright © 2016 - 2026, Más Bandwidth LLC.
+
+    Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+        1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+        2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer 
+           in the documentation and/or other materials provided with the distribution.
+
+        3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived 
+           from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+    INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+    SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+    USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "yojimbo_network_thread.h"
+#include "yojimbo_message.h"
+#include "yojimbo_server.h"
+#include "yojimbo_client.h"
+#include "yojimbo_platform.h"
+
+namespace yojimbo
+{
+    Allocator * NetworkThreadAdapter::CreateAllocator( Allocator & allocator, void * memory, size_t bytes )
+    {
+        Allocator * wrapped = m_adapter->CreateAllocator( allocator, memory, bytes );
+        if ( !wrapped )
+            return NULL;
+        return YOJIMBO_NEW( allocator, LockedAllocator, allocator, wrapped );
+    }
+
+    MessageFactory * NetworkThreadAdapter::CreateMessageFactory( Allocator & allocator )
+    {
+        MessageFactory * messageFactory = m_adapter->CreateMessageFactory( allocator );
+        if ( messageFactory )
+            messageFactory->EnableLocking();
+        return messageFactory;
+    }
+
+    NetworkThread::NetworkThread( Allocator & allocator, int numChannels, const NetworkThreadConfig & config, double time )
+        : m_allocator( allocator ), m_config( config )
+    {
+        yojimbo_assert( numChannels > 0 );
+        yojimbo_assert( config.updateInterval >= 0.0 );
+        m_time = time;
+        m_numSlots = 0;
+        m_numChannels = numChannels;
+        m_sendQueue = NULL;
+        m_receiveQueue = NULL;
+        m_eventQueue = NULL;
+        m_gameConnected = NULL;
+        m_gameGeneration = NULL;
+        m_threadConnected = NULL;
+        m_threadClientId = NULL;
+        m_threadGeneration = NULL;
+        m_quit.store( false );
+        m_numUpdates.store( 0 );
+        m_threadRunning = false;
+        m_startWallTime = 0.0;
+    }
+
+    NetworkThread::~NetworkThread()
+    {
+        // IMPORTANT: The derived class must stop the thread and destroy the queues before this point.
+        yojimbo_assert( !m_threadRunning );
+        yojimbo_assert( !m_sendQueue );
+    }
+
+    void NetworkThread::CreateQueues( int numSlots )
+    {
+        yojimbo_assert( numSlots > 0 );
+        yojimbo_assert( !m_sendQueue );
+
+        m_numSlots = numSlots;
+
+        const int numQueues = numSlots * m_numChannels;
+        m_sendQueue = (SpscQueue<NetworkThreadMessage>**) YOJIMBO_ALLOCATE( m_allocator, sizeof( SpscQueue<NetworkThreadMessage>* ) * numQueues );
+        m_receiveQueue = (SpscQueue<NetworkThreadMessage>**) YOJIMBO_ALLOCATE( m_allocator, sizeof( SpscQueue<NetworkThreadMessage>* ) * numQueues );
+        for ( int i = 0; i < numQueues; ++i )
+        {
+            m_sendQueue[i] = YOJIMBO_NEW( m_allocator, SpscQueue<NetworkThreadMessage>, m_allocator, m_config.sendQueueSize );
+            m_receiveQueue[i] = YOJIMBO_NEW( m_allocator, SpscQueue<NetworkThreadMessage>, m_allocator, m_config.receiveQueueSize );
+        }
+        m_eventQueue = YOJIMBO_NEW( m_allocator, SpscQueue<NetworkThreadEvent>, m_allocator, m_config.eventQueueSize );
+
+        m_gameConnected = (bool*) YOJIMBO_ALLOCATE( m_allocator, sizeof( bool ) * numSlots );
+        m_gameGeneration = (uint32_t*) YOJIMBO_ALLOCATE( m_allocator, sizeof( uint32_t ) * numSlots );
+        m_threadConnected = (bool*) YOJIMBO_ALLOCATE( m_allocator, sizeof( bool ) * numSlots );
+        m_threadClientId = (uint64_t*) YOJIMBO_ALLOCATE( m_allocator, sizeof( uint64_t ) * numSlots );
+        m_threadGeneration = (uint32_t*) YOJIMBO_ALLOCATE( m_allocator, sizeof( uint32_t ) * numSlots );
+        for ( int i = 0; i < numSlots; ++i )
+        {
+            m_gameConnected[i] = false;
+            m_gameGeneration[i] = 0;
+            m_threadConnected[i] = false;
+            m_threadClientId[i] = 0;
+            m_threadGeneration[i] = 0;
+        }
+    }
+
+    void NetworkThread::DestroyQueues()
+    {
+        yojimbo_assert( !m_threadRunning );
+
+        if ( !m_sendQueue )
+            return;
+
+        NetworkThreadMessage entry;
+        for ( int slot = 0; slot < m_numSlots; ++slot )
+        {
+            for ( int channelIndex = 0; channelIndex < m_numChannels; ++channelIndex )
+            {
+                const int queueIndex = slot * m_numChannels + channelIndex;
+                while ( m_sendQueue[queueIndex]->Pop( entry ) )
+                    ReleaseSlotMessage( slot, entry.message );
+                while ( m_receiveQueue[queueIndex]->Pop( entry ) )
+                    ReleaseSlotMessage( slot, entry.message );
+                YOJIMBO_DELETE( m_allocator, SpscQueue<NetworkThreadMessage>, m_sendQueue[queueIndex] );
+                YOJIMBO_DELETE( m_allocator, SpscQueue<NetworkThreadMessage>, m_receiveQueue[queueIndex] );
+            }
+        }
+        YOJIMBO_FREE( m_allocator, m_sendQueue );
+        YOJIMBO_FREE( m_allocator, m_receiveQueue );
+        YOJIMBO_DELETE( m_allocator, SpscQueue<NetworkThreadEvent>, m_eventQueue );
+
+        YOJIMBO_FREE( m_allocator, m_gameConnected );
+        YOJIMBO_FREE( m_allocator, m_gameGeneration );
+        YOJIMBO_FREE( m_allocator, m_threadConnected );
+        YOJIMBO_FREE( m_allocator, m_threadClientId );
+        YOJIMBO_FREE( m_allocator, m_threadGeneration );
+
+        m_numSlots = 0;
+    }
+
+    void NetworkThread::StartThread()
+    {
+        yojimbo_assert( !m_threadRunning );
+        yojimbo_assert( m_sendQueue );
+        m_quit.store( false );
+        m_startWallTime = yojimbo_time();
+        m_threadRunning = true;
+        m_thread = std::thread( &NetworkThread::ThreadMain, this );
+    }
+
+    void NetworkThread::StopThread()
+    {
+        if ( !m_threadRunning )
+            return;
+        m_quit.store( true, std::memory_order_release );
+        m_thread.join();
+        m_threadRunning = false;
+        m_time += yojimbo_time() - m_startWallTime;
+    }
+
+    bool NetworkThread::IsSlotConnected( int slot ) const
+    {
+        yojimbo_assert( slot >= 0 );
+        if ( slot >= m_numSlots )
+            return false;
+        return m_gameConnected[slot];
+    }
+
+    bool NetworkThread::CanSendSlotMessage( int slot, int channelIndex )
+    {
+        yojimbo_assert( slot >= 0 );
+        yojimbo_assert( slot < m_numSlots );
+        yojimbo_assert( channelIndex >= 0 );
+        yojimbo_assert( channelIndex < m_numChannels );
+        return m_gameConnected[slot] && !m_sendQueue[slot * m_numChannels + channelIndex]->IsFull();
+    }
+
+    bool NetworkThread::SendSlotMessage( int slot, int channelIndex, Message * message )
+    {
+        yojimbo_assert( slot >= 0 );
+        yojimbo_assert( slot < m_numSlots );
+        yojimbo_assert( channelIndex >= 0 );
+        yojimbo_assert( channelIndex < m_numChannels );
+        yojimbo_assert( message );
+
+        NetworkThreadMessage entry;
+        entry.message = message;
+        entry.generation = m_gameGeneration[slot];
+
+        if ( !m_gameConnected[slot] || !m_sendQueue[slot * m_numChannels + channelIndex]->Push( entry ) )
+        {
+            ReleaseSlotMessage( slot, message );
+            return false;
+        }
+
+        return true;
+    }
+
+    Message * NetworkThread::ReceiveSlotMessage( int slot, int channelIndex )
+    {
+        yojimbo_assert( slot >= 0 );
+        yojimbo_assert( slot < m_numSlots );
+        yojimbo_assert( channelIndex >= 0 );
+        yojimbo_assert( channelIndex < m_numChannels );
+
+        if ( !m_gameConnected[slot] )
+            return NULL;
+
+        // messages from a later connection wait until the game thread has seen its connect event
+
+        SpscQueue<NetworkThreadMessage> & queue = *m_receiveQueue[slot * m_numChannels + channelIndex];
+        NetworkThreadMessage entry;
+        if ( !queue.Peek( entry ) || entry.generation != m_gameGeneration[slot] )
+            return NULL;
+
+        queue.Pop( entry );
+        return entry.message;
+    }
+
+    bool NetworkThread::ReceiveEvent( NetworkThreadEvent & event )
+    {
+        if ( !m_eventQueue || !m_eventQueue->Pop( event ) )
+            return false;
+
+        const int slot = event.clientIndex;
+        yojimbo_assert( slot >= 0 );
+        yojimbo_assert( slot < m_numSlots );
+
+        if ( event.type == NETWORK_THREAD_EVENT_CONNECTED )
+        {
+            m_gameConnected[slot] = true;
+            m_gameGeneration[slot] = event.generation;
+        }
+        else
+        {
+            m_gameConnected[slot] = false;
+            DrainSlot( slot, event.generation );
+        }
+
+        return true;
+    }
+
+    void NetworkThread::DrainSlot( int slot, uint32_t generation )
+    {
+        NetworkThreadMessage entry;
+        for ( int channelIndex = 0; channelIndex < m_numChannels; ++channelIndex )
+        {
+            SpscQueue<NetworkThreadMessage> & queue = *m_receiveQueue[slot * m_numChannels + channelIndex];
+            while ( queue.Peek( entry ) && entry.generation == generation )
+            {
+                queue.Pop( entry );
+                ReleaseSlotMessage( slot, entry.message );
+            }
+        }
+    }
+
+    void NetworkThread::ThreadMain()
+    {
+        while ( !m_quit.load( std::memory_order_acquire ) )
+        {
+            const double updateStart = yojimbo_time();
+
+            ThreadReceivePackets( m_time + ( updateStart - m_startWallTime ) );
+
+            ThreadUpdateState();
+
+            for ( int slot = 0; slot < m_numSlots; ++slot )
+            {
+                ThreadUpdateSlot( slot );
+            }
+
+            ThreadSendPackets();
+
+            m_numUpdates.fetch_add( 1, std::memory_order_relaxed );
+
+            const double updateTime = yojimbo_time() - updateStart;
+            if ( updateTime < m_config.updateInterval )
+            {
+                yojimbo_sleep( m_config.updateInterval - updateTime );
+            }
+        }
+    }
+
+    void NetworkThread::ThreadUpdateSlot( int slot )
+    {
+        const bool connected = ThreadIsSlotConnected( slot );
+        const uint64_t clientId = connected ? ThreadGetSlotClientId( slot ) : 0;
+
+        // report connection changes first. if the event queue is full, try again next update
+
+        if ( m_threadConnected[slot] && ( !connected || clientId != m_threadClientId[slot] ) )
+        {
+            NetworkThreadEvent event;
+            event.type = NETWORK_THREAD_EVENT_DISCONNECTED;
+            event.clientIndex = slot;
+            event.clientId = m_threadClientId[slot];
+            event.generation = m_threadGeneration[slot];
+            if ( !m_eventQueue->Push( event ) )
+                return;
+            m_threadConnected[slot] = false;
+        }
+
+        if ( !m_threadConnected[slot] && connected )
+        {
+            NetworkThreadEvent event;
+            event.type = NETWORK_THREAD_EVENT_CONNECTED;
+            event.clientIndex = slot;
+            event.clientId = clientId;
+            event.generation = m_threadGeneration[slot] + 1;
+            if ( !m_eventQueue->Push( event ) )
+                return;
+            m_threadConnected[slot] = true;
+            m_threadClientId[slot] = clientId;
+            m_threadGeneration[slot]++;
+        }
+
+        NetworkThreadMessage entry;
+
+        for ( int channelIndex = 0; channelIndex < m_numChannels; ++channelIndex )
+        {
+            const int queueIndex = slot * m_numChannels + channelIndex;
+
+            // messages for an earlier connection are dropped. messages the channel can't take yet wait in the queue
+
+            SpscQueue<NetworkThreadMessage> & sendQueue = *m_sendQueue[queueIndex];
+            while ( sendQueue.Peek( entry ) )
+            {
+                if ( !m_threadConnected[slot] || entry.generation != m_threadGeneration[slot] )
+                {
+                    sendQueue.Pop( entry );
+                    ReleaseSlotMessage( slot, entry.message );
+                    continue;
+                }
+                if ( !ThreadCanSendMessage( slot, channelIndex ) )
+                    break;
+                sendQueue.Pop( entry );
+                ThreadSendMessage( slot, channelIndex, entry.message );
+            }
+
+            if ( !m_threadConnected[slot] )
+                continue;
+
+            SpscQueue<NetworkThreadMessage> & receiveQueue = *m_receiveQueue[queueIndex];
+            while ( !receiveQueue.IsFull() )
+            {
+                Message * message = ThreadReceiveMessage( slot, channelIndex );
+                if ( !message )
+                    break;
+                entry.message = message;
+                entry.generation = m_threadGeneration[slot];
+                receiveQueue.Push( entry );
+            }
+        }
+    }
+
+    // ------------------------------------------------------------------------------------------------------------
+
+    ServerNetworkThread::ServerNetworkThread( Allocator & allocator, const uint8_t privateKey[], const Address & address, const ClientServerConfig & config, Adapter & adapter, double time, const NetworkThreadConfig & threadConfig )
+        : NetworkThread( allocator, config.numChannels, threadConfig, time ), m_adapter( adapter )
+    {
+        // the game thread creates messages with the client slot factories, so they must outlive any one connection
+        ClientServerConfig serverConfig = config;
+        serverConfig.serverLazyClientMemory = false;
+        m_server = YOJIMBO_NEW( m_allocator, Server, m_allocator, privateKey, address, serverConfig, m_adapter, time );
+        m_maxClients = 0;
+    }
+
+    ServerNetworkThread::~ServerNetworkThread()
+    {
+        Stop();
+        YOJIMBO_DELETE( m_allocator, Server, m_server );
+    }
+
+    void ServerNetworkThread::Start( int maxClients )
+    {
+        yojimbo_assert( !IsThreadRunning() );
+        m_server->Start( maxClients );
+        if ( !m_server->IsRunning() )
+            return;
+        m_maxClients = maxClients;
+        CreateQueues( maxClients );
+        StartThread();
+    }
+
+    void ServerNetworkThread::Stop()
+    {
+        if ( !IsThreadRunning() )
+            return;
+        StopThread();
+        DestroyQueues();
+        m_server->Stop();
+        m_maxClients = 0;
+    }
+
+    const Address & ServerNetworkThread::GetAddress() const
+    {
+        return m_server->GetAddress();
+    }
+
+    Message * ServerNetworkThread::CreateMessage( int clientIndex, int type )
+    {
+        return m_server->CreateMessage( clientIndex, type );
+    }
+
+    uint8_t * ServerNetworkThread::AllocateBlock( int clientIndex, int bytes )
+    {
+        return m_server->AllocateBlock( clientIndex, bytes );
+    }
+
+    void ServerNetworkThread::AttachBlockToMessage( int clientIndex, Message * message, uint8_t * block, int bytes )
+    {
+        m_server->AttachBlockToMessage( clientIndex, message, block, bytes );
+    }
+
+    void ServerNetworkThread::FreeBlock( int clientIndex, uint8_t * block )
+    {
+        m_server->FreeBlock( clientIndex, block );
+    }
+
+    void ServerNetworkThread::ReleaseSlotMessage( int slot, Message * message )
+    {
+        m_server->ReleaseMessage( slot, message );
+    }
+
+    void ServerNetworkThread::ThreadReceivePackets( double time )
+    {
+        m_server->AdvanceTime( time );
+        m_server->ReceivePackets();
+    }
+
+    void ServerNetworkThread::ThreadSendPackets()
+    {
+        m_server->SendPackets();
+    }
+
+    bool ServerNetworkThread::ThreadIsSlotConnected( int slot )
+    {
+        return m_server->IsClientConnected( slot );
+    }
+
+    uint64_t ServerNetworkThread::ThreadGetSlotClientId( int slot )
+    {
+        return m_server->GetClientId( slot );
+    }
+
+    bool ServerNetworkThread::ThreadCanSendMessage( int slot, int channelIndex )
+    {
+        return m_server->CanSendMessage( slot, channelIndex );
+    }
+
+    void ServerNetworkThread::ThreadSendMessage( int slot, int channelIndex, Message * message )
+    {
+        m_server->SendMessage( slot, channelIndex, message );
+    }
+
+    Message * ServerNetworkThread::ThreadReceiveMessage( int slot, int channelIndex )
+    {
+        return m_server->ReceiveMessage( slot, channelIndex );
+    }
+
+    // ------------------------------------------------------------------------------------------------------------
+
+    ClientNetworkThread::ClientNetworkThread( Allocator & allocator, const Address & address, const ClientServerConfig & config, Adapter & adapter, double time, const NetworkThreadConfig & threadConfig )
+        : NetworkThread( allocator, config.numChannels, threadConfig, time ), m_adapter( adapter )
+    {
+        m_client = YOJIMBO_NEW( m_allocator, Client, m_allocator, address, config, m_adapter, time );
+        m_clientState.store( CLIENT_STATE_DISCONNECTED );
+    }
+
+    ClientNetworkThread::~ClientNetworkThread()
+    {
+        Disconnect();
+        YOJIMBO_DELETE( m_allocator, Client, m_client );
+    }
+
+    void ClientNetworkThread::InsecureConnect( const uint8_t privateKey[], uint64_t clientId, const Address & address )
+    {
+        Disconnect();
+        m_client->InsecureConnect( privateKey, clientId, address );
+        StartConnected();
+    }
+
+    void ClientNetworkThread::Connect( uint64_t clientId, uint8_t * connectToken )
+    {
+        Disconnect();
+        m_client->Connect( clientId, connectToken );
+        StartConnected();
+    }
+
+    void ClientNetworkThread::StartConnected()
+    {
+        m_clientState.store( m_client->GetClientState(), std::memory_order_release );
+        if ( m_client->IsDisconnected() )
+            return;
+        CreateQueues( 1 );
+        StartThread();
+    }
+
+    void ClientNetworkThread::Disconnect()
+    {
+        if ( IsThreadRunning() )
+        {
+            StopThread();
+            DestroyQueues();
+        }
+        m_client->Disconnect();
+        m_clientState.store( m_client->GetClientState(), std::memory_order_release );
+    }
+
+    Message * ClientNetworkThread::CreateMessage( int type )
+    {
+        return m_client->CreateMessage( type );
+    }
+
+    uint8_t * ClientNetworkThread::AllocateBlock( int bytes )
+    {
+        return m_client->AllocateBlock( bytes );
+    }
+
+    void ClientNetworkThread::AttachBlockToMessage( Message * message, uint8_t * block, int bytes )
+    {
+        m_client->AttachBlockToMessage( message, block, bytes );
+    }
+
+    void ClientNetworkThread::FreeBlock( uint8_t * block )
+    {
+        m_client->FreeBlock( block );
+    }
+
+    void ClientNetworkThread::ReleaseSlotMessage( int slot, Message * message )
+    {
+        (void) slot;
+        m_client->ReleaseMessage( message );
+    }
+
+    void ClientNetworkThread::ThreadReceivePackets( double time )
+    {
+        m_client->AdvanceTime( time );
+        m_client->ReceivePackets();
+    }
+
+    void ClientNetworkThread::ThreadSendPackets()
+    {
+        m_client->SendPackets();
+    }
+
+    void ClientNetworkThread::ThreadUpdateState()
+    {
+        m_clientState.store( m_client->GetClientState(), std::memory_order_release );
+    }
+
+    bool ClientNetworkThread::ThreadIsSlotConnected( int slot )
+    {
+        (void) slot;
+        return m_client->IsConnected();
+    }
+
+    uint64_t ClientNetworkThread::ThreadGetSlotClientId( int slot )
+    {
+        (void) slot;
+        return m_client->GetClientId();
+    }
+
+    bool ClientNetworkThread::ThreadCanSendMessage( int slot, int channelIndex )
+    {
+        (void) slot;
+        return m_client->CanSendMessage( channelIndex );
+    }
+
+    void ClientNetworkThread::ThreadSendMessage( int slot, int channelIndex, Message * message )
+    {
+        (void) slot;
+        m_client->SendMessage( channelIndex, message );
+    }
+
+    Message * ClientNetworkThread::ThreadReceiveMessage( int slot, int channelIndex )
+    {
+        (void) slot;
+        return m_client->ReceiveMessage( channelIndex );
+    }
+}
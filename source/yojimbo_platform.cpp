@@ -23,11 +23,13 @@
 */
 
 #include "yojimbo_platform.h"
+#include "yojimbo_log.h"
 #include "netcode.h"
 #include "reliable.h"
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 static void default_assert_handler( const char * condition, const char * function, const char * file, int line )
 {
@@ -45,6 +47,8 @@ static int log_level = 0;
 
 static int (*printf_function)( const char *, ... ) = printf;
 
+static void (*vprintf_function)( const char *, va_list ) = NULL;
+
 void (*yojimbo_assert_function)( const char *, const char *, const char * file, int line ) = default_assert_handler;
 
 void yojimbo_log_level( int level )
@@ -60,6 +64,14 @@ void yojimbo_set_printf_function( int (*function)( const char *, ... ) )
     printf_function = function;
     netcode_set_printf_function( function );
     reliable_set_printf_function( function );
+
+    // The binary logger takes messages unformatted, so hand them to it directly instead of formatting them first.
+    // A system netcode and reliable have no hook for it, and keep formatting theirs.
+    vprintf_function = ( function == yojimbo_binary_log_printf ) ? yojimbo_binary_log_vprintf : NULL;
+#ifndef YOJIMBO_SYSTEM_DEPS
+    netcode_set_vprintf_function( vprintf_function );
+    reliable_set_vprintf_function( vprintf_function );
+#endif // #ifndef YOJIMBO_SYSTEM_DEPS
 }
 
 void yojimbo_set_assert_function( void (*function)( const char *, const char *, const char * file, int line ) )
@@ -77,9 +89,16 @@ void yojimbo_printf( int level, const char * format, ... )
         return;
     va_list args;
     va_start( args, format );
-    char buffer[4*1024];
-    vsnprintf( buffer, sizeof(buffer), format, args );
-    printf_function( "%s", buffer );
+    if ( vprintf_function )
+    {
+        vprintf_function( format, args );
+    }
+    else
+    {
+        char buffer[4*1024];
+        vsnprintf( buffer, sizeof(buffer), format, args );
+        printf_function( "%s", buffer );
+    }
     va_end( args );
 }
 
@@ -212,3 +231,380 @@ double yojimbo_time()
 #error unsupported platform!
 
 #endif
+
+// ===============================
+//         Virtual memory
+// ===============================
+
+#if YOJIMBO_PLATFORM == YOJIMBO_PLATFORM_WINDOWS
+
+size_t yojimbo_memory_page_size()
+{
+    SYSTEM_INFO info;
+    GetSystemInfo( &info );
+    return (size_t) info.dwPageSize;
+}
+
+void * yojimbo_memory_reserve( size_t bytes )
+{
+    return VirtualAlloc( NULL, bytes, MEM_RESERVE, PAGE_NOACCESS );
+}
+
+bool yojimbo_memory_commit( void * memory, size_t bytes )
+{
+    return VirtualAlloc( memory, bytes, MEM_COMMIT, PAGE_READWRITE ) != NULL;
+}
+
+void yojimbo_memory_decommit( void * memory, size_t bytes )
+{
+    VirtualFree( memory, bytes, MEM_DECOMMIT );
+}
+
+void yojimbo_memory_release( void * memory, size_t bytes )
+{
+    (void) bytes;
+    VirtualFree( memory, 0, MEM_RELEASE );
+}
+
+size_t yojimbo_memory_resident( const void * memory, size_t bytes )
+{
+    // windows can't cheaply report resident pages, so count committed pages instead
+
+    const uint8_t * p = (const uint8_t*) memory;
+    const uint8_t * end = p + bytes;
+    size_t committed = 0;
+    while ( p < end )
+    {
+        MEMORY_BASIC_INFORMATION info;
+        if ( VirtualQuery( p, &info, sizeof( info ) ) == 0 )
+            break;
+        const uint8_t * regionEnd = (const uint8_t*) info.BaseAddress + info.RegionSize;
+        if ( regionEnd > end )
+            regionEnd = end;
+        if ( info.State == MEM_COMMIT )
+            committed += regionEnd - p;
+        p = regionEnd;
+    }
+    return committed;
+}
+
+#else // #if YOJIMBO_PLATFORM == YOJIMBO_PLATFORM_WINDOWS
+
+#include <sys/mman.h>
+
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
+#ifndef MAP_NORESERVE
+#define MAP_NORESERVE 0
+#endif
+
+size_t yojimbo_memory_page_size()
+{
+    return (size_t) sysconf( _SC_PAGESIZE );
+}
+
+void * yojimbo_memory_reserve( size_t bytes )
+{
+    void * memory = mmap( NULL, bytes, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0 );
+    return memory != MAP_FAILED ? memory : NULL;
+}
+
+bool yojimbo_memory_commit( void * memory, size_t bytes )
+{
+    return mprotect( memory, bytes, PROT_READ | PROT_WRITE ) == 0;
+}
+
+void yojimbo_memory_decommit( void * memory, size_t bytes )
+{
+    // mapping fresh pages over the range frees the old ones straight away. madvise does too on linux, but not on mac
+
+    mmap( memory, bytes, PROT_NONE, MAP_FIXED | MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0 );
+}
+
+void yojimbo_memory_release( void * memory, size_t bytes )
+{
+    munmap( memory, bytes );
+}
+
+size_t yojimbo_memory_resident( const void * memory, size_t bytes )
+{
+#if YOJIMBO_PLATFORM == YOJIMBO_PLATFORM_MAC
+    char residency[256];
+#else
+    unsigned char residency[256];
+#endif
+    const size_t pageSize = yojimbo_memory_page_size();
+    uintptr_t p = (uintptr_t) memory & ~( pageSize - 1 );
+    const uintptr_t end = ( (uintptr_t) memory + bytes + pageSize - 1 ) & ~( pageSize - 1 );
+    size_t resident = 0;
+    while ( p < end )
+    {
+        size_t numPages = ( end - p ) / pageSize;
+        if ( numPages > sizeof( residency ) )
+            numPages = sizeof( residency );
+        if ( mincore( (void*) p, numPages * pageSize, residency ) != 0 )
+            break;
+        for ( size_t i = 0; i < numPages; ++i )
+        {
+            if ( residency[i] & 1 )
+                resident += pageSize;
+        }
+        p += numPages * pageSize;
+    }
+    return resident;
+}
+
+#endif // #if YOJIMBO_PLATFORM == YOJIMBO_PLATFORM_WINDOWS
+
+// ===============================
+//      Huge pages and NUMA
+// ===============================
+
+#if YOJIMBO_PLATFORM == YOJIMBO_PLATFORM_WINDOWS
+
+size_t yojimbo_memory_huge_page_size()
+{
+    return (size_t) GetLargePageMinimum();
+}
+
+void * yojimbo_memory_map( size_t bytes, bool hugePages, int numaNode )
+{
+    const DWORD node = numaNode >= 0 ? (DWORD) numaNode : NUMA_NO_PREFERRED_NODE;
+    void * memory = NULL;
+    if ( hugePages && GetLargePageMinimum() != 0 )
+    {
+        memory = VirtualAllocExNuma( GetCurrentProcess(), NULL, bytes, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE, node );
+    }
+    if ( !memory )
+    {
+        memory = VirtualAllocExNuma( GetCurrentProcess(), NULL, bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE, node );
+    }
+    return memory;
+}
+
+void yojimbo_memory_set_policy( void * memory, size_t bytes, bool hugePages, int numaNode )
+{
+    // windows sets the node when memory is allocated, and has no transparent huge pages
+    (void) memory;
+    (void) bytes;
+    (void) hugePages;
+    (void) numaNode;
+}
+
+int yojimbo_memory_numa_node()
+{
+    PROCESSOR_NUMBER processor;
+    GetCurrentProcessorNumberEx( &processor );
+    USHORT node = 0;
+    if ( !GetNumaProcessorNodeEx( &processor, &node ) || node == 0xFFFF )
+        return -1;
+    return (int) node;
+}
+
+#elif YOJIMBO_PLATFORM == YOJIMBO_PLATFORM_UNIX
+
+#include <sys/syscall.h>
+
+static const size_t HugePageSize = 2 * 1024 * 1024;
+
+static void yojimbo_memory_bind( void * memory, size_t bytes, int numaNode )
+{
+#ifdef SYS_mbind
+    const int MPOL_BIND_MODE = 2;
+    const int MaxNodes = 1024;
+    const int BitsPerWord = 8 * sizeof( unsigned long );
+    if ( numaNode < 0 || numaNode >= MaxNodes )
+        return;
+    unsigned long nodeMask[MaxNodes / BitsPerWord];
+    memset( nodeMask, 0, sizeof( nodeMask ) );
+    nodeMask[numaNode / BitsPerWord] = 1UL << ( numaNode % BitsPerWord );
+    if ( syscall( SYS_mbind, memory, bytes, MPOL_BIND_MODE, nodeMask, (unsigned long) MaxNodes, 0 ) != 0 )
+    {
+        yojimbo_printf( YOJIMBO_LOG_LEVEL_ERROR, "error: could not bind memory to numa node %d\n", numaNode );
+    }
+#else // #ifdef SYS_mbind
+    (void) memory;
+    (void) bytes;
+    (void) numaNode;
+#endif // #ifdef SYS_mbind
+}
+
+size_t yojimbo_memory_huge_page_size()
+{
+    return HugePageSize;
+}
+
+void * yojimbo_memory_map( size_t bytes, bool hugePages, int numaNode )
+{
+    uint8_t * memory = NULL;
+
+    if ( hugePages )
+    {
+        yojimbo_assert( ( bytes % HugePageSize ) == 0 );
+
+#ifdef MAP_HUGETLB
+        // hugetlbfs reserves the pages at map time, so this fails up front if the pool is short, rather than on first touch
+        void * hugetlb = mmap( NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0 );
+        if ( hugetlb != MAP_FAILED )
+        {
+            yojimbo_memory_bind( hugetlb, bytes, numaNode );
+            return hugetlb;
+        }
+#endif // #ifdef MAP_HUGETLB
+
+        // map an extra huge page and trim the ends, so the range is huge page aligned and transparent huge pages can back all of it
+
+        void * mapped = mmap( NULL, bytes + HugePageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+        if ( mapped == MAP_FAILED )
+            return NULL;
+        memory = (uint8_t*) ( ( uintptr_t( mapped ) + HugePageSize - 1 ) & ~uintptr_t( HugePageSize - 1 ) );
+        const size_t head = memory - (uint8_t*) mapped;
+        if ( head > 0 )
+            munmap( mapped, head );
+        if ( HugePageSize - head > 0 )
+            munmap( memory + bytes, HugePageSize - head );
+    }
+    else
+    {
+        void * mapped = mmap( NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+        if ( mapped == MAP_FAILED )
+            return NULL;
+        memory = (uint8_t*) mapped;
+    }
+
+    yojimbo_memory_set_policy( memory, bytes, hugePages, numaNode );
+
+    return memory;
+}
+
+void yojimbo_memory_set_policy( void * memory, size_t bytes, bool hugePages, int numaNode )
+{
+#ifdef MADV_HUGEPAGE
+    if ( hugePages )
+    {
+        madvise( memory, bytes, MADV_HUGEPAGE );
+    }
+#else // #ifdef MADV_HUGEPAGE
+    (void) hugePages;
+#endif // #ifdef MADV_HUGEPAGE
+    yojimbo_memory_bind( memory, bytes, numaNode );
+}
+
+int yojimbo_memory_numa_node()
+{
+#ifdef SYS_getcpu
+    unsigned int cpu = 0;
+    unsigned int node = 0;
+    if ( syscall( SYS_getcpu, &cpu, &node, NULL ) == 0 )
+        return (int) node;
+#endif // #ifdef SYS_getcpu
+    return -1;
+}
+
+#else // #if YOJIMBO_PLATFORM == YOJIMBO_PLATFORM_WINDOWS
+
+size_t yojimbo_memory_huge_page_size()
+{
+    return 0;
+}
+
+void * yojimbo_memory_map( size_t bytes, bool hugePages, int numaNode )
+{
+    // no huge pages or NUMA here. the memory is still mapped straight from the OS
+    (void) hugePages;
+    (void) numaNode;
+    void * memory = mmap( NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+    return memory != MAP_FAILED ? memory : NULL;
+}
+
+void yojimbo_memory_set_policy( void * memory, size_t bytes, bool hugePages, int numaNode )
+{
+    (void) memory;
+    (void) bytes;
+    (void) hugePages;
+    (void) numaNode;
+}
+
+int yojimbo_memory_numa_node()
+{
+    return -1;
+}
+
+#endif // #if YOJIMBO_PLATFORM == YOJIMBO_PLATFORM_WINDOWS
+
+// ===============================
+//         Local sockets
+// ===============================
+
+#if YOJIMBO_PLATFORM == YOJIMBO_PLATFORM_WINDOWS
+
+bool yojimbo_local_socket_send( const char * path, const void * data, size_t bytes )
+{
+    // not supported. scrape the exported file instead
+    (void) path;
+    (void) data;
+    (void) bytes;
+    return false;
+}
+
+#else // #if YOJIMBO_PLATFORM == YOJIMBO_PLATFORM_WINDOWS
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <errno.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+bool yojimbo_local_socket_send( const char * path, const void * data, size_t bytes )
+{
+    yojimbo_assert( path );
+    yojimbo_assert( data || bytes == 0 );
+
+    struct sockaddr_un address;
+    memset( &address, 0, sizeof( address ) );
+    address.sun_family = AF_UNIX;
+    if ( strlen( path ) >= sizeof( address.sun_path ) )
+        return false;
+    strncpy( address.sun_path, path, sizeof( address.sun_path ) - 1 );
+
+    int s = socket( AF_UNIX, SOCK_STREAM, 0 );
+    if ( s < 0 )
+        return false;
+
+#ifdef SO_NOSIGPIPE
+    // mac has no MSG_NOSIGNAL. a listener that goes away mid send must not kill the server
+    int one = 1;
+    setsockopt( s, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof( one ) );
+#endif // #ifdef SO_NOSIGPIPE
+
+    if ( connect( s, (struct sockaddr*) &address, sizeof( address ) ) != 0 )
+    {
+        close( s );
+        return false;
+    }
+
+    const uint8_t * p = (const uint8_t*) data;
+    while ( bytes > 0 )
+    {
+        ssize_t sent = send( s, p, bytes, MSG_NOSIGNAL );
+        if ( sent < 0 && errno == EINTR )
+            continue;
+        if ( sent <= 0 )
+        {
+            close( s );
+            return false;
+        }
+        p += sent;
+        bytes -= (size_t) sent;
+    }
+
+    close( s );
+    return true;
+}
+
+#endif // #if YOJIMBO_PLATFORM == YOJIMBO_PLATFORM_WINDOWS
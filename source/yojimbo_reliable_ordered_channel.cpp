@@ -24,13 +24,16 @@
 
 #include "yojimbo_reliable_ordered_channel.h"
 #include "yojimbo_utils.h"
+#include "yojimbo_compression.h"
 
 namespace yojimbo
 {
     ReliableOrderedChannel::ReliableOrderedChannel( Allocator & allocator, MessageFactory & messageFactory, const ChannelConfig & config, const int maxPacketSize, int channelIndex, double time )
         : Channel( allocator, messageFactory, config, maxPacketSize, channelIndex, time )
     {
-        yojimbo_assert( config.type == CHANNEL_TYPE_RELIABLE_ORDERED );
+        yojimbo_assert( config.type == CHANNEL_TYPE_RELIABLE_ORDERED || config.type == CHANNEL_TYPE_RELIABLE_UNORDERED );
+
+        m_ordered = config.type == CHANNEL_TYPE_RELIABLE_ORDERED;
 
         yojimbo_assert( ( 65536 % config.sentPacketBufferSize ) == 0 );
         yojimbo_assert( ( 65536 % config.messageSendQueueSize ) == 0 );
@@ -41,18 +44,32 @@ namespace yojimbo
         m_messageReceiveQueue = YOJIMBO_NEW( *m_allocator, SequenceBuffer<MessageReceiveQueueEntry>, *m_allocator, m_config.messageReceiveQueueSize );
         m_sentPacketMessageIds = (uint16_t*) YOJIMBO_ALLOCATE( *m_allocator, sizeof( uint16_t ) * m_config.maxMessagesPerPacket * m_config.sentPacketBufferSize );
         m_packetMessageIds = (uint16_t*) YOJIMBO_ALLOCATE( *m_allocator, sizeof( uint16_t ) * m_config.maxMessagesPerPacket );
+        m_messageDeliveryQueue = !m_ordered ? YOJIMBO_NEW( *m_allocator, Queue<Message*>, *m_allocator, m_config.messageReceiveQueueSize ) : NULL;
 
         if ( !config.disableBlocks )
         {
-            m_sendBlock = YOJIMBO_NEW( *m_allocator, SendBlockData, *m_allocator, m_config.GetMaxFragmentsPerBlock() ); 
-            m_receiveBlock = YOJIMBO_NEW( *m_allocator, ReceiveBlockData, *m_allocator, m_config.maxBlockSize, m_config.GetMaxFragmentsPerBlock() );
+            m_sentPacketFragments = (SentFragmentEntry*) YOJIMBO_ALLOCATE( *m_allocator, sizeof( SentFragmentEntry ) * m_config.maxFragmentsPerPacket * m_config.sentPacketBufferSize );
+            m_packetFragments = (SentFragmentEntry*) YOJIMBO_ALLOCATE( *m_allocator, sizeof( SentFragmentEntry ) * m_config.maxFragmentsPerPacket );
+            m_sendBlocks = (SendBlockData**) YOJIMBO_ALLOCATE( *m_allocator, sizeof( SendBlockData* ) * m_config.maxBlocksInFlight );
+            m_receiveBlocks = (ReceiveBlockData**) YOJIMBO_ALLOCATE( *m_allocator, sizeof( ReceiveBlockData* ) * m_config.maxBlocksInFlight );
+            const int maxFragments = yojimbo_max( m_config.GetMaxFragmentsPerBlock(), m_config.streamWindowSize );
+            for ( int i = 0; i < m_config.maxBlocksInFlight; ++i )
+            {
+                m_sendBlocks[i] = YOJIMBO_NEW( *m_allocator, SendBlockData, *m_allocator, maxFragments );
+                m_receiveBlocks[i] = YOJIMBO_NEW( *m_allocator, ReceiveBlockData, *m_allocator, maxFragments, m_config.streamWindowSize );
+            }
         }
         else
         {
-            m_sendBlock = NULL;
-            m_receiveBlock = NULL;
+            m_sentPacketFragments = NULL;
+            m_packetFragments = NULL;
+            m_sendBlocks = NULL;
+            m_receiveBlocks = NULL;
         }
 
+        m_streamWriteFunction = NULL;
+        m_streamWriteContext = NULL;
+
         Reset();
     }
 
@@ -60,11 +77,23 @@ namespace yojimbo
     {
         Reset();
 
-        YOJIMBO_DELETE( *m_allocator, SendBlockData, m_sendBlock );
-        YOJIMBO_DELETE( *m_allocator, ReceiveBlockData, m_receiveBlock );
+        if ( !m_config.disableBlocks )
+        {
+            for ( int i = 0; i < m_config.maxBlocksInFlight; ++i )
+            {
+                YOJIMBO_DELETE( *m_allocator, SendBlockData, m_sendBlocks[i] );
+                YOJIMBO_DELETE( *m_allocator, ReceiveBlockData, m_receiveBlocks[i] );
+            }
+        }
+
+        YOJIMBO_FREE( *m_allocator, m_sendBlocks );
+        YOJIMBO_FREE( *m_allocator, m_receiveBlocks );
+        YOJIMBO_FREE( *m_allocator, m_sentPacketFragments );
+        YOJIMBO_FREE( *m_allocator, m_packetFragments );
         YOJIMBO_DELETE( *m_allocator, SequenceBuffer<SentPacketEntry>, m_sentPackets );
         YOJIMBO_DELETE( *m_allocator, SequenceBuffer<MessageSendQueueEntry>, m_messageSendQueue );
         YOJIMBO_DELETE( *m_allocator, SequenceBuffer<MessageReceiveQueueEntry>, m_messageReceiveQueue );
+        YOJIMBO_DELETE( *m_allocator, Queue<Message*>, m_messageDeliveryQueue );
         
         YOJIMBO_FREE( *m_allocator, m_sentPacketMessageIds );
         YOJIMBO_FREE( *m_allocator, m_packetMessageIds );
@@ -79,6 +108,7 @@ namespace yojimbo
         m_sendMessageId = 0;
         m_receiveMessageId = 0;
         m_oldestUnackedMessageId = 0;
+        m_rtt = -1.0;
 
         for ( int i = 0; i < m_messageSendQueue->GetSize(); ++i )
         {
@@ -94,22 +124,34 @@ namespace yojimbo
                 m_messageFactory->ReleaseMessage( entry->message );
         }
 
+        if ( m_messageDeliveryQueue )
+        {
+            for ( int i = 0; i < m_messageDeliveryQueue->GetNumEntries(); ++i )
+                m_messageFactory->ReleaseMessage( (*m_messageDeliveryQueue)[i] );
+
+            m_messageDeliveryQueue->Clear();
+        }
+
         m_sentPackets->Reset();
         m_messageSendQueue->Reset();
+        m_unsentList.head = m_unsentList.tail = -1;
+        m_sentList.head = m_sentList.tail = -1;
         m_messageReceiveQueue->Reset();
 
-        if ( m_sendBlock )
+        if ( !m_config.disableBlocks )
         {
-            m_sendBlock->Reset();
-        }
-
-        if ( m_receiveBlock )
-        {
-            m_receiveBlock->Reset();
-            if ( m_receiveBlock->blockMessage )
+            for ( int i = 0; i < m_config.maxBlocksInFlight; ++i )
             {
-                m_messageFactory->ReleaseMessage( m_receiveBlock->blockMessage );
-                m_receiveBlock->blockMessage = NULL;
+                m_sendBlocks[i]->Reset();
+
+                ReceiveBlockData * receiveBlock = m_receiveBlocks[i];
+                receiveBlock->Reset();
+                YOJIMBO_FREE( m_messageFactory->GetAllocator(), receiveBlock->blockData );
+                if ( receiveBlock->blockMessage )
+                {
+                    m_messageFactory->ReleaseMessage( receiveBlock->blockMessage );
+                    receiveBlock->blockMessage = NULL;
+                }
             }
         }
 
@@ -154,14 +196,29 @@ namespace yojimbo
             return;
         }
 
-        message->SetId( m_sendMessageId );
+        const bool isStream = message->IsBlockMessage() && ( (BlockMessage*) message )->IsBlockStream();
 
-        MeasureStream measureStream;
-        measureStream.SetContext( context );
-        measureStream.SetAllocator( &m_messageFactory->GetAllocator() );
-        message->SerializeInternal( measureStream );
+        yojimbo_assert( !isStream || m_config.streamWindowSize > 0 );
 
-        const int measuredBits = measureStream.GetBitsProcessed();
+        if ( isStream && m_config.streamWindowSize <= 0 )
+        {
+            // You tried to send a streamed block, but this channel has no stream window. See ChannelConfig::streamWindowSize.
+            SetErrorLevel( CHANNEL_ERROR_STREAM_FAILED );
+            m_messageFactory->ReleaseMessage( message );
+            return;
+        }
+
+        if ( isStream && ( ( (BlockMessage*) message )->GetBlockStreamSize() - 1 ) / m_config.blockFragmentSize >= 0x7FFFFFFF )
+        {
+            // Stream fragment ids must fit in a signed 32 bit integer.
+            SetErrorLevel( CHANNEL_ERROR_MESSAGE_TOO_LARGE );
+            m_messageFactory->ReleaseMessage( message );
+            return;
+        }
+
+        message->SetId( m_sendMessageId );
+
+        const int measuredBits = m_messageFactory->MeasureMessage( message, context );
 
         const bool isOverBudget = m_config.packetBudget > 0 && measuredBits > m_config.packetBudget * 8;
         const bool isOverPacketSize = measuredBits > m_maxPacketSize * 8;
@@ -186,7 +243,9 @@ namespace yojimbo
         entry->measuredBits = 0;
         entry->timeLastSent = -1.0;
 
-        if ( message->IsBlockMessage() )
+        LinkSendQueueEntry( m_unsentList, m_messageSendQueue->GetIndex( m_sendMessageId ) );
+
+        if ( message->IsBlockMessage() && !isStream )
         {
             yojimbo_assert( ((BlockMessage*)message)->GetBlockSize() > 0 );
             yojimbo_assert( ((BlockMessage*)message)->GetBlockSize() <= m_config.maxBlockSize );
@@ -202,6 +261,16 @@ namespace yojimbo
         if ( GetErrorLevel() != CHANNEL_ERROR_NONE )
             return NULL;
 
+        if ( !m_ordered )
+        {
+            if ( m_messageDeliveryQueue->IsEmpty() )
+                return NULL;
+
+            m_counters[CHANNEL_COUNTER_MESSAGES_RECEIVED]++;
+
+            return m_messageDeliveryQueue->Pop();
+        }
+
         MessageReceiveQueueEntry * entry = m_messageReceiveQueue->Find( m_receiveMessageId );
         if ( !entry )
             return NULL;
@@ -228,23 +297,7 @@ namespace yojimbo
 
         if ( SendingBlockMessage() )
         {
-            if (m_config.blockFragmentSize * 8 > availableBits)
-                return 0;
-
-            uint16_t messageId;
-            uint16_t fragmentId;
-            int fragmentBytes;
-            int numFragments;
-            int messageType;
-
-            uint8_t * fragmentData = GetFragmentToSend( messageId, fragmentId, fragmentBytes, numFragments, messageType );
-
-            if ( fragmentData )
-            {
-                const int fragmentBits = GetFragmentPacketData( packetData, messageId, fragmentId, fragmentData, fragmentBytes, numFragments, messageType );
-                AddFragmentPacketEntry( messageId, fragmentId, packetSequence );
-                return fragmentBits;
-            }
+            return GetBlockPacketData( packetData, packetSequence, availableBits );
         }
         else
         {
@@ -269,6 +322,11 @@ namespace yojimbo
         return m_oldestUnackedMessageId != m_sendMessageId;
     }
 
+    int ReliableOrderedChannel::GetSendQueueDepth() const
+    {
+        return (uint16_t) ( m_sendMessageId - m_oldestUnackedMessageId );
+    }
+
     int ReliableOrderedChannel::GetMessagesToSend( uint16_t * messageIds, int & numMessageIds, int availableBits, void *context )
     {
         yojimbo_assert( HasMessagesToSend() );
@@ -281,46 +339,75 @@ namespace yojimbo
         const int giveUpBits = 4 * 8;
         const int messageTypeBits = bits_required( 0, m_messageFactory->GetNumTypes() - 1 );
         const int messageLimit = yojimbo_min( m_config.messageSendQueueSize, m_config.messageReceiveQueueSize );
-        uint16_t previousMessageId = 0;
         int usedBits = ConservativeMessageHeaderBits;
         int giveUpCounter = 0;
 
-        for ( int i = 0; i < messageLimit; ++i )
+        // Due resends first, longest waiting first, then messages that have never been sent, oldest first. The unsent walk stops at the
+        // first block message, which has to go out on its own before anything after it, and at the end of the receiver's queue.
+
+        // Messages are picked out of id order, but are written in id order, the first id in 16 bits and each one after relative to the
+        // one before. So the picked ids are kept sorted, relative to the oldest unacked message so it works across wrap around, and each
+        // message is charged exactly what its id adds where it goes. Packets hold few messages, so inserting into the array is fine.
+
+        for ( int pass = 0; pass < 2; ++pass )
         {
-            if ( availableBits - usedBits < giveUpBits )
-                break;
+            int index = ( pass == 0 ) ? m_sentList.head : m_unsentList.head;
 
-            if ( giveUpCounter > m_config.messageSendQueueSize )
-                break;
+            while ( index >= 0 && numMessageIds < m_config.maxMessagesPerPacket )
+            {
+                if ( availableBits - usedBits < giveUpBits || giveUpCounter > m_config.messageSendQueueSize )
+                    break;
 
-            uint16_t messageId = m_oldestUnackedMessageId + i;
-            MessageSendQueueEntry * entry = m_messageSendQueue->Find( messageId );
-            if ( !entry )
-                continue;
+                MessageSendQueueEntry * entry = m_messageSendQueue->GetAtIndex( index );
 
-            if ( entry->block )
-                break;
+                yojimbo_assert( entry );
+                yojimbo_assert( entry->message );
+
+                index = entry->nextIndex;
+
+                if ( pass == 0 )
+                {
+                    if ( entry->timeLastSent + m_config.messageResendTime > m_time )
+                        break;
+                }
+                else
+                {
+                    if ( entry->block || uint16_t( entry->message->GetId() - m_oldestUnackedMessageId ) >= messageLimit )
+                        break;
+                }
+
+                // Messages that are too large to fit in a packet are rejected in SendMessage()
+                yojimbo_assert( (m_config.packetBudget <= 0 || entry->measuredBits <= uint32_t(m_config.packetBudget * 8)) && entry->measuredBits <= uint32_t(m_maxPacketSize * 8) );
 
-            // Messages that are too large to fit in a packet are rejected in SendMessage()
-            yojimbo_assert( (m_config.packetBudget <= 0 || entry->measuredBits <= uint32_t(m_config.packetBudget * 8)) && entry->measuredBits <= uint32_t(m_maxPacketSize * 8) );
-            
-            if ( entry->timeLastSent + m_config.messageResendTime <= m_time && availableBits >= (int) entry->measuredBits )
-            {                
-                int messageBits = entry->measuredBits + messageTypeBits;
-                
+                const uint16_t messageId = uint16_t( entry->message->GetId() );
+
+                int position = numMessageIds;
+                while ( position > 0 && uint16_t( messageIds[position-1] - m_oldestUnackedMessageId ) > uint16_t( messageId - m_oldestUnackedMessageId ) )
+                    position--;
+
+                int idBits;
                 if ( numMessageIds == 0 )
                 {
-                    messageBits += 16;
+                    idBits = 16;
+                }
+                else if ( position == 0 )
+                {
+                    // takes over the 16 bit id, and the id that had it is written relative to this one instead
+                    idBits = GetRelativeMessageIdBits( messageId, messageIds[0], context );
+                }
+                else if ( position == numMessageIds )
+                {
+                    idBits = GetRelativeMessageIdBits( messageIds[position-1], messageId, context );
                 }
                 else
                 {
-                    MeasureStream stream;
-                    stream.SetContext( context );
-                    stream.SetAllocator( &m_messageFactory->GetAllocator() );
-                    serialize_sequence_relative_internal( stream, previousMessageId, messageId );
-                    messageBits += stream.GetBitsProcessed();
+                    idBits = GetRelativeMessageIdBits( messageIds[position-1], messageId, context )
+                           + GetRelativeMessageIdBits( messageId, messageIds[position], context )
+                           - GetRelativeMessageIdBits( messageIds[position-1], messageIds[position], context );
                 }
 
+                const int messageBits = entry->measuredBits + messageTypeBits + idBits;
+
                 if ( usedBits + messageBits > availableBits )
                 {
                     giveUpCounter++;
@@ -328,18 +415,39 @@ namespace yojimbo
                 }
 
                 usedBits += messageBits;
-                messageIds[numMessageIds++] = messageId;
-                previousMessageId = messageId;
-                entry->timeLastSent = m_time;
+                for ( int i = numMessageIds; i > position; --i )
+                    messageIds[i] = messageIds[i-1];
+                messageIds[position] = messageId;
+                numMessageIds++;
             }
+        }
 
-            if ( numMessageIds == m_config.maxMessagesPerPacket )
-                break;
+        // Move the picked messages to the back of the sent list.
+
+        for ( int i = 0; i < numMessageIds; ++i )
+        {
+            const int index = m_messageSendQueue->GetIndex( messageIds[i] );
+            MessageSendQueueEntry * entry = m_messageSendQueue->GetAtIndex( index );
+
+            yojimbo_assert( entry );
+
+            UnlinkSendQueueEntry( entry->timeLastSent < 0.0 ? m_unsentList : m_sentList, index );
+            entry->timeLastSent = m_time;
+            LinkSendQueueEntry( m_sentList, index );
         }
 
         return usedBits;
     }
 
+    int ReliableOrderedChannel::GetRelativeMessageIdBits( uint16_t previousMessageId, uint16_t messageId, void * context ) const
+    {
+        MeasureStream stream;
+        stream.SetContext( context );
+        stream.SetAllocator( &m_messageFactory->GetAllocator() );
+        serialize_sequence_relative_internal( stream, previousMessageId, messageId );
+        return stream.GetBitsProcessed();
+    }
+
     bool ReliableOrderedChannel::GetMessagePacketData( ChannelPacketData & packetData, const uint16_t * messageIds, int numMessageIds )
     {
         yojimbo_assert( messageIds );
@@ -384,6 +492,8 @@ namespace yojimbo
         {
             sentPacket->acked = 0;
             sentPacket->block = 0;
+            sentPacket->fragments = NULL;
+            sentPacket->numFragments = 0;
             sentPacket->timeSent = m_time;
             sentPacket->messageIds = &m_sentPacketMessageIds[ ( sequence % m_config.sentPacketBufferSize ) * m_config.maxMessagesPerPacket ];
             sentPacket->numMessageIds = numMessageIds;            
@@ -423,18 +533,56 @@ namespace yojimbo
 
             yojimbo_assert( !m_messageReceiveQueue->GetAtIndex( m_messageReceiveQueue->GetIndex( messageId ) ) );
 
-            MessageReceiveQueueEntry * entry = m_messageReceiveQueue->Insert( messageId );
-            if ( !entry )
-            {
-                // For some reason we can't insert the message in the receive queue
-                SetErrorLevel( CHANNEL_ERROR_DESYNC );
+            if ( !AddReceivedMessage( message ) )
                 return;
-            }
 
+            m_messageFactory->AcquireMessage( message );
+        }
+    }
+
+    bool ReliableOrderedChannel::AddReceivedMessage( Message * message )
+    {
+        yojimbo_assert( message );
+
+        const uint16_t messageId = message->GetId();
+
+        if ( !m_ordered && m_messageDeliveryQueue->IsFull() )
+        {
+            // Did you forget to dequeue messages on the receiver?
+            yojimbo_printf( YOJIMBO_LOG_LEVEL_ERROR, "receive queue overflow: message %d\n", messageId );
+            SetErrorLevel( CHANNEL_ERROR_DESYNC );
+            return false;
+        }
+
+        MessageReceiveQueueEntry * entry = m_messageReceiveQueue->Insert( messageId );
+        if ( !entry )
+        {
+            // For some reason we can't insert the message in the receive queue
+            SetErrorLevel( CHANNEL_ERROR_DESYNC );
+            return false;
+        }
+
+        if ( m_ordered )
+        {
             entry->message = message;
+            return true;
+        }
 
-            m_messageFactory->AcquireMessage( message );
+        // Reliable-unordered: hand the message out right away and keep only a marker in the
+        // receive window, then slide the window forward past every message received so far.
+        // Anything older than the window start has been received, so it's a duplicate.
+
+        entry->message = NULL;
+
+        m_messageDeliveryQueue->Push( message );
+
+        while ( m_messageReceiveQueue->Find( m_receiveMessageId ) )
+        {
+            m_messageReceiveQueue->Remove( m_receiveMessageId );
+            m_receiveMessageId++;
         }
+
+        return true;
     }
 
     void ReliableOrderedChannel::ProcessPacketData( const ChannelPacketData & packetData, uint16_t packetSequence )
@@ -453,13 +601,12 @@ namespace yojimbo
 
         if ( packetData.blockMessage )
         {
-            ProcessPacketFragment( packetData.block.messageType, 
-                                   packetData.block.messageId, 
-                                   packetData.block.numFragments, 
-                                   packetData.block.fragmentId, 
-                                   packetData.block.fragmentData, 
-                                   packetData.block.fragmentSize, 
-                                   packetData.block.message );
+            ProcessPacketFragment( packetData.block );
+
+            for ( int i = 0; i < packetData.numExtraFragments && m_errorLevel == CHANNEL_ERROR_NONE; ++i )
+            {
+                ProcessPacketFragment( packetData.extraFragments[i] );
+            }
         }
         else
         {
@@ -468,48 +615,133 @@ namespace yojimbo
     }
 
     void ReliableOrderedChannel::ProcessAck( uint16_t ack )
+    {
+        if ( AckPacket( ack ) )
+            UpdateOldestUnackedMessageId();
+    }
+
+    void ReliableOrderedChannel::ProcessAcks( const uint16_t * acks, int numAcks )
+    {
+        bool removedMessages = false;
+
+        for ( int i = 0; i < numAcks; ++i )
+        {
+            if ( AckPacket( acks[i] ) )
+                removedMessages = true;
+        }
+
+        if ( removedMessages )
+            UpdateOldestUnackedMessageId();
+    }
+
+    bool ReliableOrderedChannel::AckPacket( uint16_t ack )
     {
         SentPacketEntry * sentPacketEntry = m_sentPackets->Find( ack );
         if ( !sentPacketEntry )
-            return;
+            return false;
+
+        bool removedMessages = false;
 
         yojimbo_assert( !sentPacketEntry->acked );
         sentPacketEntry->acked = true;
 
+        // Smooth the round trip time the same way reliable does. Block fragment resends are timed from it.
+
+        const double rtt = yojimbo_max( m_time - sentPacketEntry->timeSent, 0.0 );
+        m_rtt = m_rtt < 0.0 ? rtt : m_rtt + ( rtt - m_rtt ) * 0.1;
+
         for ( int i = 0; i < (int) sentPacketEntry->numMessageIds; ++i )
         {
             const uint16_t messageId = sentPacketEntry->messageIds[i];
-            MessageSendQueueEntry * sendQueueEntry = m_messageSendQueue->Find( messageId );
-            if ( sendQueueEntry )
+            if ( m_messageSendQueue->Find( messageId ) )
             {
-                yojimbo_assert( sendQueueEntry->message );
-                yojimbo_assert( sendQueueEntry->message->GetId() == messageId );
-                m_messageFactory->ReleaseMessage( sendQueueEntry->message );
-                m_messageSendQueue->Remove( messageId );
-                UpdateOldestUnackedMessageId();
+                RemoveSentMessage( messageId );
+                removedMessages = true;
             }
         }
 
-        if ( !m_config.disableBlocks && sentPacketEntry->block && m_sendBlock->active && m_sendBlock->blockMessageId == sentPacketEntry->blockMessageId )
-        {        
-            const int messageId = sentPacketEntry->blockMessageId;
-            const int fragmentId = sentPacketEntry->blockFragmentId;
+        for ( int i = 0; i < (int) sentPacketEntry->numFragments; ++i )
+        {
+            const uint16_t messageId = sentPacketEntry->fragments[i].messageId;
+            const int fragmentId = int( sentPacketEntry->fragments[i].fragmentId );
+
+            SendBlockData * sendBlock = m_sendBlocks[ messageId % m_config.maxBlocksInFlight ];
 
-            if ( !m_sendBlock->ackedFragment->GetBit( fragmentId ) )
+            if ( !sendBlock->active || sendBlock->blockMessageId != messageId || fragmentId < sendBlock->baseFragment )
+                continue;
+
+            const int index = sendBlock->GetFragmentIndex( fragmentId, m_config.streamWindowSize );
+
+            if ( sendBlock->ackedFragment->GetBit( index ) )
+                continue;
+
+            sendBlock->ackedFragment->SetBit( index );
+            sendBlock->numAckedFragments++;
+
+            if ( sendBlock->stream )
             {
-                m_sendBlock->ackedFragment->SetBit( fragmentId );
-                m_sendBlock->numAckedFragments++;
-                if ( m_sendBlock->numAckedFragments == m_sendBlock->numFragments )
+                // Slide the stream window past the acked fragments at its start. The slots they free up are reused for the fragments entering the window.
+
+                while ( sendBlock->baseFragment < sendBlock->numFragments )
                 {
-                    m_sendBlock->active = false;
-                    MessageSendQueueEntry * sendQueueEntry = m_messageSendQueue->Find( messageId );
-                    yojimbo_assert( sendQueueEntry );
-                    m_messageFactory->ReleaseMessage( sendQueueEntry->message );
-                    m_messageSendQueue->Remove( messageId );
-                    UpdateOldestUnackedMessageId();
+                    const int baseIndex = sendBlock->GetFragmentIndex( sendBlock->baseFragment, m_config.streamWindowSize );
+                    if ( !sendBlock->ackedFragment->GetBit( baseIndex ) )
+                        break;
+                    sendBlock->ackedFragment->ClearBit( baseIndex );
+                    sendBlock->fragmentSendTime[baseIndex] = -1.0;
+                    sendBlock->baseFragment++;
                 }
             }
+
+            if ( sendBlock->numAckedFragments == sendBlock->numFragments )
+            {
+                sendBlock->Reset();
+                RemoveSentMessage( messageId );
+                removedMessages = true;
+            }
         }
+
+        return removedMessages;
+    }
+
+    void ReliableOrderedChannel::RemoveSentMessage( uint16_t messageId )
+    {
+        MessageSendQueueEntry * entry = m_messageSendQueue->Find( messageId );
+        yojimbo_assert( entry );
+        yojimbo_assert( entry->message );
+        yojimbo_assert( entry->message->GetId() == messageId );
+        UnlinkSendQueueEntry( entry->timeLastSent < 0.0 ? m_unsentList : m_sentList, m_messageSendQueue->GetIndex( messageId ) );
+        m_messageFactory->ReleaseMessage( entry->message );
+        m_messageSendQueue->Remove( messageId );
+    }
+
+    void ReliableOrderedChannel::LinkSendQueueEntry( SendList & list, int index )
+    {
+        MessageSendQueueEntry * entry = m_messageSendQueue->GetAtIndex( index );
+        yojimbo_assert( entry );
+        entry->prevIndex = list.tail;
+        entry->nextIndex = -1;
+        if ( list.tail >= 0 )
+            m_messageSendQueue->GetAtIndex( list.tail )->nextIndex = index;
+        else
+            list.head = index;
+        list.tail = index;
+    }
+
+    void ReliableOrderedChannel::UnlinkSendQueueEntry( SendList & list, int index )
+    {
+        MessageSendQueueEntry * entry = m_messageSendQueue->GetAtIndex( index );
+        yojimbo_assert( entry );
+        if ( entry->prevIndex >= 0 )
+            m_messageSendQueue->GetAtIndex( entry->prevIndex )->nextIndex = entry->nextIndex;
+        else
+            list.head = entry->nextIndex;
+        if ( entry->nextIndex >= 0 )
+            m_messageSendQueue->GetAtIndex( entry->nextIndex )->prevIndex = entry->prevIndex;
+        else
+            list.tail = entry->prevIndex;
+        entry->prevIndex = -1;
+        entry->nextIndex = -1;
     }
 
     void ReliableOrderedChannel::UpdateOldestUnackedMessageId()
@@ -537,130 +769,302 @@ namespace yojimbo
         return entry ? entry->block : false;
     }
 
-    uint8_t * ReliableOrderedChannel::GetFragmentToSend( uint16_t & messageId, uint16_t & fragmentId, int & fragmentBytes, int & numFragments, int & messageType )
+
+    ReliableOrderedChannel::SendBlockData * ReliableOrderedChannel::StartSendingBlock( uint16_t messageId )
     {
-        MessageSendQueueEntry * entry = m_messageSendQueue->Find( m_oldestUnackedMessageId );
+        SendBlockData * sendBlock = m_sendBlocks[ messageId % m_config.maxBlocksInFlight ];
+
+        if ( sendBlock->active )
+        {
+            // Blocks in flight are consecutive message ids, so the previous block in this slot was acked before this one entered the window.
+            yojimbo_assert( sendBlock->blockMessageId == messageId );
+            return sendBlock;
+        }
+
+        MessageSendQueueEntry * entry = m_messageSendQueue->Find( messageId );
 
         yojimbo_assert( entry );
         yojimbo_assert( entry->block );
 
         BlockMessage * blockMessage = (BlockMessage*) entry->message;
 
-        yojimbo_assert( blockMessage );
+        sendBlock->active = true;
+        sendBlock->stream = blockMessage->IsBlockStream();
+        sendBlock->blockSize = blockMessage->GetBlockSize();
+        sendBlock->streamSize = blockMessage->GetBlockStreamSize();
+        sendBlock->blockMessageId = messageId;
+        sendBlock->numAckedFragments = 0;
+        sendBlock->baseFragment = 0;
+
+        int numTracked;
+
+        if ( sendBlock->stream )
+        {
+            sendBlock->numFragments = int( ( sendBlock->streamSize + m_config.blockFragmentSize - 1 ) / m_config.blockFragmentSize );
+            numTracked = yojimbo_min( sendBlock->numFragments, m_config.streamWindowSize );
+        }
+        else
+        {
+            CompressBlock( *sendBlock, *blockMessage );
+            sendBlock->numFragments = ( sendBlock->blockSize + m_config.blockFragmentSize - 1 ) / m_config.blockFragmentSize;
+            numTracked = sendBlock->numFragments;
+            yojimbo_assert( sendBlock->numFragments <= m_config.GetMaxFragmentsPerBlock() );
+        }
+
+        yojimbo_assert( sendBlock->numFragments > 0 );
 
-        messageId = blockMessage->GetId();
+        sendBlock->ackedFragment->Clear();
 
-        const int blockSize = blockMessage->GetBlockSize();
+        for ( int i = 0; i < numTracked; ++i )
+            sendBlock->fragmentSendTime[i] = -1.0;
 
-        if ( !m_sendBlock->active )
+        return sendBlock;
+    }
+
+    void ReliableOrderedChannel::CompressBlock( SendBlockData & sendBlock, BlockMessage & blockMessage )
+    {
+        yojimbo_assert( !sendBlock.compressedData );
+
+        if ( !m_config.compressBlocks || sendBlock.blockSize < 2 )
+            return;
+
+        // Only keep the compressed block if it is smaller, so a block never costs more to send because it is compressed.
+
+        uint8_t * compressedData = (uint8_t*) YOJIMBO_ALLOCATE( *m_allocator, sendBlock.blockSize - 1 );
+        if ( !compressedData )
+            return;
+
+        const int compressedSize = yojimbo_compress( blockMessage.GetBlockData(), sendBlock.blockSize, compressedData, sendBlock.blockSize - 1, m_config.compressionDictionary, m_config.compressionDictionaryBytes );
+
+        if ( compressedSize == 0 )
         {
-            // start sending this block
+            YOJIMBO_FREE( *m_allocator, compressedData );
+            return;
+        }
+
+        sendBlock.compressedData = compressedData;
+        sendBlock.uncompressedSize = sendBlock.blockSize;
+        sendBlock.blockSize = compressedSize;
+    }
+
+    bool ReliableOrderedChannel::DecompressBlock( ReceiveBlockData & receiveBlock )
+    {
+        yojimbo_assert( receiveBlock.uncompressedSize > 0 );
+        yojimbo_assert( receiveBlock.uncompressedSize <= m_config.maxBlockSize );
 
-            m_sendBlock->active = true;
-            m_sendBlock->blockSize = blockSize;
-            m_sendBlock->blockMessageId = messageId;
-            m_sendBlock->numFragments = (int) ceil( blockSize / float( m_config.blockFragmentSize ) );
-            m_sendBlock->numAckedFragments = 0;
+        Allocator & allocator = m_messageFactory->GetAllocator();
 
-            const int MaxFragmentsPerBlock = m_config.GetMaxFragmentsPerBlock();
+        uint8_t * blockData = (uint8_t*) YOJIMBO_ALLOCATE( allocator, receiveBlock.uncompressedSize );
 
-            yojimbo_assert( m_sendBlock->numFragments > 0 );
-            yojimbo_assert( m_sendBlock->numFragments <= MaxFragmentsPerBlock );
+        if ( !blockData )
+        {
+            SetErrorLevel( CHANNEL_ERROR_OUT_OF_MEMORY );
+            return false;
+        }
 
-            m_sendBlock->ackedFragment->Clear();
+        const int blockSize = yojimbo_decompress( receiveBlock.blockData, int( receiveBlock.blockSize ), blockData, receiveBlock.uncompressedSize, m_config.compressionDictionary, m_config.compressionDictionaryBytes );
 
-            for ( int i = 0; i < MaxFragmentsPerBlock; ++i )
-                m_sendBlock->fragmentSendTime[i] = -1.0;
+        if ( blockSize != receiveBlock.uncompressedSize )
+        {
+            // The block is corrupt, or its size doesn't match the size sent with fragment 0.
+            YOJIMBO_FREE( allocator, blockData );
+            SetErrorLevel( CHANNEL_ERROR_DESYNC );
+            return false;
         }
 
-        numFragments = m_sendBlock->numFragments;
+        YOJIMBO_FREE( allocator, receiveBlock.blockData );
+
+        receiveBlock.blockData = blockData;
+        receiveBlock.blockDataSize = blockSize;
+        receiveBlock.blockSize = uint32_t( blockSize );
+
+        return true;
+    }
+
+    int ReliableOrderedChannel::GetFragmentBytes( const SendBlockData & sendBlock, int fragmentId ) const
+    {
+        const int fragmentRemainder = sendBlock.stream ? int( sendBlock.streamSize % m_config.blockFragmentSize ) : sendBlock.blockSize % m_config.blockFragmentSize;
+
+        if ( fragmentRemainder && fragmentId == sendBlock.numFragments - 1 )
+            return fragmentRemainder;
 
-        // find the next fragment to send (there may not be one)
+        return m_config.blockFragmentSize;
+    }
 
-        fragmentId = 0xFFFF;
+    double ReliableOrderedChannel::GetFragmentResendTime() const
+    {
+        // Resend a little after the ack should have arrived. The floor stops fragments going out
+        // every tick over loopback, where acks come back in the same tick the packet was sent.
+        if ( m_rtt < 0.0 )
+            return m_config.blockFragmentResendTime;
+
+        return yojimbo_max( m_rtt * 1.5, 0.01 );
+    }
 
-        for ( int i = 0; i < m_sendBlock->numFragments; ++i )
+    int ReliableOrderedChannel::GetBlockPacketData( ChannelPacketData & packetData, uint16_t packetSequence, int availableBits )
+    {
+        // The first fragment may use the rest of the packet, like a block always could. Any more fragments also respect the channel budget.
+
+        const int budgetBits = m_config.packetBudget > 0 ? yojimbo_min( m_config.packetBudget * 8, availableBits ) : availableBits;
+        const int messageTypeBits = bits_required( 0, m_messageFactory->GetNumTypes() - 1 );
+        const double resendTime = GetFragmentResendTime();
+
+        SentFragmentEntry * fragments = m_packetFragments;
+        int numFragments = 0;
+        int usedBits = bits_required( 1, m_config.maxFragmentsPerPacket );
+        bool packetFull = false;
+
+        for ( int i = 0; i < m_config.maxBlocksInFlight && !packetFull; ++i )
         {
-            if ( !m_sendBlock->ackedFragment->GetBit( i ) && m_sendBlock->fragmentSendTime[i] + m_config.blockFragmentResendTime < m_time )
-            {
-                fragmentId = uint16_t( i );
+            const uint16_t messageId = m_oldestUnackedMessageId + i;
+
+            MessageSendQueueEntry * entry = m_messageSendQueue->Find( messageId );
+            if ( !entry || !entry->block )
                 break;
+
+            SendBlockData * sendBlock = StartSendingBlock( messageId );
+
+            // A stream only sends the fragments inside its window, so the receiver never has to hold more than the window either.
+
+            const int firstFragment = sendBlock->baseFragment;
+            const int endFragment = sendBlock->stream ? yojimbo_min( sendBlock->numFragments, sendBlock->baseFragment + m_config.streamWindowSize ) : sendBlock->numFragments;
+
+            for ( int fragmentId = firstFragment; fragmentId < endFragment; ++fragmentId )
+            {
+                const int index = sendBlock->GetFragmentIndex( fragmentId, m_config.streamWindowSize );
+
+                if ( sendBlock->ackedFragment->GetBit( index ) || sendBlock->fragmentSendTime[index] + resendTime > m_time )
+                    continue;
+
+                int fragmentBits = ConservativeFragmentHeaderBits + GetFragmentBytes( *sendBlock, fragmentId ) * 8;
+
+                if ( fragmentId == 0 )
+                    fragmentBits += entry->measuredBits + messageTypeBits + ( sendBlock->stream ? 64 : 0 ) + ( m_config.compressBlocks ? 33 : 0 );
+
+                if ( usedBits + fragmentBits > ( numFragments == 0 ? availableBits : budgetBits ) )
+                {
+                    packetFull = true;
+                    break;
+                }
+
+                usedBits += fragmentBits;
+
+                fragments[numFragments].messageId = messageId;
+                fragments[numFragments].fragmentId = uint32_t( fragmentId );
+                numFragments++;
+
+                if ( numFragments == m_config.maxFragmentsPerPacket )
+                {
+                    packetFull = true;
+                    break;
+                }
             }
         }
 
-        if ( fragmentId == 0xFFFF )
-            return NULL;
+        if ( numFragments == 0 )
+            return 0;
 
-        // allocate and return a copy of the fragment data
+        Allocator & allocator = m_messageFactory->GetAllocator();
 
-        messageType = blockMessage->GetType();
+        packetData.Initialize();
+        packetData.channelIndex = GetChannelIndex();
+        packetData.blockMessage = 1;
 
-        fragmentBytes = m_config.blockFragmentSize;
-        
-        const int fragmentRemainder = blockSize % m_config.blockFragmentSize;
+        if ( numFragments > 1 )
+        {
+            packetData.extraFragments = (ChannelPacketData::BlockData*) YOJIMBO_ALLOCATE( allocator, sizeof( ChannelPacketData::BlockData ) * ( numFragments - 1 ) );
 
-        if ( fragmentRemainder && fragmentId == m_sendBlock->numFragments - 1 )
-            fragmentBytes = fragmentRemainder;
+            if ( !packetData.extraFragments )
+            {
+                SetErrorLevel( CHANNEL_ERROR_OUT_OF_MEMORY );
+                return 0;
+            }
 
-        uint8_t * fragmentData = (uint8_t*) YOJIMBO_ALLOCATE( m_messageFactory->GetAllocator(), fragmentBytes );
+            memset( packetData.extraFragments, 0, sizeof( ChannelPacketData::BlockData ) * ( numFragments - 1 ) );
+            packetData.numExtraFragments = numFragments - 1;
+        }
 
-        if ( fragmentData )
+        for ( int i = 0; i < numFragments; ++i )
         {
-            memcpy( fragmentData, blockMessage->GetBlockData() + fragmentId * m_config.blockFragmentSize, fragmentBytes );
+            ChannelPacketData::BlockData & block = ( i == 0 ) ? packetData.block : packetData.extraFragments[i-1];
 
-            m_sendBlock->fragmentSendTime[fragmentId] = m_time;
+            const SendBlockData & sendBlock = *m_sendBlocks[ fragments[i].messageId % m_config.maxBlocksInFlight ];
+
+            if ( !GetFragmentData( block, sendBlock, int( fragments[i].fragmentId ) ) )
+            {
+                // Out of memory, or the stream failed. Free the fragments copied so far and send nothing for this channel.
+                packetData.Free( *m_messageFactory );
+                return 0;
+            }
+        }
+
+        for ( int i = 0; i < numFragments; ++i )
+        {
+            SendBlockData * sendBlock = m_sendBlocks[ fragments[i].messageId % m_config.maxBlocksInFlight ];
+            sendBlock->fragmentSendTime[ sendBlock->GetFragmentIndex( int( fragments[i].fragmentId ), m_config.streamWindowSize ) ] = m_time;
         }
 
-        return fragmentData;
+        AddFragmentPacketEntry( numFragments, packetSequence );
+
+        return usedBits;
     }
 
-    int ReliableOrderedChannel::GetFragmentPacketData( ChannelPacketData & packetData, 
-                                                       uint16_t messageId, 
-                                                       uint16_t fragmentId, 
-                                                       uint8_t * fragmentData, 
-                                                       int fragmentSize, 
-                                                       int numFragments, 
-                                                       int messageType )
+    bool ReliableOrderedChannel::GetFragmentData( ChannelPacketData::BlockData & block, const SendBlockData & sendBlock, int fragmentId )
     {
-        packetData.Initialize();
-
-        packetData.channelIndex = GetChannelIndex();
+        MessageSendQueueEntry * entry = m_messageSendQueue->Find( sendBlock.blockMessageId );
 
-        packetData.blockMessage = 1;
+        yojimbo_assert( entry );
+        yojimbo_assert( entry->message );
 
-        packetData.block.fragmentData = fragmentData;
-        packetData.block.messageId = messageId;
-        packetData.block.fragmentId = fragmentId;
-        packetData.block.fragmentSize = fragmentSize;
-        packetData.block.numFragments = numFragments;
-        packetData.block.messageType = messageType;
+        BlockMessage * blockMessage = (BlockMessage*) entry->message;
 
-        const int messageTypeBits = bits_required( 0, m_messageFactory->GetNumTypes() - 1 );
+        const int fragmentBytes = GetFragmentBytes( sendBlock, fragmentId );
 
-        int fragmentBits = ConservativeFragmentHeaderBits + fragmentSize * 8;
+        block.fragmentData = (uint8_t*) YOJIMBO_ALLOCATE( m_messageFactory->GetAllocator(), fragmentBytes );
 
-        if ( fragmentId == 0 )
+        if ( !block.fragmentData )
         {
-            MessageSendQueueEntry * entry = m_messageSendQueue->Find( packetData.block.messageId );
-
-            yojimbo_assert( entry );
-            yojimbo_assert( entry->message );
+            SetErrorLevel( CHANNEL_ERROR_OUT_OF_MEMORY );
+            return false;
+        }
 
-            packetData.block.message = (BlockMessage*) entry->message;
+        if ( sendBlock.stream )
+        {
+            if ( !blockMessage->ReadBlockStream( uint64_t( fragmentId ) * m_config.blockFragmentSize, block.fragmentData, fragmentBytes ) )
+            {
+                SetErrorLevel( CHANNEL_ERROR_STREAM_FAILED );
+                return false;
+            }
+        }
+        else
+        {
+            const uint8_t * blockData = sendBlock.compressedData ? sendBlock.compressedData : blockMessage->GetBlockData();
+            memcpy( block.fragmentData, blockData + fragmentId * m_config.blockFragmentSize, fragmentBytes );
+        }
 
-            m_messageFactory->AcquireMessage( packetData.block.message );
+        block.messageId = sendBlock.blockMessageId;
+        block.fragmentId = uint32_t( fragmentId );
+        block.fragmentSize = uint16_t( fragmentBytes );
+        block.numFragments = sendBlock.stream ? 0 : uint16_t( sendBlock.numFragments );
+        block.isStream = sendBlock.stream;
+        block.streamSize = ( sendBlock.stream && fragmentId == 0 ) ? sendBlock.streamSize : 0;
+        block.messageType = blockMessage->GetType();
+        block.uncompressedSize = fragmentId == 0 ? sendBlock.uncompressedSize : 0;
 
-            fragmentBits += entry->measuredBits + messageTypeBits;
+        if ( fragmentId == 0 )
+        {
+            block.message = blockMessage;
+            m_messageFactory->AcquireMessage( block.message );
         }
         else
         {
-            packetData.block.message = NULL;
+            block.message = NULL;
         }
 
-        return fragmentBits;
+        return true;
     }
 
-    void ReliableOrderedChannel::AddFragmentPacketEntry( uint16_t messageId, uint16_t fragmentId, uint16_t sequence )
+    void ReliableOrderedChannel::AddFragmentPacketEntry( int numFragments, uint16_t sequence )
     {
         SentPacketEntry * sentPacket = m_sentPackets->Insert( sequence, true );
         yojimbo_assert( sentPacket );
@@ -671,143 +1075,343 @@ namespace yojimbo
             sentPacket->timeSent = m_time;
             sentPacket->acked = 0;
             sentPacket->block = 1;
-            sentPacket->blockMessageId = messageId;
-            sentPacket->blockFragmentId = fragmentId;
+            sentPacket->fragments = &m_sentPacketFragments[ ( sequence % m_config.sentPacketBufferSize ) * m_config.maxFragmentsPerPacket ];
+            sentPacket->numFragments = uint16_t( numFragments );
+            for ( int i = 0; i < numFragments; ++i )
+            {
+                sentPacket->fragments[i] = m_packetFragments[i];
+            }
         }
     }
 
-    void ReliableOrderedChannel::ProcessPacketFragment( int messageType, 
-                                                        uint16_t messageId, 
-                                                        int numFragments, 
-                                                        uint16_t fragmentId, 
-                                                        const uint8_t * fragmentData, 
-                                                        int fragmentBytes, 
-                                                        BlockMessage * blockMessage )
-    {  
+    void ReliableOrderedChannel::ProcessPacketFragment( const ChannelPacketData::BlockData & block )
+    {
         yojimbo_assert( !m_config.disableBlocks );
 
-        if ( fragmentData )
+        if ( !block.fragmentData )
+            return;
+
+        const uint16_t messageId = block.messageId;
+        const int numFragments = block.numFragments;
+        const int fragmentId = block.fragmentId;
+        const int fragmentBytes = block.fragmentSize;
+
+        if ( yojimbo_sequence_less_than( messageId, m_receiveMessageId ) )
+            return;
+
+        if ( yojimbo_sequence_greater_than( messageId, uint16_t( m_receiveMessageId + m_config.messageReceiveQueueSize - 1 ) ) )
         {
-            const uint16_t expectedMessageId = m_messageReceiveQueue->GetSequence();
-            if ( messageId != expectedMessageId )
-                return;
+            // Did you forget to dequeue messages on the receiver?
+            SetErrorLevel( CHANNEL_ERROR_DESYNC );
+            return;
+        }
+
+        if ( m_messageReceiveQueue->Find( messageId ) )
+            return;
+
+        ReceiveBlockData * receiveBlock = m_receiveBlocks[ messageId % m_config.maxBlocksInFlight ];
+
+        if ( receiveBlock->active && receiveBlock->messageId != messageId )
+        {
+            // A well behaved sender never has two blocks in flight that share a slot. Drop the fragment.
+            return;
+        }
+
+        if ( receiveBlock->active && receiveBlock->stream != bool( block.isStream ) )
+        {
+            // The same message can't be both a block and a stream.
+            SetErrorLevel( CHANNEL_ERROR_DESYNC );
+            return;
+        }
+
+        if ( block.isStream )
+        {
+            ProcessStreamFragment( block, *receiveBlock );
+            return;
+        }
+
+        // start receiving a new block
+
+        if ( !receiveBlock->active )
+        {
+            yojimbo_assert( numFragments >= 0 );
+            yojimbo_assert( numFragments <= m_config.GetMaxFragmentsPerBlock() );
+
+            yojimbo_assert( !receiveBlock->blockData );
 
-            // start receiving a new block
+            const int blockDataSize = yojimbo_min( numFragments * m_config.blockFragmentSize, m_config.maxBlockSize );
 
-            if ( !m_receiveBlock->active )
+            receiveBlock->blockData = (uint8_t*) YOJIMBO_ALLOCATE( m_messageFactory->GetAllocator(), blockDataSize );
+
+            if ( !receiveBlock->blockData )
             {
-                yojimbo_assert( numFragments >= 0 );
-                yojimbo_assert( numFragments <= m_config.GetMaxFragmentsPerBlock() );
-
-                m_receiveBlock->active = true;
-                m_receiveBlock->numFragments = numFragments;
-                m_receiveBlock->numReceivedFragments = 0;
-                m_receiveBlock->messageId = messageId;
-                m_receiveBlock->blockSize = 0;
-                m_receiveBlock->receivedFragment->Clear();
+                SetErrorLevel( CHANNEL_ERROR_OUT_OF_MEMORY );
+                return;
             }
 
-            // validate fragment
+            receiveBlock->active = true;
+            receiveBlock->numFragments = numFragments;
+            receiveBlock->numReceivedFragments = 0;
+            receiveBlock->messageId = messageId;
+            receiveBlock->blockSize = 0;
+            receiveBlock->blockDataSize = blockDataSize;
+            receiveBlock->receivedFragment->Clear();
+        }
+
+        // validate fragment
+
+        if ( fragmentId >= receiveBlock->numFragments )
+        {
+            // The fragment id is out of range.
+            SetErrorLevel( CHANNEL_ERROR_DESYNC );
+            return;
+        }
+
+        if ( numFragments != receiveBlock->numFragments )
+        {
+            // The number of fragments is out of range.
+            SetErrorLevel( CHANNEL_ERROR_DESYNC );
+            return;
+        }
+
+        // Validate the fragment write against the receive buffer BEFORE copying.
+        // blockData is allocated at min(numFragments * blockFragmentSize, maxBlockSize) bytes, but when maxBlockSize
+        // is not a multiple of blockFragmentSize the fragment count rounds up, so the final fragment
+        // starts at an offset where a full blockFragmentSize write would run past the buffer.
+        // fragmentBytes is attacker-controlled in [1,blockFragmentSize] (see SerializeBlockFragment),
+        // so a peer can send an over-long final fragment. Reject anything that wouldn't fit
+        // rather than overflowing the heap (the blockSize check below only runs after the copy).
+        if ( fragmentId * m_config.blockFragmentSize + fragmentBytes > receiveBlock->blockDataSize )
+        {
+            // The fragment would write past the end of the block buffer.
+            SetErrorLevel( CHANNEL_ERROR_DESYNC );
+            return;
+        }
+
+        // receive the fragment
+
+        if ( receiveBlock->receivedFragment->GetBit( fragmentId ) )
+            return;
+
+        receiveBlock->receivedFragment->SetBit( fragmentId );
+
+        memcpy( receiveBlock->blockData + fragmentId * m_config.blockFragmentSize, block.fragmentData, fragmentBytes );
+
+        if ( fragmentId == 0 )
+        {
+            receiveBlock->messageType = block.messageType;
+            receiveBlock->uncompressedSize = block.uncompressedSize;
+        }
 
-            if ( fragmentId >= m_receiveBlock->numFragments )
+        if ( fragmentId == receiveBlock->numFragments - 1 )
+        {
+            receiveBlock->blockSize = ( receiveBlock->numFragments - 1 ) * m_config.blockFragmentSize + fragmentBytes;
+
+            if ( receiveBlock->blockSize > (uint32_t) m_config.maxBlockSize )
             {
-                // The fragment id is out of range.
+                // The block size is outside range
                 SetErrorLevel( CHANNEL_ERROR_DESYNC );
                 return;
             }
+        }
+
+        receiveBlock->numReceivedFragments++;
 
-            if ( numFragments != m_receiveBlock->numFragments )
+        if ( fragmentId == 0 )
+        {
+            // save block message (sent with fragment 0)
+            receiveBlock->blockMessage = block.message;
+            m_messageFactory->AcquireMessage( receiveBlock->blockMessage );
+        }
+
+        if ( receiveBlock->numReceivedFragments == receiveBlock->numFragments )
+        {
+            // finished receiving block
+
+            if ( m_messageReceiveQueue->GetAtIndex( m_messageReceiveQueue->GetIndex( messageId ) ) )
             {
-                // The number of fragments is out of range.
+                // Did you forget to dequeue messages on the receiver?
                 SetErrorLevel( CHANNEL_ERROR_DESYNC );
                 return;
             }
 
-            // Validate the fragment write against the receive buffer BEFORE copying.
-            // blockData is allocated at maxBlockSize bytes, but when maxBlockSize is not a
-            // multiple of blockFragmentSize the fragment count rounds up, so the final fragment
-            // starts at an offset where a full blockFragmentSize write would run past the buffer.
-            // fragmentBytes is attacker-controlled in [1,blockFragmentSize] (see SerializeBlockFragment),
-            // so a peer can send an over-long final fragment. Reject anything that wouldn't fit
-            // rather than overflowing the heap (the blockSize check below only runs after the copy).
-            if ( fragmentId * m_config.blockFragmentSize + fragmentBytes > m_config.maxBlockSize )
+            if ( receiveBlock->uncompressedSize > 0 && !DecompressBlock( *receiveBlock ) )
+                return;
+
+            BlockMessage * blockMessage = receiveBlock->blockMessage;
+
+            yojimbo_assert( blockMessage );
+
+            // Hand the reassembly buffer straight to the message. It may be a little larger than the block, which is fine.
+
+            blockMessage->AttachBlock( m_messageFactory->GetAllocator(), receiveBlock->blockData, receiveBlock->blockSize );
+
+            blockMessage->SetId( messageId );
+
+            receiveBlock->Reset();
+            receiveBlock->blockData = NULL;
+            receiveBlock->blockMessage = NULL;
+
+            if ( !AddReceivedMessage( blockMessage ) )
             {
-                // The fragment would write past the end of the block buffer.
-                SetErrorLevel( CHANNEL_ERROR_DESYNC );
+                m_messageFactory->ReleaseMessage( blockMessage );
                 return;
             }
+        }
+    }
+
+    void ReliableOrderedChannel::ProcessStreamFragment( const ChannelPacketData::BlockData & block, ReceiveBlockData & receiveBlock )
+    {
+        yojimbo_assert( m_config.streamWindowSize > 0 );
+
+        if ( !m_streamWriteFunction )
+        {
+            // A stream arrived, but there is nowhere to write it. See SetBlockStreamWriteFunction.
+            SetErrorLevel( CHANNEL_ERROR_STREAM_FAILED );
+            return;
+        }
 
-            // receive the fragment
+        const int windowSize = m_config.streamWindowSize;
+        const int fragmentSize = m_config.blockFragmentSize;
 
-            if ( !m_receiveBlock->receivedFragment->GetBit( fragmentId ) )
+        // start receiving a new stream
+
+        if ( !receiveBlock.active )
+        {
+            yojimbo_assert( !receiveBlock.blockData );
+
+            receiveBlock.blockData = (uint8_t*) YOJIMBO_ALLOCATE( m_messageFactory->GetAllocator(), windowSize * fragmentSize );
+
+            if ( !receiveBlock.blockData )
             {
-                m_receiveBlock->receivedFragment->SetBit( fragmentId );
+                SetErrorLevel( CHANNEL_ERROR_OUT_OF_MEMORY );
+                return;
+            }
 
-                memcpy( m_receiveBlock->blockData + fragmentId * m_config.blockFragmentSize, fragmentData, fragmentBytes );
+            receiveBlock.active = true;
+            receiveBlock.stream = true;
+            receiveBlock.streamSize = 0;
+            receiveBlock.baseFragment = 0;
+            receiveBlock.numFragments = 0;
+            receiveBlock.numReceivedFragments = 0;
+            receiveBlock.messageId = block.messageId;
+            receiveBlock.blockSize = 0;
+            receiveBlock.blockDataSize = windowSize * fragmentSize;
+            receiveBlock.receivedFragment->Clear();
+        }
 
-                if ( fragmentId == 0 )
-                {
-                    m_receiveBlock->messageType = messageType;
-                }
+        // Fragments before the window have already been written out. The sender never sends past the end of the window, because
+        // it only slides its own window on acks, so it is never ahead of ours.
 
-                if ( fragmentId == m_receiveBlock->numFragments - 1 )
-                {
-                    m_receiveBlock->blockSize = ( m_receiveBlock->numFragments - 1 ) * m_config.blockFragmentSize + fragmentBytes;
-
-                    if ( m_receiveBlock->blockSize > (uint32_t) m_config.maxBlockSize )
-                    {
-                        // The block size is outside range
-                        SetErrorLevel( CHANNEL_ERROR_DESYNC );
-                        return;
-                    }
-                }
+        const uint32_t fragmentId = block.fragmentId;
 
-                m_receiveBlock->numReceivedFragments++;
+        if ( fragmentId < uint32_t( receiveBlock.baseFragment ) )
+            return;
 
-                if ( fragmentId == 0 )
-                {
-                    // save block message (sent with fragment 0)
-                    m_receiveBlock->blockMessage = blockMessage;
-                    m_messageFactory->AcquireMessage( m_receiveBlock->blockMessage );
-                }
+        if ( fragmentId >= uint32_t( receiveBlock.baseFragment ) + uint32_t( windowSize ) )
+        {
+            SetErrorLevel( CHANNEL_ERROR_DESYNC );
+            return;
+        }
 
-                if ( m_receiveBlock->numReceivedFragments == m_receiveBlock->numFragments )
-                {
-                    // finished receiving block
+        if ( receiveBlock.numFragments > 0 && fragmentId >= uint32_t( receiveBlock.numFragments ) )
+        {
+            // The fragment id is past the end of the stream.
+            SetErrorLevel( CHANNEL_ERROR_DESYNC );
+            return;
+        }
+
+        const int index = int( fragmentId % uint32_t( windowSize ) );
 
-                    if ( m_messageReceiveQueue->GetAtIndex( m_messageReceiveQueue->GetIndex( messageId ) ) )
-                    {
-                        // Did you forget to dequeue messages on the receiver?
-                        SetErrorLevel( CHANNEL_ERROR_DESYNC );
-                        return;
-                    }
+        if ( receiveBlock.receivedFragment->GetBit( index ) )
+            return;
 
-                    blockMessage = m_receiveBlock->blockMessage;
+        if ( fragmentId == 0 )
+        {
+            // Fragment 0 carries the message and the stream size.
 
-                    yojimbo_assert( blockMessage );
+            if ( ( block.streamSize - 1 ) / fragmentSize >= 0x7FFFFFFF )
+            {
+                // Too many fragments for a 32 bit fragment id.
+                SetErrorLevel( CHANNEL_ERROR_DESYNC );
+                return;
+            }
 
-                    uint8_t * blockData = (uint8_t*) YOJIMBO_ALLOCATE( m_messageFactory->GetAllocator(), m_receiveBlock->blockSize );
+            yojimbo_assert( block.message );
 
-                    if ( !blockData )
-                    {
-                        // Not enough memory to allocate block data
-                        SetErrorLevel( CHANNEL_ERROR_OUT_OF_MEMORY );
-                        return;
-                    }
+            receiveBlock.streamSize = block.streamSize;
+            receiveBlock.numFragments = int( ( block.streamSize + fragmentSize - 1 ) / fragmentSize );
+            receiveBlock.messageType = block.messageType;
+            receiveBlock.blockMessage = block.message;
+            receiveBlock.blockMessage->SetBlockStreamSize( block.streamSize );
+            m_messageFactory->AcquireMessage( receiveBlock.blockMessage );
+        }
 
-                    memcpy( blockData, m_receiveBlock->blockData, m_receiveBlock->blockSize );
+        receiveBlock.receivedFragment->SetBit( index );
+        receiveBlock.fragmentBytes[index] = uint16_t( block.fragmentSize );
+        receiveBlock.numReceivedFragments++;
 
-                    blockMessage->AttachBlock( m_messageFactory->GetAllocator(), blockData, m_receiveBlock->blockSize );
+        memcpy( receiveBlock.blockData + index * fragmentSize, block.fragmentData, block.fragmentSize );
 
-                    blockMessage->SetId( messageId );
+        // Write out the fragments at the start of the window. Nothing is written until fragment 0 arrives, because the base is 0 until then.
 
-                    MessageReceiveQueueEntry * entry = m_messageReceiveQueue->Insert( messageId );
-                    yojimbo_assert( entry );
-                    entry->message = blockMessage;
-                    m_receiveBlock->active = false;
-                    m_receiveBlock->blockMessage = NULL;
-                }
+        while ( receiveBlock.baseFragment < receiveBlock.numFragments )
+        {
+            const int baseIndex = receiveBlock.baseFragment % windowSize;
+
+            if ( !receiveBlock.receivedFragment->GetBit( baseIndex ) )
+                break;
+
+            const uint64_t offset = uint64_t( receiveBlock.baseFragment ) * fragmentSize;
+            const int expectedBytes = int( yojimbo_min( receiveBlock.streamSize - offset, uint64_t( fragmentSize ) ) );
+
+            if ( receiveBlock.fragmentBytes[baseIndex] != expectedBytes )
+            {
+                // Only the last fragment of a stream may be short.
+                SetErrorLevel( CHANNEL_ERROR_DESYNC );
+                return;
             }
+
+            if ( !m_streamWriteFunction( m_streamWriteContext, receiveBlock.blockMessage, offset, receiveBlock.blockData + baseIndex * fragmentSize, expectedBytes ) )
+            {
+                SetErrorLevel( CHANNEL_ERROR_STREAM_FAILED );
+                return;
+            }
+
+            receiveBlock.receivedFragment->ClearBit( baseIndex );
+            receiveBlock.baseFragment++;
+        }
+
+        if ( receiveBlock.numFragments == 0 || receiveBlock.baseFragment < receiveBlock.numFragments )
+            return;
+
+        // finished receiving stream
+
+        if ( m_messageReceiveQueue->GetAtIndex( m_messageReceiveQueue->GetIndex( receiveBlock.messageId ) ) )
+        {
+            // Did you forget to dequeue messages on the receiver?
+            SetErrorLevel( CHANNEL_ERROR_DESYNC );
+            return;
         }
+
+        BlockMessage * blockMessage = receiveBlock.blockMessage;
+
+        blockMessage->SetId( receiveBlock.messageId );
+
+        YOJIMBO_FREE( m_messageFactory->GetAllocator(), receiveBlock.blockData );
+
+        receiveBlock.Reset();
+        receiveBlock.blockMessage = NULL;
+
+        if ( !AddReceivedMessage( blockMessage ) )
+        {
+            m_messageFactory->ReleaseMessage( blockMessage );
+        }
+    }
+
+    void ReliableOrderedChannel::SetBlockStreamWriteFunction( BlockStreamWriteFunction function, void * context )
+    {
+        m_streamWriteFunction = function;
+        m_streamWriteContext = context;
     }
 }
@@ -26,6 +26,7 @@
 #include "yojimbo_connection.h"
 #include "yojimbo_adapter.h"
 #include "yojimbo_network_simulator.h"
+#include "yojimbo_trace.h"
 #include "reliable.h"
 #include "netcode.h"
 
@@ -40,6 +41,7 @@ namespace yojimbo
         m_boundAddress = address;
         m_config = config;
         m_server = NULL;
+        m_decryptFailures = 0;
     }
 
     Server::~Server()
@@ -78,6 +80,8 @@ namespace yojimbo
 
         netcode_server_start( m_server, maxClients );
 
+        m_decryptFailures = 0;
+
         m_boundAddress.SetPort( netcode_server_get_port( m_server ) );
     }
 
@@ -127,29 +131,47 @@ namespace yojimbo
 
     void Server::SendPackets()
     {
+        YOJIMBO_TRACE_SCOPE( "Server::SendPackets" );
         if ( m_server )
         {
+            const double startTime = yojimbo_time();
+            MetricsRegistry & metrics = GetMetrics();
+            const ConnectionMetrics & ids = GetConnectionMetrics();
+            int sendQueueMessages = 0;
             const int maxClients = GetMaxClients();
             for ( int i = 0; i < maxClients; ++i )
             {
-                if ( IsClientConnected( i ) )
+                if ( IsClientConnected( i ) && !IsDirectLoopbackClient( i ) )
                 {
                     uint8_t * packetData = GetPacketBuffer();
                     int packetBytes;
                     uint16_t packetSequence = reliable_endpoint_next_packet_sequence( GetClientEndpoint(i) );
                     if ( GetClientConnection(i).GeneratePacket( GetContext(), packetSequence, packetData, m_config.maxPacketSize, packetBytes ) )
                     {
+                        if ( PacketCapture * capture = GetCapture() )
+                            capture->WritePacket( CAPTURE_RECORD_PACKET_SENT, i, packetSequence, GetTime(), packetData, packetBytes );
+                        YOJIMBO_TRACE_BEGIN( "reliable_endpoint_send_packet" );
                         reliable_endpoint_send_packet( GetClientEndpoint(i), packetData, packetBytes );
+                        YOJIMBO_TRACE_END( "reliable_endpoint_send_packet" );
                     }
+                    const int sendQueueDepth = GetClientConnection(i).GetSendQueueDepth();
+                    metrics.Observe( ids.sendQueueDepth, sendQueueDepth );
+                    sendQueueMessages += sendQueueDepth;
                 }
             }
+            metrics.SetGauge( ids.sendQueueMessages, sendQueueMessages );
+            metrics.Observe( ids.sendPacketsTime, yojimbo_time() - startTime );
         }
     }
 
     void Server::ReceivePackets()
     {
+        YOJIMBO_TRACE_SCOPE( "Server::ReceivePackets" );
         if ( m_server )
         {
+            const double startTime = yojimbo_time();
+            MetricsRegistry & metrics = GetMetrics();
+            const ConnectionMetrics & ids = GetConnectionMetrics();
             const int maxClients = GetMaxClients();
             for ( int clientIndex = 0; clientIndex < maxClients; ++clientIndex )
             {
@@ -160,18 +182,32 @@ namespace yojimbo
                     uint8_t * packetData = netcode_server_receive_packet( m_server, clientIndex, &packetBytes, &packetSequence );
                     if ( !packetData )
                         break;
+                    metrics.Increment( ids.packetsReceived );
+                    metrics.Observe( ids.packetBytesReceived, packetBytes );
+                    YOJIMBO_TRACE_BEGIN( "reliable_endpoint_receive_packet" );
                     reliable_endpoint_receive_packet( GetClientEndpoint( clientIndex ), packetData, packetBytes );
+                    YOJIMBO_TRACE_END( "reliable_endpoint_receive_packet" );
                     netcode_server_free_packet( m_server, packetData );
                 }
             }
+            metrics.Observe( ids.receivePacketsTime, yojimbo_time() - startTime );
         }
     }
 
     void Server::AdvanceTime( double time )
     {
+        const double startTime = yojimbo_time();
         if ( m_server )
         {
+            YOJIMBO_TRACE_BEGIN( "netcode_server_update" );
             netcode_server_update( m_server, time );
+            YOJIMBO_TRACE_END( "netcode_server_update" );
+#ifndef YOJIMBO_SYSTEM_DEPS
+            // netcode reads the socket here, so this is where it drops packets that fail to decrypt
+            const uint64_t decryptFailures = netcode_server_num_decrypt_failures( m_server );
+            GetMetrics().Increment( GetConnectionMetrics().decryptFailures, decryptFailures - m_decryptFailures );
+            m_decryptFailures = decryptFailures;
+#endif // #ifndef YOJIMBO_SYSTEM_DEPS
         }
         BaseServer::AdvanceTime( time );
         NetworkSimulator * networkSimulator = GetNetworkSimulator();
@@ -196,6 +232,11 @@ namespace yojimbo
                 }
             }
         }
+        if ( m_server )
+        {
+            GetMetrics().SetGauge( GetConnectionMetrics().connections, GetNumConnectedClients() );
+            GetMetrics().Observe( GetConnectionMetrics().advanceTimeTime, yojimbo_time() - startTime );
+        }
     }
 
     bool Server::IsClientConnected( int clientIndex ) const
@@ -252,6 +293,8 @@ namespace yojimbo
     void Server::TransmitPacketFunction( int clientIndex, uint16_t packetSequence, uint8_t * packetData, int packetBytes )
     {
         (void) packetSequence;
+        GetMetrics().Increment( GetConnectionMetrics().packetsSent );
+        GetMetrics().Observe( GetConnectionMetrics().packetBytesSent, packetBytes );
         NetworkSimulator * networkSimulator = GetNetworkSimulator();
         if ( networkSimulator && networkSimulator->IsActive() )
         {
@@ -265,6 +308,8 @@ namespace yojimbo
 
     int Server::ProcessPacketFunction( int clientIndex, uint16_t packetSequence, uint8_t * packetData, int packetBytes )
     {
+        if ( PacketCapture * capture = GetCapture() )
+            capture->WritePacket( CAPTURE_RECORD_PACKET_RECEIVED, clientIndex, packetSequence, GetTime(), packetData, packetBytes );
         return (int) GetClientConnection(clientIndex).ProcessPacket( GetContext(), packetSequence, packetData, packetBytes );
     }
 
@@ -282,9 +327,16 @@ namespace yojimbo
                                                             ? YOJIMBO_SERVER_CLIENT_DISCONNECT_REASON_TIMED_OUT
                                                             : YOJIMBO_SERVER_CLIENT_DISCONNECT_REASON_DISCONNECTED );
             }
-            GetAdapter().OnServerClientDisconnected( clientIndex );
-            reliable_endpoint_reset( GetClientEndpoint( clientIndex ) );
-            GetClientConnection( clientIndex ).Reset();
+            // A slot that failed to commit on connect never told the adapter about the client.
+            if ( IsClientCommitted( clientIndex ) )
+            {
+                if ( PacketCapture * capture = GetCapture() )
+                    capture->WriteEvent( CAPTURE_RECORD_CLIENT_DISCONNECTED, clientIndex, GetTime() );
+                GetAdapter().OnServerClientDisconnected( clientIndex );
+                DisconnectDirectLoopback( clientIndex );
+                reliable_endpoint_reset( GetClientEndpoint( clientIndex ) );
+                GetClientConnection( clientIndex ).Reset();
+            }
             NetworkSimulator * networkSimulator = GetNetworkSimulator();
             if ( networkSimulator && networkSimulator->IsActive() )
             {
@@ -296,6 +348,23 @@ namespace yojimbo
             // This slot now belongs to a new client: clear any disconnect reason left behind by
             // the previous occupant of the slot.
             SetClientDisconnectReason( clientIndex, YOJIMBO_SERVER_CLIENT_DISCONNECT_REASON_NONE );
+            // With lazy client memory the slot is committed here, as the client connects.
+            if ( !CommitClient( clientIndex ) )
+            {
+                yojimbo_printf( YOJIMBO_LOG_LEVEL_ERROR, "error: failed to commit memory for client %d. disconnecting it\n", clientIndex );
+                SetClientDisconnectReason( clientIndex, YOJIMBO_SERVER_CLIENT_DISCONNECT_REASON_OUT_OF_MEMORY );
+                if ( IsLoopbackClient( clientIndex ) )
+                {
+                    DisconnectLoopbackClient( clientIndex );
+                }
+                else
+                {
+                    DisconnectClient( clientIndex );
+                }
+                return;
+            }
+            if ( PacketCapture * capture = GetCapture() )
+                capture->WriteEvent( CAPTURE_RECORD_CLIENT_CONNECTED, clientIndex, GetTime() );
             GetAdapter().OnServerClientConnected( clientIndex );
         }
     }
@@ -0,0 +1,569 @@
+/*
+    Yojimbo Client/Server Network Library.
+
+    Copyright © 2016 - 2026, Más Bandwidth LLC.
+
+    Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+        1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+        2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer
+           in the documentation and/or other materials provided with the distribution.
+
+        3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived
+           from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES,
+    INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+    SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+    USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "yojimbo_snapshot_channel.h"
+#include "yojimbo_utils.h"
+
+namespace yojimbo
+{
+    /**
+        Unchanged gaps of up to this many bytes between two changed runs are sent as part of a single run.
+        Starting a new run costs around 10 bits (the run flag plus two relative ints), so sending one unchanged byte is cheaper than splitting the run around it.
+     */
+
+    static const int SnapshotDeltaMergeBytes = 1;
+
+    static inline uint8_t GetBaselineByte( const uint8_t * baseline, int baselineBytes, int index )
+    {
+        return index < baselineBytes ? baseline[index] : 0;
+    }
+
+    static bool FindChangedRun( const uint8_t * baseline, int baselineBytes, const uint8_t * snapshot, int snapshotBytes, int position, int & runStart, int & runEnd )
+    {
+        int i = position;
+        while ( i < snapshotBytes && snapshot[i] == GetBaselineByte( baseline, baselineBytes, i ) )
+            i++;
+
+        if ( i == snapshotBytes )
+            return false;
+
+        runStart = i;
+        runEnd = i + 1;
+
+        for ( int j = i + 1; j < snapshotBytes; ++j )
+        {
+            if ( snapshot[j] != GetBaselineByte( baseline, baselineBytes, j ) )
+                runEnd = j + 1;
+            else if ( j - runEnd + 1 > SnapshotDeltaMergeBytes )
+                break;
+        }
+
+        return true;
+    }
+
+    /**
+        Serialize a snapshot block as a delta against a baseline block.
+        The delta is a list of runs of changed bytes. Each run is its start relative to the end of the previous run, its length, then the new bytes.
+        The baseline is treated as zero extended (or truncated) to the size of the snapshot, so snapshots are free to change size.
+        When reading, the snapshot must already hold the baseline bytes. The runs are written over it.
+     */
+
+    template <typename Stream> bool SerializeSnapshotDelta( Stream & stream, const uint8_t * baseline, int baselineBytes, uint8_t * snapshot, int snapshotBytes )
+    {
+        int position = 0;
+
+        while ( true )
+        {
+            int runStart = 0;
+            int runEnd = 0;
+
+            bool hasRun = false;
+            if ( Stream::IsWriting )
+                hasRun = FindChangedRun( baseline, baselineBytes, snapshot, snapshotBytes, position, runStart, runEnd );
+
+            serialize_bool( stream, hasRun );
+
+            if ( !hasRun )
+                break;
+
+            // Offset by one so the difference is positive even when a run starts right where the last one ended.
+            int start = runStart + 1;
+            int length = runEnd - runStart;
+            serialize_int_relative( stream, position, start );
+            serialize_int_relative( stream, 0, length );
+
+            if ( Stream::IsReading )
+            {
+                runStart = start - 1;
+                if ( runStart >= snapshotBytes || length > snapshotBytes - runStart )
+                    return false;
+                runEnd = runStart + length;
+            }
+
+            for ( int i = runStart; i < runEnd; ++i )
+            {
+                uint32_t value = snapshot[i];
+                serialize_bits( stream, value, 8 );
+                if ( Stream::IsReading )
+                    snapshot[i] = uint8_t( value );
+            }
+
+            position = runEnd;
+        }
+
+        return true;
+    }
+
+    static void GetSnapshotBlock( Message * message, const uint8_t * & data, int & bytes )
+    {
+        if ( message && message->IsBlockMessage() )
+        {
+            BlockMessage * blockMessage = (BlockMessage*) message;
+            data = blockMessage->GetBlockData();
+            bytes = blockMessage->GetBlockSize();
+        }
+        else
+        {
+            data = NULL;
+            bytes = 0;
+        }
+    }
+
+    SnapshotChannel::SnapshotChannel( Allocator & allocator, MessageFactory & messageFactory, const ChannelConfig & config, const int maxPacketSize, int channelIndex, double time )
+        : Channel( allocator, messageFactory, config, maxPacketSize, channelIndex, time )
+    {
+        yojimbo_assert( config.type == CHANNEL_TYPE_SNAPSHOT );
+        yojimbo_assert( ( 65536 % config.sentPacketBufferSize ) == 0 );
+        yojimbo_assert( ( 65536 % config.snapshotBufferSize ) == 0 );
+
+        m_sentPackets = YOJIMBO_NEW( *m_allocator, SequenceBuffer<SentPacketEntry>, *m_allocator, m_config.sentPacketBufferSize );
+        m_messageReceiveQueue = YOJIMBO_NEW( *m_allocator, Queue<Message*>, *m_allocator, m_config.messageReceiveQueueSize );
+        m_sendSnapshots = (SnapshotEntry*) YOJIMBO_ALLOCATE( *m_allocator, sizeof( SnapshotEntry ) * m_config.snapshotBufferSize );
+        m_receiveSnapshots = (SnapshotEntry*) YOJIMBO_ALLOCATE( *m_allocator, sizeof( SnapshotEntry ) * m_config.snapshotBufferSize );
+        memset( m_sendSnapshots, 0, sizeof( SnapshotEntry ) * m_config.snapshotBufferSize );
+        memset( m_receiveSnapshots, 0, sizeof( SnapshotEntry ) * m_config.snapshotBufferSize );
+
+        Reset();
+    }
+
+    SnapshotChannel::~SnapshotChannel()
+    {
+        Reset();
+
+        YOJIMBO_DELETE( *m_allocator, SequenceBuffer<SentPacketEntry>, m_sentPackets );
+        YOJIMBO_DELETE( *m_allocator, Queue<Message*>, m_messageReceiveQueue );
+        YOJIMBO_FREE( *m_allocator, m_sendSnapshots );
+        YOJIMBO_FREE( *m_allocator, m_receiveSnapshots );
+    }
+
+    void SnapshotChannel::Reset()
+    {
+        SetErrorLevel( CHANNEL_ERROR_NONE );
+
+        m_sendSnapshotId = 0;
+        m_receiveSnapshotId = 0;
+        m_baselineSnapshotId = 0;
+        m_hasReceivedSnapshot = false;
+        m_hasBaseline = false;
+        m_sendPending = false;
+
+        for ( int i = 0; i < m_config.snapshotBufferSize; ++i )
+        {
+            if ( m_sendSnapshots[i].message )
+                m_messageFactory->ReleaseMessage( m_sendSnapshots[i].message );
+
+            if ( m_receiveSnapshots[i].message )
+                m_messageFactory->ReleaseMessage( m_receiveSnapshots[i].message );
+        }
+
+        memset( m_sendSnapshots, 0, sizeof( SnapshotEntry ) * m_config.snapshotBufferSize );
+        memset( m_receiveSnapshots, 0, sizeof( SnapshotEntry ) * m_config.snapshotBufferSize );
+
+        for ( int i = 0; i < m_messageReceiveQueue->GetNumEntries(); ++i )
+            m_messageFactory->ReleaseMessage( (*m_messageReceiveQueue)[i] );
+
+        m_messageReceiveQueue->Clear();
+
+        m_sentPackets->Reset();
+
+        ResetCounters();
+    }
+
+    bool SnapshotChannel::CanSendMessage() const
+    {
+        // A new snapshot supersedes any snapshot that has not gone out yet, so there is no send queue to fill up.
+        return true;
+    }
+
+    bool SnapshotChannel::HasMessagesToSend() const
+    {
+        return m_sendPending;
+    }
+
+    int SnapshotChannel::GetSendQueueDepth() const
+    {
+        // only the latest snapshot is ever waiting to be sent
+        return m_sendPending ? 1 : 0;
+    }
+
+    void SnapshotChannel::SendMessage( Message * message, void *context )
+    {
+        yojimbo_assert( message );
+        (void)context;
+
+        if ( GetErrorLevel() != CHANNEL_ERROR_NONE )
+        {
+            m_messageFactory->ReleaseMessage( message );
+            return;
+        }
+
+        yojimbo_assert( !( message->IsBlockMessage() && m_config.disableBlocks ) );
+
+        if ( message->IsBlockMessage() && m_config.disableBlocks )
+        {
+            SetErrorLevel( CHANNEL_ERROR_BLOCKS_DISABLED );
+            m_messageFactory->ReleaseMessage( message );
+            return;
+        }
+
+        yojimbo_assert( !( message->IsBlockMessage() && ( (BlockMessage*) message )->IsBlockStream() ) );
+
+        if ( message->IsBlockMessage() && ( (BlockMessage*) message )->IsBlockStream() )
+        {
+            // Streamed blocks can only be sent over reliable channels.
+            SetErrorLevel( CHANNEL_ERROR_STREAM_FAILED );
+            m_messageFactory->ReleaseMessage( message );
+            return;
+        }
+
+        if ( message->IsBlockMessage() )
+        {
+            yojimbo_assert( ((BlockMessage*)message)->GetBlockSize() > 0 );
+            yojimbo_assert( ((BlockMessage*)message)->GetBlockSize() <= m_config.maxBlockSize );
+        }
+
+        const uint16_t snapshotId = m_sendSnapshotId++;
+
+        message->SetId( snapshotId );
+
+        StoreSnapshot( m_sendSnapshots, snapshotId, message );
+
+        m_messageFactory->ReleaseMessage( message );
+
+        m_sendPending = true;
+
+        m_counters[CHANNEL_COUNTER_MESSAGES_SENT]++;
+    }
+
+    Message * SnapshotChannel::ReceiveMessage()
+    {
+        if ( GetErrorLevel() != CHANNEL_ERROR_NONE )
+            return NULL;
+
+        if ( m_messageReceiveQueue->IsEmpty() )
+            return NULL;
+
+        m_counters[CHANNEL_COUNTER_MESSAGES_RECEIVED]++;
+
+        return m_messageReceiveQueue->Pop();
+    }
+
+    void SnapshotChannel::AdvanceTime( double time )
+    {
+        (void) time;
+    }
+
+    int SnapshotChannel::GetPacketData( void *context, ChannelPacketData & packetData, uint16_t packetSequence, int availableBits )
+    {
+        if ( !m_sendPending )
+            return 0;
+
+        if ( m_config.packetBudget > 0 )
+            availableBits = yojimbo_min( m_config.packetBudget * 8, availableBits );
+
+        const uint16_t snapshotId = m_sendSnapshotId - 1;
+
+        SnapshotEntry * entry = FindSnapshot( m_sendSnapshots, snapshotId );
+
+        yojimbo_assert( entry );
+
+        Message * message = entry->message;
+
+        const uint8_t * snapshotData = NULL;
+        int snapshotBytes = 0;
+        GetSnapshotBlock( message, snapshotData, snapshotBytes );
+
+        // Delta encode against the newest acked baseline if we still hold it and its offset fits on the wire.
+
+        uint16_t baselineOffset = 0;
+        const uint8_t * baselineData = NULL;
+        int baselineBytes = 0;
+
+        if ( m_hasBaseline && snapshotBytes >= 2 )
+        {
+            const uint16_t offset = snapshotId - m_baselineSnapshotId;
+            SnapshotEntry * baseline = offset >= 1 && offset < m_config.snapshotBufferSize ? FindSnapshot( m_sendSnapshots, m_baselineSnapshotId ) : NULL;
+            if ( baseline )
+            {
+                baselineOffset = offset;
+                GetSnapshotBlock( baseline->message, baselineData, baselineBytes );
+            }
+        }
+
+        Allocator & allocator = m_messageFactory->GetAllocator();
+
+        uint8_t * data = NULL;
+        int dataBytes = 0;
+
+        if ( baselineOffset != 0 )
+        {
+            MeasureStream measureStream;
+            SerializeSnapshotDelta( measureStream, baselineData, baselineBytes, (uint8_t*) snapshotData, snapshotBytes );
+            const int deltaBytes = ( measureStream.GetBitsProcessed() + 7 ) / 8;
+
+            if ( deltaBytes < snapshotBytes )
+            {
+                // The bit writer flushes whole qwords, so the buffer size is a multiple of 8 with room for the final flush.
+                const int bufferSize = ( ( deltaBytes + 7 ) & ~7 ) + 8;
+                data = (uint8_t*) YOJIMBO_ALLOCATE( allocator, bufferSize );
+                if ( data )
+                {
+                    WriteStream writeStream( data, bufferSize );
+                    SerializeSnapshotDelta( writeStream, baselineData, baselineBytes, (uint8_t*) snapshotData, snapshotBytes );
+                    writeStream.Flush();
+                    dataBytes = (int) writeStream.GetBytesProcessed();
+                    yojimbo_assert( dataBytes == deltaBytes );
+                }
+            }
+            else
+            {
+                baselineOffset = 0;
+            }
+        }
+
+        if ( baselineOffset == 0 && snapshotBytes > 0 )
+        {
+            data = (uint8_t*) YOJIMBO_ALLOCATE( allocator, snapshotBytes );
+            if ( data )
+            {
+                memcpy( data, snapshotData, snapshotBytes );
+                dataBytes = snapshotBytes;
+            }
+        }
+
+        if ( snapshotBytes > 0 && !data )
+        {
+            SetErrorLevel( CHANNEL_ERROR_OUT_OF_MEMORY );
+            return 0;
+        }
+
+        const int messageBits = m_messageFactory->MeasureMessage( message, context );
+
+        const int messageTypeBits = bits_required( 0, m_messageFactory->GetNumTypes() - 1 );
+
+        int snapshotBits = ConservativeMessageHeaderBits + 16;
+        snapshotBits += bits_required( 0, m_config.snapshotBufferSize - 1 );
+        snapshotBits += bits_required( 0, m_config.maxBlockSize );
+        if ( baselineOffset != 0 )
+            snapshotBits += bits_required( 1, snapshotBytes - 1 );
+        if ( dataBytes > 0 )
+            snapshotBits += 7 + dataBytes * 8;                                          // serialize_bytes aligns to a byte boundary first
+        snapshotBits += messageTypeBits + messageBits;
+
+        const bool isOverBudget = m_config.packetBudget > 0 && snapshotBits > m_config.packetBudget * 8;
+        const bool isOverPacketSize = snapshotBits > m_maxPacketSize * 8;
+
+        if ( isOverBudget || isOverPacketSize )
+        {
+            // Snapshots are never fragmented. Keep each snapshot (or at least its delta) small enough to fit in a single packet.
+            yojimbo_printf( YOJIMBO_LOG_LEVEL_ERROR, "error: snapshot %d is too large to fit in a packet (%d bits)\n", snapshotId, snapshotBits );
+            YOJIMBO_FREE( allocator, data );
+            SetErrorLevel( CHANNEL_ERROR_MESSAGE_TOO_LARGE );
+            m_sendPending = false;
+            return 0;
+        }
+
+        if ( snapshotBits > availableBits )
+        {
+            // Other channels used up this packet. Try again with the next one.
+            YOJIMBO_FREE( allocator, data );
+            return 0;
+        }
+
+        packetData.Initialize();
+        packetData.channelIndex = GetChannelIndex();
+        packetData.message.messages = (Message**) YOJIMBO_ALLOCATE( allocator, sizeof( Message* ) );
+
+        if ( !packetData.message.messages )
+        {
+            YOJIMBO_FREE( allocator, data );
+            SetErrorLevel( CHANNEL_ERROR_OUT_OF_MEMORY );
+            return 0;
+        }
+
+        m_messageFactory->AcquireMessage( message );
+        packetData.message.numMessages = 1;
+        packetData.message.messages[0] = message;
+        packetData.snapshot.data = data;
+        packetData.snapshot.dataBytes = dataBytes;
+        packetData.snapshot.snapshotBytes = snapshotBytes;
+        packetData.snapshot.snapshotId = snapshotId;
+        packetData.snapshot.baselineOffset = baselineOffset;
+
+        SentPacketEntry * sentPacket = m_sentPackets->Insert( packetSequence );
+        if ( sentPacket )
+            sentPacket->snapshotId = snapshotId;
+
+        m_sendPending = false;
+
+        return snapshotBits;
+    }
+
+    void SnapshotChannel::ProcessPacketData( const ChannelPacketData & packetData, uint16_t packetSequence )
+    {
+        (void) packetSequence;
+
+        if ( m_errorLevel != CHANNEL_ERROR_NONE )
+            return;
+
+        if ( packetData.messageFailedToSerialize || packetData.blockMessage || packetData.message.numMessages != 1 )
+        {
+            SetErrorLevel( CHANNEL_ERROR_FAILED_TO_SERIALIZE );
+            return;
+        }
+
+        Message * message = packetData.message.messages[0];
+
+        yojimbo_assert( message );
+
+        const uint16_t snapshotId = packetData.snapshot.snapshotId;
+
+        // Duplicate packets carry snapshots we already hold, and snapshots so old they would evict newer baselines are no use to anybody.
+
+        if ( FindSnapshot( m_receiveSnapshots, snapshotId ) )
+            return;
+
+        if ( m_hasReceivedSnapshot && !yojimbo_sequence_greater_than( uint16_t( snapshotId + m_config.snapshotBufferSize ), m_receiveSnapshotId ) )
+            return;
+
+        const int snapshotBytes = packetData.snapshot.snapshotBytes;
+
+        if ( snapshotBytes > 0 )
+        {
+            yojimbo_assert( message->IsBlockMessage() );
+
+            Allocator & allocator = m_messageFactory->GetAllocator();
+
+            uint8_t * blockData = NULL;
+
+            if ( packetData.snapshot.baselineOffset == 0 )
+            {
+                yojimbo_assert( packetData.snapshot.dataBytes == snapshotBytes );
+
+                blockData = (uint8_t*) YOJIMBO_ALLOCATE( allocator, snapshotBytes );
+                if ( !blockData )
+                {
+                    SetErrorLevel( CHANNEL_ERROR_OUT_OF_MEMORY );
+                    return;
+                }
+
+                memcpy( blockData, packetData.snapshot.data, snapshotBytes );
+            }
+            else
+            {
+                const uint16_t baselineSnapshotId = snapshotId - packetData.snapshot.baselineOffset;
+
+                SnapshotEntry * baseline = FindSnapshot( m_receiveSnapshots, baselineSnapshotId );
+
+                if ( !baseline )
+                {
+                    // The baseline has already been evicted by newer snapshots. Drop this snapshot, a newer one is on its way.
+                    yojimbo_printf( YOJIMBO_LOG_LEVEL_DEBUG, "dropped snapshot %d because baseline %d is no longer held\n", snapshotId, baselineSnapshotId );
+                    return;
+                }
+
+                const uint8_t * baselineData = NULL;
+                int baselineBytes = 0;
+                GetSnapshotBlock( baseline->message, baselineData, baselineBytes );
+
+                blockData = (uint8_t*) YOJIMBO_ALLOCATE( allocator, snapshotBytes );
+                if ( !blockData )
+                {
+                    SetErrorLevel( CHANNEL_ERROR_OUT_OF_MEMORY );
+                    return;
+                }
+
+                for ( int i = 0; i < snapshotBytes; ++i )
+                    blockData[i] = GetBaselineByte( baselineData, baselineBytes, i );
+
+                ReadStream readStream( packetData.snapshot.data, packetData.snapshot.dataBytes );
+
+                if ( !SerializeSnapshotDelta( readStream, baselineData, baselineBytes, blockData, snapshotBytes ) )
+                {
+                    yojimbo_printf( YOJIMBO_LOG_LEVEL_ERROR, "error: failed to decode snapshot %d against baseline %d\n", snapshotId, baselineSnapshotId );
+                    YOJIMBO_FREE( allocator, blockData );
+                    SetErrorLevel( CHANNEL_ERROR_FAILED_TO_SERIALIZE );
+                    return;
+                }
+            }
+
+            ((BlockMessage*)message)->AttachBlock( allocator, blockData, snapshotBytes );
+        }
+
+        StoreSnapshot( m_receiveSnapshots, snapshotId, message );
+
+        if ( m_hasReceivedSnapshot && !yojimbo_sequence_greater_than( snapshotId, m_receiveSnapshotId ) )
+            return;
+
+        m_hasReceivedSnapshot = true;
+        m_receiveSnapshotId = snapshotId;
+
+        if ( !m_messageReceiveQueue->IsFull() )
+        {
+            m_messageFactory->AcquireMessage( message );
+            m_messageReceiveQueue->Push( message );
+        }
+    }
+
+    void SnapshotChannel::ProcessAck( uint16_t ack )
+    {
+        SentPacketEntry * sentPacket = m_sentPackets->Find( ack );
+        if ( !sentPacket )
+            return;
+
+        const uint16_t snapshotId = sentPacket->snapshotId;
+
+        m_sentPackets->Remove( ack );
+
+        if ( !m_hasBaseline || yojimbo_sequence_greater_than( snapshotId, m_baselineSnapshotId ) )
+        {
+            m_hasBaseline = true;
+            m_baselineSnapshotId = snapshotId;
+        }
+    }
+
+    bool SnapshotChannel::GetBaselineSnapshotId( uint16_t & snapshotId ) const
+    {
+        snapshotId = m_baselineSnapshotId;
+        return m_hasBaseline;
+    }
+
+    SnapshotChannel::SnapshotEntry * SnapshotChannel::FindSnapshot( SnapshotEntry * entries, uint16_t snapshotId )
+    {
+        SnapshotEntry * entry = &entries[ snapshotId % m_config.snapshotBufferSize ];
+        if ( entry->message && entry->snapshotId == snapshotId )
+            return entry;
+        return NULL;
+    }
+
+    void SnapshotChannel::StoreSnapshot( SnapshotEntry * entries, uint16_t snapshotId, Message * message )
+    {
+        SnapshotEntry * entry = &entries[ snapshotId % m_config.snapshotBufferSize ];
+        if ( entry->message )
+            m_messageFactory->ReleaseMessage( entry->message );
+        m_messageFactory->AcquireMessage( message );
+        entry->message = message;
+        entry->snapshotId = snapshotId;
+    }
+}
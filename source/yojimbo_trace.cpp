@@ -0,0 +1,184 @@
+#include "yojimbo_trace.h"
+#include "yojimbo_platform.h"
+
+#if YOJIMBO_ENABLE_TRACING
+
+#include <atomic>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+namespace yojimbo
+{
+    struct TraceEvent
+    {
+        const char * name;
+        uint64_t timeAndEnd;                                    // steady clock nanoseconds << 1, low bit set for an end event
+    };
+
+    struct TraceBuffer
+    {
+        TraceBuffer * next;                                     // next buffer in the global list. Buffers are never unlinked
+        std::atomic<bool> inUse;                                // true while a thread owns this buffer
+        int threadId;                                           // the tid written to the trace for this buffer
+        std::atomic<uint64_t> numEvents;                        // events written since the last reset. The newest is at ( numEvents - 1 ) % YOJIMBO_TRACE_BUFFER_EVENTS
+        TraceEvent events[YOJIMBO_TRACE_BUFFER_EVENTS];
+    };
+
+    static std::atomic<TraceBuffer*> s_traceBuffers( NULL );
+    static std::atomic<int> s_numTraceBuffers( 0 );
+
+    // Hands a thread's buffer back when the thread exits, so the next new thread reuses it
+    // instead of growing the list. Its events stay in the buffer until the new owner overwrites them.
+
+    struct TraceThread
+    {
+        TraceBuffer * buffer;
+
+        ~TraceThread()
+        {
+            if ( buffer )
+                buffer->inUse.store( false, std::memory_order_release );
+        }
+    };
+
+    static thread_local TraceThread t_traceThread = { NULL };
+
+    static TraceBuffer * AcquireTraceBuffer()
+    {
+        for ( TraceBuffer * buffer = s_traceBuffers.load( std::memory_order_acquire ); buffer; buffer = buffer->next )
+        {
+            bool expected = false;
+            if ( buffer->inUse.compare_exchange_strong( expected, true, std::memory_order_acquire ) )
+                return buffer;
+        }
+
+        // The buffer lives until the process exits: a dump may be reading it at any time, and
+        // tracing threads hold raw pointers to it.
+
+        TraceBuffer * buffer = (TraceBuffer*) calloc( 1, sizeof( TraceBuffer ) );
+        if ( !buffer )
+            return NULL;
+        buffer->inUse.store( true, std::memory_order_relaxed );
+        buffer->threadId = s_numTraceBuffers.fetch_add( 1, std::memory_order_relaxed ) + 1;
+        buffer->numEvents.store( 0, std::memory_order_relaxed );
+        TraceBuffer * head = s_traceBuffers.load( std::memory_order_relaxed );
+        do
+        {
+            buffer->next = head;
+        }
+        while ( !s_traceBuffers.compare_exchange_weak( head, buffer, std::memory_order_release, std::memory_order_relaxed ) );
+        return buffer;
+    }
+
+    static inline void RecordTraceEvent( const char * name, uint64_t end )
+    {
+        TraceBuffer * buffer = t_traceThread.buffer;
+        if ( !buffer )
+        {
+            buffer = AcquireTraceBuffer();
+            if ( !buffer )
+                return;
+            t_traceThread.buffer = buffer;
+        }
+        const uint64_t time = (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+        const uint64_t index = buffer->numEvents.load( std::memory_order_relaxed );
+        TraceEvent & event = buffer->events[index & ( YOJIMBO_TRACE_BUFFER_EVENTS - 1 )];
+        event.name = name;
+        event.timeAndEnd = ( time << 1 ) | end;
+        buffer->numEvents.store( index + 1, std::memory_order_release );
+    }
+}
+
+void yojimbo_trace_begin( const char * name )
+{
+    yojimbo::RecordTraceEvent( name, 0 );
+}
+
+void yojimbo_trace_end( const char * name )
+{
+    yojimbo::RecordTraceEvent( name, 1 );
+}
+
+bool yojimbo_trace_write( const char * path )
+{
+    using namespace yojimbo;
+
+    yojimbo_assert( path );
+
+    FILE * file = fopen( path, "wb" );
+    if ( !file )
+    {
+        yojimbo_printf( YOJIMBO_LOG_LEVEL_ERROR, "error: failed to open trace file %s\n", path );
+        return false;
+    }
+
+    fprintf( file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[" );
+
+    bool first = true;
+
+    for ( TraceBuffer * buffer = s_traceBuffers.load( std::memory_order_acquire ); buffer; buffer = buffer->next )
+    {
+        const uint64_t numEvents = buffer->numEvents.load( std::memory_order_acquire );
+        const uint64_t firstEvent = numEvents > YOJIMBO_TRACE_BUFFER_EVENTS ? numEvents - YOJIMBO_TRACE_BUFFER_EVENTS : 0;
+        for ( uint64_t i = firstEvent; i < numEvents; ++i )
+        {
+            const TraceEvent & event = buffer->events[i & ( YOJIMBO_TRACE_BUFFER_EVENTS - 1 )];
+            const uint64_t time = event.timeAndEnd >> 1;
+            fprintf( file, "%s\n{\"name\":\"%s\",\"cat\":\"yojimbo\",\"ph\":\"%c\",\"ts\":%llu.%03u,\"pid\":1,\"tid\":%d}",
+                first ? "" : ",",
+                event.name,
+                ( event.timeAndEnd & 1 ) ? 'E' : 'B',
+                (unsigned long long) ( time / 1000 ),
+                (unsigned) ( time % 1000 ),
+                buffer->threadId );
+            first = false;
+        }
+    }
+
+    fprintf( file, "\n]}\n" );
+
+    const bool result = !ferror( file );
+
+    if ( fclose( file ) != 0 || !result )
+    {
+        yojimbo_printf( YOJIMBO_LOG_LEVEL_ERROR, "error: failed to write trace file %s\n", path );
+        return false;
+    }
+
+    return true;
+}
+
+void yojimbo_trace_reset()
+{
+    using namespace yojimbo;
+    for ( TraceBuffer * buffer = s_traceBuffers.load( std::memory_order_acquire ); buffer; buffer = buffer->next )
+    {
+        buffer->numEvents.store( 0, std::memory_order_release );
+    }
+}
+
+#else // #if YOJIMBO_ENABLE_TRACING
+
+void yojimbo_trace_begin( const char * name )
+{
+    (void) name;
+}
+
+void yojimbo_trace_end( const char * name )
+{
+    (void) name;
+}
+
+bool yojimbo_trace_write( const char * path )
+{
+    (void) path;
+    return false;
+}
+
+void yojimbo_trace_reset()
+{
+}
+
+#endif // #if YOJIMBO_ENABLE_TRACING
@@ -83,6 +83,12 @@ namespace yojimbo
         return !m_messageSendQueue->IsEmpty();
     }
 
+    int UnreliableUnorderedChannel::GetSendQueueDepth() const
+    {
+        yojimbo_assert( m_messageSendQueue );
+        return m_messageSendQueue->GetNumEntries();
+    }
+
     void UnreliableUnorderedChannel::SendMessage( Message * message, void *context )
     {
         yojimbo_assert( message );
@@ -111,6 +117,16 @@ namespace yojimbo
             return;
         }
 
+        yojimbo_assert( !( message->IsBlockMessage() && ( (BlockMessage*) message )->IsBlockStream() ) );
+
+        if ( message->IsBlockMessage() && ( (BlockMessage*) message )->IsBlockStream() )
+        {
+            // Streamed blocks can only be sent over reliable channels.
+            SetErrorLevel( CHANNEL_ERROR_STREAM_FAILED );
+            m_messageFactory->ReleaseMessage( message );
+            return;
+        }
+
         if ( message->IsBlockMessage() )
         {
             yojimbo_assert( ((BlockMessage*)message)->GetBlockSize() > 0 );
@@ -173,19 +189,19 @@ namespace yojimbo
 
             yojimbo_assert( message );
 
-            MeasureStream measureStream;
-            measureStream.SetContext( context );
-            measureStream.SetAllocator( &m_messageFactory->GetAllocator() );
-            message->SerializeInternal( measureStream );
+            int messageBits = messageTypeBits + m_messageFactory->MeasureMessage( message, context );
             
             if ( message->IsBlockMessage() )
             {
+                // measured on its own: the measure stream counts alignment as the worst case wherever it falls, so the total is unchanged
+                MeasureStream measureStream;
+                measureStream.SetContext( context );
+                measureStream.SetAllocator( &m_messageFactory->GetAllocator() );
                 BlockMessage * blockMessage = (BlockMessage*) message;
                 SerializeMessageBlock( measureStream, *m_messageFactory, blockMessage, m_config.maxBlockSize );
+                messageBits += (int) measureStream.GetBitsProcessed();
             }
 
-            const int messageBits = messageTypeBits + measureStream.GetBitsProcessed();
-
             const bool isOverBudget = m_config.packetBudget > 0 && messageBits > m_config.packetBudget * 8;
             const bool isOverPacketSize = messageBits > m_maxPacketSize * 8;
             const bool isTooLarge = isOverBudget || isOverPacketSize;
@@ -282,4 +298,10 @@ namespace yojimbo
     {
         (void) ack;
     }
+
+    void UnreliableUnorderedChannel::ProcessAcks( const uint16_t * acks, int numAcks )
+    {
+        (void) acks;
+        (void) numAcks;
+    }
 }
@@ -155,6 +155,65 @@ void test_queue()
     check( queue.GetSize() == QueueSize );
 }
 
+static void spsc_queue_producer( SpscQueue<int> * queue, int numValues )
+{
+    for ( int i = 0; i < numValues; )
+    {
+        if ( queue->Push( i ) )
+            ++i;
+    }
+}
+
+void test_spsc_queue()
+{
+    SpscQueue<int> queue( GetDefaultAllocator(), 100 );
+
+    check( queue.GetSize() == 128 );
+    check( !queue.IsFull() );
+
+    int value = -1;
+    check( !queue.Peek( value ) );
+    check( !queue.Pop( value ) );
+
+    for ( int i = 0; i < queue.GetSize(); ++i )
+        check( queue.Push( i ) );
+
+    check( queue.IsFull() );
+    check( !queue.Push( queue.GetSize() ) );
+
+    check( queue.Peek( value ) );
+    check( value == 0 );
+
+    for ( int i = 0; i < queue.GetSize(); ++i )
+    {
+        check( queue.Pop( value ) );
+        check( value == i );
+    }
+
+    check( !queue.Pop( value ) );
+    check( !queue.IsFull() );
+
+    // producer on another thread, wrapping the queue many times. values must come out in order with none lost or repeated
+
+    const int NumValues = 1000000;
+
+    std::thread producer( spsc_queue_producer, &queue, NumValues );
+
+    int expected = 0;
+    while ( expected < NumValues )
+    {
+        if ( queue.Pop( value ) )
+        {
+            check( value == expected );
+            ++expected;
+        }
+    }
+
+    producer.join();
+
+    check( !queue.Pop( value ) );
+}
+
 bool parse_address( const char string[] )
 {
     Address address( string );
@@ -737,6 +796,53 @@ void test_sequence_buffer()
         check( sequence_buffer.Find(i) == NULL );
 }
 
+void test_sequence_buffer_remove_entries()
+{
+    // Insert with random gaps, through several wraps around 65536, and check that exactly the
+    // inserted sequence numbers in the most recent window are found. Gaps larger than the buffer
+    // clear it completely.
+
+    const int Sizes[] = { 256, 32 };
+
+    static bool inserted[65536];
+
+    for ( int j = 0; j < int( sizeof( Sizes ) / sizeof( Sizes[0] ) ); ++j )
+    {
+        const int Size = Sizes[j];
+
+        SequenceBuffer<TestSequenceData> sequence_buffer( GetDefaultAllocator(), Size );
+
+        memset( inserted, 0, sizeof( inserted ) );
+
+        uint16_t sequence = 0;
+
+        for ( int i = 0; i < 10000; ++i )
+        {
+            int gap = ( rand() % 8 == 0 ) ? 1 + rand() % ( Size * 2 ) : 1 + rand() % 3;
+            while ( gap-- > 0 )
+            {
+                sequence++;
+                inserted[sequence] = false;
+            }
+
+            TestSequenceData * entry = sequence_buffer.Insert( sequence );
+            check( entry );
+            entry->sequence = sequence;
+            inserted[sequence] = true;
+
+            check( sequence_buffer.GetSequence() == uint16_t( sequence + 1 ) );
+
+            for ( int k = 0; k < Size; ++k )
+            {
+                const uint16_t s = sequence - k;
+                TestSequenceData * found = sequence_buffer.Find( s );
+                check( ( found != NULL ) == inserted[s] );
+                check( !found || found->sequence == s );
+            }
+        }
+    }
+}
+
 void test_allocator_tlsf()
 {
     const int NumBlocks = 256;
@@ -787,7 +893,506 @@ void test_allocator_tlsf()
     free( memory );
 }
 
-void PumpConnectionUpdate( ConnectionConfig & connectionConfig, double & time, Connection & sender, Connection & receiver, uint16_t & senderSequence, uint16_t & receiverSequence, float deltaTime = 0.1f, int packetLossPercent = 90 )
+void test_allocator_tlsf_slab()
+{
+    const int MemorySize = 256 * 1024;
+
+    uint8_t * memory = (uint8_t*) malloc( MemorySize );
+
+    {
+        TLSF_SlabAllocator allocator( memory, MemorySize );
+
+        // mix small sizes across every size class with a few large blocks that go straight to TLSF
+
+        const int NumBlocks = 1024;
+
+        uint8_t * blockData[NumBlocks];
+        int blockSize[NumBlocks];
+
+        for ( int i = 0; i < NumBlocks; ++i )
+        {
+            blockSize[i] = ( i % 64 ) == 63 ? 1000 : 1 + ( i * 37 ) % TLSF_SlabAllocator::MaxBytes;
+            blockData[i] = (uint8_t*) YOJIMBO_ALLOCATE( allocator, blockSize[i] );
+            check( blockData[i] );
+            check( ( uintptr_t( blockData[i] ) & 15 ) == 0 );
+            memset( blockData[i], i & 0xFF, blockSize[i] );
+        }
+
+        check( allocator.GetErrorLevel() == ALLOCATOR_ERROR_NONE );
+        check( allocator.GetNumSlabs() > 0 );
+
+        // free in a scrambled order. 389 is coprime with the block count, so this visits every block once
+
+        for ( int n = 0; n < NumBlocks; ++n )
+        {
+            const int i = ( n * 389 ) % NumBlocks;
+            for ( int j = 0; j < blockSize[i]; ++j )
+                check( blockData[i][j] == uint8_t( i & 0xFF ) );
+            YOJIMBO_FREE( allocator, blockData[i] );
+        }
+
+        // only the one empty slab per size class is kept, so most of the memory is back in TLSF
+
+        check( allocator.GetNumSlabs() <= TLSF_SlabAllocator::NumSizeClasses );
+
+        uint8_t * large = (uint8_t*) YOJIMBO_ALLOCATE( allocator, MemorySize / 2 );
+        check( large );
+        YOJIMBO_FREE( allocator, large );
+
+        // fill the heap with small blocks until it runs out, then free them all
+
+        const int MaxSmallBlocks = MemorySize / 16;
+        uint8_t ** smallBlocks = (uint8_t**) malloc( sizeof( uint8_t* ) * MaxSmallBlocks );
+        int numSmallBlocks = 0;
+        while ( numSmallBlocks < MaxSmallBlocks )
+        {
+            uint8_t * p = (uint8_t*) YOJIMBO_ALLOCATE( allocator, 24 );
+            if ( !p )
+                break;
+            smallBlocks[numSmallBlocks++] = p;
+        }
+        check( numSmallBlocks > MemorySize / 64 );
+        check( allocator.GetErrorLevel() == ALLOCATOR_ERROR_OUT_OF_MEMORY );
+        allocator.ClearError();
+
+        for ( int i = 0; i < numSmallBlocks; ++i )
+        {
+            YOJIMBO_FREE( allocator, smallBlocks[i] );
+        }
+        free( smallBlocks );
+
+        check( allocator.GetNumSlabs() <= TLSF_SlabAllocator::NumSizeClasses );
+    }
+
+    free( memory );
+}
+
+void test_allocator_stats()
+{
+    const int MemorySize = 256 * 1024;
+
+    uint8_t * memory = (uint8_t*) malloc( MemorySize );
+
+    for ( int slabs = 0; slabs <= 1; ++slabs )
+    {
+        Allocator * allocator = slabs ? (Allocator*) new TLSF_SlabAllocator( memory, MemorySize ) : (Allocator*) new TLSF_Allocator( memory, MemorySize );
+
+        AllocatorStats stats;
+        check( allocator->GetStats( stats ) );
+        check( stats.heapBytes > 0 );
+        check( stats.heapBytes <= size_t( MemorySize ) );
+        check( stats.bytesInUse == 0 );
+        check( stats.numAllocations == 0 );
+        check( stats.numFreeBlocks >= 1 );
+        check( stats.largestFreeBlock > 0 );
+        check( stats.largestFreeBlock <= stats.freeBytes );
+
+        const size_t largestFreeBlockBefore = stats.largestFreeBlock;
+
+        const int NumBlocks = 8;
+        const int BlockSizes[NumBlocks] = { 8, 16, 100, 200, 1000, 4000, 10000, 50000 };
+        void * blocks[NumBlocks];
+        for ( int i = 0; i < NumBlocks; ++i )
+        {
+            blocks[i] = YOJIMBO_ALLOCATE( *allocator, BlockSizes[i] );
+            check( blocks[i] );
+        }
+
+        check( allocator->GetStats( stats ) );
+        check( stats.numAllocations == NumBlocks );
+        check( stats.totalAllocations == NumBlocks );
+        check( stats.bytesInUse >= 65324 );
+        check( stats.highWaterBytes == stats.bytesInUse );
+        check( stats.largestFreeBlock < largestFreeBlockBefore );
+
+        int numAllocations = 0;
+        for ( int i = 0; i < NumAllocatorSizeClasses; ++i )
+            numAllocations += stats.numAllocationsBySizeClass[i];
+        check( numAllocations == NumBlocks );
+        check( stats.numAllocationsBySizeClass[GetAllocatorSizeClass( 50000 )] == 1 );
+        check( GetAllocatorSizeClass( 50000 ) == NumAllocatorSizeClasses - 1 );
+        check( GetAllocatorSizeClass( 16 ) == 0 );
+        check( GetAllocatorSizeClass( 17 ) == 1 );
+
+        const size_t highWaterBytes = stats.highWaterBytes;
+
+        for ( int i = 0; i < NumBlocks; ++i )
+        {
+            YOJIMBO_FREE( *allocator, blocks[i] );
+        }
+
+        check( allocator->GetStats( stats ) );
+        check( stats.bytesInUse == 0 );
+        check( stats.numAllocations == 0 );
+        check( stats.highWaterBytes == highWaterBytes );
+        for ( int i = 0; i < NumAllocatorSizeClasses; ++i )
+            check( stats.numAllocationsBySizeClass[i] == 0 );
+
+        delete allocator;
+    }
+
+    // allocators that keep no counters say so
+
+    AllocatorStats stats;
+    check( !GetDefaultAllocator().GetStats( stats ) );
+    check( stats.bytesInUse == 0 );
+
+    free( memory );
+}
+
+void test_metrics_registry()
+{
+    MetricsRegistry metrics;
+
+    const double bounds[] = { 1.0, 10.0, 100.0 };
+
+    const int counter = metrics.AddCounter( "test_events_total", "Test \"events\"." );
+    const int gauge = metrics.AddGauge( "test_level", "Test level." );
+    const int histogram = metrics.AddHistogram( "test_size", "Test size.", bounds, 3 );
+
+    check( counter == 0 );
+    check( gauge == 1 );
+    check( histogram == 2 );
+    check( metrics.GetNumMetrics() == 3 );
+    check( metrics.AddCounter( "test_events_total", "Duplicate." ) == -1 );
+    check( metrics.FindMetric( "test_level" ) == gauge );
+    check( metrics.FindMetric( "missing" ) == -1 );
+
+    metrics.Increment( counter );
+    metrics.Increment( counter, 4 );
+    metrics.SetGauge( gauge, 2.5 );
+    metrics.Observe( histogram, 0.5 );
+    metrics.Observe( histogram, 1.0 );
+    metrics.Observe( histogram, 50.0 );
+    metrics.Observe( histogram, 1000.0 );
+
+    check( metrics.GetMetric( counter ).count == 5 );
+    check( metrics.GetMetric( gauge ).value == 2.5 );
+    const Metric & sizes = metrics.GetMetric( histogram );
+    check( sizes.count == 4 );
+    check( sizes.value == 1051.5 );
+    check( sizes.bucket[0] == 2 );
+    check( sizes.bucket[1] == 0 );
+    check( sizes.bucket[2] == 1 );
+    check( sizes.bucket[3] == 1 );
+
+    MetricsSnapshot snapshot;
+    metrics.GetSnapshot( snapshot );
+    check( snapshot.numMetrics == 3 );
+    check( snapshot.metric[histogram].bucket[3] == 1 );
+
+    // the snapshot keeps its values when the registry moves on
+
+    metrics.Reset();
+    check( metrics.GetNumMetrics() == 3 );
+    check( metrics.GetMetric( counter ).count == 0 );
+    check( metrics.GetMetric( histogram ).bucket[0] == 0 );
+    check( snapshot.metric[counter].count == 5 );
+
+    // prometheus buckets are cumulative, with a +Inf bucket
+
+    char text[4096];
+    const int length = WriteMetrics( snapshot, METRICS_FORMAT_PROMETHEUS, text, sizeof( text ) );
+    check( length > 0 );
+    check( length < int( sizeof( text ) ) );
+    check( int( strlen( text ) ) == length );
+    check( strstr( text, "# TYPE test_events_total counter\ntest_events_total 5\n" ) );
+    check( strstr( text, "test_level 2.5\n" ) );
+    check( strstr( text, "test_size_bucket{le=\"1\"} 2\n" ) );
+    check( strstr( text, "test_size_bucket{le=\"10\"} 2\n" ) );
+    check( strstr( text, "test_size_bucket{le=\"100\"} 3\n" ) );
+    check( strstr( text, "test_size_bucket{le=\"+Inf\"} 4\n" ) );
+    check( strstr( text, "test_size_sum 1051.5\n" ) );
+    check( strstr( text, "test_size_count 4\n" ) );
+
+    // size a buffer first, and truncated output is still terminated
+
+    check( WriteMetrics( snapshot, METRICS_FORMAT_PROMETHEUS, NULL, 0 ) == length );
+    char small[16];
+    check( WriteMetrics( snapshot, METRICS_FORMAT_PROMETHEUS, small, sizeof( small ) ) == length );
+    check( strlen( small ) == sizeof( small ) - 1 );
+
+    const int jsonLength = WriteMetrics( snapshot, METRICS_FORMAT_JSON, text, sizeof( text ) );
+    check( jsonLength > 0 );
+    check( jsonLength < int( sizeof( text ) ) );
+    check( strstr( text, "{\"name\":\"test_events_total\",\"help\":\"Test \\\"events\\\".\",\"type\":\"counter\",\"value\":5}" ) );
+    check( strstr( text, "\"type\":\"histogram\",\"count\":4,\"sum\":1051.5,\"buckets\":[{\"le\":1,\"count\":2}" ) );
+    check( strstr( text, "{\"le\":\"+Inf\",\"count\":4}]}" ) );
+
+    // export to a file, and read it back
+
+    const char * path = "test_metrics.prom";
+    check( ExportMetricsToFile( snapshot, METRICS_FORMAT_PROMETHEUS, path ) );
+    FILE * file = fopen( path, "rb" );
+    check( file );
+    char fileText[4096];
+    const size_t fileBytes = fread( fileText, 1, sizeof( fileText ) - 1, file );
+    fclose( file );
+    fileText[fileBytes] = '\0';
+    WriteMetrics( snapshot, METRICS_FORMAT_PROMETHEUS, text, sizeof( text ) );
+    check( strcmp( fileText, text ) == 0 );
+    remove( path );
+
+    // nothing listens on this socket
+
+    check( !ExportMetricsToSocket( snapshot, METRICS_FORMAT_PROMETHEUS, "test_metrics_no_listener.sock" ) );
+}
+
+#if YOJIMBO_ENABLE_TRACING
+
+static void trace_thread_function()
+{
+    YOJIMBO_TRACE_SCOPE( "test_trace_thread" );
+}
+
+#endif // #if YOJIMBO_ENABLE_TRACING
+
+void test_trace()
+{
+    const char * path = "test_trace.json";
+
+#if YOJIMBO_ENABLE_TRACING
+
+    yojimbo_trace_reset();
+
+    {
+        YOJIMBO_TRACE_SCOPE( "test_trace_outer" );
+        YOJIMBO_TRACE_BEGIN( "test_trace_inner" );
+        YOJIMBO_TRACE_END( "test_trace_inner" );
+    }
+
+    std::thread thread( trace_thread_function );
+    thread.join();
+
+    check( yojimbo_trace_write( path ) );
+
+    FILE * file = fopen( path, "rb" );
+    check( file );
+    fseek( file, 0, SEEK_END );
+    const long fileBytes = ftell( file );
+    fseek( file, 0, SEEK_SET );
+    check( fileBytes > 0 );
+    char * text = (char*) malloc( fileBytes + 1 );
+    check( fread( text, 1, fileBytes, file ) == size_t( fileBytes ) );
+    text[fileBytes] = '\0';
+    fclose( file );
+    remove( path );
+
+    check( strstr( text, "\"traceEvents\":[" ) );
+    check( strstr( text, "{\"name\":\"test_trace_outer\",\"cat\":\"yojimbo\",\"ph\":\"B\"" ) );
+    check( strstr( text, "{\"name\":\"test_trace_outer\",\"cat\":\"yojimbo\",\"ph\":\"E\"" ) );
+    check( strstr( text, "{\"name\":\"test_trace_inner\",\"cat\":\"yojimbo\",\"ph\":\"B\"" ) );
+    check( strstr( text, "{\"name\":\"test_trace_thread\",\"cat\":\"yojimbo\",\"ph\":\"E\"" ) );
+
+    // the other thread writes to its own buffer, so its events carry a different tid
+
+    const char * outer = strstr( text, "test_trace_outer" );
+    const char * other = strstr( text, "test_trace_thread" );
+    const char * outerTid = strstr( outer, "\"tid\":" );
+    const char * otherTid = strstr( other, "\"tid\":" );
+    check( outerTid && otherTid );
+    check( atoi( outerTid + 6 ) != atoi( otherTid + 6 ) );
+
+    free( text );
+
+    yojimbo_trace_reset();
+
+#else // #if YOJIMBO_ENABLE_TRACING
+
+    // compiled out: the macros are no-ops and there is nothing to write
+
+    YOJIMBO_TRACE_SCOPE( "test_trace_outer" );
+    YOJIMBO_TRACE_BEGIN( "test_trace_inner" );
+    YOJIMBO_TRACE_END( "test_trace_inner" );
+
+    check( !yojimbo_trace_write( path ) );
+
+#endif // #if YOJIMBO_ENABLE_TRACING
+}
+
+static char binary_log_text[16*1024];
+
+static int binary_log_function( const char * format, ... )
+{
+    const size_t length = strlen( binary_log_text );
+    va_list args;
+    va_start( args, format );
+    const int result = vsnprintf( binary_log_text + length, sizeof( binary_log_text ) - length, format, args );
+    va_end( args );
+    return result;
+}
+
+void test_binary_log()
+{
+    yojimbo_binary_log_flush( binary_log_function );
+    binary_log_text[0] = '\0';
+
+    // messages come out of a flush exactly as printf would have formatted them
+
+    const uint64_t recorded = yojimbo_binary_log_counter( YOJIMBO_BINARY_LOG_COUNTER_MESSAGES_RECORDED );
+    const uint64_t written = yojimbo_binary_log_counter( YOJIMBO_BINARY_LOG_COUNTER_MESSAGES_WRITTEN );
+
+    char name[] = "copied";
+    yojimbo_binary_log_printf( "int %d %05u %x %c %hd, long %ld %llu %zu, float %.2f %g, string %s %-8s| %.3s, star %*d %.*f, %p %% %%d\n",
+        -42, 7u, 255, 'y', (short) -3, -1234567890L, 1ULL << 40, (size_t) 99, 3.14159, 0.5, name, "left", "truncate", 5, 12, 1, 2.25, (void*) NULL );
+    name[0] = 'X';
+
+    check( yojimbo_binary_log_flush( binary_log_function ) == 1 );
+
+    char expected[1024];
+    snprintf( expected, sizeof( expected ), "int %d %05u %x %c %hd, long %ld %llu %zu, float %.2f %g, string %s %-8s| %.3s, star %*d %.*f, %p %% %%d\n",
+        -42, 7u, 255, 'y', (short) -3, -1234567890L, 1ULL << 40, (size_t) 99, 3.14159, 0.5, "copied", "left", "truncate", 5, 12, 1, 2.25, (void*) NULL );
+    check( strcmp( binary_log_text, expected ) == 0 );
+
+    check( yojimbo_binary_log_counter( YOJIMBO_BINARY_LOG_COUNTER_MESSAGES_RECORDED ) == recorded + 1 );
+    check( yojimbo_binary_log_counter( YOJIMBO_BINARY_LOG_COUNTER_MESSAGES_WRITTEN ) == written + 1 );
+
+    // a string argument too big for the message is cut short, and arguments after it are written as "?"
+
+    char longString[1024];
+    memset( longString, 'a', sizeof( longString ) - 1 );
+    longString[sizeof( longString ) - 1] = '\0';
+    binary_log_text[0] = '\0';
+    yojimbo_binary_log_printf( "%s %d\n", longString, 10 );
+    check( yojimbo_binary_log_flush( binary_log_function ) == 1 );
+    check( strlen( binary_log_text ) == YOJIMBO_BINARY_LOG_MESSAGE_BYTES - 1 + 3 );
+    check( strcmp( binary_log_text + YOJIMBO_BINARY_LOG_MESSAGE_BYTES - 1, " ?\n" ) == 0 );
+
+    // the rate limit keeps a few messages from each call site per window, and counts the rest
+
+    const uint64_t suppressed = yojimbo_binary_log_counter( YOJIMBO_BINARY_LOG_COUNTER_MESSAGES_SUPPRESSED );
+
+    yojimbo_binary_log_rate_limit( 3, 1000.0 );
+    for ( int i = 0; i < 10; ++i )
+        yojimbo_binary_log_printf( "repeated %d\n", i );
+    yojimbo_binary_log_printf( "other\n" );
+
+    binary_log_text[0] = '\0';
+    check( yojimbo_binary_log_flush( binary_log_function ) == 4 );
+    check( strcmp( binary_log_text, "repeated 0\nrepeated 1\nrepeated 2\nother\n" ) == 0 );
+    check( yojimbo_binary_log_counter( YOJIMBO_BINARY_LOG_COUNTER_MESSAGES_SUPPRESSED ) == suppressed + 7 );
+
+    // once the window ends, the next message says how many were discarded
+
+    yojimbo_binary_log_rate_limit( 3, 0.0 );
+    yojimbo_binary_log_printf( "repeated %d\n", 10 );
+    binary_log_text[0] = '\0';
+    check( yojimbo_binary_log_flush( binary_log_function ) == 1 );
+    check( strcmp( binary_log_text, "(7 similar messages suppressed)\nrepeated 10\n" ) == 0 );
+
+    // a full buffer drops new messages until the next flush
+
+    yojimbo_binary_log_rate_limit( 0, 0.0 );
+    const uint64_t dropped = yojimbo_binary_log_counter( YOJIMBO_BINARY_LOG_COUNTER_MESSAGES_DROPPED );
+    for ( int i = 0; i < YOJIMBO_BINARY_LOG_BUFFER_MESSAGES + 10; ++i )
+        yojimbo_binary_log_printf( "fill %d\n", i );
+    check( yojimbo_binary_log_counter( YOJIMBO_BINARY_LOG_COUNTER_MESSAGES_DROPPED ) == dropped + 10 );
+    binary_log_text[0] = '\0';
+    check( yojimbo_binary_log_flush( binary_log_function ) == YOJIMBO_BINARY_LOG_BUFFER_MESSAGES );
+    binary_log_text[0] = '\0';
+    yojimbo_binary_log_printf( "fill %d\n", 0 );
+    check( yojimbo_binary_log_flush( binary_log_function ) == 1 );
+
+    yojimbo_binary_log_rate_limit( 16, 1.0 );
+
+#if YOJIMBO_ENABLE_LOGGING
+
+    // installed as the printf function, library log messages go to the binary log unformatted, and the flush thread writes them
+
+    binary_log_text[0] = '\0';
+    const uint64_t writtenBefore = yojimbo_binary_log_counter( YOJIMBO_BINARY_LOG_COUNTER_MESSAGES_WRITTEN );
+    check( yojimbo_binary_log_start_thread( binary_log_function, 0.001 ) );
+    check( !yojimbo_binary_log_start_thread( binary_log_function, 0.001 ) );
+
+    yojimbo_set_printf_function( yojimbo_binary_log_printf );
+    yojimbo_log_level( YOJIMBO_LOG_LEVEL_INFO );
+    yojimbo_printf( YOJIMBO_LOG_LEVEL_INFO, "library message %d\n", 1 );
+    yojimbo_printf( YOJIMBO_LOG_LEVEL_DEBUG, "filtered by the log level\n" );
+    yojimbo_log_level( YOJIMBO_LOG_LEVEL_NONE );
+    yojimbo_set_printf_function( printf );
+
+    for ( int i = 0; i < 1000 && yojimbo_binary_log_counter( YOJIMBO_BINARY_LOG_COUNTER_MESSAGES_WRITTEN ) == writtenBefore; ++i )
+        yojimbo_sleep( 0.001 );
+
+    yojimbo_binary_log_stop_thread();
+
+    check( strcmp( binary_log_text, "library message 1\n" ) == 0 );
+
+#endif // #if YOJIMBO_ENABLE_LOGGING
+}
+
+void test_virtual_memory()
+{
+    const size_t pageSize = yojimbo_memory_page_size();
+    check( pageSize > 0 );
+    check( ( pageSize & ( pageSize - 1 ) ) == 0 );
+
+    const size_t NumPages = 16;
+    const size_t bytes = NumPages * pageSize;
+
+    uint8_t * memory = (uint8_t*) yojimbo_memory_reserve( bytes );
+    check( memory );
+    check( yojimbo_memory_resident( memory, bytes ) == 0 );
+
+    check( yojimbo_memory_commit( memory, bytes ) );
+
+    for ( size_t i = 0; i < NumPages; ++i )
+    {
+        memory[i*pageSize] = uint8_t( i + 1 );
+    }
+
+    check( yojimbo_memory_resident( memory, bytes ) == bytes );
+
+    yojimbo_memory_decommit( memory, bytes );
+
+    check( yojimbo_memory_resident( memory, bytes ) == 0 );
+
+    // commit again: the pages come back zeroed
+
+    check( yojimbo_memory_commit( memory, bytes ) );
+    for ( size_t i = 0; i < NumPages; ++i )
+    {
+        check( memory[i*pageSize] == 0 );
+    }
+
+    yojimbo_memory_release( memory, bytes );
+}
+
+void test_huge_page_memory()
+{
+    const size_t hugePageSize = yojimbo_memory_huge_page_size();
+    const size_t pageSize = hugePageSize != 0 ? hugePageSize : yojimbo_memory_page_size();
+    const size_t bytes = 4 * pageSize;
+
+    const int numaNode = yojimbo_memory_numa_node();
+    check( numaNode >= -1 );
+
+    for ( int hugePages = 0; hugePages <= 1; ++hugePages )
+    {
+        uint8_t * memory = (uint8_t*) yojimbo_memory_map( bytes, hugePages != 0, numaNode );
+        check( memory );
+        if ( hugePages && hugePageSize != 0 )
+            check( ( uintptr_t( memory ) & ( hugePageSize - 1 ) ) == 0 );
+
+        // mapped memory comes zeroed and committed
+
+        for ( size_t i = 0; i < bytes; i += 4096 )
+        {
+            check( memory[i] == 0 );
+            memory[i] = uint8_t( i >> 12 );
+        }
+        for ( size_t i = 0; i < bytes; i += 4096 )
+        {
+            check( memory[i] == uint8_t( i >> 12 ) );
+        }
+
+        check( yojimbo_memory_resident( memory, bytes ) > 0 );
+
+        yojimbo_memory_release( memory, bytes );
+    }
+}
+
+template <typename Sender, typename Receiver> void PumpConnectionUpdate( ConnectionConfig & connectionConfig, double & time, Sender & sender, Receiver & receiver, uint16_t & senderSequence, uint16_t & receiverSequence, float deltaTime = 0.1f, int packetLossPercent = 90 )
 {
     uint8_t * packetData = (uint8_t*) alloca( connectionConfig.maxPacketSize );
 
@@ -878,117 +1483,213 @@ void test_connection_reliable_ordered_messages()
     check( numMessagesReceived == NumMessagesSent );
 }
 
-void test_connection_reliable_ordered_blocks()
+void test_connection_reliable_ordered_batched_acks()
 {
+    // Acks for several packets delivered in one ProcessAcks call, out of order, must ack every message they cover.
+
     TestMessageFactory messageFactory( GetDefaultAllocator() );
 
     double time = 100.0;
 
     ConnectionConfig connectionConfig;
+    connectionConfig.channel[ReliableChannel].maxMessagesPerPacket = 4;
 
     Connection sender( GetDefaultAllocator(), messageFactory, connectionConfig, time );
     Connection receiver( GetDefaultAllocator(), messageFactory, connectionConfig, time );
 
-    const int NumMessagesSent = 32;
+    const int NumPackets = 8;
+    const int NumMessagesSent = NumPackets * 4;
 
     for ( int i = 0; i < NumMessagesSent; ++i )
     {
-        TestBlockMessage * message = (TestBlockMessage*) messageFactory.CreateMessage( TEST_BLOCK_MESSAGE );
+        TestMessage * message = (TestMessage*) messageFactory.CreateMessage( TEST_MESSAGE );
         check( message );
         message->sequence = i;
-        const int blockSize = 1 + ( ( i * 901 ) % 3333 );
-        uint8_t * blockData = (uint8_t*) YOJIMBO_ALLOCATE( messageFactory.GetAllocator(), blockSize );
-        for ( int j = 0; j < blockSize; ++j )
-            blockData[j] = i + j;
-        message->AttachBlock( messageFactory.GetAllocator(), blockData, blockSize );
         sender.SendMessage( ReliableChannel, message );
     }
 
-    int numMessagesReceived = 0;
-
-    uint16_t senderSequence = 0;
-    uint16_t receiverSequence = 0;
+    uint8_t * packetData = (uint8_t*) alloca( connectionConfig.maxPacketSize );
 
-    const int NumIterations = 10000;
+    uint16_t acks[NumPackets];
 
-    for ( int i = 0; i < NumIterations; ++i )
+    for ( int i = 0; i < NumPackets; ++i )
     {
-        PumpConnectionUpdate( connectionConfig, time, sender, receiver, senderSequence, receiverSequence );
-
-        while ( true )
-        {
-            Message * message = receiver.ReceiveMessage( ReliableChannel );
-            if ( !message )
-                break;
-
-            check( message->GetId() == (int) numMessagesReceived );
-
-            check( message->GetType() == TEST_BLOCK_MESSAGE );
-
-            TestBlockMessage * blockMessage = (TestBlockMessage*) message;
-
-            check( blockMessage->sequence == uint16_t( numMessagesReceived ) );
-
-            const int blockSize = blockMessage->GetBlockSize();
+        int packetBytes = 0;
+        check( sender.GeneratePacket( NULL, uint16_t( i ), packetData, connectionConfig.maxPacketSize, packetBytes ) );
+        check( receiver.ProcessPacket( NULL, uint16_t( i ), packetData, packetBytes ) );
+        acks[NumPackets-1-i] = uint16_t( i );
+    }
 
-            check( blockSize == 1 + ( ( numMessagesReceived * 901 ) % 3333 ) );
+    // Everything but the first packet. The oldest messages are still unacked, so there is still something to send.
 
-            const uint8_t * blockData = blockMessage->GetBlockData();
+    sender.ProcessAcks( acks, NumPackets - 1 );
 
-            check( blockData );
+    check( sender.HasMessagesToSend( ReliableChannel ) );
 
-            for ( int j = 0; j < blockSize; ++j )
-            {
-                check( blockData[j] == uint8_t( numMessagesReceived + j ) );
-            }
+    sender.ProcessAcks( &acks[NumPackets-1], 1 );
 
-            ++numMessagesReceived;
+    check( !sender.HasMessagesToSend( ReliableChannel ) );
 
-            messageFactory.ReleaseMessage( message );
-        }
+    int numMessagesReceived = 0;
 
-        if ( numMessagesReceived == NumMessagesSent )
-            break;
+    while ( Message * message = receiver.ReceiveMessage( ReliableChannel ) )
+    {
+        check( ( (TestMessage*) message )->sequence == uint16_t( numMessagesReceived ) );
+        ++numMessagesReceived;
+        messageFactory.ReleaseMessage( message );
     }
 
     check( numMessagesReceived == NumMessagesSent );
+    check( !sender.GetErrorLevel() && !receiver.GetErrorLevel() );
 }
 
-void test_connection_reliable_ordered_blocks_max_size()
+void test_connection_reliable_ordered_resend_order()
 {
-    // Regression test: when maxBlockSize is not a multiple of blockFragmentSize, a
-    // full-size block needs ceil(maxBlockSize/blockFragmentSize) fragments. The
-    // send-side fragment buffers used to be sized with floor division, so sending a
-    // maxBlockSize block overflowed them. Here 1100/500 => floor 2, ceil 3.
+    // Due resends go out before anything else, longest waiting first.
+
     TestMessageFactory messageFactory( GetDefaultAllocator() );
 
     double time = 100.0;
 
     ConnectionConfig connectionConfig;
-    connectionConfig.channel[ReliableChannel].maxBlockSize = 1100;
-    connectionConfig.channel[ReliableChannel].blockFragmentSize = 500;
+    connectionConfig.channel[ReliableChannel].maxMessagesPerPacket = 4;
 
     Connection sender( GetDefaultAllocator(), messageFactory, connectionConfig, time );
     Connection receiver( GetDefaultAllocator(), messageFactory, connectionConfig, time );
 
-    const int NumMessagesSent = 8;
-    const int BlockSize = connectionConfig.channel[ReliableChannel].maxBlockSize;
+    const int NumMessagesSent = 12;
+
+    for ( int i = 0; i < NumMessagesSent; ++i )
+    {
+        TestMessage * message = (TestMessage*) messageFactory.CreateMessage( TEST_MESSAGE );
+        check( message );
+        message->sequence = i;
+        sender.SendMessage( ReliableChannel, message );
+    }
+
+    uint8_t * packetData = (uint8_t*) alloca( connectionConfig.maxPacketSize );
+    int packetBytes = 0;
+
+    // Messages 0-3 are lost, 4-7 arrive.
+
+    check( sender.GeneratePacket( NULL, 0, packetData, connectionConfig.maxPacketSize, packetBytes ) );
+    check( sender.GeneratePacket( NULL, 1, packetData, connectionConfig.maxPacketSize, packetBytes ) );
+    check( receiver.ProcessPacket( NULL, 1, packetData, packetBytes ) );
+
+    check( receiver.ReceiveMessage( ReliableChannel ) == NULL );
+
+    // Once 0-3 are due they go out ahead of 8-11, which have never been sent.
+
+    time += connectionConfig.channel[ReliableChannel].messageResendTime;
+    sender.AdvanceTime( time );
+    receiver.AdvanceTime( time );
+
+    check( sender.GeneratePacket( NULL, 2, packetData, connectionConfig.maxPacketSize, packetBytes ) );
+    check( receiver.ProcessPacket( NULL, 2, packetData, packetBytes ) );
+
+    int numMessagesReceived = 0;
+
+    while ( Message * message = receiver.ReceiveMessage( ReliableChannel ) )
+    {
+        check( ( (TestMessage*) message )->sequence == uint16_t( numMessagesReceived ) );
+        ++numMessagesReceived;
+        messageFactory.ReleaseMessage( message );
+    }
+
+    check( numMessagesReceived == 8 );
+    check( !sender.GetErrorLevel() && !receiver.GetErrorLevel() );
+}
+
+void test_connection_reliable_ordered_packet_budget()
+{
+    // When bits are the limit, a packet carries as many messages as their exact cost allows. Consecutive message ids
+    // cost 16 bits for the first and 1 bit for each one after it, not the most a message id can cost.
+
+    TestMessageFactory messageFactory( GetDefaultAllocator() );
+
+    double time = 100.0;
+
+    ConnectionConfig connectionConfig;
+    connectionConfig.channel[ReliableChannel].maxMessagesPerPacket = 64;
+    connectionConfig.channel[ReliableChannel].packetBudget = 64;
+
+    Connection sender( GetDefaultAllocator(), messageFactory, connectionConfig, time );
+    Connection receiver( GetDefaultAllocator(), messageFactory, connectionConfig, time );
+
+    const int NumMessagesSent = 64;
+
+    int messageBits = 0;
+
+    for ( int i = 0; i < NumMessagesSent; ++i )
+    {
+        TestMessage * message = (TestMessage*) messageFactory.CreateMessage( TEST_MESSAGE );
+        check( message );
+        message->sequence = uint16_t( i * 21 );                     // all the same size. see GetNumBitsForMessage
+        messageBits = messageFactory.MeasureMessage( message, NULL ) + bits_required( 0, messageFactory.GetNumTypes() - 1 );
+        sender.SendMessage( ReliableChannel, message );
+    }
+
+    // The channel stops adding messages once fewer than 4 bytes are left.
+
+    const int availableBits = connectionConfig.channel[ReliableChannel].packetBudget * 8;
+    int usedBits = ConservativeMessageHeaderBits;
+    int numMessagesExpected = 0;
+    while ( availableBits - usedBits >= 32 && usedBits + messageBits + ( numMessagesExpected == 0 ? 16 : 1 ) <= availableBits )
+    {
+        usedBits += messageBits + ( numMessagesExpected == 0 ? 16 : 1 );
+        numMessagesExpected++;
+    }
+
+    uint8_t * packetData = (uint8_t*) alloca( connectionConfig.maxPacketSize );
+    int packetBytes = 0;
+
+    check( sender.GeneratePacket( NULL, 0, packetData, connectionConfig.maxPacketSize, packetBytes ) );
+    check( receiver.ProcessPacket( NULL, 0, packetData, packetBytes ) );
+
+    int numMessagesReceived = 0;
+
+    while ( Message * message = receiver.ReceiveMessage( ReliableChannel ) )
+    {
+        check( ( (TestMessage*) message )->sequence == uint16_t( numMessagesReceived * 21 ) );
+        ++numMessagesReceived;
+        messageFactory.ReleaseMessage( message );
+    }
+
+    check( numMessagesReceived == numMessagesExpected );
+    check( !sender.GetErrorLevel() && !receiver.GetErrorLevel() );
+}
+
+void test_connection_reliable_ordered_blocks()
+{
+    TestMessageFactory messageFactory( GetDefaultAllocator() );
+
+    double time = 100.0;
+
+    ConnectionConfig connectionConfig;
+
+    Connection sender( GetDefaultAllocator(), messageFactory, connectionConfig, time );
+    Connection receiver( GetDefaultAllocator(), messageFactory, connectionConfig, time );
+
+    const int NumMessagesSent = 32;
 
     for ( int i = 0; i < NumMessagesSent; ++i )
     {
         TestBlockMessage * message = (TestBlockMessage*) messageFactory.CreateMessage( TEST_BLOCK_MESSAGE );
         check( message );
         message->sequence = i;
-        uint8_t * blockData = (uint8_t*) YOJIMBO_ALLOCATE( messageFactory.GetAllocator(), BlockSize );
-        for ( int j = 0; j < BlockSize; ++j )
-            blockData[j] = uint8_t( i + j );
-        message->AttachBlock( messageFactory.GetAllocator(), blockData, BlockSize );
+        const int blockSize = 1 + ( ( i * 901 ) % 3333 );
+        uint8_t * blockData = (uint8_t*) YOJIMBO_ALLOCATE( messageFactory.GetAllocator(), blockSize );
+        for ( int j = 0; j < blockSize; ++j )
+            blockData[j] = i + j;
+        message->AttachBlock( messageFactory.GetAllocator(), blockData, blockSize );
         sender.SendMessage( ReliableChannel, message );
     }
 
     int numMessagesReceived = 0;
+
     uint16_t senderSequence = 0;
     uint16_t receiverSequence = 0;
+
     const int NumIterations = 10000;
 
     for ( int i = 0; i < NumIterations; ++i )
@@ -1002,20 +1703,28 @@ void test_connection_reliable_ordered_blocks_max_size()
                 break;
 
             check( message->GetId() == (int) numMessagesReceived );
+
             check( message->GetType() == TEST_BLOCK_MESSAGE );
 
             TestBlockMessage * blockMessage = (TestBlockMessage*) message;
+
             check( blockMessage->sequence == uint16_t( numMessagesReceived ) );
 
             const int blockSize = blockMessage->GetBlockSize();
-            check( blockSize == BlockSize );
+
+            check( blockSize == 1 + ( ( numMessagesReceived * 901 ) % 3333 ) );
 
             const uint8_t * blockData = blockMessage->GetBlockData();
+
             check( blockData );
+
             for ( int j = 0; j < blockSize; ++j )
+            {
                 check( blockData[j] == uint8_t( numMessagesReceived + j ) );
+            }
 
             ++numMessagesReceived;
+
             messageFactory.ReleaseMessage( message );
         }
 
@@ -1026,48 +1735,41 @@ void test_connection_reliable_ordered_blocks_max_size()
     check( numMessagesReceived == NumMessagesSent );
 }
 
-void test_connection_reliable_ordered_messages_and_blocks()
+void test_connection_reliable_ordered_blocks_max_size()
 {
+    // Regression test: when maxBlockSize is not a multiple of blockFragmentSize, a
+    // full-size block needs ceil(maxBlockSize/blockFragmentSize) fragments. The
+    // send-side fragment buffers used to be sized with floor division, so sending a
+    // maxBlockSize block overflowed them. Here 1100/500 => floor 2, ceil 3.
     TestMessageFactory messageFactory( GetDefaultAllocator() );
 
     double time = 100.0;
 
     ConnectionConfig connectionConfig;
+    connectionConfig.channel[ReliableChannel].maxBlockSize = 1100;
+    connectionConfig.channel[ReliableChannel].blockFragmentSize = 500;
 
     Connection sender( GetDefaultAllocator(), messageFactory, connectionConfig, time );
-
     Connection receiver( GetDefaultAllocator(), messageFactory, connectionConfig, time );
 
-    const int NumMessagesSent = 32;
+    const int NumMessagesSent = 8;
+    const int BlockSize = connectionConfig.channel[ReliableChannel].maxBlockSize;
 
     for ( int i = 0; i < NumMessagesSent; ++i )
     {
-        if ( rand() % 2 )
-        {
-            TestMessage * message = (TestMessage*) messageFactory.CreateMessage( TEST_MESSAGE );
-            check( message );
-            message->sequence = i;
-            sender.SendMessage( ReliableChannel, message );
-        }
-        else
-        {
-            TestBlockMessage * message = (TestBlockMessage*) messageFactory.CreateMessage( TEST_BLOCK_MESSAGE );
-            check( message );
-            message->sequence = i;
-            const int blockSize = 1 + ( ( i * 901 ) % 3333 );
-            uint8_t * blockData = (uint8_t*) YOJIMBO_ALLOCATE( messageFactory.GetAllocator(), blockSize );
-            for ( int j = 0; j < blockSize; ++j )
-                blockData[j] = i + j;
-            message->AttachBlock( messageFactory.GetAllocator(), blockData, blockSize );
-            sender.SendMessage( ReliableChannel, message );
-        }
+        TestBlockMessage * message = (TestBlockMessage*) messageFactory.CreateMessage( TEST_BLOCK_MESSAGE );
+        check( message );
+        message->sequence = i;
+        uint8_t * blockData = (uint8_t*) YOJIMBO_ALLOCATE( messageFactory.GetAllocator(), BlockSize );
+        for ( int j = 0; j < BlockSize; ++j )
+            blockData[j] = uint8_t( i + j );
+        message->AttachBlock( messageFactory.GetAllocator(), blockData, BlockSize );
+        sender.SendMessage( ReliableChannel, message );
     }
 
     int numMessagesReceived = 0;
-
     uint16_t senderSequence = 0;
     uint16_t receiverSequence = 0;
-
     const int NumIterations = 10000;
 
     for ( int i = 0; i < NumIterations; ++i )
@@ -1081,43 +1783,20 @@ void test_connection_reliable_ordered_messages_and_blocks()
                 break;
 
             check( message->GetId() == (int) numMessagesReceived );
+            check( message->GetType() == TEST_BLOCK_MESSAGE );
 
-            switch ( message->GetType() )
-            {
-                case TEST_MESSAGE:
-                {
-                    TestMessage * testMessage = (TestMessage*) message;
-
-                    check( testMessage->sequence == uint16_t( numMessagesReceived ) );
-
-                    ++numMessagesReceived;
-                }
-                break;
-
-                case TEST_BLOCK_MESSAGE:
-                {
-                    TestBlockMessage * blockMessage = (TestBlockMessage*) message;
-
-                    check( blockMessage->sequence == uint16_t( numMessagesReceived ) );
-
-                    const int blockSize = blockMessage->GetBlockSize();
-
-                    check( blockSize == 1 + ( ( numMessagesReceived * 901 ) % 3333 ) );
-
-                    const uint8_t * blockData = blockMessage->GetBlockData();
-
-                    check( blockData );
+            TestBlockMessage * blockMessage = (TestBlockMessage*) message;
+            check( blockMessage->sequence == uint16_t( numMessagesReceived ) );
 
-                    for ( int j = 0; j < blockSize; ++j )
-                    {
-                        check( blockData[j] == uint8_t( numMessagesReceived + j ) );
-                    }
+            const int blockSize = blockMessage->GetBlockSize();
+            check( blockSize == BlockSize );
 
-                    ++numMessagesReceived;
-                }
-                break;
-            }
+            const uint8_t * blockData = blockMessage->GetBlockData();
+            check( blockData );
+            for ( int j = 0; j < blockSize; ++j )
+                check( blockData[j] == uint8_t( numMessagesReceived + j ) );
 
+            ++numMessagesReceived;
             messageFactory.ReleaseMessage( message );
         }
 
@@ -1128,162 +1807,188 @@ void test_connection_reliable_ordered_messages_and_blocks()
     check( numMessagesReceived == NumMessagesSent );
 }
 
-void test_connection_reliable_ordered_messages_and_blocks_multiple_channels()
+static int SendBlocksAndCountUpdates( ConnectionConfig & connectionConfig, int numBlocks, int blockSize )
 {
-    const int NumChannels = 2;
-
-    yojimbo_assert( NumChannels >= 0 );
-    yojimbo_assert( NumChannels <= MaxChannels );
-
-    double time = 100.0;
+    // Returns the number of lossless updates until the receiver has every block, checking they arrive in order and intact.
 
     TestMessageFactory messageFactory( GetDefaultAllocator() );
 
-    ConnectionConfig connectionConfig;
-    connectionConfig.numChannels = NumChannels;
-    connectionConfig.channel[0].type = CHANNEL_TYPE_RELIABLE_ORDERED;
-    connectionConfig.channel[0].maxMessagesPerPacket = 8;
-    connectionConfig.channel[1].type = CHANNEL_TYPE_RELIABLE_ORDERED;
-    connectionConfig.channel[1].maxMessagesPerPacket = 8;
+    double time = 100.0;
 
     Connection sender( GetDefaultAllocator(), messageFactory, connectionConfig, time );
-
     Connection receiver( GetDefaultAllocator(), messageFactory, connectionConfig, time );
 
-    const int NumMessagesSent = 32;
-
-    for ( int channelIndex = 0; channelIndex < NumChannels; ++channelIndex )
+    for ( int i = 0; i < numBlocks; ++i )
     {
-        for ( int i = 0; i < NumMessagesSent; ++i )
-        {
-            if ( rand() % 2 )
-            {
-                TestMessage * message = (TestMessage*) messageFactory.CreateMessage( TEST_MESSAGE );
-                check( message );
-                message->sequence = i;
-                sender.SendMessage( channelIndex, message );
-            }
-            else
-            {
-                TestBlockMessage * message = (TestBlockMessage*) messageFactory.CreateMessage( TEST_BLOCK_MESSAGE );
-                check( message );
-                message->sequence = i;
-                const int blockSize = 1 + ( ( i * 901 ) % 3333 );
-                uint8_t * blockData = (uint8_t*) YOJIMBO_ALLOCATE( messageFactory.GetAllocator(), blockSize );
-                for ( int j = 0; j < blockSize; ++j )
-                    blockData[j] = i + j;
-                message->AttachBlock( messageFactory.GetAllocator(), blockData, blockSize );
-                sender.SendMessage( channelIndex, message );
-            }
-        }
+        TestBlockMessage * message = (TestBlockMessage*) messageFactory.CreateMessage( TEST_BLOCK_MESSAGE );
+        check( message );
+        message->sequence = i;
+        uint8_t * blockData = (uint8_t*) YOJIMBO_ALLOCATE( messageFactory.GetAllocator(), blockSize );
+        for ( int j = 0; j < blockSize; ++j )
+            blockData[j] = i + j;
+        message->AttachBlock( messageFactory.GetAllocator(), blockData, blockSize );
+        sender.SendMessage( ReliableChannel, message );
     }
 
-    const int NumIterations = 10000;
-
-    int numMessagesReceived[NumChannels];
-    memset( numMessagesReceived, 0, sizeof( numMessagesReceived ) );
+    int numMessagesReceived = 0;
 
     uint16_t senderSequence = 0;
     uint16_t receiverSequence = 0;
 
-    for ( int i = 0; i < NumIterations; ++i )
+    const int NumIterations = 1000;
+
+    int i = 0;
+
+    for ( ; i < NumIterations && numMessagesReceived < numBlocks; ++i )
     {
-        PumpConnectionUpdate( connectionConfig, time, sender, receiver, senderSequence, receiverSequence );
+        PumpConnectionUpdate( connectionConfig, time, sender, receiver, senderSequence, receiverSequence, 0.1f, 0 );
 
-        for ( int channelIndex = 0; channelIndex < NumChannels; ++channelIndex )
+        while ( Message * message = receiver.ReceiveMessage( ReliableChannel ) )
         {
-            while ( true )
-            {
-                Message * message = receiver.ReceiveMessage( channelIndex );
-                if ( !message )
-                    break;
-
-                check( message->GetId() == (int) numMessagesReceived[channelIndex] );
+            check( message->GetId() == (int) numMessagesReceived );
+            check( message->GetType() == TEST_BLOCK_MESSAGE );
 
-                switch ( message->GetType() )
-                {
-                    case TEST_MESSAGE:
-                    {
-                        TestMessage * testMessage = (TestMessage*) message;
+            TestBlockMessage * blockMessage = (TestBlockMessage*) message;
 
-                        check( testMessage->sequence == uint16_t( numMessagesReceived[channelIndex] ) );
+            check( blockMessage->sequence == uint16_t( numMessagesReceived ) );
+            check( blockMessage->GetBlockSize() == blockSize );
 
-                        ++numMessagesReceived[channelIndex];
-                    }
-                    break;
+            const uint8_t * blockData = blockMessage->GetBlockData();
+            for ( int j = 0; j < blockSize; ++j )
+                check( blockData[j] == uint8_t( numMessagesReceived + j ) );
 
-                    case TEST_BLOCK_MESSAGE:
-                    {
-                        TestBlockMessage * blockMessage = (TestBlockMessage*) message;
+            ++numMessagesReceived;
 
-                        check( blockMessage->sequence == uint16_t( numMessagesReceived[channelIndex] ) );
+            messageFactory.ReleaseMessage( message );
+        }
+    }
 
-                        const int blockSize = blockMessage->GetBlockSize();
+    check( numMessagesReceived == numBlocks );
+    check( !sender.GetErrorLevel() && !receiver.GetErrorLevel() );
 
-                        check( blockSize == 1 + ( ( numMessagesReceived[channelIndex] * 901 ) % 3333 ) );
+    return i;
+}
 
-                        const uint8_t * blockData = blockMessage->GetBlockData();
+void test_connection_reliable_ordered_blocks_multiple_fragments()
+{
+    // A 16 fragment block takes one packet per fragment at one fragment per packet, and a quarter of that at four.
 
-                        check( blockData );
+    ConnectionConfig connectionConfig;
+    connectionConfig.channel[0].maxBlockSize = 16 * 1024;
+    connectionConfig.channel[0].blockFragmentSize = 1024;
 
-                        for ( int j = 0; j < blockSize; ++j )
-                        {
-                            check( blockData[j] == uint8_t( numMessagesReceived[channelIndex] + j ) );
-                        }
+    connectionConfig.channel[0].maxFragmentsPerPacket = 1;
+    check( SendBlocksAndCountUpdates( connectionConfig, 1, 16 * 1024 ) == 16 );
 
-                        ++numMessagesReceived[channelIndex];
-                    }
-                    break;
-                }
+    connectionConfig.channel[0].maxFragmentsPerPacket = 4;
+    check( SendBlocksAndCountUpdates( connectionConfig, 1, 16 * 1024 ) == 4 );
 
-                messageFactory.ReleaseMessage( message );
-            }
-        }
+    // A packet smaller than four fragments holds as many as fit.
 
-        bool receivedAllMessages = true;
+    connectionConfig.maxPacketSize = 3 * 1024;
+    check( SendBlocksAndCountUpdates( connectionConfig, 1, 16 * 1024 ) == 8 );
+}
 
-        for ( int channelIndex = 0; channelIndex < NumChannels; ++channelIndex )
-        {
-            if ( numMessagesReceived[channelIndex] != NumMessagesSent )
-            {
-                receivedAllMessages = false;
-                break;
-            }
-        }
+void test_connection_reliable_ordered_blocks_in_flight()
+{
+    // Single fragment blocks. With one block in flight each block waits for the previous one to be acked.
+    // With a window, fragments of several blocks go out together in the same packet.
 
-        if ( receivedAllMessages )
-            break;
-    }
+    ConnectionConfig connectionConfig;
+    connectionConfig.channel[0].maxBlockSize = 1024;
+    connectionConfig.channel[0].blockFragmentSize = 1024;
+    connectionConfig.channel[0].maxFragmentsPerPacket = 4;
 
-    for ( int channelIndex = 0; channelIndex < NumChannels; ++channelIndex )
+    connectionConfig.channel[0].maxBlocksInFlight = 1;
+    check( SendBlocksAndCountUpdates( connectionConfig, 8, 1000 ) == 8 );
+
+    connectionConfig.channel[0].maxBlocksInFlight = 4;
+    check( SendBlocksAndCountUpdates( connectionConfig, 8, 1000 ) == 2 );
+}
+
+static uint8_t StreamByte( uint64_t offset )
+{
+    return uint8_t( ( offset * 7 ) ^ ( offset >> 11 ) );
+}
+
+static bool ReadTestStream( void * context, uint64_t offset, uint8_t * data, int bytes )
+{
+    int * numReads = (int*) context;
+    ( *numReads )++;
+    for ( int i = 0; i < bytes; ++i )
+        data[i] = StreamByte( offset + i );
+    return true;
+}
+
+struct TestStreamSink
+{
+    uint64_t bytesWritten;
+    int numWrites;
+    bool valid;
+};
+
+static bool WriteTestStream( void * context, BlockMessage * message, uint64_t offset, const uint8_t * data, int bytes )
+{
+    TestStreamSink * sink = (TestStreamSink*) context;
+    if ( message->GetType() != TEST_BLOCK_MESSAGE || ( (TestBlockMessage*) message )->sequence != 1000 || offset != sink->bytesWritten )
+        sink->valid = false;
+    for ( int i = 0; i < bytes; ++i )
     {
-        check( numMessagesReceived[channelIndex] == NumMessagesSent );
+        if ( data[i] != StreamByte( offset + i ) )
+            sink->valid = false;
     }
+    sink->bytesWritten += bytes;
+    sink->numWrites++;
+    return true;
 }
 
-void test_connection_unreliable_unordered_messages()
+void test_connection_reliable_ordered_block_stream()
 {
+    // A stream many times the maximum block size, sent between regular messages under packet loss.
+    // It arrives in order through the write function, and the message carrying it is delivered in its place among the others.
+
     TestMessageFactory messageFactory( GetDefaultAllocator() );
 
     double time = 100.0;
 
     ConnectionConfig connectionConfig;
-    connectionConfig.numChannels = 1;
-    connectionConfig.channel[0].type = CHANNEL_TYPE_UNRELIABLE_UNORDERED;
+    connectionConfig.channel[0].maxBlockSize = 4 * 1024;
+    connectionConfig.channel[0].blockFragmentSize = 1024;
+    connectionConfig.channel[0].streamWindowSize = 8;
 
     Connection sender( GetDefaultAllocator(), messageFactory, connectionConfig, time );
     Connection receiver( GetDefaultAllocator(), messageFactory, connectionConfig, time );
 
-    const int NumIterations = 256;
+    TestStreamSink sink;
+    sink.bytesWritten = 0;
+    sink.numWrites = 0;
+    sink.valid = true;
 
-    const int NumMessagesSent = 16;
+    receiver.SetBlockStreamWriteFunction( ReliableChannel, WriteTestStream, &sink );
 
-    for ( int j = 0; j < NumMessagesSent; ++j )
+    const uint64_t StreamSize = 100 * 1024 + 123;
+
+    int numReads = 0;
+
+    const int NumMessagesSent = 3;
+
+    for ( int i = 0; i < NumMessagesSent; ++i )
     {
-        TestMessage * message = (TestMessage*) messageFactory.CreateMessage( TEST_MESSAGE );
-        check( message );
-        message->sequence = j;
-        sender.SendMessage( 0, message );
+        if ( i == 1 )
+        {
+            TestBlockMessage * message = (TestBlockMessage*) messageFactory.CreateMessage( TEST_BLOCK_MESSAGE );
+            check( message );
+            message->sequence = 1000;
+            message->AttachBlockStream( StreamSize, ReadTestStream, &numReads );
+            sender.SendMessage( ReliableChannel, message );
+        }
+        else
+        {
+            TestMessage * message = (TestMessage*) messageFactory.CreateMessage( TEST_MESSAGE );
+            check( message );
+            message->sequence = i;
+            sender.SendMessage( ReliableChannel, message );
+        }
     }
 
     int numMessagesReceived = 0;
@@ -1291,761 +1996,2888 @@ void test_connection_unreliable_unordered_messages()
     uint16_t senderSequence = 0;
     uint16_t receiverSequence = 0;
 
-    for ( int i = 0; i < NumIterations; ++i )
+    const int NumIterations = 10000;
+
+    for ( int i = 0; i < NumIterations && numMessagesReceived < NumMessagesSent; ++i )
     {
-        PumpConnectionUpdate( connectionConfig, time, sender, receiver, senderSequence, receiverSequence, 0.1f, 0 );
+        PumpConnectionUpdate( connectionConfig, time, sender, receiver, senderSequence, receiverSequence, 0.1f, 50 );
 
-        while ( true )
+        while ( Message * message = receiver.ReceiveMessage( ReliableChannel ) )
         {
-            Message * message = receiver.ReceiveMessage( 0 );
-            if ( !message )
-                break;
-
-            check( message->GetType() == TEST_MESSAGE );
-
-            TestMessage * testMessage = (TestMessage*) message;
+            check( message->GetId() == (int) numMessagesReceived );
 
-            check( testMessage->sequence == uint16_t( numMessagesReceived ) );
+            if ( numMessagesReceived == 1 )
+            {
+                check( message->GetType() == TEST_BLOCK_MESSAGE );
+                BlockMessage * blockMessage = (BlockMessage*) message;
+                check( blockMessage->IsBlockStream() );
+                check( blockMessage->GetBlockStreamSize() == StreamSize );
+                check( blockMessage->GetBlockData() == NULL );
+                check( sink.bytesWritten == StreamSize );
+            }
+            else
+            {
+                check( message->GetType() == TEST_MESSAGE );
+                check( ( (TestMessage*) message )->sequence == numMessagesReceived );
+            }
 
             ++numMessagesReceived;
 
             messageFactory.ReleaseMessage( message );
         }
-
-        if ( numMessagesReceived == NumMessagesSent )
-            break;
     }
 
     check( numMessagesReceived == NumMessagesSent );
+    check( sink.valid );
+    check( sink.numWrites == 101 );
+    check( numReads >= 101 );
+    check( !sender.GetErrorLevel() && !receiver.GetErrorLevel() );
 }
 
-void test_connection_unreliable_unordered_blocks()
+void test_connection_reliable_ordered_block_stream_no_write_function()
 {
+    // A stream sent to a channel with nowhere to write it is an error, rather than something to buffer.
+
     TestMessageFactory messageFactory( GetDefaultAllocator() );
 
     double time = 100.0;
 
     ConnectionConfig connectionConfig;
-    connectionConfig.numChannels = 1;
-    connectionConfig.channel[0].type = CHANNEL_TYPE_UNRELIABLE_UNORDERED;
+    connectionConfig.channel[0].streamWindowSize = 8;
 
     Connection sender( GetDefaultAllocator(), messageFactory, connectionConfig, time );
-
     Connection receiver( GetDefaultAllocator(), messageFactory, connectionConfig, time );
 
-    const int NumIterations = 256;
+    int numReads = 0;
 
-    const int NumMessagesSent = 8;
+    TestBlockMessage * message = (TestBlockMessage*) messageFactory.CreateMessage( TEST_BLOCK_MESSAGE );
+    check( message );
+    message->AttachBlockStream( 10000, ReadTestStream, &numReads );
+    sender.SendMessage( ReliableChannel, message );
 
-    for ( int j = 0; j < NumMessagesSent; ++j )
+    uint16_t senderSequence = 0;
+    uint16_t receiverSequence = 0;
+
+    PumpConnectionUpdate( connectionConfig, time, sender, receiver, senderSequence, receiverSequence, 0.1f, 0 );
+
+    check( receiver.GetErrorLevel() == CONNECTION_ERROR_CHANNEL );
+    check( receiver.GetChannelErrorLevel( ReliableChannel ) == CHANNEL_ERROR_STREAM_FAILED );
+}
+
+static void CheckCompressionRoundTrip( const uint8_t * data, int bytes, const uint8_t * dictionary, int dictionaryBytes )
+{
+    const int bound = yojimbo_compress_bound( bytes );
+    uint8_t * compressed = (uint8_t*) YOJIMBO_ALLOCATE( GetDefaultAllocator(), bound );
+    uint8_t * decompressed = (uint8_t*) YOJIMBO_ALLOCATE( GetDefaultAllocator(), bytes + 1 );
+
+    const int compressedBytes = yojimbo_compress( data, bytes, compressed, bound, dictionary, dictionaryBytes );
+    check( compressedBytes > 0 );
+    check( compressedBytes <= bound );
+
+    check( yojimbo_decompress( compressed, compressedBytes, decompressed, bytes, dictionary, dictionaryBytes ) == bytes );
+    check( bytes == 0 || memcmp( data, decompressed, bytes ) == 0 );
+
+    // Every truncation must fail cleanly or decode a prefix of the data, never overrun.
+
+    for ( int i = 0; i < compressedBytes; ++i )
     {
-        TestBlockMessage * message = (TestBlockMessage*) messageFactory.CreateMessage( TEST_BLOCK_MESSAGE );
-        check( message );
-        message->sequence = j;
-        const int blockSize = 1 + ( j * 7 );
-        uint8_t * blockData = (uint8_t*) YOJIMBO_ALLOCATE( messageFactory.GetAllocator(), blockSize );
-        for ( int k = 0; k < blockSize; ++k )
-            blockData[k] = j + k;
-        message->AttachBlock( messageFactory.GetAllocator(), blockData, blockSize );
-        sender.SendMessage( 0, message );
+        const int result = yojimbo_decompress( compressed, i, decompressed, bytes, dictionary, dictionaryBytes );
+        check( result >= -1 && result <= bytes );
+        check( result <= 0 || memcmp( data, decompressed, result ) == 0 );
     }
 
-    int numMessagesReceived = 0;
+    YOJIMBO_FREE( GetDefaultAllocator(), compressed );
+    YOJIMBO_FREE( GetDefaultAllocator(), decompressed );
+}
 
-    uint16_t senderSequence = 0;
-    uint16_t receiverSequence = 0;
+void test_compression()
+{
+    const int Size = 4096;
 
-    for ( int i = 0; i < NumIterations; ++i )
-    {
-        PumpConnectionUpdate( connectionConfig, time, sender, receiver, senderSequence, receiverSequence, 0.1f, 0 );
+    uint8_t * data = (uint8_t*) YOJIMBO_ALLOCATE( GetDefaultAllocator(), Size );
+    uint8_t * compressed = (uint8_t*) YOJIMBO_ALLOCATE( GetDefaultAllocator(), yojimbo_compress_bound( Size ) );
+    uint8_t * output = (uint8_t*) YOJIMBO_ALLOCATE( GetDefaultAllocator(), Size );
 
-        while ( true )
-        {
-            Message * message = receiver.ReceiveMessage( 0 );
-            if ( !message )
-                break;
+    CheckCompressionRoundTrip( data, 0, NULL, 0 );
 
-            check( message->GetType() == TEST_BLOCK_MESSAGE );
+    // repetitive data compresses well
 
-            TestBlockMessage * blockMessage = (TestBlockMessage*) message;
+    for ( int i = 0; i < Size; ++i )
+        data[i] = uint8_t( i );
 
-            check( blockMessage->sequence == uint16_t( numMessagesReceived ) );
+    CheckCompressionRoundTrip( data, 1, NULL, 0 );
+    CheckCompressionRoundTrip( data, 7, NULL, 0 );
+    CheckCompressionRoundTrip( data, Size, NULL, 0 );
+    check( yojimbo_compress( data, Size, compressed, Size / 8, NULL, 0 ) > 0 );
 
-            const int blockSize = blockMessage->GetBlockSize();
+    memset( data, 0, Size );
+    CheckCompressionRoundTrip( data, Size, NULL, 0 );
 
-            check( blockSize == 1 + ( numMessagesReceived * 7 ) );
+    // random data doesn't, and is rejected when the output is smaller than the input
 
-            const uint8_t * blockData = blockMessage->GetBlockData();
+    yojimbo_random_bytes( data, Size );
+    CheckCompressionRoundTrip( data, Size, NULL, 0 );
+    check( yojimbo_compress( data, Size, compressed, Size - 1, NULL, 0 ) == 0 );
 
-            check( blockData );
+    // a short message that shares content with the dictionary compresses against it
 
-            for ( int j = 0; j < blockSize; ++j )
-            {
-                check( blockData[j] == uint8_t( numMessagesReceived + j ) );
-            }
+    const char dictionary[] = "{\"type\":\"chat\",\"channel\":\"global\",\"text\":\"\"}{\"type\":\"move\",\"x\":0,\"y\":0}";
+    const char text[] = "{\"type\":\"chat\",\"channel\":\"global\",\"text\":\"hello\"}";
+    const int textBytes = (int) strlen( text );
+    const int dictionaryBytes = (int) strlen( dictionary );
 
-            ++numMessagesReceived;
+    CheckCompressionRoundTrip( (const uint8_t*) text, textBytes, (const uint8_t*) dictionary, dictionaryBytes );
+    check( yojimbo_compress( (const uint8_t*) text, textBytes, compressed, textBytes - 1, NULL, 0 ) == 0 );
+    check( yojimbo_compress( (const uint8_t*) text, textBytes, compressed, textBytes - 1, (const uint8_t*) dictionary, dictionaryBytes ) > 0 );
 
-            messageFactory.ReleaseMessage( message );
-        }
+    // garbage input never writes past the output
 
-        if ( numMessagesReceived == NumMessagesSent )
-            break;
+    for ( int i = 0; i < 1000; ++i )
+    {
+        const int bytes = yojimbo_random_int( 1, 64 );
+        yojimbo_random_bytes( compressed, bytes );
+        const int result = yojimbo_decompress( compressed, bytes, output, 32, (const uint8_t*) dictionary, dictionaryBytes );
+        check( result >= -1 && result <= 32 );
     }
 
-    check( numMessagesReceived == NumMessagesSent );
+    YOJIMBO_FREE( GetDefaultAllocator(), data );
+    YOJIMBO_FREE( GetDefaultAllocator(), compressed );
+    YOJIMBO_FREE( GetDefaultAllocator(), output );
 }
 
-void test_connection_reject_empty_packet()
+void test_connection_reliable_ordered_blocks_compressed()
 {
-    // A packet that is exactly a reliable header reaches Connection::ProcessPacket with
-    // zero payload bytes. That must be rejected cleanly, not fed to the bit reader (which
-    // used to trip the bufferSize > 0 assert in ReadPacket).
-
-    TestMessageFactory messageFactory( GetDefaultAllocator() );
-
-    double time = 100.0;
+    // The test blocks repeat every 256 bytes, so a 16 fragment block compresses down to a single fragment.
 
     ConnectionConfig connectionConfig;
-    connectionConfig.numChannels = 1;
-    connectionConfig.channel[0].type = CHANNEL_TYPE_RELIABLE_ORDERED;
+    connectionConfig.channel[0].maxBlockSize = 16 * 1024;
+    connectionConfig.channel[0].blockFragmentSize = 1024;
+    connectionConfig.channel[0].maxFragmentsPerPacket = 1;
 
-    Connection connection( GetDefaultAllocator(), messageFactory, connectionConfig, time );
+    check( SendBlocksAndCountUpdates( connectionConfig, 1, 16 * 1024 ) == 16 );
 
-    uint8_t buffer[1] = { 0 };
+    connectionConfig.channel[0].compressBlocks = true;
+    check( SendBlocksAndCountUpdates( connectionConfig, 1, 16 * 1024 ) == 1 );
+    check( SendBlocksAndCountUpdates( connectionConfig, 8, 3000 ) == 8 );
 
-    check( !connection.ProcessPacket( NULL, 0, buffer, 0 ) );
-    check( connection.GetErrorLevel() == CONNECTION_ERROR_READ_PACKET_FAILED );
-}
+    // Blocks too small to compress are sent as-is.
 
-void test_connection_unreliable_rejects_block_fragment()
-{
-    // An unreliable-unordered channel never sends a top-level block fragment (its blocks
-    // are serialized inline). A peer that puts a block fragment on that channel index used
-    // to be misread through the ChannelPacketData union (a BlockMessage* reinterpreted as a
-    // message-pointer array) and crash. It must instead be rejected as a serialize failure.
+    check( SendBlocksAndCountUpdates( connectionConfig, 4, 1 ) == 4 );
+
+    // Incompressible blocks are sent as-is, mixed with compressed blocks, under packet loss.
 
     TestMessageFactory messageFactory( GetDefaultAllocator() );
 
     double time = 100.0;
 
-    // Sender speaks reliable-ordered on channel 0, so it emits a top-level block fragment.
-    ConnectionConfig senderConfig;
-    senderConfig.numChannels = 1;
-    senderConfig.channel[0].type = CHANNEL_TYPE_RELIABLE_ORDERED;
+    Connection sender( GetDefaultAllocator(), messageFactory, connectionConfig, time );
+    Connection receiver( GetDefaultAllocator(), messageFactory, connectionConfig, time );
 
-    // Receiver treats channel 0 as unreliable-unordered.
-    ConnectionConfig receiverConfig;
-    receiverConfig.numChannels = 1;
-    receiverConfig.channel[0].type = CHANNEL_TYPE_UNRELIABLE_UNORDERED;
+    const int NumMessagesSent = 16;
+    const int BlockSize = 5000;
 
-    Connection sender( GetDefaultAllocator(), messageFactory, senderConfig, time );
-    Connection receiver( GetDefaultAllocator(), messageFactory, receiverConfig, time );
+    uint8_t randomData[BlockSize];
+    yojimbo_random_bytes( randomData, BlockSize );
 
-    TestBlockMessage * message = (TestBlockMessage*) messageFactory.CreateMessage( TEST_BLOCK_MESSAGE );
-    check( message );
-    message->sequence = 0;
-    const int blockSize = 64;
-    uint8_t * blockData = (uint8_t*) YOJIMBO_ALLOCATE( messageFactory.GetAllocator(), blockSize );
-    for ( int i = 0; i < blockSize; ++i )
-        blockData[i] = (uint8_t) i;
-    message->AttachBlock( messageFactory.GetAllocator(), blockData, blockSize );
-    sender.SendMessage( 0, message );
+    for ( int i = 0; i < NumMessagesSent; ++i )
+    {
+        TestBlockMessage * message = (TestBlockMessage*) messageFactory.CreateMessage( TEST_BLOCK_MESSAGE );
+        check( message );
+        message->sequence = i;
+        uint8_t * blockData = (uint8_t*) YOJIMBO_ALLOCATE( messageFactory.GetAllocator(), BlockSize );
+        for ( int j = 0; j < BlockSize; ++j )
+            blockData[j] = ( i & 1 ) ? randomData[j] : uint8_t( j / 100 );
+        message->AttachBlock( messageFactory.GetAllocator(), blockData, BlockSize );
+        sender.SendMessage( ReliableChannel, message );
+    }
 
-    // The sender is never acked, so it keeps re-sending the block fragment every tick.
-    // Feed each generated packet to the receiver until its unreliable channel rejects the
-    // fragment and the connection drops into the channel error state.
-    uint8_t * packetData = (uint8_t*) alloca( senderConfig.maxPacketSize );
-    uint16_t sequence = 0;
-    bool sawChannelError = false;
+    int numMessagesReceived = 0;
 
-    for ( int i = 0; i < 64 && !sawChannelError; ++i )
+    uint16_t senderSequence = 0;
+    uint16_t receiverSequence = 0;
+
+    for ( int i = 0; i < 10000 && numMessagesReceived < NumMessagesSent; ++i )
     {
-        int packetBytes = 0;
-        if ( sender.GeneratePacket( NULL, sequence, packetData, senderConfig.maxPacketSize, packetBytes ) && packetBytes > 0 )
-            receiver.ProcessPacket( NULL, sequence, packetData, packetBytes );
+        PumpConnectionUpdate( connectionConfig, time, sender, receiver, senderSequence, receiverSequence );
 
-        sender.AdvanceTime( time );
-        receiver.AdvanceTime( time );
-        time += 0.1;
-        sequence++;
+        while ( Message * message = receiver.ReceiveMessage( ReliableChannel ) )
+        {
+            TestBlockMessage * blockMessage = (TestBlockMessage*) message;
 
-        if ( receiver.GetErrorLevel() == CONNECTION_ERROR_CHANNEL )
-            sawChannelError = true;
-    }
+            check( blockMessage->sequence == uint16_t( numMessagesReceived ) );
+            check( blockMessage->GetBlockSize() == BlockSize );
 
-    check( sawChannelError );
+            const uint8_t * blockData = blockMessage->GetBlockData();
+            for ( int j = 0; j < BlockSize; ++j )
+                check( blockData[j] == ( ( numMessagesReceived & 1 ) ? randomData[j] : uint8_t( j / 100 ) ) );
+
+            ++numMessagesReceived;
+
+            messageFactory.ReleaseMessage( message );
+        }
+    }
+
+    check( numMessagesReceived == NumMessagesSent );
+    check( !sender.GetErrorLevel() && !receiver.GetErrorLevel() );
 }
 
-void test_connection_reliable_block_fragment_on_disabled_blocks()
+void test_connection_reliable_ordered_messages_and_blocks()
 {
-    // A peer sends a block fragment on a reliable-ordered channel, but the receiver has
-    // blocks disabled on that channel. ChannelPacketData::Serialize reads blockMessage=1 then
-    // returns early on disableBlocks, before SerializeBlockFragment initializes the block
-    // pointers. The packet destructor's Free() must not then dereference an uninitialized
-    // block.message (it used to, because Initialize() only zeroed part of the union).
-
     TestMessageFactory messageFactory( GetDefaultAllocator() );
 
     double time = 100.0;
 
-    // Sender: reliable-ordered with blocks enabled, so it emits a real block fragment.
-    ConnectionConfig senderConfig;
-    senderConfig.numChannels = 1;
-    senderConfig.channel[0].type = CHANNEL_TYPE_RELIABLE_ORDERED;
-
-    // Receiver: reliable-ordered on the same channel, but with blocks disabled.
-    ConnectionConfig receiverConfig;
-    receiverConfig.numChannels = 1;
-    receiverConfig.channel[0].type = CHANNEL_TYPE_RELIABLE_ORDERED;
-    receiverConfig.channel[0].disableBlocks = true;
+    ConnectionConfig connectionConfig;
 
-    Connection sender( GetDefaultAllocator(), messageFactory, senderConfig, time );
-    Connection receiver( GetDefaultAllocator(), messageFactory, receiverConfig, time );
+    Connection sender( GetDefaultAllocator(), messageFactory, connectionConfig, time );
 
-    TestBlockMessage * message = (TestBlockMessage*) messageFactory.CreateMessage( TEST_BLOCK_MESSAGE );
-    check( message );
-    message->sequence = 0;
-    const int blockSize = 2000;   // > fragment size, but even a single fragment reproduces it
-    uint8_t * blockData = (uint8_t*) YOJIMBO_ALLOCATE( messageFactory.GetAllocator(), blockSize );
-    for ( int i = 0; i < blockSize; ++i )
-        blockData[i] = (uint8_t) i;
-    message->AttachBlock( messageFactory.GetAllocator(), blockData, blockSize );
-    sender.SendMessage( 0, message );
+    Connection receiver( GetDefaultAllocator(), messageFactory, connectionConfig, time );
 
-    // Feed generated block-fragment packets to the receiver. Before the fix this crashed in
-    // the packet destructor; after it, the read simply fails and the connection errors.
-    uint8_t * packetData = (uint8_t*) alloca( senderConfig.maxPacketSize );
-    uint16_t sequence = 0;
+    const int NumMessagesSent = 32;
 
-    for ( int i = 0; i < 64; ++i )
+    for ( int i = 0; i < NumMessagesSent; ++i )
     {
-        int packetBytes = 0;
-        if ( sender.GeneratePacket( NULL, sequence, packetData, senderConfig.maxPacketSize, packetBytes ) && packetBytes > 0 )
-            receiver.ProcessPacket( NULL, sequence, packetData, packetBytes );
-
-        sender.AdvanceTime( time );
-        receiver.AdvanceTime( time );
-        time += 0.1;
-        sequence++;
-
-        if ( receiver.GetErrorLevel() != CONNECTION_ERROR_NONE )
-            break;
+        if ( rand() % 2 )
+        {
+            TestMessage * message = (TestMessage*) messageFactory.CreateMessage( TEST_MESSAGE );
+            check( message );
+            message->sequence = i;
+            sender.SendMessage( ReliableChannel, message );
+        }
+        else
+        {
+            TestBlockMessage * message = (TestBlockMessage*) messageFactory.CreateMessage( TEST_BLOCK_MESSAGE );
+            check( message );
+            message->sequence = i;
+            const int blockSize = 1 + ( ( i * 901 ) % 3333 );
+            uint8_t * blockData = (uint8_t*) YOJIMBO_ALLOCATE( messageFactory.GetAllocator(), blockSize );
+            for ( int j = 0; j < blockSize; ++j )
+                blockData[j] = i + j;
+            message->AttachBlock( messageFactory.GetAllocator(), blockData, blockSize );
+            sender.SendMessage( ReliableChannel, message );
+        }
     }
 
-    // The receiver rejected the disallowed block fragment without crashing.
-    check( receiver.GetErrorLevel() != CONNECTION_ERROR_NONE );
-}
+    int numMessagesReceived = 0;
 
-// Hand-serialize a connection packet carrying a single reliable-ordered channel entry that is
-// a block fragment. Matches ConnectionPacket + ChannelPacketData::Serialize + SerializeBlockFragment
-// for a numChannels==1 config. Lets tests inject fragment fields a well-behaved sender never would.
-template <typename Stream> static bool SerializeRawBlockFragmentPacket( Stream & stream, int maxFragmentsPerBlock, int blockFragmentSize, int numFragments, int fragmentId, int fragmentSize )
-{
-    int numChannelEntries = 1;
-    serialize_int( stream, numChannelEntries, 0, 1 );   // numChannels == 1, so channelIndex is not serialized
+    uint16_t senderSequence = 0;
+    uint16_t receiverSequence = 0;
 
-    bool blockMessage = true;
-    serialize_bool( stream, blockMessage );
+    const int NumIterations = 10000;
 
-    uint32_t messageId = 0;
-    serialize_bits( stream, messageId, 16 );
+    for ( int i = 0; i < NumIterations; ++i )
+    {
+        PumpConnectionUpdate( connectionConfig, time, sender, receiver, senderSequence, receiverSequence );
 
-    if ( maxFragmentsPerBlock > 1 )
-        serialize_int( stream, numFragments, 1, maxFragmentsPerBlock );
+        while ( true )
+        {
+            Message * message = receiver.ReceiveMessage( ReliableChannel );
+            if ( !message )
+                break;
 
-    if ( numFragments > 1 )
-        serialize_int( stream, fragmentId, 0, numFragments - 1 );
+            check( message->GetId() == (int) numMessagesReceived );
 
-    serialize_int( stream, fragmentSize, 1, blockFragmentSize );
+            switch ( message->GetType() )
+            {
+                case TEST_MESSAGE:
+                {
+                    TestMessage * testMessage = (TestMessage*) message;
 
-    uint8_t payload[2048];
-    yojimbo_assert( fragmentSize <= (int) sizeof( payload ) );
-    memset( payload, 0xAB, sizeof( payload ) );
-    serialize_bytes( stream, payload, fragmentSize );
+                    check( testMessage->sequence == uint16_t( numMessagesReceived ) );
 
-    // fragmentId != 0 here, so no message type / block message is serialized.
-    return true;
-}
+                    ++numMessagesReceived;
+                }
+                break;
 
-void test_connection_reliable_block_fragment_overflow()
-{
-    // Regression test: a peer sends a reliable-ordered block fragment whose final fragment
-    // claims a full blockFragmentSize of data, even though maxBlockSize is not a multiple of
-    // blockFragmentSize. The receive buffer (blockData) is maxBlockSize bytes, but the final
-    // fragment is copied at offset (numFragments-1)*blockFragmentSize, so a full-size copy
-    // used to run past the end of the buffer (heap-buffer-overflow, caught by ASan). The
-    // fragment must be rejected before the copy. fragmentSize is attacker-controllable in
-    // [1,blockFragmentSize], so a legitimate sender never produces this.
+                case TEST_BLOCK_MESSAGE:
+                {
+                    TestBlockMessage * blockMessage = (TestBlockMessage*) message;
 
-    TestMessageFactory messageFactory( GetDefaultAllocator() );
+                    check( blockMessage->sequence == uint16_t( numMessagesReceived ) );
 
-    double time = 100.0;
+                    const int blockSize = blockMessage->GetBlockSize();
 
-    ConnectionConfig config;
-    config.numChannels = 1;
-    config.channel[0].type = CHANNEL_TYPE_RELIABLE_ORDERED;
-    config.channel[0].maxBlockSize = 1100;      // deliberately not a multiple of blockFragmentSize
-    config.channel[0].blockFragmentSize = 500;  // => GetMaxFragmentsPerBlock() == ceil(1100/500) == 3
+                    check( blockSize == 1 + ( ( numMessagesReceived * 901 ) % 3333 ) );
 
-    Connection receiver( GetDefaultAllocator(), messageFactory, config, time );
+                    const uint8_t * blockData = blockMessage->GetBlockData();
 
-    const int maxFragmentsPerBlock = config.channel[0].GetMaxFragmentsPerBlock();
-    const int blockFragmentSize = config.channel[0].blockFragmentSize;
+                    check( blockData );
 
-    // messageId=0 (== expected receive sequence), final fragment, full blockFragmentSize payload.
-    const int numFragments = maxFragmentsPerBlock;   // 3
-    const int fragmentId = numFragments - 1;         // 2 (final fragment)
-    const int fragmentSize = blockFragmentSize;      // 500 -> write [1000,1500) into a 1100-byte buffer
+                    for ( int j = 0; j < blockSize; ++j )
+                    {
+                        check( blockData[j] == uint8_t( numMessagesReceived + j ) );
+                    }
 
-    uint8_t buffer[4096];
-    memset( buffer, 0, sizeof( buffer ) );
-    WriteStream stream( buffer, sizeof( buffer ) );
-    check( SerializeRawBlockFragmentPacket( stream, maxFragmentsPerBlock, blockFragmentSize, numFragments, fragmentId, fragmentSize ) );
-    stream.Flush();
-    const int packetBytes = stream.GetBytesProcessed();
-    check( packetBytes > 0 );
+                    ++numMessagesReceived;
+                }
+                break;
+            }
 
-    // Before the fix this overflowed the receive buffer inside ProcessPacketFragment. After the
-    // fix the fragment is rejected: the read fails and the channel drops into an error state.
-    const bool processed = receiver.ProcessPacket( NULL, 0, buffer, packetBytes );
-    check( !processed );
+            messageFactory.ReleaseMessage( message );
+        }
 
-    receiver.AdvanceTime( time );
-    check( receiver.GetErrorLevel() == CONNECTION_ERROR_CHANNEL );
+        if ( numMessagesReceived == NumMessagesSent )
+            break;
+    }
+
+    check( numMessagesReceived == NumMessagesSent );
 }
 
-void test_connection_reliable_over_budget_packet()
+void test_connection_reliable_unordered_messages_and_blocks()
 {
-    // A peer sends more channel data than the receiver's configured packetBudget. On read this
-    // used to trip the YOJIMBO_DEBUG_MESSAGE_BUDGET assert — a remote crash in debug builds
-    // reachable from a decrypted-but-attacker-controlled packet. The message count and sizes
-    // are already bounded by the serialize_* range checks, so an over-budget read must simply
-    // be accepted, not asserted on.
-
     TestMessageFactory messageFactory( GetDefaultAllocator() );
 
     double time = 100.0;
 
-    // Sender: default (unlimited) packet budget, so it packs messages freely.
-    ConnectionConfig senderConfig;
-    senderConfig.numChannels = 1;
-    senderConfig.channel[0].type = CHANNEL_TYPE_RELIABLE_ORDERED;
-
-    // Receiver: a small per-channel packet budget.
-    ConnectionConfig receiverConfig;
-    receiverConfig.numChannels = 1;
-    receiverConfig.channel[0].type = CHANNEL_TYPE_RELIABLE_ORDERED;
-    receiverConfig.channel[0].packetBudget = 32;
+    ConnectionConfig connectionConfig;
+    connectionConfig.numChannels = 1;
+    connectionConfig.channel[0].type = CHANNEL_TYPE_RELIABLE_UNORDERED;
 
-    Connection sender( GetDefaultAllocator(), messageFactory, senderConfig, time );
-    Connection receiver( GetDefaultAllocator(), messageFactory, receiverConfig, time );
+    Connection sender( GetDefaultAllocator(), messageFactory, connectionConfig, time );
 
-    const int NumMessages = 64;
-    for ( int i = 0; i < NumMessages; ++i )
-    {
-        TestMessage * message = (TestMessage*) messageFactory.CreateMessage( TEST_MESSAGE );
-        check( message );
-        message->sequence = (uint16_t) i;
-        sender.SendMessage( 0, message );
-    }
+    Connection receiver( GetDefaultAllocator(), messageFactory, connectionConfig, time );
 
-    // The first generated packet carries far more than 32 bytes of channel data. Before the
-    // fix, processing it aborted the receiver in the budget assert; after, it reads cleanly.
-    uint8_t * packetData = (uint8_t*) alloca( senderConfig.maxPacketSize );
-    uint16_t sequence = 0;
-    bool processed = false;
+    const int NumMessagesSent = 64;
 
-    for ( int i = 0; i < 8 && !processed; ++i )
+    for ( int i = 0; i < NumMessagesSent; ++i )
     {
-        int packetBytes = 0;
-        if ( sender.GeneratePacket( NULL, sequence, packetData, senderConfig.maxPacketSize, packetBytes ) && packetBytes > 0 )
+        if ( rand() % 4 )
         {
-            check( receiver.ProcessPacket( NULL, sequence, packetData, packetBytes ) );
-            processed = true;
+            TestMessage * message = (TestMessage*) messageFactory.CreateMessage( TEST_MESSAGE );
+            check( message );
+            message->sequence = i;
+            sender.SendMessage( 0, message );
+        }
+        else
+        {
+            TestBlockMessage * message = (TestBlockMessage*) messageFactory.CreateMessage( TEST_BLOCK_MESSAGE );
+            check( message );
+            message->sequence = i;
+            const int blockSize = 1 + ( ( i * 901 ) % 3333 );
+            uint8_t * blockData = (uint8_t*) YOJIMBO_ALLOCATE( messageFactory.GetAllocator(), blockSize );
+            for ( int j = 0; j < blockSize; ++j )
+                blockData[j] = i + j;
+            message->AttachBlock( messageFactory.GetAllocator(), blockData, blockSize );
+            sender.SendMessage( 0, message );
         }
-
-        sender.AdvanceTime( time );
-        receiver.AdvanceTime( time );
-        time += 0.1;
-        sequence++;
     }
 
-    check( processed );
-    check( receiver.GetErrorLevel() == CONNECTION_ERROR_NONE );
-}
+    bool received[NumMessagesSent];
+    memset( received, 0, sizeof( received ) );
 
-void PumpClientServerUpdate( double & time, Client ** client, int numClients, Server ** server, int numServers, float deltaTime = 0.1f )
-{
-    for ( int i = 0; i < numClients; ++i )
-        client[i]->SendPackets();
+    int numMessagesReceived = 0;
+
+    uint16_t senderSequence = 0;
+    uint16_t receiverSequence = 0;
+
+    const int NumIterations = 10000;
+
+    for ( int i = 0; i < NumIterations; ++i )
+    {
+        PumpConnectionUpdate( connectionConfig, time, sender, receiver, senderSequence, receiverSequence );
+
+        while ( true )
+        {
+            Message * message = receiver.ReceiveMessage( 0 );
+            if ( !message )
+                break;
+
+            // Messages may arrive in any order, but each one exactly once.
+
+            const int messageId = message->GetId();
+
+            check( messageId >= 0 && messageId < NumMessagesSent );
+            check( !received[messageId] );
+
+            received[messageId] = true;
+
+            switch ( message->GetType() )
+            {
+                case TEST_MESSAGE:
+                {
+                    TestMessage * testMessage = (TestMessage*) message;
+
+                    check( testMessage->sequence == uint16_t( messageId ) );
+                }
+                break;
+
+                case TEST_BLOCK_MESSAGE:
+                {
+                    TestBlockMessage * blockMessage = (TestBlockMessage*) message;
+
+                    check( blockMessage->sequence == uint16_t( messageId ) );
+
+                    const int blockSize = blockMessage->GetBlockSize();
+
+                    check( blockSize == 1 + ( ( messageId * 901 ) % 3333 ) );
+
+                    const uint8_t * blockData = blockMessage->GetBlockData();
+
+                    check( blockData );
+
+                    for ( int j = 0; j < blockSize; ++j )
+                    {
+                        check( blockData[j] == uint8_t( messageId + j ) );
+                    }
+                }
+                break;
+            }
+
+            ++numMessagesReceived;
+
+            messageFactory.ReleaseMessage( message );
+        }
+
+        if ( numMessagesReceived == NumMessagesSent )
+            break;
+    }
+
+    check( numMessagesReceived == NumMessagesSent );
+}
+
+void test_connection_reliable_unordered_no_head_of_line_blocking()
+{
+    // Lose the packet carrying message 0, then deliver the packet carrying message 1.
+    // A reliable-unordered channel must hand message 1 out immediately instead of waiting
+    // for message 0 to be resent, and still deliver message 0 once the resend arrives.
+
+    TestMessageFactory messageFactory( GetDefaultAllocator() );
+
+    double time = 100.0;
+
+    ConnectionConfig connectionConfig;
+    connectionConfig.numChannels = 1;
+    connectionConfig.channel[0].type = CHANNEL_TYPE_RELIABLE_UNORDERED;
+
+    Connection sender( GetDefaultAllocator(), messageFactory, connectionConfig, time );
+
+    Connection receiver( GetDefaultAllocator(), messageFactory, connectionConfig, time );
+
+    uint8_t * packetData = (uint8_t*) alloca( connectionConfig.maxPacketSize );
+    int packetBytes = 0;
+    uint16_t senderSequence = 0;
+
+    TestMessage * message = (TestMessage*) messageFactory.CreateMessage( TEST_MESSAGE );
+    check( message );
+    message->sequence = 0;
+    sender.SendMessage( 0, message );
+
+    check( sender.GeneratePacket( NULL, senderSequence++, packetData, connectionConfig.maxPacketSize, packetBytes ) );
+
+    message = (TestMessage*) messageFactory.CreateMessage( TEST_MESSAGE );
+    check( message );
+    message->sequence = 1;
+    sender.SendMessage( 0, message );
+
+    // message 0 is not due for resend yet, so this packet carries only message 1
+
+    check( sender.GeneratePacket( NULL, senderSequence, packetData, connectionConfig.maxPacketSize, packetBytes ) );
+    check( receiver.ProcessPacket( NULL, senderSequence, packetData, packetBytes ) );
+    sender.ProcessAcks( &senderSequence, 1 );
+    senderSequence++;
+
+    Message * received = receiver.ReceiveMessage( 0 );
+    check( received );
+    check( received->GetId() == 1 );
+    messageFactory.ReleaseMessage( received );
+
+    check( receiver.ReceiveMessage( 0 ) == NULL );
+
+    time += 1.0;
+    sender.AdvanceTime( time );
+    receiver.AdvanceTime( time );
+
+    check( sender.GeneratePacket( NULL, senderSequence, packetData, connectionConfig.maxPacketSize, packetBytes ) );
+    check( receiver.ProcessPacket( NULL, senderSequence, packetData, packetBytes ) );
+    sender.ProcessAcks( &senderSequence, 1 );
+    senderSequence++;
+
+    received = receiver.ReceiveMessage( 0 );
+    check( received );
+    check( received->GetId() == 0 );
+    messageFactory.ReleaseMessage( received );
+
+    check( receiver.ReceiveMessage( 0 ) == NULL );
+    check( !sender.HasMessagesToSend( 0 ) );
+}
+
+static void FillTestSnapshot( uint8_t * data, int bytes, uint16_t snapshotId )
+{
+    // Most of the snapshot is static. A small, moving part of it changes every snapshot, the way a few objects move in a mostly idle world.
+    for ( int i = 0; i < bytes; ++i )
+        data[i] = uint8_t( i * 7 );
+    for ( int i = 0; i < 8; ++i )
+        data[ ( snapshotId * 3 + i * 97 ) % bytes ] = uint8_t( snapshotId + i );
+}
+
+static void SendTestSnapshot( TestMessageFactory & messageFactory, Connection & sender, uint16_t snapshotId, int snapshotBytes )
+{
+    TestBlockMessage * message = (TestBlockMessage*) messageFactory.CreateMessage( TEST_BLOCK_MESSAGE );
+    check( message );
+    message->sequence = snapshotId;
+    uint8_t * blockData = (uint8_t*) YOJIMBO_ALLOCATE( messageFactory.GetAllocator(), snapshotBytes );
+    check( blockData );
+    FillTestSnapshot( blockData, snapshotBytes, snapshotId );
+    message->AttachBlock( messageFactory.GetAllocator(), blockData, snapshotBytes );
+    sender.SendMessage( 0, message );
+}
+
+static bool CheckTestSnapshot( Message * message, int snapshotBytes )
+{
+    if ( message->GetType() != TEST_BLOCK_MESSAGE )
+        return false;
+    TestBlockMessage * blockMessage = (TestBlockMessage*) message;
+    if ( blockMessage->GetId() != blockMessage->sequence || blockMessage->GetBlockSize() != snapshotBytes )
+        return false;
+    uint8_t * expected = (uint8_t*) alloca( snapshotBytes );
+    FillTestSnapshot( expected, snapshotBytes, blockMessage->sequence );
+    return memcmp( expected, blockMessage->GetBlockData(), snapshotBytes ) == 0;
+}
+
+void test_connection_snapshot_delta()
+{
+    TestMessageFactory messageFactory( GetDefaultAllocator() );
+
+    double time = 100.0;
+
+    ConnectionConfig connectionConfig;
+    connectionConfig.numChannels = 1;
+    connectionConfig.channel[0].type = CHANNEL_TYPE_SNAPSHOT;
+
+    Connection sender( GetDefaultAllocator(), messageFactory, connectionConfig, time );
+
+    Connection receiver( GetDefaultAllocator(), messageFactory, connectionConfig, time );
+
+    const int SnapshotBytes = 1000;
+    const int NumSnapshots = 200;
+
+    uint16_t senderSequence = 0;
+    uint16_t receiverSequence = 0;
+
+    int numReceived = 0;
+    bool hasReceived = false;
+    uint16_t lastReceived = 0;
+
+    for ( int i = 0; i < NumSnapshots; ++i )
+    {
+        SendTestSnapshot( messageFactory, sender, uint16_t( i ), SnapshotBytes );
+
+        PumpConnectionUpdate( connectionConfig, time, sender, receiver, senderSequence, receiverSequence, 0.1f, 25 );
+
+        while ( true )
+        {
+            Message * message = receiver.ReceiveMessage( 0 );
+            if ( !message )
+                break;
+
+            check( CheckTestSnapshot( message, SnapshotBytes ) );
+            check( !hasReceived || yojimbo_sequence_greater_than( message->GetId(), lastReceived ) );
+
+            hasReceived = true;
+            lastReceived = message->GetId();
+            numReceived++;
+
+            messageFactory.ReleaseMessage( message );
+        }
+    }
+
+    check( numReceived > NumSnapshots / 2 );
+    check( sender.GetChannelErrorLevel( 0 ) == CHANNEL_ERROR_NONE );
+    check( receiver.GetChannelErrorLevel( 0 ) == CHANNEL_ERROR_NONE );
+}
+
+void test_connection_snapshot_baseline()
+{
+    // The first snapshot has no acked baseline and goes out in full. Once its packet is acked,
+    // the next snapshot is a delta against it and the packet shrinks to a fraction of the size.
+
+    TestMessageFactory messageFactory( GetDefaultAllocator() );
+
+    double time = 100.0;
+
+    ConnectionConfig connectionConfig;
+    connectionConfig.numChannels = 1;
+    connectionConfig.channel[0].type = CHANNEL_TYPE_SNAPSHOT;
+
+    Connection sender( GetDefaultAllocator(), messageFactory, connectionConfig, time );
+
+    Connection receiver( GetDefaultAllocator(), messageFactory, connectionConfig, time );
+
+    const int SnapshotBytes = 1000;
+
+    uint8_t * packetData = (uint8_t*) alloca( connectionConfig.maxPacketSize );
+    int packetBytes = 0;
+    uint16_t senderSequence = 0;
+
+    SendTestSnapshot( messageFactory, sender, 0, SnapshotBytes );
+    check( sender.GeneratePacket( NULL, senderSequence, packetData, connectionConfig.maxPacketSize, packetBytes ) );
+    check( packetBytes > SnapshotBytes );
+    check( receiver.ProcessPacket( NULL, senderSequence, packetData, packetBytes ) );
+    senderSequence++;
+
+    uint8_t * firstPacketData = (uint8_t*) alloca( connectionConfig.maxPacketSize );
+    const int firstPacketBytes = packetBytes;
+    memcpy( firstPacketData, packetData, packetBytes );
+
+    // not acked yet: snapshot 1 goes out in full too
+
+    SendTestSnapshot( messageFactory, sender, 1, SnapshotBytes );
+    check( sender.GeneratePacket( NULL, senderSequence, packetData, connectionConfig.maxPacketSize, packetBytes ) );
+    check( packetBytes > SnapshotBytes );
+    senderSequence++;
+
+    uint16_t ack = 0;
+    sender.ProcessAcks( &ack, 1 );
+
+    SendTestSnapshot( messageFactory, sender, 2, SnapshotBytes );
+    check( sender.GeneratePacket( NULL, senderSequence, packetData, connectionConfig.maxPacketSize, packetBytes ) );
+    check( packetBytes < SnapshotBytes / 4 );
+    check( receiver.ProcessPacket( NULL, senderSequence, packetData, packetBytes ) );
+    senderSequence++;
+
+    // nothing new to send
+
+    check( !sender.HasMessagesToSend( 0 ) );
+
+    Message * message = receiver.ReceiveMessage( 0 );
+    check( message );
+    check( message->GetId() == 0 );
+    check( CheckTestSnapshot( message, SnapshotBytes ) );
+    messageFactory.ReleaseMessage( message );
+
+    message = receiver.ReceiveMessage( 0 );
+    check( message );
+    check( message->GetId() == 2 );
+    check( CheckTestSnapshot( message, SnapshotBytes ) );
+    messageFactory.ReleaseMessage( message );
+
+    check( receiver.ReceiveMessage( 0 ) == NULL );
+
+    // a late duplicate of snapshot 0 is not delivered again
+
+    check( receiver.ProcessPacket( NULL, 0, firstPacketData, firstPacketBytes ) );
+    check( receiver.ReceiveMessage( 0 ) == NULL );
+    check( receiver.GetChannelErrorLevel( 0 ) == CHANNEL_ERROR_NONE );
+}
+
+void test_connection_reliable_ordered_messages_and_blocks_multiple_channels()
+{
+    const int NumChannels = 2;
+
+    yojimbo_assert( NumChannels >= 0 );
+    yojimbo_assert( NumChannels <= MaxChannels );
+
+    double time = 100.0;
+
+    TestMessageFactory messageFactory( GetDefaultAllocator() );
+
+    ConnectionConfig connectionConfig;
+    connectionConfig.numChannels = NumChannels;
+    connectionConfig.channel[0].type = CHANNEL_TYPE_RELIABLE_ORDERED;
+    connectionConfig.channel[0].maxMessagesPerPacket = 8;
+    connectionConfig.channel[1].type = CHANNEL_TYPE_RELIABLE_ORDERED;
+    connectionConfig.channel[1].maxMessagesPerPacket = 8;
+
+    Connection sender( GetDefaultAllocator(), messageFactory, connectionConfig, time );
+
+    Connection receiver( GetDefaultAllocator(), messageFactory, connectionConfig, time );
+
+    const int NumMessagesSent = 32;
+
+    for ( int channelIndex = 0; channelIndex < NumChannels; ++channelIndex )
+    {
+        for ( int i = 0; i < NumMessagesSent; ++i )
+        {
+            if ( rand() % 2 )
+            {
+                TestMessage * message = (TestMessage*) messageFactory.CreateMessage( TEST_MESSAGE );
+                check( message );
+                message->sequence = i;
+                sender.SendMessage( channelIndex, message );
+            }
+            else
+            {
+                TestBlockMessage * message = (TestBlockMessage*) messageFactory.CreateMessage( TEST_BLOCK_MESSAGE );
+                check( message );
+                message->sequence = i;
+                const int blockSize = 1 + ( ( i * 901 ) % 3333 );
+                uint8_t * blockData = (uint8_t*) YOJIMBO_ALLOCATE( messageFactory.GetAllocator(), blockSize );
+                for ( int j = 0; j < blockSize; ++j )
+                    blockData[j] = i + j;
+                message->AttachBlock( messageFactory.GetAllocator(), blockData, blockSize );
+                sender.SendMessage( channelIndex, message );
+            }
+        }
+    }
+
+    const int NumIterations = 10000;
+
+    int numMessagesReceived[NumChannels];
+    memset( numMessagesReceived, 0, sizeof( numMessagesReceived ) );
+
+    uint16_t senderSequence = 0;
+    uint16_t receiverSequence = 0;
+
+    for ( int i = 0; i < NumIterations; ++i )
+    {
+        PumpConnectionUpdate( connectionConfig, time, sender, receiver, senderSequence, receiverSequence );
+
+        for ( int channelIndex = 0; channelIndex < NumChannels; ++channelIndex )
+        {
+            while ( true )
+            {
+                Message * message = receiver.ReceiveMessage( channelIndex );
+                if ( !message )
+                    break;
+
+                check( message->GetId() == (int) numMessagesReceived[channelIndex] );
+
+                switch ( message->GetType() )
+                {
+                    case TEST_MESSAGE:
+                    {
+                        TestMessage * testMessage = (TestMessage*) message;
+
+                        check( testMessage->sequence == uint16_t( numMessagesReceived[channelIndex] ) );
+
+                        ++numMessagesReceived[channelIndex];
+                    }
+                    break;
+
+                    case TEST_BLOCK_MESSAGE:
+                    {
+                        TestBlockMessage * blockMessage = (TestBlockMessage*) message;
+
+                        check( blockMessage->sequence == uint16_t( numMessagesReceived[channelIndex] ) );
+
+                        const int blockSize = blockMessage->GetBlockSize();
+
+                        check( blockSize == 1 + ( ( numMessagesReceived[channelIndex] * 901 ) % 3333 ) );
+
+                        const uint8_t * blockData = blockMessage->GetBlockData();
+
+                        check( blockData );
+
+                        for ( int j = 0; j < blockSize; ++j )
+                        {
+                            check( blockData[j] == uint8_t( numMessagesReceived[channelIndex] + j ) );
+                        }
+
+                        ++numMessagesReceived[channelIndex];
+                    }
+                    break;
+                }
+
+                messageFactory.ReleaseMessage( message );
+            }
+        }
+
+        bool receivedAllMessages = true;
+
+        for ( int channelIndex = 0; channelIndex < NumChannels; ++channelIndex )
+        {
+            if ( numMessagesReceived[channelIndex] != NumMessagesSent )
+            {
+                receivedAllMessages = false;
+                break;
+            }
+        }
+
+        if ( receivedAllMessages )
+            break;
+    }
+
+    for ( int channelIndex = 0; channelIndex < NumChannels; ++channelIndex )
+    {
+        check( numMessagesReceived[channelIndex] == NumMessagesSent );
+    }
+}
+
+void test_connection_unreliable_unordered_messages()
+{
+    TestMessageFactory messageFactory( GetDefaultAllocator() );
+
+    double time = 100.0;
+
+    ConnectionConfig connectionConfig;
+    connectionConfig.numChannels = 1;
+    connectionConfig.channel[0].type = CHANNEL_TYPE_UNRELIABLE_UNORDERED;
+
+    Connection sender( GetDefaultAllocator(), messageFactory, connectionConfig, time );
+    Connection receiver( GetDefaultAllocator(), messageFactory, connectionConfig, time );
+
+    const int NumIterations = 256;
+
+    const int NumMessagesSent = 16;
+
+    for ( int j = 0; j < NumMessagesSent; ++j )
+    {
+        TestMessage * message = (TestMessage*) messageFactory.CreateMessage( TEST_MESSAGE );
+        check( message );
+        message->sequence = j;
+        sender.SendMessage( 0, message );
+    }
+
+    int numMessagesReceived = 0;
+
+    uint16_t senderSequence = 0;
+    uint16_t receiverSequence = 0;
+
+    for ( int i = 0; i < NumIterations; ++i )
+    {
+        PumpConnectionUpdate( connectionConfig, time, sender, receiver, senderSequence, receiverSequence, 0.1f, 0 );
+
+        while ( true )
+        {
+            Message * message = receiver.ReceiveMessage( 0 );
+            if ( !message )
+                break;
+
+            check( message->GetType() == TEST_MESSAGE );
+
+            TestMessage * testMessage = (TestMessage*) message;
+
+            check( testMessage->sequence == uint16_t( numMessagesReceived ) );
+
+            ++numMessagesReceived;
+
+            messageFactory.ReleaseMessage( message );
+        }
+
+        if ( numMessagesReceived == NumMessagesSent )
+            break;
+    }
+
+    check( numMessagesReceived == NumMessagesSent );
+}
+
+void test_connection_unreliable_unordered_blocks()
+{
+    TestMessageFactory messageFactory( GetDefaultAllocator() );
+
+    double time = 100.0;
+
+    ConnectionConfig connectionConfig;
+    connectionConfig.numChannels = 1;
+    connectionConfig.channel[0].type = CHANNEL_TYPE_UNRELIABLE_UNORDERED;
+
+    Connection sender( GetDefaultAllocator(), messageFactory, connectionConfig, time );
+
+    Connection receiver( GetDefaultAllocator(), messageFactory, connectionConfig, time );
+
+    const int NumIterations = 256;
+
+    const int NumMessagesSent = 8;
+
+    for ( int j = 0; j < NumMessagesSent; ++j )
+    {
+        TestBlockMessage * message = (TestBlockMessage*) messageFactory.CreateMessage( TEST_BLOCK_MESSAGE );
+        check( message );
+        message->sequence = j;
+        const int blockSize = 1 + ( j * 7 );
+        uint8_t * blockData = (uint8_t*) YOJIMBO_ALLOCATE( messageFactory.GetAllocator(), blockSize );
+        for ( int k = 0; k < blockSize; ++k )
+            blockData[k] = j + k;
+        message->AttachBlock( messageFactory.GetAllocator(), blockData, blockSize );
+        sender.SendMessage( 0, message );
+    }
+
+    int numMessagesReceived = 0;
+
+    uint16_t senderSequence = 0;
+    uint16_t receiverSequence = 0;
+
+    for ( int i = 0; i < NumIterations; ++i )
+    {
+        PumpConnectionUpdate( connectionConfig, time, sender, receiver, senderSequence, receiverSequence, 0.1f, 0 );
+
+        while ( true )
+        {
+            Message * message = receiver.ReceiveMessage( 0 );
+            if ( !message )
+                break;
+
+            check( message->GetType() == TEST_BLOCK_MESSAGE );
+
+            TestBlockMessage * blockMessage = (TestBlockMessage*) message;
+
+            check( blockMessage->sequence == uint16_t( numMessagesReceived ) );
+
+            const int blockSize = blockMessage->GetBlockSize();
+
+            check( blockSize == 1 + ( numMessagesReceived * 7 ) );
+
+            const uint8_t * blockData = blockMessage->GetBlockData();
+
+            check( blockData );
+
+            for ( int j = 0; j < blockSize; ++j )
+            {
+                check( blockData[j] == uint8_t( numMessagesReceived + j ) );
+            }
+
+            ++numMessagesReceived;
+
+            messageFactory.ReleaseMessage( message );
+        }
+
+        if ( numMessagesReceived == NumMessagesSent )
+            break;
+    }
+
+    check( numMessagesReceived == NumMessagesSent );
+}
+
+template <typename Sender, typename Receiver> void StaticConnectionExchange()
+{
+    TestMessageFactory messageFactory( GetDefaultAllocator() );
+
+    double time = 100.0;
+
+    ConnectionConfig connectionConfig;
+    connectionConfig.numChannels = 2;
+    connectionConfig.channel[0].type = CHANNEL_TYPE_RELIABLE_ORDERED;
+    connectionConfig.channel[1].type = CHANNEL_TYPE_UNRELIABLE_UNORDERED;
+
+    Sender sender( GetDefaultAllocator(), messageFactory, connectionConfig, time );
+    Receiver receiver( GetDefaultAllocator(), messageFactory, connectionConfig, time );
+
+    const int NumIterations = 1000;
+
+    const int NumMessagesSent = 32;
+
+    uint16_t senderSequence = 0;
+    uint16_t receiverSequence = 0;
+
+    // unreliable first, without packet loss
+
+    for ( int j = 0; j < NumMessagesSent; ++j )
+    {
+        TestMessage * message = (TestMessage*) messageFactory.CreateMessage( TEST_MESSAGE );
+        check( message );
+        message->sequence = j;
+        sender.SendMessage( 1, message );
+    }
+
+    int numUnreliableReceived = 0;
+
+    for ( int i = 0; i < NumIterations && numUnreliableReceived < NumMessagesSent; ++i )
+    {
+        PumpConnectionUpdate( connectionConfig, time, sender, receiver, senderSequence, receiverSequence, 0.1f, 0 );
+
+        while ( Message * message = receiver.ReceiveMessage( 1 ) )
+        {
+            check( message->GetType() == TEST_MESSAGE );
+            check( ( (TestMessage*) message )->sequence == uint16_t( numUnreliableReceived ) );
+            ++numUnreliableReceived;
+            messageFactory.ReleaseMessage( message );
+        }
+    }
+
+    check( numUnreliableReceived == NumMessagesSent );
+
+    // then reliable messages and blocks both ways, with heavy packet loss
+
+    for ( int j = 0; j < NumMessagesSent; ++j )
+    {
+        if ( j % 4 == 3 )
+        {
+            TestBlockMessage * message = (TestBlockMessage*) messageFactory.CreateMessage( TEST_BLOCK_MESSAGE );
+            check( message );
+            message->sequence = j;
+            const int blockSize = 1 + j * 131;
+            uint8_t * blockData = (uint8_t*) YOJIMBO_ALLOCATE( messageFactory.GetAllocator(), blockSize );
+            for ( int k = 0; k < blockSize; ++k )
+                blockData[k] = uint8_t( j + k );
+            message->AttachBlock( messageFactory.GetAllocator(), blockData, blockSize );
+            sender.SendMessage( 0, message );
+        }
+        else
+        {
+            TestMessage * message = (TestMessage*) messageFactory.CreateMessage( TEST_MESSAGE );
+            check( message );
+            message->sequence = j;
+            sender.SendMessage( 0, message );
+        }
+
+        TestMessage * reply = (TestMessage*) messageFactory.CreateMessage( TEST_MESSAGE );
+        check( reply );
+        reply->sequence = j;
+        receiver.SendMessage( 0, reply );
+    }
+
+    int numReceived = 0;
+    int numRepliesReceived = 0;
+
+    for ( int i = 0; i < NumIterations; ++i )
+    {
+        PumpConnectionUpdate( connectionConfig, time, sender, receiver, senderSequence, receiverSequence );
+
+        while ( Message * message = receiver.ReceiveMessage( 0 ) )
+        {
+            check( message->GetId() == numReceived );
+            if ( numReceived % 4 == 3 )
+            {
+                check( message->GetType() == TEST_BLOCK_MESSAGE );
+                TestBlockMessage * blockMessage = (TestBlockMessage*) message;
+                check( blockMessage->sequence == uint16_t( numReceived ) );
+                const int blockSize = blockMessage->GetBlockSize();
+                check( blockSize == 1 + numReceived * 131 );
+                const uint8_t * blockData = blockMessage->GetBlockData();
+                for ( int k = 0; k < blockSize; ++k )
+                    check( blockData[k] == uint8_t( numReceived + k ) );
+            }
+            else
+            {
+                check( message->GetType() == TEST_MESSAGE );
+                check( ( (TestMessage*) message )->sequence == uint16_t( numReceived ) );
+            }
+            ++numReceived;
+            messageFactory.ReleaseMessage( message );
+        }
+
+        while ( Message * message = sender.ReceiveMessage( 0 ) )
+        {
+            check( message->GetType() == TEST_MESSAGE );
+            check( ( (TestMessage*) message )->sequence == uint16_t( numRepliesReceived ) );
+            ++numRepliesReceived;
+            messageFactory.ReleaseMessage( message );
+        }
+
+        if ( numReceived == NumMessagesSent && numRepliesReceived == NumMessagesSent )
+            break;
+    }
+
+    check( numReceived == NumMessagesSent );
+    check( numRepliesReceived == NumMessagesSent );
+    check( sender.GetErrorLevel() == CONNECTION_ERROR_NONE );
+    check( receiver.GetErrorLevel() == CONNECTION_ERROR_NONE );
+}
+
+typedef StaticConnection<ReliableOrderedChannel, UnreliableUnorderedChannel> TestStaticConnection;
+
+void test_static_connection()
+{
+    StaticConnectionExchange<TestStaticConnection, TestStaticConnection>();
+}
+
+void test_static_connection_interop()
+{
+    // StaticConnection writes the same packets as Connection, so either end can be either
+    StaticConnectionExchange<TestStaticConnection, Connection>();
+    StaticConnectionExchange<Connection, TestStaticConnection>();
+}
+
+void test_static_connection_get_channel()
+{
+    TestMessageFactory messageFactory( GetDefaultAllocator() );
+
+    ConnectionConfig connectionConfig;
+    connectionConfig.numChannels = 2;
+    connectionConfig.channel[0].type = CHANNEL_TYPE_RELIABLE_ORDERED;
+    connectionConfig.channel[1].type = CHANNEL_TYPE_UNRELIABLE_UNORDERED;
+
+    TestStaticConnection connection( GetDefaultAllocator(), messageFactory, connectionConfig, 100.0 );
+
+    ReliableOrderedChannel & reliable = connection.GetChannel<0>();
+    UnreliableUnorderedChannel & unreliable = connection.GetChannel<1>();
+
+    check( reliable.GetChannelIndex() == 0 );
+    check( unreliable.GetChannelIndex() == 1 );
+
+    Message * message = messageFactory.CreateMessage( TEST_MESSAGE );
+    check( message );
+    unreliable.SendMessage( message, NULL );
+    check( connection.HasMessagesToSend( 1 ) );
+    check( !connection.HasMessagesToSend( 0 ) );
+}
+
+void test_connection_reject_empty_packet()
+{
+    // A packet that is exactly a reliable header reaches Connection::ProcessPacket with
+    // zero payload bytes. That must be rejected cleanly, not fed to the bit reader (which
+    // used to trip the bufferSize > 0 assert in ReadPacket).
+
+    TestMessageFactory messageFactory( GetDefaultAllocator() );
+
+    double time = 100.0;
+
+    ConnectionConfig connectionConfig;
+    connectionConfig.numChannels = 1;
+    connectionConfig.channel[0].type = CHANNEL_TYPE_RELIABLE_ORDERED;
+
+    Connection connection( GetDefaultAllocator(), messageFactory, connectionConfig, time );
+
+    uint8_t buffer[1] = { 0 };
+
+    check( !connection.ProcessPacket( NULL, 0, buffer, 0 ) );
+    check( connection.GetErrorLevel() == CONNECTION_ERROR_READ_PACKET_FAILED );
+}
+
+void test_connection_unreliable_rejects_block_fragment()
+{
+    // An unreliable-unordered channel never sends a top-level block fragment (its blocks
+    // are serialized inline). A peer that puts a block fragment on that channel index used
+    // to be misread through the ChannelPacketData union (a BlockMessage* reinterpreted as a
+    // message-pointer array) and crash. It must instead be rejected as a serialize failure.
+
+    TestMessageFactory messageFactory( GetDefaultAllocator() );
+
+    double time = 100.0;
+
+    // Sender speaks reliable-ordered on channel 0, so it emits a top-level block fragment.
+    ConnectionConfig senderConfig;
+    senderConfig.numChannels = 1;
+    senderConfig.channel[0].type = CHANNEL_TYPE_RELIABLE_ORDERED;
+
+    // Receiver treats channel 0 as unreliable-unordered.
+    ConnectionConfig receiverConfig;
+    receiverConfig.numChannels = 1;
+    receiverConfig.channel[0].type = CHANNEL_TYPE_UNRELIABLE_UNORDERED;
+
+    Connection sender( GetDefaultAllocator(), messageFactory, senderConfig, time );
+    Connection receiver( GetDefaultAllocator(), messageFactory, receiverConfig, time );
+
+    TestBlockMessage * message = (TestBlockMessage*) messageFactory.CreateMessage( TEST_BLOCK_MESSAGE );
+    check( message );
+    message->sequence = 0;
+    const int blockSize = 64;
+    uint8_t * blockData = (uint8_t*) YOJIMBO_ALLOCATE( messageFactory.GetAllocator(), blockSize );
+    for ( int i = 0; i < blockSize; ++i )
+        blockData[i] = (uint8_t) i;
+    message->AttachBlock( messageFactory.GetAllocator(), blockData, blockSize );
+    sender.SendMessage( 0, message );
+
+    // The sender is never acked, so it keeps re-sending the block fragment every tick.
+    // Feed each generated packet to the receiver until its unreliable channel rejects the
+    // fragment and the connection drops into the channel error state.
+    uint8_t * packetData = (uint8_t*) alloca( senderConfig.maxPacketSize );
+    uint16_t sequence = 0;
+    bool sawChannelError = false;
+
+    for ( int i = 0; i < 64 && !sawChannelError; ++i )
+    {
+        int packetBytes = 0;
+        if ( sender.GeneratePacket( NULL, sequence, packetData, senderConfig.maxPacketSize, packetBytes ) && packetBytes > 0 )
+            receiver.ProcessPacket( NULL, sequence, packetData, packetBytes );
+
+        sender.AdvanceTime( time );
+        receiver.AdvanceTime( time );
+        time += 0.1;
+        sequence++;
+
+        if ( receiver.GetErrorLevel() == CONNECTION_ERROR_CHANNEL )
+            sawChannelError = true;
+    }
+
+    check( sawChannelError );
+}
+
+void test_connection_reliable_block_fragment_on_disabled_blocks()
+{
+    // A peer sends a block fragment on a reliable-ordered channel, but the receiver has
+    // blocks disabled on that channel. ChannelPacketData::Serialize reads blockMessage=1 then
+    // returns early on disableBlocks, before SerializeBlockFragment initializes the block
+    // pointers. The packet destructor's Free() must not then dereference an uninitialized
+    // block.message (it used to, because Initialize() only zeroed part of the union).
+
+    TestMessageFactory messageFactory( GetDefaultAllocator() );
+
+    double time = 100.0;
+
+    // Sender: reliable-ordered with blocks enabled, so it emits a real block fragment.
+    ConnectionConfig senderConfig;
+    senderConfig.numChannels = 1;
+    senderConfig.channel[0].type = CHANNEL_TYPE_RELIABLE_ORDERED;
+
+    // Receiver: reliable-ordered on the same channel, but with blocks disabled.
+    ConnectionConfig receiverConfig;
+    receiverConfig.numChannels = 1;
+    receiverConfig.channel[0].type = CHANNEL_TYPE_RELIABLE_ORDERED;
+    receiverConfig.channel[0].disableBlocks = true;
+
+    Connection sender( GetDefaultAllocator(), messageFactory, senderConfig, time );
+    Connection receiver( GetDefaultAllocator(), messageFactory, receiverConfig, time );
+
+    TestBlockMessage * message = (TestBlockMessage*) messageFactory.CreateMessage( TEST_BLOCK_MESSAGE );
+    check( message );
+    message->sequence = 0;
+    const int blockSize = 2000;   // > fragment size, but even a single fragment reproduces it
+    uint8_t * blockData = (uint8_t*) YOJIMBO_ALLOCATE( messageFactory.GetAllocator(), blockSize );
+    for ( int i = 0; i < blockSize; ++i )
+        blockData[i] = (uint8_t) i;
+    message->AttachBlock( messageFactory.GetAllocator(), blockData, blockSize );
+    sender.SendMessage( 0, message );
+
+    // Feed generated block-fragment packets to the receiver. Before the fix this crashed in
+    // the packet destructor; after it, the read simply fails and the connection errors.
+    uint8_t * packetData = (uint8_t*) alloca( senderConfig.maxPacketSize );
+    uint16_t sequence = 0;
+
+    for ( int i = 0; i < 64; ++i )
+    {
+        int packetBytes = 0;
+        if ( sender.GeneratePacket( NULL, sequence, packetData, senderConfig.maxPacketSize, packetBytes ) && packetBytes > 0 )
+            receiver.ProcessPacket( NULL, sequence, packetData, packetBytes );
+
+        sender.AdvanceTime( time );
+        receiver.AdvanceTime( time );
+        time += 0.1;
+        sequence++;
+
+        if ( receiver.GetErrorLevel() != CONNECTION_ERROR_NONE )
+            break;
+    }
+
+    // The receiver rejected the disallowed block fragment without crashing.
+    check( receiver.GetErrorLevel() != CONNECTION_ERROR_NONE );
+}
+
+// Hand-serialize a connection packet carrying a single reliable-ordered channel entry that is
+// a block fragment. Matches ConnectionPacket + ChannelPacketData::Serialize + SerializeBlockFragment
+// for a numChannels==1 config. Lets tests inject fragment fields a well-behaved sender never would.
+template <typename Stream> static bool SerializeRawBlockFragmentPacket( Stream & stream, int maxFragmentsPerPacket, int maxFragmentsPerBlock, int blockFragmentSize, int numFragments, int fragmentId, int fragmentSize )
+{
+    int numChannelEntries = 1;
+    serialize_int( stream, numChannelEntries, 0, 1 );   // numChannels == 1, so channelIndex is not serialized
+
+    bool blockMessage = true;
+    serialize_bool( stream, blockMessage );
+
+    int numFragmentsInPacket = 1;
+    if ( maxFragmentsPerPacket > 1 )
+        serialize_int( stream, numFragmentsInPacket, 1, maxFragmentsPerPacket );
+
+    uint32_t messageId = 0;
+    serialize_bits( stream, messageId, 16 );
+
+    if ( maxFragmentsPerBlock > 1 )
+        serialize_int( stream, numFragments, 1, maxFragmentsPerBlock );
+
+    if ( numFragments > 1 )
+        serialize_int( stream, fragmentId, 0, numFragments - 1 );
+
+    serialize_int( stream, fragmentSize, 1, blockFragmentSize );
+
+    uint8_t payload[2048];
+    yojimbo_assert( fragmentSize <= (int) sizeof( payload ) );
+    memset( payload, 0xAB, sizeof( payload ) );
+    serialize_bytes( stream, payload, fragmentSize );
+
+    // fragmentId != 0 here, so no message type / block message is serialized.
+    return true;
+}
+
+void test_connection_reliable_block_fragment_overflow()
+{
+    // Regression test: a peer sends a reliable-ordered block fragment whose final fragment
+    // claims a full blockFragmentSize of data, even though maxBlockSize is not a multiple of
+    // blockFragmentSize. The receive buffer (blockData) is maxBlockSize bytes, but the final
+    // fragment is copied at offset (numFragments-1)*blockFragmentSize, so a full-size copy
+    // used to run past the end of the buffer (heap-buffer-overflow, caught by ASan). The
+    // fragment must be rejected before the copy. fragmentSize is attacker-controllable in
+    // [1,blockFragmentSize], so a legitimate sender never produces this.
+
+    TestMessageFactory messageFactory( GetDefaultAllocator() );
+
+    double time = 100.0;
+
+    ConnectionConfig config;
+    config.numChannels = 1;
+    config.channel[0].type = CHANNEL_TYPE_RELIABLE_ORDERED;
+    config.channel[0].maxBlockSize = 1100;      // deliberately not a multiple of blockFragmentSize
+    config.channel[0].blockFragmentSize = 500;  // => GetMaxFragmentsPerBlock() == ceil(1100/500) == 3
+
+    Connection receiver( GetDefaultAllocator(), messageFactory, config, time );
+
+    const int maxFragmentsPerBlock = config.channel[0].GetMaxFragmentsPerBlock();
+    const int blockFragmentSize = config.channel[0].blockFragmentSize;
+
+    // messageId=0 (== expected receive sequence), final fragment, full blockFragmentSize payload.
+    const int numFragments = maxFragmentsPerBlock;   // 3
+    const int fragmentId = numFragments - 1;         // 2 (final fragment)
+    const int fragmentSize = blockFragmentSize;      // 500 -> write [1000,1500) into a 1100-byte buffer
+
+    uint8_t buffer[4096];
+    memset( buffer, 0, sizeof( buffer ) );
+    WriteStream stream( buffer, sizeof( buffer ) );
+    check( SerializeRawBlockFragmentPacket( stream, config.channel[0].maxFragmentsPerPacket, maxFragmentsPerBlock, blockFragmentSize, numFragments, fragmentId, fragmentSize ) );
+    stream.Flush();
+    const int packetBytes = stream.GetBytesProcessed();
+    check( packetBytes > 0 );
+
+    // Before the fix this overflowed the receive buffer inside ProcessPacketFragment. After the
+    // fix the fragment is rejected: the read fails and the channel drops into an error state.
+    const bool processed = receiver.ProcessPacket( NULL, 0, buffer, packetBytes );
+    check( !processed );
+
+    receiver.AdvanceTime( time );
+    check( receiver.GetErrorLevel() == CONNECTION_ERROR_CHANNEL );
+}
+
+void test_connection_reliable_over_budget_packet()
+{
+    // A peer sends more channel data than the receiver's configured packetBudget. On read this
+    // used to trip the YOJIMBO_DEBUG_MESSAGE_BUDGET assert — a remote crash in debug builds
+    // reachable from a decrypted-but-attacker-controlled packet. The message count and sizes
+    // are already bounded by the serialize_* range checks, so an over-budget read must simply
+    // be accepted, not asserted on.
+
+    TestMessageFactory messageFactory( GetDefaultAllocator() );
+
+    double time = 100.0;
+
+    // Sender: default (unlimited) packet budget, so it packs messages freely.
+    ConnectionConfig senderConfig;
+    senderConfig.numChannels = 1;
+    senderConfig.channel[0].type = CHANNEL_TYPE_RELIABLE_ORDERED;
+
+    // Receiver: a small per-channel packet budget.
+    ConnectionConfig receiverConfig;
+    receiverConfig.numChannels = 1;
+    receiverConfig.channel[0].type = CHANNEL_TYPE_RELIABLE_ORDERED;
+    receiverConfig.channel[0].packetBudget = 32;
+
+    Connection sender( GetDefaultAllocator(), messageFactory, senderConfig, time );
+    Connection receiver( GetDefaultAllocator(), messageFactory, receiverConfig, time );
+
+    const int NumMessages = 64;
+    for ( int i = 0; i < NumMessages; ++i )
+    {
+        TestMessage * message = (TestMessage*) messageFactory.CreateMessage( TEST_MESSAGE );
+        check( message );
+        message->sequence = (uint16_t) i;
+        sender.SendMessage( 0, message );
+    }
+
+    // The first generated packet carries far more than 32 bytes of channel data. Before the
+    // fix, processing it aborted the receiver in the budget assert; after, it reads cleanly.
+    uint8_t * packetData = (uint8_t*) alloca( senderConfig.maxPacketSize );
+    uint16_t sequence = 0;
+    bool processed = false;
+
+    for ( int i = 0; i < 8 && !processed; ++i )
+    {
+        int packetBytes = 0;
+        if ( sender.GeneratePacket( NULL, sequence, packetData, senderConfig.maxPacketSize, packetBytes ) && packetBytes > 0 )
+        {
+            check( receiver.ProcessPacket( NULL, sequence, packetData, packetBytes ) );
+            processed = true;
+        }
+
+        sender.AdvanceTime( time );
+        receiver.AdvanceTime( time );
+        time += 0.1;
+        sequence++;
+    }
+
+    check( processed );
+    check( receiver.GetErrorLevel() == CONNECTION_ERROR_NONE );
+}
+
+void PumpClientServerUpdate( double & time, Client ** client, int numClients, Server ** server, int numServers, float deltaTime = 0.1f )
+{
+    for ( int i = 0; i < numClients; ++i )
+        client[i]->SendPackets();
 
     for ( int i = 0; i < numServers; ++i )
         server[i]->SendPackets();
 
-    for ( int i = 0; i < numClients; ++i )
-        client[i]->ReceivePackets();
+    for ( int i = 0; i < numClients; ++i )
+        client[i]->ReceivePackets();
+
+    for ( int i = 0; i < numServers; ++i )
+        server[i]->ReceivePackets();
+
+    time += deltaTime;
+
+    for ( int i = 0; i < numClients; ++i )
+        client[i]->AdvanceTime( time );
+
+    for ( int i = 0; i < numServers; ++i )
+        server[i]->AdvanceTime( time );
+
+    yojimbo_sleep( 0.0f );
+}
+
+template <typename ClientType> void SendClientToServerMessages( ClientType & client, int numMessagesToSend, int channelIndex = ReliableChannel )
+{
+    for ( int i = 0; i < numMessagesToSend; ++i )
+    {
+        if ( !client.CanSendMessage( channelIndex ) )
+            break;
+
+        if ( rand() % 10 )
+        {
+            TestMessage * message = (TestMessage*) client.CreateMessage( TEST_MESSAGE );
+            check( message );
+            message->sequence = i;
+            client.SendMessage( channelIndex, message );
+        }
+        else
+        {
+            TestBlockMessage * message = (TestBlockMessage*) client.CreateMessage( TEST_BLOCK_MESSAGE );
+            check( message );
+            message->sequence = i;
+            const int blockSize = 1 + ( ( i * 901 ) % 1001 );
+            uint8_t * blockData = client.AllocateBlock( blockSize );
+            check( blockData );
+            for ( int j = 0; j < blockSize; ++j )
+                blockData[j] = i + j;
+            client.AttachBlockToMessage( message, blockData, blockSize );
+            client.SendMessage( channelIndex, message );
+        }
+    }
+}
+
+template <typename ServerType> void SendServerToClientMessages( ServerType & server, int clientIndex, int numMessagesToSend, int channelIndex = ReliableChannel )
+{
+    for ( int i = 0; i < numMessagesToSend; ++i )
+    {
+        if ( !server.CanSendMessage( clientIndex, channelIndex ) )
+            break;
+
+        if ( rand() % 10 )
+        {
+            TestMessage * message = (TestMessage*) server.CreateMessage( clientIndex, TEST_MESSAGE );
+            check( message );
+            message->sequence = i;
+            server.SendMessage( clientIndex, channelIndex, message );
+        }
+        else
+        {
+            TestBlockMessage * message = (TestBlockMessage*) server.CreateMessage( clientIndex, TEST_BLOCK_MESSAGE );
+            check( message );
+            message->sequence = i;
+            const int blockSize = 1 + ( ( i * 901 ) % 1001 );
+            uint8_t * blockData = server.AllocateBlock( clientIndex, blockSize );
+            check( blockData );
+            for ( int j = 0; j < blockSize; ++j )
+                blockData[j] = i + j;
+            server.AttachBlockToMessage( clientIndex, message, blockData, blockSize );
+            server.SendMessage( clientIndex, channelIndex, message );
+        }
+    }
+}
+
+template <typename ClientType> void ProcessServerToClientMessages( ClientType & client, int & numMessagesReceivedFromServer, int channelIndex = ReliableChannel )
+{
+    while ( true )
+    {
+        Message * message = client.ReceiveMessage( channelIndex );
+
+        if ( !message )
+            break;
+
+        check( message->GetId() == (int) numMessagesReceivedFromServer );
+
+        switch ( message->GetType() )
+        {
+            case TEST_MESSAGE:
+            {
+                TestMessage * testMessage = (TestMessage*) message;
+                check( !message->IsBlockMessage() );
+                check( testMessage->sequence == uint16_t( numMessagesReceivedFromServer ) );
+                ++numMessagesReceivedFromServer;
+            }
+            break;
+
+            case TEST_BLOCK_MESSAGE:
+            {
+                check( message->IsBlockMessage() );
+                TestBlockMessage * blockMessage = (TestBlockMessage*) message;
+                check( blockMessage->sequence == uint16_t( numMessagesReceivedFromServer ) );
+                const int blockSize = blockMessage->GetBlockSize();
+                check( blockSize == 1 + ( ( numMessagesReceivedFromServer * 901 ) % 1001 ) );
+                const uint8_t * blockData = blockMessage->GetBlockData();
+                check( blockData );
+                for ( int j = 0; j < blockSize; ++j )
+                {
+                    check( blockData[j] == uint8_t( numMessagesReceivedFromServer + j ) );
+                }
+                ++numMessagesReceivedFromServer;
+            }
+            break;
+        }
+
+        client.ReleaseMessage( message );
+    }
+}
+
+template <typename ServerType> void ProcessClientToServerMessages( ServerType & server, int clientIndex, int & numMessagesReceivedFromClient, int channelIndex = ReliableChannel )
+{
+    while ( true )
+    {
+        Message * message = server.ReceiveMessage( clientIndex, channelIndex );
+
+        if ( !message )
+            break;
+
+        check( message->GetId() == (int) numMessagesReceivedFromClient );
+
+        switch ( message->GetType() )
+        {
+            case TEST_MESSAGE:
+            {
+                check( !message->IsBlockMessage() );
+                TestMessage * testMessage = (TestMessage*) message;
+                check( testMessage->sequence == uint16_t( numMessagesReceivedFromClient ) );
+                ++numMessagesReceivedFromClient;
+            }
+            break;
+
+            case TEST_BLOCK_MESSAGE:
+            {
+                check( message->IsBlockMessage() );
+                TestBlockMessage * blockMessage = (TestBlockMessage*) message;
+                check( blockMessage->sequence == uint16_t( numMessagesReceivedFromClient ) );
+                const int blockSize = blockMessage->GetBlockSize();
+                check( blockSize == 1 + ( ( numMessagesReceivedFromClient * 901 ) % 1001 ) );
+                const uint8_t * blockData = blockMessage->GetBlockData();
+                check( blockData );
+                for ( int j = 0; j < blockSize; ++j )
+                {
+                    check( blockData[j] == uint8_t( numMessagesReceivedFromClient + j ) );
+                }
+                ++numMessagesReceivedFromClient;
+            }
+            break;
+        }
+
+        server.ReleaseMessage( clientIndex, message );
+    }
+}
+
+void test_connection_reliable_message_alloc_failure()
+{
+    // Regression: on the send path, GetMessagePacketData allocated the message-pointer array
+    // without checking for NULL and then wrote through it - a crash on allocator exhaustion.
+    // Arm the allocator to fail that first allocation inside GeneratePacket and verify we neither
+    // crash nor leak (the queued reliable message is retained and freed at teardown).
+    ArmableAllocator allocator;
+    {
+        TestMessageFactory messageFactory( allocator );
+
+        ConnectionConfig config;
+        config.numChannels = 1;
+        config.channel[0].type = CHANNEL_TYPE_RELIABLE_ORDERED;
+
+        {
+            Connection connection( allocator, messageFactory, config, 100.0 );
+
+            Message * message = messageFactory.CreateMessage( TEST_MESSAGE );
+            check( message );
+            connection.SendMessage( 0, message );
+
+            uint8_t packetData[4096];
+            int packetBytes = 0;
+
+            allocator.Arm( 0 );     // fail the first allocation inside GeneratePacket (message array)
+            connection.GeneratePacket( NULL, 0, packetData, sizeof( packetData ), packetBytes );
+            allocator.Disarm();
+        }
+    }
+    check( allocator.GetOutstanding() == 0 );   // no leak across teardown
+}
+
+void test_connection_unreliable_message_alloc_failure()
+{
+    // Regression: the unreliable channel's GetPacketData allocated the message-pointer array
+    // without a NULL check and then wrote through it. The messages had already been popped off
+    // the send queue, so a failure crashed (NULL deref) and would have leaked the popped
+    // messages. Arm the allocator to fail that allocation and verify no crash and no leak.
+    ArmableAllocator allocator;
+    {
+        TestMessageFactory messageFactory( allocator );
+
+        ConnectionConfig config;
+        config.numChannels = 1;
+        config.channel[0].type = CHANNEL_TYPE_UNRELIABLE_UNORDERED;
+
+        {
+            Connection connection( allocator, messageFactory, config, 100.0 );
+
+            for ( int i = 0; i < 4; ++i )
+            {
+                Message * message = messageFactory.CreateMessage( TEST_MESSAGE );
+                check( message );
+                connection.SendMessage( 0, message );
+            }
+
+            uint8_t packetData[4096];
+            int packetBytes = 0;
+
+            allocator.Arm( 0 );     // fail the message-pointer array allocation in GetPacketData
+            connection.GeneratePacket( NULL, 0, packetData, sizeof( packetData ), packetBytes );
+            allocator.Disarm();
+        }
+    }
+    check( allocator.GetOutstanding() == 0 );   // popped messages released, nothing leaked
+}
+
+void test_connection_generate_packet_channel_data_alloc_failure()
+{
+    // Regression: when AllocateChannelData failed, GeneratePacket returned without freeing the
+    // per-channel packet data GetPacketData had already populated (acquired message references
+    // and the allocated message-pointer array), leaking them. Arm the allocator so the message
+    // array allocation succeeds but the subsequent channel-data allocation fails, and verify
+    // nothing leaks.
+    ArmableAllocator allocator;
+    {
+        TestMessageFactory messageFactory( allocator );
+
+        ConnectionConfig config;
+        config.numChannels = 1;
+        config.channel[0].type = CHANNEL_TYPE_RELIABLE_ORDERED;
+
+        {
+            Connection connection( allocator, messageFactory, config, 100.0 );
+
+            Message * message = messageFactory.CreateMessage( TEST_MESSAGE );
+            check( message );
+            connection.SendMessage( 0, message );
+
+            uint8_t packetData[4096];
+            int packetBytes = 0;
+
+            allocator.Arm( 1 );     // 1st alloc (message array) succeeds, 2nd (channel data) fails
+            const bool result = connection.GeneratePacket( NULL, 0, packetData, sizeof( packetData ), packetBytes );
+            allocator.Disarm();
+            check( !result );       // the channel-data allocation failure fails the generate
+        }
+    }
+    check( allocator.GetOutstanding() == 0 );   // no leak across teardown
+}
+
+void test_message_factory_create_message_alloc_failure()
+{
+    // Regression: YOJIMBO_NEW used to run the constructor on a NULL pointer when the allocation
+    // failed (undefined behavior / crash) before CreateMessage's NULL check. CreateMessage must
+    // return NULL cleanly on allocator exhaustion and flag the factory.
+    ArmableAllocator allocator;
+    {
+        TestMessageFactory factory( allocator );
+        allocator.Arm( 0 );     // fail the next allocation (the message object)
+        Message * message = factory.CreateMessage( TEST_MESSAGE );
+        allocator.Disarm();
+        check( message == NULL );
+        check( factory.GetErrorLevel() == MESSAGE_FACTORY_ERROR_FAILED_TO_ALLOCATE_MESSAGE );
+    }
+    check( allocator.GetOutstanding() == 0 );
+}
+
+void test_message_factory_pools()
+{
+    ArmableAllocator allocator;
+    {
+        TestMessageFactory factory( allocator );
+
+        MessagePoolStats stats;
+        check( !factory.GetMessagePoolStats( TEST_MESSAGE, stats ) );
+
+        factory.EnableMessagePools( 4, 8 );
+
+        const int NumMessages = 10;
+        Message * messages[NumMessages];
+
+        // the first create allocates 4, the fifth grows by 8
+        for ( int i = 0; i < NumMessages; ++i )
+        {
+            messages[i] = factory.CreateMessage( TEST_MESSAGE );
+            check( messages[i] );
+            check( messages[i]->GetType() == TEST_MESSAGE );
+            check( messages[i]->GetRefCount() == 1 );
+        }
+
+        check( factory.GetMessagePoolStats( TEST_MESSAGE, stats ) );
+        check( stats.blockSize >= (int) sizeof( TestMessage ) );
+        check( stats.capacity == 12 );
+        check( stats.inUse == NumMessages );
+        check( stats.highWater == NumMessages );
+        check( stats.misses == 2 );
+        check( stats.hits == NumMessages - 2 );
+        check( allocator.GetOutstanding() == 4 );           // the per-type message counts, the pool array and two chunks
+
+        for ( int i = 0; i < NumMessages; ++i )
+            factory.ReleaseMessage( messages[i] );
+
+        check( factory.GetMessagePoolStats( TEST_MESSAGE, stats ) );
+        check( stats.inUse == 0 );
+
+        // released messages are reused last in, first out, without touching the allocator
+        Message * message = factory.CreateMessage( TEST_MESSAGE );
+        check( message == messages[NumMessages - 1] );
+        check( ( (TestMessage*) message )->sequence == 0 );
+        factory.ReleaseMessage( message );
+
+        check( factory.GetMessagePoolStats( TEST_MESSAGE, stats ) );
+        check( stats.capacity == 12 );
+        check( stats.misses == 2 );
+        check( stats.hits == NumMessages - 1 );
+        check( stats.highWater == NumMessages );
+        check( allocator.GetOutstanding() == 4 );
+
+        // other types have their own pools
+        check( factory.GetMessagePoolStats( TEST_BLOCK_MESSAGE, stats ) );
+        check( stats.blockSize == 0 );
+        check( stats.capacity == 0 );
+
+        BlockMessage * blockMessage = (BlockMessage*) factory.CreateMessage( TEST_BLOCK_MESSAGE );
+        check( blockMessage );
+        uint8_t * blockData = (uint8_t*) YOJIMBO_ALLOCATE( factory.GetAllocator(), 32 );
+        memset( blockData, 0, 32 );
+        blockMessage->AttachBlock( factory.GetAllocator(), blockData, 32 );
+        factory.ReleaseMessage( blockMessage );
+
+        check( factory.GetMessagePoolStats( TEST_BLOCK_MESSAGE, stats ) );
+        check( stats.capacity == 4 );
+        check( stats.inUse == 0 );
+    }
+    check( allocator.GetOutstanding() == 0 );
+}
+
+void test_message_factory_pools_alloc_failure()
+{
+    ArmableAllocator allocator;
+    {
+        TestMessageFactory factory( allocator );
+        factory.EnableMessagePools( 0, 4 );
+        allocator.Arm( 0 );     // fail the next allocation (the pool's first chunk)
+        Message * message = factory.CreateMessage( TEST_MESSAGE );
+        allocator.Disarm();
+        check( message == NULL );
+        check( factory.GetErrorLevel() == MESSAGE_FACTORY_ERROR_FAILED_TO_ALLOCATE_MESSAGE );
+
+        factory.ClearErrorLevel();
+        message = factory.CreateMessage( TEST_MESSAGE );
+        check( message );
+        factory.ReleaseMessage( message );
+    }
+    check( allocator.GetOutstanding() == 0 );
+}
+
+void test_network_thread_client_server()
+{
+    const uint64_t clientId = 1;
+
+    Address clientAddress( "0.0.0.0", ClientPort );
+    Address serverAddress( "127.0.0.1", ServerPort );
+
+    double time = 100.0;
+
+    ClientServerConfig config;
+    config.channel[0].messageSendQueueSize = 32;
+    config.channel[0].maxMessagesPerPacket = 8;
+    config.channel[0].maxBlockSize = 1024;
+    config.channel[0].blockFragmentSize = 200;
+
+    NetworkThreadConfig threadConfig;
+    threadConfig.updateInterval = 0.001;
+
+    uint8_t privateKey[KeyBytes];
+    memset( privateKey, 0, KeyBytes );
+
+    ServerNetworkThread server( GetDefaultAllocator(), privateKey, serverAddress, config, adapter, time, threadConfig );
+
+    server.Start( MaxClients );
+
+    check( server.IsRunning() );
+
+    ClientNetworkThread client( GetDefaultAllocator(), clientAddress, config, adapter, time, threadConfig );
+
+    const int NumIterations = 10000;
+
+    for ( int iteration = 0; iteration < 2; ++iteration )
+    {
+        client.InsecureConnect( privateKey, clientId, serverAddress );
+
+        // messages sent before the game thread has seen the connect event are released, not queued
+
+        Message * message = client.CreateMessage( TEST_MESSAGE );
+        check( message );
+        check( !client.SendMessage( ReliableChannel, message ) );
+
+        // pump events until both sides have seen the connection
+
+        bool clientConnected = false;
+        bool serverConnected = false;
+
+        for ( int i = 0; i < NumIterations; ++i )
+        {
+            NetworkThreadEvent event;
+
+            while ( client.ReceiveEvent( event ) )
+            {
+                check( event.type == NETWORK_THREAD_EVENT_CONNECTED );
+                clientConnected = true;
+            }
+
+            while ( server.ReceiveEvent( event ) )
+            {
+                check( event.type == NETWORK_THREAD_EVENT_CONNECTED );
+                check( event.clientIndex == 0 );
+                check( event.clientId == clientId );
+                check( event.generation == uint32_t( iteration + 1 ) );
+                serverConnected = true;
+            }
+
+            if ( client.GetClientState() == CLIENT_STATE_ERROR )
+                break;
+
+            if ( clientConnected && serverConnected )
+                break;
+
+            yojimbo_sleep( 0.001 );
+        }
+
+        check( clientConnected );
+        check( serverConnected );
+        check( client.IsConnected() );
+        check( server.IsClientConnected( 0 ) );
+
+        // send more messages than the channel send queue holds. the network thread holds the rest back until there is room
+
+        const int NumMessagesSent = config.channel[0].messageSendQueueSize * 2;
+
+        SendClientToServerMessages( client, NumMessagesSent );
+
+        SendServerToClientMessages( server, 0, NumMessagesSent );
+
+        int numMessagesReceivedFromClient = 0;
+        int numMessagesReceivedFromServer = 0;
+
+        for ( int i = 0; i < NumIterations; ++i )
+        {
+            ProcessServerToClientMessages( client, numMessagesReceivedFromServer );
+
+            ProcessClientToServerMessages( server, 0, numMessagesReceivedFromClient );
+
+            if ( numMessagesReceivedFromClient == NumMessagesSent && numMessagesReceivedFromServer == NumMessagesSent )
+                break;
+
+            yojimbo_sleep( 0.001 );
+        }
+
+        check( numMessagesReceivedFromClient == NumMessagesSent );
+        check( numMessagesReceivedFromServer == NumMessagesSent );
+
+        // disconnect and pump until the server sees it
+
+        client.Disconnect();
+
+        check( !client.IsConnected() );
+
+        bool serverDisconnected = false;
+
+        for ( int i = 0; i < NumIterations; ++i )
+        {
+            NetworkThreadEvent event;
+            while ( server.ReceiveEvent( event ) )
+            {
+                check( event.type == NETWORK_THREAD_EVENT_DISCONNECTED );
+                check( event.clientIndex == 0 );
+                check( event.generation == uint32_t( iteration + 1 ) );
+                serverDisconnected = true;
+            }
+
+            if ( serverDisconnected )
+                break;
+
+            yojimbo_sleep( 0.001 );
+        }
+
+        check( serverDisconnected );
+        check( !server.IsClientConnected( 0 ) );
+    }
+
+    check( server.GetNumUpdates() > 0 );
+
+    server.Stop();
+}
+
+void test_connection_process_packet_channel_data_alloc_failure()
+{
+    // Regression: on the read path, if AllocateChannelData failed, numChannelEntries had already
+    // been read from the wire, so the ConnectionPacket destructor iterated a NULL channelEntry
+    // array (crash). Feed a valid packet to a receiver whose allocator fails the channel-data
+    // allocation, and verify the read fails cleanly without crashing or leaking.
+    ArmableAllocator senderAlloc;
+    ArmableAllocator receiverAlloc;
+    {
+        TestMessageFactory senderFactory( senderAlloc );
+        TestMessageFactory receiverFactory( receiverAlloc );
+
+        ConnectionConfig config;
+        config.numChannels = 1;
+        config.channel[0].type = CHANNEL_TYPE_RELIABLE_ORDERED;
+
+        {
+            Connection sender( senderAlloc, senderFactory, config, 100.0 );
+            Connection receiver( receiverAlloc, receiverFactory, config, 100.0 );
+
+            Message * message = senderFactory.CreateMessage( TEST_MESSAGE );
+            check( message );
+            sender.SendMessage( 0, message );
+
+            uint8_t packetData[4096];
+            int packetBytes = 0;
+            check( sender.GeneratePacket( NULL, 0, packetData, sizeof( packetData ), packetBytes ) );
+            check( packetBytes > 0 );
+
+            receiverAlloc.Arm( 0 );     // fail the channel-data allocation in the connection-packet read
+            const bool ok = receiver.ProcessPacket( NULL, 0, packetData, packetBytes );
+            receiverAlloc.Disarm();
+            check( !ok );               // read fails cleanly rather than crashing in the destructor
+        }
+    }
+    check( senderAlloc.GetOutstanding() == 0 );
+    check( receiverAlloc.GetOutstanding() == 0 );
+}
+
+void test_client_connect_socket_failure_no_crash()
+{
+    // Regression: Connect() and ConnectLoopback() called into netcode_client_connect() without
+    // checking that CreateClient() succeeded. When the socket can't be created - forced here with
+    // an unparseable bind address - m_client is NULL and netcode dereferences it (crash in
+    // release; assert trap in debug). Both must bail like InsecureConnect() already does.
+    ClientServerConfig config;
+
+    Address invalidAddress;                     // ADDRESS_NONE -> "NONE" -> netcode_client_create fails
+    check( !invalidAddress.IsValid() );
+
+    Client client( GetDefaultAllocator(), invalidAddress, config, adapter, 100.0 );
+
+    uint8_t connectToken[ConnectTokenBytes];
+    memset( connectToken, 0, sizeof( connectToken ) );
+
+    client.Connect( 1, connectToken );          // must not crash - CreateClient failed
+    check( !client.IsConnected() );
+
+    client.ConnectLoopback( 0, 1, 1 );          // must not crash either
+    check( !client.IsConnected() );
+
+    client.Disconnect();
+}
+
+void test_client_is_loopback_when_disconnected()
+{
+    // Regression: IsLoopback() called netcode_client_loopback(m_client) with no NULL guard, so a
+    // never-connected client (m_client == NULL) crashed. Like GetClientIndex(), it must be safe
+    // to query in any state and simply report false.
+    ClientServerConfig config;
+    Address clientAddress( "0.0.0.0", ClientPort );
+    Client client( GetDefaultAllocator(), clientAddress, config, adapter, 100.0 );
+
+    check( !client.IsLoopback() );              // must not crash; not connected -> not a loopback client
+    check( client.GetClientIndex() == -1 );
+    check( !client.IsConnected() );
+}
+
+void test_client_server_messages()
+{
+    const uint64_t clientId = 1;
+
+    Address clientAddress( "0.0.0.0", ClientPort );
+    Address serverAddress( "127.0.0.1", ServerPort );
+
+    double time = 100.0;
+
+    ClientServerConfig config;
+    config.channel[0].messageSendQueueSize = 32;
+    config.channel[0].maxMessagesPerPacket = 8;
+    config.channel[0].maxBlockSize = 1024;
+    config.channel[0].blockFragmentSize = 200;
+
+    Client client( GetDefaultAllocator(), clientAddress, config, adapter, time );
+
+    uint8_t privateKey[KeyBytes];
+    memset( privateKey, 0, KeyBytes );
+
+    Server server( GetDefaultAllocator(), privateKey, serverAddress, config, adapter, time );
+
+    server.Start( MaxClients );
+
+    server.SetLatency( 250 );
+    server.SetJitter( 100 );
+    server.SetPacketLoss( 25 );
+    server.SetDuplicates( 25 );
+
+    for ( int iteration = 0; iteration < 2; ++iteration )
+    {
+        // connect and wait until connection completes
+
+        client.InsecureConnect( privateKey, clientId, serverAddress );
+
+        client.SetLatency( 250 );
+        client.SetJitter( 100 );
+        client.SetPacketLoss( 25 );
+        client.SetDuplicates( 25 );
+
+        const int NumIterations = 10000;
+
+        for ( int i = 0; i < NumIterations; ++i )
+        {
+            Client * clients[] = { &client };
+            Server * servers[] = { &server };
+
+            PumpClientServerUpdate( time, clients, 1, servers, 1 );
+
+            if ( client.ConnectionFailed() )
+                break;
+
+            if ( !client.IsConnecting() && client.IsConnected() && server.GetNumConnectedClients() == 1 )
+                break;
+        }
+
+        // verify connection has completed successfully
+
+        check( !client.IsConnecting() );
+        check( client.IsConnected() );
+        check( server.GetNumConnectedClients() == 1 );
+        check( client.GetClientIndex() == 0 );
+        check( server.IsClientConnected(0) );
+
+        // send a bunch of messages and pump until they are received
+
+        const int NumMessagesSent = config.channel[0].messageSendQueueSize;
+
+        SendClientToServerMessages( client, NumMessagesSent );
+
+        SendServerToClientMessages( server, client.GetClientIndex(), NumMessagesSent );
+
+        int numMessagesReceivedFromClient = 0;
+        int numMessagesReceivedFromServer = 0;
+
+        for ( int i = 0; i < NumIterations; ++i )
+        {
+            Client * clients[] = { &client };
+            Server * servers[] = { &server };
+
+            PumpClientServerUpdate( time, clients, 1, servers, 1 );
+
+            if ( !client.IsConnected() )
+                break;
+
+            ProcessServerToClientMessages( client, numMessagesReceivedFromServer );
+
+            ProcessClientToServerMessages( server, client.GetClientIndex(), numMessagesReceivedFromClient );
+
+            if ( numMessagesReceivedFromClient == NumMessagesSent && numMessagesReceivedFromServer == NumMessagesSent )
+                break;
+        }
+
+        check( client.IsConnected() );
+        check( server.IsClientConnected( client.GetClientIndex() ) );
+        check( numMessagesReceivedFromClient == NumMessagesSent );
+        check( numMessagesReceivedFromServer == NumMessagesSent );
+
+        // disconnect and pump until client disconnects
+
+        client.Disconnect();
+
+        for ( int i = 0; i < NumIterations; ++i )
+        {
+            Client * clients[] = { &client };
+            Server * servers[] = { &server };
+
+            PumpClientServerUpdate( time, clients, 1, servers, 1 );
+
+            if ( !client.IsConnected() && server.GetNumConnectedClients() == 0 )
+                break;
+        }
+
+        check( !client.IsConnected() && server.GetNumConnectedClients() == 0 );
+    }
+
+    server.Stop();
+}
+
+void test_client_server_lazy_client_memory()
+{
+    const uint64_t clientId = 1;
+
+    Address clientAddress( "0.0.0.0", ClientPort );
+    Address serverAddress( "127.0.0.1", ServerPort );
+
+    double time = 100.0;
+
+    ClientServerConfig config;
+    config.serverLazyClientMemory = true;
+    config.channel[0].messageSendQueueSize = 32;
+    config.channel[0].maxMessagesPerPacket = 8;
+    config.channel[0].maxBlockSize = 1024;
+    config.channel[0].blockFragmentSize = 200;
+
+    uint8_t privateKey[KeyBytes];
+    memset( privateKey, 0, KeyBytes );
+
+    for ( int warmClientSlots = 0; warmClientSlots <= 1; ++warmClientSlots )
+    {
+        config.serverWarmClientSlots = warmClientSlots;
+
+        Client client( GetDefaultAllocator(), clientAddress, config, adapter, time );
+
+        Server server( GetDefaultAllocator(), privateKey, serverAddress, config, adapter, time );
+
+        server.Start( MaxClients );
+
+        // nothing is committed until a client connects
+
+        check( server.GetNumCommittedClients() == 0 );
+        check( server.CreateMessage( 0, TEST_MESSAGE ) == NULL );
+        check( !server.CanSendMessage( 0, 0 ) );
+
+        ClientMemoryInfo info;
+        server.GetClientMemoryInfo( 0, info );
+        check( !info.committed );
+        check( info.reservedBytes >= size_t( config.serverPerClientMemory ) );
+        check( info.residentBytes == 0 );
+
+        client.InsecureConnect( privateKey, clientId, serverAddress );
+
+        const int NumIterations = 10000;
+
+        for ( int i = 0; i < NumIterations; ++i )
+        {
+            Client * clients[] = { &client };
+            Server * servers[] = { &server };
+
+            PumpClientServerUpdate( time, clients, 1, servers, 1 );
+
+            if ( client.ConnectionFailed() )
+                break;
+
+            if ( !client.IsConnecting() && client.IsConnected() && server.GetNumConnectedClients() == 1 )
+                break;
+        }
+
+        check( client.IsConnected() );
+        check( server.IsClientConnected( 0 ) );
+        check( server.GetNumCommittedClients() == 1 );
+
+        // exchange messages through the slot committed on connect
+
+        const int NumMessagesSent = config.channel[0].messageSendQueueSize;
+
+        SendClientToServerMessages( client, NumMessagesSent );
+
+        SendServerToClientMessages( server, client.GetClientIndex(), NumMessagesSent );
+
+        int numMessagesReceivedFromClient = 0;
+        int numMessagesReceivedFromServer = 0;
+
+        for ( int i = 0; i < NumIterations; ++i )
+        {
+            Client * clients[] = { &client };
+            Server * servers[] = { &server };
+
+            PumpClientServerUpdate( time, clients, 1, servers, 1 );
+
+            if ( !client.IsConnected() )
+                break;
+
+            ProcessServerToClientMessages( client, numMessagesReceivedFromServer );
+
+            ProcessClientToServerMessages( server, client.GetClientIndex(), numMessagesReceivedFromClient );
+
+            if ( numMessagesReceivedFromClient == NumMessagesSent && numMessagesReceivedFromServer == NumMessagesSent )
+                break;
+        }
+
+        check( numMessagesReceivedFromClient == NumMessagesSent );
+        check( numMessagesReceivedFromServer == NumMessagesSent );
+
+        server.GetClientMemoryInfo( 0, info );
+        check( info.committed );
+        check( info.residentBytes > 0 );
+        check( info.residentBytes <= info.reservedBytes );
+        check( info.hasHeapStats );
+        check( info.heap.bytesInUse > 0 );
+        check( info.heap.highWaterBytes >= info.heap.bytesInUse );
+        check( info.heap.largestFreeBlock > 0 );
+        check( info.heap.largestFreeBlock < size_t( config.serverPerClientMemory ) );
+        check( info.numMessageTypes == NUM_TEST_MESSAGE_TYPES );
+
+        // hold on to a received message, and it shows up by type
+
+        SendClientToServerMessages( client, 1 );
+        Message * heldMessage = NULL;
+        for ( int i = 0; i < NumIterations && !heldMessage; ++i )
+        {
+            Client * clients[] = { &client };
+            Server * servers[] = { &server };
+
+            PumpClientServerUpdate( time, clients, 1, servers, 1 );
+
+            heldMessage = server.ReceiveMessage( 0, 0 );
+        }
+        check( heldMessage );
 
-    for ( int i = 0; i < numServers; ++i )
-        server[i]->ReceivePackets();
+        server.GetClientMemoryInfo( 0, info );
+        check( info.numMessages >= 1 );
+        check( info.numMessagesByType[heldMessage->GetType()] >= 1 );
+        int numMessages = 0;
+        for ( int i = 0; i < info.numMessageTypes; ++i )
+            numMessages += info.numMessagesByType[i];
+        check( numMessages == info.numMessages );
 
-    time += deltaTime;
+        server.ReleaseMessage( 0, heldMessage );
 
-    for ( int i = 0; i < numClients; ++i )
-        client[i]->AdvanceTime( time );
+        // disconnect. the slot gives its memory back, unless it is kept warm
 
-    for ( int i = 0; i < numServers; ++i )
-        server[i]->AdvanceTime( time );
+        client.Disconnect();
 
-    yojimbo_sleep( 0.0f );
+        for ( int i = 0; i < NumIterations; ++i )
+        {
+            Client * clients[] = { &client };
+            Server * servers[] = { &server };
+
+            PumpClientServerUpdate( time, clients, 1, servers, 1 );
+
+            if ( !client.IsConnected() && server.GetNumConnectedClients() == 0 )
+                break;
+        }
+
+        check( server.GetNumConnectedClients() == 0 );
+
+        server.GetClientMemoryInfo( 0, info );
+        if ( warmClientSlots == 0 )
+        {
+            check( server.GetNumCommittedClients() == 0 );
+            check( !info.committed );
+            check( info.residentBytes == 0 );
+        }
+        else
+        {
+            check( server.GetNumCommittedClients() == 1 );
+            check( info.committed );
+        }
+
+        server.Stop();
+    }
 }
 
-void SendClientToServerMessages( Client & client, int numMessagesToSend, int channelIndex = ReliableChannel )
+void test_client_server_huge_pages()
 {
-    for ( int i = 0; i < numMessagesToSend; ++i )
+    const uint64_t clientId = 1;
+
+    Address clientAddress( "0.0.0.0", ClientPort );
+    Address serverAddress( "127.0.0.1", ServerPort );
+
+    double time = 100.0;
+
+    ClientServerConfig config;
+    config.serverHugePages = true;
+    config.serverNumaNode = yojimbo_memory_numa_node();
+
+    const size_t hugePageSize = yojimbo_memory_huge_page_size();
+
+    uint8_t privateKey[KeyBytes];
+    memset( privateKey, 0, KeyBytes );
+
+    // once with heaps mapped up front, once committed lazily
+
+    for ( int lazy = 0; lazy <= 1; ++lazy )
     {
-        if ( !client.CanSendMessage( channelIndex ) )
-            break;
+        config.serverLazyClientMemory = lazy != 0;
 
-        if ( rand() % 10 )
+        Client client( GetDefaultAllocator(), clientAddress, config, adapter, time );
+
+        Server server( GetDefaultAllocator(), privateKey, serverAddress, config, adapter, time );
+
+        const int NumClientSlots = 4;
+
+        server.Start( NumClientSlots );
+
+        check( server.GetNumCommittedClients() == ( lazy ? 0 : NumClientSlots ) );
+
+        client.InsecureConnect( privateKey, clientId, serverAddress );
+
+        const int NumIterations = 10000;
+
+        for ( int i = 0; i < NumIterations; ++i )
         {
-            TestMessage * message = (TestMessage*) client.CreateMessage( TEST_MESSAGE );
-            check( message );
-            message->sequence = i;
-            client.SendMessage( channelIndex, message );
+            Client * clients[] = { &client };
+            Server * servers[] = { &server };
+
+            PumpClientServerUpdate( time, clients, 1, servers, 1 );
+
+            if ( client.ConnectionFailed() )
+                break;
+
+            if ( !client.IsConnecting() && client.IsConnected() && server.GetNumConnectedClients() == 1 )
+                break;
         }
-        else
+
+        check( client.IsConnected() );
+        check( server.IsClientConnected( 0 ) );
+
+        ClientMemoryInfo info;
+        server.GetClientMemoryInfo( 0, info );
+        check( info.committed );
+        check( info.reservedBytes >= size_t( config.serverPerClientMemory ) );
+        if ( hugePageSize != 0 )
+            check( ( info.reservedBytes % hugePageSize ) == 0 );
+
+        const int NumMessagesSent = 16;
+
+        SendClientToServerMessages( client, NumMessagesSent );
+
+        SendServerToClientMessages( server, client.GetClientIndex(), NumMessagesSent );
+
+        int numMessagesReceivedFromClient = 0;
+        int numMessagesReceivedFromServer = 0;
+
+        for ( int i = 0; i < NumIterations; ++i )
         {
-            TestBlockMessage * message = (TestBlockMessage*) client.CreateMessage( TEST_BLOCK_MESSAGE );
-            check( message );
-            message->sequence = i;
-            const int blockSize = 1 + ( ( i * 901 ) % 1001 );
-            uint8_t * blockData = client.AllocateBlock( blockSize );
-            check( blockData );
-            for ( int j = 0; j < blockSize; ++j )
-                blockData[j] = i + j;
-            client.AttachBlockToMessage( message, blockData, blockSize );
-            client.SendMessage( channelIndex, message );
+            Client * clients[] = { &client };
+            Server * servers[] = { &server };
+
+            PumpClientServerUpdate( time, clients, 1, servers, 1 );
+
+            if ( !client.IsConnected() )
+                break;
+
+            ProcessServerToClientMessages( client, numMessagesReceivedFromServer );
+
+            ProcessClientToServerMessages( server, client.GetClientIndex(), numMessagesReceivedFromClient );
+
+            if ( numMessagesReceivedFromClient == NumMessagesSent && numMessagesReceivedFromServer == NumMessagesSent )
+                break;
         }
+
+        check( numMessagesReceivedFromClient == NumMessagesSent );
+        check( numMessagesReceivedFromServer == NumMessagesSent );
+
+        client.Disconnect();
+
+        server.Stop();
     }
 }
 
-void SendServerToClientMessages( Server & server, int clientIndex, int numMessagesToSend, int channelIndex = ReliableChannel )
+void test_client_server_metrics()
 {
-    for ( int i = 0; i < numMessagesToSend; ++i )
+    const uint64_t clientId = 1;
+
+    Address clientAddress( "0.0.0.0", ClientPort );
+    Address serverAddress( "127.0.0.1", ServerPort );
+
+    double time = 100.0;
+
+    ClientServerConfig config;
+
+    uint8_t privateKey[KeyBytes];
+    memset( privateKey, 0, KeyBytes );
+
+    Client client( GetDefaultAllocator(), clientAddress, config, adapter, time );
+
+    Server server( GetDefaultAllocator(), privateKey, serverAddress, config, adapter, time );
+
+    server.Start( MaxClients );
+
+    client.InsecureConnect( privateKey, clientId, serverAddress );
+
+    const int NumIterations = 10000;
+
+    for ( int i = 0; i < NumIterations; ++i )
     {
-        if ( !server.CanSendMessage( clientIndex, channelIndex ) )
+        Client * clients[] = { &client };
+        Server * servers[] = { &server };
+
+        PumpClientServerUpdate( time, clients, 1, servers, 1 );
+
+        if ( client.ConnectionFailed() )
             break;
 
-        if ( rand() % 10 )
-        {
-            TestMessage * message = (TestMessage*) server.CreateMessage( clientIndex, TEST_MESSAGE );
-            check( message );
-            message->sequence = i;
-            server.SendMessage( clientIndex, channelIndex, message );
-        }
-        else
+        if ( !client.IsConnecting() && client.IsConnected() && server.GetNumConnectedClients() == 1 )
+            break;
+    }
+
+    check( client.IsConnected() );
+
+    const int NumMessagesSent = 16;
+
+    SendClientToServerMessages( client, NumMessagesSent );
+
+    SendServerToClientMessages( server, client.GetClientIndex(), NumMessagesSent );
+
+    int numMessagesReceivedFromClient = 0;
+    int numMessagesReceivedFromServer = 0;
+
+    for ( int i = 0; i < NumIterations; ++i )
+    {
+        Client * clients[] = { &client };
+        Server * servers[] = { &server };
+
+        PumpClientServerUpdate( time, clients, 1, servers, 1 );
+
+        if ( !client.IsConnected() )
+            break;
+
+        ProcessServerToClientMessages( client, numMessagesReceivedFromServer );
+
+        ProcessClientToServerMessages( server, client.GetClientIndex(), numMessagesReceivedFromClient );
+
+        if ( numMessagesReceivedFromClient == NumMessagesSent && numMessagesReceivedFromServer == NumMessagesSent )
+            break;
+    }
+
+    check( numMessagesReceivedFromClient == NumMessagesSent );
+    check( numMessagesReceivedFromServer == NumMessagesSent );
+
+    for ( int side = 0; side <= 1; ++side )
+    {
+        const MetricsRegistry & metrics = side ? server.GetMetrics() : client.GetMetrics();
+        const ConnectionMetrics & ids = side ? server.GetConnectionMetrics() : client.GetConnectionMetrics();
+
+        const uint64_t packetsSent = metrics.GetMetric( ids.packetsSent ).count;
+        const uint64_t packetsReceived = metrics.GetMetric( ids.packetsReceived ).count;
+        check( packetsSent > 0 );
+        check( packetsReceived > 0 );
+        check( metrics.GetMetric( ids.packetBytesSent ).count == packetsSent );
+        check( metrics.GetMetric( ids.packetBytesReceived ).count == packetsReceived );
+        check( metrics.GetMetric( ids.packetBytesSent ).value > 0.0 );
+        check( metrics.GetMetric( ids.decryptFailures ).count == 0 );
+        check( metrics.GetMetric( ids.channelBitsPerPacket ).count > 0 );
+        check( metrics.GetMetric( ids.messagesPerPacket ).value >= NumMessagesSent );
+        check( metrics.GetMetric( ids.sendQueueDepth ).count > 0 );
+        check( metrics.GetMetric( ids.connections ).value == 1.0 );
+        check( metrics.GetMetric( ids.receivePacketsTime ).count > 0 );
+        check( metrics.GetMetric( ids.sendPacketsTime ).count > 0 );
+        check( metrics.GetMetric( ids.advanceTimeTime ).count > 0 );
+    }
+
+    // the server export has every built-in metric
+
+    MetricsSnapshot snapshot;
+    server.GetMetrics().GetSnapshot( snapshot );
+    const int length = WriteMetrics( snapshot, METRICS_FORMAT_PROMETHEUS, NULL, 0 );
+    char * text = (char*) malloc( length + 1 );
+    check( WriteMetrics( snapshot, METRICS_FORMAT_PROMETHEUS, text, length + 1 ) == length );
+    check( strstr( text, "\nyojimbo_packets_sent_total " ) );
+    check( strstr( text, "\nyojimbo_decrypt_failures_total 0\n" ) );
+    check( strstr( text, "\nyojimbo_connections 1\n" ) );
+    check( strstr( text, "\nyojimbo_send_packets_seconds_count " ) );
+    free( text );
+
+    client.Disconnect();
+
+    server.Stop();
+}
+
+void test_packet_capture()
+{
+    const uint64_t clientId = 1;
+
+    Address clientAddress( "0.0.0.0", ClientPort );
+    Address serverAddress( "127.0.0.1", ServerPort );
+
+    double time = 100.0;
+
+    ClientServerConfig config;
+    config.channel[0].maxBlockSize = 1024;
+    config.channel[0].blockFragmentSize = 200;
+
+    uint8_t privateKey[KeyBytes];
+    memset( privateKey, 0, KeyBytes );
+
+    Client client( GetDefaultAllocator(), clientAddress, config, adapter, time );
+
+    Server server( GetDefaultAllocator(), privateKey, serverAddress, config, adapter, time );
+
+    server.Start( MaxClients );
+
+    check( !server.IsCapturing() );
+    check( server.StartCapture( "test_capture.bin" ) );
+    check( server.IsCapturing() );
+
+    client.InsecureConnect( privateKey, clientId, serverAddress );
+
+    const int NumIterations = 10000;
+
+    for ( int i = 0; i < NumIterations; ++i )
+    {
+        Client * clients[] = { &client };
+        Server * servers[] = { &server };
+
+        PumpClientServerUpdate( time, clients, 1, servers, 1 );
+
+        if ( client.ConnectionFailed() )
+            break;
+
+        if ( !client.IsConnecting() && client.IsConnected() && server.GetNumConnectedClients() == 1 )
+            break;
+    }
+
+    check( client.IsConnected() );
+
+    const int NumMessagesSent = 64;
+
+    int numMessagesReceivedFromClient = 0;
+    int numMessagesReceivedFromServer = 0;
+    int numMessagesQueued = 0;
+
+    for ( int i = 0; i < NumIterations; ++i )
+    {
+        Client * clients[] = { &client };
+        Server * servers[] = { &server };
+
+        if ( numMessagesQueued < NumMessagesSent && client.CanSendMessage( ReliableChannel ) )
         {
-            TestBlockMessage * message = (TestBlockMessage*) server.CreateMessage( clientIndex, TEST_BLOCK_MESSAGE );
+            TestMessage * message = (TestMessage*) client.CreateMessage( TEST_MESSAGE );
             check( message );
-            message->sequence = i;
-            const int blockSize = 1 + ( ( i * 901 ) % 1001 );
-            uint8_t * blockData = server.AllocateBlock( clientIndex, blockSize );
-            check( blockData );
-            for ( int j = 0; j < blockSize; ++j )
-                blockData[j] = i + j;
-            server.AttachBlockToMessage( clientIndex, message, blockData, blockSize );
-            server.SendMessage( clientIndex, channelIndex, message );
+            message->sequence = numMessagesQueued++;
+            client.SendMessage( ReliableChannel, message );
         }
-    }
-}
 
-void ProcessServerToClientMessages( Client & client, int & numMessagesReceivedFromServer, int channelIndex = ReliableChannel )
-{
-    while ( true )
-    {
-        Message * message = client.ReceiveMessage( channelIndex );
+        PumpClientServerUpdate( time, clients, 1, servers, 1 );
 
-        if ( !message )
-            break;
+        ProcessServerToClientMessages( client, numMessagesReceivedFromServer );
 
-        check( message->GetId() == (int) numMessagesReceivedFromServer );
+        ProcessClientToServerMessages( server, client.GetClientIndex(), numMessagesReceivedFromClient );
 
-        switch ( message->GetType() )
-        {
-            case TEST_MESSAGE:
-            {
-                TestMessage * testMessage = (TestMessage*) message;
-                check( !message->IsBlockMessage() );
-                check( testMessage->sequence == uint16_t( numMessagesReceivedFromServer ) );
-                ++numMessagesReceivedFromServer;
-            }
+        if ( numMessagesReceivedFromClient == NumMessagesSent )
             break;
+    }
 
-            case TEST_BLOCK_MESSAGE:
-            {
-                check( message->IsBlockMessage() );
-                TestBlockMessage * blockMessage = (TestBlockMessage*) message;
-                check( blockMessage->sequence == uint16_t( numMessagesReceivedFromServer ) );
-                const int blockSize = blockMessage->GetBlockSize();
-                check( blockSize == 1 + ( ( numMessagesReceivedFromServer * 901 ) % 1001 ) );
-                const uint8_t * blockData = blockMessage->GetBlockData();
-                check( blockData );
-                for ( int j = 0; j < blockSize; ++j )
-                {
-                    check( blockData[j] == uint8_t( numMessagesReceivedFromServer + j ) );
-                }
-                ++numMessagesReceivedFromServer;
-            }
-            break;
-        }
+    check( numMessagesReceivedFromClient == NumMessagesSent );
 
-        client.ReleaseMessage( message );
-    }
-}
+    // a few more updates so the server acks everything it received
 
-void ProcessClientToServerMessages( Server & server, int clientIndex, int & numMessagesReceivedFromClient, int channelIndex = ReliableChannel )
-{
-    while ( true )
+    for ( int i = 0; i < 10; ++i )
     {
-        Message * message = server.ReceiveMessage( clientIndex, channelIndex );
+        Client * clients[] = { &client };
+        Server * servers[] = { &server };
+        PumpClientServerUpdate( time, clients, 1, servers, 1 );
+    }
 
-        if ( !message )
-            break;
+    server.StopCapture();
+    check( !server.IsCapturing() );
 
-        check( message->GetId() == (int) numMessagesReceivedFromClient );
+    client.Disconnect();
+    server.Stop();
 
-        switch ( message->GetType() )
-        {
-            case TEST_MESSAGE:
-            {
-                check( !message->IsBlockMessage() );
-                TestMessage * testMessage = (TestMessage*) message;
-                check( testMessage->sequence == uint16_t( numMessagesReceivedFromClient ) );
-                ++numMessagesReceivedFromClient;
-            }
-            break;
+    // the capture has the server's config and every kind of record
 
-            case TEST_BLOCK_MESSAGE:
-            {
-                check( message->IsBlockMessage() );
-                TestBlockMessage * blockMessage = (TestBlockMessage*) message;
-                check( blockMessage->sequence == uint16_t( numMessagesReceivedFromClient ) );
-                const int blockSize = blockMessage->GetBlockSize();
-                check( blockSize == 1 + ( ( numMessagesReceivedFromClient * 901 ) % 1001 ) );
-                const uint8_t * blockData = blockMessage->GetBlockData();
-                check( blockData );
-                for ( int j = 0; j < blockSize; ++j )
-                {
-                    check( blockData[j] == uint8_t( numMessagesReceivedFromClient + j ) );
-                }
-                ++numMessagesReceivedFromClient;
-            }
-            break;
-        }
+    PacketCaptureReader reader( GetDefaultAllocator() );
+    check( reader.Open( "test_capture.bin" ) );
+    check( reader.IsServer() );
 
-        server.ReleaseMessage( clientIndex, message );
-    }
-}
+    const ConnectionConfig & captureConfig = reader.GetConnectionConfig();
+    check( captureConfig.numChannels == config.numChannels );
+    check( captureConfig.maxPacketSize == config.maxPacketSize );
+    check( captureConfig.channel[0].type == config.channel[0].type );
+    check( captureConfig.channel[0].maxBlockSize == config.channel[0].maxBlockSize );
+    check( captureConfig.channel[0].blockFragmentSize == config.channel[0].blockFragmentSize );
 
-void test_connection_reliable_message_alloc_failure()
-{
-    // Regression: on the send path, GetMessagePacketData allocated the message-pointer array
-    // without checking for NULL and then wrote through it - a crash on allocator exhaustion.
-    // Arm the allocator to fail that first allocation inside GeneratePacket and verify we neither
-    // crash nor leak (the queued reliable message is retained and freed at teardown).
-    ArmableAllocator allocator;
+    int numRecords[CAPTURE_NUM_RECORD_TYPES];
+    memset( numRecords, 0, sizeof( numRecords ) );
+    double lastTime = 0.0;
+
+    CaptureRecord record;
+    while ( reader.ReadRecord( record ) )
     {
-        TestMessageFactory messageFactory( allocator );
+        check( record.type >= 0 && record.type < CAPTURE_NUM_RECORD_TYPES );
+        check( record.clientIndex == 0 );
+        check( record.time >= lastTime );
+        lastTime = record.time;
+        if ( record.type == CAPTURE_RECORD_PACKET_RECEIVED || record.type == CAPTURE_RECORD_PACKET_SENT )
+        {
+            check( record.packetData );
+            check( record.packetBytes > 0 && record.packetBytes <= config.maxPacketSize );
+        }
+        numRecords[record.type]++;
+    }
 
-        ConnectionConfig config;
-        config.numChannels = 1;
-        config.channel[0].type = CHANNEL_TYPE_RELIABLE_ORDERED;
+    check( !reader.IsTruncated() );
+    check( numRecords[CAPTURE_RECORD_PACKET_RECEIVED] > 0 );
+    check( numRecords[CAPTURE_RECORD_PACKET_SENT] > 0 );
+    check( numRecords[CAPTURE_RECORD_ADVANCE_TIME] > 0 );
+    check( numRecords[CAPTURE_RECORD_CLIENT_CONNECTED] == 1 );
 
-        {
-            Connection connection( allocator, messageFactory, config, 100.0 );
+    // replaying the capture receives exactly the messages the server received, and replaying it twice gives the same result
 
-            Message * message = messageFactory.CreateMessage( TEST_MESSAGE );
-            check( message );
-            connection.SendMessage( 0, message );
+    TestMessageFactory messageFactory( GetDefaultAllocator() );
 
-            uint8_t packetData[4096];
-            int packetBytes = 0;
+    for ( int pass = 0; pass < 2; ++pass )
+    {
+        reader.Rewind();
+
+        CaptureReplayStats stats;
+        check( ReplayCapture( GetDefaultAllocator(), messageFactory, NULL, reader, true, stats ) );
+        check( stats.numPacketErrors == 0 );
+        check( stats.numPacketsReceived == (uint64_t) numRecords[CAPTURE_RECORD_PACKET_RECEIVED] );
+        check( stats.numPacketsSent == (uint64_t) numRecords[CAPTURE_RECORD_PACKET_SENT] );
+        check( stats.numConnects == 1 );
+        check( stats.numMessagesReceived == (uint64_t) NumMessagesSent );
+    }
 
-            allocator.Arm( 0 );     // fail the first allocation inside GeneratePacket (message array)
-            connection.GeneratePacket( NULL, 0, packetData, sizeof( packetData ), packetBytes );
-            allocator.Disarm();
+    reader.Close();
+
+    // a capture cut off part way through a record replays everything before it, and reports the truncation
+
+    FILE * file = fopen( "test_capture.bin", "rb" );
+    check( file );
+    fseek( file, 0, SEEK_END );
+    const long fileBytes = ftell( file );
+    fseek( file, 0, SEEK_SET );
+    uint8_t * fileData = (uint8_t*) malloc( fileBytes );
+    check( fread( fileData, 1, fileBytes, file ) == (size_t) fileBytes );
+    fclose( file );
+
+    file = fopen( "test_capture.bin", "wb" );
+    check( file );
+    fwrite( fileData, 1, fileBytes - 3, file );
+    fclose( file );
+
+    check( reader.Open( "test_capture.bin" ) );
+    CaptureReplayStats stats;
+    check( !ReplayCapture( GetDefaultAllocator(), messageFactory, NULL, reader, false, stats ) );
+    check( reader.IsTruncated() );
+    check( stats.numPacketErrors == 0 );
+    check( stats.numRecords > 0 );
+    reader.Close();
+
+    // a capture that ends on a packet record replays that packet too. the bit reader loads 8 byte windows, so the
+    // last packet must not sit right at the end of the reader's copy of the file (run this under ASan to see it)
+
+    file = fopen( "test_capture.bin", "wb" );
+    check( file );
+    fwrite( fileData, 1, fileBytes, file );
+    fclose( file );
+
+    const long recordHeaderBytes = 1 + 2 + 2 + 8 + 4;
+
+    check( reader.Open( "test_capture.bin" ) );
+    long recordBytes = 0;
+    long lastPacketEnd = 0;
+    int numPacketsBeforeEnd = 0;
+    int numPacketsReceived = 0;
+    while ( reader.ReadRecord( record ) )
+    {
+        recordBytes += recordHeaderBytes + record.packetBytes;
+        if ( record.type == CAPTURE_RECORD_PACKET_RECEIVED )
+        {
+            numPacketsReceived++;
+            lastPacketEnd = recordBytes;
+            numPacketsBeforeEnd = numPacketsReceived;
         }
     }
-    check( allocator.GetOutstanding() == 0 );   // no leak across teardown
-}
+    reader.Close();
 
-void test_connection_unreliable_message_alloc_failure()
-{
-    // Regression: the unreliable channel's GetPacketData allocated the message-pointer array
-    // without a NULL check and then wrote through it. The messages had already been popped off
-    // the send queue, so a failure crashed (NULL deref) and would have leaked the popped
-    // messages. Arm the allocator to fail that allocation and verify no crash and no leak.
-    ArmableAllocator allocator;
-    {
-        TestMessageFactory messageFactory( allocator );
+    const long headerBytes = fileBytes - recordBytes;
+    check( lastPacketEnd > 0 );
+    check( lastPacketEnd < recordBytes );
 
-        ConnectionConfig config;
-        config.numChannels = 1;
-        config.channel[0].type = CHANNEL_TYPE_UNRELIABLE_UNORDERED;
+    file = fopen( "test_capture.bin", "wb" );
+    check( file );
+    fwrite( fileData, 1, headerBytes + lastPacketEnd, file );
+    fclose( file );
 
-        {
-            Connection connection( allocator, messageFactory, config, 100.0 );
+    check( reader.Open( "test_capture.bin" ) );
+    check( ReplayCapture( GetDefaultAllocator(), messageFactory, NULL, reader, false, stats ) );
+    check( !reader.IsTruncated() );
+    check( stats.numPacketErrors == 0 );
+    check( stats.numPacketsReceived == (uint64_t) numPacketsBeforeEnd );
+    check( stats.numMessagesReceived == (uint64_t) NumMessagesSent );
+    reader.Close();
 
-            for ( int i = 0; i < 4; ++i )
-            {
-                Message * message = messageFactory.CreateMessage( TEST_MESSAGE );
-                check( message );
-                connection.SendMessage( 0, message );
-            }
+    // a capture whose channel config would break the connection fails to open. offsets are into channel 0 of the header
 
-            uint8_t packetData[4096];
-            int packetBytes = 0;
+    struct BadChannelField { int offset; int original; int value; };
 
-            allocator.Arm( 0 );     // fail the message-pointer array allocation in GetPacketData
-            connection.GeneratePacket( NULL, 0, packetData, sizeof( packetData ), packetBytes );
-            allocator.Disarm();
-        }
-    }
-    check( allocator.GetOutstanding() == 0 );   // popped messages released, nothing leaked
-}
+    const ChannelConfig & channel = config.channel[0];
 
-void test_connection_generate_packet_channel_data_alloc_failure()
-{
-    // Regression: when AllocateChannelData failed, GeneratePacket returned without freeing the
-    // per-channel packet data GetPacketData had already populated (acquired message references
-    // and the allocated message-pointer array), leaking them. Arm the allocator so the message
-    // array allocation succeeds but the subsequent channel-data allocation fails, and verify
-    // nothing leaks.
-    ArmableAllocator allocator;
+    const BadChannelField badFields[] =
     {
-        TestMessageFactory messageFactory( allocator );
+        { 29, channel.sentPacketBufferSize, 0 },
+        { 29, channel.sentPacketBufferSize, 3 },
+        { 33, channel.messageSendQueueSize, 0 },
+        { 37, channel.messageReceiveQueueSize, 1000 },
+        { 49, channel.maxBlockSize, -1 },
+        { 53, channel.blockFragmentSize, -200 },
+        { 65, channel.maxFragmentsPerPacket, 0 },
+    };
 
-        ConnectionConfig config;
-        config.numChannels = 1;
-        config.channel[0].type = CHANNEL_TYPE_RELIABLE_ORDERED;
+    for ( int i = 0; i < int( sizeof( badFields ) / sizeof( badFields[0] ) ); ++i )
+    {
+        uint8_t * badData = (uint8_t*) malloc( fileBytes );
+        memcpy( badData, fileData, fileBytes );
+
+        uint8_t * p = badData + badFields[i].offset;
+        const uint32_t original = uint32_t( p[0] ) | ( uint32_t( p[1] ) << 8 ) | ( uint32_t( p[2] ) << 16 ) | ( uint32_t( p[3] ) << 24 );
+        check( original == uint32_t( badFields[i].original ) );
+
+        const uint32_t value = uint32_t( badFields[i].value );
+        p[0] = uint8_t( value );
+        p[1] = uint8_t( value >> 8 );
+        p[2] = uint8_t( value >> 16 );
+        p[3] = uint8_t( value >> 24 );
+
+        file = fopen( "test_capture.bin", "wb" );
+        check( file );
+        fwrite( badData, 1, fileBytes, file );
+        fclose( file );
+        free( badData );
+
+        check( !reader.Open( "test_capture.bin" ) );
+    }
 
-        {
-            Connection connection( allocator, messageFactory, config, 100.0 );
+    free( fileData );
 
-            Message * message = messageFactory.CreateMessage( TEST_MESSAGE );
-            check( message );
-            connection.SendMessage( 0, message );
+    // a file that is not a capture fails to open
 
-            uint8_t packetData[4096];
-            int packetBytes = 0;
+    file = fopen( "test_capture.bin", "wb" );
+    check( file );
+    fprintf( file, "not a capture" );
+    fclose( file );
+    check( !reader.Open( "test_capture.bin" ) );
 
-            allocator.Arm( 1 );     // 1st alloc (message array) succeeds, 2nd (channel data) fails
-            const bool result = connection.GeneratePacket( NULL, 0, packetData, sizeof( packetData ), packetBytes );
-            allocator.Disarm();
-            check( !result );       // the channel-data allocation failure fails the generate
-        }
-    }
-    check( allocator.GetOutstanding() == 0 );   // no leak across teardown
+    remove( "test_capture.bin" );
 }
 
-void test_message_factory_create_message_alloc_failure()
+void test_client_server_direct_loopback()
 {
-    // Regression: YOJIMBO_NEW used to run the constructor on a NULL pointer when the allocation
-    // failed (undefined behavior / crash) before CreateMessage's NULL check. CreateMessage must
-    // return NULL cleanly on allocator exhaustion and flag the factory.
-    ArmableAllocator allocator;
-    {
-        TestMessageFactory factory( allocator );
-        allocator.Arm( 0 );     // fail the next allocation (the message object)
-        Message * message = factory.CreateMessage( TEST_MESSAGE );
-        allocator.Disarm();
-        check( message == NULL );
-        check( factory.GetErrorLevel() == MESSAGE_FACTORY_ERROR_FAILED_TO_ALLOCATE_MESSAGE );
-    }
-    check( allocator.GetOutstanding() == 0 );
-}
+    const uint64_t clientId = 1;
 
-void test_connection_process_packet_channel_data_alloc_failure()
-{
-    // Regression: on the read path, if AllocateChannelData failed, numChannelEntries had already
-    // been read from the wire, so the ConnectionPacket destructor iterated a NULL channelEntry
-    // array (crash). Feed a valid packet to a receiver whose allocator fails the channel-data
-    // allocation, and verify the read fails cleanly without crashing or leaking.
-    ArmableAllocator senderAlloc;
-    ArmableAllocator receiverAlloc;
-    {
-        TestMessageFactory senderFactory( senderAlloc );
-        TestMessageFactory receiverFactory( receiverAlloc );
+    Address clientAddress( "0.0.0.0", ClientPort );
+    Address serverAddress( "127.0.0.1", ServerPort );
 
-        ConnectionConfig config;
-        config.numChannels = 1;
-        config.channel[0].type = CHANNEL_TYPE_RELIABLE_ORDERED;
+    double time = 100.0;
 
-        {
-            Connection sender( senderAlloc, senderFactory, config, 100.0 );
-            Connection receiver( receiverAlloc, receiverFactory, config, 100.0 );
+    ClientServerConfig config;
 
-            Message * message = senderFactory.CreateMessage( TEST_MESSAGE );
-            check( message );
-            sender.SendMessage( 0, message );
+    uint8_t privateKey[KeyBytes];
+    memset( privateKey, 0, KeyBytes );
 
-            uint8_t packetData[4096];
-            int packetBytes = 0;
-            check( sender.GeneratePacket( NULL, 0, packetData, sizeof( packetData ), packetBytes ) );
-            check( packetBytes > 0 );
+    Server server( GetDefaultAllocator(), privateKey, serverAddress, config, adapter, time );
 
-            receiverAlloc.Arm( 0 );     // fail the channel-data allocation in the connection-packet read
-            const bool ok = receiver.ProcessPacket( NULL, 0, packetData, packetBytes );
-            receiverAlloc.Disarm();
-            check( !ok );               // read fails cleanly rather than crashing in the destructor
-        }
+    server.Start( MaxClients );
+
+    Client client( GetDefaultAllocator(), clientAddress, config, adapter, time );
+
+    // the test adapter asserts if a loopback packet is sent, so this also checks that no packets are sent
+
+    server.ConnectLoopbackClient( 0, clientId, NULL );
+
+    client.ConnectDirectLoopback( server, 0 );
+
+    check( client.IsConnected() );
+    check( client.IsLoopback() );
+    check( client.IsDirectLoopback() );
+    check( client.GetClientIndex() == 0 );
+    check( server.IsDirectLoopbackClient( 0 ) );
+    check( !server.IsDirectLoopbackClient( 1 ) );
+
+    // fill the send queues both ways, then drain them
+
+    const int NumMessagesSent = config.channel[ReliableChannel].messageSendQueueSize;
+
+    SendClientToServerMessages( client, NumMessagesSent );
+    SendServerToClientMessages( server, 0, NumMessagesSent );
+
+    check( !client.CanSendMessage( ReliableChannel ) );
+    check( !server.CanSendMessage( 0, ReliableChannel ) );
+    check( client.HasMessagesToSend( ReliableChannel ) );
+    check( server.HasMessagesToSend( 0, ReliableChannel ) );
+
+    int numMessagesReceivedFromClient = 0;
+    int numMessagesReceivedFromServer = 0;
+
+    for ( int i = 0; i < 10; ++i )
+    {
+        Client * clients[] = { &client };
+        Server * servers[] = { &server };
+
+        PumpClientServerUpdate( time, clients, 1, servers, 1 );
+
+        ProcessServerToClientMessages( client, numMessagesReceivedFromServer );
+        ProcessClientToServerMessages( server, 0, numMessagesReceivedFromClient );
     }
-    check( senderAlloc.GetOutstanding() == 0 );
-    check( receiverAlloc.GetOutstanding() == 0 );
-}
 
-void test_client_connect_socket_failure_no_crash()
-{
-    // Regression: Connect() and ConnectLoopback() called into netcode_client_connect() without
-    // checking that CreateClient() succeeded. When the socket can't be created - forced here with
-    // an unparseable bind address - m_client is NULL and netcode dereferences it (crash in
-    // release; assert trap in debug). Both must bail like InsecureConnect() already does.
-    ClientServerConfig config;
+    check( client.IsConnected() );
+    check( numMessagesReceivedFromClient == NumMessagesSent );
+    check( numMessagesReceivedFromServer == NumMessagesSent );
+    check( !client.HasMessagesToSend( ReliableChannel ) );
+    check( !server.HasMessagesToSend( 0, ReliableChannel ) );
 
-    Address invalidAddress;                     // ADDRESS_NONE -> "NONE" -> netcode_client_create fails
-    check( !invalidAddress.IsValid() );
+    NetworkInfo networkInfo;
+    client.GetNetworkInfo( networkInfo );
+    check( networkInfo.numPacketsSent == 0 );
 
-    Client client( GetDefaultAllocator(), invalidAddress, config, adapter, 100.0 );
+    // every message came from the server slot, and every one was released
 
-    uint8_t connectToken[ConnectTokenBytes];
-    memset( connectToken, 0, sizeof( connectToken ) );
+    ClientMemoryInfo memoryInfo;
+    server.GetClientMemoryInfo( 0, memoryInfo );
+    check( memoryInfo.numMessages == 0 );
+
+    // the server disconnecting the slot disconnects the client, and releases the messages still queued.
+    // a message the client received before the disconnect is released back to the slot afterwards
+
+    SendClientToServerMessages( client, 10 );
+    SendServerToClientMessages( server, 0, 11 );
+
+    Message * heldMessage = client.ReceiveMessage( ReliableChannel );
+    check( heldMessage );
+
+    server.GetClientMemoryInfo( 0, memoryInfo );
+    check( memoryInfo.numMessages == 21 );
+
+    server.DisconnectLoopbackClient( 0 );
 
-    client.Connect( 1, connectToken );          // must not crash - CreateClient failed
     check( !client.IsConnected() );
+    check( !client.IsDirectLoopback() );
+    check( !server.IsDirectLoopbackClient( 0 ) );
+
+    server.GetClientMemoryInfo( 0, memoryInfo );
+    check( memoryInfo.numMessages == 1 );
+
+    client.ReleaseMessage( heldMessage );
+
+    server.GetClientMemoryInfo( 0, memoryInfo );
+    check( memoryInfo.numMessages == 0 );
+
+    // the client disconnecting first leaves the link to the server until it disconnects the slot
+
+    server.ConnectLoopbackClient( 0, clientId, NULL );
+
+    client.ConnectDirectLoopback( server, 0 );
+
+    check( client.IsDirectLoopback() );
+
+    SendServerToClientMessages( server, 0, 10 );
+
+    client.DisconnectLoopback();
 
-    client.ConnectLoopback( 0, 1, 1 );          // must not crash either
     check( !client.IsConnected() );
+    check( server.IsDirectLoopbackClient( 0 ) );
 
-    client.Disconnect();
-}
+    server.DisconnectLoopbackClient( 0 );
 
-void test_client_is_loopback_when_disconnected()
-{
-    // Regression: IsLoopback() called netcode_client_loopback(m_client) with no NULL guard, so a
-    // never-connected client (m_client == NULL) crashed. Like GetClientIndex(), it must be safe
-    // to query in any state and simply report false.
-    ClientServerConfig config;
-    Address clientAddress( "0.0.0.0", ClientPort );
-    Client client( GetDefaultAllocator(), clientAddress, config, adapter, 100.0 );
+    check( !server.IsDirectLoopbackClient( 0 ) );
+
+    server.GetClientMemoryInfo( 0, memoryInfo );
+    check( memoryInfo.numMessages == 0 );
+
+    // stopping the server disconnects a linked client
+
+    server.ConnectLoopbackClient( 0, clientId, NULL );
+
+    client.ConnectDirectLoopback( server, 0 );
+
+    check( client.IsConnected() );
+
+    server.Stop();
 
-    check( !client.IsLoopback() );              // must not crash; not connected -> not a loopback client
-    check( client.GetClientIndex() == -1 );
     check( !client.IsConnected() );
+    check( !client.IsDirectLoopback() );
 }
 
-void test_client_server_messages()
+void test_client_server_extended_acks()
 {
+    // Both ends configured for 128 ack bits. Messages still flow both ways under loss, so the extended
+    // ack header round trips through netcode and the reliable endpoints on client and server.
+
     const uint64_t clientId = 1;
 
     Address clientAddress( "0.0.0.0", ClientPort );
@@ -2054,6 +4886,7 @@ void test_client_server_messages()
     double time = 100.0;
 
     ClientServerConfig config;
+    config.ackBits = 128;
     config.channel[0].messageSendQueueSize = 32;
     config.channel[0].maxMessagesPerPacket = 8;
     config.channel[0].maxBlockSize = 1024;
@@ -2068,97 +4901,63 @@ void test_client_server_messages()
 
     server.Start( MaxClients );
 
-    server.SetLatency( 250 );
-    server.SetJitter( 100 );
     server.SetPacketLoss( 25 );
-    server.SetDuplicates( 25 );
-
-    for ( int iteration = 0; iteration < 2; ++iteration )
-    {
-        // connect and wait until connection completes
-
-        client.InsecureConnect( privateKey, clientId, serverAddress );
-
-        client.SetLatency( 250 );
-        client.SetJitter( 100 );
-        client.SetPacketLoss( 25 );
-        client.SetDuplicates( 25 );
-
-        const int NumIterations = 10000;
-
-        for ( int i = 0; i < NumIterations; ++i )
-        {
-            Client * clients[] = { &client };
-            Server * servers[] = { &server };
-
-            PumpClientServerUpdate( time, clients, 1, servers, 1 );
-
-            if ( client.ConnectionFailed() )
-                break;
-
-            if ( !client.IsConnecting() && client.IsConnected() && server.GetNumConnectedClients() == 1 )
-                break;
-        }
 
-        // verify connection has completed successfully
+    client.InsecureConnect( privateKey, clientId, serverAddress );
 
-        check( !client.IsConnecting() );
-        check( client.IsConnected() );
-        check( server.GetNumConnectedClients() == 1 );
-        check( client.GetClientIndex() == 0 );
-        check( server.IsClientConnected(0) );
+    client.SetPacketLoss( 25 );
 
-        // send a bunch of messages and pump until they are received
+    const int NumIterations = 10000;
 
-        const int NumMessagesSent = config.channel[0].messageSendQueueSize;
+    for ( int i = 0; i < NumIterations; ++i )
+    {
+        Client * clients[] = { &client };
+        Server * servers[] = { &server };
 
-        SendClientToServerMessages( client, NumMessagesSent );
+        PumpClientServerUpdate( time, clients, 1, servers, 1 );
 
-        SendServerToClientMessages( server, client.GetClientIndex(), NumMessagesSent );
+        if ( client.ConnectionFailed() )
+            break;
 
-        int numMessagesReceivedFromClient = 0;
-        int numMessagesReceivedFromServer = 0;
+        if ( !client.IsConnecting() && client.IsConnected() && server.GetNumConnectedClients() == 1 )
+            break;
+    }
 
-        for ( int i = 0; i < NumIterations; ++i )
-        {
-            Client * clients[] = { &client };
-            Server * servers[] = { &server };
+    check( client.IsConnected() );
+    check( server.GetNumConnectedClients() == 1 );
 
-            PumpClientServerUpdate( time, clients, 1, servers, 1 );
+    const int NumMessagesSent = config.channel[0].messageSendQueueSize;
 
-            if ( !client.IsConnected() )
-                break;
+    SendClientToServerMessages( client, NumMessagesSent );
 
-            ProcessServerToClientMessages( client, numMessagesReceivedFromServer );
+    SendServerToClientMessages( server, client.GetClientIndex(), NumMessagesSent );
 
-            ProcessClientToServerMessages( server, client.GetClientIndex(), numMessagesReceivedFromClient );
+    int numMessagesReceivedFromClient = 0;
+    int numMessagesReceivedFromServer = 0;
 
-            if ( numMessagesReceivedFromClient == NumMessagesSent && numMessagesReceivedFromServer == NumMessagesSent )
-                break;
-        }
+    for ( int i = 0; i < NumIterations; ++i )
+    {
+        Client * clients[] = { &client };
+        Server * servers[] = { &server };
 
-        check( client.IsConnected() );
-        check( server.IsClientConnected( client.GetClientIndex() ) );
-        check( numMessagesReceivedFromClient == NumMessagesSent );
-        check( numMessagesReceivedFromServer == NumMessagesSent );
+        PumpClientServerUpdate( time, clients, 1, servers, 1 );
 
-        // disconnect and pump until client disconnects
+        if ( !client.IsConnected() )
+            break;
 
-        client.Disconnect();
+        ProcessServerToClientMessages( client, numMessagesReceivedFromServer );
 
-        for ( int i = 0; i < NumIterations; ++i )
-        {
-            Client * clients[] = { &client };
-            Server * servers[] = { &server };
+        ProcessClientToServerMessages( server, client.GetClientIndex(), numMessagesReceivedFromClient );
 
-            PumpClientServerUpdate( time, clients, 1, servers, 1 );
+        if ( numMessagesReceivedFromClient == NumMessagesSent && numMessagesReceivedFromServer == NumMessagesSent )
+            break;
+    }
 
-            if ( !client.IsConnected() && server.GetNumConnectedClients() == 0 )
-                break;
-        }
+    check( client.IsConnected() );
+    check( numMessagesReceivedFromClient == NumMessagesSent );
+    check( numMessagesReceivedFromServer == NumMessagesSent );
 
-        check( !client.IsConnected() && server.GetNumConnectedClients() == 0 );
-    }
+    client.Disconnect();
 
     server.Stop();
 }
@@ -3386,6 +6185,251 @@ void test_single_message_type_unreliable()
     check( numMessagesReceived == NumMessagesSent );
 }
 
+#if YOJIMBO_TEST_SCHEMA
+
+// generated at build time from tools/schema/test_messages.json (see yojimbo_add_schema in CMakeLists.txt)
+
+#include "test_messages.h"
+
+static void FillSchemaMessage( Message * message, int seed )
+{
+    switch ( message->GetType() )
+    {
+        case SCHEMA_INPUT_MESSAGE:
+        {
+            SchemaInputMessage * input = (SchemaInputMessage*) message;
+            input->sequence = uint16_t( seed * 7919 );
+            input->buttons = uint32_t( seed * 37 ) & 0xFFF;
+            input->jump = ( seed & 1 ) != 0;
+            input->yaw = -180.0f + ( seed % 360 );
+            input->throttle = ( seed % 201 ) - 100;
+        }
+        break;
+
+        case SCHEMA_STATE_MESSAGE:
+        {
+            SchemaStateMessage * state = (SchemaStateMessage*) message;
+            state->entity = seed % 4096;
+            state->tick = 1099511627775LL - seed;
+            state->flags = 0xF0E1D2C3B4A59687ULL ^ uint64_t( seed );
+            state->mass = 1.5f * seed;
+            state->time = 0.25 * seed;
+            for ( int i = 0; i < 3; ++i )
+                state->position[i] = -1000.0f + 250.0f * ( i + ( seed % 4 ) );
+            state->health[0] = seed;
+            state->health[1] = -seed;
+            state->health[2] = INT32_MIN;
+            state->health[3] = INT32_MAX;
+        }
+        break;
+
+        case SCHEMA_CHAT_MESSAGE:
+        {
+            SchemaChatMessage * chat = (SchemaChatMessage*) message;
+            chat->channel = uint8_t( seed );
+            const int length = seed % 64;
+            for ( int i = 0; i < length; ++i )
+                chat->text[i] = char( 'a' + ( ( seed + i ) % 26 ) );
+            chat->text[length] = '\0';
+        }
+        break;
+
+        case SCHEMA_BLOB_MESSAGE:
+            ( (SchemaBlobMessage*) message )->kind = seed % 8;
+            break;
+
+        default:
+            break;
+    }
+}
+
+static bool SchemaMessagesEqual( Message * a, Message * b )
+{
+    if ( a->GetType() != b->GetType() )
+        return false;
+
+    switch ( a->GetType() )
+    {
+        case SCHEMA_INPUT_MESSAGE:
+        {
+            SchemaInputMessage * x = (SchemaInputMessage*) a;
+            SchemaInputMessage * y = (SchemaInputMessage*) b;
+            return x->sequence == y->sequence && x->buttons == y->buttons && x->jump == y->jump && x->yaw == y->yaw && x->throttle == y->throttle;
+        }
+
+        case SCHEMA_STATE_MESSAGE:
+        {
+            SchemaStateMessage * x = (SchemaStateMessage*) a;
+            SchemaStateMessage * y = (SchemaStateMessage*) b;
+            if ( x->entity != y->entity || x->tick != y->tick || x->flags != y->flags || x->mass != y->mass || x->time != y->time )
+                return false;
+            for ( int i = 0; i < 3; ++i )
+            {
+                if ( x->position[i] != y->position[i] )
+                    return false;
+            }
+            return memcmp( x->health, y->health, sizeof( x->health ) ) == 0;
+        }
+
+        case SCHEMA_CHAT_MESSAGE:
+        {
+            SchemaChatMessage * x = (SchemaChatMessage*) a;
+            SchemaChatMessage * y = (SchemaChatMessage*) b;
+            return x->channel == y->channel && strcmp( x->text, y->text ) == 0;
+        }
+
+        case SCHEMA_BLOB_MESSAGE:
+            return ( (SchemaBlobMessage*) a )->kind == ( (SchemaBlobMessage*) b )->kind;
+
+        default:
+            return true;
+    }
+}
+
+void test_schema_messages_serialize()
+{
+    SchemaTestMessageFactory messageFactory( GetDefaultAllocator() );
+
+    const int fixedBits[] = { SchemaEmptyMessage::FixedBits, SchemaInputMessage::FixedBits, SchemaStateMessage::FixedBits, SchemaChatMessage::FixedBits, SchemaBlobMessage::FixedBits };
+    const int maxBits[] = { SchemaEmptyMessage::MaxBits, SchemaInputMessage::MaxBits, SchemaStateMessage::MaxBits, SchemaChatMessage::MaxBits, SchemaBlobMessage::MaxBits };
+
+    check( SchemaChatMessage::FixedBits == -1 );
+
+    for ( int type = 0; type < NUM_SCHEMA_TEST_MESSAGE_TYPES; ++type )
+    {
+        const MessageTypeInfo * typeInfo = messageFactory.GetMessageTypeInfo( type );
+        check( typeInfo );
+        check( typeInfo->fixedBits == fixedBits[type] );
+        check( typeInfo->maxBits == maxBits[type] );
+
+        for ( int seed = 0; seed < 64; ++seed )
+        {
+            Message * message = messageFactory.CreateMessage( type );
+            check( message );
+            FillSchemaMessage( message, seed );
+
+            // measure through the type table, then measure the slow way through the virtual and compare
+            const int measuredBits = messageFactory.MeasureMessage( message, NULL );
+            MeasureStream measureStream;
+            check( message->SerializeInternal( measureStream ) );
+            check( measuredBits == (int) measureStream.GetBitsProcessed() );
+            if ( fixedBits[type] >= 0 )
+                check( measuredBits == fixedBits[type] );
+            check( measuredBits <= maxBits[type] );
+
+            uint8_t buffer[1024];
+            WriteStream writeStream( buffer, sizeof( buffer ) );
+            check( messageFactory.SerializeMessage( message, writeStream ) );
+            writeStream.Flush();
+            check( writeStream.GetBitsProcessed() <= measuredBits );
+
+            Message * readMessage = messageFactory.CreateMessage( type );
+            check( readMessage );
+            ReadStream readStream( buffer, writeStream.GetBytesProcessed() );
+            check( messageFactory.SerializeMessage( readMessage, readStream ) );
+            check( SchemaMessagesEqual( message, readMessage ) );
+
+            messageFactory.ReleaseMessage( message );
+            messageFactory.ReleaseMessage( readMessage );
+        }
+    }
+}
+
+void test_schema_messages_connection()
+{
+    SchemaTestMessageFactory messageFactory( GetDefaultAllocator() );
+
+    double time = 100.0;
+
+    ConnectionConfig connectionConfig;
+    connectionConfig.numChannels = 2;
+    connectionConfig.channel[0].type = CHANNEL_TYPE_RELIABLE_ORDERED;
+    connectionConfig.channel[1].type = CHANNEL_TYPE_UNRELIABLE_UNORDERED;
+
+    Connection sender( GetDefaultAllocator(), messageFactory, connectionConfig, time );
+    Connection receiver( GetDefaultAllocator(), messageFactory, connectionConfig, time );
+
+    const int NumIterations = 1000;
+
+    const int NumMessagesSent = 64;
+
+    Message * expected[2][NumMessagesSent];
+
+    for ( int channelIndex = 0; channelIndex < 2; ++channelIndex )
+    {
+        for ( int j = 0; j < NumMessagesSent; ++j )
+        {
+            const int type = j % NUM_SCHEMA_TEST_MESSAGE_TYPES;
+            Message * message = messageFactory.CreateMessage( type );
+            check( message );
+            FillSchemaMessage( message, j );
+            if ( type == SCHEMA_BLOB_MESSAGE )
+            {
+                const int blockSize = 1 + j;
+                uint8_t * blockData = (uint8_t*) YOJIMBO_ALLOCATE( messageFactory.GetAllocator(), blockSize );
+                for ( int k = 0; k < blockSize; ++k )
+                    blockData[k] = uint8_t( j + k );
+                ( (BlockMessage*) message )->AttachBlock( messageFactory.GetAllocator(), blockData, blockSize );
+            }
+            messageFactory.AcquireMessage( message );
+            expected[channelIndex][j] = message;
+            sender.SendMessage( channelIndex, message );
+        }
+    }
+
+    int numMessagesReceived[2] = { 0, 0 };
+
+    uint16_t senderSequence = 0;
+    uint16_t receiverSequence = 0;
+
+    for ( int i = 0; i < NumIterations; ++i )
+    {
+        // the unreliable channel must not lose anything here, so only drop packets once it has everything
+        PumpConnectionUpdate( connectionConfig, time, sender, receiver, senderSequence, receiverSequence, 0.1f, numMessagesReceived[1] == NumMessagesSent ? 90 : 0 );
+
+        for ( int channelIndex = 0; channelIndex < 2; ++channelIndex )
+        {
+            while ( true )
+            {
+                Message * message = receiver.ReceiveMessage( channelIndex );
+                if ( !message )
+                    break;
+
+                check( numMessagesReceived[channelIndex] < NumMessagesSent );
+
+                Message * sent = expected[channelIndex][numMessagesReceived[channelIndex]];
+
+                check( SchemaMessagesEqual( sent, message ) );
+
+                if ( message->GetType() == SCHEMA_BLOB_MESSAGE )
+                {
+                    BlockMessage * blockMessage = (BlockMessage*) message;
+                    check( blockMessage->GetBlockSize() == ( (BlockMessage*) sent )->GetBlockSize() );
+                    check( memcmp( blockMessage->GetBlockData(), ( (BlockMessage*) sent )->GetBlockData(), blockMessage->GetBlockSize() ) == 0 );
+                }
+
+                ++numMessagesReceived[channelIndex];
+
+                messageFactory.ReleaseMessage( message );
+            }
+        }
+
+        if ( numMessagesReceived[0] == NumMessagesSent && numMessagesReceived[1] == NumMessagesSent )
+            break;
+    }
+
+    check( numMessagesReceived[0] == NumMessagesSent );
+    check( numMessagesReceived[1] == NumMessagesSent );
+
+    for ( int channelIndex = 0; channelIndex < 2; ++channelIndex )
+    {
+        for ( int j = 0; j < NumMessagesSent; ++j )
+            messageFactory.ReleaseMessage( expected[channelIndex][j] );
+    }
+}
+
+#endif // #if YOJIMBO_TEST_SCHEMA
+
 
 void SendClientToServerMessagesSample( Client & client, int numMessagesToSend, int channelIndex = 0 )
 {
@@ -3743,20 +6787,45 @@ int main( int argc, char ** argv )
         RUN_TEST( test_crypto_aead_vectors );
 #endif // #ifndef YOJIMBO_SYSTEM_DEPS
         RUN_TEST( test_queue );
+        RUN_TEST( test_spsc_queue );
         RUN_TEST( test_address );
         RUN_TEST( test_address_classification );
         RUN_TEST( test_network_simulator_drains_all_slots );
         RUN_TEST( test_bit_array );
         RUN_TEST( test_sequence_buffer );
+        RUN_TEST( test_sequence_buffer_remove_entries );
         RUN_TEST( test_allocator_tlsf );
+        RUN_TEST( test_allocator_tlsf_slab );
+        RUN_TEST( test_allocator_stats );
+        RUN_TEST( test_metrics_registry );
+        RUN_TEST( test_trace );
+        RUN_TEST( test_binary_log );
+        RUN_TEST( test_virtual_memory );
+        RUN_TEST( test_huge_page_memory );
 
         RUN_TEST( test_connection_reliable_ordered_messages );
+        RUN_TEST( test_connection_reliable_ordered_batched_acks );
+        RUN_TEST( test_connection_reliable_ordered_resend_order );
+        RUN_TEST( test_connection_reliable_ordered_packet_budget );
         RUN_TEST( test_connection_reliable_ordered_blocks );
         RUN_TEST( test_connection_reliable_ordered_blocks_max_size );
+        RUN_TEST( test_connection_reliable_ordered_blocks_multiple_fragments );
+        RUN_TEST( test_connection_reliable_ordered_blocks_in_flight );
+        RUN_TEST( test_connection_reliable_ordered_block_stream );
+        RUN_TEST( test_connection_reliable_ordered_block_stream_no_write_function );
+        RUN_TEST( test_compression );
+        RUN_TEST( test_connection_reliable_ordered_blocks_compressed );
         RUN_TEST( test_connection_reliable_ordered_messages_and_blocks );
         RUN_TEST( test_connection_reliable_ordered_messages_and_blocks_multiple_channels );
+        RUN_TEST( test_connection_reliable_unordered_messages_and_blocks );
+        RUN_TEST( test_connection_reliable_unordered_no_head_of_line_blocking );
+        RUN_TEST( test_connection_snapshot_delta );
+        RUN_TEST( test_connection_snapshot_baseline );
         RUN_TEST( test_connection_unreliable_unordered_messages );
         RUN_TEST( test_connection_unreliable_unordered_blocks );
+        RUN_TEST( test_static_connection );
+        RUN_TEST( test_static_connection_interop );
+        RUN_TEST( test_static_connection_get_channel );
         RUN_TEST( test_connection_reject_empty_packet );
         RUN_TEST( test_connection_unreliable_rejects_block_fragment );
         RUN_TEST( test_connection_reliable_block_fragment_on_disabled_blocks );
@@ -3766,11 +6835,22 @@ int main( int argc, char ** argv )
         RUN_TEST( test_connection_unreliable_message_alloc_failure );
         RUN_TEST( test_connection_generate_packet_channel_data_alloc_failure );
         RUN_TEST( test_message_factory_create_message_alloc_failure );
+        RUN_TEST( test_message_factory_pools );
+        RUN_TEST( test_message_factory_pools_alloc_failure );
+        RUN_TEST( test_network_thread_client_server );
         RUN_TEST( test_connection_process_packet_channel_data_alloc_failure );
 
         RUN_TEST( test_client_connect_socket_failure_no_crash );
         RUN_TEST( test_client_is_loopback_when_disconnected );
         RUN_TEST( test_client_server_messages );
+        RUN_TEST( test_client_server_lazy_client_memory );
+        RUN_TEST( test_client_server_huge_pages );
+        RUN_TEST( test_client_server_metrics );
+        RUN_TEST( test_packet_capture );
+        RUN_TEST( test_client_server_direct_loopback );
+#ifndef YOJIMBO_SYSTEM_DEPS
+        RUN_TEST( test_client_server_extended_acks );           // a system reliable only has the 32 bit ack window
+#endif // #ifndef YOJIMBO_SYSTEM_DEPS
         RUN_TEST( test_client_server_start_stop_restart );
         RUN_TEST( test_client_server_message_failed_to_serialize_reliable_ordered );
         RUN_TEST( test_server_client_disconnect_reason );
@@ -3786,6 +6866,11 @@ int main( int argc, char ** argv )
         RUN_TEST( test_single_message_type_reliable_blocks );
         RUN_TEST( test_single_message_type_unreliable );
 
+#if YOJIMBO_TEST_SCHEMA
+        RUN_TEST( test_schema_messages_serialize );
+        RUN_TEST( test_schema_messages_connection );
+#endif // #if YOJIMBO_TEST_SCHEMA
+
         RUN_TEST( test_client_server_messages_network_sim_leak );
 
 #if SOAK
@@ -0,0 +1,81 @@
+#!/usr/bin/env python3
+"""Compare two `bench --json` result files.
+
+Matches results by benchmark and name, and prints the change in each. A result
+that moved the wrong way (slower, bigger, fewer) by more than the threshold is a
+regression. Results present in only one file are listed, not judged.
+
+Timing results vary from run to run by a few percent, more on a busy machine:
+compare release builds run on the same machine, and keep the threshold above
+the noise.
+
+usage: python3 tools/bench/compare.py baseline.json candidate.json [--threshold PERCENT]
+exit:  0 = no regressions, 1 = at least one result regressed past the threshold
+"""
+import argparse, json, sys
+
+
+def load(path):
+    with open(path) as f:
+        data = json.load(f)
+    results = {}
+    for r in data["results"]:
+        results[(r["benchmark"], r["name"])] = r
+    return data, results
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Compare two bench --json result files.")
+    parser.add_argument("baseline")
+    parser.add_argument("candidate")
+    parser.add_argument("--threshold", type=float, default=10.0,
+                        help="percent change in the wrong direction that counts as a regression (default 10)")
+    args = parser.parse_args()
+
+    base_info, base = load(args.baseline)
+    cand_info, cand = load(args.candidate)
+
+    print("baseline:  %s (%s build)" % (base_info["version"], base_info["build"]))
+    print("candidate: %s (%s build)" % (cand_info["version"], cand_info["build"]))
+    if base_info["build"] != cand_info["build"]:
+        print("warning: comparing a %s build against a %s build" % (base_info["build"], cand_info["build"]))
+    print()
+
+    regressions = 0
+    benchmark = None
+
+    for key, b in base.items():
+        c = cand.get(key)
+        if c is None:
+            continue
+        if key[0] != benchmark:
+            benchmark = key[0]
+            print(benchmark)
+        old, new = b["value"], c["value"]
+        change = (new - old) * 100.0 / old if old != 0 else 0.0
+        worse = change if b["better"] == "lower" else -change
+        flag = ""
+        if worse > args.threshold:
+            flag = "  REGRESSION"
+            regressions += 1
+        elif worse < -args.threshold:
+            flag = "  improved"
+        print("    %-80s %12.6g -> %12.6g %-14s %+7.1f%%%s" % (key[1], old, new, b["unit"], change, flag))
+
+    only_base = [k for k in base if k not in cand]
+    only_cand = [k for k in cand if k not in base]
+    if only_base:
+        print("\nonly in baseline:")
+        for k in only_base:
+            print("    %s: %s" % k)
+    if only_cand:
+        print("\nonly in candidate:")
+        for k in only_cand:
+            print("    %s: %s" % k)
+
+    print("\n%d regression(s) past %.1f%%" % (regressions, args.threshold))
+    return 1 if regressions else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -23,7 +23,8 @@ CHANNEL_TYPE = ["RELIABLE_ORDERED", "UNRELIABLE_UNORDERED"]
 MAX_MESSAGES_PER_PACKET = 256
 MAX_BLOCK_SIZE = 256 * 1024
 BLOCK_FRAGMENT_SIZE = 1024
-MAX_FRAGMENTS_PER_BLOCK = MAX_BLOCK_SIZE // BLOCK_FRAGMENT_SIZE
+MAX_FRAGMENTS_PER_BLOCK = -(-MAX_BLOCK_SIZE // BLOCK_FRAGMENT_SIZE)
+MAX_FRAGMENTS_PER_PACKET = 1
 # fuzz_messages.h: PRIMITIVES, STRING, BYTES, BLOCK
 NUM_MESSAGE_TYPES = 4
 MAX_MESSAGE_TYPE = NUM_MESSAGE_TYPES - 1
@@ -99,16 +100,18 @@ def decode_packet(raw):
         ci = sint(r, 0, NUM_CHANNELS - 1) if NUM_CHANNELS > 1 else 0
         is_block = r.bits(1)
         if is_block:
-            msg_id = r.bits(16)
-            n_frag = sint(r, 1, MAX_FRAGMENTS_PER_BLOCK) if MAX_FRAGMENTS_PER_BLOCK > 1 else 1
-            frag_id = sint(r, 0, n_frag - 1) if n_frag > 1 else 0
-            frag_size = sint(r, 1, BLOCK_FRAGMENT_SIZE)
-            r.read_bytes(frag_size)
-            if frag_id == 0:
-                mtype = sint(r, 0, MAX_MESSAGE_TYPE) if MAX_MESSAGE_TYPE > 0 else 0
-                if mtype != 3: raise ValueError("fragment 0 message type is not a block message")
-                message_body(r, mtype)
-            desc.append(f"ch{ci} block id={msg_id} frag={frag_id}/{n_frag} size={frag_size}")
+            n_in_packet = sint(r, 1, MAX_FRAGMENTS_PER_PACKET) if MAX_FRAGMENTS_PER_PACKET > 1 else 1
+            for _ in range(n_in_packet):
+                msg_id = r.bits(16)
+                n_frag = sint(r, 1, MAX_FRAGMENTS_PER_BLOCK) if MAX_FRAGMENTS_PER_BLOCK > 1 else 1
+                frag_id = sint(r, 0, n_frag - 1) if n_frag > 1 else 0
+                frag_size = sint(r, 1, BLOCK_FRAGMENT_SIZE)
+                r.read_bytes(frag_size)
+                if frag_id == 0:
+                    mtype = sint(r, 0, MAX_MESSAGE_TYPE) if MAX_MESSAGE_TYPE > 0 else 0
+                    if mtype != 3: raise ValueError("fragment 0 message type is not a block message")
+                    message_body(r, mtype)
+                desc.append(f"ch{ci} block id={msg_id} frag={frag_id}/{n_frag} size={frag_size}")
             continue
         if not r.bits(1):
             desc.append(f"ch{ci} empty"); continue
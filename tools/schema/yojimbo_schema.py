@@ -0,0 +1,363 @@
+#!/usr/bin/env python3
+"""Generate yojimbo message classes and a message factory from a JSON schema.
+
+Each message becomes a class with a templated Serialize method built on the
+serialize compile time surface (SerializeIntConst and friends), so every range
+and bit width is a template argument. Each class carries its size bounds as
+compile time constants:
+
+    FixedBits   bits every message of the type writes, or -1 if it varies
+    MaxBits     upper bound on the bits the measure stream can report
+
+The factory registers a yojimbo::MessageTypeInfo table, so channels serialize
+messages with direct calls instead of the virtual SerializeInternal methods,
+and skip the measure pass for fixed size types. See tools/schema/README.md for
+the schema format.
+
+usage: python3 tools/schema/yojimbo_schema.py schema.json -o messages.h
+exit:  0 = header written, 1 = the schema is invalid
+"""
+import argparse, json, math, os, re, struct, sys
+
+INT32_MIN, INT32_MAX = -2**31, 2**31 - 1
+INT64_MIN, INT64_MAX = -2**63, 2**63 - 1
+UNSIGNED_BITS = {"uint8": 8, "uint16": 16, "uint32": 32, "uint64": 64}
+
+
+class SchemaError(Exception):
+    pass
+
+
+def bits_required(lo, hi):
+    """serialize::bits_required: the bits to send a value in [lo,hi] as an offset from lo."""
+    return 0 if lo == hi else (hi - lo).bit_length()
+
+
+def f32(x):
+    """Round a Python float to IEEE single precision, as the C++ float math does."""
+    return struct.unpack("<f", struct.pack("<f", x))[0]
+
+
+def compressed_float_bits(lo, hi, res):
+    """serialize::compressed_float_max_integer_value, in single precision, then its bit width.
+    Single precision +, - and / are exactly rounded when computed in double and rounded once to
+    float, so this matches the C++ result bit for bit."""
+    delta = f32(f32(hi) - f32(lo))
+    values = f32(delta / f32(res))
+    if not values >= 1.0:
+        values = 1.0
+    elif values > 4294967040.0:
+        values = 4294967040.0
+    return bits_required(0, int(math.ceil(values)))
+
+
+def upper_snake(name):
+    return re.sub(r"(?<=[a-z0-9])(?=[A-Z])", "_", name).upper()
+
+
+def float_literal(x):
+    # 9 significant digits round trip any float, and the C++ compiler rounds the decimal straight to float
+    text = format(f32(x), ".9g")
+    if "." not in text and "e" not in text and "inf" not in text and "nan" not in text:
+        text += ".0"
+    return text + "f"
+
+
+def int32_literal(x):
+    return "( -2147483647 - 1 )" if x == INT32_MIN else str(x)
+
+
+def int64_literal(x):
+    return "( -9223372036854775807LL - 1 )" if x == INT64_MIN else "%dLL" % x
+
+
+class Field:
+    """One message field: its C++ declaration, serialize call and bit bounds."""
+
+    def __init__(self, where, spec):
+        def need(key):
+            if key not in spec:
+                raise SchemaError("%s: missing '%s'" % (where, key))
+            return spec[key]
+
+        def need_int(key, lo, hi):
+            value = need(key)
+            if not isinstance(value, int) or isinstance(value, bool) or not lo <= value <= hi:
+                raise SchemaError("%s: '%s' must be an integer in [%d,%d]" % (where, key, lo, hi))
+            return value
+
+        def need_number(key):
+            value = need(key)
+            if not isinstance(value, (int, float)) or isinstance(value, bool):
+                raise SchemaError("%s: '%s' must be a number" % (where, key))
+            return float(value)
+
+        def need_range(lo, hi):
+            mn, mx = need_int("min", lo, hi), need_int("max", lo, hi)
+            if mn >= mx:
+                raise SchemaError("%s: min must be less than max" % where)
+            return mn, mx
+
+        def need_float_range():
+            mn, mx, res = need_number("min"), need_number("max"), need_number("res")
+            if not f32(mn) < f32(mx) or not f32(res) > 0.0:
+                raise SchemaError("%s: needs min < max and res > 0" % where)
+            return mn, mx, res
+
+        self.name = need("name")
+        if not isinstance(self.name, str) or not re.match(r"^[A-Za-z_][A-Za-z0-9_]*$", self.name):
+            raise SchemaError("%s: field name must be a C++ identifier" % where)
+        kind = need("type")
+        self.array = None           # element count for array members
+        self.fixed = True
+        n = self.name
+
+        if kind == "bool":
+            self.ctype, self.bits = "bool", 1
+            self.code = "serialize_bool_compile_time( stream, %s );" % n
+        elif kind in UNSIGNED_BITS or kind == "bits":
+            bits = UNSIGNED_BITS[kind] if kind in UNSIGNED_BITS else need_int("bits", 1, 64)
+            self.ctype = {8: "uint8_t", 16: "uint16_t"}.get(bits, "uint32_t" if bits <= 32 else "uint64_t")
+            if kind == "bits":
+                self.ctype = "uint32_t" if bits <= 32 else "uint64_t"
+            self.bits = bits
+            macro = "serialize_bits_compile_time" if bits <= 32 else "serialize_bits64_compile_time"
+            self.code = "%s( stream, %s, %d );" % (macro, n, bits)
+        elif kind == "int":
+            mn, mx = need_range(INT32_MIN, INT32_MAX)
+            self.ctype, self.bits = "int32_t", bits_required(mn, mx)
+            self.code = "serialize_int_compile_time( stream, %s, %s, %s );" % (n, int32_literal(mn), int32_literal(mx))
+        elif kind == "int64":
+            mn, mx = need_range(INT64_MIN, INT64_MAX)
+            self.ctype, self.bits = "int64_t", bits_required(mn, mx)
+            self.code = "serialize_int64_compile_time( stream, %s, %s, %s );" % (n, int64_literal(mn), int64_literal(mx))
+        elif kind == "float":
+            self.ctype, self.bits = "float", 32
+            self.code = "serialize_float( stream, %s );" % n
+        elif kind == "double":
+            self.ctype, self.bits = "double", 64
+            self.code = "serialize_double( stream, %s );" % n
+        elif kind == "compressed_float":
+            mn, mx, res = need_float_range()
+            self.ctype, self.bits = "float", compressed_float_bits(mn, mx, res)
+            self.code = "serialize_compressed_float( stream, %s, %s, %s, %s );" % (n, float_literal(mn), float_literal(mx), float_literal(res))
+        elif kind == "string":
+            size = need_int("size", 2, 1 << 20)
+            self.ctype, self.array = "char", size
+            # length in [0,size-1], then the bytes after an align. the measure stream counts the align as 7 bits
+            self.min_bits = bits_required(0, size - 1) + 7
+            self.bits = self.min_bits + 8 * (size - 1)
+            self.fixed = False
+            self.code = "serialize_string( stream, %s, %d );" % (n, size)
+        elif kind == "int_array":
+            count = need_int("count", 1, 1 << 20)
+            mn, mx = need_range(INT32_MIN, INT32_MAX)
+            self.ctype, self.array, self.bits = "int32_t", count, count * bits_required(mn, mx)
+            self.code = "serialize_int_array( stream, %s, %d, %s, %s );" % (n, count, int32_literal(mn), int32_literal(mx))
+        elif kind == "compressed_float_array":
+            count = need_int("count", 1, 1 << 20)
+            mn, mx, res = need_float_range()
+            self.ctype, self.array, self.bits = "float", count, count * compressed_float_bits(mn, mx, res)
+            self.code = "serialize_compressed_float_array( stream, %s, %d, %s, %s, %s );" % (n, count, float_literal(mn), float_literal(mx), float_literal(res))
+        else:
+            raise SchemaError("%s: unknown field type '%s'" % (where, kind))
+
+        if self.fixed:
+            self.min_bits = self.bits
+
+    def declaration(self):
+        if self.array:
+            return "%s %s[%d];" % (self.ctype, self.name, self.array)
+        return "%s %s;" % (self.ctype, self.name)
+
+    def initializer(self):
+        if self.array:
+            return "memset( %s, 0, sizeof( %s ) );" % (self.name, self.name)
+        return "%s = %s;" % (self.name, "false" if self.ctype == "bool" else "0")
+
+
+class MessageSpec:
+    def __init__(self, index, spec):
+        where = "message %d" % index
+        if not isinstance(spec, dict) or "name" not in spec:
+            raise SchemaError("%s: missing 'name'" % where)
+        self.name = spec["name"]
+        if not isinstance(self.name, str) or not re.match(r"^[A-Za-z_][A-Za-z0-9_]*$", self.name):
+            raise SchemaError("%s: name must be a C++ identifier" % where)
+        where = "message '%s'" % self.name
+        self.type = spec.get("type", upper_snake(self.name))
+        self.block = bool(spec.get("block", False))
+        fields = spec.get("fields", [])
+        if not isinstance(fields, list):
+            raise SchemaError("%s: 'fields' must be a list" % where)
+        self.fields = []
+        for i, field in enumerate(fields):
+            if not isinstance(field, dict):
+                raise SchemaError("%s field %d: must be an object" % (where, i))
+            self.fields.append(Field("%s field '%s'" % (where, field.get("name", i)), field))
+        names = [f.name for f in self.fields]
+        for name in names:
+            if names.count(name) > 1:
+                raise SchemaError("%s: duplicate field '%s'" % (where, name))
+        self.max_bits = sum(f.bits for f in self.fields)
+        self.fixed_bits = self.max_bits if all(f.fixed for f in self.fields) else -1
+        if self.max_bits > INT32_MAX:
+            raise SchemaError("%s: too large" % where)
+
+
+def load(path):
+    try:
+        with open(path) as f:
+            schema = json.load(f)
+    except (OSError, ValueError) as e:
+        raise SchemaError(str(e))
+    for key in ("enum", "factory", "messages"):
+        if key not in schema:
+            raise SchemaError("missing '%s'" % key)
+    if not isinstance(schema["messages"], list) or not schema["messages"]:
+        raise SchemaError("'messages' must be a non-empty list")
+    messages = [MessageSpec(i, m) for i, m in enumerate(schema["messages"])]
+    names = [m.name for m in messages] + [m.type for m in messages]
+    for name in names:
+        if names.count(name) > 1:
+            raise SchemaError("duplicate message name or type '%s'" % name)
+    return schema, messages
+
+
+def generate(schema, messages, source_name, output_name):
+    guard = re.sub(r"[^A-Za-z0-9]", "_", os.path.basename(output_name)).upper()
+    enum = schema["enum"]
+    count = "NUM_%sS" % upper_snake(enum)
+    factory = schema["factory"]
+    namespace = schema.get("namespace")
+
+    out = []
+    w = out.append
+    w("/*")
+    w("    Generated by tools/schema/yojimbo_schema.py from %s. Do not edit." % source_name)
+    w("*/")
+    w("")
+    w("#ifndef %s" % guard)
+    w("#define %s" % guard)
+    w("")
+    w('#include "yojimbo.h"')
+    w("#include <string.h>")
+    w("")
+    w("#if !defined( SERIALIZE_HAS_COMPILE_TIME_SURFACE )")
+    w('#error "generated messages need the serialize compile time surface (C++14 or later)"')
+    w("#endif // #if !defined( SERIALIZE_HAS_COMPILE_TIME_SURFACE )")
+    w("")
+    if namespace:
+        w("namespace %s" % namespace)
+        w("{")
+    ind = "    " if namespace else ""
+
+    w(ind + "enum %s" % enum)
+    w(ind + "{")
+    for m in messages:
+        w(ind + "    %s," % m.type)
+    w(ind + "    %s" % count)
+    w(ind + "};")
+    w("")
+
+    for m in messages:
+        base = "yojimbo::BlockMessage" if m.block else "yojimbo::Message"
+        w(ind + "class %s : public %s" % (m.name, base))
+        w(ind + "{")
+        w(ind + "public:")
+        w("")
+        w(ind + "    // message body bounds in bits, not counting the type and id the channel adds or an attached block")
+        w(ind + "    enum { FixedBits = %d, MaxBits = %d };" % (m.fixed_bits, m.max_bits))
+        if m.fields:
+            w("")
+            for f in m.fields:
+                w(ind + "    %s" % f.declaration())
+        w("")
+        w(ind + "    %s()" % m.name)
+        w(ind + "    {")
+        for f in m.fields:
+            w(ind + "        %s" % f.initializer())
+        w(ind + "    }")
+        w("")
+        w(ind + "    template <typename Stream> bool Serialize( Stream & stream )")
+        w(ind + "    {")
+        if not m.fields:
+            w(ind + "        (void) stream;")
+        for f in m.fields:
+            w(ind + "        %s" % f.code)
+        w(ind + "        return true;")
+        w(ind + "    }")
+        w("")
+        w(ind + "    YOJIMBO_VIRTUAL_SERIALIZE_FUNCTIONS();")
+        w(ind + "};")
+        w("")
+
+    w(ind + "class %s : public yojimbo::MessageFactory" % factory)
+    w(ind + "{")
+    w(ind + "public:")
+    w("")
+    w(ind + "    explicit %s( yojimbo::Allocator & allocator ) : yojimbo::MessageFactory( allocator, %s )" % (factory, count))
+    w(ind + "    {")
+    w(ind + "        static const yojimbo::MessageTypeInfo typeInfo[%s] =" % count)
+    w(ind + "        {")
+    for m in messages:
+        w(ind + "            YOJIMBO_MESSAGE_TYPE_INFO( %s, %s::FixedBits, %s::MaxBits )," % (m.name, m.name, m.name))
+    w(ind + "        };")
+    w(ind + "        SetMessageTypeInfo( typeInfo );")
+    w(ind + "    }")
+    w("")
+    w(ind + "protected:")
+    w("")
+    w(ind + "    yojimbo::Message * CreateMessageInternal( int type ) YOJIMBO_OVERRIDE")
+    w(ind + "    {")
+    w(ind + "        yojimbo::Message * message;")
+    w(ind + "        yojimbo::Allocator & allocator = GetMessageAllocator( type );")
+    w(ind + "        switch ( type )")
+    w(ind + "        {")
+    for m in messages:
+        w(ind + "            case %s:" % m.type)
+        w(ind + "                message = YOJIMBO_NEW( allocator, %s );" % m.name)
+        w(ind + "                if ( !message )")
+        w(ind + "                    return NULL;")
+        w(ind + "                SetMessageType( message, %s );" % m.type)
+        w(ind + "                return message;")
+    w(ind + "            default: return NULL;")
+    w(ind + "        }")
+    w(ind + "    }")
+    w(ind + "};")
+
+    if namespace:
+        w("}")
+    w("")
+    w("#endif // #ifndef %s" % guard)
+    w("")
+    return "\n".join(out)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Generate yojimbo message classes and a message factory from a JSON schema.")
+    parser.add_argument("schema", help="the schema file (.json)")
+    parser.add_argument("-o", "--output", required=True, help="the header to write")
+    args = parser.parse_args()
+
+    try:
+        schema, messages = load(args.schema)
+        text = generate(schema, messages, os.path.basename(args.schema), args.output)
+    except SchemaError as e:
+        print("error: %s: %s" % (args.schema, e), file=sys.stderr)
+        return 1
+
+    # only touch the output when it changes, so dependent objects don't rebuild for nothing
+    try:
+        with open(args.output) as f:
+            if f.read() == text:
+                return 0
+    except OSError:
+        pass
+    with open(args.output, "w") as f:
+        f.write(text)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())